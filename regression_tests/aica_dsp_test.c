@@ -0,0 +1,237 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * Runs random AICA DSP programs through both the interpreter and the x86_64
+ * backend and fails if they ever disagree about the output, the DSP's
+ * registers or wave memory.  Afterwards it times both of them on a
+ * full-length program and prints the cost of one mixing block.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "washdc/error.h"
+#include "washdc/log.h"
+#include "log.h"
+#include "hw/aica/aica_dsp.h"
+#include "jit/x86_64/exec_mem.h"
+
+// same as AICA_MIX_BLOCK_LEN
+#define BLOCK_LEN 512
+
+#define N_PROGRAMS 256
+#define N_BLOCKS 4
+
+#define N_BENCH_BLOCKS 500
+
+#define SYS_REG_LEN (0x8000 / 4)
+
+static struct exec_mem arena;
+static struct aica_dsp dsp_interp, dsp_native;
+static struct aica_wave_mem *mem_interp, *mem_native;
+static uint32_t sys_reg[SYS_REG_LEN];
+
+static int32_t mixs[AICA_DSP_N_MIXS][BLOCK_LEN];
+static int32_t const *mixs_in[AICA_DSP_N_MIXS];
+
+static float out_interp[2][BLOCK_LEN], out_native[2][BLOCK_LEN];
+
+void log_do_write(enum log_severity lvl, char const *fmt, ...) {
+}
+
+void washdc_log(enum washdc_log_severity severity,
+                char const *fmt, va_list args) {
+}
+
+ERROR_INT_ATTR(line) {
+}
+
+ERROR_STRING_ATTR(file) {
+}
+
+ERROR_STRING_ATTR(function) {
+}
+
+ERROR_U32_ATTR(address) {
+}
+
+ERROR_INT_ATTR(length) {
+}
+
+WASHDC_NORETURN void error_raise(enum error_type tp) {
+    fprintf(stderr, "error %d raised\n", (int)tp);
+    abort();
+}
+
+static uint32_t rand16(void) {
+    return rand() & 0xffff;
+}
+
+static int32_t rand24(void) {
+    return ((int32_t)((uint32_t)rand() << 8)) >> 8;
+}
+
+static void random_program(void) {
+    unsigned idx;
+
+    for (idx = 0; idx < AICA_DSP_N_STEPS * 4; idx++)
+        sys_reg[AICA_DSP_MPRO / 4 + idx] = rand16();
+    for (idx = 0; idx < AICA_DSP_N_STEPS; idx++)
+        sys_reg[AICA_DSP_COEF / 4 + idx] = rand16();
+    for (idx = 0; idx < 32; idx++)
+        sys_reg[AICA_DSP_MADRS / 4 + idx] = rand16();
+    for (idx = 0; idx < AICA_DSP_N_EFREG; idx++)
+        sys_reg[AICA_DSP_MIXER_FIRST / 4 + idx] = rand16();
+
+    uint32_t rb_base = (rand() & 0xfff) << 11;
+    uint32_t rb_len = (8 * 1024) << (rand() & 3);
+
+    aica_dsp_compile(&dsp_interp, sys_reg, rb_base, rb_len);
+    aica_dsp_compile(&dsp_native, sys_reg, rb_base, rb_len);
+}
+
+static void random_state(void) {
+    unsigned idx;
+
+    for (idx = 0; idx < AICA_DSP_N_TEMP; idx++)
+        dsp_interp.temp[idx] = dsp_native.temp[idx] = rand24();
+    for (idx = 0; idx < AICA_DSP_N_MEMS; idx++)
+        dsp_interp.mems[idx] = dsp_native.mems[idx] = rand24();
+    dsp_interp.dec = dsp_native.dec = rand();
+}
+
+static void random_mixs(void) {
+    unsigned reg_no, sample_no;
+
+    // a bit outside of 20 bits so that the clamping gets tested too
+    for (reg_no = 0; reg_no < AICA_DSP_N_MIXS; reg_no++)
+        for (sample_no = 0; sample_no < BLOCK_LEN; sample_no++)
+            mixs[reg_no][sample_no] = (rand() % 0x120000) - 0x90000;
+}
+
+static int compare(unsigned prog_no, unsigned block_no) {
+    if (memcmp(out_interp, out_native, sizeof(out_interp)) != 0) {
+        fprintf(stderr, "program %u block %u: output mismatch\n",
+                prog_no, block_no);
+        return 1;
+    }
+    if (memcmp(dsp_interp.temp, dsp_native.temp, sizeof(dsp_interp.temp)) ||
+        memcmp(dsp_interp.mems, dsp_native.mems, sizeof(dsp_interp.mems)) ||
+        memcmp(dsp_interp.efreg, dsp_native.efreg,
+               sizeof(dsp_interp.efreg)) ||
+        dsp_interp.dec != dsp_native.dec) {
+        fprintf(stderr, "program %u block %u: register mismatch\n",
+                prog_no, block_no);
+        return 1;
+    }
+    if (memcmp(mem_interp, mem_native, sizeof(*mem_interp)) != 0) {
+        fprintf(stderr, "program %u block %u: wave memory mismatch\n",
+                prog_no, block_no);
+        return 1;
+    }
+    return 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static double bench(struct aica_dsp *dsp, struct aica_wave_mem *mem) {
+    unsigned block_no;
+    double start = now();
+    for (block_no = 0; block_no < N_BENCH_BLOCKS; block_no++) {
+        aica_dsp_run(dsp, mem, mixs_in, out_interp[0], out_interp[1],
+                     BLOCK_LEN);
+    }
+    return (now() - start) / N_BENCH_BLOCKS * 1000000.0;
+}
+
+int main(int argc, char **argv) {
+    unsigned prog_no, block_no, reg_no, idx;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+
+    exec_mem_init(&arena);
+
+    mem_interp = malloc(sizeof(*mem_interp));
+    mem_native = malloc(sizeof(*mem_native));
+    if (!mem_interp || !mem_native) {
+        fprintf(stderr, "failed to allocate wave memory\n");
+        return 1;
+    }
+
+    for (idx = 0; idx < sizeof(*mem_interp); idx++)
+        ((uint8_t*)mem_interp)[idx] = rand();
+    memcpy(mem_native, mem_interp, sizeof(*mem_native));
+
+    for (reg_no = 0; reg_no < AICA_DSP_N_MIXS; reg_no++)
+        mixs_in[reg_no] = mixs[reg_no];
+
+    aica_dsp_init(&dsp_interp, NULL);
+    aica_dsp_init(&dsp_native, &arena);
+
+    for (prog_no = 0; prog_no < N_PROGRAMS; prog_no++) {
+        random_program();
+        random_state();
+
+        for (block_no = 0; block_no < N_BLOCKS; block_no++) {
+            random_mixs();
+            memset(out_interp, 0, sizeof(out_interp));
+            memset(out_native, 0, sizeof(out_native));
+            aica_dsp_run(&dsp_interp, mem_interp, mixs_in,
+                         out_interp[0], out_interp[1], BLOCK_LEN);
+            aica_dsp_run(&dsp_native, mem_native, mixs_in,
+                         out_native[0], out_native[1], BLOCK_LEN);
+            if (compare(prog_no, block_no))
+                return 1;
+        }
+    }
+
+    printf("%u programs matched\n", N_PROGRAMS);
+
+    // time a program that has all 128 steps, none of which can be dropped
+    do {
+        random_program();
+    } while (dsp_interp.prog_len < AICA_DSP_N_STEPS);
+    random_mixs();
+
+    double us_interp = bench(&dsp_interp, mem_interp);
+    double us_native = bench(&dsp_native, mem_native);
+    printf("%u-sample block, %u steps: %.1f us interpreted, "
+           "%.1f us native\n", BLOCK_LEN, dsp_interp.prog_len,
+           us_interp, us_native);
+
+    aica_dsp_cleanup(&dsp_native);
+    aica_dsp_cleanup(&dsp_interp);
+    exec_mem_cleanup(&arena);
+
+    free(mem_native);
+    free(mem_interp);
+
+    return 0;
+}
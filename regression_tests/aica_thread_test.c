@@ -0,0 +1,176 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * Drives aica_thread.c with the AICA and ARM7 stubbed out.  Every "timeslice"
+ * on the AICA thread flips the SH4's interrupt line far more times than there
+ * used to be room for in the queue between the two threads, while the SH4's
+ * thread keeps reading AICA registers and waiting for the answers.  This used
+ * to deadlock, so ctest gives it a timeout.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "washdc/error.h"
+#include "washdc/log.h"
+#include "log.h"
+#include "dc_sched.h"
+#include "hw/aica/aica.h"
+#include "hw/sys/holly_intc.h"
+#include "hw/aica/aica_thread.h"
+
+#define N_SLICES 256
+
+// interrupt line changes per timeslice
+#define N_TOGGLES 1000
+
+// AICA thread only
+static unsigned n_slices_run, n_reads;
+
+// SH4 thread only
+static bool int_line;
+static unsigned n_raises, n_clears;
+
+bool dc_clock_run_timeslice(struct dc_clock *clk) {
+    unsigned idx;
+
+    for (idx = 0; idx < N_TOGGLES; idx++) {
+        aica_thread_post_sh4_int(!(idx & 1));
+        if (idx % 64 == 0)
+            aica_thread_poll();
+    }
+
+    // leave the line raised at the end of odd-numbered slices
+    aica_thread_post_sh4_int(n_slices_run & 1);
+    n_slices_run++;
+
+    return false;
+}
+
+void holly_raise_ext_int(HollyExtInt int_type) {
+    int_line = true;
+    n_raises++;
+}
+
+void holly_clear_ext_int(HollyExtInt int_type) {
+    int_line = false;
+    n_clears++;
+}
+
+static uint32_t stub_read_32(addr32_t addr, void *ctxt) {
+    n_reads++;
+    return addr;
+}
+
+static uint16_t stub_read_16(addr32_t addr, void *ctxt) {
+    return stub_read_32(addr, ctxt);
+}
+
+static uint8_t stub_read_8(addr32_t addr, void *ctxt) {
+    return stub_read_32(addr, ctxt);
+}
+
+struct memory_interface aica_sys_intf = {
+    .read32 = stub_read_32,
+    .read16 = stub_read_16,
+    .read8 = stub_read_8
+};
+
+void aica_get_sndchan_stat(struct aica const *aica, unsigned ch_no,
+                           struct washdc_sndchan_stat *stat) {
+}
+
+void aica_get_sndchan_var(struct aica const *aica,
+                          struct washdc_sndchan_stat const *chan_stat,
+                          unsigned var_no, struct washdc_var *var) {
+}
+
+void aica_mute_chan(struct aica *aica, unsigned chan_no, bool is_muted) {
+}
+
+void aica_set_silent(struct aica *aica, bool silent) {
+}
+
+void log_do_write(enum log_severity lvl, char const *fmt, ...) {
+}
+
+void washdc_log(enum washdc_log_severity severity,
+                char const *fmt, va_list args) {
+}
+
+ERROR_INT_ATTR(line) {
+}
+
+ERROR_STRING_ATTR(file) {
+}
+
+ERROR_STRING_ATTR(function) {
+}
+
+ERROR_U32_ATTR(address) {
+}
+
+ERROR_INT_ATTR(length) {
+}
+
+WASHDC_NORETURN void error_raise(enum error_type tp) {
+    fprintf(stderr, "error %d raised\n", (int)tp);
+    abort();
+}
+
+int main(int argc, char **argv) {
+    unsigned slice_no;
+    int ret = 0;
+
+    aica_thread_start(NULL, NULL);
+
+    for (slice_no = 0; slice_no < N_SLICES; slice_no++) {
+        uint32_t addr = 0x00702800 + 4 * (slice_no % 4);
+        if (aica_thread_sys_intf.read32(addr, NULL) != addr) {
+            fprintf(stderr, "wrong answer to read %u\n", slice_no);
+            ret = 1;
+        }
+        aica_thread_sync();
+    }
+
+    aica_thread_stop();
+
+    printf("%u timeslices, %u interrupt changes each, %u raises and %u "
+           "clears applied\n", n_slices_run, N_TOGGLES + 1, n_raises,
+           n_clears);
+
+    if (n_reads != N_SLICES) {
+        fprintf(stderr, "%u of %u reads got through\n", n_reads, N_SLICES);
+        ret = 1;
+    }
+
+    // the line should be wherever the last timeslice left it
+    if (!n_slices_run || int_line != ((n_slices_run - 1) & 1)) {
+        fprintf(stderr, "interrupt line is %s after the last timeslice\n",
+                int_line ? "raised" : "cleared");
+        ret = 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,322 @@
+#!/usr/bin/env perl
+
+################################################################################
+#
+#
+#    WashingtonDC Dreamcast Emulator
+#    Copyright (C) 2020 snickerbockers
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+#
+################################################################################
+
+################################################################################
+#
+# Batch regression runner for washdc-headless.
+#
+# usage: headless_batch.pl [options] <manifest>
+#
+# Every test in the manifest gets its own washdc-headless process, and up to
+# -j of them run at the same time.  Each one boots the firmware (optionally
+# with a disc image mounted and an input movie playing), hashes the
+# framebuffer at the end of each checkpoint frame (the -H and -K options of
+# washdc-headless) and exits after the last checkpoint.  The hashes are then
+# compared against the ones in the manifest.
+#
+# The manifest has one test per line.  Blank lines and anything after a '#'
+# are ignored.  Each test is four whitespace-separated fields:
+#
+#     <name> <disc image or -> <input movie or -> <frame>=<hash>[,...]
+#
+# for example:
+#
+#     bios_boot    -                  -              60=?,600=?
+#     menu_walk    game/disc.gdi      menu_walk.wdcm 300=3772584155f5e325
+#
+# A hash of "?" means the expected value isn't known yet; that checkpoint
+# gets reported as NEW instead of failing.  Run with -u to write a copy of the
+# manifest with every hash filled in from this run.
+#
+# A hash of "none" means the framebuffer is expected to be unavailable at
+# that checkpoint (for example because nothing has been rendered yet).  It
+# has to be written into the manifest by hand: a checkpoint where
+# washdc-headless couldn't grab the framebuffer fails unless the manifest
+# says "none", and -u never fills it in.
+#
+# Only use checkpoints from runs that are known to be correct, and keep the
+# firmware, flash image and CPU backend the same between runs (the flash
+# image is never written to since it is always passed in with -f).
+# exec.aica-thread gets ignored while hashing, so it doesn't matter.
+#
+# options:
+#     -w <path>    washdc-headless executable
+#     -b <path>    firmware image
+#     -f <path>    flash image
+#     -j <n>       number of tests to run at once (default: number of CPUs)
+#     -t <secs>    kill a test that runs longer than this (default 600)
+#     -o <dir>     where to put each test's log, hashes and benchmark CSV
+#     -u <path>    write the manifest with this run's hashes to path
+#     -a <args>    extra arguments for washdc-headless (eg "-p")
+#
+# The exit status is 0 if every test passed (NEW counts as passing) and 1
+# otherwise.
+#
+################################################################################
+
+use strict;
+use warnings;
+
+use Getopt::Std;
+use POSIX qw(:sys_wait_h);
+use Time::HiRes qw(time sleep);
+
+my $WASH_PATH = "./src/washdc-headless/washdc-headless";
+my $FIRMWARE_PATH = "./dc_bios.bin";
+my $FLASH_PATH = "./dc_flash.bin";
+my $OUT_DIR = "./headless_batch_out";
+my $TIMEOUT = 600;
+
+sub usage {
+    print STDERR "usage: $0 [-w washdc-headless] [-b bios] [-f flash] " .
+        "[-j jobs] [-t timeout] [-o outdir] [-u new_manifest] " .
+        "[-a \"extra args\"] <manifest>\n";
+    exit 1;
+}
+
+sub cpu_count {
+    my $count = 0;
+    if (open(my $cpuinfo, "< /proc/cpuinfo")) {
+        while (<$cpuinfo>) {
+            $count++ if /^processor\s*:/;
+        }
+        close($cpuinfo);
+    }
+    if (!$count) {
+        my $online = `getconf _NPROCESSORS_ONLN 2>/dev/null`;
+        $count = $1 if defined $online && $online =~ /^\s*(\d+)/;
+    }
+    return $count > 0 ? $count : 1;
+}
+
+my %opts;
+getopts('w:b:f:j:t:o:u:a:h', \%opts) or usage();
+usage() if $opts{'h'} || @ARGV != 1;
+
+$WASH_PATH = $opts{'w'} if defined $opts{'w'};
+$FIRMWARE_PATH = $opts{'b'} if defined $opts{'b'};
+$FLASH_PATH = $opts{'f'} if defined $opts{'f'};
+$OUT_DIR = $opts{'o'} if defined $opts{'o'};
+$TIMEOUT = $opts{'t'} if defined $opts{'t'};
+my $n_jobs = defined $opts{'j'} ? $opts{'j'} : cpu_count();
+my @extra_args = defined $opts{'a'} ? split(' ', $opts{'a'}) : ( );
+my $manifest_path = $ARGV[0];
+
+usage() if $n_jobs < 1 || $TIMEOUT <= 0;
+
+# parse the manifest
+my @tests = ( );
+my %test_names = ( );
+open(my $manifest, "< $manifest_path") || die "failed to open $manifest_path";
+while (my $line = <$manifest>) {
+    $line =~ s/#.*//;
+    next if $line =~ /^\s*$/;
+
+    my @fields = split(' ', $line);
+    die "$manifest_path:$.: expected 4 fields\n" if @fields != 4;
+    my ($name, $image, $movie, $checkpoints) = @fields;
+
+    die "$manifest_path:$.: bad test name \"$name\"\n"
+        unless $name =~ /^[\w.-]+$/;
+    die "$manifest_path:$.: duplicate test name \"$name\"\n"
+        if $test_names{$name};
+    $test_names{$name} = 1;
+
+    my @frames = ( );
+    my %expect = ( );
+    foreach my $cp (split(/,/, $checkpoints)) {
+        die "$manifest_path:$.: bad checkpoint \"$cp\"\n"
+            unless $cp =~ /^(\d+)=([0-9a-fA-F]{16}|\?|none)$/;
+        die "$manifest_path:$.: checkpoints must be in increasing order\n"
+            if @frames && $1 <= $frames[-1];
+        push @frames, $1;
+        $expect{$1} = lc $2;
+    }
+    die "$manifest_path:$.: no checkpoints\n" unless @frames;
+
+    push @tests, {
+        name => $name,
+        image => $image eq "-" ? undef : $image,
+        movie => $movie eq "-" ? undef : $movie,
+        frames => \@frames,
+        expect => \%expect
+    };
+}
+close($manifest);
+
+die "no tests in $manifest_path\n" unless @tests;
+
+mkdir $OUT_DIR unless -d $OUT_DIR;
+die "unable to create $OUT_DIR\n" unless -d $OUT_DIR;
+
+sub start_test {
+    my $test = shift;
+    my $name = $test->{name};
+
+    $test->{log} = "$OUT_DIR/$name.log";
+    $test->{hash_file} = "$OUT_DIR/$name.hash";
+    $test->{bench_file} = "$OUT_DIR/$name.csv";
+    unlink $test->{hash_file}, $test->{bench_file};
+
+    my @cmd = ($WASH_PATH, "-b", $FIRMWARE_PATH, "-f", $FLASH_PATH, "-l",
+               "-H", $test->{hash_file},
+               "-K", join(",", @{$test->{frames}}),
+               "-B", $test->{bench_file}, @extra_args);
+    push @cmd, ("-m", $test->{image}) if defined $test->{image};
+    push @cmd, ("-P", $test->{movie}) if defined $test->{movie};
+
+    my $pid = fork;
+    die "fork failed" unless defined $pid;
+    if ($pid == 0) {
+        open(STDOUT, "> $test->{log}") || die "failed to open $test->{log}";
+        open(STDERR, ">&STDOUT");
+        exec(@cmd) || die "failed to execute $WASH_PATH";
+    }
+
+    $test->{pid} = $pid;
+    $test->{start} = time;
+}
+
+# compare a finished test's hashes against the manifest
+sub check_test {
+    my $test = shift;
+    my %got = ( );
+
+    if (open(my $hash_file, "< $test->{hash_file}")) {
+        while (<$hash_file>) {
+            $got{$1} = lc $2 if /^(\d+) ([0-9a-fA-F]{16}|none)/;
+        }
+        close($hash_file);
+    }
+    $test->{got} = \%got;
+
+    # one line per frame after the CSV header
+    $test->{n_frames} = 0;
+    if (open(my $bench_file, "< $test->{bench_file}")) {
+        $test->{n_frames}++ while <$bench_file>;
+        $test->{n_frames}-- if $test->{n_frames};
+        close($bench_file);
+    }
+
+    my @problems = ( );
+    my $n_new = 0;
+    foreach my $frame (@{$test->{frames}}) {
+        my $want = $test->{expect}->{$frame};
+        if (!defined $got{$frame}) {
+            push @problems, "frame $frame: no hash";
+        } elsif ($got{$frame} eq "none" && $want ne "none") {
+            push @problems, "frame $frame: unable to grab the framebuffer";
+        } elsif ($want eq "?") {
+            $n_new++;
+        } elsif ($want ne $got{$frame}) {
+            push @problems, "frame $frame: expected $want, got $got{$frame}";
+        }
+    }
+
+    if ($test->{timed_out}) {
+        unshift @problems, "timed out after ${TIMEOUT}s";
+    } elsif ($test->{status}) {
+        unshift @problems, sprintf("exited with status %d", $test->{status} >> 8);
+    }
+
+    if (@problems) {
+        $test->{result} = "FAIL";
+        $test->{detail} = join("; ", @problems) . " (see $test->{log})";
+    } elsif ($n_new) {
+        $test->{result} = "NEW";
+        $test->{detail} = "$n_new checkpoint(s) had no expected hash";
+    } else {
+        $test->{result} = "PASS";
+        $test->{detail} = "";
+    }
+}
+
+sub report_test {
+    my $test = shift;
+    my $fps = $test->{wall} > 0 ? $test->{n_frames} / $test->{wall} : 0;
+    printf("%-4s %-24s %8.2fs %8.1f fps  %s\n", $test->{result},
+           $test->{name}, $test->{wall}, $fps, $test->{detail});
+}
+
+printf("running %d test(s), %d at a time\n", scalar @tests, $n_jobs);
+
+my @queue = @tests;
+my %running = ( );
+my $batch_start = time;
+while (@queue || %running) {
+    while (@queue && keys(%running) < $n_jobs) {
+        my $test = shift @queue;
+        start_test($test);
+        $running{$test->{pid}} = $test;
+    }
+
+    my $pid = waitpid(-1, WNOHANG);
+    if ($pid > 0 && $running{$pid}) {
+        my $test = delete $running{$pid};
+        $test->{status} = $?;
+        $test->{wall} = time - $test->{start};
+        check_test($test);
+        report_test($test);
+        next;
+    }
+
+    # SIGINT first so that the emulator gets a chance to clean up
+    foreach my $test (values %running) {
+        my $elapsed = time - $test->{start};
+        if ($elapsed > $TIMEOUT + 10) {
+            kill 'KILL', $test->{pid};
+        } elsif ($elapsed > $TIMEOUT && !$test->{timed_out}) {
+            $test->{timed_out} = 1;
+            kill 'INT', $test->{pid};
+        }
+    }
+
+    sleep 0.1;
+}
+
+my %n_results = ( PASS => 0, NEW => 0, FAIL => 0 );
+$n_results{$_->{result}}++ foreach @tests;
+printf("%d passed, %d new, %d failed in %.2fs\n", $n_results{PASS},
+       $n_results{NEW}, $n_results{FAIL}, time - $batch_start);
+
+if (defined $opts{'u'}) {
+    open(my $new_manifest, "> $opts{'u'}") || die "failed to open $opts{'u'}";
+    print $new_manifest "# name image movie checkpoints\n";
+    foreach my $test (@tests) {
+        # "none" only ever comes from the original manifest
+        my @cps = map {
+            my $got = $test->{got}->{$_};
+            "$_=" . (defined $got && $got ne "none" ?
+                     $got : $test->{expect}->{$_})
+        } @{$test->{frames}};
+        printf $new_manifest "%s %s %s %s\n", $test->{name},
+            defined $test->{image} ? $test->{image} : "-",
+            defined $test->{movie} ? $test->{movie} : "-",
+            join(",", @cps);
+    }
+    close($new_manifest);
+    print "wrote updated manifest to $opts{'u'}\n";
+}
+
+exit($n_results{FAIL} ? 1 : 0);
@@ -77,6 +77,10 @@ static inline void washdc_atomic_int_init(washdc_atomic_int *atom, int val) {
     *atom = val;
 }
 
+static inline void washdc_atomic_int_store(washdc_atomic_int *atom, int val) {
+    InterlockedExchange(atom, val);
+}
+
 #else
 /*
  * Here we foolishly assume that any compiler which isn't MSVC will support C11
@@ -114,6 +118,10 @@ static inline void washdc_atomic_int_init(washdc_atomic_int *atom, int val) {
     atomic_init(atom, val);
 }
 
+static inline void washdc_atomic_int_store(washdc_atomic_int *atom, int val) {
+    atomic_store(atom, val);
+}
+
 #endif
 
 #ifdef __cplusplus
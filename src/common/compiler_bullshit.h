@@ -27,11 +27,13 @@
 
 #define WASHDC_NORETURN __attribute__((__noreturn__))
 #define WASHDC_UNUSED __attribute__((unused))
+#define WASHDC_THREAD_LOCAL __thread
 
 #elif defined(_MSC_VER)
 
 #define WASHDC_NORETURN __declspec(noreturn)
 #define WASHDC_UNUSED
+#define WASHDC_THREAD_LOCAL __declspec(thread)
 
 #else
 #error unknown compiler
@@ -47,6 +47,8 @@
 
 #include "gdb_stub.hpp"
 
+extern struct washdc_instance *instance;
+
 // uncomment this to log all traffic in/out of the debugger to stdout
 // #define GDBSTUB_VERBOSE
 
@@ -75,9 +77,16 @@ struct gdb_stub {
     struct evbuffer *output_buffer;
 
     // the last unsuccessfully acknowledged packet, or empty if there is none
-    struct string unack_packet;
+    struct evbuffer *unack_packet;
 
-    struct string input_packet;
+    /*
+     * the packet currently being received.  This is an evbuffer instead of a
+     * string because X packets carry raw binary data which may contain zeroes.
+     */
+    struct evbuffer *input_packet;
+
+    // number of checksum characters still expected, or -1 before the '#'
+    int input_csum_rem;
 
     bool frontend_supports_swbreak;
 
@@ -135,19 +144,21 @@ static size_t deserialize_data(struct string const *input_str,
                                void *out, size_t max_sz);
 static int decode_hex(char ch);
 static void do_write(void);
-static void extract_packet(struct string *out, struct string const *packet_in);
 static int set_reg(reg32_t reg_file[SH4_REGISTER_COUNT],
                    unsigned reg_no, reg32_t reg_val);
-static void handle_packet(struct string *pkt);
+static void handle_packet(char const *pkt, size_t pkt_len);
 static void transmit_pkt(struct string const *pkt);
-static bool next_packet(struct string *pkt);
+static void transmit_pkt_bin(void const *pkt, size_t pkt_len);
 
 static void handle_c_packet(struct string *out, struct string *dat);
 static void handle_q_packet(struct string *out, struct string const *dat);
 static void handle_g_packet(struct string *out, struct string const *dat);
 static void handle_m_packet(struct string *out, struct string const *dat);
 static void handle_M_packet(struct string *out, struct string const *dat);
+static void handle_x_packet(struct string const *dat);
+static void handle_X_packet(struct string *out, char const *dat, size_t len);
 static void handle_s_packet(struct string *out, struct string const *dat);
+static void handle_b_packet(struct string *out, struct string const *dat);
 static void handle_G_packet(struct string *out, struct string const *dat);
 static void handle_P_packet(struct string *out, struct string const *dat);
 static void handle_D_packet(struct string *out, struct string const *dat);
@@ -268,8 +279,11 @@ void gdb_init(void) {
     gdb_inform_write_watchpoint_event = event_new(io::event_base, -1, EV_PERSIST,
                                                   on_write_watchpoint_event, NULL);
 
-    string_init(&stub.unack_packet);
-    string_init(&stub.input_packet);
+    stub.unack_packet = evbuffer_new();
+    stub.input_packet = evbuffer_new();
+    if (!stub.unack_packet || !stub.input_packet)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    stub.input_csum_rem = -1;
 
     stub.frontend_supports_swbreak = false;
     stub.listener = NULL;
@@ -318,8 +332,8 @@ void gdb_cleanup(void) {
     if (stub.listener)
         evconnlistener_free(stub.listener);
 
-    string_cleanup(&stub.input_packet);
-    string_cleanup(&stub.unack_packet);
+    evbuffer_free(stub.input_packet);
+    evbuffer_free(stub.unack_packet);
 
     event_free(gdb_inform_write_watchpoint_event);
     event_free(gdb_inform_read_watchpoint_event);
@@ -456,11 +470,23 @@ static void serialize_data(struct string *out, void const *buf,
         'c', 'd', 'e', 'f'
     };
 
+    /*
+     * build the whole thing up in a temporary buffer first because appending
+     * to a string one char at a time is quadratic.
+     */
+    char *txt = (char*)malloc(buf_len * 2 + 1);
+    if (!txt)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
     for (unsigned i = 0; i < buf_len; i++) {
-        string_append_char(out, hex_tbl[(*buf8) >> 4]);
-        string_append_char(out, hex_tbl[(*buf8) & 0xf]);
+        txt[2 * i] = hex_tbl[(*buf8) >> 4];
+        txt[2 * i + 1] = hex_tbl[(*buf8) & 0xf];
         buf8++;
     }
+    txt[buf_len * 2] = '\0';
+
+    string_append(out, txt);
+    free(txt);
 }
 
 static int decode_hex(char ch)
@@ -514,16 +540,6 @@ static void craft_packet(struct string *out, struct string const *in) {
     string_append_char(out, hex_tbl[csum & 0xf]);
 }
 
-static void extract_packet(struct string *out, struct string const *packet_in) {
-    int dollar_idx = string_find_first_of(packet_in, "$");
-    int pound_idx = string_find_last_of(packet_in, "#");
-
-    if (dollar_idx < 0 || pound_idx < 0)
-        return;
-
-    string_substr(out, packet_in, dollar_idx + 1, pound_idx - 1);
-}
-
 static int conv_reg_idx_to_sh4(unsigned reg_no, reg32_t reg_sr) {
     if (reg_no >= R0 && reg_no <= R15)
         return debug_gen_reg_idx(DEBUG_CONTEXT_SH4, reg_no - R0);
@@ -613,6 +629,17 @@ static void handle_q_packet(struct string *out, struct string const *dat_orig) {
     string_copy(&dat, dat_orig);
 
     if (string_eq_n(&dat, "qSupported", 10)) {
+        /*
+         * let gdb send and receive big packets so that large memory
+         * transfers don't get chopped up into thousands of tiny requests.
+         */
+        string_append(out, "PacketSize=");
+        string_append_hex32(out, GDB_PACKET_SIZE);
+        string_append(out, ";binary-upload+;");
+
+        // bs and bc packets, see handle_b_packet
+        string_append(out, "ReverseStep+;ReverseContinue+;");
+
         int semicolon_idx = string_find_first_of(&dat, ";");
 
         if (semicolon_idx == -1)
@@ -697,6 +724,11 @@ static void handle_m_packet(struct string *out, struct string const *dat) {
     string_cleanup(&addr_str);
     string_cleanup(&len_str);
 
+    if (len > GDB_MAX_MEM_XFER) {
+        err_str(out, EINVAL);
+        return;
+    }
+
     void *data_buf = malloc(len);
     if (!data_buf) {
         error_set_length(len);
@@ -743,10 +775,14 @@ static void handle_M_packet(struct string *out, struct string const *dat) {
     struct string new_dat;
     string_init(&new_dat);
     string_substr(&new_dat, dat, dat_idx, string_length(dat) - 1);
-    if (len < 1024) {
+    if (len <= GDB_MAX_MEM_XFER) {
         uint8_t *buf = (uint8_t*)malloc(sizeof(uint8_t) * len);
-        deserialize_data(&new_dat, buf, len);
-        int err = gdb_stub_write_mem(buf, addr, len);
+        if (!buf) {
+            error_set_length(len);
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        }
+        size_t len_actual = deserialize_data(&new_dat, buf, len);
+        int err = len_actual == len ? gdb_stub_write_mem(buf, addr, len) : -1;
         free(buf);
 
         if (err < 0) {
@@ -755,18 +791,196 @@ static void handle_M_packet(struct string *out, struct string const *dat) {
             return;
         }
     } else {
-        error_set_length(len);
-        RAISE_ERROR(ERROR_INVALID_PARAM);
+        err_str(out, EINVAL);
+        string_cleanup(&new_dat);
+        return;
     }
     string_cleanup(&new_dat);
 
     string_set(out, "OK");
 }
 
+/*
+ * parse the "addr,len" part of an x or X packet.  hdr points to the packet's
+ * first character (the x or X) and hdr_len is the number of characters up to
+ * (but not including) the colon, if there is one.
+ */
+static int parse_bin_mem_hdr(char const *hdr, size_t hdr_len,
+                             addr32_t *addr_out, uint32_t *len_out) {
+    char tmp[32];
+
+    if (hdr_len < 4 || hdr_len >= sizeof(tmp))
+        return -1;
+    memcpy(tmp, hdr + 1, hdr_len - 1);
+    tmp[hdr_len - 1] = '\0';
+
+    char *endp;
+    unsigned long addr = strtoul(tmp, &endp, 16);
+    if (endp == tmp || *endp != ',')
+        return -1;
+    char const *len_str = endp + 1;
+    unsigned long len = strtoul(len_str, &endp, 16);
+    if (endp == len_str || *endp != '\0')
+        return -1;
+
+    *addr_out = addr;
+    *len_out = len;
+    return 0;
+}
+
+// characters that have to be escaped in binary packet data
+static bool gdb_bin_needs_escape(uint8_t ch) {
+    return ch == '#' || ch == '$' || ch == '}' || ch == '*';
+}
+
+/*
+ * x addr,len - read memory as binary.  The response is a 'b' followed by the
+ * raw (escaped) memory contents.  This halves the transfer size compared to
+ * the m packet and skips the hex encoding entirely, which makes a real
+ * difference when dumping the whole of main RAM or texture memory.
+ *
+ * This transmits the response itself instead of going through
+ * craft_packet because the data can contain zeroes.
+ */
+static void handle_x_packet(struct string const *dat) {
+    static const char hex_tbl[16] = {
+        '0', '1', '2', '3',
+        '4', '5', '6', '7',
+        '8', '9', 'a', 'b',
+        'c', 'd', 'e', 'f'
+    };
+    addr32_t addr;
+    uint32_t len;
+    struct string err, err_pkt;
+    uint8_t *data_buf = NULL;
+    char *pkt = NULL;
+
+    if (parse_bin_mem_hdr(string_get(dat), string_length(dat),
+                          &addr, &len) != 0 || len > GDB_MAX_MEM_XFER) {
+        goto on_error;
+    }
+
+    data_buf = (uint8_t*)malloc(len ? len : 1);
+
+    /*
+     * worst-case every byte needs to be escaped, plus 5 characters for the
+     * '$', 'b', '#' and the two-character checksum.
+     */
+    pkt = (char*)malloc(2 * (size_t)len + 5);
+    if (!data_buf || !pkt) {
+        error_set_length(len);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    if (len && gdb_stub_read_mem(data_buf, addr, len) < 0)
+        goto on_error;
+
+    {
+        size_t pkt_len = 0;
+        uint8_t csum = 'b';
+
+        pkt[pkt_len++] = '$';
+        pkt[pkt_len++] = 'b';
+        for (uint32_t idx = 0; idx < len; idx++) {
+            uint8_t ch = data_buf[idx];
+            if (gdb_bin_needs_escape(ch)) {
+                pkt[pkt_len++] = '}';
+                csum += '}';
+                ch ^= 0x20;
+            }
+            pkt[pkt_len++] = ch;
+            csum += ch;
+        }
+        pkt[pkt_len++] = '#';
+        pkt[pkt_len++] = hex_tbl[csum >> 4];
+        pkt[pkt_len++] = hex_tbl[csum & 0xf];
+
+        transmit_pkt_bin(pkt, pkt_len);
+    }
+
+    free(pkt);
+    free(data_buf);
+    return;
+
+on_error:
+    free(pkt);
+    free(data_buf);
+
+    string_init(&err);
+    string_init(&err_pkt);
+    err_str(&err, EINVAL);
+    craft_packet(&err_pkt, &err);
+    transmit_pkt(&err_pkt);
+    string_cleanup(&err_pkt);
+    string_cleanup(&err);
+}
+
+/*
+ * X addr,len:XX... - write binary data to memory.  gdb sends an empty X
+ * packet to probe for support before it will use this.
+ */
+static void handle_X_packet(struct string *out, char const *dat, size_t len) {
+    char const *colon = (char const*)memchr(dat, ':', len);
+    addr32_t addr;
+    uint32_t n_bytes;
+
+    if (!colon || parse_bin_mem_hdr(dat, colon - dat, &addr, &n_bytes) != 0 ||
+        n_bytes > GDB_MAX_MEM_XFER) {
+        err_str(out, EINVAL);
+        return;
+    }
+
+    if (!n_bytes) {
+        string_set(out, "OK");
+        return;
+    }
+
+    uint8_t *buf = (uint8_t*)malloc(n_bytes);
+    if (!buf) {
+        error_set_length(n_bytes);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    char const *src = colon + 1;
+    char const *src_end = dat + len;
+    uint32_t n_decoded = 0;
+    while (src < src_end && n_decoded < n_bytes) {
+        uint8_t ch = *src++;
+        if (ch == '}') {
+            if (src >= src_end)
+                break;
+            ch = *src++ ^ 0x20;
+        }
+        buf[n_decoded++] = ch;
+    }
+
+    if (n_decoded != n_bytes || src != src_end ||
+        gdb_stub_write_mem(buf, addr, n_bytes) < 0) {
+        err_str(out, EINVAL);
+    } else {
+        string_set(out, "OK");
+    }
+
+    free(buf);
+}
+
 static void handle_s_packet(struct string *out, struct string const *dat) {
     debug_request_single_step();
 }
 
+/*
+ * bs - reverse-step
+ * bc - reverse-continue
+ *
+ * like s and c, the response is sent later on when the debugger breaks.
+ */
+static void handle_b_packet(struct string *out, struct string const *dat) {
+    if (string_get(dat)[1] == 's')
+        debug_request_reverse_step();
+    else
+        debug_request_reverse_continue();
+}
+
 static void handle_G_packet(struct string *out, struct string const *dat) {
     reg32_t regs[N_REGS];
 
@@ -846,7 +1060,7 @@ static void handle_D_packet(struct string *out, struct string const *dat) {
 }
 
 static void handle_K_packet(struct string *out, struct string const *dat) {
-    washdc_kill();
+    washdc_kill(instance);
 
     string_set(out, "OK");
 }
@@ -1102,7 +1316,11 @@ cleanup:
     string_cleanup(&dat_local);
 }
 
-static void handle_packet(struct string *pkt) {
+/*
+ * pkt is the entire packet, starting with the '$' and ending with the last
+ * checksum character.
+ */
+static void handle_packet(char const *pkt, size_t pkt_len) {
     struct string dat;
     struct string response;
     struct string resp_pkt;
@@ -1111,7 +1329,28 @@ static void handle_packet(struct string *pkt) {
     string_init(&response);
     string_init(&resp_pkt);
 
-    extract_packet(&dat, pkt);
+    if (pkt_len < 4)
+        goto cleanup;
+
+    {
+        // strip off the '$' at the front and the '#' + checksum at the end
+        char const *payload = pkt + 1;
+        size_t payload_len = pkt_len - 4;
+
+        // X packets are binary, so they can't be turned into a string
+        if (payload_len && payload[0] == 'X') {
+            handle_X_packet(&response, payload, payload_len);
+            goto respond;
+        }
+
+        char *txt = (char*)malloc(payload_len + 1);
+        if (!txt)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        memcpy(txt, payload, payload_len);
+        txt[payload_len] = '\0';
+        string_set(&dat, txt);
+        free(txt);
+    }
 
     if (string_length(&dat)) {
         char first_ch = string_get(&dat)[0];
@@ -1125,6 +1364,9 @@ static void handle_packet(struct string *pkt) {
             handle_m_packet(&response, &dat);
         } else if (first_ch == 'M') {
             handle_M_packet(&response, &dat);
+        } else if (first_ch == 'x') {
+            handle_x_packet(&dat);
+            goto cleanup;
         } else if (first_ch == '?') {
             string_set(&response, "S05 create:");
         } else if (first_ch == 's') {
@@ -1133,6 +1375,11 @@ static void handle_packet(struct string *pkt) {
         } else if (first_ch == 'c') {
             handle_c_packet(&response, &dat);
             goto cleanup;
+        } else if (first_ch == 'b' && string_length(&dat) == 2 &&
+                   (string_get(&dat)[1] == 's' ||
+                    string_get(&dat)[1] == 'c')) {
+            handle_b_packet(&response, &dat);
+            goto cleanup;
         } else if (first_ch == 'P') {
             handle_P_packet(&response, &dat);
         } else if (first_ch == 'D') {
@@ -1146,6 +1393,7 @@ static void handle_packet(struct string *pkt) {
         }
     }
 
+respond:
     craft_packet(&resp_pkt, &response);
     transmit_pkt(&resp_pkt);
 
@@ -1160,88 +1408,16 @@ static void transmit_pkt(struct string const *pkt) {
     washdc_log_info(">>>> %s\n", string_get(pkt));
 #endif
 
-    string_copy(&stub.unack_packet, pkt);
-    transmit(pkt);
+    transmit_pkt_bin(string_get(pkt), string_length(pkt));
 }
 
-static bool next_packet(struct string *pkt) {
-    struct string pktbuf_tmp;
-    struct string tmp_str;
-    char ch;
-    bool found_pkt = false;
-
-    string_init(&pktbuf_tmp);
-    string_copy(&pktbuf_tmp, &stub.input_packet);
-
-    // wait around for the start character, ignore all other characters
-    do {
-        if (!string_length(&pktbuf_tmp))
-            goto cleanup;
-
-        ch = string_get(&pktbuf_tmp)[0];
-
-        string_init(&tmp_str);
-        string_substr(&tmp_str, &pktbuf_tmp, 1, string_length(&pktbuf_tmp) - 1);
-        string_cleanup(&pktbuf_tmp);
-        memcpy(&pktbuf_tmp, &tmp_str, sizeof(pktbuf_tmp));
-
-        if (ch == EOF)
-            goto cleanup;
-    } while(ch != '$');
-    string_append_char(pkt, ch);
-
-    // now, read until a # or end of buffer is found
-    do {
-        if (!string_length(&pktbuf_tmp))
-            goto cleanup;
-
-        ch = string_get(&pktbuf_tmp)[0];
-
-        string_init(&tmp_str);
-        string_substr(&tmp_str, &pktbuf_tmp, 1, string_length(&pktbuf_tmp) - 1);
-        string_cleanup(&pktbuf_tmp);
-        memcpy(&pktbuf_tmp, &tmp_str, sizeof(pktbuf_tmp));
-
-        if (ch == EOF)
-            goto cleanup;
-
-        string_append_char(pkt, ch);
-    } while(ch != '#');
-        
-    // read the one-byte (two char) checksum
-    if (!string_length(&pktbuf_tmp))
-            goto cleanup;
-    ch = string_get(&pktbuf_tmp)[0];
-    if (ch == EOF)
-            goto cleanup;
-    string_init(&tmp_str);
-    string_substr(&tmp_str, &pktbuf_tmp, 1, string_length(&pktbuf_tmp) - 1);
-    string_cleanup(&pktbuf_tmp);
-    memcpy(&pktbuf_tmp, &tmp_str, sizeof(pktbuf_tmp));
-    string_append_char(pkt, ch);
-
-    if (!string_length(&pktbuf_tmp))
-            goto cleanup;
-    ch = string_get(&pktbuf_tmp)[0];
-    if (ch == EOF)
-            goto cleanup;
-    string_init(&tmp_str);
-    string_substr(&tmp_str, &pktbuf_tmp, 1, string_length(&pktbuf_tmp) - 1);
-    string_cleanup(&pktbuf_tmp);
-    memcpy(&pktbuf_tmp, &tmp_str, sizeof(pktbuf_tmp));
-    string_append_char(pkt, ch);
-
-    string_set(&stub.input_packet, string_get(&pktbuf_tmp));
-
-#ifdef GDBSTUB_VERBOSE
-    washdc_log_info("<<<< %s\n", string_get(pkt));
-#endif
-
-    found_pkt = true;
-
-cleanup:
-    string_cleanup(&pktbuf_tmp);
-    return found_pkt;
+static void transmit_pkt_bin(void const *pkt, size_t pkt_len) {
+    evbuffer_drain(stub.unack_packet, evbuffer_get_length(stub.unack_packet));
+    if (evbuffer_add(stub.unack_packet, pkt, pkt_len) < 0 ||
+        evbuffer_add(stub.output_buffer, pkt, pkt_len) < 0) {
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+    do_write();
 }
 
 /*
@@ -1306,7 +1482,7 @@ static void handle_events(struct bufferevent *bev, short events, void *arg) {
     }
     std::cerr << __func__ << " called: \"" << ev_type << "\" (" << events
               << ") event received; calling washdc_kill" << std::endl;
-    washdc_kill();
+    washdc_kill(instance);
 }
 
 static void handle_read(struct bufferevent *bev, void *arg) {
@@ -1319,30 +1495,36 @@ static void handle_read(struct bufferevent *bev, void *arg) {
 
     bufferevent_read_buffer(bev, read_buffer);
     size_t buflen = evbuffer_get_length(read_buffer);
+    uint8_t const *readp = evbuffer_pullup(read_buffer, -1);
 
     for (unsigned i = 0; i < buflen; i++) {
-        uint8_t tmp;
-        if (evbuffer_remove(read_buffer, &tmp, sizeof(tmp)) < 0)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-        char c = tmp;
+        char c = readp[i];
 
-        if (string_length(&stub.input_packet)) {
+        if (evbuffer_get_length(stub.input_packet)) {
 
-            if (string_length(&stub.unack_packet)) {
+            if (evbuffer_get_length(stub.unack_packet)) {
                 washdc_log_warn("WARNING: new packet incoming; no "
                                 "acknowledgement was ever received for "
-                                "\"%s\"\n", string_get(&stub.unack_packet));
-                string_set(&stub.unack_packet, "");
+                                "the last packet sent\n");
+                evbuffer_drain(stub.unack_packet,
+                               evbuffer_get_length(stub.unack_packet));
             }
 
-            string_append_char(&stub.input_packet, c);
+            if (evbuffer_add(stub.input_packet, &c, sizeof(c)) < 0)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
 
-            struct string pkt;
-            string_init(&pkt);
-            bool pkt_valid = next_packet(&pkt);
-            if (string_length(&pkt) && pkt_valid) {
-                string_set(&stub.input_packet, "");
+            /*
+             * binary data in X packets always has '#' escaped, so the first
+             * '#' marks the end of the packet data.  After that there's a
+             * two-character checksum.
+             */
+            if (stub.input_csum_rem < 0) {
+                if (c == '#')
+                    stub.input_csum_rem = 2;
+            } else if (--stub.input_csum_rem == 0) {
+                size_t pkt_len = evbuffer_get_length(stub.input_packet);
+                char const *pkt =
+                    (char const*)evbuffer_pullup(stub.input_packet, -1);
 
                 // TODO: verify the checksum
 
@@ -1353,36 +1535,41 @@ static void handle_read(struct bufferevent *bev, void *arg) {
                 string_init_txt(&plus_symbol, "+");
                 transmit(&plus_symbol);
                 string_cleanup(&plus_symbol);
-                handle_packet(&pkt);
-            }
+                handle_packet(pkt, pkt_len);
 
-            string_cleanup(&pkt);
+                evbuffer_drain(stub.input_packet, pkt_len);
+                stub.input_csum_rem = -1;
+            }
         } else {
             if (c == '+') {
 #ifdef GDBSTUB_VERBOSE
                 washdc_log_info("<<<< +\n");
 #endif
-                if (!string_length(&stub.unack_packet))
+                if (!evbuffer_get_length(stub.unack_packet))
                     washdc_log_warn("WARNING: received acknowledgement for "
                                     "unsent packet\n");
-                string_set(&stub.unack_packet, "");
+                evbuffer_drain(stub.unack_packet,
+                               evbuffer_get_length(stub.unack_packet));
             } else if (c == '-') {
 #ifdef GDBSTUB_VERBOSE
                 washdc_log_info("<<<< -\n");
 #endif
-                if (!string_length(&stub.unack_packet)) {
+                size_t unack_len = evbuffer_get_length(stub.unack_packet);
+                if (!unack_len) {
                     washdc_log_warn("WARNING: received negative "
                                     "acknowledgement for unsent packet\n");
                 } else {
-#ifdef GDBSTUB_VERBOSE
-                    washdc_log_info(">>>> %s\n",
-                                    string_get(&stub.unack_packet));
-#endif
-                    transmit(&stub.unack_packet);
+                    void const *unack =
+                        evbuffer_pullup(stub.unack_packet, -1);
+                    if (evbuffer_add(stub.output_buffer, unack, unack_len) < 0)
+                        RAISE_ERROR(ERROR_FAILED_ALLOC);
+                    do_write();
                 }
             } else if (c == '$') {
                 // new packet
-                string_set(&stub.input_packet, "$");
+                if (evbuffer_add(stub.input_packet, &c, sizeof(c)) < 0)
+                    RAISE_ERROR(ERROR_FAILED_ALLOC);
+                stub.input_csum_rem = -1;
             } else if (c == 3) {
                 // user pressed ctrl+c (^C) on the gdb frontend
                 washdc_log_info("GDBSTUB: user requested breakpoint "
@@ -1396,6 +1583,8 @@ static void handle_read(struct bufferevent *bev, void *arg) {
     }
 
     gdb_stub_unlock();
+
+    evbuffer_free(read_buffer);
 }
 
 static void gdb_stub_lock(void) {
@@ -1669,6 +1858,7 @@ static void deferred_cmd_exec(struct deferred_cmd *cmd) {
     deferred_cmd_lock();
 
     deferred_cmd_push_nolock(cmd);
+    debug_signal();
 
     while (cmd->status == DEFERRED_CMD_IN_PROGRESS)
         deferred_cmd_wait();
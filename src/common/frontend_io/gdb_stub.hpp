@@ -43,6 +43,18 @@
 // it's 'cause 1999 is the year the Dreamcast came out in America
 #define GDB_PORT_NO 1999
 
+/*
+ * largest packet we advertise to gdb in the qSupported response.  gdb breaks
+ * up large memory transfers into packets no bigger than this.
+ */
+#define GDB_PACKET_SIZE (256 * 1024)
+
+/*
+ * largest single memory transfer the stub will service.  This is big enough to
+ * dump all of main system memory in a single request.
+ */
+#define GDB_MAX_MEM_XFER (16 * 1024 * 1024)
+
 // see sh_sh4_register_name in gdb/sh-tdep.c in the gdb source code
 enum gdb_reg_order {
     R0, R1, R2, R3, R4, R5, R6, R7,
@@ -45,6 +45,8 @@
 #include "serial_server.hpp"
 #endif
 
+extern struct washdc_instance *instance;
+
 #ifndef USE_LIBEVENT
 #error this file should not be built with USE_LIBEVENT disabled!
 #endif
@@ -135,7 +137,7 @@ static void io_main(void *arg) {
 
     int const evflags = EVLOOP_NO_EXIT_ON_EMPTY;
     while (event_base_loop(event_base, evflags) >= 0) {
-        if (!washdc_is_running())
+        if (!washdc_is_running(instance))
             break;
 
         alive = false;
@@ -163,7 +165,7 @@ static void io_main(void *arg) {
 }
 
 static void work_callback(evutil_socket_t fd, short ev, void *arg) {
-    if (!washdc_is_running())
+    if (!washdc_is_running(instance))
         event_base_loopbreak(event_base);
 
 #ifdef ENABLE_TCP_SERIAL
@@ -43,6 +43,8 @@
 
 #include "serial_server.hpp"
 
+extern struct washdc_instance *instance;
+
 static struct serial_server {
     struct evconnlistener *listener;
     struct bufferevent *bev;
@@ -230,7 +232,7 @@ static void handle_events(struct bufferevent *bev, short events, void *arg) {
     if (events != BEV_EVENT_EOF) {
         std::cerr << __func__ << " called: \"" << ev_type << "\" (" << events
                   << ") event received; calling washdc_kill" << std::endl;
-        washdc_kill();
+        washdc_kill(instance);
     } else {
         std::cerr << __func__ << " called - EOF received" << std::endl;
         bufferevent_free(srv.bev);
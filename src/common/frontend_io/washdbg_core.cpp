@@ -33,12 +33,15 @@
 #include "washdc/debugger.h"
 #include "washdc/hw/arm7/arm7_reg_idx.h"
 #include "washdc/error.h"
+#include "washdc/hostfile.h"
 #include "washdc/washdc.h"
 #include "washdbg_tcp.hpp"
 #include "compiler_bullshit.h"
 
 #include "washdbg_core.hpp"
 
+extern struct washdc_instance *instance;
+
 #ifndef USE_LIBEVENT
 #error this file should not be built with USE_LIBEVENT disabled!
 #endif
@@ -51,6 +54,12 @@
 static char in_buf[BUF_LEN];
 static unsigned in_buf_pos;
 
+/*
+ * set whenever washdbg_core_run_once prints something or consumes a line of
+ * input, so it knows whether calling it again right away would do anything.
+ */
+static bool made_progress;
+
 static csh capstone_handle;
 static bool capstone_avail;
 
@@ -130,6 +139,9 @@ enum washdbg_state {
     WASHDBG_STATE_CMD_ASID,
     WASHDBG_STAT_CMD_AT_MODE,
     WASHDBG_STATE_CMD_AT_MODE,
+    WASHDBG_STATE_CMD_MEMXFER,
+    WASHDBG_STATE_CMD_PROFILE,
+    WASHDBG_STATE_CMD_PERF,
 
     // permanently stop accepting commands because we're about to disconnect.
     WASHDBG_STATE_CMD_EXIT
@@ -174,7 +186,7 @@ static bool washdbg_is_continue_cmd(char const *cmd) {
 
 void washdbg_do_exit(int argc, char **argv) {
     std::cout << "User requested exit via WashDbg" << std::endl;
-    washdc_kill();
+    washdc_kill(instance);
     cur_state = WASHDBG_STATE_CMD_EXIT;
 }
 
@@ -202,6 +214,28 @@ static void washdbg_do_step(int argc, char **argv) {
     debug_request_single_step();
 }
 
+static bool washdbg_is_reverse_step_cmd(char const *cmd) {
+    return strcmp(cmd, "rs") == 0 ||
+        strcmp(cmd, "reverse-step") == 0;
+}
+
+static void washdbg_do_reverse_step(int argc, char **argv) {
+    std::cout << "WashDbg reverse-step requested" << std::endl;
+    cur_state = WASHDBG_STATE_RUNNING;
+    debug_request_reverse_step();
+}
+
+static bool washdbg_is_reverse_continue_cmd(char const *cmd) {
+    return strcmp(cmd, "rc") == 0 ||
+        strcmp(cmd, "reverse-continue") == 0;
+}
+
+static void washdbg_do_reverse_continue(int argc, char **argv) {
+    std::cout << "WashDbg reverse-continue requested" << std::endl;
+    cur_state = WASHDBG_STATE_RUNNING;
+    debug_request_reverse_continue();
+}
+
 struct print_banner_state {
     struct washdbg_txt_state txt;
 } print_banner_state;
@@ -239,16 +273,22 @@ void washdbg_do_help(int argc, char **argv) {
         "bplist       - list all breakpoints\n"
         "bpset <addr> - set a breakpoint\n"
         "continue     - continue execution when suspended.\n"
+        "dump         - save a block of memory to a file (dump <addr> <len> <file>)\n"
         "echo         - echo back text\n"
         "exit         - exit the debugger and close WashingtonDC\n"
         "help         - display this message\n"
+        "load         - copy a file into memory (load <addr> <file>)\n"
 #ifdef ENABLE_DBG_COND
         "memwatch     - watch a specific memory address for a specific value\n"
 #endif
+        "perf         - show host time per subsystem for the last frame\n"
         "print        - print a value\n"
+        "profile      - show the n hottest JIT blocks, or clear samples\n"
+        "rc           - reverse-continue to the last breakpoint that was hit\n"
 #ifdef ENABLE_DBG_COND
         "regwatch     - watch for a register to be set to a given value\n"
 #endif
+        "rs           - reverse-step to the previous instruction\n"
         "step         - single-step\n"
 #ifdef ENABLE_MMU
         "trans_itlb   - translate pointer using ITLB or UTLB\n"
@@ -1084,7 +1124,330 @@ static void washdbg_at_mode(int argc, char **argv) {
 #endif
 }
 
+#define WASHDBG_MEMXFER_STR_LEN 256
+
+// largest block the dump and load commands will transfer in one go
+#define WASHDBG_MEMXFER_MAX (16 * 1024 * 1024)
+
+static struct memxfer_state {
+    char msg[WASHDBG_MEMXFER_STR_LEN];
+    struct washdbg_txt_state txt;
+} memxfer_state;
+
+static bool washdbg_is_dump_cmd(char const *str) {
+    return strcmp(str, "dump") == 0;
+}
+
+/*
+ * dump <addr> <len> <file>
+ *
+ * The whole block is read with a single debug_read_mem call so that
+ * large regions like main RAM or texture memory get copied in one shot.
+ */
+static void washdbg_dump(int argc, char **argv) {
+    unsigned addr, len;
+    enum dbg_context_id ctx, len_ctx;
+
+    if (argc != 4) {
+        washdbg_print_error("usage: dump <addr> <len> <file>\n");
+        return;
+    }
+
+    if (eval_expression(argv[1], &ctx, &addr) != 0 ||
+        eval_expression(argv[2], &len_ctx, &len) != 0)
+        return;
+
+    if (!len || len > WASHDBG_MEMXFER_MAX) {
+        washdbg_print_error("invalid length\n");
+        return;
+    }
+
+    void *dat = malloc(len);
+    if (!dat) {
+        washdbg_print_error("failed allocation\n");
+        return;
+    }
+
+    if (debug_read_mem(ctx, dat, addr, len) != 0) {
+        washdbg_print_error("failed to read memory\n");
+        goto cleanup;
+    }
+
+    {
+        washdc_hostfile fp =
+            washdc_hostfile_open(argv[3], (enum washdc_hostfile_mode)
+                                 (WASHDC_HOSTFILE_WRITE |
+                                  WASHDC_HOSTFILE_BINARY));
+        if (fp == WASHDC_HOSTFILE_INVALID) {
+            washdbg_print_error("unable to open file\n");
+            goto cleanup;
+        }
+        size_t n_written = washdc_hostfile_write(fp, dat, len);
+        washdc_hostfile_close(fp);
+
+        if (n_written != len) {
+            washdbg_print_error("failed to write file\n");
+            goto cleanup;
+        }
+    }
+
+    snprintf(memxfer_state.msg, sizeof(memxfer_state.msg),
+             "dumped %u bytes from 0x%08x to %s\n", len, addr, argv[3]);
+    memxfer_state.msg[WASHDBG_MEMXFER_STR_LEN - 1] = '\0';
+    memxfer_state.txt.txt = memxfer_state.msg;
+    memxfer_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_MEMXFER;
+
+cleanup:
+    free(dat);
+}
+
+static bool washdbg_is_load_cmd(char const *str) {
+    return strcmp(str, "load") == 0;
+}
+
+// load <addr> <file>
+static void washdbg_load(int argc, char **argv) {
+    unsigned addr;
+    enum dbg_context_id ctx;
+    void *dat = NULL;
+    long len;
+
+    if (argc != 3) {
+        washdbg_print_error("usage: load <addr> <file>\n");
+        return;
+    }
+
+    if (eval_expression(argv[1], &ctx, &addr) != 0)
+        return;
+
+    washdc_hostfile fp =
+        washdc_hostfile_open(argv[2], (enum washdc_hostfile_mode)
+                             (WASHDC_HOSTFILE_READ | WASHDC_HOSTFILE_BINARY));
+    if (fp == WASHDC_HOSTFILE_INVALID) {
+        washdbg_print_error("unable to open file\n");
+        return;
+    }
+
+    if (washdc_hostfile_seek(fp, 0, WASHDC_HOSTFILE_SEEK_END) != 0 ||
+        (len = washdc_hostfile_tell(fp)) < 0 ||
+        washdc_hostfile_seek(fp, 0, WASHDC_HOSTFILE_SEEK_BEG) != 0) {
+        washdbg_print_error("unable to determine file length\n");
+        goto cleanup;
+    }
+
+    if (!len || len > WASHDBG_MEMXFER_MAX) {
+        washdbg_print_error("invalid file length\n");
+        goto cleanup;
+    }
+
+    dat = malloc(len);
+    if (!dat) {
+        washdbg_print_error("failed allocation\n");
+        goto cleanup;
+    }
+
+    if (washdc_hostfile_read(fp, dat, len) != (size_t)len) {
+        washdbg_print_error("failed to read file\n");
+        goto cleanup;
+    }
+
+    if (debug_write_mem(ctx, dat, addr, len) != 0) {
+        washdbg_print_error("failed to write memory\n");
+        goto cleanup;
+    }
+
+    snprintf(memxfer_state.msg, sizeof(memxfer_state.msg),
+             "loaded %u bytes from %s to 0x%08x\n",
+             (unsigned)len, argv[2], addr);
+    memxfer_state.msg[WASHDBG_MEMXFER_STR_LEN - 1] = '\0';
+    memxfer_state.txt.txt = memxfer_state.msg;
+    memxfer_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_MEMXFER;
+
+cleanup:
+    free(dat);
+    washdc_hostfile_close(fp);
+}
+
+#define WASHDBG_PROFILE_DEFAULT_BLOCKS 16
+#define WASHDBG_PROFILE_MAX_BLOCKS 64
+#define WASHDBG_PROFILE_LINE_LEN 96
+#define WASHDBG_PROFILE_STR_LEN \
+    ((WASHDBG_PROFILE_MAX_BLOCKS + 3) * WASHDBG_PROFILE_LINE_LEN)
+
+static struct profile_state {
+    char msg[WASHDBG_PROFILE_STR_LEN];
+    struct washdbg_txt_state txt;
+} profile_state;
+
+static bool washdbg_is_profile_cmd(char const *str) {
+    return strcmp(str, "profile") == 0;
+}
+
+static double washdbg_profile_pct(unsigned long long part,
+                                  unsigned long long total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+/*
+ * profile [n]
+ * profile reset
+ *
+ * shows the n blocks which got the most samples from the JIT's sampling
+ * profiler, along with the static cycle count, IL instruction count and number
+ * of interpreter fallbacks in each block and how many times it got compiled.
+ */
+static void washdbg_profile(int argc, char **argv) {
+    unsigned n_blocks = WASHDBG_PROFILE_DEFAULT_BLOCKS;
+
+    if (!washdc_jit_sample_enabled(instance)) {
+        washdbg_print_error("the JIT sampling profiler is not enabled; set "
+                            "wash.jit.sample.enable in the config file\n");
+        return;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        washdc_jit_sample_reset(instance);
+        snprintf(profile_state.msg, sizeof(profile_state.msg),
+                 "JIT profile samples cleared\n");
+        goto print_msg;
+    } else if (argc == 2) {
+        if (!is_dec_str(argv[1]) || !parse_dec_str(argv[1])) {
+            washdbg_print_error("usage: profile [n|reset]\n");
+            return;
+        }
+        n_blocks = parse_dec_str(argv[1]);
+        if (n_blocks > WASHDBG_PROFILE_MAX_BLOCKS)
+            n_blocks = WASHDBG_PROFILE_MAX_BLOCKS;
+    } else if (argc != 1) {
+        washdbg_print_error("usage: profile [n|reset]\n");
+        return;
+    }
+
+    {
+        struct washdc_jit_sample_blk blks[WASHDBG_PROFILE_MAX_BLOCKS];
+        struct washdc_jit_sample_stat stat;
+        n_blocks = washdc_jit_sample_top(instance, blks, n_blocks, &stat);
+
+        size_t pos = 0;
+        unsigned long long n_in_blocks =
+            stat.n_samples - stat.n_outside - stat.n_compiling;
+        pos += snprintf(profile_state.msg + pos,
+                        sizeof(profile_state.msg) - pos,
+                        "%llu samples: %.1f%% in %u blocks, %.1f%% outside "
+                        "JIT code, %.1f%% compiling\n", stat.n_samples,
+                        washdbg_profile_pct(n_in_blocks, stat.n_samples),
+                        stat.n_blocks,
+                        washdbg_profile_pct(stat.n_outside, stat.n_samples),
+                        washdbg_profile_pct(stat.n_compiling, stat.n_samples));
+        pos += snprintf(profile_state.msg + pos,
+                        sizeof(profile_state.msg) - pos,
+                        "address     samples       %%  cycles  IL  "
+                        "fallbacks  compiles\n");
+
+        unsigned idx;
+        for (idx = 0; idx < n_blocks; idx++) {
+            struct washdc_jit_sample_blk const *blk = blks + idx;
+            pos += snprintf(profile_state.msg + pos,
+                            sizeof(profile_state.msg) - pos,
+                            "0x%08x %10llu %6.2f %7u %3u %10u %9u\n",
+                            (unsigned)blk->addr, blk->n_samples,
+                            washdbg_profile_pct(blk->n_samples,
+                                                stat.n_samples),
+                            blk->cycle_count, blk->n_il_insts,
+                            blk->n_fallbacks, blk->n_compiles);
+        }
+    }
+
+print_msg:
+    profile_state.msg[WASHDBG_PROFILE_STR_LEN - 1] = '\0';
+    profile_state.txt.txt = profile_state.msg;
+    profile_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_PROFILE;
+}
+
+#define WASHDBG_PERF_STR_LEN ((WASHDC_PERF_CAT_COUNT + 4) * 80)
+
+static struct perf_state {
+    char msg[WASHDBG_PERF_STR_LEN];
+    struct washdbg_txt_state txt;
+} perf_state;
+
+static bool washdbg_is_perf_cmd(char const *str) {
+    return strcmp(str, "perf") == 0;
+}
+
+/*
+ * perf
+ * perf on|off
+ *
+ * shows how much host time each subsystem took during the last frame that the
+ * perf counters were on for.  The counters only get updated at the end of a
+ * frame, so after turning them on the emulator has to run for a frame before
+ * there's anything to show.
+ */
+static void washdbg_perf(int argc, char **argv) {
+    // in the same order as enum washdc_perf_cat
+    static char const *const cat_names[WASHDC_PERF_CAT_COUNT] = {
+        "sh4", "arm7", "aica", "ta", "render", "tex_upload",
+        "jit_compile", "gdrom", "other"
+    };
+
+    if (argc == 2 && (strcmp(argv[1], "on") == 0 ||
+                      strcmp(argv[1], "off") == 0)) {
+        bool en = strcmp(argv[1], "on") == 0;
+        washdc_set_perf_counters(instance, en);
+        snprintf(perf_state.msg, sizeof(perf_state.msg),
+                 "perf counters will be %s at the end of the next frame\n",
+                 en ? "enabled" : "disabled");
+        goto print_msg;
+    } else if (argc != 1) {
+        washdbg_print_error("usage: perf [on|off]\n");
+        return;
+    }
+
+    {
+        struct washdc_perf_counters perf;
+        if (!washdc_get_perf_counters(instance, &perf)) {
+            washdbg_print_error("no frames have been counted yet; use "
+                                "\"perf on\" and let the emulator run\n");
+            return;
+        }
+
+        size_t pos = 0;
+        double total = perf.host_ns ? perf.host_ns : 1.0;
+        pos += snprintf(perf_state.msg + pos, sizeof(perf_state.msg) - pos,
+                        "frame %u: %llu ns host, %llu ns emulated, %llu code "
+                        "cache misses\n", perf.frame_no,
+                        (unsigned long long)perf.host_ns,
+                        (unsigned long long)perf.virt_ns,
+                        perf.code_cache_misses);
+        pos += snprintf(perf_state.msg + pos, sizeof(perf_state.msg) - pos,
+                        "category            ns       %%    calls\n");
+
+        unsigned cat;
+        for (cat = 0; cat < WASHDC_PERF_CAT_COUNT; cat++) {
+            pos += snprintf(perf_state.msg + pos,
+                            sizeof(perf_state.msg) - pos,
+                            "%-12s %11llu %7.2f %8u\n", cat_names[cat],
+                            (unsigned long long)perf.cat_ns[cat],
+                            100.0 * perf.cat_ns[cat] / total,
+                            perf.cat_count[cat]);
+        }
+    }
+
+print_msg:
+    perf_state.msg[WASHDBG_PERF_STR_LEN - 1] = '\0';
+    perf_state.txt.txt = perf_state.msg;
+    perf_state.txt.pos = 0;
+    cur_state = WASHDBG_STATE_CMD_PERF;
+}
+
 void washdbg_core_run_once(void) {
+    enum washdbg_state old_state = cur_state;
+    made_progress = false;
+
     switch (cur_state) {
     case WASHDBG_STATE_BANNER:
         if (washdbg_print_buffer(&print_banner_state.txt) == 0)
@@ -1156,9 +1519,32 @@ void washdbg_core_run_once(void) {
         if (washdbg_print_buffer(&at_mode_state.txt) == 0)
             washdbg_print_prompt();
         break;
+    case WASHDBG_STATE_CMD_MEMXFER:
+        if (washdbg_print_buffer(&memxfer_state.txt) == 0)
+            washdbg_print_prompt();
+        break;
+    case WASHDBG_STATE_CMD_PROFILE:
+        if (washdbg_print_buffer(&profile_state.txt) == 0)
+            washdbg_print_prompt();
+        break;
+    case WASHDBG_STATE_CMD_PERF:
+        if (washdbg_print_buffer(&perf_state.txt) == 0)
+            washdbg_print_prompt();
+        break;
     default:
         break;
     }
+
+    /*
+     * most states take more than one call to finish, so have the emulation
+     * thread come right back if this call got anything done.  If it didn't
+     * (for example because the tx ring is full) then the io thread will wake
+     * the emulation thread up when there's room or new input.
+     */
+    if (cur_state != WASHDBG_STATE_RUNNING &&
+        cur_state != WASHDBG_STATE_CMD_EXIT &&
+        (made_progress || cur_state != old_state))
+        debug_signal();
 }
 
 void washdbg_core_on_break(enum dbg_context_id id, void *argptr) {
@@ -1185,6 +1571,7 @@ static void washdbg_process_input(void) {
 
         memset(cur_line, 0, sizeof(cur_line));
         memcpy(cur_line, in_buf, newline_idx);
+        made_progress = true;
 
         if (newline_idx < (BUF_LEN - 1)) {
             size_t chars_to_move = BUF_LEN - newline_idx - 1;
@@ -1248,6 +1635,10 @@ static void washdbg_process_input(void) {
                 washdbg_x(argc, argv);
             } else if (washdbg_is_step_cmd(cmd)) {
                 washdbg_do_step(argc, argv);
+            } else if (washdbg_is_reverse_step_cmd(cmd)) {
+                washdbg_do_reverse_step(argc, argv);
+            } else if (washdbg_is_reverse_continue_cmd(cmd)) {
+                washdbg_do_reverse_continue(argc, argv);
             } else if (washdbg_is_bpset_cmd(cmd)) {
                 washdbg_bpset(argc, argv);
             } else if (washdbg_is_bplist_cmd(cmd)) {
@@ -1272,6 +1663,14 @@ static void washdbg_process_input(void) {
                 washdbg_asid(argc, argv);
             } else if (washdbg_is_at_mode_cmd(cmd)) {
                 washdbg_at_mode(argc, argv);
+            } else if (washdbg_is_dump_cmd(cmd)) {
+                washdbg_dump(argc, argv);
+            } else if (washdbg_is_load_cmd(cmd)) {
+                washdbg_load(argc, argv);
+            } else if (washdbg_is_profile_cmd(cmd)) {
+                washdbg_profile(argc, argv);
+            } else if (washdbg_is_perf_cmd(cmd)) {
+                washdbg_perf(argc, argv);
             } else {
                 washdbg_bad_input(cmd);
             }
@@ -1287,7 +1686,10 @@ cleanup_args:
 }
 
 static int washdbg_puts(char const *txt) {
-    return washdbg_tcp_puts(txt);
+    int n_chars = washdbg_tcp_puts(txt);
+    if (n_chars)
+        made_progress = true;
+    return n_chars;
 }
 
 static void washdbg_state_echo_process(void) {
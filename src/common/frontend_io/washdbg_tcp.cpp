@@ -41,6 +41,8 @@
 
 #include "washdbg_tcp.hpp"
 
+extern struct washdc_instance *instance;
+
 #ifndef USE_LIBEVENT
 #error this file should not be built with USE_LIBEVENT disabled!
 #endif
@@ -201,7 +203,9 @@ static void drain_tx(void) {
         have_extra_char = false;
     }
 
+    bool drained = false;
     while (tx_ring.consume(&ch)) {
+        drained = true;
         if (evbuffer_add(outbound_buf, &ch, sizeof(ch)) < 0) {
             extra_char = ch;
             have_extra_char = true;
@@ -210,6 +214,13 @@ static void drain_tx(void) {
     }
 
     bufferevent_write_buffer(bev, outbound_buf);
+
+    /*
+     * washdbg_core stops asking to be run when the tx ring is full, so let it
+     * know that there's room again.
+     */
+    if (drained)
+        debug_signal();
 }
 
 static void washdbg_run_once(void *argptr) {
@@ -322,7 +333,7 @@ static void handle_events(struct bufferevent *bev, short events, void *arg) {
     }
     std::cerr << __func__ << " called: \"" << ev_type << "\" (" << events
               << ") event received; calling washdc_kill" << std::endl;
-    washdc_kill();
+    washdc_kill(instance);
 }
 
 // dat should *not* be null-terminated
@@ -333,6 +344,7 @@ static void dump_to_rx_ring(char const *dat, unsigned n_chars) {
             debug_request_break();
         else
             rx_ring.produce(dat[idx]);
+    debug_signal();
 }
 
 // libevent callback for when the socket has data for us to read
@@ -25,6 +25,7 @@
 #include "dreamcast.h"
 #include "washdc/error.h"
 #include "mem_code.h"
+#include "trace.h"
 
 #include "washdc/MemoryMap.h"
 
@@ -54,7 +55,12 @@ void memory_map_cleanup(struct memory_map *map) {
                                                                         \
                 CHECK_R_WATCHPOINT(addr, type);                         \
                                                                         \
-                return intf->read##type_postfix(addr & mask, ctxt);     \
+                type val = intf->read##type_postfix(addr & mask, ctxt); \
+                if (reg->id == MEMORY_MAP_REGION_MMIO) {                \
+                    TRACE_MMIO(map, region_no, addr, &val,              \
+                               sizeof(val), false);                     \
+                }                                                       \
+                return val;                                             \
             }                                                           \
         }                                                               \
                                                                         \
@@ -127,6 +133,10 @@ MEMORY_MAP_TRY_READ_TMPL(double, double)
                                                                         \
                 CHECK_W_WATCHPOINT(addr, type);                         \
                                                                         \
+                if (reg->id == MEMORY_MAP_REGION_MMIO) {                \
+                    TRACE_MMIO(map, region_no, addr, &val,              \
+                               sizeof(val), true);                      \
+                }                                                       \
                 intf->write##type_postfix(addr & mask, val, ctxt);      \
                 return;                                                 \
             }                                                           \
@@ -182,6 +192,42 @@ MEM_MAP_TRY_WRITE_TMPL(uint32_t, 32)
 MEM_MAP_TRY_WRITE_TMPL(float, float)
 MEM_MAP_TRY_WRITE_TMPL(double, double)
 
+static struct memory_map_region *
+memory_map_raw_region(struct memory_map *map, uint32_t addr, unsigned len) {
+    if (!len)
+        return NULL;
+
+    struct memory_map_region *reg = memory_map_get_region(map, addr, len);
+    if (!reg)
+        return NULL;
+
+    // make sure the block doesn't wrap around the region's mask
+    uint32_t first_masked = addr & reg->mask;
+    uint32_t last_masked = (addr + (len - 1)) & reg->mask;
+    if (last_masked < first_masked || last_masked - first_masked != len - 1)
+        return NULL;
+
+    return reg;
+}
+
+int
+memory_map_try_read_raw(struct memory_map *map, uint32_t addr,
+                        void *buf, unsigned len) {
+    struct memory_map_region *reg = memory_map_raw_region(map, addr, len);
+    if (!reg || !reg->intf->read_raw)
+        return 1;
+    return reg->intf->read_raw(addr & reg->mask, buf, len, reg->ctxt);
+}
+
+int
+memory_map_try_write_raw(struct memory_map *map, uint32_t addr,
+                         void const *buf, unsigned len) {
+    struct memory_map_region *reg = memory_map_raw_region(map, addr, len);
+    if (!reg || !reg->intf->write_raw)
+        return 1;
+    return reg->intf->write_raw(addr & reg->mask, buf, len, reg->ctxt);
+}
+
 void
 memory_map_add(struct memory_map *map,
                uint32_t addr_first,
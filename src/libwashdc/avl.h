@@ -46,8 +46,9 @@ struct avl_node {
 
 struct avl_node;
 
-typedef struct avl_node*(*avl_node_ctor)(avl_key_type);
-typedef void(*avl_node_dtor)(struct avl_node*);
+// arg is whatever was given to avl_init
+typedef struct avl_node*(*avl_node_ctor)(avl_key_type, void *arg);
+typedef void(*avl_node_dtor)(struct avl_node*, void *arg);
 
 struct avl_tree {
     struct avl_node *root;
@@ -59,13 +60,16 @@ struct avl_tree {
      */
     avl_node_ctor ctor;
     avl_node_dtor dtor;
+    void *arg;
 };
 
 static inline void
-avl_init(struct avl_tree *tree, avl_node_ctor ctor, avl_node_dtor dtor) {
+avl_init(struct avl_tree *tree, avl_node_ctor ctor, avl_node_dtor dtor,
+         void *arg) {
     memset(tree, 0, sizeof(*tree));
     tree->ctor = ctor;
     tree->dtor = dtor;
+    tree->arg = arg;
 }
 
 static inline void
@@ -75,7 +79,7 @@ avl_clear_node(struct avl_tree *tree, struct avl_node *node) {
             avl_clear_node(tree, node->left);
         if (node->right)
             avl_clear_node(tree, node->right);
-        tree->dtor(node);
+        tree->dtor(node, tree->arg);
     }
 }
 
@@ -208,7 +212,7 @@ static void avl_rot_left(struct avl_tree *tree, struct avl_node *old_root) {
 static inline struct avl_node *
 avl_basic_insert(struct avl_tree *tree, struct avl_node **node_p,
                  struct avl_node *parent, avl_key_type key) {
-    struct avl_node *new_node = tree->ctor(key);
+    struct avl_node *new_node = tree->ctor(key, tree->arg);
     if (!new_node)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
     *node_p = new_node;
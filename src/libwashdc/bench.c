@@ -0,0 +1,563 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "real_ticks.h"
+#include "compiler_bullshit.h"
+#include "threading.h"
+#include "config.h"
+#include "log.h"
+#include "dreamcast.h"
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "washdc/washdc.h"
+
+#include "bench.h"
+
+/*
+ * time is measured with the TSC where there is one, because bench_push and
+ * bench_pop can happen thousands of times per frame.  It gets converted to
+ * nanoseconds once per frame by comparing it against the real-time clock.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || \
+    defined(__i386__) || defined(_M_IX86)
+#define BENCH_HAVE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#define BENCH_STACK_DEPTH 16
+
+struct bench_frame {
+    uint64_t host_ns;
+    uint64_t cat_ns[BENCH_CAT_COUNT];
+    unsigned cat_count[BENCH_CAT_COUNT];
+    dc_cycle_stamp_t virt_cycles;
+    unsigned long long cache_misses;
+
+    /*
+     * poly_count is for the most recently rendered frame, everything else is
+     * how much the counter went up during this frame.
+     */
+    struct washdc_pvr2_stat pvr2;
+};
+
+washdc_atomic_int bench_enabled;
+
+/*
+ * set from any thread by bench_set_live.  The emulation thread only looks at
+ * it in bench_frame_boundary so that counting always starts and stops on a
+ * frame boundary with nothing on the category stack.
+ */
+static washdc_atomic_int bench_live_req;
+
+// the most recently finished frame, for bench_get_perf_counters
+static washdc_mutex latest_lock = WASHDC_MUTEX_STATIC_INIT;
+static struct bench_frame latest_frame;
+static unsigned latest_frame_no;
+
+static struct bench {
+    // true if the frames get written to a file at exit
+    bool record;
+
+    unsigned max_frames;
+    unsigned max_seconds;
+    bool done;
+
+    // number of frames counted so far, including ones that weren't recorded
+    unsigned frame_no;
+
+    struct bench_frame *frames;
+    unsigned n_frames, n_frames_alloc;
+
+    // the frame currently being recorded
+    struct bench_frame cur;
+
+    enum bench_cat stack[BENCH_STACK_DEPTH];
+    unsigned depth;
+
+    // number of pushes that didn't fit on the stack
+    unsigned overflow;
+
+    /*
+     * these are in units of bench_ticks.  Time gets charged to cat_ticks as
+     * it happens and converted to nanoseconds at the end of every frame.
+     */
+    uint64_t cat_ticks[BENCH_CAT_COUNT];
+    uint64_t start_ticks, frame_start_ticks, last_ticks;
+
+    // real time at start_ticks and at the end of the last frame
+    uint64_t start_ns, last_ns;
+
+    dc_cycle_stamp_t last_virt;
+    unsigned long long last_misses;
+    struct washdc_pvr2_stat last_pvr2;
+
+    struct washdc_instance *inst;
+} bench;
+
+enum bench_col {
+    BENCH_COL_FRAME,
+    BENCH_COL_HOST_NS,
+    BENCH_COL_SH4_NS,
+    BENCH_COL_ARM7_NS,
+    BENCH_COL_AICA_NS,
+    BENCH_COL_TA_NS,
+    BENCH_COL_RENDER_NS,
+    BENCH_COL_TEX_UPLOAD_NS,
+    BENCH_COL_JIT_COMPILE_NS,
+    BENCH_COL_GDROM_NS,
+    BENCH_COL_OTHER_NS,
+    BENCH_COL_JIT_COMPILES,
+    BENCH_COL_CODE_CACHE_MISSES,
+    BENCH_COL_VIRT_NS,
+    BENCH_COL_POLY_OPAQUE,
+    BENCH_COL_POLY_OPAQUE_MOD,
+    BENCH_COL_POLY_TRANS,
+    BENCH_COL_POLY_TRANS_MOD,
+    BENCH_COL_POLY_PUNCH_THROUGH,
+    BENCH_COL_TEX_XMIT,
+    BENCH_COL_TEX_INVALIDATE,
+    BENCH_COL_PAL_TEX_INVALIDATE,
+    BENCH_COL_TEX_OVERWRITE,
+    BENCH_COL_TEX_FRESH_UPLOAD,
+    BENCH_COL_TEX_EVICTION,
+
+    BENCH_COL_COUNT
+};
+
+static char const *const bench_col_names[BENCH_COL_COUNT] = {
+    [BENCH_COL_FRAME] = "frame",
+    [BENCH_COL_HOST_NS] = "host_ns",
+    [BENCH_COL_SH4_NS] = "sh4_ns",
+    [BENCH_COL_ARM7_NS] = "arm7_ns",
+    [BENCH_COL_AICA_NS] = "aica_ns",
+    [BENCH_COL_TA_NS] = "ta_ns",
+    [BENCH_COL_RENDER_NS] = "render_ns",
+    [BENCH_COL_TEX_UPLOAD_NS] = "tex_upload_ns",
+    [BENCH_COL_JIT_COMPILE_NS] = "jit_compile_ns",
+    [BENCH_COL_GDROM_NS] = "gdrom_ns",
+    [BENCH_COL_OTHER_NS] = "other_ns",
+    [BENCH_COL_JIT_COMPILES] = "jit_compiles",
+    [BENCH_COL_CODE_CACHE_MISSES] = "code_cache_misses",
+    [BENCH_COL_VIRT_NS] = "virt_ns",
+    [BENCH_COL_POLY_OPAQUE] = "poly_opaque",
+    [BENCH_COL_POLY_OPAQUE_MOD] = "poly_opaque_mod",
+    [BENCH_COL_POLY_TRANS] = "poly_trans",
+    [BENCH_COL_POLY_TRANS_MOD] = "poly_trans_mod",
+    [BENCH_COL_POLY_PUNCH_THROUGH] = "poly_punch_through",
+    [BENCH_COL_TEX_XMIT] = "tex_xmit",
+    [BENCH_COL_TEX_INVALIDATE] = "tex_invalidate",
+    [BENCH_COL_PAL_TEX_INVALIDATE] = "pal_tex_invalidate",
+    [BENCH_COL_TEX_OVERWRITE] = "tex_overwrite",
+    [BENCH_COL_TEX_FRESH_UPLOAD] = "tex_fresh_upload",
+    [BENCH_COL_TEX_EVICTION] = "tex_eviction"
+};
+
+static uint64_t bench_now_ns(void) {
+    washdc_real_time now;
+    washdc_get_real_time(&now);
+    return (uint64_t)(washdc_real_time_to_seconds(&now) * 1000000000.0);
+}
+
+static inline uint64_t bench_ticks(void) {
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return bench_now_ns();
+#endif
+}
+
+// how long one tick is, based on how much of each has gone by since the start
+static double bench_ns_per_tick(uint64_t now_ticks, uint64_t now_ns) {
+#ifdef BENCH_HAVE_TSC
+    if (now_ticks <= bench.start_ticks || now_ns <= bench.start_ns)
+        return 0.0;
+    return (double)(now_ns - bench.start_ns) /
+        (double)(now_ticks - bench.start_ticks);
+#else
+    return 1.0;
+#endif
+}
+
+// charge the time since the last push/pop to the innermost category
+static void bench_charge(uint64_t now) {
+    if (bench.depth)
+        bench.cat_ticks[bench.stack[bench.depth - 1]] += now - bench.last_ticks;
+    bench.last_ticks = now;
+}
+
+/*
+ * only the thread that called bench_start gets benchmarked; when the AICA runs
+ * on its own thread its pushes and pops land here and get dropped.
+ */
+static WASHDC_THREAD_LOCAL bool bench_this_thread;
+
+void bench_init(void) {
+    memset(&bench, 0, sizeof(bench));
+    washdc_atomic_int_init(&bench_enabled, 0);
+
+    washdc_mutex_lock(&latest_lock);
+    memset(&latest_frame, 0, sizeof(latest_frame));
+    latest_frame_no = 0;
+    washdc_mutex_unlock(&latest_lock);
+
+    char const *path = config_get_bench_path();
+    if (!path || !strlen(path))
+        return;
+
+    int max_frames = config_get_bench_frames();
+    int max_seconds = config_get_bench_seconds();
+    bench.max_frames = max_frames > 0 ? max_frames : 0;
+    bench.max_seconds = max_seconds > 0 ? max_seconds : 0;
+
+    bench.record = true;
+    washdc_atomic_int_store(&bench_enabled, 1);
+
+    if (bench.max_frames) {
+        LOG_INFO("benchmarking %u frames into \"%s\"\n",
+                 bench.max_frames, path);
+    } else if (bench.max_seconds) {
+        LOG_INFO("benchmarking %u seconds into \"%s\"\n",
+                 bench.max_seconds, path);
+    } else {
+        LOG_INFO("benchmarking until exit into \"%s\"\n", path);
+    }
+}
+
+void bench_start(struct washdc_instance *inst) {
+    bench_this_thread = true;
+    bench.inst = inst;
+
+    bench.start_ns = bench_now_ns();
+    bench.start_ticks = bench_ticks();
+    bench.frame_start_ticks = bench.start_ticks;
+    bench.last_ticks = bench.start_ticks;
+    bench.last_ns = bench.start_ns;
+}
+
+/*
+ * begin counting in the middle of a run.  This only gets called from
+ * bench_frame_boundary, so the category stack is already empty; the
+ * per-frame deltas start from where the counters are now.
+ */
+static void bench_begin_live(dc_cycle_stamp_t virt_time,
+                             unsigned long long cache_misses) {
+    bench.overflow = 0;
+    memset(&bench.cur, 0, sizeof(bench.cur));
+    memset(bench.cat_ticks, 0, sizeof(bench.cat_ticks));
+
+    bench.frame_start_ticks = bench_ticks();
+    bench.last_ticks = bench.frame_start_ticks;
+    bench.last_virt = virt_time;
+    bench.last_misses = cache_misses;
+    washdc_get_pvr2_stat(bench.inst, &bench.last_pvr2);
+
+    washdc_atomic_int_store(&bench_enabled, 1);
+}
+
+void bench_set_live(bool enable) {
+    washdc_atomic_int_store(&bench_live_req, enable);
+}
+
+void bench_frame_boundary(dc_cycle_stamp_t virt_time,
+                          unsigned long long cache_misses) {
+    if (bench.record)
+        return;
+
+    bool live = washdc_atomic_int_load(&bench_live_req);
+    bool enabled = washdc_atomic_int_load(&bench_enabled);
+    if (live && !enabled)
+        bench_begin_live(virt_time, cache_misses);
+    else if (!live && enabled)
+        washdc_atomic_int_store(&bench_enabled, 0);
+}
+
+void bench_do_push(enum bench_cat cat) {
+    if (!bench_this_thread)
+        return;
+
+    bench_charge(bench_ticks());
+
+    if (bench.depth < BENCH_STACK_DEPTH)
+        bench.stack[bench.depth++] = cat;
+    else
+        bench.overflow++;
+    bench.cur.cat_count[cat]++;
+}
+
+void bench_do_pop(void) {
+    if (!bench_this_thread)
+        return;
+
+    bench_charge(bench_ticks());
+
+    if (bench.overflow)
+        bench.overflow--;
+    else if (bench.depth)
+        bench.depth--;
+}
+
+void bench_end_frame(dc_cycle_stamp_t virt_time,
+                     unsigned long long cache_misses) {
+    if (!washdc_atomic_int_load(&bench_enabled) || bench.done)
+        return;
+
+    uint64_t now = bench_ticks();
+    uint64_t now_ns = bench_now_ns();
+    bench_charge(now);
+
+    double ns_per_tick = bench_ns_per_tick(now, now_ns);
+    struct bench_frame *cur = &bench.cur;
+    unsigned cat;
+    for (cat = 0; cat < BENCH_CAT_COUNT; cat++)
+        cur->cat_ns[cat] = (uint64_t)(bench.cat_ticks[cat] * ns_per_tick);
+    memset(bench.cat_ticks, 0, sizeof(bench.cat_ticks));
+    cur->host_ns = (uint64_t)((now - bench.frame_start_ticks) * ns_per_tick);
+    cur->virt_cycles = virt_time - bench.last_virt;
+    cur->cache_misses = cache_misses - bench.last_misses;
+    bench.last_virt = virt_time;
+    bench.last_misses = cache_misses;
+
+    struct washdc_pvr2_stat pvr2;
+    washdc_get_pvr2_stat(bench.inst, &pvr2);
+    memcpy(cur->pvr2.poly_count, pvr2.poly_count, sizeof(pvr2.poly_count));
+    cur->pvr2.tex_xmit_count =
+        pvr2.tex_xmit_count - bench.last_pvr2.tex_xmit_count;
+    cur->pvr2.tex_invalidate_count =
+        pvr2.tex_invalidate_count - bench.last_pvr2.tex_invalidate_count;
+    cur->pvr2.pal_tex_invalidate_count =
+        pvr2.pal_tex_invalidate_count -
+        bench.last_pvr2.pal_tex_invalidate_count;
+    cur->pvr2.texture_overwrite_count =
+        pvr2.texture_overwrite_count - bench.last_pvr2.texture_overwrite_count;
+    cur->pvr2.fresh_texture_upload_count =
+        pvr2.fresh_texture_upload_count -
+        bench.last_pvr2.fresh_texture_upload_count;
+    cur->pvr2.tex_eviction_count =
+        pvr2.tex_eviction_count - bench.last_pvr2.tex_eviction_count;
+    bench.last_pvr2 = pvr2;
+
+    washdc_mutex_lock(&latest_lock);
+    latest_frame = *cur;
+    latest_frame_no = ++bench.frame_no;
+    washdc_mutex_unlock(&latest_lock);
+
+    memset(cur, 0, sizeof(*cur));
+    bench.frame_start_ticks = now;
+    bench.last_ns = now_ns;
+
+    if (!bench.record)
+        return;
+
+    if (bench.n_frames == bench.n_frames_alloc) {
+        unsigned n_alloc = bench.n_frames_alloc ? 2 * bench.n_frames_alloc : 1024;
+        struct bench_frame *frames = (struct bench_frame*)
+            realloc(bench.frames, n_alloc * sizeof(struct bench_frame));
+        if (!frames)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        bench.frames = frames;
+        bench.n_frames_alloc = n_alloc;
+    }
+    bench.frames[bench.n_frames++] = latest_frame;
+
+    if ((bench.max_frames && bench.n_frames >= bench.max_frames) ||
+        (bench.max_seconds &&
+         now_ns - bench.start_ns >= bench.max_seconds * 1000000000ull)) {
+        LOG_INFO("benchmark finished after %u frames\n", bench.n_frames);
+        bench.done = true;
+        dreamcast_kill();
+    }
+}
+
+// host time that didn't go to any category
+static uint64_t bench_other_ns(struct bench_frame const *frame) {
+    uint64_t total = 0;
+    unsigned cat;
+    for (cat = 0; cat < BENCH_CAT_COUNT; cat++)
+        total += frame->cat_ns[cat];
+    return frame->host_ns > total ? frame->host_ns - total : 0;
+}
+
+static void
+bench_get_row(struct bench_frame const *frame, unsigned frame_no,
+              unsigned long long row[BENCH_COL_COUNT]) {
+    row[BENCH_COL_FRAME] = frame_no;
+    row[BENCH_COL_HOST_NS] = frame->host_ns;
+    row[BENCH_COL_SH4_NS] = frame->cat_ns[BENCH_CAT_SH4];
+    row[BENCH_COL_ARM7_NS] = frame->cat_ns[BENCH_CAT_ARM7];
+    row[BENCH_COL_AICA_NS] = frame->cat_ns[BENCH_CAT_AICA];
+    row[BENCH_COL_TA_NS] = frame->cat_ns[BENCH_CAT_TA];
+    row[BENCH_COL_RENDER_NS] = frame->cat_ns[BENCH_CAT_RENDER];
+    row[BENCH_COL_TEX_UPLOAD_NS] = frame->cat_ns[BENCH_CAT_TEX_UPLOAD];
+    row[BENCH_COL_JIT_COMPILE_NS] = frame->cat_ns[BENCH_CAT_JIT_COMPILE];
+    row[BENCH_COL_GDROM_NS] = frame->cat_ns[BENCH_CAT_GDROM];
+    row[BENCH_COL_OTHER_NS] = bench_other_ns(frame);
+
+    row[BENCH_COL_JIT_COMPILES] = frame->cat_count[BENCH_CAT_JIT_COMPILE];
+    row[BENCH_COL_CODE_CACHE_MISSES] = frame->cache_misses;
+    row[BENCH_COL_VIRT_NS] =
+        (unsigned long long)(frame->virt_cycles *
+                             (1000000000.0 / SCHED_FREQUENCY));
+
+    row[BENCH_COL_POLY_OPAQUE] =
+        frame->pvr2.poly_count[WASHDC_PVR2_POLY_GROUP_OPAQUE];
+    row[BENCH_COL_POLY_OPAQUE_MOD] =
+        frame->pvr2.poly_count[WASHDC_PVR2_POLY_GROUP_OPAQUE_MOD];
+    row[BENCH_COL_POLY_TRANS] =
+        frame->pvr2.poly_count[WASHDC_PVR2_POLY_GROUP_TRANS];
+    row[BENCH_COL_POLY_TRANS_MOD] =
+        frame->pvr2.poly_count[WASHDC_PVR2_POLY_GROUP_TRANS_MOD];
+    row[BENCH_COL_POLY_PUNCH_THROUGH] =
+        frame->pvr2.poly_count[WASHDC_PVR2_POLY_GROUP_PUNCH_THROUGH];
+
+    row[BENCH_COL_TEX_XMIT] = frame->pvr2.tex_xmit_count;
+    row[BENCH_COL_TEX_INVALIDATE] = frame->pvr2.tex_invalidate_count;
+    row[BENCH_COL_PAL_TEX_INVALIDATE] = frame->pvr2.pal_tex_invalidate_count;
+    row[BENCH_COL_TEX_OVERWRITE] = frame->pvr2.texture_overwrite_count;
+    row[BENCH_COL_TEX_FRESH_UPLOAD] = frame->pvr2.fresh_texture_upload_count;
+    row[BENCH_COL_TEX_EVICTION] = frame->pvr2.tex_eviction_count;
+}
+
+static void bench_write_csv(washdc_hostfile file) {
+    unsigned long long row[BENCH_COL_COUNT];
+    unsigned col, frame_no;
+
+    for (col = 0; col < BENCH_COL_COUNT; col++) {
+        washdc_hostfile_printf(file, "%s%s", col ? "," : "",
+                               bench_col_names[col]);
+    }
+    washdc_hostfile_putc(file, '\n');
+
+    for (frame_no = 0; frame_no < bench.n_frames; frame_no++) {
+        bench_get_row(bench.frames + frame_no, frame_no, row);
+        for (col = 0; col < BENCH_COL_COUNT; col++)
+            washdc_hostfile_printf(file, "%s%llu", col ? "," : "", row[col]);
+        washdc_hostfile_putc(file, '\n');
+    }
+}
+
+static void bench_write_json(washdc_hostfile file) {
+    unsigned long long row[BENCH_COL_COUNT];
+    unsigned col, frame_no;
+    char const *cpu;
+
+    if (!config_get_jit())
+        cpu = "interpreter";
+#ifdef ENABLE_JIT_X86_64
+    else if (config_get_native_jit())
+        cpu = "native_jit";
+#endif
+    else
+        cpu = "jit";
+
+    washdc_hostfile_printf(file, "{\n");
+    washdc_hostfile_printf(file, "    \"sh4_backend\": \"%s\",\n", cpu);
+    washdc_hostfile_printf(file, "    \"n_frames\": %u,\n", bench.n_frames);
+    washdc_hostfile_printf(file, "    \"host_ns\": %llu,\n",
+                           (unsigned long long)(bench.last_ns -
+                                                bench.start_ns));
+    washdc_hostfile_printf(file, "    \"frames\": [");
+    for (frame_no = 0; frame_no < bench.n_frames; frame_no++) {
+        bench_get_row(bench.frames + frame_no, frame_no, row);
+        washdc_hostfile_printf(file, "%s\n        {", frame_no ? "," : "");
+        for (col = 0; col < BENCH_COL_COUNT; col++) {
+            washdc_hostfile_printf(file, "%s\"%s\": %llu", col ? ", " : "",
+                                   bench_col_names[col], row[col]);
+        }
+        washdc_hostfile_putc(file, '}');
+    }
+    washdc_hostfile_printf(file, "\n    ]\n}\n");
+}
+
+void bench_cleanup(void) {
+    if (!bench.record)
+        goto the_end;
+
+    char const *path = config_get_bench_path();
+    washdc_hostfile file =
+        washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                             WASHDC_HOSTFILE_TEXT);
+    if (file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open benchmark output file \"%s\"\n", path);
+        goto the_end;
+    }
+
+    char const *ext = strrchr(path, '.');
+    if (ext && strcmp(ext, ".csv") == 0)
+        bench_write_csv(file);
+    else
+        bench_write_json(file);
+
+    washdc_hostfile_close(file);
+    LOG_INFO("wrote %u frames of benchmark data to \"%s\"\n",
+             bench.n_frames, path);
+
+the_end:
+    free(bench.frames);
+    memset(&bench, 0, sizeof(bench));
+    washdc_atomic_int_store(&bench_enabled, 0);
+}
+
+bool bench_get_perf_counters(struct washdc_perf_counters *out) {
+    washdc_mutex_lock(&latest_lock);
+    struct bench_frame frame = latest_frame;
+    unsigned frame_no = latest_frame_no;
+    washdc_mutex_unlock(&latest_lock);
+
+    memset(out, 0, sizeof(*out));
+    if (!frame_no)
+        return false;
+
+    static enum washdc_perf_cat const cat_map[BENCH_CAT_COUNT] = {
+        [BENCH_CAT_SH4] = WASHDC_PERF_CAT_SH4,
+        [BENCH_CAT_ARM7] = WASHDC_PERF_CAT_ARM7,
+        [BENCH_CAT_AICA] = WASHDC_PERF_CAT_AICA,
+        [BENCH_CAT_TA] = WASHDC_PERF_CAT_TA,
+        [BENCH_CAT_RENDER] = WASHDC_PERF_CAT_RENDER,
+        [BENCH_CAT_TEX_UPLOAD] = WASHDC_PERF_CAT_TEX_UPLOAD,
+        [BENCH_CAT_JIT_COMPILE] = WASHDC_PERF_CAT_JIT_COMPILE,
+        [BENCH_CAT_GDROM] = WASHDC_PERF_CAT_GDROM
+    };
+
+    unsigned cat;
+    for (cat = 0; cat < BENCH_CAT_COUNT; cat++) {
+        out->cat_ns[cat_map[cat]] = frame.cat_ns[cat];
+        out->cat_count[cat_map[cat]] = frame.cat_count[cat];
+    }
+    out->cat_ns[WASHDC_PERF_CAT_OTHER] = bench_other_ns(&frame);
+
+    out->frame_no = frame_no;
+    out->host_ns = frame.host_ns;
+    out->virt_ns = (uint64_t)(frame.virt_cycles *
+                              (1000000000.0 / SCHED_FREQUENCY));
+    out->code_cache_misses = frame.cache_misses;
+
+    return true;
+}
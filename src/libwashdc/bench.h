@@ -0,0 +1,124 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/*
+ * Per-frame benchmark recorder.
+ *
+ * When a benchmark output path is configured (washdc-headless's -B option),
+ * the host time spent on the emulation thread gets split up by category for
+ * every frame and written out as JSON or CSV (chosen by the file extension)
+ * when the emulator exits.  The run can optionally be stopped automatically
+ * after a number of frames or seconds.
+ *
+ * The same counters can also be switched on and off at runtime with
+ * bench_set_live (washdc_set_perf_counters); in that case nothing gets written
+ * out and only the most recently finished frame is kept around for
+ * bench_get_perf_counters.  When neither is in use, bench_push and bench_pop
+ * cost one load and one branch.
+ *
+ * Categories nest; time is only ever charged to the innermost one, so for
+ * example the time spent compiling a block does not also count as SH4 time.
+ * Time spent on the emulation thread outside of every category (main loop,
+ * code cache garbage collection, etc) is reported as "other".
+ *
+ * SH4 time includes every scheduler event on the SH4's clock that doesn't have
+ * a category of its own.  TA time only covers the bulk paths into the TA
+ * (channel-2 DMA and sort-DMA); store-queue writes count as SH4 time because
+ * timing every 32-byte packet would cost more than the TA itself.
+ * GD-ROM time covers ATA and packet command processing, the drive's delayed
+ * completion event and GD-DMA transfers.
+ *
+ * All of these functions must be called from the emulation thread.  Pushes and
+ * pops from any other thread are ignored, so ARM7/AICA time is not counted when
+ * exec.aica-thread is enabled.
+ */
+
+#include <stdbool.h>
+
+#include "dc_sched.h"
+#include "atomics.h"
+#include "washdc/washdc.h"
+
+enum bench_cat {
+    BENCH_CAT_SH4,
+    BENCH_CAT_ARM7,
+    BENCH_CAT_AICA,
+    BENCH_CAT_TA,
+    BENCH_CAT_RENDER,
+    BENCH_CAT_TEX_UPLOAD,
+    BENCH_CAT_JIT_COMPILE,
+    BENCH_CAT_GDROM,
+
+    BENCH_CAT_COUNT
+};
+
+extern washdc_atomic_int bench_enabled;
+
+void bench_init(void);
+
+// writes out the results
+void bench_cleanup(void);
+
+/*
+ * call right before the emulation thread starts running frames.  inst is the
+ * instance whose PowerVR2 counters get recorded.
+ */
+struct washdc_instance;
+void bench_start(struct washdc_instance *inst);
+
+void bench_do_push(enum bench_cat cat);
+void bench_do_pop(void);
+
+static inline void bench_push(enum bench_cat cat) {
+    if (washdc_atomic_int_load(&bench_enabled))
+        bench_do_push(cat);
+}
+
+static inline void bench_pop(void) {
+    if (washdc_atomic_int_load(&bench_enabled))
+        bench_do_pop();
+}
+
+/*
+ * called at the end of every frame.  virt_time is the SH4's cycle stamp and
+ * cache_misses is the running total of code-cache misses.  If the frame or
+ * time limit has been reached, this kills the emulator.
+ */
+void bench_end_frame(dc_cycle_stamp_t virt_time,
+                     unsigned long long cache_misses);
+
+/*
+ * called between frames, when nothing is on the category stack.  This is
+ * where counting gets switched on or off for bench_set_live.
+ */
+void bench_frame_boundary(dc_cycle_stamp_t virt_time,
+                          unsigned long long cache_misses);
+
+// these two can be called from any thread
+void bench_set_live(bool enable);
+bool bench_get_perf_counters(struct washdc_perf_counters *out);
+
+#endif
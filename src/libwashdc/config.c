@@ -93,3 +93,13 @@ CONFIG_DEF_BOOL(inline_mem, true);
 
 CONFIG_DEF_BOOL(log_verbose, false);
 CONFIG_DEF_BOOL(log_stdout, false);
+
+CONFIG_DEF_STRING(bench_path);
+CONFIG_DEF_INT(bench_frames, 0);
+CONFIG_DEF_INT(bench_seconds, 0);
+
+CONFIG_DEF_STRING(movie_record_path);
+CONFIG_DEF_STRING(movie_play_path);
+
+CONFIG_DEF_STRING(frame_hash_path);
+CONFIG_DEF_STRING(frame_hash_frames);
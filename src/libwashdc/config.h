@@ -104,4 +104,25 @@ CONFIG_DECL_BOOL(inline_mem);
 CONFIG_DECL_BOOL(log_stdout);
 CONFIG_DECL_BOOL(log_verbose);
 
+// if not empty, record per-frame benchmark data into this file (see bench.h)
+CONFIG_DECL_STRING(bench_path);
+
+// number of frames to benchmark before exiting, or 0 for no limit
+CONFIG_DECL_INT(bench_frames);
+
+// number of seconds to benchmark before exiting, or 0 for no limit
+CONFIG_DECL_INT(bench_seconds);
+
+// if not empty, record an input movie into this file (see maple_movie.h)
+CONFIG_DECL_STRING(movie_record_path);
+
+// if not empty, play back the input movie in this file
+CONFIG_DECL_STRING(movie_play_path);
+
+// if not empty, write framebuffer checkpoint hashes here (see frame_hash.h)
+CONFIG_DECL_STRING(frame_hash_path);
+
+// comma-separated list of frame numbers to hash the framebuffer at
+CONFIG_DECL_STRING(frame_hash_frames);
+
 #endif
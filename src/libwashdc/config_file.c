@@ -62,6 +62,14 @@ static struct cfg_state {
     bool in_comment;
 } cfg_state;
 
+/*
+ * settings that were added after wash.cfg was already being generated.  These
+ * get parsed before wash.cfg so that config files written by older versions
+ * still pick them up, and anything in wash.cfg overrides them.
+ */
+static char const *cfg_builtin_defaults =
+    "wash.ctrl.toggle-turbo kbd.f9\n";
+
 static void cfg_add_entry(void);
 static void cfg_handle_newline(void);
 static int cfg_parse_bool(char const *val, bool *outp);
@@ -87,6 +95,36 @@ static void cfg_create_default_config(void) {
         "; purposes)\n"
         "wash.dbg.dump_mem_on_error false\n"
         "\n"
+        "; when the debugger is enabled, it keeps a ring of snapshots so that\n"
+        "; it can step backwards.  depth is the number of snapshots to keep\n"
+        "; (set it to 0 to disable this), period is the number of frames\n"
+        "; between snapshots and max-mb caps the memory used by old pages.\n"
+        "; Every single-step also takes a snapshot.  Going backwards from\n"
+        "; anywhere else replays from the snapshot before it, so a shorter\n"
+        "; period makes that faster.\n"
+        "wash.dbg.rewind.depth 256\n"
+        "wash.dbg.rewind.period 10\n"
+        "wash.dbg.rewind.max-mb 256\n"
+        "\n"
+        "; execution trace (builds with -DENABLE_TRACE=On only).  Uncomment\n"
+        "; wash.trace.file to turn it on.  wash.trace.events is a comma-separated\n"
+        "; list of block, mmio, irq, dma and ta, or all to record everything.\n"
+        "; wash.trace.file washdc_trace.bin\n"
+        "wash.trace.events all\n"
+        "\n"
+        "; tell Linux perf about native JIT code.  map writes /tmp/perf-<pid>.map\n"
+        "; and jitdump writes /tmp/jit-<pid>.dump for perf inject --jit.  disas\n"
+        "; adds IL listings of each block to the jitdump's debug info.\n"
+        "wash.jit.perf.map false\n"
+        "wash.jit.perf.jitdump false\n"
+        "wash.jit.perf.disas false\n"
+        "\n"
+        "; sampling profiler for JIT code blocks.  When enabled, a background\n"
+        "; thread checks which block is running every period-us microseconds.\n"
+        "; The results can be viewed with WashDbg's profile command.\n"
+        "wash.jit.sample.enable false\n"
+        "wash.jit.sample.period-us 1000\n"
+        "\n"
         "; background color (use html hex syntax)\n"
         "ui.bgcolor #3d77c0\n"
         "\n"
@@ -119,10 +157,19 @@ static void cfg_create_default_config(void) {
         "; seem to be a good enough approximation most of the time.\n"
         "gfx.rend.oit-mode per-group\n"
         "\n"
+        "; number of extra threads used to decode textures.  Set this to 0\n"
+        "; to decode every texture on the emulation thread.\n"
+        "gfx.rend.tex-decode-threads 3\n"
+        "\n"
         "; set this to true to mute audio.  Set it to false to allow audio \n"
         "; to play\n"
         "audio.mute false\n"
         "\n"
+        "; set this to true to keep the audio buffer at a steady level by\n"
+        "; slightly adjusting the playback rate instead of stalling the emulator\n"
+        "; whenever the buffer fills up\n"
+        "audio.dynamic-rate-control true\n"
+        "\n"
         "; to \"unplug\" any of the below controllers, comment out or delete it\n"
         "wash.dc.port.0.0 dreamcast_controller\n"
         "wash.dc.port.1.0 dreamcast_controller\n"
@@ -136,6 +183,11 @@ static void cfg_create_default_config(void) {
         ";     pause: start the emulator paused\n"
         "exec.speed full\n"
         "\n"
+        "; in turbo mode, only one out of this many frames gets drawn\n"
+        "exec.turbo-interval 10\n"
+        "; run the ARM7 and AICA on a second host thread (no debugger support)\n"
+        "exec.aica-thread false\n"
+        "\n"
         /*
          * TODO: find a way to explain the naming convention for control
          * bindings to end-users
@@ -149,6 +201,7 @@ static void cfg_create_default_config(void) {
         "wash.ctrl.pause-execution kbd.f7\n"
 
         "wash.ctrl.toggle-mute kbd.f8\n"
+        "wash.ctrl.toggle-turbo kbd.f9\n"
         "wash.ctrl.toggle-fullscreen kbd.f11\n"
         "wash.ctrl.screenshot kbd.f12\n"
         "\n"
@@ -434,6 +487,11 @@ void cfg_init(void) {
 
     fifo_init(&cfg_state.cfg_nodes);
 
+    char const *def;
+    for (def = cfg_builtin_defaults; *def; def++)
+        cfg_put_char(*def);
+    cfg_state.line_count = 0;
+
     washdc_hostfile cfg_file =
         washdc_hostfile_open_cfg_file(WASHDC_HOSTFILE_READ |
                                       WASHDC_HOSTFILE_TEXT);
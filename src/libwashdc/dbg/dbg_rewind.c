@@ -0,0 +1,793 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "memory.h"
+#include "dc_sched.h"
+#include "hw/sh4/sh4.h"
+#include "hw/arm7/arm7.h"
+#include "hw/aica/aica_wave_mem.h"
+#include "washdc/config_file.h"
+#include "washdc/error.h"
+#include "washdc/debugger.h"
+
+#include "dbg_rewind.h"
+
+#define DBG_REWIND_PAGE_SHIFT 12
+#define DBG_REWIND_PAGE_SIZE (1 << DBG_REWIND_PAGE_SHIFT)
+
+static_assert(MEMORY_PAGE_SHIFT == DBG_REWIND_PAGE_SHIFT &&
+              AICA_WAVE_MEM_PAGE_SHIFT == DBG_REWIND_PAGE_SHIFT,
+              "written_pages maps don't match the rewind page size");
+
+// page ids in the snapshots say which area the page belongs to
+#define DBG_REWIND_PAGE_ID(area_no, page_no) (((area_no) << 16) | (page_no))
+#define DBG_REWIND_PAGE_ID_AREA(page_id) ((page_id) >> 16)
+#define DBG_REWIND_PAGE_ID_PAGE(page_id) ((page_id) & 0xffff)
+
+#define DBG_REWIND_DEFAULT_DEPTH 256
+#define DBG_REWIND_DEFAULT_PERIOD 10
+#define DBG_REWIND_DEFAULT_MAX_MB 256
+
+/*
+ * when a reverse-step has to replay, it first takes a snapshot every this
+ * many instructions.  Once it finds its way back it replays the last stretch
+ * again from the newest of those, this time taking a snapshot before every
+ * instruction.
+ */
+#define DBG_REWIND_REPLAY_COARSE_PERIOD 1024
+
+/*
+ * A replay normally has to get back to its target on exactly the same cycle
+ * the original execution did.  Interrupts and DMA don't necessarily land on
+ * the same instructions the second time around though, so if it misses, it
+ * starts over and this time accepts the first match that's within span / 8
+ * plus this many cycles of the target, where span is how long the original
+ * execution took.
+ */
+#define DBG_REWIND_REPLAY_SLACK (SCHED_FREQUENCY / 10000)
+
+struct dbg_rewind_cpu_state {
+    reg32_t sh4_reg[SH4_REGISTER_COUNT];
+    Sh4ExecState sh4_exec_state;
+    bool sh4_delayed_branch;
+    addr32_t sh4_delayed_branch_addr;
+    bool sh4_dont_increment_pc;
+
+    // decides how many cycles the next instruction takes
+    sh4_inst_group_t sh4_last_inst_type;
+
+    uint32_t arm7_reg[ARM7_REGISTER_COUNT];
+    arm7_inst arm7_pipeline[2];
+    uint32_t arm7_pipeline_pc[2];
+    enum arm7_excp arm7_excp;
+};
+
+struct dbg_rewind_snap {
+    struct dbg_rewind_cpu_state cpu;
+
+    // emulated time when this snapshot was taken (see dbg_rewind_now)
+    dc_cycle_stamp_t when;
+
+    /*
+     * true if the position after this snapshot (either the next snapshot or
+     * the current position) is exactly one SH4 instruction later.
+     */
+    bool next_is_step;
+
+    /*
+     * pages of memory which changed between this snapshot and the next
+     * one, along with what they contained when this snapshot was taken.
+     */
+    unsigned n_pages, max_pages;
+    unsigned *page_id;
+    uint8_t *page_dat;
+};
+
+enum dbg_rewind_area_id {
+    DBG_REWIND_AREA_RAM,
+    DBG_REWIND_AREA_WAVE_MEM,
+
+    DBG_REWIND_N_AREAS
+};
+
+struct dbg_rewind_area {
+    uint8_t *mem;
+    uint8_t *written_pages;
+    unsigned n_pages;
+
+    // contents of mem as of the newest snapshot
+    uint8_t *shadow;
+
+    /*
+     * one byte per page, set for the pages that are in the log of the
+     * snapshot a replay started from.
+     */
+    uint8_t *in_log;
+};
+
+enum dbg_rewind_replay_mode {
+    // land on the instruction right before the target
+    DBG_REWIND_REPLAY_STEP,
+
+    // land on the last breakpoint before the target
+    DBG_REWIND_REPLAY_BREAK
+};
+
+struct dbg_rewind_replay {
+    bool active;
+    enum dbg_rewind_replay_mode mode;
+
+    // where the replay is trying to get back to
+    struct dbg_rewind_cpu_state target;
+    dc_cycle_stamp_t target_when;
+
+    /*
+     * the snapshot the replay started from is always the one at position
+     * base_count - 1 in the ring.  Replay only ever keeps the newest
+     * snapshot it took, which comes right after that one.
+     */
+    unsigned base_count;
+
+    // DBG_REWIND_REPLAY_STEP takes a snapshot this often
+    unsigned capture_period;
+
+    // instructions executed since the newest snapshot
+    unsigned n_since_capture;
+
+    // DBG_REWIND_REPLAY_BREAK sets this once it takes a snapshot
+    bool hit_break;
+
+    // set on the second try, once an exact replay didn't work out
+    bool tolerant;
+};
+
+static struct dbg_rewind {
+    bool enabled;
+
+    struct Sh4 *sh4;
+    struct arm7 *arm7;
+    struct dc_clock *clk;
+
+    struct dbg_rewind_area areas[DBG_REWIND_N_AREAS];
+
+    struct dbg_rewind_snap *ring;
+    unsigned depth, first, count;
+
+    // total bytes of page data held by all snapshots
+    size_t n_bytes, max_bytes;
+
+    unsigned period, frames_until_snap;
+
+    /*
+     * the clock keeps going forward when the system gets rewound, so this is
+     * subtracted from it to get the time along the history the snapshots are
+     * on.
+     */
+    dc_cycle_stamp_t time_offs;
+
+    struct dbg_rewind_replay replay;
+} rw;
+
+static dc_cycle_stamp_t dbg_rewind_now(void) {
+    return clock_cycle_stamp(rw.clk) - rw.time_offs;
+}
+
+static struct dbg_rewind_snap *dbg_rewind_nth(unsigned idx) {
+    return rw.ring + (rw.first + idx) % rw.depth;
+}
+
+static struct dbg_rewind_snap *dbg_rewind_newest(void) {
+    return dbg_rewind_nth(rw.count - 1);
+}
+
+static struct dbg_rewind_snap *dbg_rewind_replay_base(void) {
+    return dbg_rewind_nth(rw.replay.base_count - 1);
+}
+
+static uint8_t *dbg_rewind_page(uint8_t *base, unsigned page_no) {
+    return base + ((size_t)page_no << DBG_REWIND_PAGE_SHIFT);
+}
+
+static void dbg_rewind_free_pages(struct dbg_rewind_snap *snap) {
+    rw.n_bytes -= (size_t)snap->n_pages * DBG_REWIND_PAGE_SIZE;
+    free(snap->page_id);
+    free(snap->page_dat);
+    snap->page_id = NULL;
+    snap->page_dat = NULL;
+    snap->n_pages = 0;
+    snap->max_pages = 0;
+}
+
+static void dbg_rewind_log_page(struct dbg_rewind_snap *snap,
+                                unsigned page_id, uint8_t const *dat) {
+    if (snap->n_pages == snap->max_pages) {
+        unsigned max_pages = snap->max_pages ? 2 * snap->max_pages : 16;
+        unsigned *page_id_new = (unsigned*)realloc(snap->page_id,
+                                                   max_pages * sizeof(unsigned));
+        if (!page_id_new)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        snap->page_id = page_id_new;
+
+        uint8_t *page_dat_new = (uint8_t*)realloc(snap->page_dat,
+            (size_t)max_pages * DBG_REWIND_PAGE_SIZE);
+        if (!page_dat_new)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        snap->page_dat = page_dat_new;
+
+        snap->max_pages = max_pages;
+    }
+
+    snap->page_id[snap->n_pages] = page_id;
+    memcpy(dbg_rewind_page(snap->page_dat, snap->n_pages), dat,
+           DBG_REWIND_PAGE_SIZE);
+    snap->n_pages++;
+    rw.n_bytes += DBG_REWIND_PAGE_SIZE;
+}
+
+static void dbg_rewind_drop_oldest(void) {
+    dbg_rewind_free_pages(rw.ring + rw.first);
+    rw.first = (rw.first + 1) % rw.depth;
+    rw.count--;
+    if (rw.replay.active)
+        rw.replay.base_count--;
+}
+
+static void dbg_rewind_get_cpu(struct dbg_rewind_cpu_state *state) {
+    // zero it out first so that padding doesn't mess up memcmp
+    memset(state, 0, sizeof(*state));
+
+    memcpy(state->sh4_reg, rw.sh4->reg, sizeof(state->sh4_reg));
+    state->sh4_exec_state = rw.sh4->exec_state;
+    state->sh4_delayed_branch = rw.sh4->delayed_branch;
+    state->sh4_delayed_branch_addr = rw.sh4->delayed_branch_addr;
+    state->sh4_dont_increment_pc = rw.sh4->dont_increment_pc;
+    state->sh4_last_inst_type = rw.sh4->last_inst_type;
+
+    memcpy(state->arm7_reg, rw.arm7->reg, sizeof(state->arm7_reg));
+    memcpy(state->arm7_pipeline, rw.arm7->pipeline,
+           sizeof(state->arm7_pipeline));
+    memcpy(state->arm7_pipeline_pc, rw.arm7->pipeline_pc,
+           sizeof(state->arm7_pipeline_pc));
+    state->arm7_excp = rw.arm7->excp;
+}
+
+static void dbg_rewind_set_cpu(struct dbg_rewind_cpu_state const *state) {
+    /*
+     * copy the register files in directly instead of going through
+     * sh4_set_regs because they're already in the layout of the bank that
+     * was active when the snapshot was taken.
+     */
+    memcpy(rw.sh4->reg, state->sh4_reg, sizeof(state->sh4_reg));
+    rw.sh4->exec_state = state->sh4_exec_state;
+    rw.sh4->delayed_branch = state->sh4_delayed_branch;
+    rw.sh4->delayed_branch_addr = state->sh4_delayed_branch_addr;
+    rw.sh4->dont_increment_pc = state->sh4_dont_increment_pc;
+    rw.sh4->last_inst_type = state->sh4_last_inst_type;
+
+    memcpy(rw.arm7->reg, state->arm7_reg, sizeof(state->arm7_reg));
+    memcpy(rw.arm7->pipeline, state->arm7_pipeline,
+           sizeof(state->arm7_pipeline));
+    memcpy(rw.arm7->pipeline_pc, state->arm7_pipeline_pc,
+           sizeof(state->arm7_pipeline_pc));
+    rw.arm7->excp = state->arm7_excp;
+}
+
+/*
+ * compare the SH4 against the given state.  Only the registers instructions
+ * operate on (everything up to and including the PC) are compared; the rest
+ * of the register file belongs to on-chip peripherals that don't necessarily
+ * come out the same way on a replay.  The branch target only means anything
+ * while there's a delayed branch pending, and the JIT doesn't keep it up to
+ * date otherwise.
+ */
+static bool dbg_rewind_sh4_matches(struct dbg_rewind_cpu_state const *state) {
+    return memcmp(rw.sh4->reg, state->sh4_reg,
+                  (SH4_REG_PC + 1) * sizeof(reg32_t)) == 0 &&
+        rw.sh4->exec_state == state->sh4_exec_state &&
+        rw.sh4->delayed_branch == state->sh4_delayed_branch &&
+        (!rw.sh4->delayed_branch ||
+         rw.sh4->delayed_branch_addr == state->sh4_delayed_branch_addr) &&
+        rw.sh4->dont_increment_pc == state->sh4_dont_increment_pc;
+}
+
+// returns the first page at or after page_no with its written_pages byte set
+static unsigned
+dbg_rewind_next_written(struct dbg_rewind_area const *area, unsigned page_no) {
+    while (page_no < area->n_pages) {
+        // skip over eight clean pages at a time
+        if (!(page_no & 7)) {
+            uint64_t word;
+            memcpy(&word, area->written_pages + page_no, sizeof(word));
+            if (!word) {
+                page_no += 8;
+                continue;
+            }
+        }
+        if (area->written_pages[page_no])
+            return page_no;
+        page_no++;
+    }
+    return area->n_pages;
+}
+
+#define DBG_REWIND_FOREACH_WRITTEN(area, page_no)                       \
+    for ((page_no) = dbg_rewind_next_written((area), 0);                \
+         (page_no) < (area)->n_pages;                                   \
+         (page_no) = dbg_rewind_next_written((area), (page_no) + 1))
+
+/*
+ * Bring the shadow up to date with every page written since it last was.  The
+ * old contents of each page that actually changed go into log, unless
+ * skip_logged is set and the page is already in there.
+ */
+static void dbg_rewind_collect(struct dbg_rewind_snap *log, bool skip_logged) {
+    unsigned area_no;
+    for (area_no = 0; area_no < DBG_REWIND_N_AREAS; area_no++) {
+        struct dbg_rewind_area *area = rw.areas + area_no;
+        unsigned page_no;
+        DBG_REWIND_FOREACH_WRITTEN(area, page_no) {
+            uint8_t *cur = dbg_rewind_page(area->mem, page_no);
+            uint8_t *shadow = dbg_rewind_page(area->shadow, page_no);
+
+            area->written_pages[page_no] = 0;
+            if (memcmp(cur, shadow, DBG_REWIND_PAGE_SIZE) == 0)
+                continue;
+
+            if (!skip_logged || !area->in_log[page_no]) {
+                dbg_rewind_log_page(log, DBG_REWIND_PAGE_ID(area_no, page_no),
+                                    shadow);
+                area->in_log[page_no] = 1;
+            }
+            memcpy(shadow, cur, DBG_REWIND_PAGE_SIZE);
+        }
+    }
+}
+
+// put every page written since the newest snapshot back the way it was
+static void dbg_rewind_revert_written(void) {
+    unsigned area_no;
+    for (area_no = 0; area_no < DBG_REWIND_N_AREAS; area_no++) {
+        struct dbg_rewind_area *area = rw.areas + area_no;
+        unsigned page_no;
+        DBG_REWIND_FOREACH_WRITTEN(area, page_no) {
+            area->written_pages[page_no] = 0;
+            memcpy(dbg_rewind_page(area->mem, page_no),
+                   dbg_rewind_page(area->shadow, page_no),
+                   DBG_REWIND_PAGE_SIZE);
+        }
+    }
+}
+
+// returns true if the system is exactly where the newest snapshot left it
+static bool dbg_rewind_at_newest(void) {
+    struct dbg_rewind_cpu_state cur;
+    dbg_rewind_get_cpu(&cur);
+    if (memcmp(&cur, &dbg_rewind_newest()->cpu, sizeof(cur)) != 0)
+        return false;
+
+    unsigned area_no;
+    for (area_no = 0; area_no < DBG_REWIND_N_AREAS; area_no++) {
+        struct dbg_rewind_area const *area = rw.areas + area_no;
+        unsigned page_no;
+        DBG_REWIND_FOREACH_WRITTEN(area, page_no) {
+            if (memcmp(dbg_rewind_page(area->mem, page_no),
+                       dbg_rewind_page(area->shadow, page_no),
+                       DBG_REWIND_PAGE_SIZE) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void dbg_rewind_set_position(struct dbg_rewind_snap const *snap) {
+    dbg_rewind_set_cpu(&snap->cpu);
+    rw.time_offs = clock_cycle_stamp(rw.clk) - snap->when;
+}
+
+static void dbg_rewind_revert_to_newest(void) {
+    dbg_rewind_revert_written();
+    dbg_rewind_set_position(dbg_rewind_newest());
+}
+
+// throw away the newest snapshot and go back to the one before it
+static void dbg_rewind_pop(void) {
+    dbg_rewind_revert_written();
+
+    rw.count--;
+    struct dbg_rewind_snap *snap = dbg_rewind_newest();
+
+    unsigned idx;
+    for (idx = 0; idx < snap->n_pages; idx++) {
+        unsigned page_id = snap->page_id[idx];
+        struct dbg_rewind_area *area =
+            rw.areas + DBG_REWIND_PAGE_ID_AREA(page_id);
+        unsigned page_no = DBG_REWIND_PAGE_ID_PAGE(page_id);
+        uint8_t const *src = dbg_rewind_page(snap->page_dat, idx);
+        memcpy(dbg_rewind_page(area->mem, page_no), src, DBG_REWIND_PAGE_SIZE);
+        memcpy(dbg_rewind_page(area->shadow, page_no), src,
+               DBG_REWIND_PAGE_SIZE);
+    }
+    dbg_rewind_free_pages(snap);
+
+    dbg_rewind_set_position(snap);
+}
+
+/*
+ * go back to the newest snapshot that's behind the current position.  *exact
+ * is set if that's exactly one instruction back.  Returns false if there's no
+ * such snapshot.
+ */
+static bool dbg_rewind_go_back(bool *exact) {
+    if (dbg_rewind_at_newest()) {
+        if (rw.count == 1)
+            return false;
+        *exact = dbg_rewind_nth(rw.count - 2)->next_is_step;
+        dbg_rewind_pop();
+    } else {
+        *exact = dbg_rewind_newest()->next_is_step;
+        dbg_rewind_revert_to_newest();
+    }
+    return true;
+}
+
+// the shadow and written_pages must already be up to date
+static void dbg_rewind_push(void) {
+    if (rw.count == rw.depth)
+        dbg_rewind_drop_oldest();
+
+    // keep at least the previous snapshot around even if it's over budget
+    while (rw.count > 1 && rw.n_bytes > rw.max_bytes &&
+           (!rw.replay.active || rw.replay.base_count > 1))
+        dbg_rewind_drop_oldest();
+
+    struct dbg_rewind_snap *snap = dbg_rewind_nth(rw.count);
+    memset(snap, 0, sizeof(*snap));
+    dbg_rewind_get_cpu(&snap->cpu);
+    snap->when = dbg_rewind_now();
+    rw.count++;
+}
+
+static bool dbg_rewind_init_area(struct dbg_rewind_area *area, uint8_t *mem,
+                                 uint8_t *written_pages, unsigned n_pages) {
+    area->mem = mem;
+    area->written_pages = written_pages;
+    area->n_pages = n_pages;
+    area->shadow = (uint8_t*)malloc((size_t)n_pages << DBG_REWIND_PAGE_SHIFT);
+    area->in_log = (uint8_t*)calloc(n_pages, sizeof(area->in_log[0]));
+    return area->shadow && area->in_log;
+}
+
+void dbg_rewind_init(struct Memory *mem, struct aica_wave_mem *wave_mem,
+                     struct Sh4 *sh4, struct arm7 *arm7,
+                     struct dc_clock *sh4_clock) {
+    int depth, period, max_mb;
+
+    memset(&rw, 0, sizeof(rw));
+
+    if (cfg_get_int("wash.dbg.rewind.depth", &depth) != 0)
+        depth = DBG_REWIND_DEFAULT_DEPTH;
+    if (cfg_get_int("wash.dbg.rewind.period", &period) != 0 || period < 0)
+        period = DBG_REWIND_DEFAULT_PERIOD;
+    if (cfg_get_int("wash.dbg.rewind.max-mb", &max_mb) != 0 || max_mb <= 0)
+        max_mb = DBG_REWIND_DEFAULT_MAX_MB;
+
+    if (depth <= 1) {
+        LOG_INFO("debugger rewind disabled\n");
+        return;
+    }
+
+    rw.ring = (struct dbg_rewind_snap*)calloc(depth, sizeof(rw.ring[0]));
+    if (!rw.ring ||
+        !dbg_rewind_init_area(rw.areas + DBG_REWIND_AREA_RAM, mem->mem,
+                              mem->written_pages, MEMORY_N_PAGES) ||
+        !dbg_rewind_init_area(rw.areas + DBG_REWIND_AREA_WAVE_MEM,
+                              wave_mem->mem, wave_mem->written_pages,
+                              AICA_WAVE_MEM_N_PAGES))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    rw.sh4 = sh4;
+    rw.arm7 = arm7;
+    rw.clk = sh4_clock;
+    rw.depth = depth;
+    rw.period = period;
+    rw.frames_until_snap = period;
+    rw.max_bytes = (size_t)max_mb << 20;
+    rw.enabled = true;
+
+    LOG_INFO("debugger rewind enabled: %u snapshots, one every %u frames "
+             "and one before every single-step\n", rw.depth, rw.period);
+}
+
+void dbg_rewind_cleanup(void) {
+    if (!rw.enabled)
+        return;
+
+    while (rw.count)
+        dbg_rewind_drop_oldest();
+
+    unsigned area_no;
+    for (area_no = 0; area_no < DBG_REWIND_N_AREAS; area_no++) {
+        free(rw.areas[area_no].in_log);
+        free(rw.areas[area_no].shadow);
+    }
+    free(rw.ring);
+    memset(&rw, 0, sizeof(rw));
+}
+
+bool dbg_rewind_enabled(void) {
+    return rw.enabled;
+}
+
+void dbg_rewind_on_frame(void) {
+    if (!rw.enabled || !rw.period || rw.replay.active)
+        return;
+
+    if (--rw.frames_until_snap == 0) {
+        dbg_rewind_snap();
+        rw.frames_until_snap = rw.period;
+    }
+}
+
+void dbg_rewind_on_step(void) {
+    if (!rw.enabled)
+        return;
+
+    dbg_rewind_snap();
+    dbg_rewind_newest()->next_is_step = true;
+}
+
+void dbg_rewind_on_continue(void) {
+    if (rw.enabled && rw.count)
+        dbg_rewind_newest()->next_is_step = false;
+}
+
+void dbg_rewind_snap(void) {
+    if (!rw.enabled || rw.replay.active)
+        return;
+
+    if (rw.count) {
+        // nothing to do if nothing happened since the newest snapshot
+        if (dbg_rewind_at_newest())
+            return;
+
+        /*
+         * save the old contents of every page that changed since the newest
+         * snapshot into that snapshot, and bring the shadow up to date.
+         */
+        dbg_rewind_collect(dbg_rewind_newest(), false);
+    } else {
+        unsigned area_no;
+        for (area_no = 0; area_no < DBG_REWIND_N_AREAS; area_no++) {
+            struct dbg_rewind_area *area = rw.areas + area_no;
+            memcpy(area->shadow, area->mem,
+                   (size_t)area->n_pages << DBG_REWIND_PAGE_SHIFT);
+            memset(area->written_pages, 0, area->n_pages);
+        }
+    }
+
+    dbg_rewind_push();
+}
+
+int dbg_rewind_step_back(void) {
+    bool exact;
+    if (!rw.enabled || !rw.count || rw.replay.active ||
+        !dbg_rewind_go_back(&exact))
+        return -1;
+    return 0;
+}
+
+static void
+dbg_rewind_replay_begin(enum dbg_rewind_replay_mode mode,
+                        struct dbg_rewind_cpu_state const *target,
+                        dc_cycle_stamp_t target_when, unsigned capture_period) {
+    struct dbg_rewind_replay *rp = &rw.replay;
+
+    if (target != &rp->target)
+        memcpy(&rp->target, target, sizeof(rp->target));
+    rp->active = true;
+    rp->mode = mode;
+    rp->target_when = target_when;
+    rp->base_count = rw.count;
+    rp->capture_period = capture_period;
+    rp->n_since_capture = 0;
+    rp->hit_break = false;
+    rp->tolerant = false;
+
+    // the snapshot the replay starts from is the newest, so its log is empty
+    unsigned area_no;
+    for (area_no = 0; area_no < DBG_REWIND_N_AREAS; area_no++)
+        memset(rw.areas[area_no].in_log, 0, rw.areas[area_no].n_pages);
+}
+
+/*
+ * take a snapshot of the current position in place of the last one the replay
+ * took, if any.  The pages that changed since then go into the log of the
+ * snapshot the replay started from, so that it still leads up to the new one.
+ */
+static void dbg_rewind_replay_capture(void) {
+    struct dbg_rewind_replay *rp = &rw.replay;
+    struct dbg_rewind_snap *base = dbg_rewind_replay_base();
+
+    // the newest snapshot never has a log of its own, so just drop it
+    if (rw.count > rp->base_count)
+        rw.count--;
+
+    dbg_rewind_collect(base, true);
+    rp->n_since_capture = 0;
+
+    // don't take a duplicate of the snapshot the replay started from
+    struct dbg_rewind_cpu_state cur;
+    dbg_rewind_get_cpu(&cur);
+    if (!base->n_pages && memcmp(&cur, &base->cpu, sizeof(cur)) == 0)
+        return;
+
+    dbg_rewind_push();
+}
+
+static void dbg_rewind_replay_land_on_base(void) {
+    if (rw.count > rw.replay.base_count)
+        dbg_rewind_pop();
+    else
+        dbg_rewind_revert_to_newest();
+    rw.replay.active = false;
+}
+
+// called when the replay gets back to its target
+static bool dbg_rewind_replay_arrive(void) {
+    struct dbg_rewind_replay *rp = &rw.replay;
+
+    if (rp->mode == DBG_REWIND_REPLAY_STEP) {
+        dbg_rewind_revert_to_newest();
+        if (rp->n_since_capture > 1) {
+            /*
+             * the newest snapshot is more than one instruction back, so go
+             * through the rest of the way again one instruction at a time.
+             */
+            bool tolerant = rp->tolerant;
+            dbg_rewind_replay_begin(DBG_REWIND_REPLAY_STEP, &rp->target,
+                                    rp->target_when, 1);
+            rp->tolerant = tolerant;
+            return dbg_rewind_replay_inst();
+        }
+        rp->active = false;
+        return true;
+    }
+
+    if (rp->hit_break) {
+        dbg_rewind_revert_to_newest();
+        rp->active = false;
+        return true;
+    }
+
+    if (rp->base_count == 1) {
+        LOG_INFO("reverse-continue reached the oldest snapshot without "
+                 "finding a breakpoint\n");
+        dbg_rewind_replay_land_on_base();
+        return true;
+    }
+
+    // no breakpoints since the base, so try the stretch leading up to it
+    struct dbg_rewind_snap *base = dbg_rewind_replay_base();
+    struct dbg_rewind_cpu_state target = base->cpu;
+    dc_cycle_stamp_t target_when = base->when;
+    dbg_rewind_revert_to_newest();
+    dbg_rewind_pop();
+    dbg_rewind_replay_begin(DBG_REWIND_REPLAY_BREAK, &target, target_when, 0);
+    return dbg_rewind_replay_inst();
+}
+
+enum dbg_rewind_status dbg_rewind_reverse_step(void) {
+    if (!rw.enabled || !rw.count || rw.replay.active)
+        return DBG_REWIND_NO_HISTORY;
+
+    struct dbg_rewind_cpu_state target;
+    dbg_rewind_get_cpu(&target);
+    dc_cycle_stamp_t target_when = dbg_rewind_now();
+
+    bool exact;
+    if (!dbg_rewind_go_back(&exact))
+        return DBG_REWIND_NO_HISTORY;
+    if (exact)
+        return DBG_REWIND_DONE;
+
+    dbg_rewind_replay_begin(DBG_REWIND_REPLAY_STEP, &target, target_when,
+                            DBG_REWIND_REPLAY_COARSE_PERIOD);
+    return dbg_rewind_replay_inst() ? DBG_REWIND_DONE : DBG_REWIND_REPLAYING;
+}
+
+enum dbg_rewind_status dbg_rewind_reverse_continue(void) {
+    if (!rw.enabled || !rw.count || rw.replay.active)
+        return DBG_REWIND_NO_HISTORY;
+
+    struct dbg_rewind_cpu_state target;
+    dbg_rewind_get_cpu(&target);
+    dc_cycle_stamp_t target_when = dbg_rewind_now();
+
+    bool exact;
+    if (!dbg_rewind_go_back(&exact))
+        return DBG_REWIND_NO_HISTORY;
+
+    dbg_rewind_replay_begin(DBG_REWIND_REPLAY_BREAK, &target, target_when, 0);
+    return dbg_rewind_replay_inst() ? DBG_REWIND_DONE : DBG_REWIND_REPLAYING;
+}
+
+static bool dbg_rewind_replay_at_target(dc_cycle_stamp_t elapsed,
+                                        dc_cycle_stamp_t span,
+                                        dc_cycle_stamp_t margin) {
+    struct dbg_rewind_replay const *rp = &rw.replay;
+    if (!rp->n_since_capture)
+        return false;
+    if (rp->tolerant ? elapsed + margin < span : elapsed != span)
+        return false;
+    return dbg_rewind_sh4_matches(&rp->target);
+}
+
+bool dbg_rewind_replay_inst(void) {
+    struct dbg_rewind_replay *rp = &rw.replay;
+    if (!rp->active)
+        return true;
+
+    dc_cycle_stamp_t base_when = dbg_rewind_replay_base()->when;
+    dc_cycle_stamp_t span = rp->target_when - base_when;
+    dc_cycle_stamp_t margin = span / 8 + DBG_REWIND_REPLAY_SLACK;
+    dc_cycle_stamp_t elapsed = dbg_rewind_now() - base_when;
+
+    if (dbg_rewind_replay_at_target(elapsed, span, margin))
+        return dbg_rewind_replay_arrive();
+
+    if (!rp->tolerant && elapsed > span) {
+        // missed it, so go back and try again less strictly
+        struct dbg_rewind_replay retry = *rp;
+        dbg_rewind_replay_land_on_base();
+        dbg_rewind_replay_begin(retry.mode, &retry.target, retry.target_when,
+                                retry.capture_period);
+        rp->tolerant = true;
+        return dbg_rewind_replay_inst();
+    }
+
+    if (elapsed > span + margin) {
+        LOG_WARN("debugger replay never made it back to PC 0x%08x; the rest "
+                 "of the hardware must have done something different this "
+                 "time\n", (unsigned)rp->target.sh4_reg[SH4_REG_PC]);
+        dbg_rewind_replay_land_on_base();
+        return true;
+    }
+
+    if (rp->mode == DBG_REWIND_REPLAY_STEP) {
+        if (rp->n_since_capture >= rp->capture_period)
+            dbg_rewind_replay_capture();
+    } else if (debug_is_break(DEBUG_CONTEXT_SH4, rw.sh4->reg[SH4_REG_PC])) {
+        dbg_rewind_replay_capture();
+        rp->hit_break = true;
+    }
+    rp->n_since_capture++;
+
+    return false;
+}
+
+void dbg_rewind_replay_abort(void) {
+    rw.replay.active = false;
+}
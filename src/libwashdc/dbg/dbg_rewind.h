@@ -0,0 +1,131 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef DBG_REWIND_H_
+#define DBG_REWIND_H_
+
+/*
+ * Ring buffer of snapshots used to let the debugger go backwards.
+ *
+ * A snapshot holds the SH4 and ARM7 execution state along with the contents of
+ * every page of main system memory and AICA wave memory that changed between
+ * that snapshot and the next one.  A shadow copy of both memories is kept as
+ * of the newest snapshot.  Everything that writes to either memory marks the
+ * pages it touched in that memory's written_pages map (see memory.h and
+ * aica_wave_mem.h), so a new snapshot only has to look at the marked pages:
+ * the old contents of each one come out of the shadow and go into the previous
+ * snapshot, and then the shadow is brought up to date.
+ *
+ * Snapshots are taken every wash.dbg.rewind.period frames and before every
+ * single-step.  Each snapshot remembers whether the position after it is
+ * exactly one instruction later, which is the case when the user single-stepped
+ * from it.  Stepping backwards from there just restores the snapshot.
+ *
+ * Otherwise the distance back to the previous snapshot isn't known, so it gets
+ * restored and execution is replayed forward through the interpreter until the
+ * SH4 gets back into the state it was in when the user asked to go backwards,
+ * on the same cycle it was there the first time.
+ * A reverse-step lands on the instruction right before that point, and a
+ * reverse-continue lands on the last breakpoint hit before it, replaying
+ * older stretches of history until it finds one.  Replay takes snapshots of
+ * its own along the way so that it has somewhere to land.
+ *
+ * The rest of the hardware (scheduler, timers, PVR2, AICA registers, etc) is
+ * NOT part of the snapshot, so a replay can diverge from what happened the
+ * first time.  If it misses that cycle it starts over and settles for the same
+ * SH4 state within a window of time around it, and if that doesn't work either
+ * it gives up and lands on the snapshot it started from.  This is meant for inspecting the program state leading up to
+ * a crash, not for deterministic replay.
+ *
+ * All of these functions must be called from the emulation thread.
+ */
+
+#include <stdbool.h>
+
+struct Memory;
+struct aica_wave_mem;
+struct Sh4;
+struct arm7;
+struct dc_clock;
+
+enum dbg_rewind_status {
+    // the system is at its new position
+    DBG_REWIND_DONE,
+
+    /*
+     * the system is at an older snapshot and has to replay forward to reach
+     * its new position; let the SH4 run its current instruction, and then
+     * call dbg_rewind_replay_inst before every instruction after that until
+     * it returns true.
+     */
+    DBG_REWIND_REPLAYING,
+
+    // there's no history to go back to, and nothing was changed
+    DBG_REWIND_NO_HISTORY
+};
+
+void dbg_rewind_init(struct Memory *mem, struct aica_wave_mem *wave_mem,
+                     struct Sh4 *sh4, struct arm7 *arm7,
+                     struct dc_clock *sh4_clock);
+void dbg_rewind_cleanup(void);
+
+// called at the end of every frame
+void dbg_rewind_on_frame(void);
+
+// push a new snapshot of the current state onto the ring
+void dbg_rewind_snap(void);
+
+// called before every single-step
+void dbg_rewind_on_step(void);
+
+// called when execution continues
+void dbg_rewind_on_continue(void);
+
+/*
+ * Go back to the newest snapshot, or to the one before it if the system is
+ * already at the newest snapshot.  Returns 0 on success, or nonzero if there's
+ * no more history to go back to.
+ */
+int dbg_rewind_step_back(void);
+
+// go back by exactly one SH4 instruction
+enum dbg_rewind_status dbg_rewind_reverse_step(void);
+
+/*
+ * go back to the last time the SH4 was about to execute an instruction with a
+ * breakpoint on it, or to the oldest snapshot if that never happened.
+ */
+enum dbg_rewind_status dbg_rewind_reverse_continue(void);
+
+/*
+ * called before every SH4 instruction during a replay.  Returns true once the
+ * replay is finished and the system is at its new position, in which case the
+ * instruction at the new PC hasn't executed yet.
+ */
+bool dbg_rewind_replay_inst(void);
+
+// stop replaying, and stay wherever the system is right now
+void dbg_rewind_replay_abort(void);
+
+bool dbg_rewind_enabled(void);
+
+#endif
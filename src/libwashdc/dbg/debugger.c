@@ -32,9 +32,12 @@
 #include "washdc/fifo.h"
 #include "washdc/MemoryMap.h"
 #include "hw/arm7/arm7.h"
+#include "jit/code_cache.h"
 #include "compiler_bullshit.h"
 
 #include "washdc/debugger.h"
+#include "dbg_rewind.h"
+#include "pace.h"
 
 #ifdef ENABLE_MMU
 #include "hw/sh4/sh4_mem.h"
@@ -67,9 +70,19 @@ struct debug_context {
 #endif
 
     struct breakpoint breakpoints[DEBUG_N_BREAKPOINTS];
+    unsigned n_breakpoints;
+
     struct watchpoint w_watchpoints[DEBUG_N_W_WATCHPOINTS];
     struct watchpoint r_watchpoints[DEBUG_N_R_WATCHPOINTS];
 
+#ifdef ENABLE_WATCHPOINTS
+    // DEBUG_WATCH_PAGE_R/DEBUG_WATCH_PAGE_W flags for every page
+    uint8_t watch_pages[DEBUG_WATCH_N_PAGES];
+
+    // nonzero whenever cur_state is not DEBUG_STATE_NORM
+    int jit_break;
+#endif
+
     // when a watchpoint gets triggered, at_watchpoint is set to true
     // and the memory address is placed in watchpoint_addr
     addr32_t watchpoint_addr;
@@ -125,6 +138,14 @@ struct debugger {
      * debug_request_detach is called from outside of the emu thread
      */
     washdc_atomic_flag not_detach;
+
+    /*
+     * these get cleared by debug_request_reverse_step and
+     * debug_request_reverse_continue.  They're called from outside of the emu
+     * thread.
+     */
+    washdc_atomic_flag not_reverse_step;
+    washdc_atomic_flag not_reverse_continue;
 };
 
 static struct debugger dbg;
@@ -150,6 +171,8 @@ static void frontend_run_once(void);
 #ifdef ENABLE_WATCHPOINTS
 static void frontend_on_read_watchpoint(addr32_t addr);
 static void frontend_on_write_watchpoint(addr32_t addr);
+
+static void dbg_update_watch_pages(enum dbg_context_id id);
 #endif
 
 #ifdef DEBUGGER_LOG_VERBOSE
@@ -163,6 +186,15 @@ WASHDC_UNUSED static char const *cur_ctx_str(void);
 
 static addr32_t dbg_get_pc(enum dbg_context_id id);
 
+static void dbg_on_code_change(enum dbg_context_id id);
+
+static void dbg_do_reverse(bool to_break);
+static void dbg_end_reverse(void);
+
+#ifdef ENABLE_DBG_COND
+static bool debug_have_conditions(enum dbg_context_id id);
+#endif
+
 void debug_init(void) {
     memset(&dbg, 0, sizeof(dbg));
 
@@ -172,6 +204,8 @@ void debug_init(void) {
     washdc_atomic_flag_test_and_set(&dbg.not_request_break);
     washdc_atomic_flag_test_and_set(&dbg.not_continue);
     washdc_atomic_flag_test_and_set(&dbg.not_detach);
+    washdc_atomic_flag_test_and_set(&dbg.not_reverse_step);
+    washdc_atomic_flag_test_and_set(&dbg.not_reverse_continue);
 
     unsigned ctx_no;
     for (ctx_no = 0; ctx_no < NUM_DEBUG_CONTEXTS; ctx_no++)
@@ -214,6 +248,19 @@ static void debug_check_break(enum dbg_context_id id) {
         (ctx->cur_state == DEBUG_STATE_WATCH))
         return;
 
+    if (ctx->cur_state == DEBUG_STATE_REPLAY) {
+        if (user_break) {
+            // stay wherever the replay got to
+            dbg_rewind_replay_abort();
+            dbg_end_reverse();
+            dc_state_transition(DC_STATE_DEBUG, DC_STATE_RUNNING);
+        } else if (id == DEBUG_CONTEXT_SH4 && dbg_rewind_replay_inst()) {
+            dbg_end_reverse();
+            dc_state_transition(DC_STATE_DEBUG, DC_STATE_RUNNING);
+        }
+        return;
+    }
+
     if (ctx->cur_state == DEBUG_STATE_STEP) {
         dbg_state_transition(DEBUG_STATE_BREAK);
         frontend_on_break();
@@ -267,6 +314,7 @@ void debug_notify_inst(void) {
 
 void debug_request_detach(void) {
     washdc_atomic_flag_clear(&dbg.not_detach);
+    pace_wake();
 }
 
 int debug_add_break(enum dbg_context_id id, addr32_t addr) {
@@ -277,6 +325,8 @@ int debug_add_break(enum dbg_context_id id, addr32_t addr) {
         if (!ctx->breakpoints[idx].enabled) {
             ctx->breakpoints[idx].addr = addr;
             ctx->breakpoints[idx].enabled = true;
+            ctx->n_breakpoints++;
+            dbg_on_code_change(id);
             return 0;
         }
 
@@ -294,6 +344,8 @@ int debug_remove_break(enum dbg_context_id id, addr32_t addr) {
         if (ctx->breakpoints[idx].enabled &&
             ctx->breakpoints[idx].addr == addr) {
             ctx->breakpoints[idx].enabled = false;
+            ctx->n_breakpoints--;
+            dbg_on_code_change(id);
             return 0;
         }
 
@@ -302,6 +354,41 @@ int debug_remove_break(enum dbg_context_id id, addr32_t addr) {
     return EINVAL;
 }
 
+bool debug_is_break(enum dbg_context_id id, addr32_t addr) {
+    struct debug_context const *ctx = dbg.contexts + id;
+    if (!ctx->n_breakpoints)
+        return false;
+    for (unsigned idx = 0; idx < DEBUG_N_BREAKPOINTS; idx++)
+        if (ctx->breakpoints[idx].enabled && ctx->breakpoints[idx].addr == addr)
+            return true;
+    return false;
+}
+
+bool debug_can_jit(enum dbg_context_id id) {
+    struct debug_context const *ctx = dbg.contexts + id;
+
+    if (ctx->cur_state != DEBUG_STATE_NORM)
+        return false;
+
+#ifdef ENABLE_DBG_COND
+    if (debug_have_conditions(id))
+        return false;
+#endif
+
+    return true;
+}
+
+/*
+ * called whenever something changes that the JIT would have compiled into
+ * its code blocks.  Only the SH4 has a JIT.
+ */
+static void dbg_on_code_change(enum dbg_context_id id) {
+    if (id == DEBUG_CONTEXT_SH4) {
+        Sh4 *sh4 = (Sh4*)dbg.contexts[id].cpu;
+        code_cache_invalidate_all(sh4->code_cache);
+    }
+}
+
 // these functions return 0 on success, nonzero on failure
 int debug_add_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
     DBG_TRACE("request to add read-watchpoint at 0x%08x\n", (unsigned)addr);
@@ -314,6 +401,7 @@ int debug_add_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
             wp->addr = addr;
             wp->len = len;
             wp->enabled = true;
+            dbg_update_watch_pages(id);
             return 0;
         }
     }
@@ -334,6 +422,7 @@ int debug_remove_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
         struct watchpoint *wp = ctx->r_watchpoints + idx;
         if (wp->enabled && wp->addr == addr && wp->len == len) {
             wp->enabled = false;
+            dbg_update_watch_pages(id);
             return 0;
         }
     }
@@ -356,6 +445,7 @@ int debug_add_w_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
             wp->addr = addr;
             wp->len = len;
             wp->enabled = true;
+            dbg_update_watch_pages(id);
             return 0;
         }
     }
@@ -376,6 +466,7 @@ int debug_remove_w_watch(enum dbg_context_id id, addr32_t addr, unsigned len) {
         struct watchpoint *wp = ctx->w_watchpoints + idx;
         if (wp->enabled && wp->addr == addr && wp->len == len) {
             wp->enabled = false;
+            dbg_update_watch_pages(id);
             return 0;
         }
     }
@@ -392,6 +483,11 @@ bool debug_is_w_watch(addr32_t addr, unsigned len) {
     if (ctx->cur_state != DEBUG_STATE_NORM)
         return false;
 
+#ifdef ENABLE_WATCHPOINTS
+    if (!debug_is_watch_page(dbg.cur_ctx, addr, len, DEBUG_WATCH_PAGE_W))
+        return false;
+#endif
+
     addr32_t access_first = addr;
     addr32_t access_last = addr + (len - 1);
 
@@ -424,6 +520,11 @@ bool debug_is_r_watch(addr32_t addr, unsigned len) {
     if (ctx->cur_state != DEBUG_STATE_NORM)
 	return false;
 
+#ifdef ENABLE_WATCHPOINTS
+    if (!debug_is_watch_page(dbg.cur_ctx, addr, len, DEBUG_WATCH_PAGE_R))
+        return false;
+#endif
+
     addr32_t access_first = addr;
     addr32_t access_last = addr + (len - 1);
 
@@ -450,6 +551,64 @@ bool debug_is_r_watch(addr32_t addr, unsigned len) {
     return false;
 }
 
+#ifdef ENABLE_WATCHPOINTS
+static void dbg_mark_watch_pages(struct debug_context *ctx,
+                                 struct watchpoint const *wp, uint8_t flag) {
+    if (!wp->enabled || !wp->len)
+        return;
+
+    addr32_t first = wp->addr & DEBUG_WATCH_ADDR_MASK;
+    addr32_t last = (wp->addr + (wp->len - 1)) & DEBUG_WATCH_ADDR_MASK;
+    unsigned page = first >> DEBUG_WATCH_PAGE_SHIFT;
+    unsigned last_page = last >> DEBUG_WATCH_PAGE_SHIFT;
+
+    // the range can wrap around the end of the mask
+    for (;;) {
+        ctx->watch_pages[page] |= flag;
+        if (page == last_page)
+            break;
+        page = (page + 1) % DEBUG_WATCH_N_PAGES;
+    }
+}
+
+/*
+ * rebuild the page map from scratch.  There are only a handful of
+ * watchpoints, so this is cheaper than keeping reference counts on pages.
+ */
+static void dbg_update_watch_pages(enum dbg_context_id id) {
+    struct debug_context *ctx = dbg.contexts + id;
+    memset(ctx->watch_pages, 0, sizeof(ctx->watch_pages));
+
+    unsigned idx;
+    for (idx = 0; idx < DEBUG_N_R_WATCHPOINTS; idx++)
+        dbg_mark_watch_pages(ctx, ctx->r_watchpoints + idx,
+                             DEBUG_WATCH_PAGE_R);
+    for (idx = 0; idx < DEBUG_N_W_WATCHPOINTS; idx++)
+        dbg_mark_watch_pages(ctx, ctx->w_watchpoints + idx,
+                             DEBUG_WATCH_PAGE_W);
+
+    // the JIT may have inlined accesses to pages that are now being watched
+    dbg_on_code_change(id);
+}
+
+uint8_t const *debug_watch_pages(enum dbg_context_id id) {
+    return dbg.contexts[id].watch_pages;
+}
+
+int const *debug_jit_break_flag(enum dbg_context_id id) {
+    return &dbg.contexts[id].jit_break;
+}
+
+bool debug_is_watch_page(enum dbg_context_id id, addr32_t addr,
+                         unsigned len, unsigned type) {
+    uint8_t const *pages = dbg.contexts[id].watch_pages;
+    unsigned first = (addr & DEBUG_WATCH_ADDR_MASK) >> DEBUG_WATCH_PAGE_SHIFT;
+    unsigned last = ((addr + (len - 1)) & DEBUG_WATCH_ADDR_MASK) >>
+        DEBUG_WATCH_PAGE_SHIFT;
+    return (pages[first] | pages[last]) & type;
+}
+#endif
+
 void debug_on_softbreak(cpu_inst_param inst, addr32_t pc) {
     DBG_TRACE("softbreak at 0x%08x\n", (unsigned)pc);
     dbg_state_transition(DEBUG_STATE_BREAK);
@@ -470,6 +629,8 @@ void debug_attach(struct debug_frontend const *frontend) {
     washdc_atomic_flag_test_and_set(&dbg.not_request_break);
     washdc_atomic_flag_test_and_set(&dbg.not_continue);
     washdc_atomic_flag_test_and_set(&dbg.not_detach);
+    washdc_atomic_flag_test_and_set(&dbg.not_reverse_step);
+    washdc_atomic_flag_test_and_set(&dbg.not_reverse_continue);
 
     unsigned ctx_no;
     for (ctx_no = 0; ctx_no < NUM_DEBUG_CONTEXTS; ctx_no++)
@@ -560,14 +721,72 @@ unsigned debug_bank1_reg_idx(enum dbg_context_id id, unsigned reg_sr, unsigned i
 
 void debug_request_continue(void) {
     washdc_atomic_flag_clear(&dbg.not_continue);
+    pace_wake();
 }
 
 void debug_request_single_step(void) {
     washdc_atomic_flag_clear(&get_ctx()->not_single_step);
+    pace_wake();
 }
 
 void debug_request_break() {
     washdc_atomic_flag_clear(&dbg.not_request_break);
+    pace_wake();
+}
+
+void debug_request_reverse_step(void) {
+    washdc_atomic_flag_clear(&dbg.not_reverse_step);
+    pace_wake();
+}
+
+void debug_request_reverse_continue(void) {
+    washdc_atomic_flag_clear(&dbg.not_reverse_continue);
+    pace_wake();
+}
+
+static void dbg_do_reverse(bool to_break) {
+    enum dbg_rewind_status status;
+
+    if (dbg.cur_ctx != DEBUG_CONTEXT_SH4) {
+        // replay only follows the SH4, so just go back one snapshot
+        status = dbg_rewind_step_back() == 0 ?
+            DBG_REWIND_DONE : DBG_REWIND_NO_HISTORY;
+    } else if (to_break) {
+        status = dbg_rewind_reverse_continue();
+    } else {
+        status = dbg_rewind_reverse_step();
+    }
+
+    switch (status) {
+    case DBG_REWIND_DONE:
+        dbg_end_reverse();
+        break;
+    case DBG_REWIND_REPLAYING:
+        /*
+         * let the system run; debug_check_break takes it from here and breaks
+         * once the replay is done.  Replay runs in the interpreter, but the
+         * JIT may have compiled code out of memory that just got rolled back.
+         */
+        dbg_on_code_change(DEBUG_CONTEXT_SH4);
+        dbg_state_transition(DEBUG_STATE_REPLAY);
+        dc_state_transition(DC_STATE_RUNNING, DC_STATE_DEBUG);
+        break;
+    default:
+        LOG_WARN("debugger has no history to rewind to\n");
+        dbg_state_transition(DEBUG_STATE_BREAK);
+        frontend_on_break();
+    }
+}
+
+// called once a reverse-step or reverse-continue is at its final position
+static void dbg_end_reverse(void) {
+    // memory got rolled back, so whatever the JIT compiled may be stale
+    dbg_on_code_change(DEBUG_CONTEXT_SH4);
+    LOG_INFO("debugger rewound to PC 0x%08x\n",
+             (unsigned)dbg_get_pc(dbg.cur_ctx));
+
+    dbg_state_transition(DEBUG_STATE_BREAK);
+    frontend_on_break();
 }
 
 #ifdef DEBUGGER_LOG_VERBOSE
@@ -593,7 +812,8 @@ dbg_state_names[DEBUG_STATE_COUNT] = {
     "DEBUG_STATE_BREAK",
     "DEBUG_STATE_PRE_WATCH",
     "DEBUG_STATE_WATCH",
-    "DEBUG_STATE_POST_WATCH"
+    "DEBUG_STATE_POST_WATCH",
+    "DEBUG_STATE_REPLAY"
 };
 #endif
 
@@ -602,10 +822,12 @@ static void dbg_state_transition(enum debug_state new_state) {
     DBG_TRACE("state transition from %s to %s\n",
               dbg_state_names[ctx->cur_state], dbg_state_names[new_state]);
     ctx->cur_state = new_state;
+#ifdef ENABLE_WATCHPOINTS
+    ctx->jit_break = (new_state != DEBUG_STATE_NORM);
+#endif
 }
 
 static washdc_mutex debug_mutex = WASHDC_MUTEX_STATIC_INIT;
-static washdc_cvar debug_cond = WASHDC_CVAR_STATIC_INIT;
 
 void debug_lock(void) {
     washdc_mutex_lock(&debug_mutex);
@@ -616,7 +838,7 @@ void debug_unlock(void) {
 }
 
 void debug_signal(void) {
-    washdc_cvar_signal(&debug_cond);
+    pace_wake();
 }
 
 void debug_run_once(void) {
@@ -630,13 +852,21 @@ void debug_run_once(void) {
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
+    if (!washdc_atomic_flag_test_and_set(&dbg.not_reverse_step))
+        dbg_do_reverse(false);
+
+    if (!washdc_atomic_flag_test_and_set(&dbg.not_reverse_continue))
+        dbg_do_reverse(true);
+
     if (!washdc_atomic_flag_test_and_set(&ctx->not_single_step)) {
         // gdb frontend requested a single-step via debug_request_single_step
+        dbg_rewind_on_step();
         dbg_state_transition(DEBUG_STATE_STEP);
         dc_state_transition(DC_STATE_RUNNING, DC_STATE_DEBUG);
     }
 
     if (!washdc_atomic_flag_test_and_set(&dbg.not_continue)) {
+        dbg_rewind_on_continue();
         if (ctx->cur_state == DEBUG_STATE_WATCH)
             dbg_state_transition(DEBUG_STATE_POST_WATCH);
         else
@@ -654,6 +884,11 @@ void debug_run_once(void) {
             memset(ctx->breakpoints, 0, sizeof(ctx->breakpoints));
             memset(ctx->r_watchpoints, 0, sizeof(ctx->r_watchpoints));
             memset(ctx->w_watchpoints, 0, sizeof(ctx->w_watchpoints));
+            ctx->n_breakpoints = 0;
+#ifdef ENABLE_WATCHPOINTS
+            memset(ctx->watch_pages, 0, sizeof(ctx->watch_pages));
+#endif
+            dbg_on_code_change((enum dbg_context_id)ctx_no);
         }
 
         dbg_state_transition(DEBUG_STATE_NORM);
@@ -787,6 +1022,14 @@ int debug_read_mem(enum dbg_context_id id, void *out,
     }
 #endif
 
+    /*
+     * if the whole range sits in a single region that supports block
+     * transfers (main RAM, texture memory) then service it with one copy
+     * instead of going through the per-unit handlers.
+     */
+    if (memory_map_try_read_raw(mmap, addr, out, len) == 0)
+        return 0;
+
     int err;
     while (n_units) {
         switch (unit_len) {
@@ -825,6 +1068,9 @@ int debug_write_mem(enum dbg_context_id id, void const *input,
     DBG_TRACE("request to write %u bytes to 0x%08x\n",
               (unsigned)len, (unsigned)addr);
 
+    // the write might overwrite code which the JIT has already compiled
+    dbg_on_code_change(id);
+
 #ifdef ENABLE_MMU
     if (ctxt->at_mode) {
         if (id != DEBUG_CONTEXT_SH4) {
@@ -844,6 +1090,9 @@ int debug_write_mem(enum dbg_context_id id, void const *input,
     }
 #endif
 
+    if (memory_map_try_write_raw(mmap, addr, input, len) == 0)
+        return 0;
+
     /*
      * Ideally none of the writes would go through if there's a
      * failure at any point down the line, but that's not the way I've
@@ -1088,6 +1337,15 @@ void debug_check_conditions(enum dbg_context_id ctx) {
             return;
 }
 
+static bool debug_have_conditions(enum dbg_context_id id) {
+    int idx;
+    for (idx = 0; idx < N_DEBUG_CONDITIONS; idx++)
+        if (conditions[idx].cond_tp != DEBUG_CONDITION_NONE &&
+            conditions[idx].ctx == id)
+            return true;
+    return false;
+}
+
 bool debug_reg_cond(enum dbg_context_id ctx, unsigned reg_no,
                     uint32_t reg_val) {
     int idx;
@@ -22,13 +22,6 @@
 
 #include "real_ticks.h"
 
-// need this for usleep on posix, Sleep on windows
-#ifdef _MSC_VER
-#include "i_hate_windows.h"
-#else
-#include <unistd.h>
-#endif
-
 #include <errno.h>
 #include <time.h>
 #include <signal.h>
@@ -49,18 +42,21 @@
 #include "hw/maple/maple.h"
 #include "hw/maple/maple_device.h"
 #include "hw/maple/maple_controller.h"
+#include "hw/maple/maple_movie.h"
 #include "hw/pvr2/framebuffer.h"
 #include "hw/pvr2/pvr2_tex_mem.h"
 #include "hw/pvr2/pvr2_ta.h"
 #include "log.h"
 #include "hw/sh4/sh4_read_inst.h"
 #include "hw/sh4/sh4_jit.h"
+#include "hw/sh4/sh4_difftest.h"
 #include "hw/pvr2/pvr2.h"
 #include "hw/pvr2/pvr2_reg.h"
 #include "hw/pvr2/pvr2_yuv.h"
 #include "hw/sys/sys_block.h"
 #include "hw/aica/aica.h"
 #include "hw/aica/aica_rtc.h"
+#include "hw/aica/aica_thread.h"
 #include "hw/g1/g1.h"
 #include "hw/g1/g1_reg.h"
 #include "hw/g2/g2.h"
@@ -72,6 +68,7 @@
 #include "jit/jit_intp/code_block_intp.h"
 #include "jit/code_cache.h"
 #include "jit/jit.h"
+#include "jit/jit_sample.h"
 #include "hw/boot_rom.h"
 #include "hw/arm7/arm7.h"
 #include "title.h"
@@ -79,72 +76,136 @@
 #include "mount.h"
 #include "cdi.h"
 #include "gdi.h"
+#include "wdci.h"
 #include "washdc/win.h"
 #include "washdc/sound_intf.h"
 #include "sound.h"
 #include "washdc/hostfile.h"
 #include "hw/sys/holly_intc.h"
+#include "trace.h"
 
 #ifdef ENABLE_TCP_SERIAL
 #include "serial_server.h"
 #endif
 
+#ifdef ENABLE_DEBUGGER
+#include "dbg/dbg_rewind.h"
+#endif
+
 #ifdef ENABLE_JIT_X86_64
 #include "jit/x86_64/native_dispatch.h"
 #include "jit/x86_64/native_mem.h"
 #include "jit/x86_64/exec_mem.h"
 #endif
 
+#ifdef ENABLE_JIT_PERF
+#include "jit/x86_64/jit_perf.h"
+#endif
+
+#include "bench.h"
+#include "frame_hash.h"
+#include "pace.h"
 #include "dreamcast.h"
 
-static struct Sh4 cpu;
-static struct Memory dc_mem;
-static struct memory_map mem_map;
-static struct boot_rom firmware;
-static struct flash_mem flash_mem;
-static struct aica_rtc rtc;
-static struct arm7 arm7;
-static struct memory_map arm7_mem_map;
-static struct aica aica;
-static struct gdrom_ctxt gdrom;
-static struct pvr2 dc_pvr2;
-static struct maple maple;
-static struct sys_block_ctxt sys_block;
+enum TermReason {
+    TERM_REASON_NORM,   // normal program exit
+    TERM_REASON_SIGINT, // received SIGINT
+    TERM_REASON_ERROR   // usually this means somebody threw a c++ exception
+};
 
-static washdc_atomic_int is_running;
-static washdc_atomic_int signal_exit_threads;
+/*
+ * everything that makes up one emulated Dreamcast.  This is opaque outside of
+ * this file; the frontend only ever sees a pointer to it.
+ */
+struct washdc_instance {
+    struct Sh4 cpu;
+    struct Memory dc_mem;
+    struct memory_map mem_map;
+    struct boot_rom firmware;
+    struct flash_mem flash_mem;
+    struct aica_rtc rtc;
+    struct arm7 arm7;
+    struct memory_map arm7_mem_map;
+    struct aica aica;
+    struct gdrom_ctxt gdrom;
+    struct pvr2 dc_pvr2;
+    struct maple maple;
+    struct sys_block_ctxt sys_block;
+
+    struct dc_clock arm7_clock;
+    struct dc_clock sh4_clock;
+
+    // SH4 code blocks compiled by the JIT
+    struct code_cache code_cache;
 
-static bool frame_stop;
-static bool init_complete;
-static bool end_of_frame;
+#ifdef ENABLE_JIT_X86_64
+    struct native_dispatch_meta sh4_native_dispatch_meta;
 
-static bool using_debugger;
+    // everything the native JIT emits lives in here
+    struct exec_mem exec_mem;
+#endif
 
-static washdc_real_time last_frame_realtime;
-static dc_cycle_stamp_t last_frame_virttime;
+    washdc_atomic_int is_running;
+    washdc_atomic_int signal_exit_threads;
 
-static struct memory_interface sh4_unmapped_mem;
-static struct memory_interface arm7_unmapped_mem;
+    // this gets set from outside of the emulation thread by dc_set_turbo
+    washdc_atomic_int turbo_enabled;
 
-#ifdef ENABLE_JIT_X86_64
-static struct native_dispatch_meta sh4_native_dispatch_meta;
-#endif
+    /*
+     * in turbo mode only one out of every turbo_interval frames gets
+     * presented.  turbo_frame_no counts up to turbo_interval and then wraps
+     * back around to 0, which is the frame that gets presented.  Renders that
+     * only go to the screen are skipped except on that frame and the one
+     * before it, since a double-buffered game displays what it rendered on
+     * the previous frame.
+     */
+    unsigned turbo_interval;
+    unsigned turbo_frame_no;
 
-enum TermReason {
-    TERM_REASON_NORM,   // normal program exit
-    TERM_REASON_SIGINT, // received SIGINT
-    TERM_REASON_ERROR   // usually this means somebody threw a c++ exception
-};
+    // if this is set, the ARM7 and AICA run on a separate thread
+    bool use_aica_thread;
 
-// this stores the reason the dreamcast suspended execution
-enum TermReason term_reason = TERM_REASON_NORM;
+    bool frame_stop;
+    bool init_complete;
+    bool end_of_frame;
 
-static enum dc_state dc_state = DC_STATE_NOT_RUNNING;
+    bool using_debugger;
 
-struct dc_clock arm7_clock;
-struct dc_clock sh4_clock;
+    washdc_real_time last_frame_realtime;
+    dc_cycle_stamp_t last_frame_virttime;
 
-static unsigned frame_count;
+    /*
+     * this is used to store the irl timestamp right before execution begins.
+     * This exists for performance profiling purposes only.
+     */
+    washdc_real_time start_time;
+
+    // this stores the reason the dreamcast suspended execution
+    enum TermReason term_reason;
+
+    enum dc_state dc_state;
+
+    unsigned frame_count;
+
+    int lmmode0, lmmode1;
+
+    struct SchedEvent periodic_event;
+
+    struct washdc_overlay_intf const *overlay_intf;
+    struct debug_frontend const *dbg_intf;
+    struct serial_server_intf const *sersrv;
+};
+
+/*
+ * The instance that the rest of libwashdc is hooked up to.  The schedulers,
+ * interrupt controllers and most other hardware modules outside of this file
+ * still keep their state in globals, so only one instance can exist at a
+ * time.
+ */
+static struct washdc_instance *dc;
+
+static struct memory_interface sh4_unmapped_mem;
+static struct memory_interface arm7_unmapped_mem;
 
 static void dc_sigint_handler(int param);
 
@@ -158,8 +219,7 @@ static bool run_to_next_sh4_event(void *ctxt);
 static bool run_to_next_sh4_event_jit(void *ctxt);
 
 static bool run_to_next_arm7_event(void *ctxt);
-
-static int lmmode0, lmmode1;
+static bool run_to_next_arm7_event_thread(void *ctxt);
 
 #ifdef ENABLE_JIT_X86_64
 static bool run_to_next_sh4_event_jit_native(void *ctxt);
@@ -173,6 +233,10 @@ static void dreamcast_enable_debugger(void);
 static bool dreamcast_check_debugger(void);
 
 static bool run_to_next_sh4_event_debugger(void *ctxt);
+static bool run_to_next_sh4_event_jit_debugger(void *ctxt);
+#ifdef ENABLE_JIT_X86_64
+static bool run_to_next_sh4_event_jit_native_debugger(void *ctxt);
+#endif
 
 static bool run_to_next_arm7_event_debugger(void *ctxt);
 
@@ -185,14 +249,19 @@ static void suspend_loop(void);
 
 static void dc_inject_irq(char const *id);
 
-void washdc_dump_main_memory(char const *path) {
+void washdc_dump_main_memory(struct washdc_instance *inst, char const *path) {
     FILE *outfile = fopen(path, "wb");
     if (outfile) {
-        fwrite(dc_mem.mem, sizeof(dc_mem.mem), 1, outfile);
+        fwrite(inst->dc_mem.mem, sizeof(inst->dc_mem.mem), 1, outfile);
         fclose(outfile);
     }
 }
 
+void dc_dump_main_memory(char const *path) {
+    if (dc)
+        washdc_dump_main_memory(dc, path);
+}
+
 /*
  * XXX this used to be (SCHED_FREQUENCY / 10).  Now it's (SCHED_FREQUENCY / 100)
  * because programs that use the serial port (like KallistiOS) can timeout if
@@ -205,35 +274,31 @@ void washdc_dump_main_memory(char const *path) {
 #define DC_PERIODIC_EVENT_PERIOD (SCHED_FREQUENCY / 100)
 
 static void periodic_event_handler(struct SchedEvent *event);
-static struct SchedEvent periodic_event;
-
-static struct washdc_overlay_intf const *overlay_intf;
-static struct debug_frontend const *dbg_intf;
-static struct serial_server_intf const *sersrv;
 
 static void dc_get_sndchan_stat(struct washdc_snddev const *dev,
                                 unsigned ch_no,
                                 struct washdc_sndchan_stat *stat) {
-    aica_get_sndchan_stat(&aica, ch_no, stat);
+    if (aica_thread_running())
+        aica_thread_get_sndchan_stat(ch_no, stat);
+    else
+        aica_get_sndchan_stat(&dc->aica, ch_no, stat);
 }
 
 static void dc_get_sndchan_var(struct washdc_snddev const *dev,
                                struct washdc_sndchan_stat const *chan,
                                unsigned var_no, struct washdc_var *var) {
-    aica_get_sndchan_var(&aica, chan, var_no, var);
+    if (aica_thread_running())
+        aica_thread_get_sndchan_var(chan, var_no, var);
+    else
+        aica_get_sndchan_var(&dc->aica, chan, var_no, var);
 }
 
 static void dc_mute_sndchan(struct washdc_snddev const *dev,
                             unsigned chan_no, bool is_muted) {
-    aica_mute_chan(&aica, chan_no, is_muted);
-}
-
-static inline void washdc_sleep_ms(unsigned n_ms) {
-#ifdef _MSC_VER
-    Sleep(n_ms);
-#else
-    usleep(n_ms * 1000);
-#endif
+    if (aica_thread_running())
+        aica_thread_mute_chan(chan_no, is_muted);
+    else
+        aica_mute_chan(&dc->aica, chan_no, is_muted);
 }
 
 static void dc_inject_irq(char const *id) {
@@ -283,7 +348,7 @@ static void dc_get_texinfo(struct washdc_texcache const *cache,
                            unsigned tex_no, struct washdc_texinfo *texinfo) {
     struct pvr2_tex_meta meta;
     if (tex_no < PVR2_TEX_CACHE_SIZE &&
-        pvr2_tex_get_meta(&dc_pvr2, &meta, tex_no) == 0) {
+        pvr2_tex_get_meta(&dc->dc_pvr2, &meta, tex_no) == 0) {
         texinfo->idx = tex_no;
         texinfo->valid = true;
         texinfo->n_vars = 12;
@@ -327,7 +392,7 @@ static void dc_get_texinfo_var(struct washdc_texcache const *cache,
                                struct washdc_var *var) {
     struct pvr2_tex_meta meta;
     if (!texinfo->valid ||
-        pvr2_tex_get_meta(&dc_pvr2, &meta, texinfo->idx) != 0)
+        pvr2_tex_get_meta(&dc->dc_pvr2, &meta, texinfo->idx) != 0)
         goto inval;
 
     switch (var_no) {
@@ -477,7 +542,7 @@ static struct washdc_gameconsole dccons = {
     .do_inject_irq = dc_inject_irq
 };
 
-struct washdc_gameconsole const*
+struct washdc_instance *
 dreamcast_init(char const *gdi_path,
                struct rend_if const *gfx_if,
                struct washdc_overlay_intf const *overlay_intf_fns,
@@ -487,11 +552,21 @@ dreamcast_init(char const *gdi_path,
                bool flash_mem_writeable) {
     int win_width, win_height;
 
-    frame_count = 0;
+    if (dc) {
+        error_set_feature("more than one washdc_instance at a time");
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    dc = (struct washdc_instance*)calloc(1, sizeof(*dc));
+    if (!dc)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
 
-    overlay_intf = overlay_intf_fns;
-    dbg_intf = dbg_frontend;
-    sersrv = ser_intf;
+    dc->term_reason = TERM_REASON_NORM;
+    dc->dc_state = DC_STATE_NOT_RUNNING;
+
+    dc->overlay_intf = overlay_intf_fns;
+    dc->dbg_intf = dbg_frontend;
+    dc->sersrv = ser_intf;
 
     log_init(config_get_log_stdout(), config_get_log_verbose());
 
@@ -502,6 +577,8 @@ dreamcast_init(char const *gdi_path,
         char const *ext = strrchr(gdi_path, '.');
         if (ext && strcmp(ext, ".cdi") == 0) // TODO: case-sensitive
             mount_cdi(gdi_path);
+        else if (ext && strcmp(ext, ".wdci") == 0)
+            mount_wdci(gdi_path);
         else
             mount_gdi(gdi_path);
         if (mount_get_meta(&content_meta) == 0) {
@@ -529,13 +606,38 @@ dreamcast_init(char const *gdi_path,
     title_set_content(title_content);
 
     cfg_init();
+    bench_init();
+    frame_hash_init();
+
+    washdc_atomic_int_init(&dc->signal_exit_threads, 0);
+    washdc_atomic_int_init(&dc->is_running, 1);
+    washdc_atomic_int_init(&dc->turbo_enabled, 0);
+
+    int interval;
+    if (cfg_get_int("exec.turbo-interval", &interval) != 0 || interval <= 0)
+        interval = DC_TURBO_INTERVAL_DEFAULT;
+    dc->turbo_interval = interval;
+    dc->turbo_frame_no = 0;
 
-    washdc_atomic_int_init(&signal_exit_threads, 0);
-    washdc_atomic_int_init(&is_running, 1);
+    if (cfg_get_bool("exec.aica-thread", &dc->use_aica_thread) != 0)
+        dc->use_aica_thread = false;
+#ifdef ENABLE_DEBUGGER
+    if (dc->use_aica_thread && config_get_dbg_enable()) {
+        LOG_WARN("exec.aica-thread is being ignored because it does not work "
+                 "with the debugger\n");
+        dc->use_aica_thread = false;
+    }
+#endif
+    if (dc->use_aica_thread && frame_hash_enabled) {
+        LOG_WARN("exec.aica-thread is being ignored because it makes frame "
+                 "hashes unreproducible\n");
+        dc->use_aica_thread = false;
+    }
 
-    memory_init(&dc_mem);
-    flash_mem_init(&flash_mem, config_get_dc_flash_path(), flash_mem_writeable);
-    boot_rom_init(&firmware, config_get_dc_bios_path());
+    memory_init(&dc->dc_mem);
+    flash_mem_init(&dc->flash_mem, config_get_dc_flash_path(),
+                   flash_mem_writeable);
+    boot_rom_init(&dc->firmware, config_get_dc_bios_path());
 
     int boot_mode = config_get_boot_mode();
     if (boot_mode == (int)DC_BOOT_IP_BIN || boot_mode == (int)DC_BOOT_DIRECT) {
@@ -549,7 +651,7 @@ dreamcast_init(char const *gdi_path,
                 RAISE_ERROR(ERROR_FILE_IO);
             }
 
-            memory_write(&dc_mem, dat_ip_bin, ADDR_IP_BIN & ADDR_AREA3_MASK,
+            memory_write(&dc->dc_mem, dat_ip_bin, ADDR_IP_BIN & ADDR_AREA3_MASK,
                          len_ip_bin);
             free(dat_ip_bin);
         }
@@ -563,7 +665,7 @@ dreamcast_init(char const *gdi_path,
                 error_set_errno_val(errno);
                 RAISE_ERROR(ERROR_FILE_IO);
             }
-            memory_write(&dc_mem, dat_1st_read_bin,
+            memory_write(&dc->dc_mem, dat_1st_read_bin,
                          ADDR_1ST_READ_BIN & ADDR_AREA3_MASK, len_1st_read_bin);
             free(dat_1st_read_bin);
         }
@@ -584,35 +686,67 @@ dreamcast_init(char const *gdi_path,
             RAISE_ERROR(ERROR_INVALID_FILE_LEN);
         }
 
-        memory_write(&dc_mem, dat_syscall,
+        memory_write(&dc->dc_mem, dat_syscall,
                      ADDR_SYSCALLS & ADDR_AREA3_MASK, syscall_len);
         free(dat_syscall);
     }
 
-    dc_clock_init(&sh4_clock);
-    dc_clock_init(&arm7_clock);
-    sh4_init(&cpu, &sh4_clock);
-    arm7_init(&arm7, &arm7_clock, &aica.mem);
+    dc_clock_init(&dc->sh4_clock);
+    dc_clock_init(&dc->arm7_clock);
+
+#ifdef ENABLE_TRACE
+    // this has to come before the native JIT checks which events to record
+    trace_init(&dc->sh4_clock);
+#endif
+    sh4_init(&dc->cpu, &dc->sh4_clock);
+    dc->cpu.code_cache = &dc->code_cache;
+    arm7_init(&dc->arm7, &dc->arm7_clock, &dc->aica.mem);
+
+    // this has to come before the native JIT decides whether to sample blocks
+    if (config_get_jit())
+        jit_sample_init();
+
+    struct exec_mem *native = NULL;
+#ifdef ENABLE_JIT_X86_64
+    if (config_get_native_jit()) {
+        exec_mem_init(&dc->exec_mem);
+        native = &dc->exec_mem;
+    }
+#endif
+
+    // the native dispatch code fills the hash table, so this goes first
+    jit_init(&dc->sh4_clock, &dc->code_cache, native);
 
 #ifdef ENABLE_JIT_X86_64
     if (config_get_native_jit()) {
+        struct native_dispatch_meta *meta = &dc->sh4_native_dispatch_meta;
         jit_x86_64_backend_init();
-        exec_mem_init();
-        sh4_jit_set_native_dispatch_meta(&sh4_native_dispatch_meta);
-        sh4_native_dispatch_meta.clk = &sh4_clock;
-        native_dispatch_init(&sh4_native_dispatch_meta, &cpu);
+        sh4_jit_set_native_dispatch_meta(meta);
+        meta->clk = &dc->sh4_clock;
+        meta->exec_mem = &dc->exec_mem;
+        meta->code_cache = &dc->code_cache;
+#ifdef ENABLE_WATCHPOINTS
+        meta->break_flag = debug_jit_break_flag(DEBUG_CONTEXT_SH4);
+#endif
+        native_dispatch_init(meta, &dc->cpu);
         native_mem_init();
+#ifdef ENABLE_JIT_PERF
+        jit_perf_init();
+#endif
     }
 #endif
-    jit_init(&sh4_clock);
 
     g1_init();
     g2_init();
-    aica_init(&aica, &arm7, &arm7_clock, &sh4_clock);
-    pvr2_init(&dc_pvr2, &sh4_clock, &maple);
-    sys_block_init(&sys_block, &sh4_clock, &cpu, &dc_mem, &dc_pvr2);
-    gdrom_init(&gdrom, &sh4_clock);
-    maple_init(&maple, &sh4_clock);
+    aica_init(&dc->aica, &dc->arm7, &dc->arm7_clock, &dc->sh4_clock, native);
+    pvr2_init(&dc->dc_pvr2, &dc->sh4_clock, &dc->maple);
+    sys_block_init(&dc->sys_block, &dc->sh4_clock, &dc->cpu, &dc->dc_mem,
+                   &dc->dc_pvr2);
+    gdrom_init(&dc->gdrom, &dc->sh4_clock);
+    maple_init(&dc->maple, &dc->sh4_clock);
+    maple_movie_init(&dc->maple, &dc->sh4_clock,
+                     config_get_movie_record_path(),
+                     config_get_movie_play_path());
 
     char const *ctrl_0 = cfg_get_node("wash.dc.port.0.0");
     char const *ctrl_1 = cfg_get_node("wash.dc.port.1.0");
@@ -621,62 +755,67 @@ dreamcast_init(char const *gdi_path,
 
     if (ctrl_0) {
         if (strcmp(ctrl_0, "dreamcast_controller") == 0) {
-            maple_device_init(&maple, maple_addr_pack(0, 0),
+            maple_device_init(&dc->maple, maple_addr_pack(0, 0),
                               MAPLE_DEVICE_CONTROLLER);
         } else if (strcmp(ctrl_0, "dreamcast_keyboard_us") == 0) {
-            maple_device_init(&maple, maple_addr_pack(0, 0),
+            maple_device_init(&dc->maple, maple_addr_pack(0, 0),
                               MAPLE_DEVICE_KEYBOARD);
         }
     }
     if (ctrl_1) {
         if (strcmp(ctrl_1, "dreamcast_controller") == 0) {
-            maple_device_init(&maple, maple_addr_pack(1, 0),
+            maple_device_init(&dc->maple, maple_addr_pack(1, 0),
                               MAPLE_DEVICE_CONTROLLER);
         } else if (strcmp(ctrl_1, "dreamcast_keyboard_us") == 0) {
-            maple_device_init(&maple, maple_addr_pack(1, 0),
+            maple_device_init(&dc->maple, maple_addr_pack(1, 0),
                               MAPLE_DEVICE_KEYBOARD);
         }
     }
     if (ctrl_2) {
         if (strcmp(ctrl_2, "dreamcast_controller") == 0) {
-            maple_device_init(&maple, maple_addr_pack(2, 0),
+            maple_device_init(&dc->maple, maple_addr_pack(2, 0),
                               MAPLE_DEVICE_CONTROLLER);
         } else if (strcmp(ctrl_0, "dreamcast_keyboard_us") == 0) {
-            maple_device_init(&maple, maple_addr_pack(2, 0),
+            maple_device_init(&dc->maple, maple_addr_pack(2, 0),
                               MAPLE_DEVICE_KEYBOARD);
         }
     }
     if (ctrl_3) {
         if (strcmp(ctrl_3, "dreamcast_controller") == 0) {
-            maple_device_init(&maple, maple_addr_pack(3, 0),
+            maple_device_init(&dc->maple, maple_addr_pack(3, 0),
                               MAPLE_DEVICE_CONTROLLER);
         } else if (strcmp(ctrl_3, "dreamcast_keyboard_us") == 0) {
-            maple_device_init(&maple, maple_addr_pack(3, 0),
+            maple_device_init(&dc->maple, maple_addr_pack(3, 0),
                               MAPLE_DEVICE_KEYBOARD);
         }
     }
 
     // hook up the irl line
-    sh4_register_irl_line(&cpu, holly_intc_irl_line_fn, NULL);
+    sh4_register_irl_line(&dc->cpu, holly_intc_irl_line_fn, NULL);
+
+    memory_map_init(&dc->mem_map);
+    construct_sh4_mem_map(&dc->cpu, &dc->mem_map);
+    sh4_set_mem_map(&dc->cpu, &dc->mem_map);
 
-    memory_map_init(&mem_map);
-    construct_sh4_mem_map(&cpu, &mem_map);
-    sh4_set_mem_map(&cpu, &mem_map);
+    memory_map_init(&dc->arm7_mem_map);
+    construct_arm7_mem_map(&dc->arm7_mem_map);
+    arm7_set_mem_map(&dc->arm7, &dc->arm7_mem_map);
 
-    memory_map_init(&arm7_mem_map);
-    construct_arm7_mem_map(&arm7_mem_map);
-    arm7_set_mem_map(&arm7, &arm7_mem_map);
+#ifdef ENABLE_TRACE
+    trace_add_map(&dc->mem_map, "sh4");
+    trace_add_map(&dc->arm7_mem_map, "arm7");
+#endif
 
 #ifdef ENABLE_JIT_X86_64
     if (config_get_native_jit())
-        native_mem_register(cpu.mem.map);
+        native_mem_register(&dc->exec_mem, dc->cpu.mem.map);
 #endif
 
     /* set the PC to the booststrap code within IP.BIN */
     if (boot_mode == (int)DC_BOOT_DIRECT)
-        cpu.reg[SH4_REG_PC] = ADDR_1ST_READ_BIN;
+        dc->cpu.reg[SH4_REG_PC] = ADDR_1ST_READ_BIN;
     else if (boot_mode == (int)DC_BOOT_IP_BIN)
-        cpu.reg[SH4_REG_PC] = ADDR_BOOTSTRAP;
+        dc->cpu.reg[SH4_REG_PC] = ADDR_BOOTSTRAP;
 
     if (boot_mode == (int)DC_BOOT_IP_BIN || boot_mode == (int)DC_BOOT_DIRECT) {
         /*
@@ -691,10 +830,10 @@ dreamcast_init(char const *gdi_path,
          * different value immediately before IP.BIN runs, and that the value
          * seen by 1ST_READ.BIN is set by IP.BIN.
          */
-        cpu.reg[SH4_REG_VBR] = 0x8c00f400;
+        dc->cpu.reg[SH4_REG_VBR] = 0x8c00f400;
     }
 
-    aica_rtc_init(&rtc, &sh4_clock, config_get_dc_path_rtc());
+    aica_rtc_init(&dc->rtc, &dc->sh4_clock, config_get_dc_path_rtc());
 
 #ifdef ENABLE_DEBUGGER
     if (config_get_dbg_enable()) {
@@ -726,98 +865,128 @@ do_init_win_gfx:
 
     dc_sound_init(snd_intf);
 
-    lmmode0 = 0;
-    lmmode1 = 0;
+    dc->lmmode0 = 0;
+    dc->lmmode1 = 0;
 
-    init_complete = true;
+    dc->init_complete = true;
 
+    return dc;
+}
+
+struct washdc_gameconsole const *
+dreamcast_get_console(struct washdc_instance *inst) {
     return &dccons;
 }
 
-void dreamcast_cleanup() {
-    init_complete = false;
+void dreamcast_cleanup(struct washdc_instance *inst) {
+    inst->init_complete = false;
 
 #ifdef ENABLE_DEBUGGER
     LOG_INFO("Cleanup up debugger\n");
     debug_cleanup();
+    dbg_rewind_cleanup();
     LOG_INFO("debugger cleaned up\n");
 #endif
 
+#ifdef ENABLE_TRACE
+    trace_cleanup();
+#endif
+
     dc_sound_cleanup();
     gfx_cleanup();
 
     win_cleanup();
 
-    aica_rtc_cleanup(&rtc);
+    aica_rtc_cleanup(&inst->rtc);
 
-    memory_map_cleanup(&arm7_mem_map);
-    memory_map_cleanup(&mem_map);
+    memory_map_cleanup(&inst->arm7_mem_map);
+    memory_map_cleanup(&inst->mem_map);
 
     // disconnect the irl line
-    sh4_register_irl_line(&cpu, NULL, NULL);
-
-    maple_cleanup(&maple);
-    gdrom_cleanup(&gdrom);
-    sys_block_cleanup(&sys_block);
-    pvr2_cleanup(&dc_pvr2);
-    aica_cleanup(&aica);
+    sh4_register_irl_line(&inst->cpu, NULL, NULL);
+
+    maple_movie_cleanup();
+    maple_cleanup(&inst->maple);
+    gdrom_cleanup(&inst->gdrom);
+    sys_block_cleanup(&inst->sys_block);
+    pvr2_cleanup(&inst->dc_pvr2);
+    aica_cleanup(&inst->aica);
     g2_cleanup();
     g1_cleanup();
 
-    jit_cleanup();
+    jit_cleanup(&inst->code_cache);
+    jit_sample_cleanup();
 #ifdef ENABLE_JIT_X86_64
     if (config_get_native_jit()) {
+#ifdef ENABLE_JIT_PERF
+        jit_perf_cleanup();
+#endif
         native_mem_cleanup();
-        native_dispatch_cleanup(&sh4_native_dispatch_meta);
-        exec_mem_cleanup();
+        native_dispatch_cleanup(&inst->sh4_native_dispatch_meta);
+        exec_mem_cleanup(&inst->exec_mem);
         jit_x86_64_backend_cleanup();
     }
 #endif
 
-    arm7_cleanup(&arm7);
-    sh4_cleanup(&cpu);
-    dc_clock_cleanup(&arm7_clock);
-    dc_clock_cleanup(&sh4_clock);
-    boot_rom_cleanup(&firmware);
-    flash_mem_cleanup(&flash_mem);
-    memory_cleanup(&dc_mem);
+    arm7_cleanup(&inst->arm7);
+    sh4_cleanup(&inst->cpu);
+    dc_clock_cleanup(&inst->arm7_clock);
+    dc_clock_cleanup(&inst->sh4_clock);
+    boot_rom_cleanup(&inst->firmware);
+    flash_mem_cleanup(&inst->flash_mem);
+    memory_cleanup(&inst->dc_mem);
     cfg_cleanup();
+    bench_cleanup();
+    frame_hash_cleanup();
 
     if (mount_check())
         mount_eject();
 
     log_cleanup();
-}
 
-/*
- * this is used to store the irl timestamp right before execution begins.
- * This exists for performance profiling purposes only.
- */
-static washdc_real_time start_time;
+    free(inst);
+    dc = NULL;
+}
 
 static void run_one_frame(void) {
-    while (!end_of_frame) {
-        if (dc_clock_run_timeslice(&sh4_clock))
-            return;
-        if (dc_clock_run_timeslice(&arm7_clock))
+    while (!dc->end_of_frame) {
+        bench_push(BENCH_CAT_SH4);
+        bool exit_now = dc_clock_run_timeslice(&dc->sh4_clock);
+        bench_pop();
+        if (exit_now)
             return;
+
+        if (dc->use_aica_thread) {
+            aica_thread_sync();
+        } else {
+            bench_push(BENCH_CAT_ARM7);
+            exit_now = dc_clock_run_timeslice(&dc->arm7_clock);
+            bench_pop();
+            if (exit_now)
+                return;
+        }
         if (config_get_jit())
-            code_cache_gc();
+            code_cache_gc(&dc->code_cache);
     }
-    end_of_frame = false;
+    dc->end_of_frame = false;
+    bench_frame_boundary(clock_cycle_stamp(&dc->sh4_clock),
+                         code_cache_n_misses(&dc->code_cache));
 }
 
-unsigned dc_get_frame_count(void) {
-    return frame_count;
+unsigned dc_get_frame_count(struct washdc_instance *inst) {
+    return inst->frame_count;
 }
 
 static void main_loop_sched(void) {
-    while (washdc_atomic_int_load(&is_running)) {
+    while (washdc_atomic_int_load(&dc->is_running)) {
         run_one_frame();
-        frame_count++;
-        if (frame_stop) {
-            frame_stop = false;
-            if (dc_state == DC_STATE_RUNNING) {
+        dc->frame_count++;
+#ifdef ENABLE_DEBUGGER
+        dbg_rewind_on_frame();
+#endif
+        if (dc->frame_stop) {
+            dc->frame_stop = false;
+            if (dc->dc_state == DC_STATE_RUNNING) {
                 dc_state_transition(DC_STATE_SUSPEND, DC_STATE_RUNNING);
                 suspend_loop();
             } else {
@@ -833,8 +1002,15 @@ typedef bool(*cpu_backend_func)(void*);
 static cpu_backend_func select_sh4_backend(void) {
 #ifdef ENABLE_DEBUGGER
     bool use_debugger = config_get_dbg_enable();
-    if (use_debugger)
-        return run_to_next_sh4_event_debugger;
+    if (use_debugger) {
+        if (!config_get_jit())
+            return run_to_next_sh4_event_debugger;
+#ifdef ENABLE_JIT_X86_64
+        if (config_get_native_jit())
+            return run_to_next_sh4_event_jit_native_debugger;
+#endif
+        return run_to_next_sh4_event_jit_debugger;
+    }
 #endif
 
 #ifdef ENABLE_JIT_X86_64
@@ -864,10 +1040,12 @@ static cpu_backend_func select_arm7_backend(void) {
     if (use_debugger)
         return run_to_next_arm7_event_debugger;
 #endif
+    if (dc->use_aica_thread)
+        return run_to_next_arm7_event_thread;
     return run_to_next_arm7_event;
 }
 
-void dreamcast_run() {
+void dreamcast_run(struct washdc_instance *inst) {
     signal(SIGINT, dc_sigint_handler);
 
     if (config_get_ser_srv_enable())
@@ -875,38 +1053,48 @@ void dreamcast_run() {
 
 #ifdef ENABLE_DEBUGGER
     debug_init();
-    debug_init_context(DEBUG_CONTEXT_SH4, &cpu, &mem_map);
-    debug_init_context(DEBUG_CONTEXT_ARM7, &arm7, &arm7_mem_map);
-    if (config_get_dbg_enable())
+    debug_init_context(DEBUG_CONTEXT_SH4, &inst->cpu, &inst->mem_map);
+    debug_init_context(DEBUG_CONTEXT_ARM7, &inst->arm7, &inst->arm7_mem_map);
+    if (config_get_dbg_enable()) {
+        dbg_rewind_init(&inst->dc_mem, &inst->aica.mem, &inst->cpu,
+                        &inst->arm7, &inst->sh4_clock);
         dreamcast_enable_debugger();
+    }
 #endif
 
-    periodic_event.when = clock_cycle_stamp(&sh4_clock) + DC_PERIODIC_EVENT_PERIOD;
-    periodic_event.handler = periodic_event_handler;
-    sched_event(&sh4_clock, &periodic_event);
+    inst->periodic_event.when =
+        clock_cycle_stamp(&inst->sh4_clock) + DC_PERIODIC_EVENT_PERIOD;
+    inst->periodic_event.handler = periodic_event_handler;
+    sched_event(&inst->sh4_clock, &inst->periodic_event);
 
     // back when cmd existed, this was where we'd wait for the user to begin-execution
     if (dc_get_state() == DC_STATE_NOT_RUNNING)
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
 
-    washdc_get_real_time(&start_time);
-    washdc_get_real_time(&last_frame_realtime);
+    washdc_get_real_time(&inst->start_time);
+    bench_start(inst);
+    washdc_get_real_time(&inst->last_frame_realtime);
 
-    sh4_clock.dispatch = select_sh4_backend();
-    sh4_clock.dispatch_ctxt = &cpu;
+    inst->sh4_clock.dispatch = select_sh4_backend();
+    inst->sh4_clock.dispatch_ctxt = &inst->cpu;
 
-    arm7_clock.dispatch = select_arm7_backend();
-    arm7_clock.dispatch_ctxt = &arm7;
+    inst->arm7_clock.dispatch = select_arm7_backend();
+    inst->arm7_clock.dispatch_ctxt = &inst->arm7;
+
+    if (inst->use_aica_thread)
+        aica_thread_start(&inst->aica, &inst->arm7_clock);
 
     main_loop_sched();
 
+    aica_thread_stop();
+
     dc_print_perf_stats();
 
     // tell the other threads it's time to clean up and exit
     int oldval = 0;
-    washdc_atomic_int_compare_exchange(&signal_exit_threads, &oldval, 1);
+    washdc_atomic_int_compare_exchange(&inst->signal_exit_threads, &oldval, 1);
 
-    switch (term_reason) {
+    switch (inst->term_reason) {
     case TERM_REASON_NORM:
         LOG_INFO("program execution ended normally\n");
         break;
@@ -922,27 +1110,49 @@ void dreamcast_run() {
     }
 }
 
+unsigned dreamcast_sh4_difftest(struct washdc_instance *inst,
+                                char const *report_path, unsigned n_cases,
+                                unsigned seed) {
+    struct sh4_difftest_target tgt = {
+        .sh4 = &inst->cpu,
+        .ram = &inst->dc_mem
+    };
+
+#ifdef ENABLE_JIT_X86_64
+    if (config_get_native_jit())
+        tgt.native = &inst->sh4_native_dispatch_meta;
+#endif
+
+    unsigned n_mismatch = sh4_difftest_run(&tgt, report_path, n_cases, seed);
+
+    // tell the other threads it's time to clean up and exit
+    int oldval = 0;
+    washdc_atomic_int_compare_exchange(&inst->signal_exit_threads, &oldval, 1);
+
+    return n_mismatch;
+}
+
 static bool run_to_next_arm7_event(void *ctxt) {
-    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&arm7_clock);
+    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&dc->arm7_clock);
 
-    if (arm7.enabled) {
+    if (dc->arm7.enabled) {
         dc_cycle_stamp_t cycles_after;
         for (;;) {
             int extra_cycles;
-            arm7_inst inst = arm7_fetch_inst(&arm7, &extra_cycles);
-            arm7_op_fn handler = arm7_decode(&arm7, inst);
-            unsigned inst_cycles = handler(&arm7, inst);
+            arm7_inst inst = arm7_fetch_inst(&dc->arm7, &extra_cycles);
+            arm7_op_fn handler = arm7_decode(&dc->arm7, inst);
+            unsigned inst_cycles = handler(&dc->arm7, inst);
             dc_cycle_stamp_t cycles_adv =
                 (inst_cycles + extra_cycles) * ARM7_CLOCK_SCALE;
 
-            if (cycles_adv >= clock_countdown(&arm7_clock)) {
-                cycles_after = clock_target_stamp(&arm7_clock);
+            if (cycles_adv >= clock_countdown(&dc->arm7_clock)) {
+                cycles_after = clock_target_stamp(&dc->arm7_clock);
                 break;
             }
 
-            clock_countdown_sub(&arm7_clock, cycles_adv);
+            clock_countdown_sub(&dc->arm7_clock, cycles_adv);
         }
-        clock_set_cycle_stamp(&arm7_clock, cycles_after);
+        clock_set_cycle_stamp(&dc->arm7_clock, cycles_after);
     } else {
         /*
          * XXX When the ARM7 is disabled, the PC is supposed to continue
@@ -956,8 +1166,45 @@ static bool run_to_next_arm7_event(void *ctxt) {
          * R14_svc.  TBH I think it would be hard to get the timing right even
          * on real hardware.
          */
-        tgt_stamp = clock_target_stamp(&arm7_clock);
-        clock_set_cycle_stamp(&arm7_clock, tgt_stamp);
+        tgt_stamp = clock_target_stamp(&dc->arm7_clock);
+        clock_set_cycle_stamp(&dc->arm7_clock, tgt_stamp);
+    }
+
+    return false;
+}
+
+/*
+ * same as run_to_next_arm7_event, but for when the ARM7 has its own thread.
+ * The only difference is that it checks for register accesses from the SH4
+ * between instructions.
+ */
+static bool run_to_next_arm7_event_thread(void *ctxt) {
+    aica_thread_poll();
+
+    if (dc->arm7.enabled) {
+        dc_cycle_stamp_t cycles_after;
+        for (;;) {
+            int extra_cycles;
+            arm7_inst inst = arm7_fetch_inst(&dc->arm7, &extra_cycles);
+            arm7_op_fn handler = arm7_decode(&dc->arm7, inst);
+            unsigned inst_cycles = handler(&dc->arm7, inst);
+            dc_cycle_stamp_t cycles_adv =
+                (inst_cycles + extra_cycles) * ARM7_CLOCK_SCALE;
+
+            if (cycles_adv >= clock_countdown(&dc->arm7_clock)) {
+                cycles_after = clock_target_stamp(&dc->arm7_clock);
+                break;
+            }
+
+            clock_countdown_sub(&dc->arm7_clock, cycles_adv);
+
+            aica_thread_poll();
+        }
+        clock_set_cycle_stamp(&dc->arm7_clock, cycles_after);
+    } else {
+        // see the comment in run_to_next_arm7_event
+        clock_set_cycle_stamp(&dc->arm7_clock,
+                              clock_target_stamp(&dc->arm7_clock));
     }
 
     return false;
@@ -965,9 +1212,9 @@ static bool run_to_next_arm7_event(void *ctxt) {
 
 #ifdef ENABLE_DEBUGGER
 static bool run_to_next_arm7_event_debugger(void *ctxt) {
-    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&arm7_clock);
+    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&dc->arm7_clock);
 
-    if (arm7.enabled) {
+    if (dc->arm7.enabled) {
         debug_set_context(DEBUG_CONTEXT_ARM7);
         dc_cycle_stamp_t cycles_after;
         bool exit_now;
@@ -977,24 +1224,24 @@ static bool run_to_next_arm7_event_debugger(void *ctxt) {
 
         while (!(exit_now = dreamcast_check_debugger())) {
             int extra_cycles;
-            arm7_inst inst = arm7_fetch_inst(&arm7, &extra_cycles);
-            arm7_op_fn handler = arm7_decode(&arm7, inst);
-            unsigned inst_cycles = handler(&arm7, inst);
+            arm7_inst inst = arm7_fetch_inst(&dc->arm7, &extra_cycles);
+            arm7_op_fn handler = arm7_decode(&dc->arm7, inst);
+            unsigned inst_cycles = handler(&dc->arm7, inst);
             dc_cycle_stamp_t cycles_adv =
                 (inst_cycles + extra_cycles) * ARM7_CLOCK_SCALE;
 
-            if (cycles_adv >= clock_countdown(&arm7_clock)) {
-                cycles_after = clock_target_stamp(&arm7_clock);
+            if (cycles_adv >= clock_countdown(&dc->arm7_clock)) {
+                cycles_after = clock_target_stamp(&dc->arm7_clock);
                 break;
             }
 
-            clock_countdown_sub(&arm7_clock, cycles_adv);
+            clock_countdown_sub(&dc->arm7_clock, cycles_adv);
 #ifdef ENABLE_DBG_COND
             debug_check_conditions(DEBUG_CONTEXT_ARM7);
 #endif
         }
         if (!exit_now)
-            clock_set_cycle_stamp(&arm7_clock, cycles_after);
+            clock_set_cycle_stamp(&dc->arm7_clock, cycles_after);
     } else {
         /*
          * XXX When the ARM7 is disabled, the PC is supposed to continue
@@ -1008,8 +1255,8 @@ static bool run_to_next_arm7_event_debugger(void *ctxt) {
          * R14_svc.  TBH I think it would be hard to get the timing right even
          * on real hardware.
          */
-        tgt_stamp = clock_target_stamp(&arm7_clock);
-        clock_set_cycle_stamp(&arm7_clock, tgt_stamp);
+        tgt_stamp = clock_target_stamp(&dc->arm7_clock);
+        clock_set_cycle_stamp(&dc->arm7_clock, tgt_stamp);
     }
 
     return false;
@@ -1031,10 +1278,11 @@ static bool dreamcast_check_debugger(void) {
         cur_state == DC_STATE_DEBUG) {
         printf("cur_state is DC_STATE_DEBUG\n");
         do {
-            // call debug_run_once 100 times per second
             win_check_events();
             debug_run_once();
-            washdc_sleep_ms(1000 / 100);
+            if (dc_emu_thread_is_running() &&
+                dc_get_state() == DC_STATE_DEBUG)
+                pace_wait();
         } while ((cur_state = dc_get_state()) == DC_STATE_DEBUG &&
                  (is_running = dc_emu_thread_is_running()));
     }
@@ -1050,29 +1298,150 @@ static bool run_to_next_sh4_event_debugger(void *ctxt) {
     if ((exit_now = dreamcast_check_debugger()))
         return exit_now;
 
-    dc_cycle_stamp_t cycles_after = clock_target_stamp(&sh4_clock);
+    dc_cycle_stamp_t cycles_after = clock_target_stamp(&dc->sh4_clock);
     while (!(exit_now = dreamcast_check_debugger())) {
         dc_cycle_stamp_t cycles_adv = 0;
 
         cycles_adv +=
             (dc_cycle_stamp_t)sh4_do_exec_inst(sh4) * SH4_CLOCK_SCALE;
-        if (cycles_adv >= clock_countdown(&sh4_clock)) {
-            cycles_after = clock_target_stamp(&sh4_clock);
+        if (cycles_adv >= clock_countdown(&dc->sh4_clock)) {
+            cycles_after = clock_target_stamp(&dc->sh4_clock);
             break;
         }
 
-        clock_countdown_sub(&sh4_clock, cycles_adv);
+        clock_countdown_sub(&dc->sh4_clock, cycles_adv);
 
 #ifdef ENABLE_DBG_COND
         debug_check_conditions(DEBUG_CONTEXT_SH4);
 #endif
     }
 
-    clock_set_cycle_stamp(&sh4_clock, cycles_after);
+    clock_set_cycle_stamp(&dc->sh4_clock, cycles_after);
 
     return exit_now;
 }
 
+/*
+ * execute one instruction in the interpreter.  The debugger must already have
+ * been notified about the instruction by dreamcast_check_debugger.
+ */
+static void dreamcast_sh4_debug_step(Sh4 *sh4) {
+    dc_cycle_stamp_t cycles_adv =
+        (dc_cycle_stamp_t)sh4_do_exec_inst(sh4) * SH4_CLOCK_SCALE;
+
+    if (cycles_adv >= clock_countdown(&dc->sh4_clock))
+        clock_set_cycle_stamp(&dc->sh4_clock,
+                              clock_target_stamp(&dc->sh4_clock));
+    else
+        clock_countdown_sub(&dc->sh4_clock, cycles_adv);
+
+#ifdef ENABLE_DBG_COND
+    debug_check_conditions(DEBUG_CONTEXT_SH4);
+#endif
+}
+
+/*
+ * run code blocks through the JIT with the debugger enabled.
+ *
+ * The JIT is used whenever the debugger allows it, and the code blocks end
+ * right before any instruction that has a breakpoint on it.  Breakpoints,
+ * single-steps, conditions and the instruction after a watchpoint all go
+ * through the interpreter one instruction at a time, same as in
+ * run_to_next_sh4_event_debugger.  A watchpoint that gets triggered by JIT
+ * code is reported at the end of the block that triggered it.
+ *
+ * dreamcast_check_debugger gets called before every instruction that runs in
+ * the interpreter, but for JIT code it only gets called when a block ends on
+ * a breakpoint or leaves the debugger in a state that doesn't allow the JIT,
+ * or when the next scheduler event comes around.  This means that a break
+ * requested by the user will be handled at the next scheduler event instead
+ * of the next instruction.
+ *
+ * The debugger is only ever checked right before something is about to
+ * execute; otherwise it would see the same instruction twice when the
+ * countdown is already expired and break on it again after a continue.
+ *
+ * run_block runs the JIT starting from the current PC until it either stops
+ * on a breakpoint or reaches the end of the countdown.
+ */
+static bool
+dreamcast_sh4_jit_debugger(Sh4 *sh4, void(*run_block)(Sh4*)) {
+    debug_set_context(DEBUG_CONTEXT_SH4);
+
+    bool check_debugger = true;
+    while (clock_countdown(&dc->sh4_clock)) {
+        if (check_debugger && dreamcast_check_debugger())
+            return true;
+
+        if (debug_can_jit(DEBUG_CONTEXT_SH4) &&
+            !debug_is_break(DEBUG_CONTEXT_SH4, sh4->reg[SH4_REG_PC])) {
+            run_block(sh4);
+            check_debugger = !debug_can_jit(DEBUG_CONTEXT_SH4) ||
+                debug_is_break(DEBUG_CONTEXT_SH4, sh4->reg[SH4_REG_PC]);
+        } else {
+            dreamcast_sh4_debug_step(sh4);
+            check_debugger = true;
+        }
+    }
+
+    return false;
+}
+
+static void dreamcast_sh4_run_jit_block(Sh4 *sh4) {
+    addr32_t blk_addr = sh4->reg[SH4_REG_PC];
+    jit_hash code_hash =
+        sh4_jit_hash(sh4, blk_addr, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4));
+    struct cache_entry *ent = code_cache_find(sh4->code_cache, code_hash);
+
+    struct jit_code_block *blk = &ent->blk;
+    struct code_block_intp *intp_blk = &blk->intp;
+    if (!ent->valid) {
+        jit_sample_cur = JIT_SAMPLE_COMPILING;
+        sh4_jit_compile_intp(sh4, blk, blk_addr);
+        ent->valid = true;
+    }
+
+    TRACE_BLOCK(code_hash);
+    jit_sample_cur = code_hash;
+
+#ifdef JIT_PROFILE
+    jit_profile_notify(&sh4->jit_profile, blk->profile);
+#endif
+
+    sh4->reg[SH4_REG_PC] = code_block_intp_exec(sh4, intp_blk);
+    jit_sample_cur = JIT_SAMPLE_OUTSIDE;
+
+    dc_cycle_stamp_t cycles_adv = intp_blk->cycle_count;
+    if (cycles_adv >= clock_countdown(&dc->sh4_clock))
+        clock_set_cycle_stamp(&dc->sh4_clock,
+                              clock_target_stamp(&dc->sh4_clock));
+    else
+        clock_countdown_sub(&dc->sh4_clock, cycles_adv);
+}
+
+static bool run_to_next_sh4_event_jit_debugger(void *ctxt) {
+    return dreamcast_sh4_jit_debugger((Sh4*)ctxt, dreamcast_sh4_run_jit_block);
+}
+
+#ifdef ENABLE_JIT_X86_64
+static void dreamcast_sh4_run_jit_native(Sh4 *sh4) {
+    reg32_t pc = sh4->reg[SH4_REG_PC];
+    jit_hash hash =
+        sh4_jit_hash(sh4, pc, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4));
+
+    /*
+     * this returns when the countdown expires or when a block that starts on
+     * a breakpoint gets executed.
+     */
+    sh4->reg[SH4_REG_PC] = dc->sh4_native_dispatch_meta.entry(pc, hash);
+    jit_sample_cur = JIT_SAMPLE_OUTSIDE;
+}
+
+static bool run_to_next_sh4_event_jit_native_debugger(void *ctxt) {
+    return dreamcast_sh4_jit_debugger((Sh4*)ctxt, dreamcast_sh4_run_jit_native);
+}
+#endif
+
 #endif
 
 static bool run_to_next_sh4_event(void *ctxt) {
@@ -1085,15 +1454,15 @@ static bool run_to_next_sh4_event(void *ctxt) {
 
         cycles_adv +=
             (dc_cycle_stamp_t)sh4_do_exec_inst(sh4) * SH4_CLOCK_SCALE;
-        if (cycles_adv >= clock_countdown(&sh4_clock)) {
-            cycles_after = clock_target_stamp(&sh4_clock);
+        if (cycles_adv >= clock_countdown(&dc->sh4_clock)) {
+            cycles_after = clock_target_stamp(&dc->sh4_clock);
             break;
         }
 
-        clock_countdown_sub(&sh4_clock, cycles_adv);
+        clock_countdown_sub(&dc->sh4_clock, cycles_adv);
     }
 
-    clock_set_cycle_stamp(&sh4_clock, cycles_after);
+    clock_set_cycle_stamp(&dc->sh4_clock, cycles_after);
 
     return false;
 }
@@ -1106,7 +1475,8 @@ static bool run_to_next_sh4_event_jit_native(void *ctxt) {
 
     jit_hash hash =
         sh4_jit_hash(ctxt, newpc, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4));
-    newpc = sh4_native_dispatch_meta.entry(newpc, hash);
+    newpc = dc->sh4_native_dispatch_meta.entry(newpc, hash);
+    jit_sample_cur = JIT_SAMPLE_OUTSIDE;
 
     sh4->reg[SH4_REG_PC] = newpc;
 
@@ -1118,56 +1488,61 @@ static bool run_to_next_sh4_event_jit(void *ctxt) {
     Sh4 *sh4 = (Sh4*)ctxt;
 
     reg32_t newpc = sh4->reg[SH4_REG_PC];
-    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&sh4_clock);
+    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&dc->sh4_clock);
 
     do {
         addr32_t blk_addr = newpc;
         jit_hash code_hash =
             sh4_jit_hash(sh4, blk_addr, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4));
-        struct cache_entry *ent = code_cache_find(code_hash);
+        struct cache_entry *ent = code_cache_find(sh4->code_cache, code_hash);
 
         struct jit_code_block *blk = &ent->blk;
         struct code_block_intp *intp_blk = &blk->intp;
         if (!ent->valid) {
+            jit_sample_cur = JIT_SAMPLE_COMPILING;
             sh4_jit_compile_intp(sh4, blk, blk_addr);
             ent->valid = true;
         }
 
+        TRACE_BLOCK(code_hash);
+        jit_sample_cur = code_hash;
+
 #ifdef JIT_PROFILE
         jit_profile_notify(&sh4->jit_profile, blk->profile);
 #endif
 
         newpc = code_block_intp_exec(sh4, intp_blk);
 
-        dc_cycle_stamp_t cycles_after = clock_cycle_stamp(&sh4_clock) +
+        dc_cycle_stamp_t cycles_after = clock_cycle_stamp(&dc->sh4_clock) +
             intp_blk->cycle_count;
-        clock_set_cycle_stamp(&sh4_clock, cycles_after);
-        tgt_stamp = clock_target_stamp(&sh4_clock);
-    } while (tgt_stamp > clock_cycle_stamp(&sh4_clock));
-    if (clock_cycle_stamp(&sh4_clock) > tgt_stamp)
-        clock_set_cycle_stamp(&sh4_clock, tgt_stamp);
+        clock_set_cycle_stamp(&dc->sh4_clock, cycles_after);
+        tgt_stamp = clock_target_stamp(&dc->sh4_clock);
+    } while (tgt_stamp > clock_cycle_stamp(&dc->sh4_clock));
+    if (clock_cycle_stamp(&dc->sh4_clock) > tgt_stamp)
+        clock_set_cycle_stamp(&dc->sh4_clock, tgt_stamp);
 
+    jit_sample_cur = JIT_SAMPLE_OUTSIDE;
     sh4->reg[SH4_REG_PC] = newpc;
 
     return false;
 }
 
 void dc_print_perf_stats(void) {
-    if (init_complete) {
+    if (dc && dc->init_complete) {
         washdc_real_time end_time, delta_time;
         washdc_get_real_time(&end_time);
 
-        washdc_real_time_diff(&delta_time, &end_time, &start_time);
+        washdc_real_time_diff(&delta_time, &end_time, &dc->start_time);
 
         double seconds = washdc_real_time_to_seconds(&delta_time);
         LOG_INFO("Total elapsed time: %f seconds\n", seconds);
 
         LOG_INFO("%u SH4 CPU cycles executed\n",
-                 (unsigned)sh4_get_cycles(&cpu));
+                 (unsigned)sh4_get_cycles(&dc->cpu));
         printf("%u SH4 CPU cycles executed\n",
-               (unsigned)sh4_get_cycles(&cpu));
+               (unsigned)sh4_get_cycles(&dc->cpu));
 
-        double hz = (double)sh4_get_cycles(&cpu) / seconds;
+        double hz = (double)sh4_get_cycles(&dc->cpu) / seconds;
         double hz_ratio = hz / (double)(200 * 1000 * 1000);
 
         LOG_INFO("Average Performance is %f MHz (%f%%)\n",
@@ -1183,28 +1558,33 @@ void dc_print_perf_stats(void) {
 void dreamcast_kill(void) {
     LOG_INFO("%s called - WashingtonDC will exit soon\n", __func__);
     int oldval = 1;
-    washdc_atomic_int_compare_exchange(&is_running, &oldval, 0);
+    washdc_atomic_int_compare_exchange(&dc->is_running, &oldval, 0);
+    pace_wake();
 }
 
 Sh4 *dreamcast_get_cpu() {
-    return &cpu;
+    return &dc->cpu;
+}
+
+struct dc_clock *dreamcast_get_sh4_clock(void) {
+    return &dc->sh4_clock;
 }
 
 #ifdef ENABLE_DEBUGGER
 static void dreamcast_enable_debugger(void) {
-    if (dbg_intf) {
-        using_debugger = true;
-        debug_attach(dbg_intf);
+    if (dc->dbg_intf) {
+        dc->using_debugger = true;
+        debug_attach(dc->dbg_intf);
     } else {
-        using_debugger = false;
+        dc->using_debugger = false;
     }
 }
 #endif
 
 static void dreamcast_enable_serial_server(void) {
 #ifdef ENABLE_TCP_SERIAL
-    serial_server_attach(sersrv, &cpu);
-    sh4_scif_connect_server(&cpu);
+    serial_server_attach(dc->sersrv, &dc->cpu);
+    sh4_scif_connect_server(&dc->cpu);
 #else
     LOG_ERROR("You must recompile with -DENABLE_TCP_SERIAL=On to use the tcp "
 	      "serial server emulator.\n");
@@ -1212,7 +1592,7 @@ static void dreamcast_enable_serial_server(void) {
 }
 
 static void dc_sigint_handler(int param) {
-    term_reason = TERM_REASON_SIGINT;
+    dc->term_reason = TERM_REASON_SIGINT;
     dreamcast_kill();
 }
 
@@ -1249,26 +1629,27 @@ close_fp:
     return dat;
 }
 
-bool dc_is_running(void) {
-    return !washdc_atomic_int_load(&signal_exit_threads);
+bool dc_is_running(struct washdc_instance *inst) {
+    return !washdc_atomic_int_load(&inst->signal_exit_threads);
 }
 
 bool dc_emu_thread_is_running(void) {
-    return washdc_atomic_int_load(&is_running);
+    return washdc_atomic_int_load(&dc->is_running);
 }
 
 enum dc_state dc_get_state(void) {
-    return dc_state;
+    return dc->dc_state;
 }
 
 void dc_state_transition(enum dc_state state_new, enum dc_state state_old) {
-    if (state_old != dc_state)
+    if (state_old != dc->dc_state)
         RAISE_ERROR(ERROR_INTEGRITY);
-    dc_state = state_new;
+    dc->dc_state = state_new;
+    pace_wake();
 }
 
 bool dc_debugger_enabled(void) {
-    return using_debugger;
+    return dc->using_debugger;
 }
 
 static void suspend_loop(void) {
@@ -1277,11 +1658,9 @@ static void suspend_loop(void) {
         do {
             win_check_events();
             gfx_redraw();
-            /*
-             * TODO: sleep on a pthread condition or something instead of
-             * polling.
-             */
-            washdc_sleep_ms(1000 * 1000 / 60);
+            if (dc_emu_thread_is_running() &&
+                dc_get_state() == DC_STATE_SUSPEND)
+                pace_wait();
         } while (dc_emu_thread_is_running() &&
                  ((cur_state = dc_get_state()) == DC_STATE_SUSPEND));
     }
@@ -1296,48 +1675,86 @@ static void suspend_loop(void) {
 static void periodic_event_handler(struct SchedEvent *event) {
     suspend_loop();
 
-    sh4_periodic(&cpu);
+    sh4_periodic(&dc->cpu);
 
-    periodic_event.when = clock_cycle_stamp(&sh4_clock) + DC_PERIODIC_EVENT_PERIOD;
-    sched_event(&sh4_clock, &periodic_event);
+    dc->periodic_event.when =
+        clock_cycle_stamp(&dc->sh4_clock) + DC_PERIODIC_EVENT_PERIOD;
+    sched_event(&dc->sh4_clock, &dc->periodic_event);
 }
 
 void dc_end_frame(void) {
     washdc_real_time timestamp, delta, virt_frametime_ns;
-    dc_cycle_stamp_t virt_timestamp = clock_cycle_stamp(&sh4_clock);
+    dc_cycle_stamp_t virt_timestamp = clock_cycle_stamp(&dc->sh4_clock);
     double framerate, virt_framerate, virt_frametime;
 
-    end_of_frame = true;
+    dc->end_of_frame = true;
 
-    virt_frametime = (double)(virt_timestamp - last_frame_virttime);
+    virt_frametime = (double)(virt_timestamp - dc->last_frame_virttime);
     double virt_frametime_seconds = virt_frametime / (double)SCHED_FREQUENCY;
     washdc_real_time_from_seconds(&virt_frametime_ns, virt_frametime_seconds);
 
     washdc_get_real_time(&timestamp);
-    washdc_real_time_diff(&delta, &timestamp, &last_frame_realtime);
+    washdc_real_time_diff(&delta, &timestamp, &dc->last_frame_realtime);
 
     framerate = 1.0 / washdc_real_time_to_seconds(&delta);
     virt_framerate = (double)SCHED_FREQUENCY / virt_frametime;
 
-    last_frame_realtime = timestamp;
-    last_frame_virttime = virt_timestamp;
-    if (overlay_intf) {
-        if (overlay_intf->overlay_set_fps)
-            overlay_intf->overlay_set_fps(framerate);
-        if (overlay_intf->overlay_set_virt_fps)
-            overlay_intf->overlay_set_virt_fps(virt_framerate);
+    dc->last_frame_realtime = timestamp;
+    dc->last_frame_virttime = virt_timestamp;
+    if (dc->overlay_intf) {
+        if (dc->overlay_intf->overlay_set_fps)
+            dc->overlay_intf->overlay_set_fps(framerate);
+        if (dc->overlay_intf->overlay_set_virt_fps)
+            dc->overlay_intf->overlay_set_virt_fps(virt_framerate);
     }
 
     title_set_fps_internal(virt_framerate);
 
     win_update_title();
-    framebuffer_render(&dc_pvr2);
+
+    /*
+     * turbo mode only gets picked up here so that it always starts and stops
+     * on a frame boundary.
+     */
+    bool turbo = washdc_atomic_int_load(&dc->turbo_enabled);
+    unsigned frame_no = dc->frame_count + 1;
+    if (!turbo || dc->turbo_frame_no == 0 || frame_hash_want(frame_no)) {
+        bench_push(BENCH_CAT_RENDER);
+        framebuffer_render(&dc->dc_pvr2);
+        bench_pop();
+    }
+    frame_hash_end_frame(frame_no);
     win_check_events();
+
+    bench_end_frame(virt_timestamp, code_cache_n_misses(&dc->code_cache));
+
+    if (turbo)
+        dc->turbo_frame_no = (dc->turbo_frame_no + 1) % dc->turbo_interval;
+    else
+        dc->turbo_frame_no = 0;
+    dc->dc_pvr2.ta.skip_render = turbo && dc->turbo_frame_no != 0 &&
+        dc->turbo_frame_no != dc->turbo_interval - 1 &&
+        !frame_hash_want(frame_no + 1) && !frame_hash_want(frame_no + 2);
+    if (dc->use_aica_thread)
+        aica_thread_set_silent(turbo);
+    else
+        aica_set_silent(&dc->aica, turbo);
+
+    if (!turbo)
+        pace_end_frame((dc_cycle_stamp_t)virt_frametime);
+}
+
+void dc_set_turbo(struct washdc_instance *inst, bool enable) {
+    washdc_atomic_int_store(&inst->turbo_enabled, enable);
+}
+
+bool dc_get_turbo(struct washdc_instance *inst) {
+    return washdc_atomic_int_load(&inst->turbo_enabled);
 }
 
 void dc_tex_cache_read(void **tex_dat_out, size_t *n_bytes_out,
                        struct pvr2_tex_meta const *meta) {
-    pvr2_tex_cache_read(&dc_pvr2, tex_dat_out, n_bytes_out, meta);
+    pvr2_tex_cache_read(&dc->dc_pvr2, tex_dat_out, n_bytes_out, meta);
 }
 
 static void construct_arm7_mem_map(struct memory_map *map) {
@@ -1348,15 +1765,18 @@ static void construct_arm7_mem_map(struct memory_map *map) {
      */
     memory_map_add(map, 0x00000000, 0x007fffff,
                    0xffffffff, ADDR_AICA_WAVE_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_wave_mem_intf, &aica.mem);
+                   &aica_wave_mem_intf, &dc->aica.mem);
     memory_map_add(map, 0x00800000, 0x00807fff,
-                   0xffffffff, 0xffffffff, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_sys_intf, &aica);
+                   0xffffffff, 0xffffffff, MEMORY_MAP_REGION_MMIO,
+                   &aica_sys_intf, &dc->aica);
 
     map->unmap = &arm7_unmapped_mem;
 }
 
 static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map) {
+    struct memory_interface const *aica_intf =
+        dc->use_aica_thread ? &aica_thread_sys_intf : &aica_sys_intf;
+
     /*
      * I don't like the idea of putting SH4_AREA_P4 ahead of AREA3 (memory),
      * but this absolutely needs to be at the front of the list because the
@@ -1369,22 +1789,22 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map) {
      * have not also put it at the begging of the regions array.
      */
     memory_map_add(map, SH4_AREA_P4_FIRST, SH4_AREA_P4_LAST,
-                   0xffffffff, 0xffffffff, MEMORY_MAP_REGION_UNKNOWN,
+                   0xffffffff, 0xffffffff, MEMORY_MAP_REGION_MMIO,
                    &sh4_p4_intf, sh4);
 
     // Main system memory.
     memory_map_add(map, 0x0c000000, 0x0cffffff,
                    0x1fffffff, ADDR_AREA3_MASK, MEMORY_MAP_REGION_RAM,
-                   &ram_intf, &dc_mem);
+                   &ram_intf, &dc->dc_mem);
     memory_map_add(map, 0x0d000000, 0x0dffffff,
                    0x1fffffff, ADDR_AREA3_MASK, MEMORY_MAP_REGION_RAM,
-                   &ram_intf, &dc_mem);
+                   &ram_intf, &dc->dc_mem);
     memory_map_add(map, 0x0e000000, 0x0effffff,
                    0x1fffffff, ADDR_AREA3_MASK, MEMORY_MAP_REGION_RAM,
-                   &ram_intf, &dc_mem);
+                   &ram_intf, &dc->dc_mem);
     memory_map_add(map, 0x0f000000, 0x0fffffff,
                    0x1fffffff, ADDR_AREA3_MASK, MEMORY_MAP_REGION_RAM,
-                   &ram_intf, &dc_mem);
+                   &ram_intf, &dc->dc_mem);
 
 
     /*
@@ -1406,27 +1826,27 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map) {
      */
     memory_map_add(map, 0x04000000, 0x047fffff,
                    0x1fffffff, (8<<20)-1, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_tex_mem_area64_intf, &dc_pvr2);
+                   &pvr2_tex_mem_area64_intf, &dc->dc_pvr2);
     memory_map_add(map, 0x05000000, 0x057fffff,
                    0x1fffffff, (8<<20)-1, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_tex_mem_area32_intf, &dc_pvr2);
+                   &pvr2_tex_mem_area32_intf, &dc->dc_pvr2);
     memory_map_add(map, 0x06000000, 0x067fffff,
                    0x1fffffff, (8<<20)-1, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_tex_mem_area64_intf, &dc_pvr2);
+                   &pvr2_tex_mem_area64_intf, &dc->dc_pvr2);
     memory_map_add(map, 0x07000000, 0x077fffff,
                    0x1fffffff, (8<<20)-1, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_tex_mem_area32_intf, &dc_pvr2);
+                   &pvr2_tex_mem_area32_intf, &dc->dc_pvr2);
 
 
     memory_map_add(map, 0x10000000, 0x107fffff,
                    0x1fffffff, 0x1fffffff, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_ta_fifo_intf, &dc_pvr2);
+                   &pvr2_ta_fifo_intf, &dc->dc_pvr2);
     memory_map_add(map, 0x10800000, 0x10ffffff,
                    0x1fffffff, 0x1fffffff, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_ta_yuv_fifo_intf, &dc_pvr2);
+                   &pvr2_ta_yuv_fifo_intf, &dc->dc_pvr2);
     memory_map_add(map, 0x11000000, 0x117fffff,
                    0x1fffffff, 0x1fffffff, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_ta_fifo_intf, &dc_pvr2);
+                   &pvr2_ta_fifo_intf, &dc->dc_pvr2);
 
     /*
      * TODO: YUV FIFO - apparently I made it a special case in the DMAC code
@@ -1440,88 +1860,88 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map) {
 
     memory_map_add(map, ADDR_BIOS_FIRST, ADDR_BIOS_LAST,
                    0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &boot_rom_intf, &firmware);
+                   &boot_rom_intf, &dc->firmware);
     memory_map_add(map, ADDR_FLASH_FIRST, ADDR_FLASH_LAST,
                    0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &flash_mem_intf, &flash_mem);
+                   &flash_mem_intf, &dc->flash_mem);
     memory_map_add(map, ADDR_G1_FIRST, ADDR_G1_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &g1_intf, NULL);
     memory_map_add(map, ADDR_SYS_FIRST, ADDR_SYS_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &sys_block_intf, &sys_block);
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
+                   &sys_block_intf, &dc->sys_block);
     memory_map_add(map, ADDR_MAPLE_FIRST, ADDR_MAPLE_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &maple_intf, &maple);
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
+                   &maple_intf, &dc->maple);
     memory_map_add(map, ADDR_G2_FIRST, ADDR_G2_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &g2_intf, NULL);
     memory_map_add(map, ADDR_PVR2_FIRST, ADDR_PVR2_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_reg_intf, &dc_pvr2);
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
+                   &pvr2_reg_intf, &dc->dc_pvr2);
     memory_map_add(map, ADDR_MODEM_FIRST, ADDR_MODEM_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &modem_intf, NULL);
     /* memory_map_add(map, ADDR_PVR2_CORE_FIRST, ADDR_PVR2_CORE_LAST, */
     /*                0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN, */
     /*                &pvr2_core_reg_intf, NULL); */
     memory_map_add(map, ADDR_AICA_WAVE_FIRST, ADDR_AICA_WAVE_LAST,
                    0x1fffffff, ADDR_AICA_WAVE_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_wave_mem_intf, &aica.mem);
+                   &aica_wave_mem_intf, &dc->aica.mem);
     memory_map_add(map, 0x00700000, 0x00707fff,
-                   0x1fffffff, 0xffffffff, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_sys_intf, &aica);
+                   0x1fffffff, 0xffffffff, MEMORY_MAP_REGION_MMIO,
+                   aica_intf, &dc->aica);
     memory_map_add(map, ADDR_AICA_RTC_FIRST, ADDR_AICA_RTC_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_rtc_intf, &rtc);
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
+                   &aica_rtc_intf, &dc->rtc);
     memory_map_add(map, ADDR_GDROM_FIRST, ADDR_GDROM_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &gdrom_reg_intf, &gdrom);
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
+                   &gdrom_reg_intf, &dc->gdrom);
     memory_map_add(map, ADDR_EXT_DEV_FIRST, ADDR_EXT_DEV_LAST,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &ext_dev_intf, NULL);
 
     memory_map_add(map, ADDR_BIOS_FIRST + 0x02000000, ADDR_BIOS_LAST + 0x02000000,
                    0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &boot_rom_intf, &firmware);
+                   &boot_rom_intf, &dc->firmware);
     memory_map_add(map, ADDR_FLASH_FIRST + 0x02000000, ADDR_FLASH_LAST + 0x02000000,
                    0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &flash_mem_intf, &flash_mem);
+                   &flash_mem_intf, &dc->flash_mem);
     memory_map_add(map, ADDR_G1_FIRST + 0x02000000, ADDR_G1_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &g1_intf, NULL);
     memory_map_add(map, ADDR_SYS_FIRST + 0x02000000, ADDR_SYS_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &sys_block_intf, NULL);
     memory_map_add(map, ADDR_MAPLE_FIRST + 0x02000000, ADDR_MAPLE_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &maple_intf, NULL);
     memory_map_add(map, ADDR_G2_FIRST + 0x02000000, ADDR_G2_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &g2_intf, NULL);
     memory_map_add(map, ADDR_PVR2_FIRST + 0x02000000, ADDR_PVR2_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &pvr2_reg_intf, &dc_pvr2);
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
+                   &pvr2_reg_intf, &dc->dc_pvr2);
     memory_map_add(map, ADDR_MODEM_FIRST + 0x02000000, ADDR_MODEM_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &modem_intf, NULL);
     /* memory_map_add(map, ADDR_PVR2_CORE_FIRST + 0x02000000, ADDR_PVR2_CORE_LAST + 0x02000000, */
     /*                0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN, */
     /*                &pvr2_core_reg_intf, NULL); */
     memory_map_add(map, ADDR_AICA_WAVE_FIRST + 0x02000000, ADDR_AICA_WAVE_LAST + 0x02000000,
                    0x1fffffff, ADDR_AICA_WAVE_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_wave_mem_intf, &aica.mem);
+                   &aica_wave_mem_intf, &dc->aica.mem);
     memory_map_add(map, 0x00700000 + 0x02000000, 0x00707fff + 0x02000000,
-                   0x1fffffff, 0xffffffff, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_sys_intf, &aica);
+                   0x1fffffff, 0xffffffff, MEMORY_MAP_REGION_MMIO,
+                   aica_intf, &dc->aica);
     memory_map_add(map, ADDR_AICA_RTC_FIRST + 0x02000000, ADDR_AICA_RTC_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_rtc_intf, &rtc);
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
+                   &aica_rtc_intf, &dc->rtc);
     memory_map_add(map, ADDR_GDROM_FIRST + 0x02000000, ADDR_GDROM_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
-                   &gdrom_reg_intf, &gdrom);
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
+                   &gdrom_reg_intf, &dc->gdrom);
     memory_map_add(map, ADDR_EXT_DEV_FIRST + 0x02000000, ADDR_EXT_DEV_LAST + 0x02000000,
-                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_UNKNOWN,
+                   0x1fffffff, ADDR_AREA0_MASK, MEMORY_MAP_REGION_MMIO,
                    &ext_dev_intf, NULL);
 
     /*
@@ -1540,8 +1960,8 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map) {
     map->unmap = &sh4_unmapped_mem;
 }
 
-void dc_request_frame_stop(void) {
-    frame_stop = true;
+void dc_request_frame_stop(struct washdc_instance *inst) {
+    inst->frame_stop = true;
 }
 
 static DEF_ERROR_U32_ATTR(ch2_dma_xfer_src_first)
@@ -1550,19 +1970,19 @@ static DEF_ERROR_U32_ATTR(ch2_dma_xfer_dst_first)
 static DEF_ERROR_U32_ATTR(ch2_dma_xfer_dst_last)
 
 void dc_set_lmmode0(unsigned val) {
-    lmmode0 = val;
+    dc->lmmode0 = val;
 }
 
 void dc_set_lmmode1(unsigned val) {
-    lmmode1 = val;
+    dc->lmmode1 = val;
 }
 
 unsigned dc_get_lmmode0(void) {
-    return lmmode0;
+    return dc->lmmode0;
 }
 
 unsigned dc_get_lmmode1(void) {
-    return lmmode1;
+    return dc->lmmode1;
 }
 
 
@@ -1585,28 +2005,28 @@ dc_ch2_dma_xfer_slow(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
     uint32_t src = xfer_src_first;
     uint32_t dst = xfer_dst_first;
     while (src <= xfer_src_last) {
-        uint32_t val = memory_map_read_32(&mem_map, src);
+        uint32_t val = memory_map_read_32(&dc->mem_map, src);
 
         if ((dst >= ADDR_TA_FIFO_POLY_FIRST) &&
             (dst <= ADDR_TA_FIFO_POLY_LAST)) {
-            pvr2_ta_fifo_poly_write_32(dst, val, &dc_pvr2);
+            pvr2_ta_fifo_poly_write_32(dst, val, &dc->dc_pvr2);
         } else if ((dst >= ADDR_AREA4_TEX_REGION_0_FIRST) &&
                    (dst <= ADDR_AREA4_TEX_REGION_0_LAST)) {
             uint32_t dst_offs = dst - ADDR_AREA4_TEX_REGION_0_FIRST;
             if (dc_get_lmmode0() == 0)
-                pvr2_tex_mem_64bit_write32(&dc_pvr2, dst_offs, val);
+                pvr2_tex_mem_64bit_write32(&dc->dc_pvr2, dst_offs, val);
             else
-                pvr2_tex_mem_32bit_write32(&dc_pvr2, dst_offs, val);
+                pvr2_tex_mem_32bit_write32(&dc->dc_pvr2, dst_offs, val);
         } else if ((xfer_dst >= ADDR_AREA4_TEX_REGION_1_FIRST) &&
                    (xfer_dst <= ADDR_AREA4_TEX_REGION_1_LAST)) {
             uint32_t dst_offs = dst - ADDR_AREA4_TEX_REGION_1_FIRST;
             if (dc_get_lmmode1() == 0)
-                pvr2_tex_mem_64bit_write32(&dc_pvr2, dst_offs, val);
+                pvr2_tex_mem_64bit_write32(&dc->dc_pvr2, dst_offs, val);
             else
-                pvr2_tex_mem_32bit_write32(&dc_pvr2, dst_offs, val);
+                pvr2_tex_mem_32bit_write32(&dc->dc_pvr2, dst_offs, val);
         } else if (xfer_dst >= ADDR_TA_FIFO_YUV_FIRST &&
                xfer_dst <= ADDR_TA_FIFO_YUV_LAST) {
-            pvr2_yuv_input_data(&dc_pvr2, &val, sizeof(val));
+            pvr2_yuv_input_data(&dc->dc_pvr2, &val, sizeof(val));
         } else {
             error_set_ch2_dma_xfer_src_last(xfer_src_last);
             error_set_ch2_dma_xfer_src_first(xfer_src_first);
@@ -1624,7 +2044,7 @@ dc_ch2_dma_xfer_slow(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
 
 dc_cycle_stamp_t
 dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
-    struct memory_map_region *src_region = memory_map_get_region(&mem_map,
+    struct memory_map_region *src_region = memory_map_get_region(&dc->mem_map,
                                                                  xfer_src,
                                                                  n_words * 4);
 
@@ -1645,12 +2065,14 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
     uint32_t mask = src_region->mask;
     if ((xfer_dst >= ADDR_TA_FIFO_POLY_FIRST) &&
         (xfer_dst <= ADDR_TA_FIFO_POLY_LAST)) {
+        bench_push(BENCH_CAT_TA);
         while (n_words--) {
             uint32_t buf = read32(xfer_src & mask, ctxt);
-            pvr2_ta_fifo_poly_write_32(xfer_dst, buf, &dc_pvr2);
+            pvr2_ta_fifo_poly_write_32(xfer_dst, buf, &dc->dc_pvr2);
             xfer_dst += sizeof(buf);
             xfer_src += sizeof(buf);
         }
+        bench_pop();
     } else if ((xfer_dst >= ADDR_AREA4_TEX_REGION_0_FIRST) &&
                (xfer_dst <= ADDR_AREA4_TEX_REGION_0_LAST)) {
         // TODO: do tex DMA transfers in large chuks instead of 4-byte increments
@@ -1658,14 +2080,14 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
         if (dc_get_lmmode0() == 0) {
             while (n_words--) {
                 uint32_t buf = read32(xfer_src & mask, ctxt);
-                pvr2_tex_mem_64bit_write32(&dc_pvr2, xfer_dst, buf);
+                pvr2_tex_mem_64bit_write32(&dc->dc_pvr2, xfer_dst, buf);
                 xfer_dst += sizeof(buf);
                 xfer_src += sizeof(buf);
             }
         } else {
             while (n_words--) {
                 uint32_t buf = read32(xfer_src & mask, ctxt);
-                pvr2_tex_mem_32bit_write32(&dc_pvr2, xfer_dst, buf);
+                pvr2_tex_mem_32bit_write32(&dc->dc_pvr2, xfer_dst, buf);
                 xfer_dst += sizeof(buf);
                 xfer_src += sizeof(buf);
             }
@@ -1677,14 +2099,14 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
         if (dc_get_lmmode1() == 0) {
             while (n_words--) {
                 uint32_t buf = read32(xfer_src & mask, ctxt);
-                pvr2_tex_mem_64bit_write32(&dc_pvr2, xfer_dst, buf);
+                pvr2_tex_mem_64bit_write32(&dc->dc_pvr2, xfer_dst, buf);
                 xfer_dst += sizeof(buf);
                 xfer_src += sizeof(buf);
             }
         } else {
             while (n_words--) {
                 uint32_t buf = read32(xfer_src & mask, ctxt);
-                pvr2_tex_mem_32bit_write32(&dc_pvr2, xfer_dst, buf);
+                pvr2_tex_mem_32bit_write32(&dc->dc_pvr2, xfer_dst, buf);
                 xfer_dst += sizeof(buf);
                 xfer_src += sizeof(buf);
             }
@@ -1694,7 +2116,7 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
         while (n_words--) {
             uint32_t in = read32(xfer_src & mask, ctxt);
             xfer_src += sizeof(in);
-            pvr2_yuv_input_data(&dc_pvr2, &in, sizeof(in));
+            pvr2_yuv_input_data(&dc->dc_pvr2, &in, sizeof(in));
         }
     } else {
         error_set_address(xfer_dst);
@@ -1773,16 +2195,17 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
 int dc_try_read32(uint32_t addr, uint32_t *valp) {
 #ifdef ENABLE_MMU
     struct sh4_utlb_ent *ent =
-        sh4_utlb_find_ent_associative(&cpu, addr);
+        sh4_utlb_find_ent_associative(&dc->cpu, addr);
     if (ent)
         addr = sh4_utlb_ent_translate_addr(ent, addr);
 #endif
 
-    return memory_map_try_read_32(&mem_map, addr, valp);
+    return memory_map_try_read_32(&dc->mem_map, addr, valp);
 }
 
-void dc_get_pvr2_stats(struct pvr2_stat *stats) {
-    *stats = dc_pvr2.stat;
+void
+dc_get_pvr2_stats(struct washdc_instance *inst, struct pvr2_stat *stats) {
+    *stats = inst->dc_pvr2.stat;
 }
 
 static uint32_t trans_bind_washdc_to_maple(uint32_t wash) {
@@ -1825,11 +2248,13 @@ static uint32_t trans_bind_washdc_to_maple(uint32_t wash) {
 }
 
 void dc_controller_press_buttons(unsigned port_no, uint32_t btns) {
-    maple_controller_press_btns(&maple, port_no, trans_bind_washdc_to_maple(btns));
+    maple_movie_input(MAPLE_MOVIE_CONT_PRESS, port_no,
+                      trans_bind_washdc_to_maple(btns), 0);
 }
 
 void dc_controller_release_buttons(unsigned port_no, uint32_t btns) {
-    maple_controller_release_btns(&maple, port_no, trans_bind_washdc_to_maple(btns));
+    maple_movie_input(MAPLE_MOVIE_CONT_RELEASE, port_no,
+                      trans_bind_washdc_to_maple(btns), 0);
 }
 
 static int trans_axis_washdc_to_maple(int axis) {
@@ -1852,12 +2277,12 @@ static int trans_axis_washdc_to_maple(int axis) {
 }
 
 void dc_controller_set_axis(unsigned port_no, unsigned axis, unsigned val) {
-    maple_controller_set_axis(&maple, port_no,
-                              trans_axis_washdc_to_maple(axis), val);
+    maple_movie_input(MAPLE_MOVIE_CONT_AXIS, port_no,
+                      trans_axis_washdc_to_maple(axis), val);
 }
 
 void dc_keyboard_set_key(unsigned port_no, unsigned btn_no, bool is_pressed) {
-    maple_keyboard_press_key(&maple, port_no, btn_no, is_pressed);
+    maple_movie_input(MAPLE_MOVIE_KBD_KEY, port_no, btn_no, is_pressed);
 }
 
 void dc_keyboard_press_special(unsigned port_no,
@@ -1879,7 +2304,7 @@ void dc_keyboard_press_special(unsigned port_no,
         spec |= MAPLE_KEYBOARD_RIGHT_ALT;
     if (which & WASHDC_KEYBOARD_S2)
         spec |= MAPLE_KEYBOARD_S2;
-    maple_keyboard_press_special(&maple, port_no, spec);
+    maple_movie_input(MAPLE_MOVIE_KBD_PRESS_SPECIAL, port_no, spec, 0);
 }
 
 void dc_keyboard_release_special(unsigned port_no,
@@ -1901,7 +2326,7 @@ void dc_keyboard_release_special(unsigned port_no,
         spec |= MAPLE_KEYBOARD_RIGHT_ALT;
     if (which & WASHDC_KEYBOARD_S2)
         spec |= MAPLE_KEYBOARD_S2;
-    maple_keyboard_release_special(&maple, port_no, spec);
+    maple_movie_input(MAPLE_MOVIE_KBD_RELEASE_SPECIAL, port_no, spec, 0);
 }
 
 static float sh4_unmapped_readfloat(uint32_t addr, void *ctxt) {
@@ -1992,11 +2417,13 @@ static void sh4_unmapped_write32(uint32_t addr, uint32_t val, void *ctxt) {
          * default value of all of these registers, anyways.
          */
         LOG_WARN("%s (PC=0x%08x) - allowing 4-byte write of 0x%08x to unmapped address "
-                 "0x%08x\n", __func__, (unsigned)cpu.reg[SH4_REG_PC], (unsigned)val, (unsigned)addr);
+                 "0x%08x\n", __func__, (unsigned)dc->cpu.reg[SH4_REG_PC],
+                 (unsigned)val, (unsigned)addr);
     } else if ((((addr >> 16) == 0xbc52) || ((addr >> 16) == 0xbc53)) && !val) {
         // same situation as above, but this time it's Bangai-O
         LOG_WARN("%s (PC=0x%08x) - allowing 4-byte write of 0x%08x to unmapped address "
-                 "0x%08x\n", __func__, (unsigned)cpu.reg[SH4_REG_PC], (unsigned)val, (unsigned)addr);
+                 "0x%08x\n", __func__, (unsigned)dc->cpu.reg[SH4_REG_PC],
+                 (unsigned)val, (unsigned)addr);
     } else {
         error_set_feature("memory mapping");
         error_set_value(val);
@@ -37,8 +37,6 @@
 #include "washdc/debugger.h"
 #endif
 
-extern struct dc_clock sh4_clock;
-
 #define ADDR_IP_BIN        0x8c008000
 #define ADDR_1ST_READ_BIN  0x8c010000
 #define ADDR_BOOTSTRAP     0x8c008300
@@ -54,7 +52,12 @@ extern struct dc_clock sh4_clock;
 struct washdc_overlay_intf;
 struct washdc_sound_intf;
 
-struct washdc_gameconsole const*
+/*
+ * The rest of libwashdc is still hooked up to whichever instance was created
+ * last, so trying to create a second one while the first is still around
+ * raises an error.
+ */
+struct washdc_instance *
 dreamcast_init(char const *gdi_path,
                struct rend_if const *gfx_if,
                struct washdc_overlay_intf const *overlay_intf_fns,
@@ -63,9 +66,17 @@ dreamcast_init(char const *gdi_path,
                struct washdc_sound_intf const *snd_intf,
                bool flash_mem_writeable);
 
-void dreamcast_cleanup();
+// this also frees inst
+void dreamcast_cleanup(struct washdc_instance *inst);
+
+struct washdc_gameconsole const *
+dreamcast_get_console(struct washdc_instance *inst);
+
+void dreamcast_run(struct washdc_instance *inst);
 
-void dreamcast_run();
+unsigned dreamcast_sh4_difftest(struct washdc_instance *inst,
+                                char const *report_path, unsigned n_cases,
+                                unsigned seed);
 
 /*
  * Kill the emulator.  This function can be safely called
@@ -75,9 +86,14 @@ void dreamcast_kill(void);
 
 Sh4 *dreamcast_get_cpu();
 
+struct dc_clock *dreamcast_get_sh4_clock(void);
+
 void dc_print_perf_stats(void);
 
-bool dc_is_running(void);
+// write out the current instance's main memory, if there is one
+void dc_dump_main_memory(char const *path);
+
+bool dc_is_running(struct washdc_instance *inst);
 
 /*
  * this function should only ever be called from the emulation thread.
@@ -129,7 +145,21 @@ enum dc_boot_mode {
 
 void dc_toggle_overlay(void);
 
-void dc_request_frame_stop(void);
+void dc_request_frame_stop(struct washdc_instance *inst);
+
+/*
+ * turbo mode runs the emulator as fast as it can go while skipping most of
+ * the presentation work.  Only one out of every exec.turbo-interval frames
+ * gets presented, and the AICA stops producing audio (its channels, timers
+ * and interrupts still advance normally).  On the other frames, renders into
+ * framebuffers that are only ever displayed get skipped; render-to-texture
+ * targets and framebuffers the guest reads back are still rendered so that
+ * the guest sees the same data it would at normal speed.  These can be called
+ * from any thread; the change takes effect at the end of the current frame.
+ */
+#define DC_TURBO_INTERVAL_DEFAULT 10
+void dc_set_turbo(struct washdc_instance *inst, bool enable);
+bool dc_get_turbo(struct washdc_instance *inst);
 
 dc_cycle_stamp_t
 dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words);
@@ -144,9 +174,10 @@ void dc_tex_cache_read(void **tex_dat_out, size_t *n_bytes_out,
                        struct pvr2_tex_meta const *meta);
 
 struct pvr2_stat;
-void dc_get_pvr2_stats(struct pvr2_stat *stats);
+void
+dc_get_pvr2_stats(struct washdc_instance *inst, struct pvr2_stat *stats);
 
-unsigned dc_get_frame_count(void);
+unsigned dc_get_frame_count(struct washdc_instance *inst);
 
 /*
  * attempt to read a 4-byte value from the sh4's memory map.
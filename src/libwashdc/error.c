@@ -60,7 +60,7 @@ WASHDC_NORETURN void error_raise(enum error_type tp) {
 
     bool dump_mem;
     if (cfg_get_bool("wash.dbg.dump_mem_on_error", &dump_mem) == 0 && dump_mem)
-        washdc_dump_main_memory("washdc_error_dump.bin");
+        dc_dump_main_memory("washdc_error_dump.bin");
 
     fflush(stdout);
     fflush(stderr);
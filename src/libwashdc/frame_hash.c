@@ -0,0 +1,139 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+#include "config.h"
+#include "log.h"
+#include "dreamcast.h"
+#include "screenshot.h"
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+
+#include "frame_hash.h"
+
+bool frame_hash_enabled;
+
+static struct frame_hash {
+    washdc_hostfile file;
+
+    unsigned checkpoints[FRAME_HASH_MAX_CHECKPOINTS];
+    unsigned n_checkpoints;
+
+    // index of the next checkpoint in checkpoints
+    unsigned next;
+} frame_hash;
+
+static int parse_checkpoints(char const *str);
+
+void frame_hash_init(void) {
+    memset(&frame_hash, 0, sizeof(frame_hash));
+    frame_hash.file = WASHDC_HOSTFILE_INVALID;
+    frame_hash_enabled = false;
+
+    char const *path = config_get_frame_hash_path();
+    if (!path || !strlen(path))
+        return;
+
+    char const *frames = config_get_frame_hash_frames();
+    if (parse_checkpoints(frames) != 0) {
+        LOG_ERROR("bad frame-hash checkpoint list \"%s\"\n", frames);
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+
+    frame_hash.file = washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                                           WASHDC_HOSTFILE_TEXT);
+    if (frame_hash.file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open frame-hash output file \"%s\"\n", path);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    LOG_INFO("hashing %u checkpoint frames into \"%s\"\n",
+             frame_hash.n_checkpoints, path);
+    frame_hash_enabled = true;
+}
+
+void frame_hash_cleanup(void) {
+    if (frame_hash.file != WASHDC_HOSTFILE_INVALID) {
+        if (frame_hash.next < frame_hash.n_checkpoints) {
+            LOG_WARN("exited before frame-hash checkpoint %u\n",
+                     frame_hash.checkpoints[frame_hash.next]);
+        }
+        washdc_hostfile_close(frame_hash.file);
+    }
+    memset(&frame_hash, 0, sizeof(frame_hash));
+    frame_hash.file = WASHDC_HOSTFILE_INVALID;
+    frame_hash_enabled = false;
+}
+
+bool frame_hash_want(unsigned frame_no) {
+    return frame_hash_enabled && frame_hash.next < frame_hash.n_checkpoints &&
+        frame_hash.checkpoints[frame_hash.next] == frame_no;
+}
+
+void frame_hash_end_frame(unsigned frame_no) {
+    if (!frame_hash_want(frame_no))
+        return;
+
+    uint64_t hash;
+    unsigned width, height;
+    if (screenshot_hash(&hash, &width, &height) == 0) {
+        washdc_hostfile_printf(frame_hash.file, "%u %016llx %ux%u\n",
+                               frame_no, (unsigned long long)hash,
+                               width, height);
+    } else {
+        LOG_WARN("unable to grab the framebuffer at frame %u\n", frame_no);
+        washdc_hostfile_printf(frame_hash.file, "%u none\n", frame_no);
+    }
+    washdc_hostfile_flush(frame_hash.file);
+
+    if (++frame_hash.next == frame_hash.n_checkpoints) {
+        LOG_INFO("last frame-hash checkpoint reached at frame %u\n",
+                 frame_no);
+        dreamcast_kill();
+    }
+}
+
+static int parse_checkpoints(char const *str) {
+    char const *pos = str;
+    unsigned last = 0;
+
+    frame_hash.n_checkpoints = 0;
+    do {
+        char *endp;
+        unsigned long frame_no = strtoul(pos, &endp, 10);
+        if (endp == pos || frame_no <= last || frame_no > UINT_MAX ||
+            (*endp && *endp != ','))
+            return -1;
+        if (frame_hash.n_checkpoints >= FRAME_HASH_MAX_CHECKPOINTS)
+            return -1;
+
+        frame_hash.checkpoints[frame_hash.n_checkpoints++] = frame_no;
+        last = frame_no;
+        pos = *endp ? endp + 1 : endp;
+    } while (*pos);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef FRAME_HASH_H_
+#define FRAME_HASH_H_
+
+/*
+ * Framebuffer checkpoints for regression testing.
+ *
+ * When a frame-hash output path is configured (washdc-headless's -H option),
+ * the framebuffer gets hashed with screenshot_hash at the end of each
+ * checkpoint frame (-K option; a comma-separated list of frame numbers,
+ * counting from 1 and strictly increasing).  Each checkpoint becomes one line
+ * in the output file:
+ *
+ *     <frame> <16 hex digit hash> <width>x<height>
+ *
+ * or "<frame> none" if the framebuffer could not be grabbed.  The emulator
+ * exits after the last checkpoint.
+ *
+ * Checkpoint frames are always drawn, even in turbo mode.  The hashes are
+ * only reproducible if everything else is (same firmware, flash, disc image,
+ * input movie and CPU backend), so exec.aica-thread is ignored while this is
+ * enabled.
+ *
+ * These functions must only be called from the emulation thread.
+ */
+
+#include <stdbool.h>
+
+#define FRAME_HASH_MAX_CHECKPOINTS 64
+
+extern bool frame_hash_enabled;
+
+void frame_hash_init(void);
+void frame_hash_cleanup(void);
+
+// returns true if frame_no is the next checkpoint
+bool frame_hash_want(unsigned frame_no);
+
+/*
+ * called at the end of every frame, after the framebuffer has been drawn.  If
+ * frame_no is a checkpoint then this hashes the framebuffer, and if it was the
+ * last one this kills the emulator.
+ */
+void frame_hash_end_frame(unsigned frame_no);
+
+#endif
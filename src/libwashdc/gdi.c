@@ -44,7 +44,6 @@ struct gdi_mount {
 };
 
 static void mount_gdi_cleanup(struct mount *mount);
-static void cleanup_gdi_info(struct gdi_info *info);
 static unsigned mount_gdi_session_count(struct mount *mount);
 static int mount_gdi_read_toc(struct mount *mount, struct mount_toc *toc,
                               unsigned session_no);
@@ -57,7 +56,6 @@ static bool gdi_validate_fmt(struct gdi_info const *info);
 static int mount_gdi_get_meta(struct mount *mount, struct mount_meta *meta);
 
 static unsigned mount_gdi_get_leadout(struct mount *mount);
-static void parse_gdi(struct gdi_info *outp, char const *path);
 
 /*
  * dumps the given gdi to stdout, this is really only here for
@@ -92,7 +90,7 @@ static struct mount_ops gdi_mount_ops = {
  */
 #define MIN_TRACKS 3
 
-static void parse_gdi(struct gdi_info *outp, char const *path) {
+void parse_gdi(struct gdi_info *outp, char const *path) {
     unsigned track_count = 0;
     struct string whole_file_txt;
     struct gdi_track *tracks = NULL;
@@ -218,7 +216,7 @@ static void parse_gdi(struct gdi_info *outp, char const *path) {
     outp->tracks = tracks;
 }
 
-static void cleanup_gdi_info(struct gdi_info *info) {
+void cleanup_gdi_info(struct gdi_info *info) {
     unsigned track_no;
 
     for (track_no = 0; track_no < info->n_tracks; track_no++) {
@@ -60,4 +60,8 @@ struct gdi_info {
 
 void mount_gdi(char const *path);
 
+// read in a .gdi file without opening any of its tracks
+void parse_gdi(struct gdi_info *outp, char const *path);
+void cleanup_gdi_info(struct gdi_info *info);
+
 #endif
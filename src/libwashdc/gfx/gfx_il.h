@@ -74,6 +74,13 @@ enum gfx_il {
     // call this to set clip_min, clip_max
     GFX_IL_SET_CLIP_RANGE,
 
+    /*
+     * set the array of vertices which GFX_IL_DRAW_ARRAY draws from.  This
+     * needs to be sent after GFX_IL_BEGIN_REND and before any
+     * GFX_IL_DRAW_ARRAY.
+     */
+    GFX_IL_SET_VERT_ARRAY,
+
     // use this to render a group of polygons
     GFX_IL_DRAW_ARRAY,
 
@@ -111,6 +118,9 @@ union gfx_il_arg {
         unsigned tex_no;
         enum gfx_tex_fmt pix_fmt;
         int width, height;
+
+        // see the comment above struct gfx_tex for the mipmap data layout
+        bool mipmap;
     } bind_tex;
 
     struct {
@@ -157,12 +167,14 @@ union gfx_il_arg {
     } set_clip_range;
 
     struct {
-        /*
-         * each vert has a len of GFX_IL_VERT_LEN; ergo the total length of
-         * verts (in terms of sizeof float) is n_verts * GFX_IL_VERT_LEN.
-         */
+        struct gfx_vert const *verts;
+        unsigned n_verts;
+    } set_vert_array;
+
+    struct {
+        // index of the first vertex within the current vertex array
+        unsigned first_vert;
         unsigned n_verts;
-        float const *verts;
     } draw_array;
 
     struct {
@@ -43,7 +43,8 @@ void gfx_tex_cache_cleanup(void) {
 }
 
 void gfx_tex_cache_bind(unsigned tex_no, int obj_no, unsigned width,
-                        unsigned height, enum gfx_tex_fmt tex_fmt) {
+                        unsigned height, enum gfx_tex_fmt tex_fmt,
+                        bool mipmap) {
     struct gfx_obj *obj = gfx_obj_get(obj_no);
     struct gfx_tex *tex = tex_cache + tex_no;
 
@@ -51,6 +52,7 @@ void gfx_tex_cache_bind(unsigned tex_no, int obj_no, unsigned width,
     tex->tex_fmt = tex_fmt;
     tex->width = width;
     tex->height = height;
+    tex->mipmap = mipmap;
     tex->valid = true;
 
     obj->arg = tex;
@@ -32,7 +32,8 @@
  * Bind the given gfx_obj to the given texture-unit.
  */
 void gfx_tex_cache_bind(unsigned tex_no, int obj_no, unsigned width,
-                        unsigned height, enum gfx_tex_fmt tex_fmt);
+                        unsigned height, enum gfx_tex_fmt tex_fmt,
+                        bool mipmap);
 
 void gfx_tex_cache_unbind(unsigned tex_no);
 
@@ -59,8 +59,9 @@ static void rend_bind_tex(struct gfx_il_inst *cmd) {
     enum gfx_tex_fmt pix_fmt = cmd->arg.bind_tex.pix_fmt;
     int width = cmd->arg.bind_tex.width;
     int height = cmd->arg.bind_tex.height;
+    bool mipmap = cmd->arg.bind_tex.mipmap;
 
-    gfx_tex_cache_bind(tex_no, obj_handle, width, height, pix_fmt);
+    gfx_tex_cache_bind(tex_no, obj_handle, width, height, pix_fmt, mipmap);
 }
 
 static void rend_unbind_tex(struct gfx_il_inst *cmd) {
@@ -95,10 +96,16 @@ static void rend_set_clip_range(struct gfx_il_inst *cmd) {
     gfx_rend_ifp->set_clip_range(clip_min, clip_max);
 }
 
+static void rend_set_vert_array(struct gfx_il_inst *cmd) {
+    unsigned n_verts = cmd->arg.set_vert_array.n_verts;
+    struct gfx_vert const *verts = cmd->arg.set_vert_array.verts;
+    gfx_rend_ifp->set_vert_array(verts, n_verts);
+}
+
 static void rend_draw_array(struct gfx_il_inst *cmd) {
+    unsigned first_vert = cmd->arg.draw_array.first_vert;
     unsigned n_verts = cmd->arg.draw_array.n_verts;
-    float const *verts = cmd->arg.draw_array.verts;
-    gfx_rend_ifp->draw_array(verts, n_verts);
+    gfx_rend_ifp->draw_array(first_vert, n_verts);
 }
 
 static void rend_clear(struct gfx_il_inst *cmd) {
@@ -225,6 +232,9 @@ void rend_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
         case GFX_IL_SET_CLIP_RANGE:
             rend_set_clip_range(cmd);
             break;
+        case GFX_IL_SET_VERT_ARRAY:
+            rend_set_vert_array(cmd);
+            break;
         case GFX_IL_DRAW_ARRAY:
             rend_draw_array(cmd);
             break;
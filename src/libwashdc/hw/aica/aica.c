@@ -32,6 +32,10 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "sound.h"
 #include "log.h"
 #include "dc_sched.h"
@@ -39,9 +43,11 @@
 #include "intmath.h"
 #include "hw/arm7/arm7.h"
 #include "hw/sys/holly_intc.h"
+#include "aica_thread.h"
 #include "adpcm.h"
 #include "intmath.h"
 #include "compiler_bullshit.h"
+#include "bench.h"
 
 #include "aica.h"
 
@@ -176,6 +182,7 @@ typedef uint32_t aica_atten;
 static DEF_ERROR_INT_ATTR(channel)
 
 static void raise_aica_sh4_int(struct aica *aica);
+static void aica_set_sh4_int_line(bool asserted);
 static void post_delay_raise_aica_sh4_int(struct SchedEvent *event);
 
 // If this is defined, WashingtonDC will panic on unrecognized AICA addresses.
@@ -252,7 +259,7 @@ static unsigned aica_chan_effective_rate(struct aica const *aica, unsigned chan_
 
 static unsigned aica_samples_per_step(unsigned effective_rate, unsigned step_no);
 
-static void aica_process_sample(struct aica *aica);
+static void aica_mix_block(struct aica *aica, unsigned n_samples);
 
 static int get_octave_signed(struct aica_chan const *chan);
 static aica_sample_pos get_sample_rate_multiplier(struct aica_chan const *chan);
@@ -278,7 +285,8 @@ struct memory_interface aica_sys_intf = {
 };
 
 void aica_init(struct aica *aica, struct arm7 *arm7,
-               struct dc_clock *clk, struct dc_clock *sh4_clk) {
+               struct dc_clock *clk, struct dc_clock *sh4_clk,
+               struct exec_mem *native) {
     memset(aica, 0, sizeof(*aica));
 
     aica->clk = clk;
@@ -298,6 +306,12 @@ void aica_init(struct aica *aica, struct arm7 *arm7,
     aica->sys_reg[AICA_SCILV1 / 4] = 0x50;
     aica->sys_reg[AICA_SCILV2 / 4] = 0x08;
 
+    /*
+     * The firmware sets this when it boots, so programs loaded directly
+     * without it would never be heard if it started at zero.
+     */
+    aica->master_volume = 0xf;
+
     aica->timers[0].evt.handler = aica_timer_a_handler;
     aica->timers[1].evt.handler = aica_timer_b_handler;
     aica->timers[2].evt.handler = aica_timer_c_handler;
@@ -308,9 +322,11 @@ void aica_init(struct aica *aica, struct arm7 *arm7,
     aica_sched_all_timers(aica);
 
     aica_wave_mem_init(&aica->mem);
+    aica_dsp_init(&aica->dsp, native);
 }
 
 void aica_cleanup(struct aica *aica) {
+    aica_dsp_cleanup(&aica->dsp);
     aica_wave_mem_cleanup(&aica->mem);
 }
 
@@ -476,7 +492,9 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
 
     switch (idx * 4) {
     case AICA_MASTER_VOLUME:
-        LOG_DBG("Writing to AICA_MASTER_VOLUME\n");
+        memcpy(&val, aica->sys_reg + (AICA_MASTER_VOLUME/4), sizeof(val));
+        aica->master_volume = val & 0xf;
+        LOG_DBG("Writing 0x%08x to AICA_MASTER_VOLUME\n", (unsigned)val);
         break;
     case AICA_ARM7_RST:
         memcpy(&val, aica->sys_reg + (AICA_ARM7_RST/4), sizeof(val));
@@ -500,7 +518,7 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
         aica->int_pending_sh4 &= ~val;
         aica_update_interrupts(aica);
         if (val & (1<<5))
-            holly_clear_ext_int(HOLLY_EXT_INT_AICA);
+            aica_set_sh4_int_line(false);
         break;
     case AICA_SCIPD:
         /*
@@ -544,6 +562,7 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
         aica->ringbuffer_addr = (val & BIT_RANGE(0, 11)) << 11;
         aica->ringbuffer_size = (val & BIT_RANGE(13, 14)) >> 13;
         aica->ringbuffer_bit15 = (bool)(val & (1 << 15));
+        aica->dsp.dirty = true;
         LOG_DBG("Writing 0x%08x to AICA_RINGBUFFER_ADDRESS\n", (unsigned)val);
         break;
     case AICA_UNKNOWN_2880:
@@ -882,7 +901,15 @@ static void aica_sys_channel_write(struct aica *aica, void const *src,
         chan->pan = tmp & 0x1f;
         break;
     case AICA_CHAN_DSP_SEND:
+        memcpy(&tmp, chan->raw + AICA_CHAN_DSP_SEND, sizeof(tmp));
+        chan->dsp_send_sel = tmp & 0xf;
+        chan->dsp_send_level = (tmp >> 4) & 0xf;
+        break;
     case AICA_CHAN_LPF1_VOL:
+        // the filter isn't implemented, only the volume
+        memcpy(&tmp, chan->raw + AICA_CHAN_LPF1_VOL, sizeof(tmp));
+        chan->total_level = (tmp >> 8) & 0xff;
+        break;
     case AICA_CHAN_LPF2:
     case AICA_CHAN_LPF3:
     case AICA_CHAN_LPF4:
@@ -921,6 +948,7 @@ static void aica_dsp_mixer_write(struct aica *aica, void const *src,
                 len, (unsigned)addr);
     }
     memcpy(((uint8_t*)aica->sys_reg) + addr, src, len);
+    aica->dsp.dirty = true;
 }
 
 static void aica_dsp_reg_write(struct aica *aica, void const *src,
@@ -938,6 +966,8 @@ static void aica_dsp_reg_write(struct aica *aica, void const *src,
                 len, (unsigned)addr);
     }
     memcpy(((uint8_t*)aica->sys_reg) + addr, src, len);
+    if (addr_first <= AICA_DSP_PROG_LAST)
+        aica->dsp.dirty = true;
 }
 
 static uint32_t aica_sys_read_32(addr32_t addr, void *ctxt) {
@@ -1339,8 +1369,14 @@ static void aica_sync(struct aica *aica) {
         dc_cycle_stamp_t n_samples = AICA_FREQ_RATIO *
             (aica_get_sample_count(aica) - aica->last_sample_sync);
 
-        while (n_samples--)
-            aica_process_sample(aica);
+        bench_push(BENCH_CAT_AICA);
+        while (n_samples) {
+            unsigned block_len = n_samples < AICA_MIX_BLOCK_LEN ?
+                n_samples : AICA_MIX_BLOCK_LEN;
+            aica_mix_block(aica, block_len);
+            n_samples -= block_len;
+        }
+        bench_pop();
 
         aica->last_sample_sync = aica_get_sample_count(aica);
     }
@@ -1594,14 +1630,6 @@ static unsigned const decay_step_delta[][4] = {
     { 8, 8, 8, 8 }  // 0x3c
 };
 
-static inline int32_t add_sample32(int32_t s1, int32_t s2) {
-    if ((s2 > 0) && (s1 > INT32_MAX - s2))
-        return INT32_MAX;
-    if ((s2 < 0) && (s1 < INT32_MIN - s2))
-        return INT32_MIN;
-    return s1 + s2;
-}
-
 static aica_sample_pos get_sample_rate_multiplier(struct aica_chan const *chan) {
     // add 1.0 to the mantissa
     aica_sample_pos mantissa = (chan->fns ^ 0x400);
@@ -1640,31 +1668,51 @@ static aica_atten atten_scale(unsigned atten) {
     return scale;
 }
 
-static void aica_process_sample(struct aica *aica) {
-    unsigned chan_no;
-
-    int32_t sample_total = 0;
+/*
+ * equivalent to aica_wave_mem_read_16/aica_wave_mem_read_8, but these get
+ * inlined into the channel renderer.
+ */
+static inline int32_t aica_chan_read_16(struct aica *aica, addr32_t addr) {
+    if (addr >= AICA_WAVE_MEM_LEN - 1)
+        return (int16_t)aica_wave_mem_read_16(addr, &aica->mem);
+    int16_t ret;
+    memcpy(&ret, aica->mem.mem + addr, sizeof(ret));
+    return ret;
+}
 
-    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++) {
-        struct aica_chan *chan = aica->channels + chan_no;
+static inline int32_t aica_chan_read_8(struct aica *aica, addr32_t addr) {
+    if (addr >= AICA_WAVE_MEM_LEN)
+        return (int8_t)aica_wave_mem_read_8(addr, &aica->mem);
+    return (int8_t)aica->mem.mem[addr];
+}
 
-        if (!chan->playing)
-            continue;
+/*
+ * render up to n_samples samples from the given channel into out.  This
+ * returns the number of samples which were rendered, which will be less than
+ * n_samples if the channel stops playing partway through.
+ *
+ * The pitch and the envelope rate only change when the channel's registers are
+ * written to (which never happens in the middle of aica_sync) or when the
+ * envelope steps, so they are computed up front and only recomputed after a
+ * step.
+ */
+static unsigned
+aica_chan_render(struct aica *aica, unsigned chan_no,
+                 int32_t *out, unsigned n_samples) {
+    struct aica_chan *chan = aica->channels + chan_no;
 
-        aica_sample_pos sample_rate =
-            get_sample_rate_multiplier(chan) / AICA_FREQ_RATIO;
-        unsigned effective_rate = aica_chan_effective_rate(aica, chan_no);
-        unsigned samples_per_step = aica_samples_per_step(effective_rate,
-                                                          chan->step_no);
+    aica_sample_pos sample_rate =
+        get_sample_rate_multiplier(chan) / AICA_FREQ_RATIO;
+    unsigned effective_rate = aica_chan_effective_rate(aica, chan_no);
+    unsigned samples_per_step = aica_samples_per_step(effective_rate,
+                                                      chan->step_no);
 
+    unsigned idx;
+    for (idx = 0; idx < n_samples && chan->playing; idx++) {
         bool did_increment = false;
         if (chan->fmt == AICA_FMT_16_BIT_SIGNED) {
-            int32_t sample =
-                (int32_t)(int16_t)aica_wave_mem_read_16(chan->addr_cur,
-                                                        &aica->mem);
             // TODO: linear interpolation
-            if (!chan->is_muted)
-                sample_total = add_sample32(sample_total, sample);
+            out[idx] = aica_chan_read_16(aica, chan->addr_cur);
 
             chan->sample_partial += sample_rate;
             while (chan->sample_partial >= AICA_SAMPLE_POS_UNIT) {
@@ -1674,14 +1722,8 @@ static void aica_process_sample(struct aica *aica) {
                 did_increment = true;
             }
         } else if (chan->fmt == AICA_FMT_8_BIT_SIGNED) {
-            int32_t sample =
-                (int32_t)(int8_t)aica_wave_mem_read_8(chan->addr_cur,
-                                                      &aica->mem);
-            sample = sat_shift(sample, 8);
-
             // TODO: linear interpolation
-            if (!chan->is_muted)
-                sample_total = add_sample32(sample_total, sample);
+            out[idx] = sat_shift(aica_chan_read_8(aica, chan->addr_cur), 8);
 
             chan->sample_partial += sample_rate;
             while (chan->sample_partial >= AICA_SAMPLE_POS_UNIT) {
@@ -1703,10 +1745,7 @@ static void aica_process_sample(struct aica *aica) {
                 chan->adpcm_next_step = false;
             }
 
-            int32_t sample = chan->adpcm_sample;
-
-            if (!chan->is_muted)
-                sample_total = add_sample32(sample_total, sample);
+            out[idx] = chan->adpcm_sample;
 
             chan->sample_partial += sample_rate;
             if (chan->sample_partial >= AICA_SAMPLE_POS_UNIT) {
@@ -1782,15 +1821,213 @@ static void aica_process_sample(struct aica *aica) {
 
                 chan->sample_no = 0;
                 chan->step_no++;
+
+                effective_rate = aica_chan_effective_rate(aica, chan_no);
+                samples_per_step = aica_samples_per_step(effective_rate,
+                                                         chan->step_no);
             }
         }
     }
 
-    dc_submit_sound_samples(&sample_total, 1);
+    return idx;
+}
+
+/*
+ * multiply samples by gain_l and gain_r and add them into mix_l and mix_r.
+ */
+static void
+aica_mix_accumulate(float *mix_l, float *mix_r, int32_t const *samples,
+                    float gain_l, float gain_r, unsigned n_samples) {
+    unsigned idx = 0;
+
+#ifdef __SSE2__
+    __m128 const gain_l_vec = _mm_set1_ps(gain_l);
+    __m128 const gain_r_vec = _mm_set1_ps(gain_r);
+    for (; idx + 4 <= n_samples; idx += 4) {
+        __m128 in = _mm_cvtepi32_ps(
+            _mm_loadu_si128((__m128i const*)(samples + idx)));
+        _mm_storeu_ps(mix_l + idx,
+                      _mm_add_ps(_mm_loadu_ps(mix_l + idx),
+                                 _mm_mul_ps(in, gain_l_vec)));
+        _mm_storeu_ps(mix_r + idx,
+                      _mm_add_ps(_mm_loadu_ps(mix_r + idx),
+                                 _mm_mul_ps(in, gain_r_vec)));
+    }
+#endif
+
+    for (; idx < n_samples; idx++) {
+        float in = (float)samples[idx];
+        mix_l[idx] += in * gain_l;
+        mix_r[idx] += in * gain_r;
+    }
+}
+
+/*
+ * the largest float that can be converted to int32_t without overflowing.
+ * INT32_MAX itself rounds up to 2^31 when it is converted to float.
+ */
+#define AICA_MIX_MAX 2147483520.0f
+
+static inline int32_t aica_mix_clamp(float sample) {
+    if (sample > AICA_MIX_MAX)
+        return (int32_t)AICA_MIX_MAX;
+    if (sample < -AICA_MIX_MAX)
+        return -(int32_t)AICA_MIX_MAX;
+    return (int32_t)sample;
+}
+
+/*
+ * convert the left and right mixes into interleaved stereo frames.
+ */
+static void aica_mix_interleave(int32_t *out, float const *mix_l,
+                                float const *mix_r, unsigned n_samples) {
+    unsigned idx = 0;
+
+#ifdef __SSE2__
+    __m128 const max_vec = _mm_set1_ps(AICA_MIX_MAX);
+    __m128 const min_vec = _mm_set1_ps(-AICA_MIX_MAX);
+    for (; idx + 4 <= n_samples; idx += 4) {
+        __m128 lhs = _mm_loadu_ps(mix_l + idx);
+        __m128 rhs = _mm_loadu_ps(mix_r + idx);
+        lhs = _mm_max_ps(_mm_min_ps(lhs, max_vec), min_vec);
+        rhs = _mm_max_ps(_mm_min_ps(rhs, max_vec), min_vec);
+
+        // truncate the same way the scalar conversion does
+        __m128i lhs_int = _mm_cvttps_epi32(lhs);
+        __m128i rhs_int = _mm_cvttps_epi32(rhs);
+        _mm_storeu_si128((__m128i*)(out + 2 * idx),
+                         _mm_unpacklo_epi32(lhs_int, rhs_int));
+        _mm_storeu_si128((__m128i*)(out + 2 * idx + 4),
+                         _mm_unpackhi_epi32(lhs_int, rhs_int));
+    }
+#endif
+
+    for (; idx < n_samples; idx++) {
+        out[2 * idx] = aica_mix_clamp(mix_l[idx]);
+        out[2 * idx + 1] = aica_mix_clamp(mix_r[idx]);
+    }
+}
+
+// gain for the channel's TL, which applies to both the direct and DSP sends
+static float aica_chan_tl_gain(struct aica_chan const *chan) {
+    if (!chan->total_level)
+        return 1.0f;
+    // each step of TL is four steps of the envelope's attenuation
+    return (float)atten_scale(chan->total_level << 2) /
+        (float)AICA_ATTEN_UNIT;
+}
+
+/*
+ * add samples into the DSP input selected by the channel's DSPChannelSend
+ * register.  MIXS is 20 bits wide, so the 16-bit samples get shifted up by 4.
+ */
+static void aica_mix_dsp_send(struct aica *aica, struct aica_chan const *chan,
+                              int32_t const *samples, unsigned n_samples,
+                              float tl_gain) {
+    float gain, unused;
+    int32_t *dst = aica->dsp_in[chan->dsp_send_sel];
+    unsigned idx;
+
+    aica_output_gains(chan->dsp_send_level, 0, &gain, &unused);
+    gain *= 16.0f * tl_gain;
+
+    for (idx = 0; idx < n_samples; idx++)
+        dst[idx] += (int32_t)(samples[idx] * gain);
+}
+
+static void aica_mix_block(struct aica *aica, unsigned n_samples) {
+    float mix_l[AICA_MIX_BLOCK_LEN], mix_r[AICA_MIX_BLOCK_LEN];
+    int32_t chan_samples[AICA_MIX_BLOCK_LEN];
+    int32_t out[2 * AICA_MIX_BLOCK_LEN];
+    unsigned chan_no;
+
+    if (aica->silent) {
+        /*
+         * the DSP doesn't run either, so any effects it would have written
+         * into its ring buffer are lost.
+         */
+        for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++) {
+            if (aica->channels[chan_no].playing)
+                aica_chan_render(aica, chan_no, chan_samples, n_samples);
+        }
+        return;
+    }
+
+    if (aica->dsp.dirty) {
+        aica_dsp_compile(&aica->dsp, aica->sys_reg, aica->ringbuffer_addr,
+                         (8 * 1024) << aica->ringbuffer_size);
+    }
+    bool dsp_active = aica->dsp.prog_len > 0;
+
+    memset(mix_l, 0, n_samples * sizeof(mix_l[0]));
+    memset(mix_r, 0, n_samples * sizeof(mix_r[0]));
+    if (dsp_active)
+        memset(aica->dsp_in, 0, sizeof(aica->dsp_in));
+
+    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++) {
+        struct aica_chan *chan = aica->channels + chan_no;
+
+        if (!chan->playing)
+            continue;
+
+        unsigned n_rendered =
+            aica_chan_render(aica, chan_no, chan_samples, n_samples);
+
+        if (chan->is_muted)
+            continue;
+
+        float gain_l, gain_r;
+        float tl_gain = aica_chan_tl_gain(chan);
+        aica_output_gains(chan->volume, chan->pan, &gain_l, &gain_r);
+        gain_l *= tl_gain;
+        gain_r *= tl_gain;
+        if (gain_l != 0.0f || gain_r != 0.0f) {
+            aica_mix_accumulate(mix_l, mix_r, chan_samples,
+                                gain_l, gain_r, n_rendered);
+        }
+
+        if (dsp_active && chan->dsp_send_level)
+            aica_mix_dsp_send(aica, chan, chan_samples, n_rendered, tl_gain);
+    }
+
+    if (dsp_active) {
+        int32_t const *mixs_in[AICA_DSP_N_MIXS];
+        unsigned mixs_no;
+        for (mixs_no = 0; mixs_no < AICA_DSP_N_MIXS; mixs_no++)
+            mixs_in[mixs_no] = aica->dsp_in[mixs_no];
+        aica_dsp_run(&aica->dsp, &aica->mem, mixs_in, mix_l, mix_r, n_samples);
+    }
+
+    // MVOL is 3dB per step, just like the send levels
+    float master_gain, unused;
+    aica_output_gains(aica->master_volume, 0, &master_gain, &unused);
+    if (master_gain != 1.0f) {
+        unsigned idx;
+        for (idx = 0; idx < n_samples; idx++) {
+            mix_l[idx] *= master_gain;
+            mix_r[idx] *= master_gain;
+        }
+    }
+
+    aica_mix_interleave(out, mix_l, mix_r, n_samples);
+    dc_submit_sound_samples(out, n_samples);
+}
+
+/*
+ * when the AICA has a thread of its own, it isn't allowed to touch the SH4's
+ * interrupt controller, so the change gets handed over to the SH4's thread.
+ */
+static void aica_set_sh4_int_line(bool asserted) {
+    if (aica_thread_running())
+        aica_thread_post_sh4_int(asserted);
+    else if (asserted)
+        holly_raise_ext_int(HOLLY_EXT_INT_AICA);
+    else
+        holly_clear_ext_int(HOLLY_EXT_INT_AICA);
 }
 
 static void raise_aica_sh4_int(struct aica *aica) {
-    holly_raise_ext_int(HOLLY_EXT_INT_AICA);
+    aica_set_sh4_int_line(true);
     aica->int_pending_sh4 |= (1<<5);
     aica->aica_sh4_int_scheduled = false;
 }
@@ -2018,3 +2255,7 @@ void aica_get_sndchan_var(struct aica const *aica,
 void aica_mute_chan(struct aica *aica, unsigned chan_no, bool is_muted) {
     aica->channels[chan_no].is_muted = is_muted;
 }
+
+void aica_set_silent(struct aica *aica, bool silent) {
+    aica->silent = silent;
+}
@@ -27,10 +27,18 @@
 
 #include "dc_sched.h"
 #include "aica_wave_mem.h"
+#include "aica_dsp.h"
 #include "washdc/gameconsole.h"
 
 struct arm7;
 
+/*
+ * maximum number of samples mixed at once.  aica_sync renders each channel
+ * for an entire block before moving on to the next channel, and the mixed
+ * block gets submitted to the frontend in one call.
+ */
+#define AICA_MIX_BLOCK_LEN 512
+
 #define AICA_SYS_LEN 0x8000
 #define AICA_SYS_MASK (AICA_SYS_LEN - 1)
 
@@ -86,6 +94,15 @@ struct aica_chan {
     // from the DirectPanVolSend channel register (offset 0x24)
     unsigned volume, pan;
 
+    // from the DSPChannelSend channel register (offset 0x20)
+    unsigned dsp_send_sel, dsp_send_level;
+
+    /*
+     * TL from the LPF1Volume channel register (offset 0x28).  This is a
+     * fixed attenuation on top of the envelope, 0.375dB per step.
+     */
+    unsigned total_level;
+
     // the state of the amplitude envelope in the PlayStatus register
     enum aica_env_state atten_env_state;
 
@@ -172,6 +189,12 @@ struct aica {
     enum ringbuffer_size ringbuffer_size;
     bool ringbuffer_bit15;
 
+    /*
+     * MVOL from the MasterVolume register.  This has to be kept here because
+     * reads from that register always return 16.
+     */
+    unsigned master_volume;
+
     bool aica_sh4_int_scheduled;
     struct SchedEvent aica_sh4_raise_event;
 
@@ -206,8 +229,20 @@ struct aica {
 
     struct aica_chan channels[AICA_CHAN_COUNT];
 
+    struct aica_dsp dsp;
+
+    // samples sent to each of the DSP's MIXS inputs during the current block
+    int32_t dsp_in[AICA_DSP_N_MIXS][AICA_MIX_BLOCK_LEN];
+
     dc_cycle_stamp_t last_sample_sync;
 
+    /*
+     * when this is set the channels keep playing (so their positions, loop
+     * flags and envelopes advance like they normally would), but nothing gets
+     * mixed or sent to the host's sound device.
+     */
+    bool silent;
+
     // timerA, timerB, timerC
     struct aica_timer timers[3];
 
@@ -215,8 +250,13 @@ struct aica {
     struct dc_clock *sh4_clk;
 };
 
+/*
+ * native is the arena the DSP program gets compiled into, or NULL to
+ * interpret it.
+ */
 void aica_init(struct aica *aica, struct arm7 *arm7,
-               struct dc_clock *clk, struct dc_clock *sh4_clk);
+               struct dc_clock *clk, struct dc_clock *sh4_clk,
+               struct exec_mem *native);
 void aica_cleanup(struct aica *aica);
 
 extern struct memory_interface aica_sys_intf;
@@ -238,4 +278,7 @@ void aica_get_sndchan_var(struct aica const *aica,
  */
 void aica_mute_chan(struct aica *aica, unsigned chan_no, bool is_muted);
 
+// this is used by turbo mode to skip the cost of mixing audio
+void aica_set_silent(struct aica *aica, bool silent);
+
 #endif
@@ -0,0 +1,466 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "log.h"
+
+#include "aica_dsp.h"
+
+#ifdef ENABLE_JIT_X86_64
+#include "washdc/error.h"
+#include "jit/x86_64/exec_mem.h"
+#include "jit/x86_64/aica_dsp_x86_64.h"
+#endif
+
+// steps with any of these set have an effect beyond the accumulator
+#define AICA_DSP_SIDE_EFFECTS                                           \
+    (AICA_DSP_TWT | AICA_DSP_IWT | AICA_DSP_MWT | AICA_DSP_MRD |        \
+     AICA_DSP_EWT | AICA_DSP_ADRL | AICA_DSP_FRCL | AICA_DSP_YRL)
+
+/*
+ * gain for every 3dB of attenuation.  The last entry is for the "infinite
+ * attenuation" setting.
+ */
+static float const atten_3db[16] = {
+    1.000000000f, 0.707945784f, 0.501187234f, 0.354813389f,
+    0.251188643f, 0.177827941f, 0.125892541f, 0.089125094f,
+    0.063095734f, 0.044668359f, 0.031622777f, 0.022387211f,
+    0.015848932f, 0.011220185f, 0.007943282f, 0.0f
+};
+
+static inline int32_t sign_extend_24(int32_t val) {
+    return ((int32_t)((uint32_t)val << 8)) >> 8;
+}
+
+static inline int32_t sign_extend_13(int32_t val) {
+    return ((int32_t)((uint32_t)val << 19)) >> 19;
+}
+
+void aica_output_gains(unsigned level, unsigned pan,
+                       float *gain_l, float *gain_r) {
+    // level 0 is silent, level 15 is full volume
+    float gain = atten_3db[15 - (level & 0xf)];
+
+    // bit 4 of the pan selects which side gets attenuated
+    float pan_gain = atten_3db[pan & 0xf];
+    if (pan & 0x10) {
+        *gain_l = gain;
+        *gain_r = gain * pan_gain;
+    } else {
+        *gain_l = gain * pan_gain;
+        *gain_r = gain;
+    }
+}
+
+void aica_dsp_init(struct aica_dsp *dsp, struct exec_mem *native) {
+    memset(dsp, 0, sizeof(*dsp));
+    dsp->rb_len = 8 * 1024;
+    dsp->dirty = true;
+
+#ifdef ENABLE_JIT_X86_64
+    /*
+     * The buffer is big enough for the longest possible program, so it never
+     * has to move or grow.  That matters because the AICA can have its own
+     * thread, and the arena is only ever touched by the SH4's thread.
+     */
+    if (native) {
+        dsp->native = exec_mem_alloc(native, AICA_DSP_NATIVE_LEN);
+        if (!dsp->native)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        dsp->native_mem = native;
+    }
+#endif
+}
+
+void aica_dsp_cleanup(struct aica_dsp *dsp) {
+#ifdef ENABLE_JIT_X86_64
+    if (dsp->native)
+        exec_mem_free(dsp->native_mem, dsp->native);
+    dsp->native = NULL;
+    dsp->native_mem = NULL;
+#endif
+}
+
+/*
+ * returns true if the given step uses the accumulator left by the previous
+ * step, either as its B operand or through the shifter.
+ */
+static bool aica_dsp_step_uses_acc(struct aica_dsp_step const *step) {
+    if ((step->flags & AICA_DSP_BSEL) && !(step->flags & AICA_DSP_ZERO))
+        return true;
+    if (step->flags & (AICA_DSP_TWT | AICA_DSP_MWT |
+                       AICA_DSP_EWT | AICA_DSP_FRCL))
+        return true;
+    return (step->flags & AICA_DSP_ADRL) && step->shift == 3;
+}
+
+void aica_dsp_compile(struct aica_dsp *dsp, uint32_t const *sys_reg,
+                      uint32_t rb_base, uint32_t rb_len) {
+    struct aica_dsp_step decoded[AICA_DSP_N_STEPS];
+    bool live[AICA_DSP_N_STEPS];
+    unsigned step_no;
+
+    uint32_t const *mpro = sys_reg + AICA_DSP_MPRO / 4;
+    uint32_t const *coef = sys_reg + AICA_DSP_COEF / 4;
+    uint32_t const *madrs = sys_reg + AICA_DSP_MADRS / 4;
+
+    for (step_no = 0; step_no < AICA_DSP_N_STEPS; step_no++) {
+        /*
+         * each step is 64 bits, spread across the lower 16 bits of four
+         * 32-bit registers.
+         */
+        uint32_t inst0 = mpro[4 * step_no] & 0xffff;
+        uint32_t inst1 = mpro[4 * step_no + 1] & 0xffff;
+        uint32_t inst2 = mpro[4 * step_no + 2] & 0xffff;
+        uint32_t inst3 = mpro[4 * step_no + 3] & 0xffff;
+        struct aica_dsp_step *step = decoded + step_no;
+        uint32_t flags = 0;
+
+        step->tra = (inst0 >> 9) & 0x7f;
+        if (inst0 & (1 << 8))
+            flags |= AICA_DSP_TWT;
+        step->twa = (inst0 >> 1) & 0x7f;
+
+        if (inst1 & (1 << 15))
+            flags |= AICA_DSP_XSEL;
+        step->ysel = (inst1 >> 13) & 3;
+        step->ira = (inst1 >> 7) & 0x3f;
+        if (inst1 & (1 << 6))
+            flags |= AICA_DSP_IWT;
+        step->iwa = (inst1 >> 1) & 0x1f;
+
+        if (inst2 & (1 << 15))
+            flags |= AICA_DSP_TABLE;
+        if (inst2 & (1 << 14))
+            flags |= AICA_DSP_MWT;
+        if (inst2 & (1 << 13))
+            flags |= AICA_DSP_MRD;
+        if (inst2 & (1 << 12))
+            flags |= AICA_DSP_EWT;
+        step->ewa = (inst2 >> 8) & 0xf;
+        if (inst2 & (1 << 7))
+            flags |= AICA_DSP_ADRL;
+        if (inst2 & (1 << 6))
+            flags |= AICA_DSP_FRCL;
+        step->shift = (inst2 >> 4) & 3;
+        if (inst2 & (1 << 3))
+            flags |= AICA_DSP_YRL;
+        if (inst2 & (1 << 2))
+            flags |= AICA_DSP_NEGB;
+        if (inst2 & (1 << 1))
+            flags |= AICA_DSP_ZERO;
+        if (inst2 & 1)
+            flags |= AICA_DSP_BSEL;
+
+        if (inst3 & (1 << 15))
+            flags |= AICA_DSP_NOFL;
+        unsigned masa = (inst3 >> 2) & 0x1f;
+        if (inst3 & (1 << 1))
+            flags |= AICA_DSP_ADREB;
+        if (inst3 & 1)
+            flags |= AICA_DSP_NXADR;
+
+        // memory can only be accessed on odd steps
+        if (!(step_no & 1))
+            flags &= ~(AICA_DSP_MRD | AICA_DSP_MWT);
+
+        // each step has its own coefficient
+        step->coef = sign_extend_13((coef[step_no] & 0xffff) >> 3);
+        step->madrs = madrs[masa] & 0xffff;
+
+        step->flags = flags;
+    }
+
+    /*
+     * Work backwards to find the steps that matter.  A step is live if it
+     * has a side-effect, or if the next step is live and uses the
+     * accumulator that this step leaves behind.
+     */
+    for (step_no = AICA_DSP_N_STEPS; step_no-- > 0;) {
+        struct aica_dsp_step const *step = decoded + step_no;
+        live[step_no] = (step->flags & AICA_DSP_SIDE_EFFECTS) ||
+            (step_no + 1 < AICA_DSP_N_STEPS && live[step_no + 1] &&
+             aica_dsp_step_uses_acc(decoded + step_no + 1));
+    }
+
+    dsp->prog_len = 0;
+    for (step_no = 0; step_no < AICA_DSP_N_STEPS; step_no++)
+        if (live[step_no])
+            dsp->prog[dsp->prog_len++] = decoded[step_no];
+
+    /*
+     * The only steps that can use the accumulator are ones whose predecessor
+     * was also kept, so the next step in the compiled program is the same one
+     * that came next in the original.
+     */
+    for (step_no = 0; step_no + 1 < dsp->prog_len; step_no++)
+        if (aica_dsp_step_uses_acc(dsp->prog + step_no + 1))
+            dsp->prog[step_no].flags |= AICA_DSP_KEEP_ACC;
+
+    unsigned efreg_no;
+    for (efreg_no = 0; efreg_no < AICA_DSP_N_EFREG; efreg_no++) {
+        uint32_t val = sys_reg[AICA_DSP_MIXER_FIRST / 4 + efreg_no];
+        aica_output_gains((val >> 8) & 0xf, val & 0x1f,
+                          dsp->efreg_gain_l + efreg_no,
+                          dsp->efreg_gain_r + efreg_no);
+    }
+
+    dsp->rb_base = rb_base;
+    dsp->rb_len = rb_len;
+    dsp->dirty = false;
+
+#ifdef ENABLE_JIT_X86_64
+    if (dsp->native)
+        aica_dsp_native_compile(dsp);
+#endif
+
+    LOG_DBG("AICA: compiled DSP program to %u steps\n", dsp->prog_len);
+}
+
+uint16_t aica_dsp_pack(int32_t val) {
+    uint32_t uval = (uint32_t)val;
+    unsigned sign = (uval >> 23) & 1;
+    uint32_t tmp = (uval ^ (uval << 1)) & 0xffffff;
+    unsigned exponent = 0;
+
+    // count the redundant sign bits
+    while (exponent < 12 && !(tmp & 0x800000)) {
+        tmp <<= 1;
+        exponent++;
+    }
+
+    if (exponent < 12)
+        uval = (uval << exponent) & 0x3fffff;
+    else
+        uval <<= 11;
+    uval = (uval >> 11) & 0x7ff;
+
+    return uval | (sign << 15) | (exponent << 11);
+}
+
+int32_t aica_dsp_unpack(uint16_t val) {
+    unsigned sign = (val >> 15) & 1;
+    unsigned exponent = (val >> 11) & 0xf;
+    int32_t ret = (val & 0x7ff) << 11;
+
+    if (exponent > 11) {
+        exponent = 11;
+        ret |= sign << 22;
+    } else {
+        ret |= (sign ^ 1) << 22;
+    }
+    ret |= sign << 23;
+
+    return sign_extend_24(ret) >> exponent;
+}
+
+// EFREG is 16 bits, and the hardware saturates instead of wrapping
+static inline int32_t aica_dsp_sat16(int32_t val) {
+    if (val > 0x7fff)
+        return 0x7fff;
+    else if (val < -0x8000)
+        return -0x8000;
+    return val;
+}
+
+static void aica_dsp_interpret(struct aica_dsp *dsp,
+                               struct aica_wave_mem *mem) {
+    int32_t acc = 0, memval = 0, frc_reg = 0, y_reg = 0;
+    uint32_t adrs_reg = 0;
+    unsigned dec = dsp->dec;
+    unsigned idx;
+
+    for (idx = 0; idx < dsp->prog_len; idx++) {
+        struct aica_dsp_step const *step = dsp->prog + idx;
+        uint32_t flags = step->flags;
+        int32_t inputs, x, y, b, shifted;
+
+        if (step->ira < 0x20)
+            inputs = dsp->mems[step->ira];
+        else if (step->ira < 0x30)
+            inputs = dsp->mixs[step->ira - 0x20] * 16;
+        else
+            inputs = 0; // EXTS (CD audio) isn't implemented
+        inputs = sign_extend_24(inputs);
+
+        if (flags & AICA_DSP_IWT) {
+            dsp->mems[step->iwa] = memval;
+            if (step->ira == step->iwa)
+                inputs = memval;
+        }
+
+        int32_t temp = sign_extend_24(dsp->temp[(step->tra + dec) & 0x7f]);
+
+        if (flags & AICA_DSP_ZERO)
+            b = 0;
+        else
+            b = (flags & AICA_DSP_BSEL) ? acc : temp;
+        if (flags & AICA_DSP_NEGB)
+            b = -b;
+
+        x = (flags & AICA_DSP_XSEL) ? inputs : temp;
+
+        switch (step->ysel) {
+        case 0:
+            y = frc_reg;
+            break;
+        case 1:
+            y = step->coef;
+            break;
+        case 2:
+            y = (y_reg >> 11) & 0x1fff;
+            break;
+        default:
+            y = (y_reg >> 4) & 0x0fff;
+            break;
+        }
+        y = sign_extend_13(y);
+
+        if (flags & AICA_DSP_YRL)
+            y_reg = inputs;
+
+        switch (step->shift) {
+        case 0:
+            shifted = acc;
+            if (shifted > 0x7fffff)
+                shifted = 0x7fffff;
+            else if (shifted < -0x800000)
+                shifted = -0x800000;
+            break;
+        case 1:
+            shifted = acc * 2;
+            if (shifted > 0x7fffff)
+                shifted = 0x7fffff;
+            else if (shifted < -0x800000)
+                shifted = -0x800000;
+            break;
+        case 2:
+            shifted = sign_extend_24(acc * 2);
+            break;
+        default:
+            shifted = sign_extend_24(acc);
+            break;
+        }
+
+        if (flags & AICA_DSP_KEEP_ACC)
+            acc = (int32_t)(((int64_t)x * (int64_t)y) >> 12) + b;
+
+        if (flags & AICA_DSP_TWT)
+            dsp->temp[(step->twa + dec) & 0x7f] = shifted;
+
+        if (flags & AICA_DSP_FRCL) {
+            if (step->shift == 3)
+                frc_reg = shifted & 0x0fff;
+            else
+                frc_reg = (shifted >> 11) & 0x1fff;
+        }
+
+        if (flags & (AICA_DSP_MRD | AICA_DSP_MWT)) {
+            uint32_t addr = step->madrs;
+            if (!(flags & AICA_DSP_TABLE))
+                addr += dec;
+            if (flags & AICA_DSP_ADREB)
+                addr += adrs_reg & 0x0fff;
+            if (flags & AICA_DSP_NXADR)
+                addr++;
+            if (flags & AICA_DSP_TABLE)
+                addr &= 0xffff;
+            else
+                addr &= dsp->rb_len - 1;
+
+            uint32_t byte_addr = (dsp->rb_base + addr * 2) & AICA_WAVE_MEM_MASK;
+            uint16_t word;
+
+            if (flags & AICA_DSP_MRD) {
+                memcpy(&word, mem->mem + byte_addr, sizeof(word));
+                if (flags & AICA_DSP_NOFL)
+                    memval = sign_extend_24((uint32_t)word << 8);
+                else
+                    memval = aica_dsp_unpack(word);
+            }
+
+            if (flags & AICA_DSP_MWT) {
+                if (flags & AICA_DSP_NOFL)
+                    word = shifted >> 8;
+                else
+                    word = aica_dsp_pack(shifted);
+                memcpy(mem->mem + byte_addr, &word, sizeof(word));
+                aica_wave_mem_note_write(mem, byte_addr, sizeof(word));
+            }
+        }
+
+        if (flags & AICA_DSP_ADRL) {
+            if (step->shift == 3)
+                adrs_reg = (shifted >> 12) & 0xfff;
+            else
+                adrs_reg = inputs >> 16;
+        }
+
+        if (flags & AICA_DSP_EWT) {
+            dsp->efreg[step->ewa] =
+                aica_dsp_sat16(dsp->efreg[step->ewa] + (shifted >> 8));
+        }
+    }
+}
+
+static void aica_dsp_exec(struct aica_dsp *dsp, struct aica_wave_mem *mem) {
+    memset(dsp->efreg, 0, sizeof(dsp->efreg));
+
+#ifdef ENABLE_JIT_X86_64
+    if (dsp->native)
+        ((aica_dsp_native_fn)dsp->native)(dsp, mem);
+    else
+#endif
+        aica_dsp_interpret(dsp, mem);
+
+    dsp->dec--;
+}
+
+void aica_dsp_run(struct aica_dsp *dsp, struct aica_wave_mem *mem,
+                  int32_t const *const mixs_in[AICA_DSP_N_MIXS],
+                  float *out_l, float *out_r, unsigned n_samples) {
+    unsigned sample_no, reg_no;
+
+    for (sample_no = 0; sample_no < n_samples; sample_no++) {
+        for (reg_no = 0; reg_no < AICA_DSP_N_MIXS; reg_no++) {
+            // MIXS is 20 bits
+            int32_t val = mixs_in[reg_no][sample_no];
+            if (val > 0x7ffff)
+                val = 0x7ffff;
+            else if (val < -0x80000)
+                val = -0x80000;
+            dsp->mixs[reg_no] = val;
+        }
+
+        aica_dsp_exec(dsp, mem);
+
+        float sample_l = 0.0f, sample_r = 0.0f;
+        for (reg_no = 0; reg_no < AICA_DSP_N_EFREG; reg_no++) {
+            float efreg = (float)aica_dsp_sat16(dsp->efreg[reg_no]);
+            sample_l += efreg * dsp->efreg_gain_l[reg_no];
+            sample_r += efreg * dsp->efreg_gain_r[reg_no];
+        }
+        out_l[sample_no] += sample_l;
+        out_r[sample_no] += sample_r;
+    }
+}
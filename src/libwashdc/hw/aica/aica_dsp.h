@@ -0,0 +1,169 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef AICA_DSP_H_
+#define AICA_DSP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aica_wave_mem.h"
+
+struct exec_mem;
+
+/*
+ * AICA effects DSP.
+ *
+ * The DSP runs a microprogram of up to 128 steps once for every output
+ * sample.  Its inputs are the MIXS registers (which the channels send
+ * samples to) and its outputs are the EFREG registers, which get panned and
+ * mixed into the final output.
+ *
+ * Interpreting the microprogram straight out of the register file is far too
+ * slow, so it is compiled into an array of pre-decoded steps whenever the
+ * program, its coefficients or its memory addresses change.  The compiler
+ * bakes the COEF and MADRS values into the steps, drops memory accesses on
+ * even steps (which the hardware doesn't perform) and removes every step
+ * whose results are never used, which includes the NOP padding that most
+ * programs have after their last real instruction.
+ *
+ * When the native JIT is enabled, the compiled steps are then translated to
+ * x86_64 code (see jit/x86_64/aica_dsp_x86_64.c).
+ */
+
+#define AICA_DSP_MIXER_FIRST 0x2000
+#define AICA_DSP_MIXER_LAST 0x2047
+
+#define AICA_DSP_COEF 0x3000
+#define AICA_DSP_MADRS 0x3200
+#define AICA_DSP_MPRO 0x3400
+#define AICA_DSP_PROG_LAST 0x3bff
+
+#define AICA_DSP_N_STEPS 128
+#define AICA_DSP_N_TEMP 128
+#define AICA_DSP_N_MEMS 32
+#define AICA_DSP_N_MIXS 16
+#define AICA_DSP_N_EFREG 16
+
+// flags for struct aica_dsp_step
+#define AICA_DSP_TWT   (1 << 0)
+#define AICA_DSP_XSEL  (1 << 1)
+#define AICA_DSP_IWT   (1 << 2)
+#define AICA_DSP_TABLE (1 << 3)
+#define AICA_DSP_MWT   (1 << 4)
+#define AICA_DSP_MRD   (1 << 5)
+#define AICA_DSP_EWT   (1 << 6)
+#define AICA_DSP_ADRL  (1 << 7)
+#define AICA_DSP_FRCL  (1 << 8)
+#define AICA_DSP_YRL   (1 << 9)
+#define AICA_DSP_NEGB  (1 << 10)
+#define AICA_DSP_ZERO  (1 << 11)
+#define AICA_DSP_BSEL  (1 << 12)
+#define AICA_DSP_NOFL  (1 << 13)
+#define AICA_DSP_ADREB (1 << 14)
+#define AICA_DSP_NXADR (1 << 15)
+
+/*
+ * set by the compiler when the next step uses the accumulator.  Steps without
+ * it don't bother with the multiply-accumulate.
+ */
+#define AICA_DSP_KEEP_ACC (1 << 16)
+
+struct aica_dsp_step {
+    uint32_t flags;
+    int32_t coef;
+    uint32_t madrs;
+    uint8_t tra, twa, ira, iwa, ewa, ysel, shift;
+};
+
+struct aica_dsp {
+    struct aica_dsp_step prog[AICA_DSP_N_STEPS];
+    unsigned prog_len;
+
+    // if this is set then the program needs to be recompiled before it runs
+    bool dirty;
+
+    // output gains for each EFREG
+    float efreg_gain_l[AICA_DSP_N_EFREG], efreg_gain_r[AICA_DSP_N_EFREG];
+
+    int32_t temp[AICA_DSP_N_TEMP];
+    int32_t mems[AICA_DSP_N_MEMS];
+    int32_t mixs[AICA_DSP_N_MIXS];
+    int32_t efreg[AICA_DSP_N_EFREG];
+
+    // decremented after every sample
+    unsigned dec;
+
+    // ringbuffer in wave memory; base is in bytes and len is in 16-bit words
+    uint32_t rb_base, rb_len;
+
+#ifdef ENABLE_JIT_X86_64
+    /*
+     * if this is non-NULL, the program also gets compiled to native code
+     * here, and that's what runs instead of the interpreter.
+     */
+    void *native;
+
+    // arena that native was allocated from
+    struct exec_mem *native_mem;
+#endif
+};
+
+/*
+ * if native is non-NULL (and the x86_64 JIT is built in), the DSP program gets
+ * compiled to native code which is allocated from that arena.  Otherwise the
+ * program is interpreted.
+ */
+void aica_dsp_init(struct aica_dsp *dsp, struct exec_mem *native);
+void aica_dsp_cleanup(struct aica_dsp *dsp);
+
+/*
+ * compile the DSP program.  sys_reg is the AICA's register file, and
+ * rb_base/rb_len are the location and length of the ringbuffer (in bytes and
+ * 16-bit words, respectively).
+ */
+void aica_dsp_compile(struct aica_dsp *dsp, uint32_t const *sys_reg,
+                      uint32_t rb_base, uint32_t rb_len);
+
+/*
+ * run the DSP for n_samples samples.  mixs_in holds the sends from the
+ * channels for each MIXS register (as 20-bit values), and the DSP's output
+ * is added to out_l and out_r.
+ */
+void aica_dsp_run(struct aica_dsp *dsp, struct aica_wave_mem *mem,
+                  int32_t const *const mixs_in[AICA_DSP_N_MIXS],
+                  float *out_l, float *out_r, unsigned n_samples);
+
+// convert a 24-bit value to the DSP's 16-bit floating-point format
+uint16_t aica_dsp_pack(int32_t val);
+
+// convert the DSP's 16-bit floating-point format to a 24-bit value
+int32_t aica_dsp_unpack(uint16_t val);
+
+/*
+ * get the left and right gains for a send level (DISDL/EFSDL) and a pan
+ * setting (DIPAN/EFPAN).  Each step of the level or pan is 3dB.
+ */
+void aica_output_gains(unsigned level, unsigned pan,
+                       float *gain_l, float *gain_r);
+
+#endif
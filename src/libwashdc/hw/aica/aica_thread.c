@@ -0,0 +1,453 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <string.h>
+
+#include "log.h"
+#include "threading.h"
+#include "atomics.h"
+#include "washdc/error.h"
+#include "hw/aica/aica.h"
+#include "hw/sys/holly_intc.h"
+
+#include "aica_thread.h"
+
+/*
+ * MCIEB, MCIPD and MCIRE.  Writes to these can change the SH4's interrupt
+ * line, so they wait for the AICA thread instead of getting posted.
+ */
+#define AICA_SH4_INT_REG_FIRST 0x28b4
+#define AICA_SH4_INT_REG_LAST 0x28bf
+
+enum aica_thread_req_tp {
+    AICA_THREAD_REQ_READ,
+    AICA_THREAD_REQ_WRITE,
+
+    // same as AICA_THREAD_REQ_WRITE, but the SH4 waits for it to finish
+    AICA_THREAD_REQ_WRITE_WAIT,
+
+    AICA_THREAD_REQ_SET_SILENT,
+
+    // from the UI
+    AICA_THREAD_REQ_GET_CHAN,
+    AICA_THREAD_REQ_GET_CHAN_VAR,
+    AICA_THREAD_REQ_MUTE_CHAN
+};
+
+struct aica_thread_req_ring aica_thread_reqs;
+
+/*
+ * The AICA's interrupt line to the SH4.  Holly's external interrupts are
+ * level-triggered, so the SH4 only needs the line's latest level and the AICA
+ * thread never has to wait for it to catch up.  Bit 0 is the level, and the
+ * rest is a count that the AICA thread bumps every time it changes the level.
+ * sh4_int_line_seen is the last value the SH4's thread applied.
+ */
+static washdc_atomic_int sh4_int_line;
+static int sh4_int_line_seen;
+
+static struct aica *aica;
+static struct dc_clock *arm7_clk;
+
+static bool running;
+static bool silent;
+
+static washdc_thread thread;
+
+/*
+ * everything below here is protected by lock.  The SH4's thread waits on
+ * sh4_cond and the AICA thread waits on aica_cond.
+ */
+static washdc_mutex lock;
+static washdc_cvar sh4_cond, aica_cond;
+
+static bool quit;
+static unsigned sh4_slices, aica_slices;
+
+// these are for requests that the SH4 waits on
+static bool req_done;
+static uint32_t read_val;
+
+static void aica_thread_main(void *argp);
+static void aica_thread_post(struct aica_thread_req const *req);
+static uint32_t aica_thread_read(addr32_t addr, unsigned len);
+static void aica_thread_write(addr32_t addr, uint32_t val, unsigned len);
+static void drain_sh4_ints(void);
+
+void aica_thread_start(struct aica *aica_in, struct dc_clock *arm7_clk_in) {
+    aica = aica_in;
+    arm7_clk = arm7_clk_in;
+
+    aica_thread_req_ring_init(&aica_thread_reqs);
+    washdc_atomic_int_init(&sh4_int_line, 0);
+    sh4_int_line_seen = 0;
+
+    quit = false;
+    sh4_slices = 0;
+    aica_slices = 0;
+    silent = false;
+
+    washdc_mutex_init(&lock);
+    washdc_cvar_init(&sh4_cond);
+    washdc_cvar_init(&aica_cond);
+
+    running = true;
+    washdc_thread_create(&thread, aica_thread_main, NULL);
+
+    LOG_INFO("ARM7 and AICA are running on their own thread\n");
+}
+
+void aica_thread_stop(void) {
+    if (!running)
+        return;
+
+    washdc_mutex_lock(&lock);
+    quit = true;
+    washdc_cvar_signal(&aica_cond);
+    washdc_mutex_unlock(&lock);
+
+    washdc_thread_join(&thread);
+
+    // apply whatever's left over from the AICA's last timeslice
+    drain_sh4_ints();
+
+    running = false;
+
+    washdc_cvar_cleanup(&aica_cond);
+    washdc_cvar_cleanup(&sh4_cond);
+    washdc_mutex_cleanup(&lock);
+}
+
+bool aica_thread_running(void) {
+    return running;
+}
+
+// apply interrupt changes from the AICA.  SH4 thread only.
+static void drain_sh4_ints(void) {
+    int line = washdc_atomic_int_load(&sh4_int_line);
+    if (line == sh4_int_line_seen)
+        return;
+    sh4_int_line_seen = line;
+
+    if (line & 1)
+        holly_raise_ext_int(HOLLY_EXT_INT_AICA);
+    else
+        holly_clear_ext_int(HOLLY_EXT_INT_AICA);
+}
+
+void aica_thread_sync(void) {
+    washdc_mutex_lock(&lock);
+
+    sh4_slices++;
+    washdc_cvar_signal(&aica_cond);
+
+    for (;;) {
+        drain_sh4_ints();
+        if (aica_slices + AICA_THREAD_MAX_SKEW > sh4_slices)
+            break;
+        washdc_cvar_wait(&sh4_cond, &lock);
+    }
+
+    washdc_mutex_unlock(&lock);
+}
+
+void aica_thread_set_silent(bool silent_new) {
+    if (silent_new != silent) {
+        struct aica_thread_req req = {
+            .tp = AICA_THREAD_REQ_SET_SILENT,
+            .val = silent_new
+        };
+        aica_thread_post(&req);
+        silent = silent_new;
+    }
+}
+
+// SH4 thread only
+static void aica_thread_post(struct aica_thread_req const *req) {
+    if (aica_thread_req_ring_full(&aica_thread_reqs)) {
+        washdc_mutex_lock(&lock);
+        washdc_cvar_signal(&aica_cond);
+        while (aica_thread_req_ring_full(&aica_thread_reqs)) {
+            drain_sh4_ints();
+            washdc_cvar_wait(&sh4_cond, &lock);
+        }
+        washdc_mutex_unlock(&lock);
+    }
+
+    aica_thread_req_ring_produce(&aica_thread_reqs, *req);
+}
+
+/*
+ * post a request and then wait for the AICA thread to get through the queue.
+ * Any interrupt changes that come out of it get applied before this returns.
+ */
+static void aica_thread_post_and_wait(struct aica_thread_req const *req) {
+    washdc_mutex_lock(&lock);
+    req_done = false;
+    washdc_mutex_unlock(&lock);
+
+    aica_thread_post(req);
+
+    washdc_mutex_lock(&lock);
+    washdc_cvar_signal(&aica_cond);
+    while (!req_done) {
+        drain_sh4_ints();
+        washdc_cvar_wait(&sh4_cond, &lock);
+    }
+    drain_sh4_ints();
+    washdc_mutex_unlock(&lock);
+}
+
+static uint32_t aica_thread_read(addr32_t addr, unsigned len) {
+    struct aica_thread_req req = {
+        .tp = AICA_THREAD_REQ_READ,
+        .len = len,
+        .addr = addr
+    };
+    aica_thread_post_and_wait(&req);
+    return read_val;
+}
+
+static void aica_thread_write(addr32_t addr, uint32_t val, unsigned len) {
+    struct aica_thread_req req = {
+        .tp = AICA_THREAD_REQ_WRITE,
+        .len = len,
+        .addr = addr,
+        .val = val
+    };
+
+    unsigned reg = addr & AICA_SYS_MASK;
+    if (reg + len > AICA_SH4_INT_REG_FIRST && reg <= AICA_SH4_INT_REG_LAST) {
+        req.tp = AICA_THREAD_REQ_WRITE_WAIT;
+        aica_thread_post_and_wait(&req);
+    } else {
+        aica_thread_post(&req);
+    }
+}
+
+void aica_thread_get_sndchan_stat(unsigned ch_no,
+                                  struct washdc_sndchan_stat *stat) {
+    struct aica_thread_req req = {
+        .tp = AICA_THREAD_REQ_GET_CHAN,
+        .val = ch_no,
+        .out = stat
+    };
+    aica_thread_post_and_wait(&req);
+}
+
+void aica_thread_get_sndchan_var(struct washdc_sndchan_stat const *stat,
+                                 unsigned var_no, struct washdc_var *var) {
+    struct aica_thread_req req = {
+        .tp = AICA_THREAD_REQ_GET_CHAN_VAR,
+        .val = var_no,
+        .arg = stat,
+        .out = var
+    };
+    aica_thread_post_and_wait(&req);
+}
+
+void aica_thread_mute_chan(unsigned chan_no, bool is_muted) {
+    struct aica_thread_req req = {
+        .tp = AICA_THREAD_REQ_MUTE_CHAN,
+        .addr = chan_no,
+        .val = is_muted
+    };
+    aica_thread_post(&req);
+}
+
+static uint32_t do_read(struct aica_thread_req const *req) {
+    switch (req->len) {
+    case 1:
+        return aica_sys_intf.read8(req->addr, aica);
+    case 2:
+        return aica_sys_intf.read16(req->addr, aica);
+    default:
+        return aica_sys_intf.read32(req->addr, aica);
+    }
+}
+
+static void do_write(struct aica_thread_req const *req) {
+    switch (req->len) {
+    case 1:
+        aica_sys_intf.write8(req->addr, req->val, aica);
+        break;
+    case 2:
+        aica_sys_intf.write16(req->addr, req->val, aica);
+        break;
+    default:
+        aica_sys_intf.write32(req->addr, req->val, aica);
+    }
+}
+
+static void finish_req(uint32_t val) {
+    washdc_mutex_lock(&lock);
+    read_val = val;
+    req_done = true;
+    washdc_mutex_unlock(&lock);
+}
+
+// AICA thread only
+void aica_thread_do_poll(void) {
+    struct aica_thread_req req;
+
+    while (aica_thread_req_ring_consume(&aica_thread_reqs, &req)) {
+        switch (req.tp) {
+        case AICA_THREAD_REQ_READ:
+            finish_req(do_read(&req));
+            break;
+        case AICA_THREAD_REQ_WRITE:
+            do_write(&req);
+            break;
+        case AICA_THREAD_REQ_WRITE_WAIT:
+            do_write(&req);
+            finish_req(0);
+            break;
+        case AICA_THREAD_REQ_SET_SILENT:
+            aica_set_silent(aica, req.val);
+            break;
+        case AICA_THREAD_REQ_GET_CHAN:
+            aica_get_sndchan_stat(aica, req.val,
+                                  (struct washdc_sndchan_stat*)req.out);
+            finish_req(0);
+            break;
+        case AICA_THREAD_REQ_GET_CHAN_VAR:
+            aica_get_sndchan_var(aica,
+                                 (struct washdc_sndchan_stat const*)req.arg,
+                                 req.val, (struct washdc_var*)req.out);
+            finish_req(0);
+            break;
+        case AICA_THREAD_REQ_MUTE_CHAN:
+            aica_mute_chan(aica, req.addr, req.val);
+            break;
+        default:
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+    }
+
+    // the SH4 could be waiting for an answer or for room in the ring
+    washdc_mutex_lock(&lock);
+    washdc_cvar_signal(&sh4_cond);
+    washdc_mutex_unlock(&lock);
+}
+
+// AICA thread only
+void aica_thread_post_sh4_int(bool asserted) {
+    // this is the only thread that writes to sh4_int_line
+    unsigned line = washdc_atomic_int_load(&sh4_int_line);
+    if ((line & 1) == asserted)
+        return;
+    line = ((line & ~1u) + 2) | asserted;
+    washdc_atomic_int_store(&sh4_int_line, (int)line);
+}
+
+static void aica_thread_main(void *argp) {
+    for (;;) {
+        washdc_mutex_lock(&lock);
+        while (!quit && aica_slices >= sh4_slices + AICA_THREAD_MAX_SKEW) {
+            if (aica_thread_req_ring_empty(&aica_thread_reqs)) {
+                washdc_cvar_wait(&aica_cond, &lock);
+            } else {
+                washdc_mutex_unlock(&lock);
+                aica_thread_do_poll();
+                washdc_mutex_lock(&lock);
+            }
+        }
+        if (quit) {
+            washdc_mutex_unlock(&lock);
+            break;
+        }
+        washdc_mutex_unlock(&lock);
+
+        aica_thread_poll();
+        dc_clock_run_timeslice(arm7_clk);
+
+        washdc_mutex_lock(&lock);
+        aica_slices++;
+        washdc_cvar_signal(&sh4_cond);
+        washdc_mutex_unlock(&lock);
+    }
+}
+
+static uint32_t aica_thread_sys_read_32(addr32_t addr, void *ctxt) {
+    return aica_thread_read(addr, 4);
+}
+
+static uint16_t aica_thread_sys_read_16(addr32_t addr, void *ctxt) {
+    return aica_thread_read(addr, 2);
+}
+
+static uint8_t aica_thread_sys_read_8(addr32_t addr, void *ctxt) {
+    return aica_thread_read(addr, 1);
+}
+
+static float aica_thread_sys_read_float(addr32_t addr, void *ctxt) {
+    uint32_t val = aica_thread_read(addr, 4);
+    float ret;
+    memcpy(&ret, &val, sizeof(ret));
+    return ret;
+}
+
+static double aica_thread_sys_read_double(addr32_t addr, void *ctxt) {
+    error_set_length(8);
+    error_set_address(addr);
+    RAISE_ERROR(ERROR_UNIMPLEMENTED);
+}
+
+static void aica_thread_sys_write_32(addr32_t addr, uint32_t val, void *ctxt) {
+    aica_thread_write(addr, val, 4);
+}
+
+static void aica_thread_sys_write_16(addr32_t addr, uint16_t val, void *ctxt) {
+    aica_thread_write(addr, val, 2);
+}
+
+static void aica_thread_sys_write_8(addr32_t addr, uint8_t val, void *ctxt) {
+    aica_thread_write(addr, val, 1);
+}
+
+static void aica_thread_sys_write_float(addr32_t addr, float val, void *ctxt) {
+    uint32_t tmp;
+    memcpy(&tmp, &val, sizeof(tmp));
+    aica_thread_write(addr, tmp, 4);
+}
+
+static void
+aica_thread_sys_write_double(addr32_t addr, double val, void *ctxt) {
+    error_set_length(8);
+    error_set_address(addr);
+    RAISE_ERROR(ERROR_UNIMPLEMENTED);
+}
+
+struct memory_interface aica_thread_sys_intf = {
+    .read32 = aica_thread_sys_read_32,
+    .read16 = aica_thread_sys_read_16,
+    .read8 = aica_thread_sys_read_8,
+    .readfloat = aica_thread_sys_read_float,
+    .readdouble = aica_thread_sys_read_double,
+
+    .write32 = aica_thread_sys_write_32,
+    .write16 = aica_thread_sys_write_16,
+    .write8 = aica_thread_sys_write_8,
+    .writefloat = aica_thread_sys_write_float,
+    .writedouble = aica_thread_sys_write_double
+};
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef AICA_THREAD_H_
+#define AICA_THREAD_H_
+
+/*
+ * Optional mode (exec.aica-thread in the config file) where the ARM7 and the
+ * AICA run on a host thread of their own instead of taking turns with the SH4.
+ *
+ * Both threads still run in DC_TIMESLICE steps, and at the end of every step
+ * each side checks how far ahead of the other one it is.  Neither side is
+ * allowed to get more than AICA_THREAD_MAX_SKEW timeslices ahead.
+ *
+ * Everything the SH4 does to the AICA's registers goes through a lock-free
+ * queue to the AICA thread.  Writes don't wait for the AICA thread, but reads
+ * (and writes to the registers which control the SH4's AICA interrupt) block
+ * until the AICA thread has caught up with the queue.  Going the other way,
+ * the AICA thread publishes the latest level of the SH4's AICA interrupt line
+ * through an atomic variable, and the SH4's thread applies it.  Wave memory
+ * is shared between the two threads like it is on real hardware, so it
+ * doesn't go through the queue.
+ *
+ * This mode isn't deterministic, so it can't be used with the debugger.
+ */
+
+#include <stdbool.h>
+
+#include "dc_sched.h"
+#include "washdc/types.h"
+#include "washdc/MemoryMap.h"
+#include "washdc/ring.h"
+
+#define AICA_THREAD_MAX_SKEW 1
+
+struct aica;
+
+// SH4-side interface to the AICA's registers
+extern struct memory_interface aica_thread_sys_intf;
+
+void aica_thread_start(struct aica *aica, struct dc_clock *arm7_clk);
+void aica_thread_stop(void);
+
+/*
+ * this is true between aica_thread_start and aica_thread_stop.  It can be
+ * called from either thread.
+ */
+bool aica_thread_running(void);
+
+/*
+ * SH4 thread only: call this at the end of every SH4 timeslice.  This is where
+ * the SH4 picks up interrupt changes from the AICA, and it blocks if the
+ * SH4 is too far ahead of the AICA.
+ */
+void aica_thread_sync(void);
+
+// SH4 thread only
+void aica_thread_set_silent(bool silent);
+
+/*
+ * SH4 thread only: these are for the UI, which runs on the SH4's thread.  They
+ * go through the queue so that the AICA thread is the only one that touches
+ * channel state.  The first two wait for the AICA thread to answer.
+ */
+struct washdc_sndchan_stat;
+struct washdc_var;
+void aica_thread_get_sndchan_stat(unsigned ch_no,
+                                  struct washdc_sndchan_stat *stat);
+void aica_thread_get_sndchan_var(struct washdc_sndchan_stat const *stat,
+                                 unsigned var_no, struct washdc_var *var);
+void aica_thread_mute_chan(unsigned chan_no, bool is_muted);
+
+// a register access (or some other request) from the SH4's thread
+struct aica_thread_req {
+    unsigned tp;
+    unsigned len;
+    addr32_t addr;
+    uint32_t val;
+
+    // for requests that need more than a register address and value
+    void const *arg;
+    void *out;
+};
+
+DEF_RING(aica_thread_req_ring, struct aica_thread_req, 10)
+
+extern struct aica_thread_req_ring aica_thread_reqs;
+
+/*
+ * AICA thread only: the ARM7 calls aica_thread_poll between instructions so
+ * that requests from the SH4 don't have to wait for the end of the timeslice.
+ */
+void aica_thread_do_poll(void);
+
+static inline void aica_thread_poll(void) {
+    if (!aica_thread_req_ring_empty(&aica_thread_reqs))
+        aica_thread_do_poll();
+}
+
+// AICA thread only
+void aica_thread_post_sh4_int(bool asserted);
+
+#endif
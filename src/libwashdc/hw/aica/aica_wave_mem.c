@@ -42,6 +42,9 @@ void aica_log_verbose(bool verbose) {
 
 void aica_wave_mem_init(struct aica_wave_mem *wm) {
     memset(wm->mem, 0, sizeof(wm->mem));
+#ifdef ENABLE_DEBUGGER
+    memset(wm->written_pages, 1, sizeof(wm->written_pages));
+#endif
 }
 
 void aica_wave_mem_cleanup(struct aica_wave_mem *wm) {
@@ -118,6 +121,7 @@ void aica_wave_mem_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     }
 
     *outp = val;
+    aica_wave_mem_note_write(wm, addr, sizeof(val));
 }
 
 uint16_t aica_wave_mem_read_16(addr32_t addr, void *ctxt) {
@@ -165,6 +169,7 @@ void aica_wave_mem_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     }
 
     memcpy(wm->mem + addr, &val, sizeof(val));
+    aica_wave_mem_note_write(wm, addr, sizeof(val));
 }
 
 void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt) {
@@ -187,6 +192,7 @@ void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     }
 
     memcpy(wm->mem + addr, &val, sizeof(val));
+    aica_wave_mem_note_write(wm, addr, sizeof(val));
 }
 
 struct memory_interface aica_wave_mem_intf = {
@@ -41,10 +41,26 @@ static_assert(!(AICA_WAVE_MEM_LEN & (AICA_WAVE_MEM_LEN - 1)),
 
 #define AICA_WAVE_MEM_MASK (AICA_WAVE_MEM_LEN - 1)
 
+#define AICA_WAVE_MEM_PAGE_SHIFT 12
+#define AICA_WAVE_MEM_N_PAGES (AICA_WAVE_MEM_LEN >> AICA_WAVE_MEM_PAGE_SHIFT)
+
 struct aica_wave_mem {
     uint8_t mem[AICA_WAVE_MEM_LEN];
+
+#ifdef ENABLE_DEBUGGER
+    // one byte per page, set on every write (see written_pages in memory.h)
+    uint8_t written_pages[AICA_WAVE_MEM_N_PAGES];
+#endif
 };
 
+static inline void
+aica_wave_mem_note_write(struct aica_wave_mem *wm, addr32_t addr, unsigned len) {
+#ifdef ENABLE_DEBUGGER
+    wm->written_pages[addr >> AICA_WAVE_MEM_PAGE_SHIFT] = 1;
+    wm->written_pages[(addr + (len - 1)) >> AICA_WAVE_MEM_PAGE_SHIFT] = 1;
+#endif
+}
+
 float aica_wave_mem_read_float(addr32_t addr, void *ctxt);
 void aica_wave_mem_write_float(addr32_t addr, float val, void *ctxt);
 double aica_wave_mem_read_double(addr32_t addr, void *ctxt);
@@ -35,6 +35,7 @@
 #include "dc_sched.h"
 #include "dreamcast.h"
 #include "intmath.h"
+#include "trace.h"
 
 #include "g2_reg.h"
 
@@ -343,13 +344,15 @@ g2_dma_ad_xfer(uint32_t src_addr, uint32_t dst_addr, unsigned n_bytes) {
     unsigned n_words = n_bytes / 4;
     LOG_DBG("AICA: Request to transfer 0x%08x bytes from 0x%08x to 0x%08x\n",
             n_bytes, (unsigned)src_addr, (unsigned)dst_addr);
+    TRACE_DMA(TRACE_DMA_AICA, src_addr, dst_addr, n_bytes);
 
     sh4_dmac_transfer_words(dreamcast_get_cpu(), src_addr, dst_addr, n_words);
 
+    struct dc_clock *sh4_clock = dreamcast_get_sh4_clock();
     aica_dma_raise_event.handler = post_delay_aica_dma_int;
     aica_dma_raise_event.when =
-        clock_cycle_stamp(&sh4_clock) + AICA_DMA_COMPLETE_INT_DELAY(n_bytes);
-    sched_event(&sh4_clock, &aica_dma_raise_event);
+        clock_cycle_stamp(sh4_clock) + AICA_DMA_COMPLETE_INT_DELAY(n_bytes);
+    sched_event(sh4_clock, &aica_dma_raise_event);
 }
 
 static void adst_reg_write(struct mmio_region_g2_reg_32 *region,
@@ -35,6 +35,8 @@
 #include "hw/g1/g1_reg.h"
 #include "intmath.h"
 #include "compiler_bullshit.h"
+#include "trace.h"
+#include "bench.h"
 
 #include "gdrom.h"
 
@@ -152,6 +154,7 @@ static void post_delay_gdrom_delayed_processing(struct SchedEvent *event) {
     struct gdrom_ctxt *gdrom = (struct gdrom_ctxt*)event->arg_ptr;
     gdrom->gdrom_int_scheduled = false;
 
+    bench_push(BENCH_CAT_GDROM);
     switch (gdrom->state) {
     case GDROM_STATE_PIO_READING:
         RAISE_ERROR(ERROR_INTEGRITY);
@@ -234,6 +237,7 @@ static void post_delay_gdrom_delayed_processing(struct SchedEvent *event) {
         if (!gdrom->dev_ctrl_reg.nien)
             holly_raise_ext_int(HOLLY_EXT_INT_GDROM);
     }
+    bench_pop();
 }
 
 enum sense_key {
@@ -633,9 +637,12 @@ static void gdrom_complete_dma(struct gdrom_ctxt *gdrom) {
     }
 
 done:
-    if (bytes_transmitted)
+    if (bytes_transmitted) {
         GDROM_TRACE("GD-ROM DMA transfer %u bytes to %08X\n",
                     bytes_transmitted, gdrom->dma_start_addr_reg);
+        TRACE_DMA(TRACE_DMA_GDROM, 0, gdrom->dma_start_addr_reg,
+                  bytes_transmitted);
+    }
 
 
     // set GD_LEND, etc here
@@ -777,6 +784,7 @@ static void gdrom_input_packet(struct gdrom_ctxt *gdrom) {
     gdrom->stat_reg.drq = false;
     gdrom->stat_reg.bsy = false;
 
+    bench_push(BENCH_CAT_GDROM);
     switch (gdrom->pkt_buf[0]) {
     case GDROM_PKT_TEST_UNIT:
         gdrom_input_test_unit_packet(gdrom);
@@ -826,6 +834,7 @@ static void gdrom_input_packet(struct gdrom_ctxt *gdrom) {
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
         /* gdrom_state_transition(gdrom, GDROM_STATE_NORM); */
     }
+    bench_pop();
 }
 
 void gdrom_cmd_set_features(struct gdrom_ctxt *gdrom) {
@@ -1416,11 +1425,14 @@ void gdrom_start_dma(struct gdrom_ctxt *gdrom) {
 
         gdrom->stat_reg.drq = false;
         gdrom->stat_reg.bsy = true;
+        bench_push(BENCH_CAT_GDROM);
         gdrom_complete_dma(gdrom);
+        bench_pop();
     }
 }
 
 void gdrom_input_cmd(struct gdrom_ctxt *gdrom, unsigned cmd) {
+    bench_push(BENCH_CAT_GDROM);
     switch (cmd) {
     case GDROM_CMD_PKT:
         gdrom_cmd_begin_packet(gdrom);
@@ -1450,6 +1462,7 @@ void gdrom_input_cmd(struct gdrom_ctxt *gdrom, unsigned cmd) {
         error_set_gdrom_command(cmd);
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
+    bench_pop();
 }
 
 #define GDROM_ERROR_SENSE_KEY_SHIFT 4
@@ -34,6 +34,8 @@
 #include "dc_sched.h"
 #include "dreamcast.h"
 #include "maple_reg.h"
+#include "trace.h"
+#include "maple_movie.h"
 
 #include "maple.h"
 
@@ -236,12 +238,17 @@ void maple_process_dma(struct maple *ctxt, uint32_t src_addr) {
     unsigned ptrn;
     struct maple_frame frame;
     uint32_t frame_meta[3];
+#ifdef ENABLE_TRACE
+    uint32_t first_addr = src_addr;
+#endif
 
 #ifdef INVARIANTS
     if (!ctxt->dma_en)
         RAISE_ERROR(ERROR_INTEGRITY);
 #endif
 
+    maple_movie_pre_dma();
+
     do {
         sh4_dmac_transfer_from_mem(dreamcast_get_cpu(), src_addr,
                                    sizeof(frame_meta[0]), 1, frame_meta);
@@ -276,6 +283,8 @@ void maple_process_dma(struct maple *ctxt, uint32_t src_addr) {
         maple_handle_frame(ctxt, &frame);
 
     } while (!xfer_complete);
+
+    TRACE_DMA(TRACE_DMA_MAPLE, first_addr, 0, src_addr - first_addr);
 }
 
 void maple_addr_unpack(unsigned addr, unsigned *port_out, unsigned *unit_out) {
@@ -0,0 +1,333 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "dc_sched.h"
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "maple.h"
+#include "maple_controller.h"
+#include "maple_keyboard.h"
+
+#include "maple_movie.h"
+
+#define MAPLE_MOVIE_MAGIC "WDCM"
+#define MAPLE_MOVIE_VERSION 1
+#define MAPLE_MOVIE_HEADER_LEN 8
+
+struct maple_movie_event {
+    dc_cycle_stamp_t when;
+    enum maple_movie_op op;
+    unsigned port_no, arg0, arg1;
+};
+
+static struct maple_movie {
+    bool recording, playing;
+
+    struct maple *maple;
+    struct dc_clock *clk;
+
+    // recording state
+    washdc_hostfile file;
+    dc_cycle_stamp_t last_dma_stamp;
+    bool have_dma;
+
+    // playback state
+    uint8_t *dat;
+    long len, pos;
+    bool have_next;
+    struct maple_movie_event next;
+
+    // stamp of the last event written or read
+    dc_cycle_stamp_t last_stamp;
+    unsigned long n_events;
+} mov;
+
+static bool maple_movie_has_arg1(enum maple_movie_op op) {
+    return op == MAPLE_MOVIE_CONT_AXIS || op == MAPLE_MOVIE_KBD_KEY;
+}
+
+static void maple_movie_apply(struct maple_movie_event const *ev) {
+    switch (ev->op) {
+    case MAPLE_MOVIE_CONT_PRESS:
+        maple_controller_press_btns(mov.maple, ev->port_no, ev->arg0);
+        break;
+    case MAPLE_MOVIE_CONT_RELEASE:
+        maple_controller_release_btns(mov.maple, ev->port_no, ev->arg0);
+        break;
+    case MAPLE_MOVIE_CONT_AXIS:
+        maple_controller_set_axis(mov.maple, ev->port_no, ev->arg0, ev->arg1);
+        break;
+    case MAPLE_MOVIE_KBD_KEY:
+        maple_keyboard_press_key(mov.maple, ev->port_no, ev->arg0, ev->arg1);
+        break;
+    case MAPLE_MOVIE_KBD_PRESS_SPECIAL:
+        maple_keyboard_press_special(mov.maple, ev->port_no,
+                                     (enum maple_keyboard_special_keys)ev->arg0);
+        break;
+    case MAPLE_MOVIE_KBD_RELEASE_SPECIAL:
+        maple_keyboard_release_special(mov.maple, ev->port_no,
+                                       (enum maple_keyboard_special_keys)ev->arg0);
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+static void maple_movie_put_varint(uint64_t val) {
+    while (val >= 0x80) {
+        washdc_hostfile_putc(mov.file, (char)((val & 0x7f) | 0x80));
+        val >>= 7;
+    }
+    washdc_hostfile_putc(mov.file, (char)val);
+}
+
+static int maple_movie_get_varint(uint64_t *valp) {
+    uint64_t val = 0;
+    unsigned shift;
+    for (shift = 0; shift < 64; shift += 7) {
+        if (mov.pos >= mov.len)
+            return -1;
+        uint8_t byte = mov.dat[mov.pos++];
+        val |= ((uint64_t)(byte & 0x7f)) << shift;
+        if (!(byte & 0x80)) {
+            *valp = val;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * read the next event out of the movie into mov.next.  When there are no more
+ * events, this clears mov.have_next.
+ */
+static void maple_movie_read_next(void) {
+    uint64_t delta, arg0, arg1 = 0;
+
+    mov.have_next = false;
+    if (mov.pos >= mov.len)
+        return;
+
+    if (maple_movie_get_varint(&delta) != 0 || mov.pos >= mov.len)
+        goto on_corrupt;
+
+    uint8_t op_port = mov.dat[mov.pos++];
+    enum maple_movie_op op = (enum maple_movie_op)(op_port & 0xf);
+    if (op >= MAPLE_MOVIE_OP_COUNT || (op_port & 0xc0))
+        goto on_corrupt;
+
+    if (maple_movie_get_varint(&arg0) != 0)
+        goto on_corrupt;
+    if (maple_movie_has_arg1(op) && maple_movie_get_varint(&arg1) != 0)
+        goto on_corrupt;
+    if (op == MAPLE_MOVIE_CONT_AXIS && arg0 >= MAPLE_CONTROLLER_N_AXES)
+        goto on_corrupt;
+
+    mov.last_stamp += delta;
+    mov.next.when = mov.last_stamp;
+    mov.next.op = op;
+    mov.next.port_no = (op_port >> 4) & 3;
+    mov.next.arg0 = arg0;
+    mov.next.arg1 = arg1;
+    mov.have_next = true;
+    return;
+
+on_corrupt:
+    LOG_ERROR("input movie is corrupt at offset %ld; playback stopped after "
+              "%lu events\n", mov.pos, mov.n_events);
+    mov.pos = mov.len;
+}
+
+static void maple_movie_init_record(char const *path) {
+    mov.file = washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                                    WASHDC_HOSTFILE_BINARY);
+    if (mov.file == WASHDC_HOSTFILE_INVALID) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    uint8_t hdr[MAPLE_MOVIE_HEADER_LEN] = {
+        MAPLE_MOVIE_MAGIC[0], MAPLE_MOVIE_MAGIC[1],
+        MAPLE_MOVIE_MAGIC[2], MAPLE_MOVIE_MAGIC[3],
+        MAPLE_MOVIE_VERSION & 0xff, MAPLE_MOVIE_VERSION >> 8,
+        0, 0
+    };
+    if (washdc_hostfile_write(mov.file, hdr, sizeof(hdr)) != sizeof(hdr)) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    mov.recording = true;
+    LOG_INFO("recording input movie to \"%s\"\n", path);
+}
+
+static void maple_movie_init_play(char const *path) {
+    washdc_hostfile fp = washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                                              WASHDC_HOSTFILE_BINARY);
+    if (fp == WASHDC_HOSTFILE_INVALID) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    if (washdc_hostfile_seek(fp, 0, WASHDC_HOSTFILE_SEEK_END) < 0 ||
+        (mov.len = washdc_hostfile_tell(fp)) < 0 ||
+        washdc_hostfile_seek(fp, 0, WASHDC_HOSTFILE_SEEK_BEG) < 0) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    if (mov.len < MAPLE_MOVIE_HEADER_LEN) {
+        error_set_file_path(path);
+        error_set_length(mov.len);
+        RAISE_ERROR(ERROR_INVALID_FILE_LEN);
+    }
+
+    mov.dat = (uint8_t*)malloc(mov.len);
+    if (!mov.dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    if (washdc_hostfile_read(fp, mov.dat, mov.len) != (size_t)mov.len) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+    washdc_hostfile_close(fp);
+
+    unsigned version = mov.dat[4] | (mov.dat[5] << 8);
+    unsigned flags = mov.dat[6] | (mov.dat[7] << 8);
+    if (memcmp(mov.dat, MAPLE_MOVIE_MAGIC, 4) != 0) {
+        LOG_ERROR("\"%s\" is not an input movie\n", path);
+        error_set_file_path(path);
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+    if (version != MAPLE_MOVIE_VERSION) {
+        LOG_ERROR("input movie \"%s\" has unsupported version %u\n",
+                  path, version);
+        error_set_file_path(path);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+    if (flags & MAPLE_MOVIE_FLAG_SAVE_STATE) {
+        error_set_feature("input movies which start from a save state");
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    mov.pos = MAPLE_MOVIE_HEADER_LEN;
+    mov.playing = true;
+    maple_movie_read_next();
+
+    LOG_INFO("playing back input movie \"%s\"\n", path);
+}
+
+void maple_movie_init(struct maple *maple, struct dc_clock *clk,
+                      char const *record_path, char const *play_path) {
+    memset(&mov, 0, sizeof(mov));
+
+    mov.maple = maple;
+    mov.clk = clk;
+
+    bool record = record_path && strlen(record_path);
+    bool play = play_path && strlen(play_path);
+
+    if (record && play) {
+        LOG_ERROR("can't record and play back an input movie at the same "
+                  "time\n");
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+
+    if (record)
+        maple_movie_init_record(record_path);
+    else if (play)
+        maple_movie_init_play(play_path);
+}
+
+void maple_movie_cleanup(void) {
+    if (mov.recording) {
+        washdc_hostfile_close(mov.file);
+        LOG_INFO("recorded %lu input events\n", mov.n_events);
+    } else if (mov.playing) {
+        if (mov.have_next) {
+            LOG_INFO("input movie playback stopped with events remaining "
+                     "(%lu played)\n", mov.n_events);
+        }
+        free(mov.dat);
+    }
+
+    memset(&mov, 0, sizeof(mov));
+}
+
+void maple_movie_input(enum maple_movie_op op, unsigned port_no,
+                       unsigned arg0, unsigned arg1) {
+    struct maple_movie_event ev = {
+        .op = op, .port_no = port_no, .arg0 = arg0, .arg1 = arg1
+    };
+
+    if (mov.playing)
+        return;
+
+    if (mov.recording) {
+        dc_cycle_stamp_t when = clock_cycle_stamp(mov.clk);
+        if (mov.have_dma && when <= mov.last_dma_stamp)
+            when = mov.last_dma_stamp + 1;
+
+        maple_movie_put_varint(when - mov.last_stamp);
+        washdc_hostfile_putc(mov.file, (char)(op | (port_no << 4)));
+        maple_movie_put_varint(arg0);
+        if (maple_movie_has_arg1(op))
+            maple_movie_put_varint(arg1);
+
+        mov.last_stamp = when;
+        mov.n_events++;
+    }
+
+    maple_movie_apply(&ev);
+}
+
+void maple_movie_pre_dma(void) {
+    if (mov.recording) {
+        mov.last_dma_stamp = clock_cycle_stamp(mov.clk);
+        mov.have_dma = true;
+    } else if (mov.playing) {
+        dc_cycle_stamp_t now = clock_cycle_stamp(mov.clk);
+        while (mov.have_next && mov.next.when <= now) {
+            maple_movie_apply(&mov.next);
+            mov.n_events++;
+            maple_movie_read_next();
+        }
+        if (!mov.have_next) {
+            LOG_INFO("input movie finished after %lu events; the frontend "
+                     "has control of the inputs now\n", mov.n_events);
+            mov.playing = false;
+            free(mov.dat);
+            mov.dat = NULL;
+        }
+    }
+}
@@ -0,0 +1,112 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef MAPLE_MOVIE_H_
+#define MAPLE_MOVIE_H_
+
+/*
+ * Input movies.
+ *
+ * Every input the frontend hands to the emulator goes through
+ * maple_movie_input.  When recording, each input gets written out along with
+ * the SH4 cycle stamp it arrived at; when playing a movie back, the frontend's
+ * input is thrown away and the recorded inputs are applied instead.
+ *
+ * The guest can only see the state of the controllers when it does a maple
+ * DMA, so recorded inputs are applied right before the first maple DMA whose
+ * cycle stamp is not less than the stamp they were recorded at.  When an input
+ * arrives at the same stamp as a DMA that already happened, the recorder bumps
+ * it ahead by one cycle so that it doesn't get applied before that DMA on
+ * playback.  As long as the rest of the emulator is deterministic (same
+ * firmware, flash, disc image and CPU backend), playback gives the guest
+ * exactly the same input at exactly the same moments.
+ *
+ * Movie file format (all multi-byte fixed-width fields are little-endian):
+ *     4 bytes - magic "WDCM"
+ *     2 bytes - version (currently 1)
+ *     2 bytes - flags (see MAPLE_MOVIE_FLAG_*)
+ * followed by any number of events:
+ *     varint  - cycle stamp minus the stamp of the previous event
+ *     1 byte  - opcode in the low 4 bits, maple port in bits 4-5
+ *     varint  - first argument
+ *     varint  - second argument (only for MAPLE_MOVIE_CONT_AXIS and
+ *               MAPLE_MOVIE_KBD_KEY)
+ * varints are unsigned LEB128, 7 bits per byte starting with the least
+ * significant bits, with the high bit set on every byte but the last.
+ *
+ * These functions must only be called from the emulation thread.
+ */
+
+#include <stdbool.h>
+
+/*
+ * this flag means that the movie starts from a saved state instead of from
+ * power-on.  WashingtonDC doesn't have save states yet, so movies with this
+ * flag set get rejected.
+ */
+#define MAPLE_MOVIE_FLAG_SAVE_STATE 1
+
+enum maple_movie_op {
+    // arg0 is the mask of maple buttons to press
+    MAPLE_MOVIE_CONT_PRESS,
+
+    // arg0 is the mask of maple buttons to release
+    MAPLE_MOVIE_CONT_RELEASE,
+
+    // arg0 is the maple axis, arg1 is its new value
+    MAPLE_MOVIE_CONT_AXIS,
+
+    // arg0 is the key code, arg1 is nonzero if the key is pressed
+    MAPLE_MOVIE_KBD_KEY,
+
+    // arg0 is the mask of special keys to press
+    MAPLE_MOVIE_KBD_PRESS_SPECIAL,
+
+    // arg0 is the mask of special keys to release
+    MAPLE_MOVIE_KBD_RELEASE_SPECIAL,
+
+    MAPLE_MOVIE_OP_COUNT
+};
+
+struct maple;
+struct dc_clock;
+
+/*
+ * record_path and play_path can be NULL or empty; at most one of them can be
+ * set.
+ */
+void maple_movie_init(struct maple *maple, struct dc_clock *clk,
+                      char const *record_path, char const *play_path);
+void maple_movie_cleanup(void);
+
+/*
+ * apply an input from the frontend.  When recording, it gets written to the
+ * movie.  While a movie is playing, it gets ignored.
+ */
+void maple_movie_input(enum maple_movie_op op, unsigned port_no,
+                       unsigned arg0, unsigned arg1);
+
+// called by maple_process_dma before it processes any frames
+void maple_movie_pre_dma(void);
+
+#endif
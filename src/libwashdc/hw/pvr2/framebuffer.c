@@ -106,11 +106,140 @@ conv_rgb0888_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
                          uint32_t addr_pixels_in,
                          unsigned n_pixels);
 
+static uint32_t get_tex_mem_offs(addr32_t addr);
+
+#define TEX_MIRROR_MASK 0x7fffff
+
+// the clip registers are 11 bits wide, so rows can be wider than OGL_FB_W_MAX
+#define FB_ROW_MAX (0x7ff + 1)
+
+/*
+ * Page-bitmap helpers.  All of the bitmaps are indexed by offset into the
+ * 32-bit texture memory area (see PVR2_FB_PAGE_SHIFT in framebuffer.h).
+ */
+static inline void fb_page_set(uint32_t *pages, unsigned page) {
+    pages[page / 32] |= 1u << (page % 32);
+}
+
+static void
+fb_page_set_range(uint32_t *pages, uint32_t first, uint32_t last) {
+    unsigned page = first >> PVR2_FB_PAGE_SHIFT;
+    unsigned last_page = last >> PVR2_FB_PAGE_SHIFT;
+    if (last_page >= PVR2_FB_N_PAGES)
+        last_page = PVR2_FB_N_PAGES - 1;
+    for (; page <= last_page; page++)
+        fb_page_set(pages, page);
+}
+
+static bool fb_pages_any(uint32_t const *pages) {
+    unsigned idx;
+    for (idx = 0; idx < PVR2_FB_PAGE_WORDS; idx++)
+        if (pages[idx])
+            return true;
+    return false;
+}
+
+/*
+ * Figure out which offsets into the 32-bit texture memory area back the
+ * given range of texture memory addresses.  first and last are absolute
+ * addresses; they can point to either the 32-bit area or the 64-bit area.
+ * Ranges in the 64-bit area are split between both banks so this returns the
+ * number of ranges written to phys_first/phys_last (either 1 or 2).
+ *
+ * The 64-bit ranges are rounded out to the nearest word, so the result is
+ * allowed to be slightly larger than the input.
+ */
+static unsigned tex_phys_ranges(uint32_t first, uint32_t last,
+                                uint32_t phys_first[2], uint32_t phys_last[2]) {
+    uint32_t first_offs = first & TEX_MIRROR_MASK;
+    uint32_t last_offs = last & TEX_MIRROR_MASK;
+    if (last_offs < first_offs)
+        last_offs = TEX_MIRROR_MASK;
+
+    if (get_tex_mem_offs(first) == ADDR_TEX64_FIRST) {
+        phys_first[0] = (first_offs / 2) & ~3;
+        phys_last[0] = (last_offs / 2) | 3;
+        phys_first[1] = phys_first[0] + PVR2_TEX_MEM_BANK_SIZE;
+        phys_last[1] = phys_last[0] + PVR2_TEX_MEM_BANK_SIZE;
+        return 2;
+    }
+
+    phys_first[0] = first_offs;
+    phys_last[0] = last_offs;
+    return 1;
+}
+
+/*
+ * set the pages which back the given range of a framebuffer.  first and last
+ * are offsets from ADDR_TEX32_FIRST like the addr_first/addr_last members of
+ * struct framebuffer.
+ */
+static void fb_mark_range(uint32_t *pages, uint32_t first, uint32_t last) {
+    uint32_t phys_first[2], phys_last[2];
+    unsigned n_ranges = tex_phys_ranges(first + ADDR_TEX32_FIRST,
+                                        last + ADDR_TEX32_FIRST,
+                                        phys_first, phys_last);
+    unsigned idx;
+    for (idx = 0; idx < n_ranges; idx++)
+        fb_page_set_range(pages, phys_first[idx], phys_last[idx]);
+}
+
+// like fb_mark_range, but test the pages instead of setting them
+static bool
+fb_range_test(uint32_t const *pages, uint32_t first, uint32_t last) {
+    uint32_t phys_first[2], phys_last[2];
+    unsigned n_ranges = tex_phys_ranges(first + ADDR_TEX32_FIRST,
+                                        last + ADDR_TEX32_FIRST,
+                                        phys_first, phys_last);
+    unsigned idx;
+    for (idx = 0; idx < n_ranges; idx++) {
+        if (pvr2_fb_page_range_test(pages, phys_first[idx],
+                                    phys_last[idx] - phys_first[idx] + 1))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * used by the framebuffer sync functions to skip over rows that don't need to
+ * be synced.  A NULL pages pointer means the whole framebuffer gets synced.
+ */
+static inline bool
+fb_row_needs_sync(uint32_t const *pages, uint32_t addr, unsigned n_bytes) {
+    return !pages || fb_range_test(pages, addr, addr + n_bytes - 1);
+}
+
+static void fb_set_footprint(struct framebuffer *fb) {
+    memset(fb->footprint, 0, sizeof(fb->footprint));
+    fb_mark_range(fb->footprint, fb->addr_first[0], fb->addr_last[0]);
+    fb_mark_range(fb->footprint, fb->addr_first[1], fb->addr_last[1]);
+}
+
+// recalculate the union bitmaps in struct pvr2_fb
+static void fb_update_global_pages(struct pvr2 *pvr2) {
+    struct pvr2_fb *pfb = &pvr2->fb;
+
+    memset(pfb->footprint, 0, sizeof(pfb->footprint));
+    memset(pfb->host_dirty, 0, sizeof(pfb->host_dirty));
+
+    unsigned fb_idx, word;
+    for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
+        struct framebuffer const *fb = pfb->fb_heap + fb_idx;
+        if (fb->flags.state == FB_STATE_INVALID)
+            continue;
+        for (word = 0; word < PVR2_FB_PAGE_WORDS; word++) {
+            pfb->footprint[word] |= fb->footprint[word];
+            pfb->host_dirty[word] |= fb->host_dirty[word];
+        }
+    }
+}
+
 static void
 sync_fb_from_tex_mem_rgb565_intl(struct pvr2 *pvr2, struct framebuffer *fb,
                                  unsigned fb_width, unsigned fb_height,
                                  uint32_t sof1, uint32_t sof2,
-                                 unsigned modulus, unsigned concat) {
+                                 unsigned modulus, unsigned concat,
+                                 uint32_t const *pages) {
     /*
      * field_adv represents the distand between the start of one row and the
      * start of the next row in the same field in terms of bytes.
@@ -154,10 +283,14 @@ sync_fb_from_tex_mem_rgb565_intl(struct pvr2 *pvr2, struct framebuffer *fb,
         uint32_t addr_row1 = sof1 + row * field_adv;
         uint32_t addr_row2 = sof2 + row * field_adv;
 
-        conv_rgb565_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
-                                addr_row1, fb_width, concat);
-        conv_rgb565_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
-                                addr_row2, fb_width, concat);
+        if (fb_row_needs_sync(pages, addr_row1, 2 * fb_width)) {
+            conv_rgb565_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
+                                    addr_row1, fb_width, concat);
+        }
+        if (fb_row_needs_sync(pages, addr_row2, 2 * fb_width)) {
+            conv_rgb565_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
+                                    addr_row2, fb_width, concat);
+        }
     }
 
     fb->addr_key = first_addr_field1  < first_addr_field2 ?
@@ -190,7 +323,8 @@ sync_fb_from_tex_mem_rgb565_intl(struct pvr2 *pvr2, struct framebuffer *fb,
 static void
 sync_fb_from_tex_mem_rgb565_prog(struct pvr2 *pvr2, struct framebuffer *fb,
                                  unsigned fb_width, unsigned fb_height,
-                                 uint32_t sof1, unsigned concat) {
+                                 uint32_t sof1, unsigned concat,
+                                 uint32_t const *pages) {
     unsigned field_adv = fb_width;
     /*
      * bounds checking
@@ -216,13 +350,17 @@ sync_fb_from_tex_mem_rgb565_prog(struct pvr2 *pvr2, struct framebuffer *fb,
     }
 
     uint32_t *dst_fb = (uint32_t*)pvr2->fb.ogl_fb;
-    memset(pvr2->fb.ogl_fb, 0xff, sizeof(pvr2->fb.ogl_fb));
+    if (!pages)
+        memset(pvr2->fb.ogl_fb, 0xff, sizeof(pvr2->fb.ogl_fb));
 
     unsigned row;
     for (row = 0; row < fb_height; row++) {
         uint32_t in_col_start_addr = sof1 + field_adv * row * 2;
         uint32_t *out_col_start = dst_fb + row * fb_width;
 
+        if (!fb_row_needs_sync(pages, in_col_start_addr, 2 * fb_width))
+            continue;
+
         conv_rgb565_to_rgba8888(pvr2, out_col_start, in_col_start_addr,
                                 fb_width, concat);
     }
@@ -255,7 +393,8 @@ static void
 sync_fb_from_tex_mem_rgb555_intl(struct pvr2 *pvr2, struct framebuffer *fb,
                                  unsigned fb_width, unsigned fb_height,
                                  uint32_t sof1, uint32_t sof2,
-                                 unsigned modulus, unsigned concat) {
+                                 unsigned modulus, unsigned concat,
+                                 uint32_t const *pages) {
     /*
      * field_adv represents the distand between the start of one row and the
      * start of the next row in the same field in terms of bytes.
@@ -299,10 +438,14 @@ sync_fb_from_tex_mem_rgb555_intl(struct pvr2 *pvr2, struct framebuffer *fb,
         uint32_t addr_row1 = sof1 + row * field_adv;
         uint32_t addr_row2 = sof2 + row * field_adv;
 
-        conv_rgb555_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
-                                addr_row1, fb_width, concat);
-        conv_rgb555_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
-                                addr_row2, fb_width, concat);
+        if (fb_row_needs_sync(pages, addr_row1, 2 * fb_width)) {
+            conv_rgb555_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
+                                    addr_row1, fb_width, concat);
+        }
+        if (fb_row_needs_sync(pages, addr_row2, 2 * fb_width)) {
+            conv_rgb555_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
+                                    addr_row2, fb_width, concat);
+        }
     }
 
     fb->addr_key = first_addr_field1  < first_addr_field2 ?
@@ -336,7 +479,7 @@ static void
 sync_fb_from_tex_mem_rgb888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
                                  unsigned fb_width, unsigned fb_height,
                                  uint32_t sof1, uint32_t sof2,
-                                 unsigned modulus) {
+                                 unsigned modulus, uint32_t const *pages) {
     /*
      * field_adv represents the distand between the start of one row and the
      * start of the next row in the same field in terms of bytes.
@@ -380,10 +523,14 @@ sync_fb_from_tex_mem_rgb888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
         uint32_t addr_row1 = sof1 + row * field_adv;
         uint32_t addr_row2 = sof2 + row * field_adv;
 
-        conv_rgb888_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
-                                addr_row1, fb_width);
-        conv_rgb888_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
-                                addr_row2, fb_width);
+        if (fb_row_needs_sync(pages, addr_row1, 3 * fb_width)) {
+            conv_rgb888_to_rgba8888(pvr2, dst_fb + row * 2 * fb_width,
+                                    addr_row1, fb_width);
+        }
+        if (fb_row_needs_sync(pages, addr_row2, 3 * fb_width)) {
+            conv_rgb888_to_rgba8888(pvr2, dst_fb + (row * 2 + 1) * fb_width,
+                                    addr_row2, fb_width);
+        }
     }
 
     fb->addr_key = first_addr_field1  < first_addr_field2 ?
@@ -416,7 +563,8 @@ sync_fb_from_tex_mem_rgb888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
 static void
 sync_fb_from_tex_mem_rgb555_prog(struct pvr2 *pvr2, struct framebuffer *fb,
                                  unsigned fb_width, unsigned fb_height,
-                                 uint32_t sof1, unsigned concat) {
+                                 uint32_t sof1, unsigned concat,
+                                 uint32_t const *pages) {
     unsigned field_adv = fb_width;
     /*
      * bounds checking
@@ -442,13 +590,17 @@ sync_fb_from_tex_mem_rgb555_prog(struct pvr2 *pvr2, struct framebuffer *fb,
     }
 
     uint32_t *dst_fb = (uint32_t*)pvr2->fb.ogl_fb;
-    memset(pvr2->fb.ogl_fb, 0xff, sizeof(pvr2->fb.ogl_fb));
+    if (!pages)
+        memset(pvr2->fb.ogl_fb, 0xff, sizeof(pvr2->fb.ogl_fb));
 
     unsigned row;
     for (row = 0; row < fb_height; row++) {
         uint32_t in_col_start_addr = sof1 + field_adv * row * 2;
         uint32_t *out_col_start = dst_fb + row * fb_width;
 
+        if (!fb_row_needs_sync(pages, in_col_start_addr, 2 * fb_width))
+            continue;
+
         conv_rgb555_to_rgba8888(pvr2, out_col_start, in_col_start_addr,
                                 fb_width, concat);
     }
@@ -481,7 +633,7 @@ static void
 sync_fb_from_tex_mem_rgb0888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
                                   unsigned fb_width, unsigned fb_height,
                                   uint32_t sof1, uint32_t sof2,
-                                  unsigned modulus) {
+                                  unsigned modulus, uint32_t const *pages) {
     /*
      * field_adv represents the distand between the start of one row and the
      * start of the next row in the same field in terms of bytes.
@@ -525,11 +677,15 @@ sync_fb_from_tex_mem_rgb0888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
         uint32_t addr_row1 = sof1 + row * field_adv;
         uint32_t addr_row2 = sof2 + row * field_adv;
 
-        conv_rgb0888_to_rgba8888(pvr2, dst_fb + (row << 1) * fb_width,
-                                 addr_row1, fb_width);
-        conv_rgb0888_to_rgba8888(pvr2,
-                                 dst_fb + ((row << 1) + 1) * fb_width,
-                                 addr_row2, fb_width);
+        if (fb_row_needs_sync(pages, addr_row1, 4 * fb_width)) {
+            conv_rgb0888_to_rgba8888(pvr2, dst_fb + (row << 1) * fb_width,
+                                     addr_row1, fb_width);
+        }
+        if (fb_row_needs_sync(pages, addr_row2, 4 * fb_width)) {
+            conv_rgb0888_to_rgba8888(pvr2,
+                                     dst_fb + ((row << 1) + 1) * fb_width,
+                                     addr_row2, fb_width);
+        }
     }
 
     fb->fb_read_width = fb_width;
@@ -562,7 +718,7 @@ sync_fb_from_tex_mem_rgb0888_intl(struct pvr2 *pvr2, struct framebuffer *fb,
 static void
 sync_fb_from_tex_mem_rgb0888_prog(struct pvr2 *pvr2, struct framebuffer *fb,
                                   unsigned fb_width, unsigned fb_height,
-                                  uint32_t sof1) {
+                                  uint32_t sof1, uint32_t const *pages) {
     addr32_t last_byte = sof1 + fb_width * fb_height * 4;
     addr32_t first_byte = sof1;
 
@@ -592,6 +748,9 @@ sync_fb_from_tex_mem_rgb0888_prog(struct pvr2 *pvr2, struct framebuffer *fb,
         uint32_t addr_in_col_start = sof1 + fb_width * row * 4;
         uint32_t *out_col_start = dst_fb + row * fb_width;
 
+        if (!fb_row_needs_sync(pages, addr_in_col_start, 4 * fb_width))
+            continue;
+
         conv_rgb0888_to_rgba8888(pvr2, out_col_start,
                                  addr_in_col_start, fb_width);
     }
@@ -620,10 +779,17 @@ sync_fb_from_tex_mem_rgb0888_prog(struct pvr2 *pvr2, struct framebuffer *fb,
     rend_exec_il(&cmd, 1);
 }
 
+/*
+ * convert the framebuffer from texture memory into ogl_fb and send it to the
+ * gfx infrastructure.  If pages is non-NULL, then only the rows which overlap
+ * those pages are converted; in that case ogl_fb must already hold the
+ * host copy of this framebuffer.
+ */
 static void
 sync_fb_from_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb,
                      unsigned width, unsigned height,
-                     unsigned modulus, unsigned concat) {
+                     unsigned modulus, unsigned concat,
+                     uint32_t const *pages) {
     bool interlace = get_spg_control(pvr2) & (1 << 4);
 
     uint32_t fb_r_sof1 = get_fb_r_sof1(pvr2) & ~3;
@@ -636,27 +802,27 @@ sync_fb_from_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb,
         // 16-bit 555 RGB
         if (interlace) {
             sync_fb_from_tex_mem_rgb555_intl(pvr2, fb, width, height, fb_r_sof1,
-                                             fb_r_sof2, modulus, concat);
+                                             fb_r_sof2, modulus, concat, pages);
         } else {
             sync_fb_from_tex_mem_rgb555_prog(pvr2, fb, width, height,
-                                             fb_r_sof1, concat);
+                                             fb_r_sof1, concat, pages);
         }
         break;
     case 1:
         // 16-bit 565 RGB
         if (interlace) {
             sync_fb_from_tex_mem_rgb565_intl(pvr2, fb, width, height, fb_r_sof1,
-                                             fb_r_sof2, modulus, concat);
+                                             fb_r_sof2, modulus, concat, pages);
         } else {
             sync_fb_from_tex_mem_rgb565_prog(pvr2, fb, width, height,
-                                             fb_r_sof1, concat);
+                                             fb_r_sof1, concat, pages);
         }
         break;
     case 2:
         // 24-bit 888 RGB
         if (interlace) {
             sync_fb_from_tex_mem_rgb888_intl(pvr2, fb, width, height, fb_r_sof1,
-                                             fb_r_sof2, modulus);
+                                             fb_r_sof2, modulus, pages);
         } else {
             error_set_feature("video mode RGB888 (progressive scan)");
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
@@ -666,12 +832,18 @@ sync_fb_from_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb,
         // 32-bit 08888 RGB
         if (interlace) {
             sync_fb_from_tex_mem_rgb0888_intl(pvr2, fb, width, height, fb_r_sof1,
-                                              fb_r_sof2, modulus);
+                                              fb_r_sof2, modulus, pages);
         } else {
             sync_fb_from_tex_mem_rgb0888_prog(pvr2, fb, width, height,
-                                              fb_r_sof1);
+                                              fb_r_sof1, pages);
         }
     }
+
+    memset(fb->guest_dirty, 0, sizeof(fb->guest_dirty));
+    memset(fb->host_dirty, 0, sizeof(fb->host_dirty));
+    fb_set_footprint(fb);
+    fb_update_global_pages(pvr2);
+    pvr2->fb.ogl_fb_owner = fb - pvr2->fb.fb_heap;
 }
 
 /*
@@ -744,6 +916,10 @@ conv_rgb0888_to_rgba8888(struct pvr2 *pvr2, uint32_t *pixels_out,
 static int
 pick_fb(struct pvr2 *pvr2, unsigned width, unsigned height, uint32_t addr);
 
+static void fb_fetch_host_copy(struct pvr2 *pvr2, int fb_idx);
+static void
+sync_fb_to_tex_mem(struct pvr2 *pvr2, int fb_idx, uint32_t const *pages);
+
 // reset all members except the gfx_obj handle
 static void fb_reset(struct framebuffer *fb) {
     fb->fb_read_width = 0;
@@ -764,12 +940,22 @@ static void fb_reset(struct framebuffer *fb) {
     fb->flags.state = FB_STATE_INVALID;
     fb->flags.fmt = FB_PIX_FMT_RGB_555;
     fb->flags.vert_flip = false;
+    fb->flags.displayed = false;
+    fb->flags.read_back = false;
+    memset(fb->footprint, 0, sizeof(fb->footprint));
+    memset(fb->host_dirty, 0, sizeof(fb->host_dirty));
+    memset(fb->guest_dirty, 0, sizeof(fb->guest_dirty));
 }
 
 void pvr2_framebuffer_init(struct pvr2 *pvr2) {
     struct gfx_il_inst cmd;
     struct framebuffer *fb_heap = pvr2->fb.fb_heap;
 
+    pvr2->fb.ogl_fb_owner = -1;
+    pvr2->fb.syncing = false;
+    memset(pvr2->fb.footprint, 0, sizeof(pvr2->fb.footprint));
+    memset(pvr2->fb.host_dirty, 0, sizeof(pvr2->fb.host_dirty));
+
     int fb_no;
     for (fb_no = 0; fb_no < FB_HEAP_SIZE; fb_no++) {
         fb_reset(fb_heap + fb_no);
@@ -824,8 +1010,22 @@ void framebuffer_render(struct pvr2 *pvr2) {
     }
 
     struct framebuffer *fb_heap = pvr2->fb.fb_heap;
-
     int fb_idx;
+
+    /*
+     * Before reading anything out of texture memory, make sure that there
+     * aren't any framebuffers holding newer versions of that memory on the
+     * host.  This is a conservative estimate of the range that's about to be
+     * read.
+     */
+    uint32_t addr_last = addr_first +
+        (height * (interlace ? 2 : 1) + 1) * (width * pix_sz + modulus * 4);
+    uint32_t read_pages[PVR2_FB_PAGE_WORDS];
+    memset(read_pages, 0, sizeof(read_pages));
+    fb_mark_range(read_pages, addr_first, addr_last);
+    for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++)
+        sync_fb_to_tex_mem(pvr2, fb_idx, read_pages);
+
     for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
         struct framebuffer *fb = fb_heap + fb_idx;
         if (fb->fb_read_width == width &&
@@ -833,9 +1033,29 @@ void framebuffer_render(struct pvr2 *pvr2) {
             fb->addr_key == addr_first &&
             fb->flags.state != FB_STATE_INVALID) {
 
-            if (!(fb_heap[fb_idx].flags.state & FB_STATE_GFX)) {
-                sync_fb_from_tex_mem(pvr2, fb_heap + fb_idx, width,
-                                     height, modulus, concat);
+            if (!(fb->flags.state & FB_STATE_GFX)) {
+                sync_fb_from_tex_mem(pvr2, fb, width,
+                                     height, modulus, concat, NULL);
+            } else if (fb_pages_any(fb->guest_dirty)) {
+                if (fb->flags.vert_flip) {
+                    /*
+                     * the host copy was originally converted from texture
+                     * memory, so only the rows the guest touched need to be
+                     * converted again.
+                     */
+                    fb_fetch_host_copy(pvr2, fb_idx);
+                    sync_fb_from_tex_mem(pvr2, fb, width, height,
+                                         modulus, concat, fb->guest_dirty);
+                } else {
+                    /*
+                     * the host copy was rendered by the gfx backend, which
+                     * uses a different layout.  Finish copying it back into
+                     * texture memory and then convert the whole thing.
+                     */
+                    sync_fb_to_tex_mem(pvr2, fb_idx, NULL);
+                    sync_fb_from_tex_mem(pvr2, fb, width, height,
+                                         modulus, concat, NULL);
+                }
             }
 
             goto submit_the_fb;
@@ -844,10 +1064,11 @@ void framebuffer_render(struct pvr2 *pvr2) {
 
     fb_idx = pick_fb(pvr2, width, height, fb_r_sof1);
     sync_fb_from_tex_mem(pvr2, fb_heap + fb_idx,
-                         width, height, modulus, concat);
+                         width, height, modulus, concat, NULL);
 
 submit_the_fb:
     pvr2->fb.stamp++;
+    fb_heap[fb_idx].flags.displayed = true;
 
     cmd.op = GFX_IL_POST_FRAMEBUFFER;
     cmd.arg.post_framebuffer.obj_handle = fb_heap[fb_idx].obj_handle;
@@ -891,8 +1112,37 @@ submit_the_fb:
     rend_exec_il(&cmd, 1);
 }
 
+/*
+ * write one row of a framebuffer into texture memory, skipping over any parts
+ * of it which fall outside of the given pages.  Those parts might hold data
+ * that the guest wrote after they were synced, so they can't be overwritten.
+ */
 static void
-fb_sync_from_host_0565_krgb(struct pvr2 *pvr2, struct framebuffer *fb) {
+fb_copy_row_to_tex_mem(struct pvr2 *pvr2, uint32_t const *pages,
+                       void const *row, uint32_t offs, unsigned n_bytes) {
+    if (!pages) {
+        copy_to_tex_mem(pvr2, row, offs, n_bytes);
+        return;
+    }
+
+    uint8_t const *row_bytes = (uint8_t const*)row;
+    while (n_bytes) {
+        unsigned chunk_len = PVR2_FB_PAGE_SIZE - (offs % PVR2_FB_PAGE_SIZE);
+        if (chunk_len > n_bytes)
+            chunk_len = n_bytes;
+
+        if (fb_range_test(pages, offs, offs + chunk_len - 1))
+            copy_to_tex_mem(pvr2, row_bytes, offs, chunk_len);
+
+        row_bytes += chunk_len;
+        offs += chunk_len;
+        n_bytes -= chunk_len;
+    }
+}
+
+static void
+fb_sync_from_host_0565_krgb(struct pvr2 *pvr2, struct framebuffer *fb,
+                            uint32_t const *pages) {
     unsigned x_min = fb->x_clip_min;
     unsigned y_min = fb->y_clip_min;
     unsigned x_max = fb->tile_w < fb->x_clip_max ? fb->tile_w : fb->x_clip_max;
@@ -907,23 +1157,27 @@ fb_sync_from_host_0565_krgb(struct pvr2 *pvr2, struct framebuffer *fb) {
 
     assert((width * height * 4) < OGL_FB_BYTES);
 
+    uint16_t row_buf[FB_ROW_MAX];
     unsigned row, col;
     uint8_t *ogl_fb = pvr2->fb.ogl_fb;
     for (row = y_min; row <= y_max; row++) {
         unsigned line_offs = addr[0] + (height - (row + 1)) * stride;
+        if (!fb_row_needs_sync(pages, line_offs + 2 * x_min, 2 * width))
+            continue;
         for (col = x_min; col <= x_max; col++) {
             unsigned fb_idx = row * width + col;
-            uint16_t pix_out = ((ogl_fb[4 * fb_idx + 2] & 0xf8) >> 3) |
+            row_buf[col - x_min] = ((ogl_fb[4 * fb_idx + 2] & 0xf8) >> 3) |
                 ((ogl_fb[4 * fb_idx + 1] & 0xfc) << 3) |
                 ((ogl_fb[4 * fb_idx] & 0xf8) << 8) | k_val;
-            copy_to_tex_mem(pvr2, &pix_out,
-                            line_offs + 2 * col, sizeof(pix_out));
         }
+        fb_copy_row_to_tex_mem(pvr2, pages, row_buf, line_offs + 2 * x_min,
+                               width * sizeof(row_buf[0]));
     }
 }
 
 static void
-fb_sync_from_host_0555_krgb(struct pvr2 *pvr2, struct framebuffer *fb) {
+fb_sync_from_host_0555_krgb(struct pvr2 *pvr2, struct framebuffer *fb,
+                            uint32_t const *pages) {
     unsigned x_min = fb->x_clip_min;
     unsigned y_min = fb->y_clip_min;
     unsigned x_max = fb->tile_w < fb->x_clip_max ? fb->tile_w : fb->x_clip_max;
@@ -938,24 +1192,28 @@ fb_sync_from_host_0555_krgb(struct pvr2 *pvr2, struct framebuffer *fb) {
 
     assert((width * height * 4) < OGL_FB_BYTES);
 
+    uint16_t row_buf[FB_ROW_MAX];
     unsigned row, col;
     uint8_t *ogl_fb = pvr2->fb.ogl_fb;
     for (row = y_min; row <= y_max; row++) {
         unsigned line_offs = addr[0] + (height - (row + 1)) * stride;
+        if (!fb_row_needs_sync(pages, line_offs + 2 * x_min, 2 * width))
+            continue;
         for (col = x_min; col <= x_max; col++) {
             unsigned fb_idx = row * width + col;
-            uint16_t pix_out = ((ogl_fb[4 * fb_idx + 2] & 0xf8) >> 3) |
+            row_buf[col - x_min] = ((ogl_fb[4 * fb_idx + 2] & 0xf8) >> 3) |
                 ((ogl_fb[4 * fb_idx + 1] & 0xf8) << 3) |
                 ((ogl_fb[4 * fb_idx] & 0xf8) << 7) | k_val;
-            copy_to_tex_mem(pvr2, &pix_out,
-                            line_offs + 2 * col, sizeof(pix_out));
         }
+        fb_copy_row_to_tex_mem(pvr2, pages, row_buf, line_offs + 2 * x_min,
+                               width * sizeof(row_buf[0]));
     }
 }
 
 
 static void
-fb_sync_from_host_1555_argb(struct pvr2 *pvr2, struct framebuffer *fb) {
+fb_sync_from_host_1555_argb(struct pvr2 *pvr2, struct framebuffer *fb,
+                            uint32_t const *pages) {
     unsigned x_min = fb->x_clip_min;
     unsigned y_min = fb->y_clip_min;
     unsigned x_max = fb->tile_w < fb->x_clip_max ? fb->tile_w : fb->x_clip_max;
@@ -968,6 +1226,7 @@ fb_sync_from_host_1555_argb(struct pvr2 *pvr2, struct framebuffer *fb) {
 
     assert((width * height * 4) < OGL_FB_BYTES);
 
+    uint16_t row_buf[FB_ROW_MAX];
     unsigned row, col;
     uint8_t *ogl_fb = pvr2->fb.ogl_fb;
     for (row = y_min; row <= y_max; row++) {
@@ -981,25 +1240,32 @@ fb_sync_from_host_1555_argb(struct pvr2 *pvr2, struct framebuffer *fb) {
          * that out right.
          */
         unsigned line_offs = addr[0] + (height - (row + 1)) * stride;
+        if (!fb_row_needs_sync(pages, line_offs + 2 * x_min, 2 * width))
+            continue;
         for (col = x_min; col <= x_max; col++) {
             unsigned fb_idx = row * width + col;
 
             uint8_t const *pix_in = ogl_fb + 4 * fb_idx;
             uint16_t red = (pix_in[0] & 0xf8) >> 3;
             uint16_t green = (pix_in[1] & 0xf8) >> 3;
-            uint16_t blue = (pix_in[2] * 0xf8) >> 3;
+            uint16_t blue = (pix_in[2] & 0xf8) >> 3;
             uint16_t alpha = pix_in[3] ? 1 : 0;
 
-            uint16_t pix_out =
+            row_buf[col - x_min] =
                 (alpha << 15) | (red << 10) | (green << 5) | blue;
-
-            copy_to_tex_mem(pvr2, &pix_out,
-                            line_offs + 2 * col, sizeof(pix_out));
         }
+        fb_copy_row_to_tex_mem(pvr2, pages, row_buf, line_offs + 2 * x_min,
+                               width * sizeof(row_buf[0]));
     }
 }
 
-static void fb_sync_from_host_rgb0888(struct pvr2 *pvr2, struct framebuffer *fb) {
+/*
+ * common implementation for the two 32-bit formats.  alpha_mask gets AND'd
+ * with every pixel; that's the only difference between them.
+ */
+static void
+fb_sync_from_host_32bit(struct pvr2 *pvr2, struct framebuffer *fb,
+                        uint32_t const *pages, uint32_t alpha_mask) {
     /*
      * TODO: don't get width, height from fb_read_width and fb_read_height
      * (see fb_sync_from_host_0565_krgb_intl for an example of how this should
@@ -1014,121 +1280,115 @@ static void fb_sync_from_host_rgb0888(struct pvr2 *pvr2, struct framebuffer *fb)
 
     assert((width * height * 4) < OGL_FB_BYTES);
 
-    unsigned row, col;
+    uint32_t row_buf[OGL_FB_W_MAX];
+    unsigned row, col, field;
     for (row = 0; row < rows_per_field; row++) {
-        unsigned row_actual[2] = { 2 * row, 2 * row + 1 };
-        unsigned line_offs[2] = {
-            addr[0] + (rows_per_field - (row + 1)) * stride,
-            addr[1] + (rows_per_field - (row + 1)) * stride
-        };
-
-        for (col = 0; col < width; col++) {
-            unsigned ogl_fb_idx[2] = {
-                row_actual[0] * width + col,
-                row_actual[1] * width + col
-            };
-
-            uint32_t pix_in[2] = {
-                fb_in[ogl_fb_idx[0]],
-                fb_in[ogl_fb_idx[1]]
-            };
-
-            uint32_t pix_out[2] = {
-                pix_in[0] & 0x00ffffff,
-                pix_in[1] & 0x00ffffff
-            };
-
-            copy_to_tex_mem(pvr2, pix_out + 0,
-                            line_offs[0] + 2 * col, sizeof(pix_out[0]));
-            copy_to_tex_mem(pvr2, pix_out + 1,
-                            line_offs[1] + 2 * col, sizeof(pix_out[1]));
-        }
-    }
-}
+        for (field = 0; field < 2; field++) {
+            unsigned row_actual = 2 * row + field;
+            unsigned line_offs =
+                addr[field] + (rows_per_field - (row + 1)) * stride;
 
-static void fb_sync_from_host_argb8888(struct pvr2 *pvr2, struct framebuffer *fb) {
-    /*
-     * TODO: don't get width, height from fb_read_width and fb_read_height
-     * (see fb_sync_from_host_0565_krgb_intl for an example of how this should
-     * work).
-     */
-    unsigned width = fb->fb_read_width;
-    unsigned height = fb->fb_read_height;
-    unsigned stride = fb->linestride;
-    uint32_t const *fb_in = (uint32_t*)pvr2->fb.ogl_fb;
-    unsigned rows_per_field = height / 2;
-    unsigned const *addr = fb->addr_first;
+            if (!fb_row_needs_sync(pages, line_offs, 4 * width))
+                continue;
 
-    assert((width * height * 4) < OGL_FB_BYTES);
+            for (col = 0; col < width; col++)
+                row_buf[col] = fb_in[row_actual * width + col] & alpha_mask;
 
-    unsigned row, col;
-    for (row = 0; row < rows_per_field; row++) {
-        unsigned row_actual[2] = { 2 * row, 2 * row + 1 };
-        unsigned line_offs[2] = {
-            addr[0] + (rows_per_field - (row + 1)) * stride,
-            addr[1] + (rows_per_field - (row + 1)) * stride
-        };
-
-        for (col = 0; col < width; col++) {
-            unsigned ogl_fb_idx[2] = {
-                row_actual[0] * width + col,
-                row_actual[1] * width + col
-            };
-
-            uint32_t pix_in[2] = {
-                fb_in[ogl_fb_idx[0]],
-                fb_in[ogl_fb_idx[1]]
-            };
-
-            uint32_t pix_out[2] = {
-                pix_in[0],
-                pix_in[1]
-            };
-
-            copy_to_tex_mem(pvr2, pix_out + 0,
-                            line_offs[0] + 2 * col, sizeof(pix_out[0]));
-            copy_to_tex_mem(pvr2, pix_out + 1,
-                            line_offs[1] + 2 * col, sizeof(pix_out[1]));
+            fb_copy_row_to_tex_mem(pvr2, pages, row_buf, line_offs,
+                                   width * sizeof(row_buf[0]));
         }
     }
 }
 
 static void
-sync_fb_to_tex_mem(struct pvr2 *pvr2, struct framebuffer *fb) {
-    if (fb->flags.state != FB_STATE_GFX)
-        return;
+fb_sync_from_host_rgb0888(struct pvr2 *pvr2, struct framebuffer *fb,
+                          uint32_t const *pages) {
+    fb_sync_from_host_32bit(pvr2, fb, pages, 0x00ffffff);
+}
+
+static void
+fb_sync_from_host_argb8888(struct pvr2 *pvr2, struct framebuffer *fb,
+                           uint32_t const *pages) {
+    fb_sync_from_host_32bit(pvr2, fb, pages, 0xffffffff);
+}
 
-    fb->flags.state |= ~FB_STATE_VIRT;
+// make sure that ogl_fb holds the host's copy of the given framebuffer
+static void fb_fetch_host_copy(struct pvr2 *pvr2, int fb_idx) {
+    if (pvr2->fb.ogl_fb_owner == fb_idx)
+        return;
 
     struct gfx_il_inst cmd = {
         .op = GFX_IL_READ_OBJ,
         .arg = { .read_obj = {
             .dat = pvr2->fb.ogl_fb,
-            .obj_no = fb->obj_handle,
+            .obj_no = pvr2->fb.fb_heap[fb_idx].obj_handle,
             .n_bytes = sizeof(pvr2->fb.ogl_fb)/* OGL_FB_W_MAX * OGL_FB_H_MAX * 4 */
             } }
     };
     rend_exec_il(&cmd, 1);
+    pvr2->fb.ogl_fb_owner = fb_idx;
+}
+
+/*
+ * copy pages which are dirty on the host back into texture memory.  Only
+ * pages which are set in both the framebuffer's host_dirty bitmap and the
+ * given pages bitmap will be copied.  If pages is NULL, then every dirty page
+ * gets copied.
+ */
+static void
+sync_fb_to_tex_mem(struct pvr2 *pvr2, int fb_idx, uint32_t const *pages) {
+    struct framebuffer *fb = pvr2->fb.fb_heap + fb_idx;
+    if (!(fb->flags.state & FB_STATE_GFX))
+        return;
+
+    uint32_t sync_pages[PVR2_FB_PAGE_WORDS];
+    bool any_pages = false;
+    unsigned word;
+    for (word = 0; word < PVR2_FB_PAGE_WORDS; word++) {
+        sync_pages[word] = fb->host_dirty[word];
+        if (pages)
+            sync_pages[word] &= pages[word];
+        fb->host_dirty[word] &= ~sync_pages[word];
+        if (sync_pages[word])
+            any_pages = true;
+    }
+
+    if (!any_pages)
+        return;
+
+    if (!fb_pages_any(fb->host_dirty))
+        fb->flags.state |= FB_STATE_VIRT;
+    fb_update_global_pages(pvr2);
+
+    fb_fetch_host_copy(pvr2, fb_idx);
+
+    /*
+     * the writes to texture memory below come from the host copy, so they
+     * must not be mistaken for guest writes.
+     */
+    pvr2->fb.syncing = true;
     switch (fb->flags.fmt) {
     case FB_PIX_FMT_RGB_555:
-        fb_sync_from_host_0555_krgb(pvr2, fb);
+        fb_sync_from_host_0555_krgb(pvr2, fb, sync_pages);
         break;
     case FB_PIX_FMT_RGB_565:
-        fb_sync_from_host_0565_krgb(pvr2, fb);
+        fb_sync_from_host_0565_krgb(pvr2, fb, sync_pages);
         break;
     case FB_PIX_FMT_0RGB_0888:
-        fb_sync_from_host_rgb0888(pvr2, fb);
+        fb_sync_from_host_rgb0888(pvr2, fb, sync_pages);
         break;
     case FB_PIX_FMT_ARGB_8888:
-        fb_sync_from_host_argb8888(pvr2, fb);
+        fb_sync_from_host_argb8888(pvr2, fb, sync_pages);
         break;
     case FB_PIX_FMT_ARGB_1555:
-        fb_sync_from_host_1555_argb(pvr2, fb);
+        fb_sync_from_host_1555_argb(pvr2, fb, sync_pages);
         break;
     default:
+        pvr2->fb.syncing = false;
         LOG_ERROR("fb->flags.fmt is %d\n", fb->flags.fmt);
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
+    pvr2->fb.syncing = false;
 }
 
 static uint32_t get_tex_mem_offs(addr32_t addr) {
@@ -1146,8 +1406,6 @@ static uint32_t get_tex_mem_offs(addr32_t addr) {
     }
 }
 
-#define TEX_MIRROR_MASK 0x7fffff
-
 static void copy_to_tex_mem(struct pvr2 *pvr2, void const *in,
                             addr32_t offs, size_t len) {
     addr32_t last_byte = offs - 1 + len;
@@ -1209,12 +1467,13 @@ pick_fb(struct pvr2 *pvr2, unsigned width, unsigned height, uint32_t addr) {
         }
 
         // sync the framebuffer to memory because it's about to get overwritten
-        struct framebuffer *fb = fb_heap + idx;
-        sync_fb_to_tex_mem(pvr2, fb);
-        fb_reset(fb);
+        sync_fb_to_tex_mem(pvr2, idx, NULL);
     }
 
     fb_reset(fb_heap + idx);
+    if (pvr2->fb.ogl_fb_owner == idx)
+        pvr2->fb.ogl_fb_owner = -1;
+    fb_update_global_pages(pvr2);
     return idx;
 }
 
@@ -1382,6 +1641,18 @@ int framebuffer_set_render_target(struct pvr2 *pvr2) {
     fb->y_clip_min = get_fb_y_clip_min(pvr2);
     fb->y_clip_max = get_fb_y_clip_max(pvr2);
 
+    /*
+     * Everything this framebuffer covers is about to be rendered on the host.
+     * None of it gets copied back into texture memory until something needs
+     * it.
+     */
+    fb_set_footprint(fb);
+    memcpy(fb->host_dirty, fb->footprint, sizeof(fb->host_dirty));
+    memset(fb->guest_dirty, 0, sizeof(fb->guest_dirty));
+    if (pvr2->fb.ogl_fb_owner == idx)
+        pvr2->fb.ogl_fb_owner = -1;
+    fb_update_global_pages(pvr2);
+
     /*
      * It's safe to re-bind an object that is already bound as a render target
      * without first unbinding it.
@@ -1394,6 +1665,23 @@ int framebuffer_set_render_target(struct pvr2 *pvr2) {
     return fb_heap[idx].obj_handle;
 }
 
+bool framebuffer_render_target_is_display_only(struct pvr2 *pvr2) {
+    uint32_t addr_key = get_fb_w_sof1(pvr2) & ~3;
+    bool found = false;
+    unsigned idx;
+
+    for (idx = 0; idx < FB_HEAP_SIZE; idx++) {
+        struct framebuffer const *fb = pvr2->fb.fb_heap + idx;
+        if (fb->flags.state == FB_STATE_INVALID || fb->addr_key != addr_key)
+            continue;
+        if (!fb->flags.displayed || fb->flags.read_back)
+            return false;
+        found = true;
+    }
+
+    return found;
+}
+
 void framebuffer_get_render_target_dims(struct pvr2 *pvr2, int tgt,
                                         unsigned *width, unsigned *height) {
     struct framebuffer *fb = pvr2->fb.fb_heap + tgt;
@@ -1401,25 +1689,17 @@ void framebuffer_get_render_target_dims(struct pvr2 *pvr2, int tgt,
     *height = fb->fb_read_height;
 }
 
-static inline bool check_overlap(uint32_t range1_start, uint32_t range1_end,
-                                 uint32_t range2_start, uint32_t range2_end) {
-    if ((range1_start >= range2_start) && (range1_start <= range2_end))
-        return true;
-    if ((range1_end >= range2_start) && (range1_end <= range2_end))
-        return true;
-    if ((range2_start >= range1_start) && (range2_start <= range1_end))
-        return true;
-    if ((range2_end >= range1_start) && (range2_end <= range1_end))
-        return true;
-    return false;
-}
-
 void pvr2_framebuffer_notify_write(struct pvr2 *pvr2, uint32_t addr_32bit,
                                    unsigned n_bytes) {
-    uint32_t first_byte = addr_32bit;
-    uint32_t last_byte = n_bytes - 1 + first_byte;
+    if (pvr2->fb.syncing ||
+        !pvr2_fb_page_range_test(pvr2->fb.footprint, addr_32bit, n_bytes))
+        return;
 
-    unsigned fb_idx;
+    uint32_t pages[PVR2_FB_PAGE_WORDS];
+    memset(pages, 0, sizeof(pages));
+    fb_page_set_range(pages, addr_32bit, addr_32bit + n_bytes - 1);
+
+    unsigned fb_idx, word;
     struct framebuffer *fb_heap = pvr2->fb.fb_heap;
     for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
         /*
@@ -1431,62 +1711,49 @@ void pvr2_framebuffer_notify_write(struct pvr2 *pvr2, uint32_t addr_32bit,
          * in mind.
          */
         struct framebuffer *fb = fb_heap + fb_idx;
-        if ((fb->flags.state & FB_STATE_GFX) &&
-            (check_overlap(first_byte, last_byte,
-                          fb->addr_first[0],
-                          fb->addr_last[0]) ||
-            check_overlap(first_byte, last_byte,
-                          fb->addr_first[1],
-                          fb->addr_last[1]))) {
-            fb->flags.state = FB_STATE_VIRT;
-        }
-    }
-}
-
-void pvr2_framebuffer_notify_texture(struct pvr2 *pvr2, uint32_t first_tex_addr,
-                                     uint32_t last_tex_addr) {
-    first_tex_addr &= TEX_MIRROR_MASK;
-    last_tex_addr &= TEX_MIRROR_MASK;
-
-    int sync_count = 0;
-    unsigned fb_idx;
-    struct framebuffer *fb_heap = pvr2->fb.fb_heap;
-    for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
-        if (fb_heap[fb_idx].flags.state != FB_STATE_GFX)
+        if (fb->flags.state == FB_STATE_INVALID ||
+            !pvr2_fb_page_range_test(fb->footprint, addr_32bit, n_bytes))
             continue;
 
-        uint32_t const *addr_first = fb_heap[fb_idx].addr_first;
-        uint32_t const *addr_last = fb_heap[fb_idx].addr_last;
-
-        uint32_t addr_first_total[2] = {
-            addr_first[0] + ADDR_TEX32_FIRST,
-            addr_first[1] + ADDR_TEX32_FIRST
-        };
+        /*
+         * the write will only cover part of the page, so the rest of it needs
+         * to be in texture memory before it happens.
+         */
+        sync_fb_to_tex_mem(pvr2, fb_idx, pages);
 
-        uint32_t addr_last_total[2] = {
-            addr_last[0] + ADDR_TEX32_FIRST,
-            addr_last[1] + ADDR_TEX32_FIRST
-        };
+        for (word = 0; word < PVR2_FB_PAGE_WORDS; word++)
+            fb->guest_dirty[word] |= pages[word] & fb->footprint[word];
+    }
+}
 
-        uint32_t offs =  get_tex_mem_offs(addr_first_total[0]);
+void pvr2_framebuffer_notify_read(struct pvr2 *pvr2, uint32_t addr_32bit,
+                                  unsigned n_bytes) {
+    if (pvr2->fb.syncing ||
+        !pvr2_fb_page_range_test(pvr2->fb.host_dirty, addr_32bit, n_bytes))
+        return;
 
-        if (get_tex_mem_offs(addr_first_total[1]) != offs ||
-            get_tex_mem_offs(addr_last_total[0]) != offs ||
-            get_tex_mem_offs(addr_last_total[1]) != offs) {
-            error_set_feature("framebuffers that span the 32-bit and 64-bit "
-                              "texture memory areas");
-        }
+    uint32_t pages[PVR2_FB_PAGE_WORDS];
+    memset(pages, 0, sizeof(pages));
+    fb_page_set_range(pages, addr_32bit, addr_32bit + n_bytes - 1);
 
-        if (offs != ADDR_TEX64_FIRST)
-            continue;
+    unsigned fb_idx;
+    for (fb_idx = 0; fb_idx < FB_HEAP_SIZE; fb_idx++) {
+        struct framebuffer *fb = pvr2->fb.fb_heap + fb_idx;
+        if (fb->flags.state != FB_STATE_INVALID &&
+            pvr2_fb_page_range_test(fb->host_dirty, addr_32bit, n_bytes))
+            fb->flags.read_back = true;
+        sync_fb_to_tex_mem(pvr2, fb_idx, pages);
+    }
+}
 
-        if (check_overlap(first_tex_addr, last_tex_addr,
-                          addr_first[0] & TEX_MIRROR_MASK, addr_last[0] & TEX_MIRROR_MASK) ||
-            check_overlap(first_tex_addr, last_tex_addr,
-                          addr_first[1] & TEX_MIRROR_MASK, addr_last[1] & TEX_MIRROR_MASK)) {
-            sync_fb_to_tex_mem(pvr2, fb_heap + fb_idx);
-            fb_heap[fb_idx].flags.state = FB_STATE_VIRT_AND_GFX;
-            sync_count++;
-        }
+void pvr2_framebuffer_notify_texture(struct pvr2 *pvr2, uint32_t first_tex_addr,
+                                     uint32_t last_tex_addr) {
+    uint32_t phys_first[2], phys_last[2];
+    unsigned n_ranges = tex_phys_ranges(first_tex_addr, last_tex_addr,
+                                        phys_first, phys_last);
+    unsigned range;
+    for (range = 0; range < n_ranges; range++) {
+        pvr2_framebuffer_notify_read(pvr2, phys_first[range],
+                                     phys_last[range] - phys_first[range] + 1);
     }
 }
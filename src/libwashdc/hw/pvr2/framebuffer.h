@@ -24,6 +24,9 @@
 #define PVR2_FRAMEBUFFER_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "mem_areas.h"
 
 struct pvr2;
 
@@ -75,21 +78,43 @@ enum FramebufferFormat {
  *    what has been rendered.  We will then render the DC framebuffer to the
  *    screen as a textured quad that encompasses the entire screen.
  *
- * This algorithm is not particularly high-performance (especially since we
- * always copy the OpenGL color buffer to framebuffer regardless of whether
- * it's necessary), but it is realatively simple and it avoids the need for
- * some sort of special case in the final output stage.  Right now, performance
- * takes a backseat to basic functionality.
+ * Copying between the OpenGL color buffer and texture memory is tracked in
+ * pages of PVR2_FB_PAGE_SIZE bytes.  After a render every page the
+ * framebuffer covers is marked as host-dirty, and a page only gets copied
+ * back into texture memory when something actually reads it (or writes to
+ * part of it).  Guest writes mark pages as guest-dirty, and only those pages
+ * get converted again the next time the framebuffer is sent to the host.
  *
  * The FB_R_CTRL and FB_R_SOF1/FB_R_SOF2 registers control settings for the
  * framebuffer->CRT transfer; the FB_W_CTRL and FB_W_SOF1/FB_W_SOF2 registers
  * control settings for the PVR2->framebuffer transfer.
  */
 
+/*
+ * granularity of the dirty-tracking between host framebuffers and texture
+ * memory.  Pages are indexed by their offset into the 32-bit texture memory
+ * area, so a framebuffer which is accessed through the 64-bit area will be
+ * spread out across pages in both banks.
+ */
+#define PVR2_FB_PAGE_SHIFT 12
+#define PVR2_FB_PAGE_SIZE (1 << PVR2_FB_PAGE_SHIFT)
+#define PVR2_FB_N_PAGES \
+    ((ADDR_TEX32_LAST - ADDR_TEX32_FIRST + 1) >> PVR2_FB_PAGE_SHIFT)
+#define PVR2_FB_PAGE_WORDS (PVR2_FB_N_PAGES / 32)
+
 struct fb_flags {
     uint8_t state : 2;
     uint8_t fmt : 3;
     uint8_t vert_flip : 1;
+
+    // set once framebuffer_render has sent this framebuffer to the screen
+    uint8_t displayed : 1;
+
+    /*
+     * set once the guest has read pages of this framebuffer that were
+     * rendered on the host, either directly or by using it as a texture.
+     */
+    uint8_t read_back : 1;
 };
 
 #define FB_HEAP_SIZE 8
@@ -110,6 +135,21 @@ struct framebuffer {
         y_clip_min, y_clip_max;
 
     struct fb_flags flags;
+
+    // every page of texture memory which this framebuffer occupies
+    uint32_t footprint[PVR2_FB_PAGE_WORDS];
+
+    /*
+     * pages which have been rendered to on the host but not yet copied back
+     * into texture memory.
+     */
+    uint32_t host_dirty[PVR2_FB_PAGE_WORDS];
+
+    /*
+     * pages which the guest has written to since the last time the host copy
+     * was updated.
+     */
+    uint32_t guest_dirty[PVR2_FB_PAGE_WORDS];
 };
 
 #define OGL_FB_W_MAX (0x3ff + 1)
@@ -120,24 +160,63 @@ struct pvr2_fb {
     uint8_t ogl_fb[OGL_FB_BYTES];
     struct framebuffer fb_heap[FB_HEAP_SIZE];
     unsigned stamp;
+
+    // index of the framebuffer whose host copy is currently in ogl_fb, or -1
+    int ogl_fb_owner;
+
+    // set while a framebuffer is being copied back into texture memory
+    bool syncing;
+
+    /*
+     * union of the footprint and host_dirty bitmaps of every framebuffer in
+     * fb_heap.  These get checked on every texture memory access, so they
+     * need to be cheap.
+     */
+    uint32_t footprint[PVR2_FB_PAGE_WORDS];
+    uint32_t host_dirty[PVR2_FB_PAGE_WORDS];
 };
 
+static inline bool
+pvr2_fb_page_range_test(uint32_t const *pages, uint32_t addr_32bit,
+                        unsigned n_bytes) {
+    unsigned page = addr_32bit >> PVR2_FB_PAGE_SHIFT;
+    unsigned last_page = (addr_32bit + n_bytes - 1) >> PVR2_FB_PAGE_SHIFT;
+
+    if (last_page >= PVR2_FB_N_PAGES)
+        last_page = PVR2_FB_N_PAGES - 1;
+
+    for (; page <= last_page; page++)
+        if (pages[page / 32] & (1u << (page % 32)))
+            return true;
+    return false;
+}
+
 void pvr2_framebuffer_init(struct pvr2 *pvr2);
 void pvr2_framebuffer_cleanup(struct pvr2 *pvr2);
 
 void framebuffer_render(struct pvr2 *pvr2);
 
-// old deprecated function that should not be called anymore
-static inline void framebuffer_sync_from_host_maybe(void) {
-}
-
 int framebuffer_set_render_target(struct pvr2 *pvr2);
 
+/*
+ * true if the framebuffer that the next STARTRENDER would draw into has been
+ * displayed before and the guest has never read it back.  Turbo mode only
+ * drops renders into framebuffers like that, because nothing but the screen
+ * ever sees them.
+ */
+bool framebuffer_render_target_is_display_only(struct pvr2 *pvr2);
+
 void framebuffer_get_render_target_dims(struct pvr2 *pvr2, int tgt,
                                         unsigned *width, unsigned *height);
 
+/*
+ * addr is an offset into the 32-bit texture memory area.  These should be
+ * called before the access happens.
+ */
 void pvr2_framebuffer_notify_write(struct pvr2 *pvr2, uint32_t addr,
                                    unsigned n_bytes);
+void pvr2_framebuffer_notify_read(struct pvr2 *pvr2, uint32_t addr,
+                                  unsigned n_bytes);
 
 void pvr2_framebuffer_notify_texture(struct pvr2 *pvr2, uint32_t first_tex_addr,
                                      uint32_t last_tex_addr);
@@ -45,6 +45,8 @@
 #include "pvr2.h"
 #include "pvr2_reg.h"
 #include "intmath.h"
+#include "trace.h"
+#include "bench.h"
 
 #include "pvr2_ta.h"
 
@@ -220,7 +222,11 @@ static void pvr2_trans_complete_int_event_handler(struct SchedEvent *event);
 static void pvr2_trans_mod_complete_int_event_handler(struct SchedEvent *event);
 static void pvr2_pt_complete_int_event_handler(struct SchedEvent *event);
 
-#define PVR2_TA_VERT_BUF_LEN (1024 * 1024)
+/*
+ * initial length of the vertex buffer.  It will grow past this if a frame
+ * needs more vertices than this.
+ */
+#define PVR2_TA_VERT_BUF_INIT_LEN (64 * 1024)
 
 #define PVR2_GFX_IL_INST_BUF_LEN (1024 * 256)
 
@@ -272,10 +278,12 @@ void pvr2_ta_init(struct pvr2 *pvr2) {
     ta->pvr2_trans_mod_complete_int_event.arg_ptr = pvr2;
     ta->pvr2_pt_complete_int_event.arg_ptr = pvr2;
 
-    pvr2->ta.pvr2_ta_vert_buf = (float*)malloc(PVR2_TA_VERT_BUF_LEN *
-                                               sizeof(float) * GFX_VERT_LEN);
-    if (!pvr2->ta.pvr2_ta_vert_buf)
+    ta->pvr2_ta_vert_buf =
+        (struct gfx_vert*)malloc(PVR2_TA_VERT_BUF_INIT_LEN *
+                                 sizeof(struct gfx_vert));
+    if (!ta->pvr2_ta_vert_buf)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
+    ta->pvr2_ta_vert_buf_len = PVR2_TA_VERT_BUF_INIT_LEN;
     ta->gfx_il_inst_buf = (struct gfx_il_inst_chain*)malloc(PVR2_GFX_IL_INST_BUF_LEN *
                                                         sizeof(struct gfx_il_inst_chain));
     if (!ta->gfx_il_inst_buf)
@@ -283,6 +291,7 @@ void pvr2_ta_init(struct pvr2 *pvr2) {
 
     pvr2->ta.pvr2_ta_vert_buf_count = 0;
     pvr2->ta.pvr2_ta_vert_cur_group = 0;
+    pvr2->ta.skip_render = false;
 
     render_frame_init(pvr2);
 }
@@ -291,33 +300,55 @@ void pvr2_ta_cleanup(struct pvr2 *pvr2) {
     free(pvr2->ta.gfx_il_inst_buf);
     free(pvr2->ta.pvr2_ta_vert_buf);
     pvr2->ta.pvr2_ta_vert_buf = NULL;
+    pvr2->ta.pvr2_ta_vert_buf_len = 0;
     pvr2->ta.pvr2_ta_vert_buf_count = 0;
     pvr2->ta.pvr2_ta_vert_cur_group = 0;
 }
 
+// convert a color component from [0.0, 1.0] to [0, 255]
+static inline uint8_t pvr2_ta_pack_color(float val) {
+    if (!(val > 0.0f))
+        return 0;
+    else if (val >= 1.0f)
+        return 255;
+    return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+static void pvr2_ta_grow_vert_buf(struct pvr2_ta *ta) {
+    unsigned new_len = ta->pvr2_ta_vert_buf_len * 2;
+    struct gfx_vert *new_buf =
+        (struct gfx_vert*)realloc(ta->pvr2_ta_vert_buf,
+                                  new_len * sizeof(struct gfx_vert));
+    if (!new_buf)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    PVR2_TRACE("vertex buffer length increased to %u\n", new_len);
+
+    ta->pvr2_ta_vert_buf = new_buf;
+    ta->pvr2_ta_vert_buf_len = new_len;
+}
+
 static inline void pvr2_ta_push_vert(struct pvr2 *pvr2, struct pvr2_ta_vert vert) {
     struct pvr2_ta *ta = &pvr2->ta;
-    if (ta->pvr2_ta_vert_buf_count >= PVR2_TA_VERT_BUF_LEN) {
-        LOG_WARN("PVR2 TA vertex buffer overflow\n");
-        return;
-    }
+    if (ta->pvr2_ta_vert_buf_count >= ta->pvr2_ta_vert_buf_len)
+        pvr2_ta_grow_vert_buf(ta);
 
-    float *outp = ta->pvr2_ta_vert_buf +
-        GFX_VERT_LEN * ta->pvr2_ta_vert_buf_count++;
+    struct gfx_vert *outp =
+        ta->pvr2_ta_vert_buf + ta->pvr2_ta_vert_buf_count++;
     PVR2_TRACE("vert_buf_count is now %u\n", ta->pvr2_ta_vert_buf_count);
-    outp[GFX_VERT_POS_OFFSET + 0] = vert.pos[0];
-    outp[GFX_VERT_POS_OFFSET + 1] = vert.pos[1];
-    outp[GFX_VERT_POS_OFFSET + 2] = vert.pos[2];
-    outp[GFX_VERT_BASE_COLOR_OFFSET + 0] = vert.base_color[0];
-    outp[GFX_VERT_BASE_COLOR_OFFSET + 1] = vert.base_color[1];
-    outp[GFX_VERT_BASE_COLOR_OFFSET + 2] = vert.base_color[2];
-    outp[GFX_VERT_BASE_COLOR_OFFSET + 3] = vert.base_color[3];
-    outp[GFX_VERT_OFFS_COLOR_OFFSET + 0] = vert.offs_color[0];
-    outp[GFX_VERT_OFFS_COLOR_OFFSET + 1] = vert.offs_color[1];
-    outp[GFX_VERT_OFFS_COLOR_OFFSET + 2] = vert.offs_color[2];
-    outp[GFX_VERT_OFFS_COLOR_OFFSET + 3] = vert.offs_color[3];
-    outp[GFX_VERT_TEX_COORD_OFFSET + 0] = vert.tex_coord[0];
-    outp[GFX_VERT_TEX_COORD_OFFSET + 1] = vert.tex_coord[1];
+    outp->pos[0] = vert.pos[0];
+    outp->pos[1] = vert.pos[1];
+    outp->pos[2] = vert.pos[2];
+    outp->base_color[0] = pvr2_ta_pack_color(vert.base_color[0]);
+    outp->base_color[1] = pvr2_ta_pack_color(vert.base_color[1]);
+    outp->base_color[2] = pvr2_ta_pack_color(vert.base_color[2]);
+    outp->base_color[3] = pvr2_ta_pack_color(vert.base_color[3]);
+    outp->offs_color[0] = pvr2_ta_pack_color(vert.offs_color[0]);
+    outp->offs_color[1] = pvr2_ta_pack_color(vert.offs_color[1]);
+    outp->offs_color[2] = pvr2_ta_pack_color(vert.offs_color[2]);
+    outp->offs_color[3] = pvr2_ta_pack_color(vert.offs_color[3]);
+    outp->tex_coord[0] = vert.tex_coord[0];
+    outp->tex_coord[1] = vert.tex_coord[1];
 }
 
 static inline void
@@ -583,6 +614,8 @@ on_pkt_end_of_list_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
         return;
     }
 
+    TRACE_TA(TRACE_TA_LIST_END, ta->cur_poly_type);
+
     struct dc_clock *clk = pvr2->clk;
     dc_cycle_stamp_t int_when =
         clock_cycle_stamp(clk) + PVR2_LIST_COMPLETE_INT_DELAY;
@@ -1513,6 +1546,10 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
     struct pvr2_ta *ta = &pvr2->ta;
     struct gfx_il_inst cmd;
 
+    bench_push(BENCH_CAT_RENDER);
+
+    TRACE_TA(TRACE_TA_STARTRENDER, pvr2->reg_backing[PVR2_PARAM_BASE]);
+
     unsigned tile_w = get_glob_tile_clip_x(pvr2) << 5;
     unsigned tile_h = get_glob_tile_clip_y(pvr2) << 5;
     unsigned x_clip_min = get_fb_x_clip_min(pvr2);
@@ -1569,7 +1606,20 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
     /* uint32_t backgnd_depth_as_int = get_isp_backgnd_d(); */
     /* memcpy(&geo->bgdepth, &backgnd_depth_as_int, sizeof(float)); */
 
+    /*
+     * Renders into a framebuffer that only the screen ever sees can be
+     * dropped when turbo mode asks for it.  Render-to-texture targets and
+     * framebuffers the guest reads back always get rendered, so turbo mode
+     * doesn't change what the guest sees.  Textures that don't get
+     * transmitted stay dirty in the cache, so they'll be picked up by the next
+     * frame that actually gets rendered.
+     */
+    if (ta->skip_render && framebuffer_render_target_is_display_only(pvr2))
+        goto skip_render;
+
+    bench_push(BENCH_CAT_TEX_UPLOAD);
     pvr2_tex_cache_xmit(pvr2);
+    bench_pop();
 
     if (ta->cur_poly_type != PVR2_POLY_TYPE_NONE)
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
@@ -1626,6 +1676,16 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
     cmd.arg.set_clip_range.clip_max = ta->clip_max;
     rend_exec_il(&cmd, 1);
 
+    /*
+     * hand the whole vertex buffer to the renderer at once.  The
+     * GFX_IL_DRAW_ARRAY commands only refer to ranges within it, so the
+     * vertices never get copied between here and the renderer's upload.
+     */
+    cmd.op = GFX_IL_SET_VERT_ARRAY;
+    cmd.arg.set_vert_array.verts = ta->pvr2_ta_vert_buf;
+    cmd.arg.set_vert_array.n_verts = ta->pvr2_ta_vert_buf_count;
+    rend_exec_il(&cmd, 1);
+
     // initial rendering settings
     cmd.op = GFX_IL_CLEAR;
     cmd.arg.clear.bgcolor[0] = ta->pvr2_bgcolor[0];
@@ -1665,6 +1725,7 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
     cmd.arg.end_rend.rend_tgt_obj = tgt;
     rend_exec_il(&cmd, 1);
 
+skip_render:
     ta->next_frame_stamp++;
     render_frame_init(pvr2);
 
@@ -1675,6 +1736,8 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
             PVR2_RENDER_COMPLETE_INT_DELAY;
         sched_event(clk, &ta->pvr2_render_complete_int_event);
     }
+
+    bench_pop();
 }
 
 void pvr2_ta_reinit(struct pvr2 *pvr2) {
@@ -1776,9 +1839,8 @@ static void finish_poly_group(struct pvr2 *pvr2, enum pvr2_poly_type poly_type)
     pvr2->stat.per_frame_counters.poly_count[poly_type] += n_verts / 3;
 
     cmd.op = GFX_IL_DRAW_ARRAY;
+    cmd.arg.draw_array.first_vert = ta->pvr2_ta_vert_cur_group;
     cmd.arg.draw_array.n_verts = n_verts;
-    cmd.arg.draw_array.verts =
-        ta->pvr2_ta_vert_buf + ta->pvr2_ta_vert_cur_group * GFX_VERT_LEN;
     pvr2_ta_push_gfx_il(pvr2, cmd);
 
     ta->pvr2_ta_vert_cur_group = ta->pvr2_ta_vert_buf_count;
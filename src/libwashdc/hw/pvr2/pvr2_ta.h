@@ -319,7 +319,8 @@ struct pvr2_ta {
 
     bool open_group;
 
-    float *pvr2_ta_vert_buf;
+    struct gfx_vert *pvr2_ta_vert_buf;
+    unsigned pvr2_ta_vert_buf_len; // allocated length, in vertices
     unsigned pvr2_ta_vert_buf_count;
     unsigned pvr2_ta_vert_cur_group;
 
@@ -339,6 +340,15 @@ struct pvr2_ta {
 
     unsigned next_frame_stamp;
 
+    /*
+     * when this is set, STARTRENDERs into framebuffers that are only ever
+     * displayed (see framebuffer_render_target_is_display_only) still do all
+     * of their bookkeeping and raise the usual interrupts, but nothing gets
+     * sent to the renderer.  Turbo mode uses this on frames that won't be
+     * presented.
+     */
+    bool skip_render;
+
     /*
      * the intensity mode base and offset colors.  These should be referenced
      * instead of the copies held in hdr because hdr's version of these gets
@@ -37,6 +37,7 @@
 #include "gfx/gfx_tex_cache.h"
 #include "dreamcast.h"
 #include "pvr2_reg.h"
+#include "washdc/config_file.h"
 
 #include "pvr2_tex_cache.h"
 
@@ -60,7 +61,15 @@ unsigned static const pixel_sizes[TEX_CTRL_PIX_FMT_COUNT] = {
     [TEX_CTRL_PIX_FMT_INVALID]   = 0
 };
 
-// byte offsets for mipmaps for 4bpp and 8bpp paletted textures
+/*
+ * byte offsets for mipmaps for 4bpp paletted textures.  The 1x1 level is only
+ * half a byte, it lives in the upper nibble of byte 1.
+ */
+static unsigned const mipmap_byte_offset_pal4[11] = {
+    0x1, 0x2, 0x4, 0xc, 0x2c, 0xac, 0x2ac, 0xaac, 0x2aac, 0xaaac, 0x2aaac
+};
+
+// byte offsets for mipmaps for 8bpp paletted textures
 static unsigned const mipmap_byte_offset_palette[11] = {
     0x3, 0x4, 0x8, 0x18, 0x58, 0x158, 0x558, 0x1558, 0x5558, 0x15558, 0x55558
 };
@@ -82,6 +91,9 @@ static bool pvr2_tex_valid(enum pvr2_tex_state state) {
 static unsigned tex_twiddle(unsigned x, unsigned y,
                             unsigned w_shift, unsigned h_shift);
 
+static uint32_t
+pvr2_tex_mipmap_offset(struct pvr2_tex_meta const *meta, unsigned side_shift);
+
 static enum gfx_tex_fmt
 translate_palette_to_pix_format(enum palette_tp palette_tp);
 
@@ -154,11 +166,22 @@ void pvr2_tex_cache_init(struct pvr2 *pvr2) {
     }
 
     memset(cache->page_stamps, 0, sizeof(cache->page_stamps));
+    memset(cache->pal_bank_stamps, 0, sizeof(cache->pal_bank_stamps));
+
+    int n_threads;
+    if (cfg_get_int("gfx.rend.tex-decode-threads", &n_threads) != 0 ||
+        n_threads < 0) {
+        n_threads = PVR2_TEX_DECODE_THREADS_DEFAULT;
+    }
+    cache->pool = pvr2_tex_pool_create(n_threads);
 }
 
 void pvr2_tex_cache_cleanup(struct pvr2 *pvr2) {
     struct pvr2_tex_cache *cache = &pvr2->tex_cache;
 
+    pvr2_tex_pool_destroy(cache->pool);
+    cache->pool = NULL;
+
     unsigned idx;
     for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++)
         if (cache->tex_cache[idx].obj_no >= 0)
@@ -363,32 +386,15 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
             tex->meta.addr_last = addr - 1 + pixel_sizes[tex_fmt] *
                 linestride * (1 << h_shift);
         }
-        if (tex->meta.mipmap) {
-            if (tex->meta.w_shift != tex->meta.h_shift) {
-                error_set_feature("proper response for attempt to enable "
-                                  "mipmaps on a rectangular texture");
-                RAISE_ERROR(ERROR_UNIMPLEMENTED);
-            }
-            if (tex->meta.vq_compression) {
-                tex->meta.addr_last += mipmap_byte_offset_vq[w_shift];
-            } else {
-                switch (tex->meta.tex_fmt) {
-                case TEX_CTRL_PIX_FMT_ARGB_1555:
-                case TEX_CTRL_PIX_FMT_RGB_565:
-                case TEX_CTRL_PIX_FMT_YUV_422:
-                case TEX_CTRL_PIX_FMT_ARGB_4444:
-                    tex->meta.addr_last += mipmap_byte_offset_norm[w_shift];
-                    break;
-                case TEX_CTRL_PIX_FMT_4_BPP_PAL:
-                case TEX_CTRL_PIX_FMT_8_BPP_PAL:
-                    tex->meta.addr_last += mipmap_byte_offset_palette[w_shift];
-                    break;
-                default:
-                case TEX_CTRL_PIX_FMT_BUMP_MAP:
-                    RAISE_ERROR(ERROR_UNIMPLEMENTED);
-                }
-            }
+    }
+
+    if (tex->meta.mipmap) {
+        if (tex->meta.w_shift != tex->meta.h_shift) {
+            error_set_feature("proper response for attempt to enable "
+                              "mipmaps on a rectangular texture");
+            RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
+        tex->meta.addr_last += pvr2_tex_mipmap_offset(&tex->meta, w_shift);
     }
 
     tex->state = PVR2_TEX_DIRTY;
@@ -428,13 +434,29 @@ void
 pvr2_tex_cache_notify_palette_write(struct pvr2 *pvr2,
                                     uint32_t addr_first, uint32_t len) {
     /*
-     * TODO: all paletted textures will be invalidated whenever there is a
-     * write to the PVR2's palette memory.  Obviously this is suboptimal
-     * compared to only invalidating the textures that reference the part of
-     * palette memory which is being written to, but I'm keeping it this way
-     * for now because it is simpler.
+     * Only the banks that are written to get new timestamps; paletted textures
+     * which reference those banks will be picked up by pvr2_tex_cache_xmit
+     * the next time it runs.
      */
-    pvr2_tex_cache_notify_palette_tp_change(pvr2);
+    unsigned entry_first = (addr_first - PVR2_PALETTE_RAM_FIRST) / 4;
+    unsigned entry_last = (addr_first + (len - 1) - PVR2_PALETTE_RAM_FIRST) / 4;
+    unsigned bank_first = entry_first / PVR2_PAL_BANK_LEN;
+    unsigned bank_last = entry_last / PVR2_PAL_BANK_LEN;
+
+#ifdef INVARIANTS
+    if (addr_first < PVR2_PALETTE_RAM_FIRST || bank_last >= PVR2_PAL_N_BANKS) {
+        error_set_address(addr_first);
+        error_set_length(len);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+#endif
+
+    dc_cycle_stamp_t time = clock_cycle_stamp(pvr2->clk);
+    dc_cycle_stamp_t *bank_stamps = pvr2->tex_cache.pal_bank_stamps;
+
+    unsigned bank_no;
+    for (bank_no = bank_first; bank_no <= bank_last; bank_no++)
+        bank_stamps[bank_no] = time;
 }
 
 void pvr2_tex_cache_notify_palette_tp_change(struct pvr2 *pvr2) {
@@ -452,14 +474,84 @@ void pvr2_tex_cache_notify_palette_tp_change(struct pvr2 *pvr2) {
 }
 
 /*
- * de-twiddle src into dst.  Both src and dst must be preallocated buffers with
- * a length of (1 << tex_w_shift) * (1 << tex_h_shift) * bytes_per_pix.
+ * A copy of everything needed to decode a texture.  The decoder only ever
+ * reads from this, so textures can be decoded off of the emulation thread
+ * while the emulator's own texture memory keeps changing.
  */
-static void pvr2_tex_detwiddle(struct pvr2 *pvr2, void *dst,
+struct pvr2_tex_src {
+    // copy of 64-bit texture memory from meta.addr_first to meta.addr_last
+    uint8_t *tex_mem;
+    uint32_t tex_mem_first;
+    size_t tex_mem_len;
+
+    // copy of palette RAM, this is NULL for textures that aren't paletted
+    uint8_t *pal_ram;
+    enum palette_tp palette_tp;
+};
+
+static void pvr2_tex_src_init(struct pvr2 *pvr2, struct pvr2_tex_src *src,
+                              struct pvr2_tex_meta const *meta) {
+    src->tex_mem_first = meta->addr_first;
+    src->tex_mem_len = meta->addr_last - meta->addr_first + 1;
+    src->tex_mem = (uint8_t*)malloc(src->tex_mem_len);
+    if (!src->tex_mem)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    pvr2_tex_mem_64bit_read_raw(pvr2, src->tex_mem,
+                                src->tex_mem_first, src->tex_mem_len);
+
+    src->palette_tp = get_palette_tp(pvr2);
+    src->pal_ram = NULL;
+    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
+        meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
+        src->pal_ram = (uint8_t*)malloc(PVR2_PALETTE_RAM_LEN);
+        if (!src->pal_ram)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        memcpy(src->pal_ram, pvr2_get_palette_ram(pvr2),
+               PVR2_PALETTE_RAM_LEN);
+    }
+}
+
+static void pvr2_tex_src_cleanup(struct pvr2_tex_src *src) {
+    free(src->pal_ram);
+    free(src->tex_mem);
+    src->pal_ram = NULL;
+    src->tex_mem = NULL;
+}
+
+static inline uint8_t const *
+pvr2_tex_src_ptr(struct pvr2_tex_src const *src,
+                 uint32_t addr, unsigned n_bytes) {
+#ifdef INVARIANTS
+    if (addr < src->tex_mem_first ||
+        addr - src->tex_mem_first + n_bytes > src->tex_mem_len)
+        RAISE_ERROR(ERROR_INTEGRITY);
+#endif
+    return src->tex_mem + (addr - src->tex_mem_first);
+}
+
+static inline uint8_t
+pvr2_tex_src_read8(struct pvr2_tex_src const *src, uint32_t addr) {
+    return *pvr2_tex_src_ptr(src, addr, 1);
+}
+
+static inline uint16_t
+pvr2_tex_src_read16(struct pvr2_tex_src const *src, uint32_t addr) {
+    uint16_t ret;
+    memcpy(&ret, pvr2_tex_src_ptr(src, addr, sizeof(ret)), sizeof(ret));
+    return ret;
+}
+
+/*
+ * de-twiddle src into dst.  dst must be a preallocated buffer with a length
+ * of (1 << tex_w_shift) * (1 << tex_h_shift) * bytes_per_pix.
+ */
+static void pvr2_tex_detwiddle(struct pvr2_tex_src const *src, void *dst,
                                uint32_t src_addr, unsigned tex_w_shift,
                                unsigned tex_h_shift, unsigned bytes_per_pix) {
     uint8_t *dst8 = (uint8_t*)dst;
     unsigned tex_w = 1 << tex_w_shift, tex_h = 1 << tex_h_shift;
+    uint8_t const *src8 =
+        pvr2_tex_src_ptr(src, src_addr, tex_w * tex_h * bytes_per_pix);
     unsigned row, col;
     for (row = 0; row < tex_h; row++) {
         for (col = 0; col < tex_w; col++) {
@@ -470,10 +562,8 @@ static void pvr2_tex_detwiddle(struct pvr2 *pvr2, void *dst,
                 RAISE_ERROR(ERROR_INTEGRITY);
 #endif
 
-            pvr2_tex_mem_64bit_read_raw(pvr2, dst8 +
-                                        (row * tex_w + col) * bytes_per_pix,
-                                        src_addr + twid_idx * bytes_per_pix,
-                                        bytes_per_pix);
+            memcpy(dst8 + (row * tex_w + col) * bytes_per_pix,
+                   src8 + twid_idx * bytes_per_pix, bytes_per_pix);
         }
     }
 }
@@ -485,7 +575,8 @@ static void pvr2_tex_detwiddle(struct pvr2 *pvr2, void *dst,
  * two packed pixels.
  */
 static void
-pvr2_tex_detwiddle_4bpp(struct pvr2 *pvr2, void *dst, uint32_t src_addr,
+pvr2_tex_detwiddle_4bpp(struct pvr2_tex_src const *src, void *dst,
+                        uint32_t src_addr,
                         unsigned tex_w_shift, unsigned tex_h_shift) {
     uint8_t *dst8 = (uint8_t*)dst;
     unsigned tex_w = 1 << tex_w_shift, tex_h = 1 << tex_h_shift;
@@ -503,9 +594,9 @@ pvr2_tex_detwiddle_4bpp(struct pvr2 *pvr2, void *dst, uint32_t src_addr,
             uint8_t in_px;
             uint32_t byteaddr = src_addr + twid_idx / 2;
             if (twid_idx % 2 == 0)
-                in_px = pvr2_tex_mem_64bit_read8(pvr2, byteaddr) & 0xf;
+                in_px = pvr2_tex_src_read8(src, byteaddr) & 0xf;
             else
-                in_px = pvr2_tex_mem_64bit_read8(pvr2, byteaddr) >> 4;
+                in_px = pvr2_tex_src_read8(src, byteaddr) >> 4;
 
             if (dst_idx % 2 == 0) {
                 dst8[dst_idx / 2] &= ~0xf;
@@ -531,10 +622,23 @@ pvr2_tex_detwiddle_4bpp(struct pvr2 *pvr2, void *dst, uint32_t src_addr,
  * TEX_CTRL_PIX_FMT_ARGB_4444).
  */
 static void
-pvr2_tex_vq_decompress(struct pvr2 *pvr2, void *dst,
+pvr2_tex_vq_decompress(struct pvr2_tex_src const *src, void *dst,
                        unsigned code_book_addr, unsigned src_addr,
                        unsigned side_shift) {
     unsigned dst_side = 1 << side_shift;
+
+    if (!side_shift) {
+        /*
+         * the 1x1 level of a mipmap still gets an entire code book index; it
+         * uses the upper-left texel of that entry.
+         */
+        unsigned idx = pvr2_tex_src_read8(src, src_addr);
+        uint16_t color = pvr2_tex_src_read16(src, PVR2_CODE_BOOK_ENTRY_SIZE *
+                                             idx + code_book_addr);
+        memcpy(dst, &color, sizeof(color));
+        return;
+    }
+
     unsigned src_side_shift = side_shift - 1;
     unsigned src_side = 1 << src_side_shift;
     unsigned row, col;
@@ -546,13 +650,13 @@ pvr2_tex_vq_decompress(struct pvr2 *pvr2, void *dst,
                                             src_side_shift, src_side_shift);
 
             // code book index
-            unsigned idx = pvr2_tex_mem_64bit_read8(pvr2, twid_idx + src_addr);
+            unsigned idx = pvr2_tex_src_read8(src, twid_idx + src_addr);
             unsigned offs = PVR2_CODE_BOOK_ENTRY_SIZE * idx + code_book_addr;
             uint16_t color[4] = {
-                pvr2_tex_mem_64bit_read16(pvr2, offs),
-                pvr2_tex_mem_64bit_read16(pvr2, offs + 2),
-                pvr2_tex_mem_64bit_read16(pvr2, offs + 4),
-                pvr2_tex_mem_64bit_read16(pvr2, offs + 6)
+                pvr2_tex_src_read16(src, offs),
+                pvr2_tex_src_read16(src, offs + 2),
+                pvr2_tex_src_read16(src, offs + 4),
+                pvr2_tex_src_read16(src, offs + 6)
             };
 
             unsigned dst_row = row * 2, dst_col = col * 2;
@@ -568,49 +672,73 @@ pvr2_tex_vq_decompress(struct pvr2 *pvr2, void *dst,
     }
 }
 
-void pvr2_tex_cache_read(struct pvr2 *pvr2,
-                         void **tex_dat_out, size_t *n_bytes_out,
+/*
+ * returns the offset from the beginning of the texture (or from the end of
+ * the code-book for VQ textures) to the mipmap level whose sides are
+ * (1 << side_shift) texels long.
+ */
+static uint32_t
+pvr2_tex_mipmap_offset(struct pvr2_tex_meta const *meta, unsigned side_shift) {
+    if (meta->vq_compression)
+        return mipmap_byte_offset_vq[side_shift];
+
+    switch (meta->tex_fmt) {
+    case TEX_CTRL_PIX_FMT_ARGB_1555:
+    case TEX_CTRL_PIX_FMT_RGB_565:
+    case TEX_CTRL_PIX_FMT_YUV_422:
+    case TEX_CTRL_PIX_FMT_ARGB_4444:
+        return mipmap_byte_offset_norm[side_shift];
+    case TEX_CTRL_PIX_FMT_4_BPP_PAL:
+        return mipmap_byte_offset_pal4[side_shift];
+    case TEX_CTRL_PIX_FMT_8_BPP_PAL:
+        return mipmap_byte_offset_palette[side_shift];
+    default:
+        error_set_tex_fmt(meta->tex_fmt);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+}
+
+static unsigned pvr2_palette_pixel_size(enum palette_tp palette_tp) {
+    switch (palette_tp) {
+    case PALETTE_TP_ARGB_1555:
+    case PALETTE_TP_RGB_565:
+    case PALETTE_TP_ARGB_4444:
+        return 2;
+    case PALETTE_TP_ARGB_8888:
+        return 4;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+// number of bytes per pixel in the decoded texture
+static unsigned
+pvr2_tex_host_pixel_size(struct pvr2_tex_src const *src,
                          struct pvr2_tex_meta const *meta) {
-    unsigned tex_w = meta->linestride, tex_h = 1 << meta->h_shift;
+    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
+        meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL)
+        return pvr2_palette_pixel_size(src->palette_tp);
+
+    unsigned px_sz = pixel_sizes[meta->tex_fmt];
+    if (!px_sz) {
+        error_set_tex_fmt(meta->tex_fmt);
+        error_set_feature("some texture format");
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+    return px_sz;
+}
 
+/*
+ * raise an error if the given texture uses a combination of features which is
+ * not implemented.
+ */
+static void pvr2_tex_check_meta(struct pvr2_tex_meta const *meta) {
     // TODO: better error-handling
     if ((ADDR_TEX64_LAST - ADDR_TEX64_FIRST + 1) <=
         (meta->addr_last - meta->addr_first + 1)) {
         abort();
     }
 
-    size_t n_bytes;
-
-    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-        n_bytes = (tex_w * tex_h) / 2;
-    } else {
-        unsigned px_sz = pixel_sizes[meta->tex_fmt];
-        if (!px_sz) {
-            error_set_tex_fmt(meta->tex_fmt);
-            error_set_feature("some texture format");
-            RAISE_ERROR(ERROR_UNIMPLEMENTED);
-        }
-        n_bytes = tex_w * tex_h * px_sz;
-    }
-
-    uint8_t *tex_dat = NULL;
-    if (n_bytes)
-        tex_dat = (uint8_t*)malloc(n_bytes * sizeof(uint8_t));
-
-    if (!tex_dat)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-    unsigned beg_addr;
-    unsigned code_book_addr; // points to the code book if this is VQ
-
-    /*
-     * handle mipmaps.
-     *
-     * Currently they're not actually implemented, I just select the
-     * highest-order mipmap (which is the one at the end).  To
-     * accomplish this, we have to offset the addr_first by the offset
-     * to the highest-order mipmap.
-     */
     if (meta->mipmap) {
         if (meta->w_shift != meta->h_shift) {
             error_set_feature("proper response for attempting to "
@@ -623,41 +751,6 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
             error_set_feature("mipmapped YUV422 textures\n");
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
-
-        unsigned side_shift = meta->w_shift;
-
-        if (meta->vq_compression) {
-            code_book_addr = meta->addr_first;
-            beg_addr = code_book_addr + PVR2_CODE_BOOK_LEN +
-                mipmap_byte_offset_vq[side_shift];
-        } else {
-            switch (meta->tex_fmt) {
-            case TEX_CTRL_PIX_FMT_ARGB_1555:
-            case TEX_CTRL_PIX_FMT_RGB_565:
-            case TEX_CTRL_PIX_FMT_YUV_422:
-            case TEX_CTRL_PIX_FMT_ARGB_4444:
-                beg_addr =
-                    meta->addr_first + mipmap_byte_offset_norm[meta->w_shift];
-                break;
-            case TEX_CTRL_PIX_FMT_4_BPP_PAL:
-            case TEX_CTRL_PIX_FMT_8_BPP_PAL:
-                beg_addr =
-                    meta->addr_first + mipmap_byte_offset_palette[meta->w_shift];
-                break;
-            default:
-                RAISE_ERROR(ERROR_UNIMPLEMENTED);
-            }
-        }
-    } else {
-        /*
-         * mipmaps are disabled, tex_in->addr_first is actually the
-         * first byte of the texture.
-         */
-        beg_addr = meta->addr_first;
-        if (meta->vq_compression) {
-            code_book_addr = beg_addr;
-            beg_addr += PVR2_CODE_BOOK_LEN;
-        }
     }
 
     if (meta->vq_compression) {
@@ -690,104 +783,108 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
                               "VQ compression on a non-square texture");
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
+    }
+}
 
-        pvr2_tex_vq_decompress(pvr2, tex_dat, code_book_addr,
-                               beg_addr, meta->w_shift);
+/*
+ * decode a single level of a texture into dst.
+ *
+ * For mipmapped textures side_shift selects which level to decode; for
+ * textures without mipmaps it is ignored and the texture is decoded using
+ * the dimensions in meta.
+ *
+ * dst must have room for tex_w * tex_h pixels of pvr2_tex_host_pixel_size
+ * bytes each.  pal_scratch is only used for paletted textures, in which case
+ * it must have room for tex_w * tex_h bytes.
+ */
+static void pvr2_tex_decode_level(struct pvr2_tex_src const *src,
+                                  uint8_t *dst, uint8_t *pal_scratch,
+                                  struct pvr2_tex_meta const *meta,
+                                  unsigned side_shift) {
+    unsigned w_shift, h_shift, tex_w, tex_h;
+    uint32_t beg_addr = meta->addr_first;
+    uint32_t code_book_addr = 0; // points to the code book if this is VQ
+
+    if (meta->vq_compression) {
+        code_book_addr = beg_addr;
+        beg_addr += PVR2_CODE_BOOK_LEN;
+    }
+
+    if (meta->mipmap) {
+        /*
+         * The PVR2 stores mipmaps from smallest to largest, so every level
+         * is located at a fixed offset that only depends on its size.
+         */
+        w_shift = h_shift = side_shift;
+        tex_w = tex_h = 1 << side_shift;
+        beg_addr += pvr2_tex_mipmap_offset(meta, side_shift);
+    } else {
+        w_shift = meta->w_shift;
+        h_shift = meta->h_shift;
+        tex_w = meta->linestride;
+        tex_h = 1 << h_shift;
+    }
+
+    bool paletted = meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
+        meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL;
+    uint8_t *tex_dat = paletted ? pal_scratch : dst;
+
+    if (meta->vq_compression) {
+        pvr2_tex_vq_decompress(src, tex_dat, code_book_addr,
+                               beg_addr, w_shift);
     } else if (meta->twiddled) {
         if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-            pvr2_tex_detwiddle_4bpp(pvr2, tex_dat, beg_addr, meta->w_shift, meta->h_shift);
+            if (meta->mipmap && side_shift == 0) {
+                // the 1x1 level of a 4bpp mipmap lives in the upper nibble
+                tex_dat[0] = pvr2_tex_src_read8(src, beg_addr) >> 4;
+            } else {
+                pvr2_tex_detwiddle_4bpp(src, tex_dat, beg_addr,
+                                        w_shift, h_shift);
+            }
         } else {
-            pvr2_tex_detwiddle(pvr2, tex_dat, beg_addr,
-                               meta->w_shift, meta->h_shift,
+            pvr2_tex_detwiddle(src, tex_dat, beg_addr, w_shift, h_shift,
                                pixel_sizes[meta->tex_fmt]);
         }
     } else {
-        size_t idx;
-        for (idx = 0; idx < n_bytes; idx++)
-            tex_dat[idx] = pvr2_tex_mem_64bit_read8(pvr2, beg_addr + idx);
+        size_t n_bytes;
+        if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL)
+            n_bytes = (tex_w * tex_h) / 2;
+        else
+            n_bytes = tex_w * tex_h * pixel_sizes[meta->tex_fmt];
+        memcpy(tex_dat, pvr2_tex_src_ptr(src, beg_addr, n_bytes), n_bytes);
     }
 
     if (meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
-        uint32_t tex_size_actual;
-        enum palette_tp palette_tp = get_palette_tp(pvr2);
-        switch (palette_tp) {
-        case PALETTE_TP_ARGB_1555:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_RGB_565:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_ARGB_4444:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_ARGB_8888:
-            tex_size_actual = 4;
-            break;
-        default:
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-        n_bytes = tex_size_actual * tex_w * tex_h;
-        uint8_t *tex_dat_no_palette =
-            (uint8_t*)malloc(n_bytes);
-        if (!tex_dat_no_palette)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-
+        uint32_t tex_size_actual = pvr2_palette_pixel_size(src->palette_tp);
         uint32_t pal_start = (meta->tex_palette_start & 0x30) << 4;
         uint8_t const *tex_dat8 = (uint8_t const*)tex_dat;
 
         unsigned row, col;
-        uint8_t *pal_ram = pvr2_get_palette_ram(pvr2);
+        uint8_t const *pal_ram = src->pal_ram;
         for (row = 0; row < tex_h; row++) {
             for (col = 0; col < tex_w; col++) {
                 unsigned pix_idx = row * tex_w + col;
-                uint8_t *pix_out = tex_dat_no_palette +
-                    pix_idx * tex_size_actual;
+                uint8_t *pix_out = dst + pix_idx * tex_size_actual;
                 uint8_t pix_in = tex_dat8[pix_idx];
                 uint32_t palette_addr =
                     (pal_start | (uint32_t)pix_in) * 4;
                 memcpy(pix_out, pal_ram + palette_addr, tex_size_actual);
             }
         }
-        free(tex_dat);
-        tex_dat = tex_dat_no_palette;
         LOG_DBG("PVR2 paletted texture: tex_palette_start is 0x%04x\n",
                (unsigned)meta->tex_palette_start);
     } else if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-        uint32_t tex_size_actual;
-        enum palette_tp palette_tp = get_palette_tp(pvr2);
-        switch (palette_tp) {
-        case PALETTE_TP_ARGB_1555:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_RGB_565:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_ARGB_4444:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_ARGB_8888:
-            tex_size_actual = 4;
-            break;
-        default:
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-        n_bytes = tex_size_actual * tex_w * tex_h;
-        uint8_t *tex_dat_no_palette =
-            (uint8_t*)malloc(n_bytes);
-        if (!tex_dat_no_palette)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-
+        uint32_t tex_size_actual = pvr2_palette_pixel_size(src->palette_tp);
         uint32_t pal_start = meta->tex_palette_start << 4;
         uint8_t const *tex_dat8 = (uint8_t const*)tex_dat;
 
-        uint8_t *pal_ram = pvr2_get_palette_ram(pvr2);
+        uint8_t const *pal_ram = src->pal_ram;
         unsigned row, col;
         for (row = 0; row < tex_h; row++) {
             for (col = 0; col < tex_w; col++) {
                 unsigned pix_idx = row * tex_w + col;
 
-                uint8_t *pix_out = tex_dat_no_palette +
-                    pix_idx * tex_size_actual;
+                uint8_t *pix_out = dst + pix_idx * tex_size_actual;
                 uint8_t pix_in;
 
                 if (pix_idx % 2 == 0)
@@ -800,16 +897,134 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
                 memcpy(pix_out, pal_ram + palette_addr, tex_size_actual);
             }
         }
-        free(tex_dat);
-        tex_dat = tex_dat_no_palette;
         LOG_DBG("PVR2 paletted texture: tex_palette_start is 0x%04x\n",
                (unsigned)meta->tex_palette_start);
     }
+}
+
+/*
+ * decode the texture described by meta.  If all_levels is set then every
+ * level of a mipmapped texture is decoded, packed one after the other from
+ * largest to smallest; otherwise only the highest-resolution level is decoded.
+ */
+static void pvr2_tex_decode(struct pvr2_tex_src const *src,
+                            struct pvr2_tex_meta const *meta, bool all_levels,
+                            void **tex_dat_out, size_t *n_bytes_out) {
+    unsigned px_sz = pvr2_tex_host_pixel_size(src, meta);
+    int top_level, bottom_level, level;
+    size_t n_pixels, max_level_pixels;
+
+    if (meta->mipmap) {
+        top_level = meta->w_shift;
+        bottom_level = all_levels ? 0 : top_level;
+        max_level_pixels = 1 << (2 * top_level);
+        n_pixels = 0;
+        for (level = top_level; level >= bottom_level; level--)
+            n_pixels += 1 << (2 * level);
+    } else {
+        top_level = bottom_level = meta->w_shift;
+        max_level_pixels = n_pixels = meta->linestride * (1 << meta->h_shift);
+    }
+    size_t n_bytes = n_pixels * px_sz;
+
+    uint8_t *tex_dat = NULL;
+    if (n_bytes)
+        tex_dat = (uint8_t*)malloc(n_bytes * sizeof(uint8_t));
+    if (!tex_dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    // every level can share the scratch buffer needed by the largest one
+    uint8_t *pal_scratch = NULL;
+    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
+        meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
+        pal_scratch = (uint8_t*)malloc(max_level_pixels);
+        if (!pal_scratch)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    uint8_t *level_out = tex_dat;
+    for (level = top_level; level >= bottom_level; level--) {
+        pvr2_tex_decode_level(src, level_out, pal_scratch, meta, level);
+        level_out += (1 << (2 * level)) * px_sz;
+    }
+
+    free(pal_scratch);
 
     *tex_dat_out = tex_dat;
     *n_bytes_out = n_bytes;
 }
 
+void pvr2_tex_cache_read(struct pvr2 *pvr2,
+                         void **tex_dat_out, size_t *n_bytes_out,
+                         struct pvr2_tex_meta const *meta) {
+    struct pvr2_tex_src src;
+
+    pvr2_tex_check_meta(meta);
+    pvr2_tex_src_init(pvr2, &src, meta);
+    pvr2_tex_decode(&src, meta, false, tex_dat_out, n_bytes_out);
+    pvr2_tex_src_cleanup(&src);
+}
+
+void pvr2_tex_cache_read_mipmaps(struct pvr2 *pvr2,
+                                 void **tex_dat_out, size_t *n_bytes_out,
+                                 struct pvr2_tex_meta const *meta) {
+    struct pvr2_tex_src src;
+
+    pvr2_tex_check_meta(meta);
+    pvr2_tex_src_init(pvr2, &src, meta);
+    pvr2_tex_decode(&src, meta, true, tex_dat_out, n_bytes_out);
+    pvr2_tex_src_cleanup(&src);
+}
+
+/*
+ * returns true if the given texture is paletted and any of the palette banks
+ * it references have been written to since the last time it was updated.
+ */
+static bool pvr2_tex_palette_dirty(struct pvr2 *pvr2,
+                                   struct pvr2_tex const *tex) {
+    unsigned bank_first, n_banks;
+
+    if (tex->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
+        bank_first = tex->meta.tex_palette_start;
+        n_banks = 1;
+    } else if (tex->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
+        bank_first = tex->meta.tex_palette_start & 0x30;
+        n_banks = 256 / PVR2_PAL_BANK_LEN;
+    } else {
+        return false;
+    }
+
+    dc_cycle_stamp_t const *bank_stamps = pvr2->tex_cache.pal_bank_stamps;
+    unsigned bank_no;
+    for (bank_no = bank_first; bank_no < bank_first + n_banks; bank_no++)
+        if (bank_stamps[bank_no % PVR2_PAL_N_BANKS] > tex->last_update)
+            return true;
+    return false;
+}
+
+/*
+ * a texture which needs to be decoded and sent to the renderer.  The
+ * decoding happens on the texture decode pool; everything else happens on the
+ * emulation thread.
+ */
+struct pvr2_tex_job {
+    struct pvr2_tex_src src;
+    struct pvr2_tex_meta meta;
+    unsigned tex_no;
+    bool new_obj;
+
+    // output of the decode
+    void *tex_dat;
+    size_t n_bytes;
+};
+
+static void pvr2_tex_job_decode(void *argp) {
+    struct pvr2_tex_job *job = (struct pvr2_tex_job*)argp;
+    pvr2_tex_decode(&job->src, &job->meta, true,
+                    &job->tex_dat, &job->n_bytes);
+    pvr2_tex_src_cleanup(&job->src);
+}
+
 void pvr2_tex_cache_xmit(struct pvr2 *pvr2) {
     unsigned idx;
     unsigned cur_frame_stamp = get_cur_frame_stamp(pvr2);
@@ -817,6 +1032,8 @@ void pvr2_tex_cache_xmit(struct pvr2 *pvr2) {
     struct pvr2_tex_cache *cache = &pvr2->tex_cache;
     dc_cycle_stamp_t *page_stamps = cache->page_stamps;
     struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
+    struct pvr2_tex_job *jobs = NULL;
+    unsigned n_jobs = 0;
 
     for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
         struct pvr2_tex *tex_in = tex_cache + idx;
@@ -842,6 +1059,11 @@ void pvr2_tex_cache_xmit(struct pvr2 *pvr2) {
                     break;
                 }
             }
+
+            if (!need_update && pvr2_tex_palette_dirty(pvr2, tex_in)) {
+                pvr2->stat.persistent_counters.pal_tex_invalidate_count++;
+                need_update = true;
+            }
         }
 
         if (need_update) {
@@ -871,69 +1093,96 @@ void pvr2_tex_cache_xmit(struct pvr2 *pvr2) {
                 continue;
             }
 
-            if (tex_in->obj_no < 0) {
-                /*
-                 * This is a new texture; we need to create a data store,
-                 * upload the texture and bind the store to the texture object.
-                 */
+            if (!jobs) {
+                jobs = (struct pvr2_tex_job*)malloc(PVR2_TEX_CACHE_SIZE *
+                                                    sizeof(*jobs));
+                if (!jobs)
+                    RAISE_ERROR(ERROR_FAILED_ALLOC);
+            }
+
+            /*
+             * take a snapshot of everything the decoder will need so that it
+             * doesn't have to touch texture memory later.  Anything which
+             * would raise an error is also checked here so that errors never
+             * get raised from the decode threads.
+             */
+            struct pvr2_tex_job *job = jobs + n_jobs++;
+            job->meta = tex_in->meta;
+            if (tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
+                tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
+                job->meta.pix_fmt =
+                    translate_palette_to_pix_format(get_palette_tp(pvr2));
+            }
+            job->tex_no = idx;
+            pvr2_tex_check_meta(&job->meta);
+            pvr2_tex_src_init(pvr2, &job->src, &job->meta);
+            pvr2_tex_host_pixel_size(&job->src, &job->meta);
+
+            /*
+             * If this is a new texture then we need to create a data store
+             * for it.
+             */
+            job->new_obj = tex_in->obj_no < 0;
+            if (job->new_obj)
                 tex_in->obj_no = pvr2_alloc_gfx_obj();
 
-                void *tex_dat;
-                size_t n_bytes;
-                struct pvr2_tex_meta tmp = tex_in->meta;
-                if (tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
-                    tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-                    tmp.pix_fmt =
-                        translate_palette_to_pix_format(get_palette_tp(pvr2));
-                }
-                pvr2_tex_cache_read(pvr2, &tex_dat, &n_bytes, &tmp);
+            tex_in->state = PVR2_TEX_READY;
+            tex_in->last_update = clock_cycle_stamp(pvr2->clk);
+        }
+    }
 
-                cmd.op = GFX_IL_INIT_OBJ;
-                cmd.arg.init_obj.obj_no = tex_in->obj_no;
-                cmd.arg.init_obj.n_bytes = n_bytes;
-                rend_exec_il(&cmd, 1);
+    if (!n_jobs) {
+        free(jobs);
+        return;
+    }
 
-                cmd.op = GFX_IL_WRITE_OBJ;
-                cmd.arg.write_obj.dat = tex_dat;
-                cmd.arg.write_obj.obj_no = tex_in->obj_no;
-                cmd.arg.write_obj.n_bytes = n_bytes;
-                rend_exec_il(&cmd, 1);
-                free(tex_dat);
+    pvr2_tex_pool_run(cache->pool, pvr2_tex_job_decode,
+                     jobs, sizeof(*jobs), n_jobs);
 
-                cmd.op = GFX_IL_BIND_TEX;
-                cmd.arg.bind_tex.gfx_obj_handle = tex_in->obj_no;
-                cmd.arg.bind_tex.tex_no = idx;
-                cmd.arg.bind_tex.pix_fmt = tmp.pix_fmt;
-                cmd.arg.bind_tex.width = tex_in->meta.linestride;
-                cmd.arg.bind_tex.height = 1 << tex_in->meta.h_shift;
+    for (idx = 0; idx < n_jobs; idx++) {
+        struct pvr2_tex_job *job = jobs + idx;
+        struct pvr2_tex const *tex_in = tex_cache + job->tex_no;
 
-                rend_exec_il(&cmd, 1);
-            } else {
-                /*
-                 * This is a pre-existing texture; since the data-store has
-                 * already been created and bound, all we have to do is write
-                 * to it.
-                 */
-                struct pvr2_tex_meta tmp = tex_in->meta;
-                if (tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
-                    tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-                    tmp.pix_fmt = translate_palette_to_pix_format(get_palette_tp(pvr2));
-                }
-                void *tex_dat;
-                size_t n_bytes;
-                pvr2_tex_cache_read(pvr2, &tex_dat, &n_bytes, &tmp);
-                cmd.op = GFX_IL_WRITE_OBJ;
-                cmd.arg.write_obj.dat = tex_dat;
-                cmd.arg.write_obj.obj_no = tex_in->obj_no;
-                cmd.arg.write_obj.n_bytes = n_bytes;
-                rend_exec_il(&cmd, 1);
-                free(tex_dat);
-            }
+        if (job->new_obj) {
+            /*
+             * This is a new texture; we need to create a data store,
+             * upload the texture and bind the store to the texture object.
+             */
+            cmd.op = GFX_IL_INIT_OBJ;
+            cmd.arg.init_obj.obj_no = tex_in->obj_no;
+            cmd.arg.init_obj.n_bytes = job->n_bytes;
+            rend_exec_il(&cmd, 1);
 
-            tex_in->state = PVR2_TEX_READY;
-            tex_in->last_update = clock_cycle_stamp(pvr2->clk);
+            cmd.op = GFX_IL_WRITE_OBJ;
+            cmd.arg.write_obj.dat = job->tex_dat;
+            cmd.arg.write_obj.obj_no = tex_in->obj_no;
+            cmd.arg.write_obj.n_bytes = job->n_bytes;
+            rend_exec_il(&cmd, 1);
+
+            cmd.op = GFX_IL_BIND_TEX;
+            cmd.arg.bind_tex.gfx_obj_handle = tex_in->obj_no;
+            cmd.arg.bind_tex.tex_no = job->tex_no;
+            cmd.arg.bind_tex.pix_fmt = job->meta.pix_fmt;
+            cmd.arg.bind_tex.width = job->meta.linestride;
+            cmd.arg.bind_tex.height = 1 << job->meta.h_shift;
+            cmd.arg.bind_tex.mipmap = job->meta.mipmap;
+            rend_exec_il(&cmd, 1);
+        } else {
+            /*
+             * This is a pre-existing texture; since the data-store has
+             * already been created and bound, all we have to do is write
+             * to it.
+             */
+            cmd.op = GFX_IL_WRITE_OBJ;
+            cmd.arg.write_obj.dat = job->tex_dat;
+            cmd.arg.write_obj.obj_no = tex_in->obj_no;
+            cmd.arg.write_obj.n_bytes = job->n_bytes;
+            rend_exec_il(&cmd, 1);
         }
+        free(job->tex_dat);
     }
+
+    free(jobs);
 }
 
 int pvr2_tex_cache_get_idx(struct pvr2 *pvr2, struct pvr2_tex const *tex) {
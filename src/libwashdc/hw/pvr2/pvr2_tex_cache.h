@@ -32,6 +32,7 @@
 #include "pvr2_ta.h"
 #include "dc_sched.h"
 #include "mem_areas.h"
+#include "pvr2_tex_pool.h"
 
 #define PVR2_TEX_CACHE_SIZE GFX_TEX_CACHE_SIZE
 #define PVR2_TEX_CACHE_MASK GFX_TEX_CACHE_MASK
@@ -127,8 +128,27 @@ struct pvr2_tex {
 #define PVR2_TEX_MEM_LEN (ADDR_TEX64_LAST - ADDR_TEX64_FIRST + 1)
 #define PVR2_TEX_N_PAGES (PVR2_TEX_MEM_LEN / PVR2_TEX_PAGE_SIZE)
 
+/*
+ * Palette memory is tracked the same way, except that the "pages" are the
+ * 16-entry banks that a 4BPP texture can select.  An 8BPP texture covers 16
+ * consecutive banks.
+ */
+#define PVR2_PAL_BANK_LEN 16
+#define PVR2_PAL_N_ENTRIES 1024
+#define PVR2_PAL_N_BANKS (PVR2_PAL_N_ENTRIES / PVR2_PAL_BANK_LEN)
+
+/*
+ * number of threads (in addition to the emulation thread) which decode
+ * textures when gfx.rend.tex-decode-threads is not set in the config file.
+ */
+#define PVR2_TEX_DECODE_THREADS_DEFAULT 3
+
 struct pvr2_tex_cache {
     dc_cycle_stamp_t page_stamps[PVR2_TEX_N_PAGES];
+    dc_cycle_stamp_t pal_bank_stamps[PVR2_PAL_N_BANKS];
+
+    // worker threads used by pvr2_tex_cache_xmit to decode textures
+    struct pvr2_tex_pool *pool;
     struct pvr2_tex tex_cache[PVR2_TEX_CACHE_SIZE];
 };
 
@@ -178,10 +198,25 @@ void pvr2_tex_cache_xmit(struct pvr2 *pvr2);
 int pvr2_tex_get_meta(struct pvr2 *pvr2,
                       struct pvr2_tex_meta *meta, unsigned tex_idx);
 
+/*
+ * Decode the given texture.  For mipmapped textures, this only returns the
+ * highest-resolution level.
+ */
 void pvr2_tex_cache_read(struct pvr2 *pvr2,
                          void **tex_dat_out, size_t *n_bytes_out,
                          struct pvr2_tex_meta const *meta);
 
+/*
+ * Decode the given texture along with all of its mipmaps.  The levels are
+ * packed one after the other starting with the highest-resolution level and
+ * ending with the 1x1 level; this is the layout expected by the gfx_tex_cache
+ * for mipmapped textures.  For textures without mipmaps this is the same as
+ * pvr2_tex_cache_read.
+ */
+void pvr2_tex_cache_read_mipmaps(struct pvr2 *pvr2,
+                                 void **tex_dat_out, size_t *n_bytes_out,
+                                 struct pvr2_tex_meta const *meta);
+
 void pvr2_tex_cache_init(struct pvr2 *pvr2);
 void pvr2_tex_cache_cleanup(struct pvr2 *pvr2);
 
@@ -30,24 +30,21 @@
 #include "pvr2_tex_cache.h"
 #include "framebuffer.h"
 
+/*
+ * pull back any pages of a rendered framebuffer that this read touches.  The
+ * page check is inlined because it happens on every read.
+ */
 static inline void
 pvr2_tex_mem_sync_fb(struct pvr2 *pvr2, uint32_t addr_32bit, size_t n_bytes) {
-    /*
-     * TODO: don't call framebuffer_sync_from_host_maybe if addr is beyond the
-     * end of the framebuffer
-     */
-    uint32_t sof1 = get_fb_w_sof1(pvr2);
-    uint32_t sof2 = get_fb_w_sof2(pvr2);
-    if ((addr_32bit + ADDR_TEX32_FIRST + n_bytes) >= sof1 ||
-        (addr_32bit + ADDR_TEX32_FIRST + n_bytes) >= sof2)
-        framebuffer_sync_from_host_maybe();
+    if (pvr2_fb_page_range_test(pvr2->fb.host_dirty, addr_32bit, n_bytes))
+        pvr2_framebuffer_notify_read(pvr2, addr_32bit, n_bytes);
 }
 
 static inline void
 pvr2_tex_mem_notify_writes(struct pvr2 *pvr2,
                            uint32_t addr_32bit, size_t n_bytes) {
-    pvr2_tex_mem_sync_fb(pvr2, addr_32bit, n_bytes);
-    pvr2_framebuffer_notify_write(pvr2, addr_32bit, n_bytes);
+    if (pvr2_fb_page_range_test(pvr2->fb.footprint, addr_32bit, n_bytes))
+        pvr2_framebuffer_notify_write(pvr2, addr_32bit, n_bytes);
 
     /*
      * TODO: calling pvr2_tex_mem_addr_32_to_64 is suboptimal because if this
@@ -70,6 +67,7 @@ pvr2_tex_mem_32bit_read_double(struct pvr2 *pvr2, unsigned addr) {
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
+    pvr2_tex_mem_sync_fb(pvr2, addr, sizeof(ret));
     memcpy(&ret, pvr2->mem.tex32 + addr, sizeof(ret));
     return ret;
 }
@@ -343,14 +341,23 @@ void pvr2_tex_mem_64bit_read_raw(struct pvr2 *pvr2,
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
+    /*
+     * pull back any framebuffer pages in the range up-front so the copy below
+     * can work on whole 32-bit words at a time.
+     */
+    pvr2_framebuffer_notify_texture(pvr2, addr + ADDR_TEX64_FIRST,
+                                    addr + (n_bytes - 1) + ADDR_TEX64_FIRST);
+
     uint8_t *dst = (uint8_t*)dstp;
     while (n_bytes) {
-        uint8_t val = pvr2_tex_mem_64bit_read8(pvr2, addr);
-        memcpy(dst, &val, sizeof(uint8_t));
-
-        --n_bytes;
-        ++addr;
-        ++dst;
+        unsigned chunk = 4 - (addr & 3);
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        memcpy(dst, pvr2->mem.tex32 + pvr2_tex_mem_addr_64_to_32(addr), chunk);
+
+        n_bytes -= chunk;
+        addr += chunk;
+        dst += chunk;
     }
 }
 
@@ -363,15 +370,51 @@ void pvr2_tex_mem_64bit_write_raw(struct pvr2 *pvr2,
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
-    uint8_t const *src = (uint8_t*)srcp;
-    while (n_bytes) {
-        uint8_t val;
-        memcpy(&val, src, sizeof(val));
-        pvr2_tex_mem_64bit_write8(pvr2, addr, val);
+    /*
+     * notify the framebuffer and texture cache once for the whole range
+     * instead of once per word.  The 64-bit range covers one contiguous span
+     * in each of the two 32-bit banks.
+     */
+    uint32_t last = addr + (n_bytes - 1);
+    unsigned bank;
+    for (bank = 0; bank < 2; bank++) {
+        uint32_t bank_first = (addr & ~7) | (bank * 4);
+        if ((bank_first & ~3) != (addr & ~3) && bank_first < addr)
+            bank_first += 8;
+        else if (bank_first < addr)
+            bank_first = addr;
+
+        uint32_t bank_last = (last & ~7) | (bank * 4) | 3;
+        if ((bank_last & ~3) != (last & ~3) && bank_last > last)
+            bank_last -= 8;
+        else if (bank_last > last)
+            bank_last = last;
+
+        if (bank_first > bank_last || bank_last > last)
+            continue;
+
+        uint32_t first32 = pvr2_tex_mem_addr_64_to_32(bank_first);
+        uint32_t last32 = pvr2_tex_mem_addr_64_to_32(bank_last);
+        if (pvr2_fb_page_range_test(pvr2->fb.footprint, first32,
+                                    last32 - first32 + 1)) {
+            pvr2_framebuffer_notify_write(pvr2, first32,
+                                          last32 - first32 + 1);
+        }
+    }
+    pvr2_tex_cache_notify_write(pvr2, addr, n_bytes);
 
-        --n_bytes;
-        ++addr;
-        ++src;
+    // copy up to one 32-bit word at a time, same as the read path
+    uint8_t const *src = (uint8_t const*)srcp;
+    while (n_bytes) {
+        unsigned chunk = 4 - (addr & 3);
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        unsigned offs = pvr2_tex_mem_addr_64_to_32(addr);
+        memcpy(pvr2->mem.tex32 + offs, src, chunk);
+
+        n_bytes -= chunk;
+        addr += chunk;
+        src += chunk;
     }
 }
 
@@ -390,7 +433,7 @@ pvr2_tex_mem_64bit_write_double(struct pvr2 *pvr2,
 
     /*
      * TODO: this is suboptimal because it could call
-     * framebuffer_sync_from_host_maybe twice
+     * pvr2_framebuffer_notify_write twice
      */
     pvr2_tex_mem_notify_writes(pvr2, offs1, sizeof(val));
     pvr2_tex_mem_notify_writes(pvr2, offs2, sizeof(val));
@@ -555,6 +598,42 @@ static void pvr2_tex_mem_area64_write_double(addr32_t addr, double val, void *ct
     pvr2_tex_mem_64bit_write_double(pvr2, addr, val);
 }
 
+static int pvr2_tex_mem_area32_read_raw(addr32_t addr, void *buf,
+                                        unsigned len, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    if (!len || addr + (len - 1) >= PVR2_TEX32_MEM_LEN)
+        return 1;
+    pvr2_tex_mem_32bit_read_raw(pvr2, buf, addr, len);
+    return 0;
+}
+
+static int pvr2_tex_mem_area32_write_raw(addr32_t addr, void const *buf,
+                                         unsigned len, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    if (!len || addr + (len - 1) >= PVR2_TEX32_MEM_LEN)
+        return 1;
+    pvr2_tex_mem_32bit_write_raw(pvr2, addr, buf, len);
+    return 0;
+}
+
+static int pvr2_tex_mem_area64_read_raw(addr32_t addr, void *buf,
+                                        unsigned len, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    if (!len || addr + (len - 1) >= PVR2_TEX64_MEM_LEN)
+        return 1;
+    pvr2_tex_mem_64bit_read_raw(pvr2, buf, addr, len);
+    return 0;
+}
+
+static int pvr2_tex_mem_area64_write_raw(addr32_t addr, void const *buf,
+                                         unsigned len, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    if (!len || addr + (len - 1) >= PVR2_TEX64_MEM_LEN)
+        return 1;
+    pvr2_tex_mem_64bit_write_raw(pvr2, addr, buf, len);
+    return 0;
+}
+
 static uint8_t pvr2_tex_mem_unused_read_8(addr32_t addr, void *ctxt) {
     return ~0;
 }
@@ -601,7 +680,10 @@ struct memory_interface pvr2_tex_mem_area32_intf = {
     .writefloat = pvr2_tex_mem_area32_write_float,
     .write32 = pvr2_tex_mem_area32_write_32,
     .write16 = pvr2_tex_mem_area32_write_16,
-    .write8 = pvr2_tex_mem_area32_write_8
+    .write8 = pvr2_tex_mem_area32_write_8,
+
+    .read_raw = pvr2_tex_mem_area32_read_raw,
+    .write_raw = pvr2_tex_mem_area32_write_raw
 };
 
 struct memory_interface pvr2_tex_mem_area64_intf = {
@@ -615,7 +697,10 @@ struct memory_interface pvr2_tex_mem_area64_intf = {
     .writefloat = pvr2_tex_mem_area64_write_float,
     .write32 = pvr2_tex_mem_area64_write_32,
     .write16 = pvr2_tex_mem_area64_write_16,
-    .write8 = pvr2_tex_mem_area64_write_8
+    .write8 = pvr2_tex_mem_area64_write_8,
+
+    .read_raw = pvr2_tex_mem_area64_read_raw,
+    .write_raw = pvr2_tex_mem_area64_write_raw
 };
 
 struct memory_interface pvr2_tex_mem_unused_intf = {
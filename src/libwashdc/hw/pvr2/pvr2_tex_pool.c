@@ -0,0 +1,164 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "washdc/error.h"
+#include "threading.h"
+
+#include "pvr2_tex_pool.h"
+
+struct pvr2_tex_pool {
+    washdc_thread threads[PVR2_TEX_POOL_MAX_THREADS];
+    unsigned n_threads;
+
+    washdc_mutex lock;
+    washdc_cvar work_cond, done_cond;
+
+    // the current batch; these are only valid while pvr2_tex_pool_run runs
+    pvr2_tex_pool_fn fn;
+    char *jobs;
+    size_t job_size;
+    unsigned n_jobs, next_job, n_done;
+
+    bool quit;
+};
+
+static void pvr2_tex_pool_main(void *argp);
+
+struct pvr2_tex_pool *pvr2_tex_pool_create(unsigned n_threads) {
+    struct pvr2_tex_pool *pool =
+        (struct pvr2_tex_pool*)malloc(sizeof(struct pvr2_tex_pool));
+    if (!pool)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    memset(pool, 0, sizeof(*pool));
+
+    if (n_threads > PVR2_TEX_POOL_MAX_THREADS)
+        n_threads = PVR2_TEX_POOL_MAX_THREADS;
+
+    washdc_mutex_init(&pool->lock);
+    washdc_cvar_init(&pool->work_cond);
+    washdc_cvar_init(&pool->done_cond);
+
+    unsigned idx;
+    for (idx = 0; idx < n_threads; idx++)
+        washdc_thread_create(pool->threads + idx, pvr2_tex_pool_main, pool);
+    pool->n_threads = n_threads;
+
+    LOG_INFO("PVR2: %u texture decode thread%s\n",
+             pool->n_threads, pool->n_threads == 1 ? "" : "s");
+
+    return pool;
+}
+
+void pvr2_tex_pool_destroy(struct pvr2_tex_pool *pool) {
+    washdc_mutex_lock(&pool->lock);
+    pool->quit = true;
+    washdc_cvar_signal(&pool->work_cond);
+    washdc_mutex_unlock(&pool->lock);
+
+    unsigned idx;
+    for (idx = 0; idx < pool->n_threads; idx++)
+        washdc_thread_join(pool->threads + idx);
+    pool->n_threads = 0;
+
+    washdc_cvar_cleanup(&pool->done_cond);
+    washdc_cvar_cleanup(&pool->work_cond);
+    washdc_mutex_cleanup(&pool->lock);
+
+    free(pool);
+}
+
+/*
+ * take jobs from the current batch until there are none left.  The lock must
+ * be held when this is called, and it will still be held when it returns.
+ *
+ * washdc_cvar_signal might only wake up one thread, so whoever takes a job
+ * passes the wakeup along to the next worker if there are still jobs left.
+ */
+static void pvr2_tex_pool_drain(struct pvr2_tex_pool *pool) {
+    while (pool->next_job < pool->n_jobs) {
+        void *job = pool->jobs + pool->job_size * pool->next_job++;
+        pvr2_tex_pool_fn fn = pool->fn;
+
+        if (pool->next_job < pool->n_jobs)
+            washdc_cvar_signal(&pool->work_cond);
+
+        washdc_mutex_unlock(&pool->lock);
+        fn(job);
+        washdc_mutex_lock(&pool->lock);
+
+        if (++pool->n_done == pool->n_jobs)
+            washdc_cvar_signal(&pool->done_cond);
+    }
+}
+
+void pvr2_tex_pool_run(struct pvr2_tex_pool *pool, pvr2_tex_pool_fn fn,
+                       void *jobs, size_t job_size, unsigned n_jobs) {
+    if (!pool->n_threads || n_jobs <= 1) {
+        char *job = (char*)jobs;
+        while (n_jobs--) {
+            fn(job);
+            job += job_size;
+        }
+        return;
+    }
+
+    washdc_mutex_lock(&pool->lock);
+
+    pool->fn = fn;
+    pool->jobs = (char*)jobs;
+    pool->job_size = job_size;
+    pool->n_jobs = n_jobs;
+    pool->next_job = 0;
+    pool->n_done = 0;
+
+    pvr2_tex_pool_drain(pool);
+
+    while (pool->n_done < pool->n_jobs)
+        washdc_cvar_wait(&pool->done_cond, &pool->lock);
+
+    pool->fn = NULL;
+    pool->jobs = NULL;
+    pool->n_jobs = pool->next_job = pool->n_done = 0;
+
+    washdc_mutex_unlock(&pool->lock);
+}
+
+static void pvr2_tex_pool_main(void *argp) {
+    struct pvr2_tex_pool *pool = (struct pvr2_tex_pool*)argp;
+
+    washdc_mutex_lock(&pool->lock);
+    while (!pool->quit) {
+        if (pool->next_job < pool->n_jobs)
+            pvr2_tex_pool_drain(pool);
+        else
+            washdc_cvar_wait(&pool->work_cond, &pool->lock);
+    }
+
+    // pass the quit signal along to the next worker
+    washdc_cvar_signal(&pool->work_cond);
+    washdc_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,60 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef PVR2_TEX_POOL_H_
+#define PVR2_TEX_POOL_H_
+
+#include <stddef.h>
+
+/*
+ * pool of worker threads used to decode textures in parallel.
+ *
+ * The pool only ever runs one batch of jobs at a time, and
+ * pvr2_tex_pool_run does not return until every job in the batch has
+ * finished, so the jobs never outlive the caller's stack frame.  The calling
+ * thread also decodes textures while it waits.
+ *
+ * Jobs must not touch any emulator state; everything they need has to be
+ * copied into the job beforehand.
+ */
+
+typedef void(*pvr2_tex_pool_fn)(void *job);
+
+#define PVR2_TEX_POOL_MAX_THREADS 16
+
+struct pvr2_tex_pool;
+
+/*
+ * n_threads is the number of worker threads to create in addition to the
+ * calling thread.  If it is 0, all jobs will run on the calling thread.
+ */
+struct pvr2_tex_pool *pvr2_tex_pool_create(unsigned n_threads);
+void pvr2_tex_pool_destroy(struct pvr2_tex_pool *pool);
+
+/*
+ * call fn on each of the n_jobs elements of the jobs array (each of which is
+ * job_size bytes long) and return once all of them have completed.
+ */
+void pvr2_tex_pool_run(struct pvr2_tex_pool *pool, pvr2_tex_pool_fn fn,
+                       void *jobs, size_t job_size, unsigned n_jobs);
+
+#endif
@@ -45,6 +45,8 @@
 #include "jit/jit_profile.h"
 #endif
 
+struct code_cache;
+
 /*
  * The clock-scale is here defined as the number of scheduler cyclers per sh4
  * cycle.
@@ -116,6 +118,12 @@ struct Sh4 {
 
     struct sh4_mem mem;
 
+    /*
+     * the JIT's code cache.  Anything that could change the code the SH4 sees
+     * needs to invalidate it.
+     */
+    struct code_cache *code_cache;
+
 #ifdef JIT_PROFILE
     struct jit_profile_ctxt jit_profile;
 #endif
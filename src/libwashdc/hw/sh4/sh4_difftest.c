@@ -0,0 +1,996 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "log.h"
+#include "memory.h"
+#include "mem_areas.h"
+#include "real_ticks.h"
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "sh4.h"
+#include "sh4_inst.h"
+#include "sh4_read_inst.h"
+#include "sh4_reg.h"
+#include "sh4_reg_flags.h"
+#include "sh4_jit.h"
+#include "jit/code_block.h"
+#include "jit/code_cache.h"
+
+#ifdef ENABLE_JIT_X86_64
+#include "jit/x86_64/native_dispatch.h"
+#endif
+
+#include "sh4_difftest.h"
+
+// where the generated code goes
+#define DIFFTEST_CODE_ADDR 0x8c010000
+
+// scratch memory for the load/store instructions
+#define DIFFTEST_DATA_ADDR 0x8c200000
+#define DIFFTEST_DATA_LEN 0x2000
+
+/*
+ * R8-R11 start out somewhere in [PTR_FIRST, PTR_FIRST + PTR_SPAN) within the
+ * scratch memory, and R0 starts out in [0, PTR_SPAN] so it can be used as an
+ * index.  That leaves plenty of room on either side for displacements and
+ * for 32 instructions worth of pre-decrements/post-increments.
+ */
+#define DIFFTEST_PTR_FIRST 0x800
+#define DIFFTEST_PTR_SPAN 0x100
+#define DIFFTEST_GBR_OFFS 0x1000
+
+#define DIFFTEST_MAX_INSTS 32
+
+// every sequence ends with "bra 1f; nop; 1:"
+#define DIFFTEST_TERM_LEN 2
+#define DIFFTEST_END_ADDR(n_insts) \
+    (DIFFTEST_CODE_ADDR + 2 * ((n_insts) + DIFFTEST_TERM_LEN))
+
+/*
+ * upper limit on how many instructions (or blocks, for the jit backends) a
+ * sequence can take before we give up on it.
+ */
+#define DIFFTEST_MAX_STEPS (DIFFTEST_MAX_INSTS + DIFFTEST_TERM_LEN)
+
+// every register from R0 up to and including PC gets compared
+#define DIFFTEST_N_REGS (SH4_REG_PC + 1)
+
+// only this many mismatching cases get written out in full
+#define DIFFTEST_MAX_REPORTS 16
+
+#define DIFFTEST_TIMING_SEQS 8
+#define DIFFTEST_TIMING_LEN 16
+#define DIFFTEST_TIMING_REPS 256
+
+#define DIFFTEST_MAX_OPS 512
+
+enum difftest_flags {
+    // never generate this instruction
+    DT_SKIP = 1 << 0,
+
+    // bits 8-11 (or 4-7) hold a general-purpose register used as an address
+    DT_ADDR_N = 1 << 1,
+    DT_ADDR_M = 1 << 2,
+
+    /*
+     * size of the memory access, this decides which pointer register gets
+     * used.  DT_SZ_F is for FMOV, which depends on FPSCR.SZ
+     */
+    DT_SZ_B = 1 << 3,
+    DT_SZ_W = 1 << 4,
+    DT_SZ_L = 1 << 5,
+    DT_SZ_F = 1 << 6,
+
+    // the address is indexed by R0
+    DT_R0_IDX = 1 << 7,
+
+    // overwrites R0
+    DT_W_R0 = 1 << 8,
+
+    // undefined unless FPSCR.PR is 0 (or 1)
+    DT_PR0 = 1 << 9,
+    DT_PR1 = 1 << 10,
+
+    // bits 8-11 (or 4-7) must name a DRn when FPSCR.PR is 1
+    DT_DR_N = 1 << 11,
+    DT_DR_M = 1 << 12,
+
+    // flips FPSCR.SZ
+    DT_SZ_FLIP = 1 << 13,
+
+    /*
+     * bits 8-11 (or 4-7) must name a DRn when FPSCR.SZ is 1.  Most of the
+     * XDn forms of FMOV aren't implemented yet.
+     */
+    DT_SZ_DR_N = 1 << 14,
+    DT_SZ_DR_M = 1 << 15
+};
+
+/*
+ * Everything the generator needs to know about an opcode that isn't in its
+ * InstOpcode.  Opcodes that aren't listed here are assumed to only operate on
+ * registers.
+ */
+static struct difftest_rule {
+    cpu_inst_param mask, val;
+    unsigned flags;
+} const difftest_rules[] = {
+    // these would hang the CPU or change SR, GBR or FPSCR behind our backs
+    { 0xffff, 0x0038, DT_SKIP },                        // LDTLB
+    { 0xffff, 0x001b, DT_SKIP },                        // SLEEP
+    { 0xff00, 0xc300, DT_SKIP },                        // TRAPA #imm
+    { 0xf0ff, 0x400e, DT_SKIP },                        // LDC Rm, SR
+    { 0xf0ff, 0x4007, DT_SKIP },                        // LDC.L @Rm+, SR
+    { 0xf0ff, 0x401e, DT_SKIP },                        // LDC Rm, GBR
+    { 0xf0ff, 0x4017, DT_SKIP },                        // LDC.L @Rm+, GBR
+    { 0xf0ff, 0x406a, DT_SKIP },                        // LDS Rm, FPSCR
+    { 0xf0ff, 0x4066, DT_SKIP },                        // LDS.L @Rm+, FPSCR
+
+    // the interpreter raises an error when the input is negative
+    { 0xf0ff, 0xf06d, DT_SKIP },                        // FSQRT FRn
+
+    { 0xf0ff, 0x401b, DT_ADDR_N | DT_SZ_B },            // TAS.B @Rn
+    { 0xf0ff, 0x0093, DT_ADDR_N | DT_SZ_B },            // OCBI @Rn
+    { 0xf0ff, 0x00a3, DT_ADDR_N | DT_SZ_B },            // OCBP @Rn
+    { 0xf0ff, 0x00b3, DT_ADDR_N | DT_SZ_B },            // OCBWB @Rn
+    { 0xf0ff, 0x0083, DT_ADDR_N | DT_SZ_B },            // PREF @Rn
+    { 0xf0ff, 0x00c3, DT_ADDR_N | DT_SZ_L },            // MOVCA.L R0, @Rn
+
+    { 0xf0ff, 0x4027, DT_ADDR_N | DT_SZ_L },            // LDC.L @Rm+, VBR
+    { 0xf0ff, 0x4037, DT_ADDR_N | DT_SZ_L },            // LDC.L @Rm+, SSR
+    { 0xf0ff, 0x4047, DT_ADDR_N | DT_SZ_L },            // LDC.L @Rm+, SPC
+    { 0xf0ff, 0x40f6, DT_ADDR_N | DT_SZ_L },            // LDC.L @Rm+, DBR
+    { 0xf08f, 0x4087, DT_ADDR_N | DT_SZ_L },            // LDC.L @Rm+, Rn_BANK
+    { 0xf0ff, 0x4003, DT_ADDR_N | DT_SZ_L },            // STC.L SR, @-Rn
+    { 0xf0ff, 0x4013, DT_ADDR_N | DT_SZ_L },            // STC.L GBR, @-Rn
+    { 0xf0ff, 0x4023, DT_ADDR_N | DT_SZ_L },            // STC.L VBR, @-Rn
+    { 0xf0ff, 0x4033, DT_ADDR_N | DT_SZ_L },            // STC.L SSR, @-Rn
+    { 0xf0ff, 0x4043, DT_ADDR_N | DT_SZ_L },            // STC.L SPC, @-Rn
+    { 0xf0ff, 0x4032, DT_ADDR_N | DT_SZ_L },            // STC.L SGR, @-Rn
+    { 0xf0ff, 0x40f2, DT_ADDR_N | DT_SZ_L },            // STC.L DBR, @-Rn
+    { 0xf08f, 0x4083, DT_ADDR_N | DT_SZ_L },            // STC.L Rm_BANK, @-Rn
+    { 0xf0ff, 0x4006, DT_ADDR_N | DT_SZ_L },            // LDS.L @Rm+, MACH
+    { 0xf0ff, 0x4016, DT_ADDR_N | DT_SZ_L },            // LDS.L @Rm+, MACL
+    { 0xf0ff, 0x4026, DT_ADDR_N | DT_SZ_L },            // LDS.L @Rm+, PR
+    { 0xf0ff, 0x4056, DT_ADDR_N | DT_SZ_L },            // LDS.L @Rm+, FPUL
+    { 0xf0ff, 0x4002, DT_ADDR_N | DT_SZ_L },            // STS.L MACH, @-Rn
+    { 0xf0ff, 0x4012, DT_ADDR_N | DT_SZ_L },            // STS.L MACL, @-Rn
+    { 0xf0ff, 0x4022, DT_ADDR_N | DT_SZ_L },            // STS.L PR, @-Rn
+    { 0xf0ff, 0x4052, DT_ADDR_N | DT_SZ_L },            // STS.L FPUL, @-Rn
+    { 0xf0ff, 0x4062, DT_ADDR_N | DT_SZ_L },            // STS.L FPSCR, @-Rn
+
+    { 0xf00f, 0x2000, DT_ADDR_N | DT_SZ_B },            // MOV.B Rm, @Rn
+    { 0xf00f, 0x2001, DT_ADDR_N | DT_SZ_W },            // MOV.W Rm, @Rn
+    { 0xf00f, 0x2002, DT_ADDR_N | DT_SZ_L },            // MOV.L Rm, @Rn
+    { 0xf00f, 0x2004, DT_ADDR_N | DT_SZ_B },            // MOV.B Rm, @-Rn
+    { 0xf00f, 0x2005, DT_ADDR_N | DT_SZ_W },            // MOV.W Rm, @-Rn
+    { 0xf00f, 0x2006, DT_ADDR_N | DT_SZ_L },            // MOV.L Rm, @-Rn
+    { 0xf00f, 0x6000, DT_ADDR_M | DT_SZ_B },            // MOV.B @Rm, Rn
+    { 0xf00f, 0x6001, DT_ADDR_M | DT_SZ_W },            // MOV.W @Rm, Rn
+    { 0xf00f, 0x6002, DT_ADDR_M | DT_SZ_L },            // MOV.L @Rm, Rn
+    { 0xf00f, 0x6004, DT_ADDR_M | DT_SZ_B },            // MOV.B @Rm+, Rn
+    { 0xf00f, 0x6005, DT_ADDR_M | DT_SZ_W },            // MOV.W @Rm+, Rn
+    { 0xf00f, 0x6006, DT_ADDR_M | DT_SZ_L },            // MOV.L @Rm+, Rn
+    { 0xf00f, 0x000f, DT_ADDR_N | DT_ADDR_M | DT_SZ_L },  // MAC.L @Rm+, @Rn+
+    { 0xf00f, 0x400f, DT_ADDR_N | DT_ADDR_M | DT_SZ_W },  // MAC.W @Rm+, @Rn+
+
+    // the register for these two is in bits 4-7
+    { 0xff00, 0x8000, DT_ADDR_M | DT_SZ_B },            // MOV.B R0, @(disp, Rn)
+    { 0xff00, 0x8100, DT_ADDR_M | DT_SZ_W },            // MOV.W R0, @(disp, Rn)
+    { 0xf000, 0x1000, DT_ADDR_N | DT_SZ_L },            // MOV.L Rm, @(disp, Rn)
+    { 0xff00, 0x8400, DT_ADDR_M | DT_SZ_B | DT_W_R0 },  // MOV.B @(disp, Rm), R0
+    { 0xff00, 0x8500, DT_ADDR_M | DT_SZ_W | DT_W_R0 },  // MOV.W @(disp, Rm), R0
+    { 0xf000, 0x5000, DT_ADDR_M | DT_SZ_L },            // MOV.L @(disp, Rm), Rn
+
+    { 0xf00f, 0x0004, DT_ADDR_N | DT_SZ_B | DT_R0_IDX },  // MOV.B Rm, @(R0, Rn)
+    { 0xf00f, 0x0005, DT_ADDR_N | DT_SZ_W | DT_R0_IDX },  // MOV.W Rm, @(R0, Rn)
+    { 0xf00f, 0x0006, DT_ADDR_N | DT_SZ_L | DT_R0_IDX },  // MOV.L Rm, @(R0, Rn)
+    { 0xf00f, 0x000c, DT_ADDR_M | DT_SZ_B | DT_R0_IDX },  // MOV.B @(R0, Rm), Rn
+    { 0xf00f, 0x000d, DT_ADDR_M | DT_SZ_W | DT_R0_IDX },  // MOV.W @(R0, Rm), Rn
+    { 0xf00f, 0x000e, DT_ADDR_M | DT_SZ_L | DT_R0_IDX },  // MOV.L @(R0, Rm), Rn
+
+    { 0xff00, 0xc400, DT_W_R0 },                        // MOV.B @(disp, GBR), R0
+    { 0xff00, 0xc500, DT_W_R0 },                        // MOV.W @(disp, GBR), R0
+    { 0xff00, 0xc600, DT_W_R0 },                        // MOV.L @(disp, GBR), R0
+    { 0xff00, 0xc900, DT_W_R0 },                        // AND #imm, R0
+    { 0xff00, 0xcb00, DT_W_R0 },                        // OR #imm, R0
+    { 0xff00, 0xca00, DT_W_R0 },                        // XOR #imm, R0
+    { 0xff00, 0xcd00, DT_R0_IDX },                      // AND.B #imm, @(R0, GBR)
+    { 0xff00, 0xcf00, DT_R0_IDX },                      // OR.B #imm, @(R0, GBR)
+    { 0xff00, 0xce00, DT_R0_IDX },                      // XOR.B #imm, @(R0, GBR)
+    { 0xff00, 0xcc00, DT_R0_IDX },                      // TST.B #imm, @(R0, GBR)
+
+    // FMOV @Rm, FRn
+    { 0xf00f, 0xf008, DT_ADDR_M | DT_SZ_F | DT_SZ_DR_N },
+    // FMOV @Rm+, FRn
+    { 0xf00f, 0xf009, DT_ADDR_M | DT_SZ_F | DT_SZ_DR_N },
+    // FMOV @(R0, Rm), FRn
+    { 0xf00f, 0xf006, DT_ADDR_M | DT_SZ_F | DT_R0_IDX | DT_SZ_DR_N },
+    // FMOV FRm, @Rn
+    { 0xf00f, 0xf00a, DT_ADDR_N | DT_SZ_F | DT_SZ_DR_M },
+    // FMOV FRm, @-Rn
+    { 0xf00f, 0xf00b, DT_ADDR_N | DT_SZ_F | DT_SZ_DR_M },
+    // FMOV FRm, @(R0, Rn)
+    { 0xf00f, 0xf007, DT_ADDR_N | DT_SZ_F | DT_R0_IDX | DT_SZ_DR_M },
+    // FMOV FRm, FRn
+    { 0xf00f, 0xf00c, DT_SZ_DR_N | DT_SZ_DR_M },
+
+    { 0xf0ff, 0xf08d, DT_PR0 },                         // FLDI0 FRn
+    { 0xf0ff, 0xf09d, DT_PR0 },                         // FLDI1 FRn
+    { 0xf0ff, 0xf05d, DT_DR_N },                        // FABS FRn
+    { 0xf0ff, 0xf04d, DT_DR_N },                        // FNEG FRn
+    { 0xf0ff, 0xf02d, DT_DR_N },                        // FLOAT FPUL, FRn
+    { 0xf0ff, 0xf03d, DT_DR_N },                        // FTRC FRm, FPUL
+    { 0xf00f, 0xf000, DT_DR_N | DT_DR_M },              // FADD FRm, FRn
+    { 0xf00f, 0xf001, DT_DR_N | DT_DR_M },              // FSUB FRm, FRn
+    { 0xf00f, 0xf002, DT_DR_N | DT_DR_M },              // FMUL FRm, FRn
+    { 0xf00f, 0xf003, DT_DR_N | DT_DR_M },              // FDIV FRm, FRn
+    { 0xf00f, 0xf004, DT_DR_N | DT_DR_M },              // FCMP/EQ FRm, FRn
+    { 0xf00f, 0xf005, DT_DR_N | DT_DR_M },              // FCMP/GT FRm, FRn
+    { 0xf00f, 0xf00e, DT_PR0 },                         // FMAC FR0, FRm, FRn
+    { 0xf0ff, 0xf0ed, DT_PR0 },                         // FIPR FVm, FVn
+    { 0xf3ff, 0xf1fd, DT_PR0 },                         // FTRV XMTRX, FVn
+    { 0xf1ff, 0xf0fd, DT_PR0 },                         // FSCA FPUL, DRn
+    { 0xf0ff, 0xf07d, DT_PR0 },                         // FSRRA FRn
+    { 0xf1ff, 0xf0bd, DT_PR1 },                         // FCNVDS DRm, FPUL
+    { 0xf1ff, 0xf0ad, DT_PR1 },                         // FCNVSD FPUL, DRn
+    { 0xffff, 0xfbfd, DT_PR0 },                         // FRCHG
+    { 0xffff, 0xf3fd, DT_PR0 | DT_SZ_FLIP }             // FSCHG
+};
+
+#define DIFFTEST_N_RULES (sizeof(difftest_rules) / sizeof(difftest_rules[0]))
+
+// general-purpose registers which can be overwritten (not R8-R11)
+static unsigned const difftest_dst_regs[] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 12, 13, 14, 15
+};
+
+#define DIFFTEST_N_DST_REGS \
+    (sizeof(difftest_dst_regs) / sizeof(difftest_dst_regs[0]))
+
+struct difftest_op {
+    InstOpcode const *op;
+    unsigned flags;
+
+    // number of shrunken mismatching cases that ended with this opcode
+    unsigned n_suspect;
+};
+
+static struct difftest_op difftest_ops[DIFFTEST_MAX_OPS];
+static unsigned difftest_n_ops;
+
+struct difftest_case {
+    unsigned n_insts;
+    bool pr, sz;
+    cpu_inst_param insts[DIFFTEST_MAX_INSTS];
+    reg32_t regs[DIFFTEST_N_REGS];
+    uint8_t data[DIFFTEST_DATA_LEN];
+};
+
+enum difftest_backend {
+    DIFFTEST_INTERP,
+    DIFFTEST_JIT_INTP,
+    DIFFTEST_NATIVE,
+
+    DIFFTEST_BACKEND_COUNT
+};
+
+static char const *const difftest_backend_names[DIFFTEST_BACKEND_COUNT] = {
+    "interpreter",
+    "jit-intp",
+    "native"
+};
+
+struct difftest_result {
+    // 0 if the sequence ran to the end, -1 if it went off somewhere else
+    int status;
+    reg32_t regs[DIFFTEST_N_REGS];
+    uint8_t data[DIFFTEST_DATA_LEN];
+};
+
+/*
+ * blocks compiled for the IL interpreter.  These don't go in the code cache
+ * because the code cache's blocks are native blocks when the native jit is
+ * enabled.
+ */
+struct difftest_il_cache {
+    unsigned n_blocks;
+    jit_hash hashes[DIFFTEST_MAX_STEPS];
+    struct jit_code_block blocks[DIFFTEST_MAX_STEPS];
+};
+
+static struct difftest_case difftest_case;
+static struct difftest_result difftest_results[DIFFTEST_BACKEND_COUNT];
+static struct difftest_il_cache difftest_il_cache;
+
+static char const *const difftest_group_names[] = {
+    [SH4_GROUP_MT] = "MT",
+    [SH4_GROUP_EX] = "EX",
+    [SH4_GROUP_BR] = "BR",
+    [SH4_GROUP_LS] = "LS",
+    [SH4_GROUP_FE] = "FE",
+    [SH4_GROUP_CO] = "CO",
+    [SH4_GROUP_NONE] = "none"
+};
+
+// splitmix64
+static uint64_t difftest_rand(uint64_t *state) {
+    uint64_t val = (*state += 0x9e3779b97f4a7c15ULL);
+    val = (val ^ (val >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    val = (val ^ (val >> 27)) * 0x94d049bb133111ebULL;
+    return val ^ (val >> 31);
+}
+
+static unsigned difftest_rand_below(uint64_t *state, unsigned limit) {
+    return difftest_rand(state) % limit;
+}
+
+static uint64_t difftest_now_ns(void) {
+    washdc_real_time now;
+    washdc_get_real_time(&now);
+    return (uint64_t)(washdc_real_time_to_seconds(&now) * 1000000000.0);
+}
+
+static void difftest_build_op_list(void) {
+    unsigned inst;
+
+    difftest_n_ops = 0;
+
+    /*
+     * every opcode that can actually be decoded maps its own val back to
+     * itself, so this finds each one exactly once.
+     */
+    for (inst = 0; inst < (1 << 16); inst++) {
+        InstOpcode const *op = sh4_inst_lut[inst];
+        if (!op->mask || op->val != inst || op->pc_relative)
+            continue;
+
+        unsigned flags = 0, rule_no;
+        for (rule_no = 0; rule_no < DIFFTEST_N_RULES; rule_no++) {
+            struct difftest_rule const *rule = difftest_rules + rule_no;
+            if (rule->mask == op->mask && rule->val == op->val) {
+                flags = rule->flags;
+                break;
+            }
+        }
+        if (flags & DT_SKIP)
+            continue;
+
+        if (difftest_n_ops >= DIFFTEST_MAX_OPS)
+            RAISE_ERROR(ERROR_OVERFLOW);
+        difftest_ops[difftest_n_ops].op = op;
+        difftest_ops[difftest_n_ops].flags = flags;
+        difftest_ops[difftest_n_ops].n_suspect = 0;
+        difftest_n_ops++;
+    }
+}
+
+static struct difftest_op *difftest_find_op(cpu_inst_param inst) {
+    InstOpcode const *op = sh4_inst_lut[inst];
+    unsigned idx;
+    for (idx = 0; idx < difftest_n_ops; idx++)
+        if (difftest_ops[idx].op == op)
+            return difftest_ops + idx;
+    return NULL;
+}
+
+static unsigned difftest_ptr_reg(unsigned flags, bool sz) {
+    if (flags & DT_SZ_B)
+        return 8;
+    if (flags & DT_SZ_W)
+        return 9;
+    if ((flags & DT_SZ_F) && sz)
+        return 11;
+    return 10;
+}
+
+/*
+ * fill in an instruction from dop with random operands, subject to the
+ * restrictions described at the top of sh4_difftest.h.  Returns false if dop
+ * can't be used here.
+ */
+static bool
+difftest_gen_inst(struct difftest_op const *dop, uint64_t *rng, bool pr,
+                  bool *sz, bool *r0_ok, cpu_inst_param *out) {
+    InstOpcode const *op = dop->op;
+    unsigned flags = dop->flags;
+    bool fpu = (op->val & 0xf000) == 0xf000;
+    bool r0_written = false;
+
+    if (((flags & DT_PR0) && pr) || ((flags & DT_PR1) && !pr) ||
+        ((flags & DT_R0_IDX) && !*r0_ok))
+        return false;
+
+    cpu_inst_param inst = op->val | (difftest_rand(rng) & ~op->mask & 0xffff);
+
+    if (flags & DT_ADDR_N) {
+        inst = (inst & ~0x0f00) | (difftest_ptr_reg(flags, *sz) << 8);
+    } else if (!(op->mask & 0x0f00) && !fpu) {
+        unsigned reg_no =
+            difftest_dst_regs[difftest_rand_below(rng, DIFFTEST_N_DST_REGS)];
+        inst = (inst & ~0x0f00) | (reg_no << 8);
+        r0_written = reg_no == 0;
+    }
+
+    if (flags & DT_ADDR_M)
+        inst = (inst & ~0x00f0) | (difftest_ptr_reg(flags, *sz) << 4);
+
+    if (pr && (flags & DT_DR_N))
+        inst &= ~0x0100;
+    if (pr && (flags & DT_DR_M))
+        inst &= ~0x0010;
+    if (*sz && (flags & DT_SZ_DR_N))
+        inst &= ~0x0100;
+    if (*sz && (flags & DT_SZ_DR_M))
+        inst &= ~0x0010;
+
+    // the random bits might have turned it into some other opcode
+    if (sh4_inst_lut[inst] != op)
+        return false;
+
+    if (r0_written || (flags & DT_W_R0))
+        *r0_ok = false;
+    if (flags & DT_SZ_FLIP)
+        *sz = !*sz;
+
+    *out = inst;
+    return true;
+}
+
+static reg32_t difftest_rand_float(uint64_t *rng) {
+    uint64_t bits = difftest_rand(rng);
+    if (!(bits & 3))
+        return bits >> 32;
+
+    // mostly stick to reasonable values so the arithmetic means something
+    float val = (float)((int)((bits >> 8) % 2001) - 1000) /
+        (float)(1 << ((bits >> 24) % 8));
+    reg32_t ret;
+    memcpy(&ret, &val, sizeof(ret));
+    return ret;
+}
+
+/*
+ * generate a random case with n_insts instructions.  If group isn't
+ * SH4_GROUP_NONE then only instructions from that group get used.
+ */
+static void difftest_case_init(struct difftest_case *tc, uint64_t *rng,
+                               sh4_inst_group_t group, unsigned n_insts) {
+    unsigned idx;
+
+    memset(tc, 0, sizeof(*tc));
+
+    // PR and SZ can't both be set
+    switch (difftest_rand_below(rng, 3)) {
+    case 1:
+        tc->pr = true;
+        break;
+    case 2:
+        tc->sz = true;
+        break;
+    }
+
+    for (idx = SH4_REG_R0; idx <= SH4_REG_R7_BANK; idx++)
+        tc->regs[idx] = difftest_rand(rng);
+    for (idx = SH4_REG_FR0; idx <= SH4_REG_XF15; idx++)
+        tc->regs[idx] = difftest_rand_float(rng);
+
+    tc->regs[SH4_REG_R0] = difftest_rand_below(rng, DIFFTEST_PTR_SPAN / 8 + 1) * 8;
+    for (idx = SH4_REG_R8; idx <= SH4_REG_R11; idx++) {
+        tc->regs[idx] = DIFFTEST_DATA_ADDR + DIFFTEST_PTR_FIRST +
+            difftest_rand_below(rng, DIFFTEST_PTR_SPAN / 8) * 8;
+    }
+
+    // round-to-nearest or round-to-zero, with denormals flushed to zero
+    tc->regs[SH4_REG_FPSCR] = SH4_FPSCR_DN_MASK |
+        (difftest_rand_below(rng, 2) << SH4_FPSCR_RM_SHIFT) |
+        (difftest_rand_below(rng, 2) << SH4_FPSCR_FR_SHIFT) |
+        (tc->pr ? SH4_FPSCR_PR_MASK : 0) | (tc->sz ? SH4_FPSCR_SZ_MASK : 0);
+    tc->regs[SH4_REG_FPUL] = difftest_rand(rng);
+
+    // privileged mode, register bank 0, interrupts blocked
+    tc->regs[SH4_REG_SR] = SH4_SR_MD_MASK | SH4_SR_BL_MASK | SH4_SR_IMASK_MASK |
+        (difftest_rand(rng) & (SH4_SR_FLAG_T_MASK | SH4_SR_FLAG_S_MASK |
+                               SH4_SR_Q_MASK | SH4_SR_M_MASK));
+
+    tc->regs[SH4_REG_SSR] = difftest_rand(rng);
+    tc->regs[SH4_REG_SPC] = difftest_rand(rng);
+    tc->regs[SH4_REG_GBR] = DIFFTEST_DATA_ADDR + DIFFTEST_GBR_OFFS;
+    tc->regs[SH4_REG_VBR] = difftest_rand(rng);
+    tc->regs[SH4_REG_SGR] = difftest_rand(rng);
+    tc->regs[SH4_REG_DBR] = difftest_rand(rng);
+    tc->regs[SH4_REG_MACH] = difftest_rand(rng);
+    tc->regs[SH4_REG_MACL] = difftest_rand(rng);
+    tc->regs[SH4_REG_PR] = difftest_rand(rng);
+    tc->regs[SH4_REG_PC] = DIFFTEST_CODE_ADDR;
+
+    for (idx = 0; idx < DIFFTEST_DATA_LEN; idx += sizeof(uint64_t)) {
+        uint64_t val = difftest_rand(rng);
+        memcpy(tc->data + idx, &val, sizeof(val));
+    }
+
+    bool sz = tc->sz, r0_ok = true;
+    for (tc->n_insts = 0; tc->n_insts < n_insts; tc->n_insts++) {
+        cpu_inst_param *inst = tc->insts + tc->n_insts;
+        unsigned tries;
+        for (tries = 0; tries < 1000; tries++) {
+            struct difftest_op const *dop =
+                difftest_ops + difftest_rand_below(rng, difftest_n_ops);
+            if (group != SH4_GROUP_NONE && dop->op->group != group)
+                continue;
+            if (difftest_gen_inst(dop, rng, tc->pr, &sz, &r0_ok, inst))
+                break;
+        }
+        if (tries >= 1000)
+            *inst = 0x0009; // NOP
+    }
+}
+
+static void difftest_il_cache_clear(struct difftest_il_cache *cache) {
+    unsigned idx;
+    for (idx = 0; idx < cache->n_blocks; idx++)
+        jit_code_block_cleanup(cache->blocks + idx, NULL);
+    cache->n_blocks = 0;
+}
+
+static void difftest_load_code(struct sh4_difftest_target const *tgt,
+                               struct difftest_case const *tc) {
+    uint16_t code[DIFFTEST_MAX_INSTS + DIFFTEST_TERM_LEN];
+    unsigned idx;
+
+    for (idx = 0; idx < tc->n_insts; idx++)
+        code[idx] = tc->insts[idx];
+    code[tc->n_insts] = 0xa000; // BRA to the instruction after the delay slot
+    code[tc->n_insts + 1] = 0x0009; // NOP
+
+    memory_write(tgt->ram, code, DIFFTEST_CODE_ADDR & ADDR_AREA3_MASK,
+                 sizeof(code[0]) * (tc->n_insts + DIFFTEST_TERM_LEN));
+
+    difftest_il_cache_clear(&difftest_il_cache);
+    if (tgt->native) {
+        code_cache_invalidate_all(tgt->native->code_cache);
+        code_cache_gc(tgt->native->code_cache);
+    }
+}
+
+static void difftest_load_state(struct sh4_difftest_target const *tgt,
+                                struct difftest_case const *tc) {
+    Sh4 *sh4 = tgt->sh4;
+
+    memcpy(sh4->reg, tc->regs, sizeof(tc->regs));
+    // this doesn't switch banks, it just sets the host's rounding mode
+    sh4_set_fpscr(sh4, sh4->reg[SH4_REG_FPSCR]);
+    sh4->delayed_branch = false;
+    sh4->dont_increment_pc = false;
+    sh4->last_inst_type = SH4_GROUP_NONE;
+
+    memory_write(tgt->ram, tc->data, DIFFTEST_DATA_ADDR & ADDR_AREA3_MASK,
+                 DIFFTEST_DATA_LEN);
+}
+
+static void difftest_save_state(struct sh4_difftest_target const *tgt,
+                                struct difftest_result *res) {
+    memcpy(res->regs, tgt->sh4->reg, sizeof(res->regs));
+    memory_read(tgt->ram, res->data, DIFFTEST_DATA_ADDR & ADDR_AREA3_MASK,
+                DIFFTEST_DATA_LEN);
+}
+
+static int difftest_run_interp(struct sh4_difftest_target const *tgt,
+                               addr32_t end_addr) {
+    Sh4 *sh4 = tgt->sh4;
+    unsigned n_steps;
+
+    for (n_steps = 0; n_steps < DIFFTEST_MAX_STEPS; n_steps++) {
+        if (sh4->reg[SH4_REG_PC] == end_addr)
+            return 0;
+        sh4_do_exec_inst(sh4);
+    }
+    return -1;
+}
+
+static int difftest_run_jit_intp(struct sh4_difftest_target const *tgt,
+                                 addr32_t end_addr) {
+    struct difftest_il_cache *cache = &difftest_il_cache;
+    Sh4 *sh4 = tgt->sh4;
+    unsigned n_steps;
+
+    for (n_steps = 0; n_steps < DIFFTEST_MAX_STEPS; n_steps++) {
+        addr32_t pc = sh4->reg[SH4_REG_PC];
+        if (pc == end_addr)
+            return 0;
+
+        jit_hash hash =
+            sh4_jit_hash(sh4, pc, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4));
+        unsigned blk_no;
+        for (blk_no = 0; blk_no < cache->n_blocks; blk_no++)
+            if (cache->hashes[blk_no] == hash)
+                break;
+        if (blk_no == cache->n_blocks) {
+            if (cache->n_blocks >= DIFFTEST_MAX_STEPS)
+                return -1;
+            jit_code_block_init(cache->blocks + blk_no, pc, NULL);
+            sh4_jit_compile_intp(sh4, cache->blocks + blk_no, pc);
+            cache->hashes[blk_no] = hash;
+            cache->n_blocks++;
+        }
+
+        sh4->reg[SH4_REG_PC] =
+            code_block_intp_exec(sh4, &cache->blocks[blk_no].intp);
+    }
+    return -1;
+}
+
+#ifdef ENABLE_JIT_X86_64
+static int difftest_run_native(struct sh4_difftest_target const *tgt,
+                               addr32_t end_addr) {
+    Sh4 *sh4 = tgt->sh4;
+    unsigned n_steps;
+
+    for (n_steps = 0; n_steps < DIFFTEST_MAX_STEPS; n_steps++) {
+        addr32_t pc = sh4->reg[SH4_REG_PC];
+        if (pc == end_addr)
+            return 0;
+
+        /*
+         * leave one cycle on the countdown so that the dispatcher comes back
+         * after every block instead of running off the end of the sequence.
+         */
+        clock_set_cycle_stamp(sh4->clk, clock_target_stamp(sh4->clk) - 1);
+        sh4->reg[SH4_REG_PC] = tgt->native->entry(pc,
+            sh4_jit_hash(sh4, pc, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4)));
+    }
+    return -1;
+}
+#endif
+
+static int difftest_run_backend(struct sh4_difftest_target const *tgt,
+                                enum difftest_backend backend,
+                                addr32_t end_addr) {
+    switch (backend) {
+    case DIFFTEST_INTERP:
+        return difftest_run_interp(tgt, end_addr);
+    case DIFFTEST_JIT_INTP:
+        return difftest_run_jit_intp(tgt, end_addr);
+#ifdef ENABLE_JIT_X86_64
+    case DIFFTEST_NATIVE:
+        return difftest_run_native(tgt, end_addr);
+#endif
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+static unsigned difftest_n_backends(struct sh4_difftest_target const *tgt) {
+    return tgt->native ? DIFFTEST_BACKEND_COUNT : DIFFTEST_NATIVE;
+}
+
+/*
+ * run the case on every backend.  Returns a bitmask of the backends which
+ * didn't match the interpreter.
+ */
+static unsigned difftest_run_case(struct sh4_difftest_target const *tgt,
+                                  struct difftest_case const *tc) {
+    addr32_t end_addr = DIFFTEST_END_ADDR(tc->n_insts);
+    unsigned backend, mismatch = 0;
+
+    difftest_load_code(tgt, tc);
+
+    for (backend = 0; backend < difftest_n_backends(tgt); backend++) {
+        struct difftest_result *res = difftest_results + backend;
+        difftest_load_state(tgt, tc);
+        res->status = difftest_run_backend(tgt, backend, end_addr);
+        difftest_save_state(tgt, res);
+
+        if (backend != DIFFTEST_INTERP &&
+            (res->status != difftest_results[DIFFTEST_INTERP].status ||
+             memcmp(res->regs, difftest_results[DIFFTEST_INTERP].regs,
+                    sizeof(res->regs)) != 0 ||
+             memcmp(res->data, difftest_results[DIFFTEST_INTERP].data,
+                    sizeof(res->data)) != 0)) {
+            mismatch |= 1 << backend;
+        }
+    }
+
+    return mismatch;
+}
+
+/*
+ * find the shortest prefix of tc that still doesn't match, and leave tc and
+ * difftest_results set up for that prefix.  The mismatch can't be pinned on
+ * any single instruction, but the last one in the prefix is the prime suspect.
+ */
+static unsigned difftest_shrink_case(struct sh4_difftest_target const *tgt,
+                                     struct difftest_case *tc) {
+    unsigned n_insts = tc->n_insts, mismatch = 0;
+
+    for (tc->n_insts = 1; tc->n_insts < n_insts; tc->n_insts++)
+        if ((mismatch = difftest_run_case(tgt, tc)))
+            return mismatch;
+
+    return difftest_run_case(tgt, tc);
+}
+
+static void difftest_reg_name(unsigned reg_no, char *buf, size_t len) {
+    static char const *const names[] = {
+        "FPSCR", "FPUL", "SR", "SSR", "SPC", "GBR", "VBR", "SGR", "DBR",
+        "MACH", "MACL", "PR", "PC"
+    };
+
+    if (reg_no <= SH4_REG_R15)
+        snprintf(buf, len, "R%u", reg_no - SH4_REG_R0);
+    else if (reg_no <= SH4_REG_R7_BANK)
+        snprintf(buf, len, "R%u_BANK", reg_no - SH4_REG_R0_BANK);
+    else if (reg_no <= SH4_REG_FR15)
+        snprintf(buf, len, "FR%u", reg_no - SH4_REG_FR0);
+    else if (reg_no <= SH4_REG_XF15)
+        snprintf(buf, len, "XF%u", reg_no - SH4_REG_XF0);
+    else
+        snprintf(buf, len, "%s", names[reg_no - SH4_REG_FPSCR]);
+}
+
+static void difftest_report_case(washdc_hostfile out, unsigned case_no,
+                                 struct difftest_case const *tc,
+                                 unsigned mismatch) {
+    struct difftest_result const *expect = difftest_results + DIFFTEST_INTERP;
+    InstOpcode const *last = sh4_inst_lut[tc->insts[tc->n_insts - 1]];
+    char code[6 * DIFFTEST_MAX_INSTS + 1];
+    unsigned idx, backend;
+
+    for (idx = 0; idx < tc->n_insts; idx++)
+        snprintf(code + 5 * idx, sizeof(code) - 5 * idx, " %04x",
+                 (unsigned)tc->insts[idx]);
+
+    washdc_hostfile_printf(out, "case %u (pr=%d sz=%d):%s\n", case_no,
+                           (int)tc->pr, (int)tc->sz, code);
+    washdc_hostfile_printf(out, "    last instruction is opcode %04x/%04x "
+                           "(group %s)\n", (unsigned)last->val,
+                           (unsigned)last->mask,
+                           difftest_group_names[last->group]);
+
+    for (backend = 0; backend < DIFFTEST_BACKEND_COUNT; backend++) {
+        if (!(mismatch & (1 << backend)))
+            continue;
+
+        struct difftest_result const *res = difftest_results + backend;
+        char const *name = difftest_backend_names[backend];
+
+        if (res->status != expect->status) {
+            washdc_hostfile_printf(out, "    %s %s the end of the sequence "
+                                   "but the interpreter %s\n", name,
+                                   res->status ? "didn't reach" : "reached",
+                                   expect->status ? "didn't" : "did");
+        }
+
+        for (idx = 0; idx < DIFFTEST_N_REGS; idx++) {
+            if (res->regs[idx] != expect->regs[idx]) {
+                char reg_name[16];
+                difftest_reg_name(idx, reg_name, sizeof(reg_name));
+                washdc_hostfile_printf(out, "    %-8s interpreter %08x "
+                                       "%s %08x\n", reg_name,
+                                       (unsigned)expect->regs[idx], name,
+                                       (unsigned)res->regs[idx]);
+            }
+        }
+
+        unsigned n_bytes = 0, first = 0;
+        for (idx = 0; idx < DIFFTEST_DATA_LEN; idx++) {
+            if (res->data[idx] != expect->data[idx] && !n_bytes++)
+                first = idx;
+        }
+        if (n_bytes) {
+            washdc_hostfile_printf(out, "    %u byte(s) of memory differ, "
+                                   "first at %08x (interpreter %02x %s %02x)\n",
+                                   n_bytes, DIFFTEST_DATA_ADDR + first,
+                                   (unsigned)expect->data[first], name,
+                                   (unsigned)res->data[first]);
+        }
+    }
+}
+
+struct difftest_timing {
+    // time spent executing, not counting the time it takes to reset state
+    uint64_t exec_ns[DIFFTEST_BACKEND_COUNT];
+
+    // time spent on the first run of each sequence (includes jit compilation)
+    uint64_t first_ns[DIFFTEST_BACKEND_COUNT];
+
+    unsigned n_seqs;
+};
+
+static void difftest_time_group(struct sh4_difftest_target const *tgt,
+                                sh4_inst_group_t group, uint64_t seed,
+                                struct difftest_timing *timing) {
+    struct difftest_case *tc = &difftest_case;
+    unsigned seq_no, backend, rep;
+
+    memset(timing, 0, sizeof(*timing));
+
+    for (seq_no = 0; seq_no < DIFFTEST_TIMING_SEQS; seq_no++) {
+        uint64_t rng = seed ^ (((uint64_t)group << 8 | seq_no) << 32);
+        addr32_t end_addr = DIFFTEST_END_ADDR(DIFFTEST_TIMING_LEN);
+
+        difftest_case_init(tc, &rng, group, DIFFTEST_TIMING_LEN);
+        difftest_load_code(tgt, tc);
+
+        for (backend = 0; backend < difftest_n_backends(tgt); backend++) {
+            uint64_t start, exec_ns, reset_ns;
+
+            difftest_load_state(tgt, tc);
+            start = difftest_now_ns();
+            difftest_run_backend(tgt, backend, end_addr);
+            timing->first_ns[backend] += difftest_now_ns() - start;
+
+            start = difftest_now_ns();
+            for (rep = 0; rep < DIFFTEST_TIMING_REPS; rep++) {
+                difftest_load_state(tgt, tc);
+                difftest_run_backend(tgt, backend, end_addr);
+            }
+            exec_ns = difftest_now_ns() - start;
+
+            start = difftest_now_ns();
+            for (rep = 0; rep < DIFFTEST_TIMING_REPS; rep++)
+                difftest_load_state(tgt, tc);
+            reset_ns = difftest_now_ns() - start;
+
+            if (exec_ns > reset_ns)
+                timing->exec_ns[backend] += exec_ns - reset_ns;
+        }
+        timing->n_seqs++;
+    }
+}
+
+static void difftest_report_timing(struct sh4_difftest_target const *tgt,
+                                   washdc_hostfile out, unsigned seed) {
+    static sh4_inst_group_t const groups[] = {
+        SH4_GROUP_MT, SH4_GROUP_EX, SH4_GROUP_LS, SH4_GROUP_FE, SH4_GROUP_CO
+    };
+    unsigned group_no, backend, n_backends = difftest_n_backends(tgt);
+
+    washdc_hostfile_printf(out, "\ntiming: %u sequences of %u instructions "
+                           "per group (plus BRA/NOP), %u runs each\n",
+                           DIFFTEST_TIMING_SEQS, DIFFTEST_TIMING_LEN,
+                           DIFFTEST_TIMING_REPS);
+    washdc_hostfile_printf(out, "the first %u columns are ns per "
+                           "instruction, the rest are how much longer the "
+                           "first run of a sequence took in us (compiling)\n",
+                           n_backends);
+    washdc_hostfile_printf(out, "group");
+    for (backend = 0; backend < n_backends; backend++)
+        washdc_hostfile_printf(out, " %12s", difftest_backend_names[backend]);
+    for (backend = DIFFTEST_JIT_INTP; backend < n_backends; backend++)
+        washdc_hostfile_printf(out, " %12s", difftest_backend_names[backend]);
+    washdc_hostfile_printf(out, "\n");
+
+    for (group_no = 0; group_no < sizeof(groups) / sizeof(groups[0]);
+         group_no++) {
+        struct difftest_timing timing;
+        unsigned op_no;
+
+        for (op_no = 0; op_no < difftest_n_ops; op_no++)
+            if (difftest_ops[op_no].op->group == groups[group_no])
+                break;
+        if (op_no == difftest_n_ops)
+            continue;
+
+        difftest_time_group(tgt, groups[group_no], seed, &timing);
+
+        double n_runs = (double)timing.n_seqs * DIFFTEST_TIMING_REPS;
+        double n_insts = n_runs * (DIFFTEST_TIMING_LEN + DIFFTEST_TERM_LEN);
+
+        washdc_hostfile_printf(out, "%-5s", difftest_group_names[groups[group_no]]);
+        for (backend = 0; backend < n_backends; backend++) {
+            washdc_hostfile_printf(out, " %12.2f",
+                                   timing.exec_ns[backend] / n_insts);
+        }
+        for (backend = DIFFTEST_JIT_INTP; backend < n_backends; backend++) {
+            double first_us = timing.first_ns[backend] / 1000.0 /
+                timing.n_seqs;
+            double run_us = timing.exec_ns[backend] / 1000.0 / n_runs;
+            washdc_hostfile_printf(out, " %12.2f", first_us - run_us);
+        }
+        washdc_hostfile_printf(out, "\n");
+    }
+}
+
+unsigned sh4_difftest_run(struct sh4_difftest_target const *tgt,
+                          char const *report_path, unsigned n_cases,
+                          unsigned seed) {
+    struct difftest_case *tc = &difftest_case;
+    unsigned case_no, n_mismatch = 0, backend, op_no;
+
+    washdc_hostfile out = washdc_hostfile_open(report_path,
+                                               WASHDC_HOSTFILE_WRITE |
+                                               WASHDC_HOSTFILE_TEXT);
+    if (out == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open SH4 difftest report \"%s\"\n", report_path);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    difftest_build_op_list();
+
+    washdc_hostfile_printf(out, "SH4 backend differential test: seed %u, "
+                           "%u cases, %u opcodes\nbackends:", seed, n_cases,
+                           difftest_n_ops);
+    for (backend = 0; backend < difftest_n_backends(tgt); backend++)
+        washdc_hostfile_printf(out, " %s", difftest_backend_names[backend]);
+    if (!tgt->native)
+        washdc_hostfile_printf(out, " (native jit not enabled)");
+    washdc_hostfile_printf(out, "\n\n");
+
+    LOG_INFO("running %u SH4 difftest cases with seed %u\n", n_cases, seed);
+
+    for (case_no = 0; case_no < n_cases; case_no++) {
+        uint64_t rng = ((uint64_t)seed << 32) | case_no;
+        difftest_case_init(tc, &rng, SH4_GROUP_NONE,
+                           1 + difftest_rand_below(&rng, DIFFTEST_MAX_INSTS));
+
+        if (!difftest_run_case(tgt, tc))
+            continue;
+
+        n_mismatch++;
+        unsigned mismatch = difftest_shrink_case(tgt, tc);
+        if (!mismatch) {
+            washdc_hostfile_printf(out, "case %u didn't match the first time "
+                                   "but did when it was run again\n", case_no);
+            continue;
+        }
+
+        struct difftest_op *suspect =
+            difftest_find_op(tc->insts[tc->n_insts - 1]);
+        if (suspect)
+            suspect->n_suspect++;
+
+        if (n_mismatch <= DIFFTEST_MAX_REPORTS)
+            difftest_report_case(out, case_no, tc, mismatch);
+    }
+
+    if (n_mismatch > DIFFTEST_MAX_REPORTS) {
+        washdc_hostfile_printf(out, "(%u more mismatching cases not shown)\n",
+                               n_mismatch - DIFFTEST_MAX_REPORTS);
+    }
+
+    washdc_hostfile_printf(out, "%s%u of %u cases didn't match\n",
+                           n_mismatch ? "\n" : "", n_mismatch, n_cases);
+    for (op_no = 0; op_no < difftest_n_ops; op_no++) {
+        struct difftest_op const *dop = difftest_ops + op_no;
+        if (dop->n_suspect) {
+            washdc_hostfile_printf(out, "    opcode %04x/%04x ended %u of "
+                                   "them\n", (unsigned)dop->op->val,
+                                   (unsigned)dop->op->mask, dop->n_suspect);
+        }
+    }
+
+    difftest_report_timing(tgt, out, seed);
+
+    difftest_il_cache_clear(&difftest_il_cache);
+    washdc_hostfile_close(out);
+
+    LOG_INFO("SH4 difftest: %u of %u cases didn't match; report written to "
+             "\"%s\"\n", n_mismatch, n_cases, report_path);
+
+    return n_mismatch;
+}
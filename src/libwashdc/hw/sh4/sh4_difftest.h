@@ -0,0 +1,74 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef SH4_DIFFTEST_H_
+#define SH4_DIFFTEST_H_
+
+/*
+ * Differential tester for the SH4 CPU backends.
+ *
+ * This generates random straight-line instruction sequences out of the
+ * interpreter's opcode list (sh4_inst_lut) and runs each one on the
+ * interpreter (sh4_do_exec_inst), the jit's IL interpreter
+ * (code_block_intp_exec) and the native x86_64 jit (if it's enabled), starting
+ * from the same register and memory state every time.  Anything that doesn't
+ * match the interpreter afterwards gets written to the report along with the
+ * shortest prefix of the sequence that still doesn't match.
+ *
+ * After that each backend gets timed on sequences drawn from only one
+ * instruction group (MT, EX, LS, FE, CO) at a time.
+ *
+ * Branches, anything PC-relative, the handful of instructions which would
+ * change SR, GBR or FPSCR out from under the tester (or hang the CPU) and
+ * forms which the interpreter doesn't implement are never generated.  Memory accesses always go through one of R8-R11 (or GBR), which
+ * point into a scratch buffer in main memory, so R8-R11 never get picked as
+ * destination registers.
+ *
+ * This takes over the SH4, main memory and the SH4's code cache, so it's meant
+ * to be run right after dreamcast_init instead of dreamcast_run.
+ */
+
+#include "sh4.h"
+
+struct Memory;
+struct native_dispatch_meta;
+
+struct sh4_difftest_target {
+    Sh4 *sh4;
+
+    // main system memory, for loading code and scratch data
+    struct Memory *ram;
+
+    // the native jit's dispatcher, or NULL if the native jit isn't enabled
+    struct native_dispatch_meta const *native;
+};
+
+/*
+ * run n_cases random sequences and then the timing test, and write a report
+ * to report_path.  Returns the number of cases where the backends disagreed.
+ */
+unsigned sh4_difftest_run(struct sh4_difftest_target const *tgt,
+                          char const *report_path, unsigned n_cases,
+                          unsigned seed);
+
+#endif
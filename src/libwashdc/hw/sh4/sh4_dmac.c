@@ -36,6 +36,7 @@
 #include "dc_sched.h"
 #include "dreamcast.h"
 #include "sh4_read_inst.h"
+#include "trace.h"
 
 static void raise_ch2_dma_int_event_handler(struct SchedEvent *event);
 
@@ -517,6 +518,7 @@ void sh4_dmac_channel2(Sh4 *sh4, addr32_t transfer_dst, unsigned n_bytes) {
 
     LOG_DBG("SH4 - initiating %u-byte DMA transfer from 0x%08x to "
             "0x%08x\n", n_bytes, transfer_src, transfer_dst);
+    TRACE_DMA(TRACE_DMA_SH4_CH2, transfer_src, transfer_dst, n_bytes);
 
     sh4->dmac.sar_pending[2] = transfer_src + n_bytes;
 
@@ -40,6 +40,7 @@
 #endif
 
 #include "washdc/hostfile.h"
+#include "trace.h"
 
 static jit_hash sh4_jit_hash_wrapper(void *sh4, uint32_t addr);
 
@@ -50,6 +51,10 @@ void sh4_jit_set_native_dispatch_meta(struct native_dispatch_meta *meta) {
 #endif
     meta->on_compile = sh4_jit_compile_native;
     meta->hash_func = sh4_jit_hash_wrapper;
+#ifdef ENABLE_TRACE
+    meta->trace_block = TRACE_ON(TRACE_CAT_BLOCK) ? trace_block : NULL;
+#endif
+    meta->sample_cur = jit_sample_enabled() ? &jit_sample_cur : NULL;
 }
 #endif
 
@@ -332,6 +337,28 @@ sh4_jit_compile_inst(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return inst_op->disas(sh4, ctx, block, pc, inst_op, inst);
 }
 
+void sh4_jit_end_block(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                       struct il_code_block *block, addr32_t addr) {
+    unsigned addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    jit_set_slot(block, addr_slot, addr);
+
+    unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    if (ctx->dirty_fpscr) {
+        unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
+                                       WASHDC_JIT_SLOT_GEN);
+        sh4_jit_hash_slot(sh4, block, addr_slot, hash_slot, fpscr_slot);
+        free_slot(block, fpscr_slot);
+    } else {
+        sh4_jit_hash_slot_known_fpscr(sh4, ctx, block, addr_slot, hash_slot);
+    }
+
+    res_drain_all_regs(sh4, ctx, block);
+    jit_jump(block, addr_slot, hash_slot);
+
+    free_slot(block, hash_slot);
+    free_slot(block, addr_slot);
+}
+
 bool
 sh4_jit_fallback(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                  struct il_code_block *block, unsigned pc,
@@ -1304,8 +1331,18 @@ bool sh4_jit_movb_rm_amrn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
     unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
 
-    jit_add_const32(block, slot_dst, -1);
-    jit_write_8_slot(block, sh4->mem.map, slot_src, slot_dst);
+    /*
+     * write through a copy of the address so that the old value gets written
+     * when reg_src and reg_dst are the same register.
+     */
+    unsigned slot_dstaddr = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_mov(block, slot_dst, slot_dstaddr);
+    jit_add_const32(block, slot_dstaddr, -1);
+    jit_write_8_slot(block, sh4->mem.map, slot_src, slot_dstaddr);
+    jit_mov(block, slot_dstaddr, slot_dst);
+
+    free_slot(block, slot_dstaddr);
 
     reg_map[reg_dst].stat = REG_STATUS_SLOT;
 
@@ -1342,8 +1379,18 @@ bool sh4_jit_movl_rm_amrn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
     unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
 
-    jit_add_const32(block, slot_dst, -4);
-    jit_write_32_slot(block, sh4->mem.map, slot_src, slot_dst);
+    /*
+     * write through a copy of the address so that the old value gets written
+     * when reg_src and reg_dst are the same register.
+     */
+    unsigned slot_dstaddr = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_mov(block, slot_dst, slot_dstaddr);
+    jit_add_const32(block, slot_dstaddr, -4);
+    jit_write_32_slot(block, sh4->mem.map, slot_src, slot_dstaddr);
+    jit_mov(block, slot_dstaddr, slot_dst);
+
+    free_slot(block, slot_dstaddr);
 
     reg_map[reg_dst].stat = REG_STATUS_SLOT;
     reg_map[reg_src].stat = REG_STATUS_SLOT;
@@ -33,15 +33,25 @@
 #include "jit/code_block.h"
 #include "jit/optimize.h"
 #include "jit/code_cache.h"
+#include "jit/jit_sample.h"
+#include "bench.h"
 
 #ifdef JIT_PROFILE
 #include "jit/jit_profile.h"
 #endif
 
+#ifdef ENABLE_DEBUGGER
+#include "washdc/debugger.h"
+#endif
+
 #ifdef ENABLE_JIT_X86_64
 #include "jit/x86_64/code_block_x86_64.h"
 #endif
 
+#ifdef ENABLE_JIT_PERF
+#include "jit/x86_64/jit_perf.h"
+#endif
+
 struct InstOpcode;
 struct il_code_block;
 struct Sh4;
@@ -91,6 +101,13 @@ sh4_jit_compile_inst(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                      struct il_code_block *block, cpu_inst_param inst,
                      unsigned pc);
 
+/*
+ * end the block with a jump to addr, which is the address of the next
+ * instruction that would have been compiled.
+ */
+void sh4_jit_end_block(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                       struct il_code_block *block, addr32_t addr);
+
 static inline void
 sh4_jit_il_code_block_compile(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                               struct jit_code_block *jit_blk,
@@ -110,6 +127,18 @@ sh4_jit_il_code_block_compile(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
 
         do_continue = sh4_jit_compile_inst(sh4, ctx, block, inst, addr);
         addr += 2;
+
+#ifdef ENABLE_DEBUGGER
+        /*
+         * make sure that instructions with breakpoints on them are always at
+         * the beginning of a block so that the debugger can catch them.
+         * Breakpoints in delay slots can't be caught this way.
+         */
+        if (do_continue && debug_is_break(DEBUG_CONTEXT_SH4, addr)) {
+            sh4_jit_end_block(sh4, ctx, block, addr);
+            do_continue = false;
+        }
+#endif
     } while (do_continue);
 }
 
@@ -138,6 +167,20 @@ sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
         .have_reg_slot = false
     };
 
+#ifdef ENABLE_DEBUGGER
+    /*
+     * a block that starts on a breakpoint returns to the debugger without
+     * executing anything.  The debugger will then single-step over the
+     * breakpoint in the interpreter.
+     */
+    if (debug_is_break(DEBUG_CONTEXT_SH4, pc)) {
+        code_block_x86_64_compile_break(blk, meta, pc);
+        return;
+    }
+#endif
+
+    bench_push(BENCH_CAT_JIT_COMPILE);
+
     il_code_block_init(&il_blk);
 
 #ifdef JIT_PROFILE
@@ -166,7 +209,17 @@ sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
                                  blk->bytes_used - wasted_bytes, blk->native);
 #endif
 
+#ifdef ENABLE_JIT_PERF
+    jit_perf_publish("sh4", pc, blk->exec_mem_alloc_start, blk->bytes_used,
+                     &il_blk);
+#endif
+    jit_sample_on_compile(sh4_jit_hash(cpu, pc, sh4_fpscr_pr(sh4),
+                                       sh4_fpscr_sz(sh4)), pc,
+                          ctx.cycle_count, &il_blk);
+
     il_code_block_cleanup(&il_blk);
+
+    bench_pop();
 }
 #endif
 
@@ -186,6 +239,8 @@ sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
         .have_reg_slot = false
     };
 
+    bench_push(BENCH_CAT_JIT_COMPILE);
+
     il_code_block_init(&il_blk);
 
 #ifdef JIT_PROFILE
@@ -205,7 +260,12 @@ sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
 #endif
 
     code_block_intp_compile(cpu, blk, &il_blk, ctx.cycle_count * SH4_CLOCK_SCALE);
+    jit_sample_on_compile(sh4_jit_hash(cpu, pc, sh4_fpscr_pr(sh4),
+                                       sh4_fpscr_sz(sh4)), pc,
+                          ctx.cycle_count, &il_blk);
     il_code_block_cleanup(&il_blk);
+
+    bench_pop();
 }
 
 /*
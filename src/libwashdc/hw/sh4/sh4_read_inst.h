@@ -37,6 +37,7 @@
 #include "intmath.h"
 #include "log.h"
 #include "sh4_mem.h"
+#include "trace.h"
 
 #ifdef DEEP_SYSCALL_TRACE
 #include "deep_syscall_trace.h"
@@ -44,6 +45,8 @@
 
 static inline void
 sh4_enter_irq_from_meta(Sh4 *sh4, struct sh4_irq_meta *irq_meta) {
+    TRACE_IRQ(TRACE_IRQ_SH4, irq_meta->code);
+
     sh4->reg[SH4_REG_INTEVT] =
         (irq_meta->code << SH4_INTEVT_CODE_SHIFT) &
         SH4_INTEVT_CODE_MASK;
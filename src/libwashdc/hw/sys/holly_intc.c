@@ -26,6 +26,7 @@
 #include "hw/sh4/sh4_read_inst.h"
 #include "dreamcast.h"
 #include "log.h"
+#include "trace.h"
 
 #include "holly_intc.h"
 
@@ -118,6 +119,8 @@ void holly_raise_nrm_int(HollyNrmInt int_type) {
 
     reg_istnrm |= mask;
 
+    TRACE_IRQ(TRACE_IRQ_HOLLY_NRM, int_type);
+
     sh4_refresh_intc(dreamcast_get_cpu());
 }
 
@@ -133,6 +136,8 @@ void holly_raise_ext_int(HollyExtInt int_type) {
 
     reg_istext |= mask;
 
+    TRACE_IRQ(TRACE_IRQ_HOLLY_EXT, int_type);
+
     sh4_refresh_intc(dreamcast_get_cpu());
 }
 
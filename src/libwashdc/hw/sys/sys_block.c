@@ -32,6 +32,7 @@
 #include "mmio.h"
 #include "hw/pvr2/pvr2_ta.h"
 #include "intmath.h"
+#include "bench.h"
 
 #include "sys_block.h"
 
@@ -265,6 +266,8 @@ static void sdst_reg_write_handler(struct mmio_region_sys_block *region,
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
 
+        bench_push(BENCH_CAT_TA);
+
         uint32_t link_addr = memory_read_32(link_table_start & MEMORY_MASK,
                                             main_memory);
 
@@ -283,6 +286,8 @@ static void sdst_reg_write_handler(struct mmio_region_sys_block *region,
             link_addr = sort_dma_process_link(ctxt, link_addr, link_base);
         }
 
+        bench_pop();
+
         // end of DMA
         LOG_DBG("END OF SORT-DMA; FINAL LINK TABLE START IS %08X\n",
                   (unsigned)link_table_start);
@@ -93,9 +93,26 @@ int(*memory_map_try_write16_func)(uint32_t addr, uint16_t val, void *ctxt);
 typedef
 int(*memory_map_try_write8_func)(uint32_t addr, uint8_t val, void *ctxt);
 
+/*
+ * optional block-transfer handlers.  These copy len bytes starting at addr in
+ * one go instead of going through the per-type handlers one unit at a time.
+ * They're used by the debugger to service large memory dumps and loads.
+ *
+ * return 0 on success, nonzero on error
+ */
+typedef
+int(*memory_map_read_raw_func)(uint32_t addr, void *buf,
+                               unsigned len, void *ctxt);
+typedef
+int(*memory_map_write_raw_func)(uint32_t addr, void const *buf,
+                                unsigned len, void *ctxt);
+
 enum memory_map_region_id {
     MEMORY_MAP_REGION_UNKNOWN,
-    MEMORY_MAP_REGION_RAM
+    MEMORY_MAP_REGION_RAM,
+
+    // hardware registers; accesses to these show up in execution traces
+    MEMORY_MAP_REGION_MMIO
 };
 
 struct memory_interface {
@@ -127,6 +144,9 @@ struct memory_interface {
     memory_map_try_write32_func try_write32;
     memory_map_try_write16_func try_write16;
     memory_map_try_write8_func try_write8;
+
+    memory_map_read_raw_func read_raw;
+    memory_map_write_raw_func write_raw;
 };
 
 struct memory_map_region {
@@ -230,6 +250,22 @@ memory_map_try_read_float(struct memory_map *map, uint32_t addr, float *val);
 int
 memory_map_try_read_double(struct memory_map *map, uint32_t addr, double *val);
 
+/*
+ * Copy len bytes between buf and the memory map in a single operation.  This
+ * only works when the entire range falls within one region which implements
+ * read_raw/write_raw; otherwise it returns nonzero without touching anything
+ * and the caller should fall back to memory_map_try_read_* /
+ * memory_map_try_write_*.
+ *
+ * Like the other try functions, these do not check for watchpoints.
+ */
+int
+memory_map_try_read_raw(struct memory_map *map, uint32_t addr,
+                        void *buf, unsigned len);
+int
+memory_map_try_write_raw(struct memory_map *map, uint32_t addr,
+                         void const *buf, unsigned len);
+
 static inline struct memory_map_region *
 memory_map_get_region(struct memory_map *map,
                       uint32_t first_addr, unsigned n_bytes) {
@@ -71,6 +71,13 @@ enum debug_state {
      */
     DEBUG_STATE_POST_WATCH,
 
+    /*
+     * the debugger rewound the system to an older snapshot and is letting it
+     * run forward one instruction at a time until it gets to where a
+     * reverse-step or reverse-continue should stop (see dbg/dbg_rewind.h).
+     */
+    DEBUG_STATE_REPLAY,
+
     DEBUG_STATE_COUNT
 };
 
@@ -210,6 +217,26 @@ void debug_on_softbreak(cpu_inst_param inst, addr32_t pc);
 int debug_add_break(enum dbg_context_id id, addr32_t addr);
 int debug_remove_break(enum dbg_context_id id, addr32_t addr);
 
+// returns true if there is a breakpoint at addr
+bool debug_is_break(enum dbg_context_id id, addr32_t addr);
+
+/*
+ * returns true if the given context is allowed to run through the JIT instead
+ * of being single-stepped through the interpreter.  This is only the case
+ * when the debugger is not stepping or stopped, and there are no conditions
+ * that need to be checked after every instruction.
+ *
+ * Breakpoints don't prevent the JIT from running.  The JIT ends its code
+ * blocks right before any instruction that has a breakpoint on it, and the
+ * caller needs to check debug_is_break at the beginning of every block and
+ * single-step if it's true.
+ *
+ * Watchpoints don't prevent the JIT from running either, but when one gets
+ * triggered from JIT code the debugger doesn't stop until the end of the
+ * block.
+ */
+bool debug_can_jit(enum dbg_context_id id);
+
 // these functions return 0 on success, nonzer on failure
 int debug_add_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len);
 int debug_remove_r_watch(enum dbg_context_id id, addr32_t addr, unsigned len);
@@ -224,6 +251,44 @@ debug_is_w_watch(addr32_t addr, unsigned len);
 bool
 debug_is_r_watch(addr32_t addr, unsigned len);
 
+#ifdef ENABLE_WATCHPOINTS
+/*
+ * Every context has a map with one byte for each 4KB page of its address
+ * space which says whether that page has any read or write watchpoints on it.
+ * Code which reads and writes memory without going through the memory map
+ * (like the JIT's inlined RAM accesses) needs to check this and go through
+ * the memory map for pages that are being watched.
+ *
+ * Addresses are ANDed with DEBUG_WATCH_ADDR_MASK before they get looked up,
+ * so the same page can show up in more than one place in the address space.
+ * That's fine since the memory map still checks the exact address.
+ */
+#define DEBUG_WATCH_PAGE_SHIFT 12
+#define DEBUG_WATCH_ADDR_MASK 0x1fffffff
+#define DEBUG_WATCH_N_PAGES \
+    ((DEBUG_WATCH_ADDR_MASK >> DEBUG_WATCH_PAGE_SHIFT) + 1)
+
+#define DEBUG_WATCH_PAGE_R 1
+#define DEBUG_WATCH_PAGE_W 2
+
+uint8_t const *debug_watch_pages(enum dbg_context_id id);
+
+/*
+ * returns true if any of the pages touched by the given addr and len have
+ * watchpoints of the given type (DEBUG_WATCH_PAGE_R or DEBUG_WATCH_PAGE_W).
+ */
+bool debug_is_watch_page(enum dbg_context_id id, addr32_t addr,
+                         unsigned len, unsigned type);
+
+/*
+ * returns a pointer to a flag which is nonzero whenever the given context is
+ * not in DEBUG_STATE_NORM.  The native JIT checks this at the end of every
+ * code block so that it can return to the debugger right after a block
+ * triggers a watchpoint.
+ */
+int const *debug_jit_break_flag(enum dbg_context_id id);
+#endif
+
 /*
  * called by the dreamcast code to notify the debugger that a new instruction
  * is about to execute.  This should check for hardware breakpoints and set the
@@ -242,6 +307,30 @@ void debug_request_continue(void);
  */
 void debug_request_single_step(void);
 
+/*
+ * called by the gdb_stub or washdbg to step backwards by one SH4 instruction
+ * (see dbg/dbg_rewind.h).  If the previous instruction isn't a snapshot, this
+ * goes back to the snapshot before it and replays forward, which can take a
+ * while.  The frontend's on_break callback gets called once the rewind is
+ * done, even if there was no history to rewind to.
+ *
+ * Only the two CPUs, main system memory and AICA wave memory get rewound.
+ * Everything else (the scheduler, timers, TA/PVR2 state, AICA channel and DSP
+ * registers, GD-ROM, Maple, etc) stays as it is, so execution after a rewind
+ * can go differently than it did the first time.  For the same reason a replay
+ * can fail to find its way back, in which case it stops at the snapshot it
+ * started from.  In the ARM7 context this only goes back to the previous
+ * snapshot, since replay follows the SH4.
+ */
+void debug_request_reverse_step(void);
+
+/*
+ * go backwards to the last time the SH4 was about to execute an instruction
+ * with a breakpoint on it, or to the oldest snapshot if there isn't one.  This
+ * replays through as much history as it needs to.
+ */
+void debug_request_reverse_continue(void);
+
 /*
  * called by the gdb_stub to tell the debugger that the remote gdb frontend is
  * detaching.  This clears out break points and such.
@@ -258,7 +347,9 @@ void debug_request_break(void);
 /*
  * These functions can be called from any thread.  debug_signal will wake up
  * the emulation thread when it is blocking on a debugging-related event.
- * debug_lock must be held when you call debug_signal.
+ * Debugger frontends should call it whenever they have new input for their
+ * run_once callback to process.  The debug_request_* functions call it for
+ * you.
  */
 void debug_lock(void);
 void debug_unlock(void);
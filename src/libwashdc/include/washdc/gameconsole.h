@@ -153,7 +153,8 @@ void washdc_gameconsole_texinfo_var(struct washdc_gameconsole const *cons,
 void washdc_gameconsole_inject_irq(struct washdc_gameconsole const *cons,
                                    char const *irq_id);
 
-void washdc_dump_main_memory(char const *path);
+struct washdc_instance;
+void washdc_dump_main_memory(struct washdc_instance *inst, char const *path);
 
 
 #ifdef __cplusplus
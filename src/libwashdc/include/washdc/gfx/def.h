@@ -24,26 +24,28 @@
 #define WASHDC_GFX_DEF_H_
 
 #include <assert.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /*
- * offsets to vertex components within the vert array.
- * these are in terms of sizeof(float)
+ * a single vertex, as it is passed from the TA to the renderer.
+ *
+ * This is packed so that the renderer can upload the TA's vertex array as-is.
+ * Positions and texture coordinates are floats, colors are unsigned normalized
+ * bytes in RGBA order.
  */
-#define GFX_VERT_POS_OFFSET 0
-#define GFX_VERT_BASE_COLOR_OFFSET 3
-#define GFX_VERT_OFFS_COLOR_OFFSET 7
-#define GFX_VERT_TEX_COORD_OFFSET 11
+struct gfx_vert {
+    float pos[3];
+    uint8_t base_color[4];
+    uint8_t offs_color[4];
+    float tex_coord[2];
+};
 
-/*
- * the number of elements per vertex.  Currently this means 3 floats for the
- * coordinates, 4 floats for the base color, 4 floats for the offset color and
- * two floats for the texture coordinates
- */
-#define GFX_VERT_LEN 13
+static_assert(sizeof(struct gfx_vert) == 28,
+              "struct gfx_vert is expected to be tightly packed");
 
 /*
  * how to combine a polygon's vertex color with a texture
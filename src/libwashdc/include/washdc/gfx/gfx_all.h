@@ -56,7 +56,15 @@ struct rend_if {
 
     void (*set_clip_range)(float clip_min, float clip_max);
 
-    void (*draw_array)(float const *verts, unsigned n_verts);
+    /*
+     * set the vertex array used by draw_array.  This is called once per
+     * frame before any polygons are drawn, and the array remains valid until
+     * the end of the frame.
+     */
+    void (*set_vert_array)(struct gfx_vert const *verts, unsigned n_verts);
+
+    // draw n_verts vertices starting at first_vert in the vertex array
+    void (*draw_array)(unsigned first_vert, unsigned n_verts);
 
     void (*clear)(float const bgcolor[4]);
 
@@ -48,10 +48,17 @@ enum gfx_tex_fmt {
 #define GFX_TEX_CACHE_SIZE 512
 #define GFX_TEX_CACHE_MASK (GFX_TEX_CACHE_SIZE - 1)
 
+/*
+ * If mipmap is set, the texture is square and the gfx_obj holds every level
+ * of the mipmap packed together, starting with the width x height level and
+ * ending with the 1x1 level.  Otherwise the gfx_obj holds a single
+ * width x height image.
+ */
 struct gfx_tex {
     int obj_handle;
     enum gfx_tex_fmt tex_fmt;
     unsigned width, height;
+    bool mipmap;
     bool valid;
 };
 
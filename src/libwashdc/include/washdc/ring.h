@@ -111,6 +111,22 @@ extern "C" {
         }                                                               \
                                                                         \
         return true;                                                    \
+    }                                                                   \
+                                                                        \
+    /*                                                                  \
+     * these are only meaningful to the consumer (empty) and the        \
+     * producer (full), since the other side can change the answer at   \
+     * any time.                                                        \
+     */                                                                 \
+    static inline bool name##_empty(struct name *ring) {                \
+        return washdc_atomic_int_load(&ring->prod_idx) ==               \
+            washdc_atomic_int_load(&ring->cons_idx);                    \
+    }                                                                   \
+                                                                        \
+    static inline bool name##_full(struct name *ring) {                 \
+        int prod_idx = washdc_atomic_int_load(&ring->prod_idx);         \
+        return ((prod_idx + 1) & ((1 << (log)) - 1)) ==                 \
+            washdc_atomic_int_load(&ring->cons_idx);                    \
     }                                                                   \
 
 DEF_RING(text_ring, char, 10)
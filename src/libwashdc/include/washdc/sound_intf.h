@@ -34,6 +34,11 @@ typedef int32_t washdc_sample_type;
 struct washdc_sound_intf {
     void (*init)(void);
     void (*cleanup)(void);
+
+    /*
+     * samples holds count stereo frames, with the left and right samples of
+     * each frame interleaved (so it is 2 * count samples long).
+     */
     void (*submit_samples)(washdc_sample_type *samples, unsigned count);
 };
 
@@ -0,0 +1,161 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef WASHDC_TRACE_FMT_H_
+#define WASHDC_TRACE_FMT_H_
+
+/*
+ * File format of the binary execution traces written by libwashdc's trace
+ * recorder (see trace.h) and read back by washdc-tracedump.
+ *
+ * The file starts with an uncompressed header:
+ *     8 bytes - TRACE_FILE_MAGIC
+ *     4 bytes - TRACE_FILE_VERSION
+ *     4 bytes - reserved, always 0
+ *     8 bytes - number of cycle-stamp ticks per second of emulated time
+ *
+ * Everything after the header is one zlib stream made up of chunks.  Each
+ * chunk is a trace_chunk_hdr followed by n_bytes worth of records which were
+ * all written by the same host thread.  Chunks from different threads are
+ * interleaved in whatever order the writer thread got to them, so records are
+ * only guaranteed to be in order relative to other records from the same
+ * thread.
+ *
+ * Every record starts with one byte for its type (enum trace_rec_type)
+ * followed by the number of cycle-stamp ticks since the previous record from
+ * the same thread, encoded as an unsigned LEB128 varint.  The first record in
+ * every chunk is a TRACE_REC_TIME, which carries the absolute time so that
+ * each chunk can be decoded on its own.  The rest of the record depends on its
+ * type and is listed below.  All multi-byte fields are little-endian.
+ */
+
+#define TRACE_FILE_MAGIC "WASHTRCE"
+#define TRACE_FILE_MAGIC_LEN 8
+#define TRACE_FILE_VERSION 1
+#define TRACE_FILE_HDR_LEN 24
+
+#define TRACE_CHUNK_HDR_LEN 8
+
+/*
+ * chunk header:
+ *     4 bytes - thread number, in the order threads first recorded something
+ *     4 bytes - n_bytes
+ */
+
+enum trace_rec_type {
+    /*
+     * 8 bytes - absolute cycle stamp
+     * The delta for this record is always 0.
+     */
+    TRACE_REC_TIME,
+
+    /*
+     * 1 byte  - map number
+     * 1 byte  - length of name
+     * n bytes - name (not NUL-terminated)
+     *
+     * names a memory map so that TRACE_REC_REGION and TRACE_REC_MMIO_* can
+     * refer to it by number.
+     */
+    TRACE_REC_MAP,
+
+    /*
+     * 1 byte  - map number
+     * 1 byte  - region number
+     * 4 bytes - first address
+     * 4 bytes - last address
+     */
+    TRACE_REC_REGION,
+
+    /*
+     * 4 bytes - JIT code block hash.  For the SH4 that's the low 29 bits of
+     *           the block's address with FPSCR.PR and FPSCR.SZ in bits 29 and
+     *           30.
+     */
+    TRACE_REC_BLOCK,
+
+    /*
+     * 1 byte  - map number
+     * 1 byte  - region number
+     * 1 byte  - access size in bytes (1, 2, 4 or 8)
+     * 4 bytes - address
+     * n bytes - value, where n is the access size
+     */
+    TRACE_REC_MMIO_READ,
+    TRACE_REC_MMIO_WRITE,
+
+    /*
+     * 1 byte  - enum trace_irq_src
+     * 4 bytes - interrupt code; depends on the source
+     */
+    TRACE_REC_IRQ,
+
+    /*
+     * 1 byte  - enum trace_dma_chan
+     * 4 bytes - source address (0 if the source is a device)
+     * 4 bytes - destination address (0 if the destination is a device)
+     * 4 bytes - length in bytes
+     */
+    TRACE_REC_DMA,
+
+    /*
+     * 1 byte  - enum trace_ta_evt
+     * 4 bytes - argument; depends on the event
+     */
+    TRACE_REC_TA,
+
+    TRACE_REC_COUNT
+};
+
+enum trace_irq_src {
+    // HOLLY normal interrupt raised; code is the HollyNrmInt
+    TRACE_IRQ_HOLLY_NRM,
+
+    // HOLLY external interrupt raised; code is the HollyExtInt
+    TRACE_IRQ_HOLLY_EXT,
+
+    // SH4 took an interrupt; code is the INTEVT code
+    TRACE_IRQ_SH4,
+
+    TRACE_IRQ_SRC_COUNT
+};
+
+enum trace_dma_chan {
+    TRACE_DMA_SH4_CH2,
+    TRACE_DMA_GDROM,
+    TRACE_DMA_AICA,
+    TRACE_DMA_MAPLE,
+
+    TRACE_DMA_CHAN_COUNT
+};
+
+enum trace_ta_evt {
+    // end-of-list packet; arg is the polygon type of the list that ended
+    TRACE_TA_LIST_END,
+
+    // STARTRENDER; arg is the ISP/TSP parameter base address
+    TRACE_TA_STARTRENDER,
+
+    TRACE_TA_EVT_COUNT
+};
+
+#endif
@@ -39,22 +39,54 @@ extern "C" {
 
 struct washdc_launch_settings;
 
+/*
+ * one emulated Dreamcast.  washdc_init creates it and washdc_cleanup destroys
+ * it, and nearly everything else takes it as the first argument.  Only one
+ * instance can exist at a time for now.
+ */
+struct washdc_instance;
+
 /*
  * gdi_path is a path to the GDI image to mount, or NULL to boot with nothing
  * in the disc drive.
  * win_width and win_height are window dimensions
  * cmd_session should be true if the remote command prompt is enabled.
  */
-struct washdc_gameconsole const*
+struct washdc_instance *
 washdc_init(struct washdc_launch_settings const *settings);
 
-void washdc_cleanup();
+// this frees inst
+void washdc_cleanup(struct washdc_instance *inst);
+
+struct washdc_gameconsole const *
+washdc_get_console(struct washdc_instance *inst);
+
+void washdc_run(struct washdc_instance *inst);
+
+/*
+ * Run the SH4 backend differential tester (see hw/sh4/sh4_difftest.h) instead
+ * of washdc_run.  Call this after washdc_init; the emulated machine's state
+ * is garbage afterwards, so the only thing left to do is washdc_cleanup.
+ *
+ * The report gets written to report_path.  Returns the number of cases on
+ * which the backends didn't agree.
+ */
+unsigned washdc_sh4_difftest(struct washdc_instance *inst,
+                             char const *report_path, unsigned n_cases,
+                             unsigned seed);
 
-void washdc_run();
+/*
+ * Convert the .gdi image at gdi_path into a compressed .wdci image (see
+ * wdci.h), then read every sector back out of the new image and check it
+ * against the .gdi.  This doesn't involve the emulator, so call it instead of
+ * washdc_init rather than after it.  Returns 0 on success.
+ */
+int washdc_write_wdci(struct washdc_hostfile_api const *hostfile_api,
+                      char const *gdi_path, char const *wdci_path);
 
-void washdc_kill(void);
+void washdc_kill(struct washdc_instance *inst);
 
-bool washdc_is_running(void);
+bool washdc_is_running(struct washdc_instance *inst);
 
 enum washdc_boot_mode {
     // standard boot into firmware
@@ -125,18 +157,45 @@ struct washdc_launch_settings {
 
     // if true, the flash image will be written out at the end
     bool write_to_flash;
+
+    /*
+     * if this is not NULL, per-frame benchmark data gets written to it (as
+     * CSV if it ends in .csv, JSON otherwise).  If bench_frames or
+     * bench_seconds is nonzero, the emulator exits once it has run that many
+     * frames or seconds.
+     */
+    char const *path_bench;
+    unsigned bench_frames;
+    unsigned bench_seconds;
+
+    /*
+     * if path_movie_record is not NULL, all input gets recorded into it.  If
+     * path_movie_play is not NULL, the input recorded in it gets played back
+     * and input from the frontend is ignored until the movie ends.
+     */
+    char const *path_movie_record;
+    char const *path_movie_play;
+
+    /*
+     * if path_frame_hash is not NULL, the framebuffer gets hashed at the end
+     * of each frame listed in frame_hash_frames (comma-separated, counting
+     * from 1) and the hashes get written into path_frame_hash.  The emulator
+     * exits after the last one.
+     */
+    char const *path_frame_hash;
+    char const *frame_hash_frames;
 };
 
-int washdc_save_screenshot(char const *path);
-int washdc_save_screenshot_dir(void);
+int washdc_save_screenshot(struct washdc_instance *inst, char const *path);
+int washdc_save_screenshot_dir(struct washdc_instance *inst);
 
-void washdc_on_expose(void);
-void washdc_on_resize(int xres, int yres);
+void washdc_on_expose(struct washdc_instance *inst);
+void washdc_on_resize(struct washdc_instance *inst, int xres, int yres);
 
-char const *washdc_win_get_title(void);
+char const *washdc_win_get_title(struct washdc_instance *inst);
 
-void washdc_gfx_toggle_wireframe(void);
-void washdc_gfx_toggle_filter(void);
+void washdc_gfx_toggle_wireframe(struct washdc_instance *inst);
+void washdc_gfx_toggle_filter(struct washdc_instance *inst);
 
 #define WASHDC_CONT_BTN_C_SHIFT 0
 #define WASHDC_CONT_BTN_C_MASK (1 << WASHDC_CONT_BTN_C_SHIFT)
@@ -210,23 +269,27 @@ enum washdc_keyboard_special_keys {
 };
 
 // mark all buttons in btns as being pressed
-void washdc_controller_press_btns(unsigned port_no, uint32_t btns);
+void washdc_controller_press_btns(struct washdc_instance *inst,
+                                  unsigned port_no, uint32_t btns);
 
 // mark all buttons in btns as being released
-void washdc_controller_release_btns(unsigned port_no, uint32_t btns);
+void washdc_controller_release_btns(struct washdc_instance *inst,
+                                    unsigned port_no, uint32_t btns);
 
 void
-washdc_keyboard_set_btn(unsigned port_no, unsigned btn_no, bool is_pressed);
+washdc_keyboard_set_btn(struct washdc_instance *inst,
+                        unsigned port_no, unsigned btn_no, bool is_pressed);
 
 void
-washdc_keyboard_press_special(unsigned port_no,
+washdc_keyboard_press_special(struct washdc_instance *inst, unsigned port_no,
                               enum washdc_keyboard_special_keys which);
 void
-washdc_keyboard_release_special(unsigned port_no,
+washdc_keyboard_release_special(struct washdc_instance *inst, unsigned port_no,
                                 enum washdc_keyboard_special_keys which);
 
 // 0 = min, 255 = max, 128 = half
-void washdc_controller_set_axis(unsigned port_no, unsigned axis, unsigned val);
+void washdc_controller_set_axis(struct washdc_instance *inst,
+                                unsigned port_no, unsigned axis, unsigned val);
 
 enum washdc_controller_tp {
     WASHDC_CONTROLLER_TP_NONE,
@@ -234,7 +297,8 @@ enum washdc_controller_tp {
     WASHDC_CONTROLLER_TP_DREAMCAST_KEYBOARD
 };
 
-enum washdc_controller_tp washdc_controller_type(unsigned port_no);
+enum washdc_controller_tp
+washdc_controller_type(struct washdc_instance *inst, unsigned port_no);
 
 enum washdc_pvr2_poly_group {
     WASHDC_PVR2_POLY_GROUP_OPAQUE,
@@ -292,14 +356,144 @@ struct washdc_pvr2_stat {
     unsigned tex_eviction_count;
 };
 
-void washdc_get_pvr2_stat(struct washdc_pvr2_stat *stat);
+void washdc_get_pvr2_stat(struct washdc_instance *inst,
+                          struct washdc_pvr2_stat *stat);
+
+void washdc_pause(struct washdc_instance *inst);
+void washdc_resume(struct washdc_instance *inst);
+bool washdc_is_paused(struct washdc_instance *inst);
+void washdc_run_one_frame(struct washdc_instance *inst);
+
+/*
+ * If enabled, the emulator sleeps at the end of every frame so that it runs
+ * no faster than a real Dreamcast.  This is disabled by default.  It can be
+ * called from any thread.
+ */
+void washdc_set_frame_pacing(struct washdc_instance *inst, bool enable);
+
+/*
+ * Turbo mode runs the emulator as fast as the host allows.  Only one out of
+ * every exec.turbo-interval frames gets presented, and no audio is produced
+ * (although the sound hardware otherwise keeps running normally).  Frames
+ * that won't be presented skip rendering anything that only goes to the
+ * screen, but render-to-texture and framebuffers the guest reads back are
+ * still rendered, so emulated behavior doesn't change.
+ * Frame pacing is ignored while turbo mode is enabled.  It can be called from
+ * any thread, and it takes effect at the end of the current frame.
+ */
+void washdc_set_turbo(struct washdc_instance *inst, bool enable);
+bool washdc_get_turbo(struct washdc_instance *inst);
+
+unsigned washdc_get_frame_count(struct washdc_instance *inst);
+
+enum washdc_perf_cat {
+    WASHDC_PERF_CAT_SH4,
+    WASHDC_PERF_CAT_ARM7,
+    WASHDC_PERF_CAT_AICA,
+    WASHDC_PERF_CAT_TA,
+    WASHDC_PERF_CAT_RENDER,
+    WASHDC_PERF_CAT_TEX_UPLOAD,
+    WASHDC_PERF_CAT_JIT_COMPILE,
+    WASHDC_PERF_CAT_GDROM,
+
+    // host time on the emulation thread that didn't go to anything above
+    WASHDC_PERF_CAT_OTHER,
+
+    WASHDC_PERF_CAT_COUNT
+};
+
+// host-time accounting for one emulated frame
+struct washdc_perf_counters {
+    // increments once per counted frame, starting from 1
+    unsigned frame_no;
+
+    // host time the whole frame took
+    uint64_t host_ns;
+
+    // emulated time the frame covered
+    uint64_t virt_ns;
+
+    /*
+     * host time charged to each category.  Categories nest, and time is only
+     * charged to the innermost one.
+     */
+    uint64_t cat_ns[WASHDC_PERF_CAT_COUNT];
+
+    // number of times each category was entered (always 0 for OTHER)
+    unsigned cat_count[WASHDC_PERF_CAT_COUNT];
+
+    unsigned long long code_cache_misses;
+};
+
+/*
+ * Turn the per-frame performance counters on or off.  They are off by default
+ * unless a benchmark is being recorded.  It can be called from any thread, and
+ * counting starts or stops at the end of the current frame.
+ *
+ * When exec.aica-thread is enabled, ARM7 and AICA time is not counted.
+ */
+void washdc_set_perf_counters(struct washdc_instance *inst, bool enable);
+
+/*
+ * copy the counters for the most recently finished frame into out.  Returns
+ * false (and zeroes out) if no frame has been counted yet.  This is safe to
+ * call while the emulator is running.
+ */
+bool washdc_get_perf_counters(struct washdc_instance *inst,
+                              struct washdc_perf_counters *out);
+
+// one code block's worth of data from the JIT's sampling profiler
+struct washdc_jit_sample_blk {
+    // guest address of the block's first instruction
+    uint32_t addr;
+
+    // the JIT's hash for the block (this includes the FPU mode)
+    uint32_t hash;
+
+    // number of times the block was executing when the profiler took a sample
+    unsigned long long n_samples;
+
+    // guest CPU cycles for one pass through the block
+    unsigned cycle_count;
+
+    unsigned n_il_insts;
+
+    // IL instructions which call back into the interpreter
+    unsigned n_fallbacks;
+
+    // number of times the block has been compiled
+    unsigned n_compiles;
+};
+
+struct washdc_jit_sample_stat {
+    // total number of samples, including the ones below
+    unsigned long long n_samples;
+
+    // samples taken when the CPU wasn't running JIT code
+    unsigned long long n_outside;
+
+    // samples taken while the JIT was compiling a block
+    unsigned long long n_compiling;
+
+    // number of distinct blocks the profiler knows about
+    unsigned n_blocks;
+};
+
+// true if wash.jit.sample.enable was set and the JIT is in use
+bool washdc_jit_sample_enabled(struct washdc_instance *inst);
 
-void washdc_pause(void);
-void washdc_resume(void);
-bool washdc_is_paused(void);
-void washdc_run_one_frame(void);
+/*
+ * copy the max_blocks blocks which got the most samples into out, sorted with
+ * the most samples first, and return the number of blocks copied.  stat can be
+ * NULL.  This is safe to call while the emulator is running.
+ */
+unsigned washdc_jit_sample_top(struct washdc_instance *inst,
+                               struct washdc_jit_sample_blk *out,
+                               unsigned max_blocks,
+                               struct washdc_jit_sample_stat *stat);
 
-unsigned washdc_get_frame_count(void);
+// start over from zero samples
+void washdc_jit_sample_reset(struct washdc_instance *inst);
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,8 @@
 #ifndef WIN_H_
 #define WIN_H_
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,6 +38,14 @@ struct win_intf {
     void (*update_title)(void);
     int (*get_width)(void);
     int (*get_height)(void);
+
+    /*
+     * These two are optional.  wait_events blocks until there's at least one
+     * event for check_events to process, or until wake_events gets called.
+     * wake_events can be called from any thread.
+     */
+    void (*wait_events)(void);
+    void (*wake_events)(void);
 };
 
 void win_set_intf(struct win_intf const *intf);
@@ -48,6 +58,9 @@ void win_make_context_current(void);
 void win_update_title(void);
 int win_get_width(void);
 int win_get_height(void);
+bool win_can_wait_events(void);
+void win_wait_events(void);
+void win_wake_events(void);
 
 #ifdef __cplusplus
 }
@@ -39,6 +39,8 @@
 
 #include "jit_intp/code_block_intp.h"
 
+struct exec_mem;
+
 enum washdc_jit_slot_tp {
     // general-purpose slot
     WASHDC_JIT_SLOT_GEN,
@@ -103,12 +105,16 @@ void il_code_block_strike_inst(struct il_code_block *blk, unsigned inst_idx);
 void il_code_block_insert_inst(struct il_code_block *blk,
                                struct jit_inst const *inst, unsigned idx);
 
+/*
+ * native is where the block gets allocated if it's going to be compiled to
+ * native code, or NULL if it's for the interpreter.
+ */
 static inline void
 jit_code_block_init(struct jit_code_block *blk, uint32_t addr_first,
-                    bool native_mode) {
+                    struct exec_mem *native) {
 #ifdef ENABLE_JIT_X86_64
-    if (native_mode)
-        code_block_x86_64_init(&blk->x86_64);
+    if (native)
+        code_block_x86_64_init(&blk->x86_64, native);
     else
 #endif
         code_block_intp_init(&blk->intp);
@@ -119,14 +125,14 @@ jit_code_block_init(struct jit_code_block *blk, uint32_t addr_first,
 }
 
 static inline void
-jit_code_block_cleanup(struct jit_code_block *blk, bool native_mode) {
+jit_code_block_cleanup(struct jit_code_block *blk, struct exec_mem *native) {
 #ifdef JIT_PROFILE
     jit_profile_free_block(blk->profile);
 #endif
 
 #ifdef ENABLE_JIT_X86_64
-    if (native_mode)
-        code_block_x86_64_cleanup(&blk->x86_64);
+    if (native)
+        code_block_x86_64_cleanup(&blk->x86_64, native);
     else
 #endif
         code_block_intp_cleanup(&blk->intp);
@@ -28,7 +28,6 @@
 #include "washdc/error.h"
 #include "code_block.h"
 #include "log.h"
-#include "config.h"
 #include "avl.h"
 
 #ifdef ENABLE_JIT_X86_64
@@ -37,18 +36,6 @@
 
 #include "code_cache.h"
 
-#define CODE_CACHE_HASH_TBL_SHIFT 16
-#define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
-#define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
-
-/*
- * This is a two-level cache.  The lower level is a binary search tree balanced
- * using the AVL algorithm.  The upper level is a hash-table.  Everything that
- * exists in the hash also exists in the tree, but not everything in the tree
- * exists in the hash.  When there is a collision in the hash, we discard
- * outdated values instead of trying to implement probing or chaining.
- */
-
 /*
  * oldroot points to a list of trees invalid nodes.
  *
@@ -59,16 +46,10 @@
  * relocated to the oldroot pointer so that its nodes can be freed later when
  * the emulator exits CPU context.
  */
-struct oldroot_node {
+struct code_cache_oldroot {
     struct avl_tree tree;
-    struct oldroot_node *next;
+    struct code_cache_oldroot *next;
 };
-static struct oldroot_node *oldroot;
-
-static struct avl_tree tree;
-
-struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
-static void *dflt_entry;
 
 /*
  * the maximum number of code-cache entries that can be created before the
@@ -87,70 +68,61 @@ static void *dflt_entry;
  * register.
  */
 #define MAX_ENTRIES (1024*1024)
-static unsigned n_entries;
-
-#ifdef ENABLE_JIT_X86_64
-static bool native_mode = true;
-#endif
 
 static struct avl_node*
-cache_entry_ctor(avl_key_type key) {
+cache_entry_ctor(avl_key_type key, void *arg) {
+    struct code_cache *cache = (struct code_cache*)arg;
     struct cache_entry *ent = calloc(1, sizeof(struct cache_entry));
 
-#ifdef ENABLE_JIT_X86_64
-    jit_code_block_init(&ent->blk, key, native_mode);
-#else
-    jit_code_block_init(&ent->blk, key, false);
-#endif
+    jit_code_block_init(&ent->blk, key, cache->native);
 
-    n_entries++;
-    if (n_entries >= MAX_ENTRIES)
+    cache->n_entries++;
+    if (cache->n_entries >= MAX_ENTRIES)
         RAISE_ERROR(ERROR_INTEGRITY);
     return &ent->node;
 }
 
 static void
-cache_entry_dtor(struct avl_node *node) {
+cache_entry_dtor(struct avl_node *node, void *arg) {
+    struct code_cache *cache = (struct code_cache*)arg;
     struct cache_entry *ent = &AVL_DEREF(node, struct cache_entry, node);
 
-#ifdef ENABLE_JIT_X86_64
-    jit_code_block_cleanup(&ent->blk, native_mode);
-#else
-    jit_code_block_cleanup(&ent->blk, false);
-#endif
+    jit_code_block_cleanup(&ent->blk, cache->native);
 
     free(ent);
 }
 
-static void reinit_tree(void) {
-    avl_init(&tree, cache_entry_ctor, cache_entry_dtor);
+static void reinit_tree(struct code_cache *cache) {
+    avl_init(&cache->tree, cache_entry_ctor, cache_entry_dtor, cache);
 }
 
-void code_cache_init(void) {
-    reinit_tree();
+void code_cache_init(struct code_cache *cache, struct exec_mem *native) {
+    cache->oldroot = NULL;
+    cache->dflt_entry = NULL;
+    cache->n_entries = 0;
+    cache->n_misses = 0;
+    cache->native = native;
+
+    reinit_tree(cache);
 
     unsigned idx;
     for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
-        code_cache_tbl[idx] = dflt_entry;
-
-#ifdef ENABLE_JIT_X86_64
-    native_mode = config_get_native_jit();
-#endif
+        cache->tbl[idx] = cache->dflt_entry;
 }
 
-void code_cache_cleanup(void) {
-    code_cache_invalidate_all();
-    code_cache_gc();
+void code_cache_cleanup(struct code_cache *cache) {
+    code_cache_invalidate_all(cache);
+    code_cache_gc(cache);
 }
 
-void code_cache_set_default(void *dflt) {
-    dflt_entry = dflt;
+void code_cache_set_default(struct code_cache *cache, void *dflt) {
+    cache->dflt_entry = dflt;
     unsigned idx;
     for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
-        code_cache_tbl[idx] = dflt_entry;
+        cache->tbl[idx] = cache->dflt_entry;
 }
 
-void code_cache_invalidate_all(void) {
+void code_cache_invalidate_all(struct code_cache *cache) {
     /*
      * this function gets called whenever something writes to the sh4 CCR.
      * Since we don't want to trash the block currently executing, we instead
@@ -165,51 +137,57 @@ void code_cache_invalidate_all(void) {
      * pre-existing oldroot if this function got called more than once by the
      * current code block.
      */
-    struct oldroot_node *list_node =
-        (struct oldroot_node*)malloc(sizeof(struct oldroot_node));
+    struct code_cache_oldroot *list_node =
+        (struct code_cache_oldroot*)malloc(sizeof(struct code_cache_oldroot));
     if (!list_node)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
-    list_node->next = oldroot;
-    list_node->tree = tree;
-    oldroot = list_node;
+    list_node->next = cache->oldroot;
+    list_node->tree = cache->tree;
+    cache->oldroot = list_node;
 
-    reinit_tree();
+    reinit_tree(cache);
 
     unsigned idx;
     for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
-        code_cache_tbl[idx] = dflt_entry;
+        cache->tbl[idx] = cache->dflt_entry;
 
-    n_entries = 0;
+    cache->n_entries = 0;
 }
 
-void code_cache_gc(void) {
-    while (oldroot) {
-        struct oldroot_node *next = oldroot->next;
-        avl_cleanup(&oldroot->tree);
-        free(oldroot);
-        oldroot = next;
+void code_cache_gc(struct code_cache *cache) {
+    while (cache->oldroot) {
+        struct code_cache_oldroot *next = cache->oldroot->next;
+        avl_cleanup(&cache->oldroot->tree);
+        free(cache->oldroot);
+        cache->oldroot = next;
     }
 
 #ifdef INVARIANTS
 #ifdef ENABLE_JIT_X86_64
-    if (config_get_native_jit())
-        exec_mem_check_integrity();
+    if (cache->native)
+        exec_mem_check_integrity(cache->native);
 #endif
 #endif
 }
 
-struct cache_entry *code_cache_find(jit_hash hash) {
+struct cache_entry *code_cache_find(struct code_cache *cache, jit_hash hash) {
     unsigned hash_idx = hash & CODE_CACHE_HASH_TBL_MASK;
-    struct cache_entry *maybe = code_cache_tbl[hash_idx];
+    struct cache_entry *maybe = cache->tbl[hash_idx];
     if (maybe && maybe->node.key == hash)
         return maybe;
 
-    struct cache_entry *ret = code_cache_find_slow(hash);
-    code_cache_tbl[hash_idx] = ret;
+    struct cache_entry *ret = code_cache_find_slow(cache, hash);
+    cache->tbl[hash_idx] = ret;
     return ret;
 }
 
-struct cache_entry *code_cache_find_slow(jit_hash hash) {
-    struct avl_node *node = avl_find(&tree, hash);
+struct cache_entry *code_cache_find_slow(struct code_cache *cache,
+                                         jit_hash hash) {
+    cache->n_misses++;
+    struct avl_node *node = avl_find(&cache->tree, hash);
     return &AVL_DEREF(node, struct cache_entry, node);
 }
+
+unsigned long long code_cache_n_misses(struct code_cache const *cache) {
+    return cache->n_misses;
+}
@@ -46,6 +46,43 @@ struct cache_entry {
     struct jit_code_block blk;
 };
 
+#define CODE_CACHE_HASH_TBL_SHIFT 16
+#define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
+#define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
+
+struct code_cache_oldroot;
+struct exec_mem;
+
+/*
+ * This is a two-level cache.  The lower level is a binary search tree balanced
+ * using the AVL algorithm.  The upper level is a hash-table.  Everything that
+ * exists in the hash also exists in the tree, but not everything in the tree
+ * exists in the hash.  When there is a collision in the hash, we discard
+ * outdated values instead of trying to implement probing or chaining.
+ *
+ * Every washdc_instance has its own code cache.
+ */
+struct code_cache {
+    struct avl_tree tree;
+
+    // trees that were invalidated but haven't been freed yet
+    struct code_cache_oldroot *oldroot;
+
+    struct cache_entry *tbl[CODE_CACHE_HASH_TBL_LEN];
+    void *dflt_entry;
+
+    unsigned n_entries;
+
+    // number of lookups that missed in the hash table
+    unsigned long long n_misses;
+
+    /*
+     * where native code blocks get allocated from, or NULL if the code blocks
+     * are for the interpreter.
+     */
+    struct exec_mem *native;
+};
+
 /*
  * this might return a pointer to an invalid cache_entry.  If so, that means
  * the cache entry needs to be filled in by the callee.  This function will
@@ -54,34 +91,34 @@ struct cache_entry {
  * That said, blk will already be init'd no matter what, even if valid is
  * false.
  */
-struct cache_entry *code_cache_find(jit_hash hash);
+struct cache_entry *code_cache_find(struct code_cache *cache, jit_hash hash);
 
 /*
  * This is like code_cache_find, but it skips the second-level hash table.
  * This function is intended for JIT code which handles that itself
  */
-struct cache_entry *code_cache_find_slow(jit_hash hash);
+struct cache_entry *code_cache_find_slow(struct code_cache *cache,
+                                         jit_hash hash);
 
-void code_cache_invalidate_all(void);
+void code_cache_invalidate_all(struct code_cache *cache);
 
-void code_cache_init(void);
-void code_cache_cleanup(void);
+// native is the same as code_cache's native member
+void code_cache_init(struct code_cache *cache, struct exec_mem *native);
+void code_cache_cleanup(struct code_cache *cache);
 
 /*
  * call this periodically from outside of CPU context to clear
  * out old cache entries.
  */
-void code_cache_gc(void);
+void code_cache_gc(struct code_cache *cache);
 
 /*
- * set the value that the code_cache_tbl gets overwritten with whenever there's
+ * set the value that the hash table gets overwritten with whenever there's
  * a nuke
  */
-void code_cache_set_default(void *dflt);
+void code_cache_set_default(struct code_cache *cache, void *dflt);
 
-#define CODE_CACHE_HASH_TBL_SHIFT 16
-#define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
-#define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
-extern struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
+// number of lookups that have missed in the hash table so far
+unsigned long long code_cache_n_misses(struct code_cache const *cache);
 
 #endif
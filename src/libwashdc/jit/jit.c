@@ -24,10 +24,11 @@
 
 #include "jit.h"
 
-void jit_init(struct dc_clock *clk) {
-    code_cache_init();
+void jit_init(struct dc_clock *clk, struct code_cache *cache,
+              struct exec_mem *native) {
+    code_cache_init(cache, native);
 }
 
-void jit_cleanup(void) {
-    code_cache_cleanup();
+void jit_cleanup(struct code_cache *cache) {
+    code_cache_cleanup(cache);
 }
@@ -27,7 +27,15 @@
 
 #include "dc_sched.h"
 
-void jit_init(struct dc_clock *clk);
-void jit_cleanup(void);
+struct code_cache;
+struct exec_mem;
+
+/*
+ * native is the arena that cache's blocks get compiled into, or NULL when
+ * the native backend is not in use.
+ */
+void jit_init(struct dc_clock *clk, struct code_cache *cache,
+              struct exec_mem *native);
+void jit_cleanup(struct code_cache *cache);
 
 #endif
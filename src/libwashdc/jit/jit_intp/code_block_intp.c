@@ -372,11 +372,14 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
         case JIT_OP_SHAD:
             if ((int32_t)block->slots[inst->immed.shad.slot_shift_amt].as_u32 >= 0) {
                 block->slots[inst->immed.shad.slot_val].as_u32 <<=
-                    block->slots[inst->immed.shad.slot_shift_amt].as_u32;
+                    block->slots[inst->immed.shad.slot_shift_amt].as_u32 & 0x1f;
             } else {
+                // shift by ((~amt) & 0x1f) + 1, which can be all 32 bits
+                unsigned shift_amt =
+                    (~block->slots[inst->immed.shad.slot_shift_amt].as_u32) & 0x1f;
                 block->slots[inst->immed.shad.slot_val].as_u32 =
                     ((int32_t)block->slots[inst->immed.shad.slot_val].as_u32) >>
-                    -(int32_t)block->slots[inst->immed.shad.slot_shift_amt].as_u32;
+                    shift_amt >> 1;
             }
             inst++;
             break;
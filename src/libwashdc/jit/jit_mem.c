@@ -29,6 +29,10 @@
 #include "memory.h"
 #include "washdc/MemoryMap.h"
 
+#ifdef ENABLE_WATCHPOINTS
+#include "washdc/debugger.h"
+#endif
+
 #include "jit_mem.h"
 
 /*
@@ -47,6 +51,21 @@ static struct memory_map_region *find_ram(struct memory_map *map) {
     return NULL;
 }
 
+/*
+ * Loads from RAM get inlined as loads from a host pointer, which would skip
+ * over the watchpoint checks in the memory map.  The debugger flushes the
+ * code cache whenever a watchpoint is added or removed, so it's enough to
+ * check this at compile-time.  This is only ever used for the SH4.
+ */
+static bool jit_mem_is_watched(addr32_t addr, unsigned len) {
+#ifdef ENABLE_WATCHPOINTS
+    return debug_is_watch_page(DEBUG_CONTEXT_SH4, addr, len,
+                               DEBUG_WATCH_PAGE_R);
+#else
+    return false;
+#endif
+}
+
 void jit_mem_read_constaddr_32(struct memory_map *map, struct il_code_block *block,
                                addr32_t addr, unsigned slot_no) {
     struct memory_map_region *ram = find_ram(map);
@@ -56,7 +75,8 @@ void jit_mem_read_constaddr_32(struct memory_map *map, struct il_code_block *blo
         addr32_t addr_last = (addr + 3) & ram->range_mask;
 
         struct Memory *mem = (struct Memory*)ram->ctxt;
-        if (addr_first >= ram->first_addr && addr_last <= ram->last_addr) {
+        if (addr_first >= ram->first_addr && addr_last <= ram->last_addr &&
+            !jit_mem_is_watched(addr, 4)) {
             void *ptr = mem->mem + (addr & ram->mask);
             jit_load_slot(block, slot_no, ptr);
             return;
@@ -75,7 +95,8 @@ void jit_mem_read_constaddr_16(struct memory_map *map, struct il_code_block *blo
         addr32_t addr_last = (addr + 3) & ram->range_mask;
 
         struct Memory *mem = (struct Memory*)ram->ctxt;
-        if (addr_first >= ram->first_addr && addr_last <= ram->last_addr) {
+        if (addr_first >= ram->first_addr && addr_last <= ram->last_addr &&
+            !jit_mem_is_watched(addr, 2)) {
             void *ptr = mem->mem + (addr & ram->mask);
             jit_load_slot16(block, slot_no, ptr);
             return;
@@ -0,0 +1,271 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifdef _MSC_VER
+#include "i_hate_windows.h"
+#else
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "threading.h"
+#include "washdc/error.h"
+#include "washdc/washdc.h"
+#include "washdc/config_file.h"
+#include "code_block.h"
+
+#include "jit_sample.h"
+
+#define JIT_SAMPLE_DEFAULT_PERIOD_US 1000
+#define JIT_SAMPLE_INITIAL_TBL_LEN 4096
+
+struct jit_sample_ent {
+    bool valid;
+    struct washdc_jit_sample_blk blk;
+};
+
+uint32_t volatile jit_sample_cur = JIT_SAMPLE_OUTSIDE;
+
+static struct jit_sample {
+    bool enabled;
+    unsigned period_us;
+
+    washdc_thread thread;
+
+    // everything after this point is protected by lock
+    washdc_mutex lock;
+    bool stop;
+
+    // open-addressing hash table keyed by jit_hash
+    struct jit_sample_ent *tbl;
+    unsigned tbl_len, n_ents;
+
+    struct washdc_jit_sample_stat stat;
+} smp;
+
+static inline void jit_sample_sleep_us(unsigned n_us) {
+#ifdef _MSC_VER
+    Sleep(n_us >= 1000 ? n_us / 1000 : 1);
+#else
+    usleep(n_us);
+#endif
+}
+
+static struct jit_sample_ent *jit_sample_probe(struct jit_sample_ent *tbl,
+                                               unsigned tbl_len,
+                                               jit_hash hash) {
+    unsigned mask = tbl_len - 1;
+    unsigned idx = (hash ^ (hash >> 16)) & mask;
+    while (tbl[idx].valid && tbl[idx].blk.hash != hash)
+        idx = (idx + 1) & mask;
+    return tbl + idx;
+}
+
+// smp.lock must be held
+static struct jit_sample_ent *jit_sample_get_ent(jit_hash hash) {
+    struct jit_sample_ent *ent = jit_sample_probe(smp.tbl, smp.tbl_len, hash);
+    if (ent->valid)
+        return ent;
+
+    // keep the table at most half-full so that probes stay short
+    if ((smp.n_ents + 1) * 2 > smp.tbl_len) {
+        unsigned new_len = smp.tbl_len * 2;
+        struct jit_sample_ent *new_tbl =
+            (struct jit_sample_ent*)calloc(new_len, sizeof(new_tbl[0]));
+        if (!new_tbl)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+        unsigned idx;
+        for (idx = 0; idx < smp.tbl_len; idx++) {
+            if (smp.tbl[idx].valid) {
+                *jit_sample_probe(new_tbl, new_len, smp.tbl[idx].blk.hash) =
+                    smp.tbl[idx];
+            }
+        }
+
+        free(smp.tbl);
+        smp.tbl = new_tbl;
+        smp.tbl_len = new_len;
+        ent = jit_sample_probe(smp.tbl, smp.tbl_len, hash);
+    }
+
+    memset(ent, 0, sizeof(*ent));
+    ent->valid = true;
+    ent->blk.hash = hash;
+    ent->blk.addr = hash; // until the block gets compiled
+    smp.n_ents++;
+    smp.stat.n_blocks = smp.n_ents;
+
+    return ent;
+}
+
+static void jit_sample_thread_main(void *argp) {
+    for (;;) {
+        jit_sample_sleep_us(smp.period_us);
+
+        uint32_t cur = jit_sample_cur;
+
+        washdc_mutex_lock(&smp.lock);
+        if (smp.stop) {
+            washdc_mutex_unlock(&smp.lock);
+            return;
+        }
+
+        smp.stat.n_samples++;
+        if (cur == JIT_SAMPLE_OUTSIDE)
+            smp.stat.n_outside++;
+        else if (cur == JIT_SAMPLE_COMPILING)
+            smp.stat.n_compiling++;
+        else
+            jit_sample_get_ent(cur)->blk.n_samples++;
+        washdc_mutex_unlock(&smp.lock);
+    }
+}
+
+void jit_sample_init(void) {
+    bool enable = false;
+    int period_us;
+
+    memset(&smp, 0, sizeof(smp));
+    jit_sample_cur = JIT_SAMPLE_OUTSIDE;
+
+    cfg_get_bool("wash.jit.sample.enable", &enable);
+    if (!enable)
+        return;
+
+    if (cfg_get_int("wash.jit.sample.period-us", &period_us) != 0 ||
+        period_us <= 0)
+        period_us = JIT_SAMPLE_DEFAULT_PERIOD_US;
+
+    smp.tbl_len = JIT_SAMPLE_INITIAL_TBL_LEN;
+    smp.tbl = (struct jit_sample_ent*)calloc(smp.tbl_len, sizeof(smp.tbl[0]));
+    if (!smp.tbl)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    smp.period_us = period_us;
+    smp.enabled = true;
+
+    washdc_mutex_init(&smp.lock);
+    washdc_thread_create(&smp.thread, jit_sample_thread_main, NULL);
+
+    LOG_INFO("JIT sampling profiler enabled: one sample every %u "
+             "microseconds\n", smp.period_us);
+}
+
+void jit_sample_cleanup(void) {
+    if (!smp.enabled)
+        return;
+
+    washdc_mutex_lock(&smp.lock);
+    smp.stop = true;
+    washdc_mutex_unlock(&smp.lock);
+    washdc_thread_join(&smp.thread);
+
+    washdc_mutex_cleanup(&smp.lock);
+    free(smp.tbl);
+    memset(&smp, 0, sizeof(smp));
+}
+
+bool jit_sample_enabled(void) {
+    return smp.enabled;
+}
+
+void jit_sample_on_compile(jit_hash hash, uint32_t addr, unsigned cycle_count,
+                           struct il_code_block const *il_blk) {
+    if (!smp.enabled)
+        return;
+
+    unsigned n_fallbacks = 0, inst_no;
+    for (inst_no = 0; inst_no < il_blk->inst_count; inst_no++)
+        if (il_blk->inst_list[inst_no].op == JIT_OP_FALLBACK)
+            n_fallbacks++;
+
+    washdc_mutex_lock(&smp.lock);
+    struct washdc_jit_sample_blk *blk = &jit_sample_get_ent(hash)->blk;
+    blk->addr = addr;
+    blk->cycle_count = cycle_count;
+    blk->n_il_insts = il_blk->inst_count;
+    blk->n_fallbacks = n_fallbacks;
+    blk->n_compiles++;
+    washdc_mutex_unlock(&smp.lock);
+}
+
+static int jit_sample_cmp(void const *lhs, void const *rhs) {
+    struct washdc_jit_sample_blk const *blk_lhs = lhs, *blk_rhs = rhs;
+    if (blk_lhs->n_samples > blk_rhs->n_samples)
+        return -1;
+    if (blk_lhs->n_samples < blk_rhs->n_samples)
+        return 1;
+    return 0;
+}
+
+unsigned jit_sample_top(struct washdc_jit_sample_blk *out, unsigned max_blocks,
+                        struct washdc_jit_sample_stat *stat) {
+    if (!smp.enabled) {
+        if (stat)
+            memset(stat, 0, sizeof(*stat));
+        return 0;
+    }
+
+    washdc_mutex_lock(&smp.lock);
+
+    struct washdc_jit_sample_blk *sorted = (struct washdc_jit_sample_blk*)
+        malloc((smp.n_ents + 1) * sizeof(sorted[0]));
+    if (!sorted)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    unsigned n_sampled = 0, idx;
+    for (idx = 0; idx < smp.tbl_len; idx++)
+        if (smp.tbl[idx].valid && smp.tbl[idx].blk.n_samples)
+            sorted[n_sampled++] = smp.tbl[idx].blk;
+    if (stat)
+        *stat = smp.stat;
+
+    washdc_mutex_unlock(&smp.lock);
+
+    qsort(sorted, n_sampled, sizeof(sorted[0]), jit_sample_cmp);
+
+    if (n_sampled > max_blocks)
+        n_sampled = max_blocks;
+    memcpy(out, sorted, n_sampled * sizeof(out[0]));
+    free(sorted);
+
+    return n_sampled;
+}
+
+void jit_sample_reset(void) {
+    if (!smp.enabled)
+        return;
+
+    washdc_mutex_lock(&smp.lock);
+    unsigned idx;
+    for (idx = 0; idx < smp.tbl_len; idx++)
+        smp.tbl[idx].blk.n_samples = 0;
+    smp.stat.n_samples = 0;
+    smp.stat.n_outside = 0;
+    smp.stat.n_compiling = 0;
+    washdc_mutex_unlock(&smp.lock);
+}
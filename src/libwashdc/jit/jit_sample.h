@@ -0,0 +1,87 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef JIT_SAMPLE_H_
+#define JIT_SAMPLE_H_
+
+/*
+ * Sampling profiler for JIT code blocks.
+ *
+ * Unlike JIT_PROFILE, this doesn't need a special build and it doesn't do any
+ * work on every block dispatch other than storing the hash of the block that's
+ * about to run into jit_sample_cur.  A separate thread wakes up every
+ * wash.jit.sample.period-us microseconds and charges one sample to whatever
+ * block jit_sample_cur points at.  Per-block information that doesn't change
+ * while the block is alive (cycle count, number of IL instructions and how
+ * many of those are interpreter fallbacks) gets recorded when the block is
+ * compiled, along with a count of how many times it has been compiled.
+ *
+ * Everything is keyed by the jit_hash of the block, so the same guest address
+ * compiled under different FPU modes shows up as separate entries.
+ *
+ * This is turned on with wash.jit.sample.enable in the config file.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "defs.h"
+
+struct il_code_block;
+struct washdc_jit_sample_blk;
+struct washdc_jit_sample_stat;
+
+/*
+ * special values for jit_sample_cur.  jit_hash values never have bit 31 set,
+ * so these can't collide with a real block.
+ */
+#define JIT_SAMPLE_OUTSIDE   0xffffffff // not running JIT code
+#define JIT_SAMPLE_COMPILING 0xfffffffe // compiling a new block
+
+/*
+ * hash of the code block currently executing on the emulation thread.  The
+ * x86_64 backend stores to this directly from the native dispatch code.
+ */
+extern uint32_t volatile jit_sample_cur;
+
+void jit_sample_init(void);
+void jit_sample_cleanup(void);
+
+bool jit_sample_enabled(void);
+
+// called from the emulation thread right after a block has been compiled
+void jit_sample_on_compile(jit_hash hash, uint32_t addr, unsigned cycle_count,
+                           struct il_code_block const *il_blk);
+
+/*
+ * copy the max_blocks blocks with the most samples into out (sorted with the
+ * most samples first) and return how many were written.  This can be called
+ * from any thread.
+ */
+unsigned jit_sample_top(struct washdc_jit_sample_blk *out, unsigned max_blocks,
+                        struct washdc_jit_sample_stat *stat);
+
+// throw away all samples taken so far, but keep the per-block information
+void jit_sample_reset(void);
+
+#endif
@@ -0,0 +1,391 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * Translates the AICA DSP's compiled steps into x86_64 code.  This does
+ * exactly what aica_dsp_interpret does, except that everything that only
+ * depends on the program (which registers a step reads, what its coefficient
+ * is, which parts of the address calculation apply) gets decided here instead
+ * of on every sample.
+ *
+ * Register usage inside the generated code:
+ *     RBX - &dsp->temp[0]; everything else in the dsp is addressed from here
+ *     R12 - wave memory
+ *     RBP - ACC
+ *     R13 - FRC_REG
+ *     R14 - Y_REG
+ *     R15 - ADRS_REG
+ *     R8D - INPUTS
+ *     R9D - TEMP[TRA]
+ *     EDX - SHIFTED
+ *     RAX, RCX, R11 - scratch
+ *
+ * MEMVAL lives on the stack, and so do INPUTS, SHIFTED and the wave memory
+ * address while aica_dsp_pack or aica_dsp_unpack is being called.
+ */
+
+#include <stddef.h>
+
+#include "washdc/error.h"
+#include "hw/aica/aica_dsp.h"
+#include "abi.h"
+#include "emit_x86_64.h"
+
+#include "aica_dsp_x86_64.h"
+
+// displacement of a member of struct aica_dsp from RBX
+#define DSP_OFFS(mem) \
+    ((int)(offsetof(struct aica_dsp, mem) - offsetof(struct aica_dsp, temp)))
+
+#define REG_TEMP_BASE RBX
+#define REG_WAVE_MEM  R12
+#define REG_ACC       RBP
+#define REG_FRC       R13
+#define REG_Y         R14
+#define REG_ADRS      R15
+#define REG_INPUTS    R8
+#define REG_TEMP      R9
+#define REG_SHIFTED   RDX
+
+/*
+ * stack frame.  The first 32 bytes are the shadow space that the Microsoft
+ * ABI wants, and the size keeps RSP 16-byte aligned after the six pushes.
+ */
+#define FRAME_SIZE 56
+#define SLOT_MEMVAL  32
+#define SLOT_SHIFTED 36
+#define SLOT_INPUTS  40
+#define SLOT_ADDR    44
+
+static void emit_prologue(void) {
+    x86asm_pushq_reg64(RBP);
+    x86asm_pushq_reg64(RBX);
+    x86asm_pushq_reg64(R12);
+    x86asm_pushq_reg64(R13);
+    x86asm_pushq_reg64(R14);
+    x86asm_pushq_reg64(R15);
+    x86asm_addq_imm8_reg(-FRAME_SIZE, RSP);
+
+    x86asm_mov_reg64_reg64(REG_ARG0, REG_TEMP_BASE);
+    x86asm_addq_imm32_reg64(offsetof(struct aica_dsp, temp), REG_TEMP_BASE);
+    x86asm_mov_reg64_reg64(REG_ARG1, REG_WAVE_MEM);
+
+    // all of these start each sample at zero
+    x86asm_xorl_reg32_reg32(REG_ACC, REG_ACC);
+    x86asm_xorl_reg32_reg32(REG_FRC, REG_FRC);
+    x86asm_xorl_reg32_reg32(REG_Y, REG_Y);
+    x86asm_xorl_reg32_reg32(REG_ADRS, REG_ADRS);
+    x86asm_movl_reg_disp8_reg(REG_ACC, SLOT_MEMVAL, RSP);
+}
+
+static void emit_epilogue(void) {
+    x86asm_addq_imm8_reg(FRAME_SIZE, RSP);
+    x86asm_popq_reg64(R15);
+    x86asm_popq_reg64(R14);
+    x86asm_popq_reg64(R13);
+    x86asm_popq_reg64(R12);
+    x86asm_popq_reg64(RBX);
+    x86asm_popq_reg64(RBP);
+    x86asm_ret();
+}
+
+// sign-extend the lower 24 bits of reg_no
+static void emit_sign_extend_24(unsigned reg_no) {
+    x86asm_shll_imm8_reg32(8, reg_no);
+    x86asm_sarl_imm8_reg32(8, reg_no);
+}
+
+// clamp reg_no to [min, max]; clobbers R11D
+static void emit_clamp(unsigned reg_no, int32_t min, int32_t max) {
+    x86asm_mov_imm32_reg32(max, R11D);
+    x86asm_cmpl_reg32_reg32(R11D, reg_no);
+    x86asm_cmovgl_reg32_reg32(R11D, reg_no);
+    x86asm_mov_imm32_reg32(min, R11D);
+    x86asm_cmpl_reg32_reg32(R11D, reg_no);
+    x86asm_cmovll_reg32_reg32(R11D, reg_no);
+}
+
+// %rcx = (DEC + offs) & 0x7f, for indexing TEMP
+static void emit_temp_idx(unsigned offs) {
+    x86asm_movl_disp32_reg_reg(DSP_OFFS(dec), REG_TEMP_BASE, ECX);
+    x86asm_addq_imm32_reg64(offs, RCX);
+    x86asm_andl_imm32_reg32(0x7f, ECX);
+}
+
+// keep the registers that a call would clobber
+static void emit_spill(void) {
+    x86asm_movl_reg_disp8_reg(REG_SHIFTED, SLOT_SHIFTED, RSP);
+    x86asm_movl_reg_disp8_reg(REG_INPUTS, SLOT_INPUTS, RSP);
+    x86asm_movl_reg_disp8_reg(ECX, SLOT_ADDR, RSP);
+}
+
+static void emit_unspill(void) {
+    x86asm_movl_disp8_reg_reg(SLOT_SHIFTED, RSP, REG_SHIFTED);
+    x86asm_movl_disp8_reg_reg(SLOT_INPUTS, RSP, REG_INPUTS);
+    x86asm_movl_disp8_reg_reg(SLOT_ADDR, RSP, ECX);
+}
+
+static void emit_step(struct aica_dsp const *dsp,
+                      struct aica_dsp_step const *step) {
+    uint32_t flags = step->flags;
+    bool keep_acc = flags & AICA_DSP_KEEP_ACC;
+    bool use_inputs = (keep_acc && (flags & AICA_DSP_XSEL)) ||
+        (flags & AICA_DSP_YRL) ||
+        ((flags & AICA_DSP_ADRL) && step->shift != 3);
+    bool use_temp = keep_acc &&
+        (!(flags & AICA_DSP_XSEL) ||
+         !(flags & (AICA_DSP_ZERO | AICA_DSP_BSEL)));
+    bool use_shifted = (flags & (AICA_DSP_TWT | AICA_DSP_FRCL |
+                                 AICA_DSP_MWT | AICA_DSP_EWT)) ||
+        ((flags & AICA_DSP_ADRL) && step->shift == 3);
+
+    if (use_inputs) {
+        if ((flags & AICA_DSP_IWT) && step->ira == step->iwa) {
+            x86asm_movl_disp8_reg_reg(SLOT_MEMVAL, RSP, REG_INPUTS);
+        } else if (step->ira < 0x20) {
+            x86asm_movl_disp32_reg_reg(DSP_OFFS(mems) + 4 * step->ira,
+                                       REG_TEMP_BASE, REG_INPUTS);
+            emit_sign_extend_24(REG_INPUTS);
+        } else if (step->ira < 0x30) {
+            // MIXS gets multiplied by 16 on the way in
+            x86asm_movl_disp32_reg_reg(DSP_OFFS(mixs) +
+                                       4 * (step->ira - 0x20),
+                                       REG_TEMP_BASE, REG_INPUTS);
+            x86asm_shll_imm8_reg32(12, REG_INPUTS);
+            x86asm_sarl_imm8_reg32(8, REG_INPUTS);
+        } else {
+            x86asm_xorl_reg32_reg32(REG_INPUTS, REG_INPUTS);
+        }
+    }
+
+    if (flags & AICA_DSP_IWT) {
+        x86asm_movl_disp8_reg_reg(SLOT_MEMVAL, RSP, EAX);
+        x86asm_movl_reg_disp32_reg(EAX, DSP_OFFS(mems) + 4 * step->iwa,
+                                   REG_TEMP_BASE);
+    }
+
+    if (use_temp) {
+        emit_temp_idx(step->tra);
+        x86asm_movl_sib_reg(REG_TEMP_BASE, 4, RCX, REG_TEMP);
+        emit_sign_extend_24(REG_TEMP);
+    }
+
+    // SHIFTED comes from the ACC that the last step left behind
+    if (use_shifted) {
+        x86asm_mov_reg32_reg32(REG_ACC, REG_SHIFTED);
+        switch (step->shift) {
+        case 0:
+            emit_clamp(REG_SHIFTED, -0x800000, 0x7fffff);
+            break;
+        case 1:
+            x86asm_shll_imm8_reg32(1, REG_SHIFTED);
+            emit_clamp(REG_SHIFTED, -0x800000, 0x7fffff);
+            break;
+        case 2:
+            x86asm_shll_imm8_reg32(9, REG_SHIFTED);
+            x86asm_sarl_imm8_reg32(8, REG_SHIFTED);
+            break;
+        default:
+            emit_sign_extend_24(REG_SHIFTED);
+            break;
+        }
+    }
+
+    if (keep_acc) {
+        bool have_product = true;
+
+        // Y goes in EAX
+        switch (step->ysel) {
+        case 0:
+            x86asm_mov_reg32_reg32(REG_FRC, EAX);
+            x86asm_shll_imm8_reg32(19, EAX);
+            x86asm_sarl_imm8_reg32(19, EAX);
+            break;
+        case 1:
+            if (step->coef)
+                x86asm_mov_imm32_reg32(step->coef, EAX);
+            else
+                have_product = false;
+            break;
+        case 2:
+            // bits 11-23 of Y_REG, sign-extended
+            x86asm_mov_reg32_reg32(REG_Y, EAX);
+            x86asm_shll_imm8_reg32(8, EAX);
+            x86asm_sarl_imm8_reg32(19, EAX);
+            break;
+        default:
+            // bits 4-15 of Y_REG, which can never be negative
+            x86asm_mov_reg32_reg32(REG_Y, EAX);
+            x86asm_shrl_imm8_reg32(4, EAX);
+            x86asm_andl_imm32_reg32(0xfff, EAX);
+            break;
+        }
+
+        // B goes in R11D
+        if (!(flags & AICA_DSP_ZERO)) {
+            x86asm_mov_reg32_reg32((flags & AICA_DSP_BSEL) ?
+                                   REG_ACC : REG_TEMP, R11D);
+            if (flags & AICA_DSP_NEGB)
+                x86asm_negl_reg32(R11D);
+        }
+
+        if (have_product) {
+            x86asm_movslq_reg32_reg64(EAX, RAX);
+            x86asm_movslq_reg32_reg64((flags & AICA_DSP_XSEL) ?
+                                      REG_INPUTS : REG_TEMP, RCX);
+            x86asm_imulq_reg64_reg64(RCX, RAX);
+            x86asm_sarq_imm8_reg64(12, RAX);
+            if (!(flags & AICA_DSP_ZERO))
+                x86asm_addl_reg32_reg32(R11D, EAX);
+            x86asm_mov_reg32_reg32(EAX, REG_ACC);
+        } else if (flags & AICA_DSP_ZERO) {
+            x86asm_xorl_reg32_reg32(REG_ACC, REG_ACC);
+        } else {
+            x86asm_mov_reg32_reg32(R11D, REG_ACC);
+        }
+    }
+
+    if (flags & AICA_DSP_YRL)
+        x86asm_mov_reg32_reg32(REG_INPUTS, REG_Y);
+
+    if (flags & AICA_DSP_TWT) {
+        emit_temp_idx(step->twa);
+        x86asm_movl_reg_sib(REG_SHIFTED, REG_TEMP_BASE, 4, RCX);
+    }
+
+    if (flags & AICA_DSP_FRCL) {
+        x86asm_mov_reg32_reg32(REG_SHIFTED, REG_FRC);
+        if (step->shift == 3) {
+            x86asm_andl_imm32_reg32(0x0fff, REG_FRC);
+        } else {
+            x86asm_sarl_imm8_reg32(11, REG_FRC);
+            x86asm_andl_imm32_reg32(0x1fff, REG_FRC);
+        }
+    }
+
+    if (flags & (AICA_DSP_MRD | AICA_DSP_MWT)) {
+        // the byte offset into wave memory goes in RCX
+        uint32_t madrs = step->madrs;
+        if (flags & AICA_DSP_NXADR)
+            madrs++;
+
+        if (flags & AICA_DSP_TABLE) {
+            x86asm_mov_imm32_reg32(madrs, ECX);
+        } else {
+            x86asm_movl_disp32_reg_reg(DSP_OFFS(dec), REG_TEMP_BASE, ECX);
+            x86asm_addq_imm32_reg64(madrs, RCX);
+        }
+        if (flags & AICA_DSP_ADREB) {
+            x86asm_mov_reg32_reg32(REG_ADRS, EAX);
+            x86asm_andl_imm32_reg32(0x0fff, EAX);
+            x86asm_addl_reg32_reg32(EAX, ECX);
+        }
+        x86asm_andl_imm32_reg32((flags & AICA_DSP_TABLE) ?
+                                0xffff : dsp->rb_len - 1, ECX);
+        x86asm_shll_imm8_reg32(1, ECX);
+        x86asm_addq_imm32_reg64(dsp->rb_base, RCX);
+        x86asm_andl_imm32_reg32(AICA_WAVE_MEM_MASK, ECX);
+
+        if (flags & AICA_DSP_MRD) {
+            x86asm_movw_sib_reg(REG_WAVE_MEM, 1, RCX, EAX);
+            if (flags & AICA_DSP_NOFL) {
+                x86asm_movsx_reg16_reg32(EAX, EAX);
+                x86asm_shll_imm8_reg32(8, EAX);
+            } else {
+                emit_spill();
+                x86asm_andl_imm32_reg32(0xffff, EAX);
+                x86asm_mov_reg32_reg32(EAX, REG_ARG0);
+                x86asm_call_ptr(aica_dsp_unpack);
+                emit_unspill();
+            }
+            x86asm_movl_reg_disp8_reg(EAX, SLOT_MEMVAL, RSP);
+        }
+
+        if (flags & AICA_DSP_MWT) {
+            if (flags & AICA_DSP_NOFL) {
+                x86asm_mov_reg32_reg32(REG_SHIFTED, EAX);
+                x86asm_sarl_imm8_reg32(8, EAX);
+            } else {
+                emit_spill();
+                x86asm_mov_reg32_reg32(REG_SHIFTED, REG_ARG0);
+                x86asm_call_ptr(aica_dsp_pack);
+                emit_unspill();
+            }
+            x86asm_movw_reg_sib(EAX, REG_WAVE_MEM, 1, RCX);
+
+#ifdef ENABLE_DEBUGGER
+            /*
+             * same as aica_wave_mem_note_write.  The address is always even,
+             * so both bytes are on the same page.
+             */
+            x86asm_shrl_imm8_reg32(AICA_WAVE_MEM_PAGE_SHIFT, ECX);
+            x86asm_addq_imm32_reg64(offsetof(struct aica_wave_mem,
+                                             written_pages), RCX);
+            x86asm_mov_imm32_reg32(1, R11D);
+            x86asm_movb_reg_sib(R11D, REG_WAVE_MEM, 1, RCX);
+#endif
+        }
+    }
+
+    if (flags & AICA_DSP_ADRL) {
+        if (step->shift == 3) {
+            x86asm_mov_reg32_reg32(REG_SHIFTED, REG_ADRS);
+            x86asm_sarl_imm8_reg32(12, REG_ADRS);
+            x86asm_andl_imm32_reg32(0xfff, REG_ADRS);
+        } else {
+            x86asm_mov_reg32_reg32(REG_INPUTS, REG_ADRS);
+            x86asm_sarl_imm8_reg32(16, REG_ADRS);
+        }
+    }
+
+    if (flags & AICA_DSP_EWT) {
+        int disp = DSP_OFFS(efreg) + 4 * step->ewa;
+        x86asm_movl_disp32_reg_reg(disp, REG_TEMP_BASE, EAX);
+        x86asm_mov_reg32_reg32(REG_SHIFTED, ECX);
+        x86asm_sarl_imm8_reg32(8, ECX);
+        x86asm_addl_reg32_reg32(ECX, EAX);
+        emit_clamp(EAX, -0x8000, 0x7fff);
+        x86asm_movl_reg_disp32_reg(EAX, disp, REG_TEMP_BASE);
+    }
+}
+
+void aica_dsp_native_compile(struct aica_dsp *dsp) {
+    unsigned n_bytes = 0;
+    unsigned step_no;
+
+    x86asm_set_dst(NULL, dsp->native, &n_bytes, AICA_DSP_NATIVE_LEN);
+
+    emit_prologue();
+
+    for (step_no = 0; step_no < dsp->prog_len; step_no++) {
+        /*
+         * Running out of room would make the emitter try to grow the
+         * allocation, which isn't safe to do from the AICA's thread.
+         * AICA_DSP_NATIVE_LEN is supposed to make sure this never happens.
+         */
+        if (AICA_DSP_NATIVE_LEN - n_bytes < AICA_DSP_NATIVE_STEP_MAX + 64)
+            RAISE_ERROR(ERROR_OVERFLOW);
+        emit_step(dsp, dsp->prog + step_no);
+    }
+
+    emit_epilogue();
+}
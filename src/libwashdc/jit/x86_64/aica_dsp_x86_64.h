@@ -0,0 +1,51 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef AICA_DSP_X86_64_H_
+#define AICA_DSP_X86_64_H_
+
+#ifndef ENABLE_JIT_X86_64
+#error this file should not be built when the x86_64 JIT backend is disabled
+#endif
+
+struct aica_dsp;
+struct aica_wave_mem;
+
+// a bit more than the longest a step compiles to, which is about 390 bytes
+#define AICA_DSP_NATIVE_STEP_MAX 512
+
+// enough room for a full-length program and the code around it
+#define AICA_DSP_NATIVE_LEN (AICA_DSP_N_STEPS * AICA_DSP_NATIVE_STEP_MAX + 256)
+
+/*
+ * runs the program for one sample.  EFREG has to be cleared beforehand, and
+ * DEC gets left alone.
+ */
+typedef void(*aica_dsp_native_fn)(struct aica_dsp*, struct aica_wave_mem*);
+
+/*
+ * translate dsp->prog to x86_64 code.  The code goes into dsp->native, which
+ * needs to be at least AICA_DSP_NATIVE_LEN bytes long.
+ */
+void aica_dsp_native_compile(struct aica_dsp *dsp);
+
+#endif
@@ -149,8 +149,8 @@ static struct reg_stat const gen_regs_template[N_REGS] = {
     },
     [R14] = {
         /*
-         * pointer to code_cache_tbl.  This is the same on both Unix and
-         * Microsoft ABI.
+         * pointer to the code cache's hash table.  This is the same on both
+         * Unix and Microsoft ABI.
          */
         .locked = true,
         .prio = 9,
@@ -849,22 +849,24 @@ static void ungrab_slot(unsigned slot_no) {
 
 #define X86_64_ALLOC_SIZE 32
 
-void code_block_x86_64_init(struct code_block_x86_64 *blk) {
-    void *native = exec_mem_alloc(X86_64_ALLOC_SIZE);
+void code_block_x86_64_init(struct code_block_x86_64 *blk,
+                            struct exec_mem *native) {
+    void *alloc = exec_mem_alloc(native, X86_64_ALLOC_SIZE);
     blk->cycle_count = 0;
     blk->bytes_used = 0;
 
-    if (!native) {
+    if (!alloc) {
         error_set_errno_val(errno);
         RAISE_ERROR(ERROR_FAILED_ALLOC);
     }
 
-    blk->native = native;
-    blk->exec_mem_alloc_start = native;
+    blk->native = alloc;
+    blk->exec_mem_alloc_start = alloc;
 }
 
-void code_block_x86_64_cleanup(struct code_block_x86_64 *blk) {
-    exec_mem_free(blk->exec_mem_alloc_start);
+void code_block_x86_64_cleanup(struct code_block_x86_64 *blk,
+                               struct exec_mem *native) {
+    exec_mem_free(native, blk->exec_mem_alloc_start);
     memset(blk, 0, sizeof(*blk));
 }
 
@@ -1760,7 +1762,8 @@ static void emit_set_gt_unsigned(struct code_block_x86_64 *blk,
     x86asm_lbl8_init(&lbl);
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lhs, 4);
-    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
+    if (slot_rhs != slot_lhs)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 4);
 
     x86asm_cmpl_reg32_reg32(slots[slot_rhs].reg_no, slots[slot_lhs].reg_no);
@@ -1769,7 +1772,8 @@ static void emit_set_gt_unsigned(struct code_block_x86_64 *blk,
     x86asm_lbl8_define(&lbl);
 
     ungrab_slot(slot_dst);
-    ungrab_slot(slot_rhs);
+    if (slot_rhs != slot_lhs)
+        ungrab_slot(slot_rhs);
     ungrab_slot(slot_lhs);
 
     x86asm_lbl8_cleanup(&lbl);
@@ -1786,7 +1790,8 @@ static void emit_set_gt_signed(struct code_block_x86_64 *blk,
     x86asm_lbl8_init(&lbl);
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lhs, 4);
-    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
+    if (slot_rhs != slot_lhs)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 4);
 
     x86asm_cmpl_reg32_reg32(slots[slot_rhs].reg_no, slots[slot_lhs].reg_no);
@@ -1795,7 +1800,8 @@ static void emit_set_gt_signed(struct code_block_x86_64 *blk,
     x86asm_lbl8_define(&lbl);
 
     ungrab_slot(slot_dst);
-    ungrab_slot(slot_rhs);
+    if (slot_rhs != slot_lhs)
+        ungrab_slot(slot_rhs);
     ungrab_slot(slot_lhs);
 
     x86asm_lbl8_cleanup(&lbl);
@@ -1860,7 +1866,8 @@ static void emit_set_eq(struct code_block_x86_64 *blk,
     x86asm_lbl8_init(&lbl);
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lhs, 4);
-    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
+    if (slot_rhs != slot_lhs)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 4);
 
     x86asm_cmpl_reg32_reg32(slots[slot_rhs].reg_no, slots[slot_lhs].reg_no);
@@ -1870,7 +1877,8 @@ static void emit_set_eq(struct code_block_x86_64 *blk,
     x86asm_lbl8_define(&lbl);
 
     ungrab_slot(slot_dst);
-    ungrab_slot(slot_rhs);
+    if (slot_rhs != slot_lhs)
+        ungrab_slot(slot_rhs);
     ungrab_slot(slot_lhs);
 
     x86asm_lbl8_cleanup(&lbl);
@@ -1887,7 +1895,8 @@ static void emit_set_ge_unsigned(struct code_block_x86_64 *blk,
     x86asm_lbl8_init(&lbl);
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lhs, 4);
-    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
+    if (slot_rhs != slot_lhs)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 4);
 
     x86asm_cmpl_reg32_reg32(slots[slot_rhs].reg_no, slots[slot_lhs].reg_no);
@@ -1896,7 +1905,8 @@ static void emit_set_ge_unsigned(struct code_block_x86_64 *blk,
     x86asm_lbl8_define(&lbl);
 
     ungrab_slot(slot_dst);
-    ungrab_slot(slot_rhs);
+    if (slot_rhs != slot_lhs)
+        ungrab_slot(slot_rhs);
     ungrab_slot(slot_lhs);
 
     x86asm_lbl8_cleanup(&lbl);
@@ -1913,7 +1923,8 @@ static void emit_set_ge_signed(struct code_block_x86_64 *blk,
     x86asm_lbl8_init(&lbl);
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lhs, 4);
-    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
+    if (slot_rhs != slot_lhs)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 4);
 
     x86asm_cmpl_reg32_reg32(slots[slot_rhs].reg_no, slots[slot_lhs].reg_no);
@@ -1922,7 +1933,8 @@ static void emit_set_ge_signed(struct code_block_x86_64 *blk,
     x86asm_lbl8_define(&lbl);
 
     ungrab_slot(slot_dst);
-    ungrab_slot(slot_rhs);
+    if (slot_rhs != slot_lhs)
+        ungrab_slot(slot_rhs);
     ungrab_slot(slot_lhs);
 
     x86asm_lbl8_cleanup(&lbl);
@@ -1941,7 +1953,8 @@ static void emit_mul_u32(struct code_block_x86_64 *blk,
     grab_register(&gen_reg_state.set, EDX);
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lhs, 4);
-    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
+    if (slot_rhs != slot_lhs)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 4);
 
 #ifdef INVARIANTS
@@ -1956,7 +1969,8 @@ static void emit_mul_u32(struct code_block_x86_64 *blk,
     x86asm_mov_reg32_reg32(REG_RET, slots[slot_dst].reg_no);
 
     ungrab_slot(slot_dst);
-    ungrab_slot(slot_rhs);
+    if (slot_rhs != slot_lhs)
+        ungrab_slot(slot_rhs);
     ungrab_slot(slot_lhs);
     ungrab_register(&gen_reg_state.set, EDX);
     ungrab_register(&gen_reg_state.set, REG_RET);
@@ -2023,12 +2037,20 @@ static void emit_shad(struct code_block_x86_64 *blk,
     struct x86asm_lbl8 lbl;
     x86asm_lbl8_init(&lbl);
 
-    x86asm_testl_reg32_reg32(slots[slot_shift_amt].reg_no,
-                             slots[slot_shift_amt].reg_no);
+    /*
+     * test the copy in ECX because slot_shift_amt isn't grabbed anymore (and
+     * it was just shifted if it's the same slot as slot_val)
+     */
+    x86asm_testl_reg32_reg32(ECX, ECX);
     x86asm_jns_lbl8(&lbl);
 
-    x86asm_negl_reg32(ECX);
+    /*
+     * right-shift by ((~shift_amt) & 0x1f) + 1, which can be as much as 32.
+     * x86 masks CL to 5 bits, so do the extra 1 separately.
+     */
+    x86asm_notl_reg32(ECX);
     x86asm_sarl_cl_reg32(reg_tmp);
+    x86asm_sarl_imm8_reg32(1, reg_tmp);
     x86asm_mov_reg32_reg32(reg_tmp, slots[slot_val].reg_no);
 
     x86asm_lbl8_define(&lbl);
@@ -2219,8 +2241,8 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
     out->cycle_count = cycle_count;
     out->dirty_stack = false;
 
-    x86asm_set_dst(out->exec_mem_alloc_start, &out->bytes_used,
-                   X86_64_ALLOC_SIZE);
+    x86asm_set_dst(dispatch_meta->exec_mem, out->exec_mem_alloc_start,
+                   &out->bytes_used, X86_64_ALLOC_SIZE);
 
     reset_slots();
 
@@ -2409,3 +2431,18 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
 
     native_check_cycles_emit(dispatch_meta);
 }
+
+void code_block_x86_64_compile_break(struct code_block_x86_64 *out,
+                                     struct native_dispatch_meta const *dispatch_meta,
+                                     uint32_t pc) {
+    out->cycle_count = 0;
+    out->dirty_stack = false;
+
+    x86asm_set_dst(dispatch_meta->exec_mem, out->exec_mem_alloc_start,
+                   &out->bytes_used, X86_64_ALLOC_SIZE);
+    out->native = out->exec_mem_alloc_start;
+
+    x86asm_mov_imm32_reg32(pc, NATIVE_DISPATCH_PC_REG);
+    x86asm_mov_imm64_reg64((uintptr_t)dispatch_meta->break_fn, REG_RET);
+    x86asm_jmpq_reg64(REG_RET);
+}
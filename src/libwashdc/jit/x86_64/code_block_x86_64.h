@@ -32,6 +32,7 @@
 
 struct il_code_block;
 struct native_dispatch_meta;
+struct exec_mem;
 
 struct code_block_x86_64 {
     /*
@@ -51,14 +52,27 @@ struct code_block_x86_64 {
 void jit_x86_64_backend_init(void);
 void jit_x86_64_backend_cleanup(void);
 
-void code_block_x86_64_init(struct code_block_x86_64 *blk);
-void code_block_x86_64_cleanup(struct code_block_x86_64 *blk);
+// native is the exec_mem arena which the block gets allocated from
+void code_block_x86_64_init(struct code_block_x86_64 *blk,
+                            struct exec_mem *native);
+void code_block_x86_64_cleanup(struct code_block_x86_64 *blk,
+                               struct exec_mem *native);
 
 void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
                                struct il_code_block const *il_blk,
                                struct native_dispatch_meta const *dispatch_meta,
                                unsigned cycle_count);
 
+/*
+ * compile a code block which does nothing but return from the native
+ * dispatcher with the PC set to pc, without executing any instructions or
+ * advancing the clock.  The debugger puts these at the addresses of
+ * breakpoints so that it can single-step over them.
+ */
+void code_block_x86_64_compile_break(struct code_block_x86_64 *out,
+                                     struct native_dispatch_meta const *dispatch_meta,
+                                     uint32_t pc);
+
 /*
  * if the stack is not 16-byte aligned, make it 16-byte aligned.
  * This way, when the CALL instruction is issued the stack will be off from
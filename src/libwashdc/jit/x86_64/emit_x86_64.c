@@ -39,21 +39,31 @@
 
 #define X86_64_GROW_SIZE 32
 
-static void *alloc_start;
-static unsigned alloc_len;
+/*
+ * The AICA compiles its DSP program on its own thread when it has one, so
+ * every thread gets its own place to emit to.
+ */
+static WASHDC_THREAD_LOCAL struct exec_mem *alloc_mem;
+static WASHDC_THREAD_LOCAL void *alloc_start;
+static WASHDC_THREAD_LOCAL unsigned alloc_len;
 
-static uint8_t *washdc_emitp;
-static unsigned *n_bytes_out;
-static unsigned washdc_emitp_len;
+static WASHDC_THREAD_LOCAL uint8_t *washdc_emitp;
+static WASHDC_THREAD_LOCAL unsigned *n_bytes_out;
+static WASHDC_THREAD_LOCAL unsigned washdc_emitp_len;
 
 static void try_grow(void) {
     if (!alloc_start)
         RAISE_ERROR(ERROR_INTEGRITY);
-    if (exec_mem_grow(alloc_start, alloc_len + X86_64_GROW_SIZE) != 0) {
+    if (!alloc_mem) {
+        LOG_ERROR("Ran out of room after %u bytes\n", alloc_len);
+        RAISE_ERROR(ERROR_OVERFLOW);
+    }
+    if (exec_mem_grow(alloc_mem, alloc_start,
+                      alloc_len + X86_64_GROW_SIZE) != 0) {
         LOG_ERROR("Unable to grow allocation to %u bytes\n",
                   alloc_len + X86_64_GROW_SIZE);
         struct exec_mem_stats stats;
-        exec_mem_get_stats(&stats);
+        exec_mem_get_stats(alloc_mem, &stats);
         exec_mem_print_stats(&stats);
         RAISE_ERROR(ERROR_OVERFLOW);
     }
@@ -389,7 +399,9 @@ static void emit_mod_reg_rm_2_8bit(unsigned rex, unsigned opcode1,
     }
 }
 
-void x86asm_set_dst(void *out_ptr, unsigned *out_n_bytes, unsigned n_bytes) {
+void x86asm_set_dst(struct exec_mem *mem, void *out_ptr,
+                    unsigned *out_n_bytes, unsigned n_bytes) {
+    alloc_mem = mem;
     alloc_start = out_ptr;
     alloc_len = n_bytes;
     washdc_emitp = (uint8_t*)out_ptr;
@@ -814,6 +826,45 @@ void x86asm_movl_reg_sib(unsigned reg_src, unsigned reg_base,
     put8(sib);
 }
 
+// movw %<reg_src>, (%<reg_base>, <scale>, %<reg_index>)
+void x86asm_movw_reg_sib(unsigned reg_src, unsigned reg_base,
+                         unsigned scale, unsigned reg_index) {
+    unsigned log2;
+    switch (scale) {
+    case 1:
+        log2 = 0;
+        break;
+    case 2:
+        log2 = 1;
+        break;
+    case 4:
+        log2 = 2;
+        break;
+    case 8:
+        log2 = 3;
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+
+    unsigned rex = 0;
+    if (reg_base >= R8) {
+        rex |= REX_B;
+        reg_base -= R8;
+    }
+    if (reg_index >= R8) {
+        rex |= REX_X;
+        reg_index -= R8;
+    }
+
+    put8(0x66);
+
+    emit_mod_reg_rm_sib(rex, 0x89, 0, reg_src, SIB);
+
+    unsigned sib = reg_base | (reg_index << 3) | (log2 << 6);
+    put8(sib);
+}
+
 // movb %<reg_src>, (%<reg_base>, <scale>, %<reg_index>)
 void x86asm_movb_reg_sib(unsigned reg_src, unsigned reg_base,
                          unsigned scale, unsigned reg_index) {
@@ -1321,6 +1372,22 @@ void x86asm_sarl_imm8_reg32(unsigned imm8, unsigned reg_no) {
     put8(imm8);
 }
 
+// sarq $<imm8>, %reg_no
+void x86asm_sarq_imm8_reg64(unsigned imm8, unsigned reg_no) {
+    emit_mod_reg_rm(REX_W, 0xc1, 3, 7, reg_no);
+    put8(imm8);
+}
+
+// imulq %<reg_src>, %<reg_dst>
+void x86asm_imulq_reg64_reg64(unsigned reg_src, unsigned reg_dst) {
+    emit_mod_reg_rm_2(REX_W, 0x0f, 0xaf, 3, reg_dst, reg_src);
+}
+
+// movslq %<reg_src>, %<reg_dst>
+void x86asm_movslq_reg32_reg64(unsigned reg_src, unsigned reg_dst) {
+    emit_mod_reg_rm(REX_W, 0x63, 3, reg_dst, reg_src);
+}
+
 // shrl $<imm8>, %reg_no
 void x86asm_shrl_imm8_reg32(unsigned imm8, unsigned reg_no) {
     emit_mod_reg_rm(0, 0xc1, 3, 5, reg_no);
@@ -1431,6 +1498,11 @@ void x86asm_cmovgel_reg32_reg32(unsigned reg_src, unsigned reg_dst) {
     emit_mod_reg_rm_2(0, 0x0f, 0x4d, 3, reg_dst, reg_src);
 }
 
+// conditional-move if less (signed)
+void x86asm_cmovll_reg32_reg32(unsigned reg_src, unsigned reg_dst) {
+    emit_mod_reg_rm_2(0, 0x0f, 0x4c, 3, reg_dst, reg_src);
+}
+
 void x86asm_setnzl_reg32(unsigned reg_no) {
     emit_mod_reg_rm_2(0, 0x0f, 0x95, 3, 0, reg_no);
 }
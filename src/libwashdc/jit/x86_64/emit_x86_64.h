@@ -29,6 +29,8 @@
 
 #include <stdint.h>
 
+struct exec_mem;
+
 #define RAX 0
 #define RCX 1
 #define RDX 2
@@ -135,7 +137,12 @@ void x86asm_lbl8_define(struct x86asm_lbl8 *lbl);
 void x86asm_lbl8_push_jmp_pt(struct x86asm_lbl8 *lbl,
                              struct lbl_jmp_pt const *jmp_pt);
 
-void x86asm_set_dst(void *out_ptr, unsigned *out_n_bytes, unsigned n_bytes);
+/*
+ * emit to out_ptr, which is n_bytes long.  If mem is not NULL, out_ptr must
+ * be an allocation from mem, and it gets grown whenever it runs out of room.
+ */
+void x86asm_set_dst(struct exec_mem *mem, void *out_ptr,
+                    unsigned *out_n_bytes, unsigned n_bytes);
 void *x86asm_get_out_ptr(void);
 
 // call a function pointer contained in a general-purpose register
@@ -237,6 +244,10 @@ void x86asm_movq_reg_sib(unsigned reg_src, unsigned reg_base,
 void x86asm_movl_reg_sib(unsigned reg_src, unsigned reg_base,
                          unsigned scale, unsigned reg_index);
 
+// movw %<reg_src>, (%<reg_base>, <scale>, %<reg_index>)
+void x86asm_movw_reg_sib(unsigned reg_src, unsigned reg_base,
+                         unsigned scale, unsigned reg_index);
+
 // movb %<reg_src>, (%<reg_base>, <scale>, %<reg_index>)
 void x86asm_movb_reg_sib(unsigned reg_src, unsigned reg_base,
                          unsigned scale, unsigned reg_index);
@@ -461,6 +472,17 @@ void x86asm_sarl_cl_reg32(unsigned reg_no);
 // sarl $<imm8>, %reg_no
 void x86asm_sarl_imm8_reg32(unsigned imm8, unsigned reg_no);
 
+// sarq $<imm8>, %reg_no
+void x86asm_sarq_imm8_reg64(unsigned imm8, unsigned reg_no);
+
+// imulq %<reg_src>, %<reg_dst>
+// signed 64-bit multiplication, only the lower 64 bits of the result are kept
+void x86asm_imulq_reg64_reg64(unsigned reg_src, unsigned reg_dst);
+
+// movslq %<reg_src>, %<reg_dst>
+// sign-extend a 32-bit register into a 64-bit register
+void x86asm_movslq_reg32_reg64(unsigned reg_src, unsigned reg_dst);
+
 void* x86asm_get_outp(void);
 
 /*
@@ -496,6 +518,9 @@ void x86asm_cmovgel_reg32_reg32(unsigned reg_src, unsigned reg_dst);
 // conditional-move if greater-or-equal (unsigned)
 void x86asm_cmovael_reg32_reg32(unsigned reg_src, unsigned reg_dst);
 
+// conditional-move if less (signed)
+void x86asm_cmovll_reg32_reg32(unsigned reg_src, unsigned reg_dst);
+
 void x86asm_setnzl_reg32(unsigned reg_no);
 
 void x86asm_negl_reg32(unsigned reg_no);
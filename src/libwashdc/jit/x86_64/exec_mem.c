@@ -42,22 +42,19 @@
 
 #define X86_64_ALLOC_SIZE (512 * 1024 * 1024)
 
-static void *native;
-
 #define FREE_CHUNK_MAGIC  0xca55e77e
 #define ALLOC_CHUNK_MAGIC 0xfeedface
 
-#define MIN_FREE_CHUNK_SIZE sizeof(struct free_chunk)
+#define MIN_FREE_CHUNK_SIZE sizeof(struct exec_mem_free_chunk)
 
-// this list should always be sorted from small addrs to large addrs
-static struct free_chunk {
+struct exec_mem_free_chunk {
 #ifdef INVARIANTS
     unsigned magic;
 #endif
-    struct free_chunk *next;
-    struct free_chunk **pprev;
+    struct exec_mem_free_chunk *next;
+    struct exec_mem_free_chunk **pprev;
     size_t len;
-} *free_mem;
+};
 
 struct alloc_chunk {
 #ifdef INVARIANTS
@@ -66,48 +63,48 @@ struct alloc_chunk {
     size_t len, len_req;
 };
 
-static size_t n_allocations;
-unsigned largest_alloc, smallest_alloc;
-
 /*
  * This returns a pointer to the true start of the allocation, which is its
  * struct alloc_chunk.
  */
 static void *get_alloc_start(void *alloc_ptr);
 
-void exec_mem_init(void) {
+void exec_mem_init(struct exec_mem *mem) {
 #ifdef _WIN32
-    native = VirtualAlloc(NULL, X86_64_ALLOC_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-    if (!native)
+    mem->native = VirtualAlloc(NULL, X86_64_ALLOC_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+    if (!mem->native)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
     DWORD garbage;
-    if (!VirtualProtect(native, X86_64_ALLOC_SIZE,
+    if (!VirtualProtect(mem->native, X86_64_ALLOC_SIZE,
                         PAGE_EXECUTE_READWRITE, &garbage))
         RAISE_ERROR(ERROR_FAILED_ALLOC);
 #else
-    native = mmap(NULL, X86_64_ALLOC_SIZE, PROT_WRITE | PROT_EXEC | PROT_READ,
-                  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (native == MAP_FAILED)
+    mem->native = mmap(NULL, X86_64_ALLOC_SIZE,
+                       PROT_WRITE | PROT_EXEC | PROT_READ,
+                       MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (mem->native == MAP_FAILED)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
 #endif
 
-    free_mem = native;
-    free_mem->next = NULL;
-    free_mem->len = X86_64_ALLOC_SIZE;
-    free_mem->pprev = &free_mem;
+    mem->free_mem = mem->native;
+    mem->free_mem->next = NULL;
+    mem->free_mem->len = X86_64_ALLOC_SIZE;
+    mem->free_mem->pprev = &mem->free_mem;
 
 #ifdef INVARIANTS
-    free_mem->magic = FREE_CHUNK_MAGIC;
+    mem->free_mem->magic = FREE_CHUNK_MAGIC;
 #endif
+
+    mem->n_allocations = 0;
 }
 
-void exec_mem_cleanup(void) {
+void exec_mem_cleanup(struct exec_mem *mem) {
 #ifdef _WIN32
-    VirtualFree(native, 0, MEM_RELEASE);
+    VirtualFree(mem->native, 0, MEM_RELEASE);
 #else
-    munmap(native, X86_64_ALLOC_SIZE);
+    munmap(mem->native, X86_64_ALLOC_SIZE);
 #endif
-    native = NULL;
+    mem->native = NULL;
 }
 
 /*
@@ -115,9 +112,9 @@ void exec_mem_cleanup(void) {
  * due to autism.  Strictly speaking, alignment is not needed on x86 but I like
  * it.
  */
-void* exec_mem_alloc(size_t len_req) {
-    struct free_chunk *curs;
-    struct free_chunk *candidate = NULL;
+void* exec_mem_alloc(struct exec_mem *mem, size_t len_req) {
+    struct exec_mem_free_chunk *curs;
+    struct exec_mem_free_chunk *candidate = NULL;
     size_t len = len_req;
 
     // add in metadata plus room for padding
@@ -131,7 +128,7 @@ void* exec_mem_alloc(size_t len_req) {
      * pull off of the beginning of the largest available allocation.
      * this way, reallocations are more likely to succeed.
      */
-    for (curs = free_mem; curs; curs = curs->next) {
+    for (curs = mem->free_mem; curs; curs = curs->next) {
 #ifdef INVARIANTS
         if (curs->magic != FREE_CHUNK_MAGIC) {
             LOG_ERROR("%s - memory corruption detected at %p\n",
@@ -151,7 +148,7 @@ void* exec_mem_alloc(size_t len_req) {
         LOG_ERROR("%s - failed alloc of size %llu\n",
                   __func__, (unsigned long long)len);
         LOG_ERROR("exec_mem stats dump follows\n");
-        exec_mem_get_stats(&stats);
+        exec_mem_get_stats(mem, &stats);
         exec_mem_print_stats(&stats);
         return NULL;
     }
@@ -172,8 +169,8 @@ void* exec_mem_alloc(size_t len_req) {
         *candidate->pprev = candidate->next;
     } else {
         // split candidate allocation
-        struct free_chunk *new_chunk =
-            (struct free_chunk*)(((uint8_t*)candidate) + len/* sizeof(candidate) */);
+        struct exec_mem_free_chunk *new_chunk =
+            (struct exec_mem_free_chunk*)(((uint8_t*)candidate) + len/* sizeof(candidate) */);
         new_chunk->next = candidate->next;
         if (new_chunk->next)
             new_chunk->next->pprev = &new_chunk->next;
@@ -201,21 +198,22 @@ void* exec_mem_alloc(size_t len_req) {
     while (ret_ptr % 8)
         ret_ptr++;
 
-    n_allocations++;
+    mem->n_allocations++;
 
     void *ret = (void*)ret_ptr;
     memset(ret, 0, len_req);
     return ret;
 }
 
-void exec_mem_free(void *ptr) {
+void exec_mem_free(struct exec_mem *mem, void *ptr) {
     // match behavior of the libc free function by ignoring NULL
     if (!ptr)
         return;
 
     void *alloc_start = get_alloc_start(ptr);
     struct alloc_chunk *alloc = (struct alloc_chunk*)alloc_start;
-    struct free_chunk *free_chunk = (struct free_chunk*)alloc_start;
+    struct exec_mem_free_chunk *free_chunk =
+        (struct exec_mem_free_chunk*)alloc_start;
 
     uintptr_t as_int = (uintptr_t)alloc_start;
 
@@ -237,55 +235,55 @@ void exec_mem_free(void *ptr) {
 
     memset(free_chunk, 0, sizeof(*free_chunk));
 
-    if (!free_mem) {
+    if (!mem->free_mem) {
         // Oh wow, this is the only chunk.
 #ifdef INVARIANTS
         free_chunk->magic = FREE_CHUNK_MAGIC;
 #endif
         free_chunk->len = len;
-        free_chunk->pprev = &free_mem;
-        free_mem = free_chunk;
+        free_chunk->pprev = &mem->free_mem;
+        mem->free_mem = free_chunk;
         goto successful_free;
     }
 
     uintptr_t first_addr = as_int;
     uintptr_t last_addr = first_addr + (len - 1);
 
-    uintptr_t free_mem_first = (uintptr_t)(void*)free_mem;
+    uintptr_t free_mem_first = (uintptr_t)(void*)mem->free_mem;
     if ((free_mem_first - 1) > last_addr) {
         // this is the new first chunk
 #ifdef INVARIANTS
         free_chunk->magic = FREE_CHUNK_MAGIC;
 #endif
         free_chunk->len = len;
-        free_chunk->pprev = &free_mem;
-        free_chunk->next = free_mem;
+        free_chunk->pprev = &mem->free_mem;
+        free_chunk->next = mem->free_mem;
         free_chunk->next->pprev = &free_chunk->next;
-        free_mem = free_chunk;
+        mem->free_mem = free_chunk;
         goto successful_free;
     } else if ((free_mem_first - 1) == last_addr) {
         // absorb free_mem into this chunk and make it the new free_mem
 #ifdef INVARIANTS
         free_chunk->magic = FREE_CHUNK_MAGIC;
 #endif
-        free_chunk->len = len + free_mem->len;
-        free_chunk->next = free_mem->next;
+        free_chunk->len = len + mem->free_mem->len;
+        free_chunk->next = mem->free_mem->next;
         if (free_chunk->next)
             free_chunk->next->pprev = &free_chunk->next;
-        free_chunk->pprev = &free_mem;
-        free_mem = free_chunk;
+        free_chunk->pprev = &mem->free_mem;
+        mem->free_mem = free_chunk;
         goto successful_free;
     }
 
-    struct free_chunk *curs, *pre = NULL, *post = NULL;
-    for (curs = free_mem; curs; curs = curs->next) {
+    struct exec_mem_free_chunk *curs, *pre = NULL, *post = NULL;
+    for (curs = mem->free_mem; curs; curs = curs->next) {
 
 #ifdef INVARIANTS
         if (curs->magic != FREE_CHUNK_MAGIC)
             RAISE_ERROR(ERROR_INTEGRITY);
 #endif
 
-        struct free_chunk *next = curs->next;
+        struct exec_mem_free_chunk *next = curs->next;
         if (next) {
             uintptr_t next_first = (uintptr_t)(void*)next;
             if (next_first > last_addr) {
@@ -387,10 +385,10 @@ void exec_mem_free(void *ptr) {
     RAISE_ERROR(ERROR_INTEGRITY);
 
 successful_free:
-    n_allocations--;
+    mem->n_allocations--;
 }
 
-int exec_mem_grow(void *ptr, size_t len_req) {
+int exec_mem_grow(struct exec_mem *mem, void *ptr, size_t len_req) {
     struct alloc_chunk *alloc = (struct alloc_chunk*)get_alloc_start(ptr);
     uintptr_t alloc_first = (uintptr_t)alloc;
     uintptr_t alloc_last = alloc_first + (alloc->len - 1);
@@ -413,8 +411,8 @@ int exec_mem_grow(void *ptr, size_t len_req) {
     if (alloc->len_req >= len_req)
         return 0; // nothing to do here, i suppose
 
-    struct free_chunk *curs;
-    for (curs = free_mem; curs; curs = curs->next) {
+    struct exec_mem_free_chunk *curs;
+    for (curs = mem->free_mem; curs; curs = curs->next) {
         uintptr_t curs_first = (uintptr_t)curs;
         uintptr_t curs_last = curs_first + (curs->len - 1);
 
@@ -448,14 +446,14 @@ int exec_mem_grow(void *ptr, size_t len_req) {
                     memset(curs, 0, sizeof(*curs));
                     alloc->len_req = len_req;
 #ifdef INVARIANTS
-                    if (curs == free_mem)
+                    if (curs == mem->free_mem)
                         RAISE_ERROR(ERROR_INTEGRITY);
 #endif
                     return 0;
                 } else {
                     // split curs
-                    struct free_chunk *new_chunk =
-                        (struct free_chunk*)(void*)(alloc_goal + 1);
+                    struct exec_mem_free_chunk *new_chunk =
+                        (struct exec_mem_free_chunk*)(void*)(alloc_goal + 1);
                     memset(new_chunk, 0xaa, sizeof(*new_chunk));
 #ifdef INVARIANTS
                     new_chunk->magic = FREE_CHUNK_MAGIC;
@@ -469,7 +467,7 @@ int exec_mem_grow(void *ptr, size_t len_req) {
                     alloc->len_req = len_req;
                     alloc->len = alloc_goal - alloc_first + 1;
 #ifdef INVARIANTS
-                    if (curs == free_mem)
+                    if (curs == mem->free_mem)
                         RAISE_ERROR(ERROR_INTEGRITY);
 #endif
                     return 0;
@@ -510,18 +508,19 @@ static void *get_alloc_start(void *alloc_ptr) {
     return (void*)as_int;
 }
 
-void exec_mem_get_stats(struct exec_mem_stats *stats) {
+void exec_mem_get_stats(struct exec_mem const *mem,
+                        struct exec_mem_stats *stats) {
     size_t n_bytes = 0;
     unsigned n_free_chunks = 0;
-    struct free_chunk *curs;
-    for (curs = free_mem; curs; curs = curs->next) {
+    struct exec_mem_free_chunk *curs;
+    for (curs = mem->free_mem; curs; curs = curs->next) {
         n_bytes += curs->len;
         n_free_chunks++;
     }
 
     stats->total_bytes = X86_64_ALLOC_SIZE;
     stats->free_bytes = n_bytes;
-    stats->n_allocations = n_allocations;
+    stats->n_allocations = mem->n_allocations;
     stats->n_free_chunks = n_free_chunks;
 }
 
@@ -539,10 +538,10 @@ void exec_mem_print_stats(struct exec_mem_stats const *stats) {
 }
 
 #ifdef INVARIANTS
-void exec_mem_check_integrity(void) {
-    struct free_chunk *curs;
-    for (curs = free_mem; curs->next; curs = curs->next) {
-        struct free_chunk *next = curs->next;
+void exec_mem_check_integrity(struct exec_mem const *mem) {
+    struct exec_mem_free_chunk *curs;
+    for (curs = mem->free_mem; curs->next; curs = curs->next) {
+        struct exec_mem_free_chunk *next = curs->next;
         uintptr_t curs_first = (uintptr_t)curs;
         uintptr_t curs_last = curs_first + (curs->len - 1);
         uintptr_t next_first = (uintptr_t)next;
@@ -552,7 +551,7 @@ void exec_mem_check_integrity(void) {
             RAISE_ERROR(ERROR_INTEGRITY);
         }
 
-        struct free_chunk *curs2;
+        struct exec_mem_free_chunk *curs2;
         for (curs2 = next; curs2; curs2 = curs2->next) {
             uintptr_t curs2_first = (uintptr_t)curs2;
             uintptr_t curs2_last = curs2_first + (curs2->len - 1);
@@ -29,11 +29,26 @@
 
 #include <stddef.h>
 
-void exec_mem_init(void);
-void exec_mem_cleanup(void);
+struct exec_mem_free_chunk;
 
-void *exec_mem_alloc(size_t len_req);
-void exec_mem_free(void *ptr);
+/*
+ * an arena of executable memory.  Every washdc_instance has its own, and
+ * everything the JIT generates for that instance comes out of it.
+ */
+struct exec_mem {
+    void *native;
+
+    // this list should always be sorted from small addrs to large addrs
+    struct exec_mem_free_chunk *free_mem;
+
+    size_t n_allocations;
+};
+
+void exec_mem_init(struct exec_mem *mem);
+void exec_mem_cleanup(struct exec_mem *mem);
+
+void *exec_mem_alloc(struct exec_mem *mem, size_t len_req);
+void exec_mem_free(struct exec_mem *mem, void *ptr);
 
 /*
  * attempt to grow the given allocation to the given size.  This funciton
@@ -50,7 +65,7 @@ void exec_mem_free(void *ptr);
  * allocations will have a high probability of failure.  I don't think the JIT
  * will ever have a good reason to grow an old allocation, anyways.
  */
-int exec_mem_grow(void *ptr, size_t len_req);
+int exec_mem_grow(struct exec_mem *mem, void *ptr, size_t len_req);
 
 struct exec_mem_stats {
     size_t free_bytes;
@@ -59,7 +74,8 @@ struct exec_mem_stats {
     unsigned n_free_chunks;
 };
 
-void exec_mem_get_stats(struct exec_mem_stats *stats);
+void exec_mem_get_stats(struct exec_mem const *mem,
+                        struct exec_mem_stats *stats);
 void exec_mem_print_stats(struct exec_mem_stats const *stats);
 
 #ifdef INVARIANTS
@@ -69,7 +85,7 @@ void exec_mem_print_stats(struct exec_mem_stats const *stats);
  * where some memory allocation that another component thinks is not free
  * actually is.  It also cannot prove there are no memory leaks.
  */
-void exec_mem_check_integrity(void);
+void exec_mem_check_integrity(struct exec_mem const *mem);
 #endif
 
 #endif
@@ -0,0 +1,351 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef ENABLE_JIT_PERF
+#error this file should not be built with ENABLE_JIT_PERF disabled
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "log.h"
+#include "washdc/error.h"
+#include "washdc/config_file.h"
+#include "washdc/hostfile.h"
+#include "jit/code_block.h"
+#include "jit/jit_disas.h"
+
+#include "jit_perf.h"
+
+#define JITDUMP_MAGIC 0x4a695444
+#define JITDUMP_VERSION 1
+#define JITDUMP_ELF_MACH_X86_64 62
+
+enum jitdump_record_id {
+    JITDUMP_CODE_LOAD = 0,
+    JITDUMP_CODE_DEBUG_INFO = 2,
+    JITDUMP_CODE_CLOSE = 3
+};
+
+struct jitdump_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct jitdump_record_prefix {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+};
+
+struct jitdump_code_load {
+    struct jitdump_record_prefix prefix;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+    // followed by the NUL-terminated name and then the code itself
+};
+
+struct jitdump_debug_info {
+    struct jitdump_record_prefix prefix;
+    uint64_t code_addr;
+    uint64_t nr_entry;
+    // followed by nr_entry struct jitdump_debug_entry
+};
+
+struct jitdump_debug_entry {
+    uint64_t addr;
+    int32_t lineno;
+    int32_t discrim;
+    // followed by the NUL-terminated source file name
+};
+
+#define JIT_PERF_PATH_LEN 64
+
+static struct jit_perf {
+    bool enabled;
+
+    washdc_hostfile map;
+
+    int dump_fd;
+    void *dump_marker;
+    uint64_t code_index;
+
+    washdc_hostfile disas;
+    char disas_path[JIT_PERF_PATH_LEN];
+    unsigned disas_line;
+} perf = {
+    .map = WASHDC_HOSTFILE_INVALID,
+    .dump_fd = -1,
+    .disas = WASHDC_HOSTFILE_INVALID
+};
+
+static uint64_t jit_perf_timestamp(void) {
+    // perf has to be run with -k mono for these to line up with its samples
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void jit_perf_dump_write(void const *dat, size_t len) {
+    char const *pos = (char const*)dat;
+
+    if (perf.dump_fd < 0)
+        return;
+
+    while (len) {
+        ssize_t n_written = write(perf.dump_fd, pos, len);
+        if (n_written <= 0) {
+            LOG_ERROR("%s - failed to write jitdump; closing it\n", __func__);
+            close(perf.dump_fd);
+            perf.dump_fd = -1;
+            return;
+        }
+        pos += n_written;
+        len -= n_written;
+    }
+}
+
+static void jit_perf_dump_open(void) {
+    char path[JIT_PERF_PATH_LEN];
+    snprintf(path, sizeof(path), "/tmp/jit-%d.dump", (int)getpid());
+
+    perf.dump_fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (perf.dump_fd < 0) {
+        LOG_ERROR("%s - unable to open %s\n", __func__, path);
+        return;
+    }
+
+    /*
+     * perf finds the jitdump by looking for an executable mapping of it in
+     * the MMAP events it records, so this mapping has to exist even though
+     * nothing ever reads from it.
+     */
+    long pagesize = sysconf(_SC_PAGESIZE);
+    perf.dump_marker = mmap(NULL, pagesize, PROT_READ | PROT_EXEC,
+                            MAP_PRIVATE, perf.dump_fd, 0);
+    if (perf.dump_marker == MAP_FAILED) {
+        LOG_ERROR("%s - unable to mmap %s\n", __func__, path);
+        perf.dump_marker = NULL;
+        close(perf.dump_fd);
+        perf.dump_fd = -1;
+        return;
+    }
+
+    struct jitdump_header hdr = {
+        .magic = JITDUMP_MAGIC,
+        .version = JITDUMP_VERSION,
+        .total_size = sizeof(hdr),
+        .elf_mach = JITDUMP_ELF_MACH_X86_64,
+        .pid = getpid(),
+        .timestamp = jit_perf_timestamp()
+    };
+    jit_perf_dump_write(&hdr, sizeof(hdr));
+
+    LOG_INFO("writing jitdump to %s\n", path);
+}
+
+static void jit_perf_dump_close(void) {
+    if (perf.dump_fd >= 0) {
+        struct jitdump_record_prefix close_rec = {
+            .id = JITDUMP_CODE_CLOSE,
+            .total_size = sizeof(close_rec),
+            .timestamp = jit_perf_timestamp()
+        };
+        jit_perf_dump_write(&close_rec, sizeof(close_rec));
+    }
+
+    if (perf.dump_marker)
+        munmap(perf.dump_marker, sysconf(_SC_PAGESIZE));
+    if (perf.dump_fd >= 0)
+        close(perf.dump_fd);
+    perf.dump_marker = NULL;
+    perf.dump_fd = -1;
+}
+
+void jit_perf_init(void) {
+    bool use_map = false, use_dump = false, use_disas = false;
+
+    cfg_get_bool("wash.jit.perf.map", &use_map);
+    cfg_get_bool("wash.jit.perf.jitdump", &use_dump);
+    cfg_get_bool("wash.jit.perf.disas", &use_disas);
+
+    if (use_map) {
+        char path[JIT_PERF_PATH_LEN];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+        perf.map = washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                                        WASHDC_HOSTFILE_TEXT);
+        if (perf.map == WASHDC_HOSTFILE_INVALID)
+            LOG_ERROR("%s - unable to open %s\n", __func__, path);
+        else
+            LOG_INFO("writing perf map to %s\n", path);
+    }
+
+    if (use_dump)
+        jit_perf_dump_open();
+
+    if (use_disas && perf.dump_fd >= 0) {
+        snprintf(perf.disas_path, sizeof(perf.disas_path),
+                 "/tmp/washdc-jit-%d.txt", (int)getpid());
+        perf.disas = washdc_hostfile_open(perf.disas_path,
+                                          WASHDC_HOSTFILE_WRITE |
+                                          WASHDC_HOSTFILE_TEXT);
+        if (perf.disas == WASHDC_HOSTFILE_INVALID)
+            LOG_ERROR("%s - unable to open %s\n", __func__, perf.disas_path);
+        perf.disas_line = 1;
+    } else if (use_disas) {
+        LOG_WARN("wash.jit.perf.disas requires wash.jit.perf.jitdump\n");
+    }
+
+    perf.code_index = 0;
+    perf.enabled = perf.map != WASHDC_HOSTFILE_INVALID || perf.dump_fd >= 0;
+}
+
+void jit_perf_cleanup(void) {
+    if (perf.map != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_close(perf.map);
+    if (perf.disas != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_close(perf.disas);
+    jit_perf_dump_close();
+
+    perf.map = WASHDC_HOSTFILE_INVALID;
+    perf.disas = WASHDC_HOSTFILE_INVALID;
+    perf.enabled = false;
+}
+
+/*
+ * write the IL listing for the block and a debug-info record that points the
+ * start of the block at it.  perf inject wants the debug info to come before
+ * the load it belongs to.
+ */
+static void jit_perf_disas(char const *name, void const *code, unsigned len,
+                           struct il_code_block const *il_blk) {
+    unsigned first_line = perf.disas_line;
+
+    washdc_hostfile_printf(perf.disas, "%s (%u bytes at %p):\n",
+                           name, len, code);
+    perf.disas_line++;
+
+    unsigned inst_no;
+    for (inst_no = 0; inst_no < il_blk->inst_count; inst_no++) {
+        // jit_disas_il always prints exactly one line per instruction
+        jit_disas_il(perf.disas, il_blk->inst_list + inst_no, inst_no);
+        perf.disas_line++;
+    }
+    washdc_hostfile_putc(perf.disas, '\n');
+    perf.disas_line++;
+
+    size_t path_len = strlen(perf.disas_path) + 1;
+    size_t rec_len = sizeof(struct jitdump_debug_info) +
+        sizeof(struct jitdump_debug_entry) + path_len;
+    char *rec = (char*)malloc(rec_len);
+    if (!rec)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    struct jitdump_debug_info info = {
+        .prefix = {
+            .id = JITDUMP_CODE_DEBUG_INFO,
+            .total_size = rec_len,
+            .timestamp = jit_perf_timestamp()
+        },
+        .code_addr = (uintptr_t)code,
+        .nr_entry = 1
+    };
+    struct jitdump_debug_entry ent = {
+        .addr = (uintptr_t)code,
+        .lineno = first_line,
+        .discrim = 0
+    };
+
+    memcpy(rec, &info, sizeof(info));
+    memcpy(rec + sizeof(info), &ent, sizeof(ent));
+    memcpy(rec + sizeof(info) + sizeof(ent), perf.disas_path, path_len);
+    jit_perf_dump_write(rec, rec_len);
+    free(rec);
+}
+
+static void jit_perf_dump_load(char const *name, void const *code,
+                               unsigned len) {
+    size_t name_len = strlen(name) + 1;
+    size_t rec_len = sizeof(struct jitdump_code_load) + name_len + len;
+    char *rec = (char*)malloc(rec_len);
+    if (!rec)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    struct jitdump_code_load load = {
+        .prefix = {
+            .id = JITDUMP_CODE_LOAD,
+            .total_size = rec_len,
+            .timestamp = jit_perf_timestamp()
+        },
+        .pid = getpid(),
+        .tid = syscall(SYS_gettid),
+        .vma = (uintptr_t)code,
+        .code_addr = (uintptr_t)code,
+        .code_size = len,
+        .code_index = perf.code_index++
+    };
+
+    memcpy(rec, &load, sizeof(load));
+    memcpy(rec + sizeof(load), name, name_len);
+    memcpy(rec + sizeof(load) + name_len, code, len);
+    jit_perf_dump_write(rec, rec_len);
+    free(rec);
+}
+
+void jit_perf_publish(char const *cpu_name, uint32_t guest_addr,
+                      void const *code, unsigned len,
+                      struct il_code_block const *il_blk) {
+    if (!perf.enabled || !len)
+        return;
+
+    char name[32];
+    snprintf(name, sizeof(name), "%s_%08x", cpu_name, (unsigned)guest_addr);
+
+    if (perf.map != WASHDC_HOSTFILE_INVALID) {
+        washdc_hostfile_printf(perf.map, "%llx %x %s\n",
+                               (unsigned long long)(uintptr_t)code, len, name);
+    }
+
+    if (perf.dump_fd >= 0) {
+        if (perf.disas != WASHDC_HOSTFILE_INVALID && il_blk)
+            jit_perf_disas(name, code, len, il_blk);
+        jit_perf_dump_load(name, code, len);
+    }
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef JIT_PERF_H_
+#define JIT_PERF_H_
+
+/*
+ * Tells Linux perf about native code blocks so that samples which land in
+ * exec_mem can be attributed to the SH4 code they were compiled from.
+ *
+ * wash.jit.perf.map appends a line to /tmp/perf-<pid>.map for every block
+ * that gets published.  perf reads that file on its own, but it has no notion
+ * of code being unloaded, so if a block is invalidated and its memory is later
+ * handed out to a different block then the two will fight over that address
+ * range.
+ *
+ * wash.jit.perf.jitdump writes /tmp/jit-<pid>.dump in the format described by
+ * tools/perf/Documentation/jitdump-specification.txt in the Linux source.
+ * Every load is timestamped, so reused addresses are attributed to whichever
+ * block was there at the time of the sample.  Record with
+ * "perf record -k mono" and then run "perf inject --jit" over the result.
+ *
+ * If wash.jit.perf.disas is also set, the IL of each block gets written to
+ * /tmp/washdc-jit-<pid>.txt and the jitdump gets debug info pointing at it, so
+ * perf report/annotate can show which block listing a sample belongs to.
+ */
+
+#ifndef ENABLE_JIT_PERF
+#error this file should not be built with ENABLE_JIT_PERF disabled
+#endif
+
+#include <stdint.h>
+
+struct il_code_block;
+
+void jit_perf_init(void);
+void jit_perf_cleanup(void);
+
+/*
+ * Call this after a native block has been compiled.  code points to the start
+ * of the block's executable memory and len is the number of bytes emitted.
+ * il_blk can be NULL if there's no IL to disassemble.
+ */
+void jit_perf_publish(char const *cpu_name, uint32_t guest_addr,
+                      void const *code, unsigned len,
+                      struct il_code_block const *il_blk);
+
+#endif
@@ -29,6 +29,7 @@
 #include "exec_mem.h"
 #include "jit/code_cache.h"
 #include "jit/jit.h"
+#include "jit/jit_sample.h"
 #include "abi.h"
 
 #include "emit_x86_64.h"
@@ -57,6 +58,8 @@ static void load_quad_into_reg(void *qptr, unsigned reg_no);
 static void store_quad_from_reg(void *qptr, unsigned reg_no,
                                 unsigned clobber_reg);
 static void create_return_fn(struct native_dispatch_meta *meta);
+static void create_break_fn(struct native_dispatch_meta *meta);
+static void emit_entry_epilogue(void);
 
 static void jmp_to_addr(void *addr, unsigned clobber_reg);
 
@@ -68,6 +71,12 @@ void native_dispatch_entry_create(struct native_dispatch_meta *meta);
 static void create_profile_code(struct native_dispatch_meta *meta);
 #endif
 
+#ifdef ENABLE_TRACE
+static void emit_trace_block(struct native_dispatch_meta const *meta);
+#endif
+
+static void emit_sample_block(struct native_dispatch_meta const *meta);
+
 static void
 native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta);
 
@@ -88,12 +97,14 @@ void native_dispatch_init(struct native_dispatch_meta *meta, void *ctx_ptr) {
     meta->ctx_ptr = ctx_ptr;
 
     meta->clock_vals =
-        exec_mem_alloc(sizeof(meta->clock_vals[0]) * WASHDC_CLOCK_IDX_COUNT);
+        exec_mem_alloc(meta->exec_mem,
+                       sizeof(meta->clock_vals[0]) * WASHDC_CLOCK_IDX_COUNT);
 
     clock_set_ptrs_priv(meta->clk, meta->clock_vals);
 
     native_dispatch_create_slow_path_entry(meta);
     create_return_fn(meta);
+    create_break_fn(meta);
 #ifdef JIT_PROFILE
     create_profile_code(meta);
 #endif
@@ -104,26 +115,28 @@ void native_dispatch_init(struct native_dispatch_meta *meta, void *ctx_ptr) {
 
 void native_dispatch_cleanup(struct native_dispatch_meta *meta) {
     // TODO: free all executable memory pointers
-    exec_mem_free(meta->entry);
-    exec_mem_free(meta->return_fn);
+    exec_mem_free(meta->exec_mem, meta->entry);
+    exec_mem_free(meta->exec_mem, meta->return_fn);
+    exec_mem_free(meta->exec_mem, meta->break_fn);
 #ifdef JIT_PROFILE
-    exec_mem_free(meta->profile_code);
+    exec_mem_free(meta->exec_mem, meta->profile_code);
 #endif
     meta->return_fn = NULL;
+    meta->break_fn = NULL;
 
     clock_set_ptrs_priv(meta->clk, NULL);
 
-    exec_mem_free(meta->clock_vals);
+    exec_mem_free(meta->exec_mem, meta->clock_vals);
 
     meta->clock_vals = NULL;
 
-    exec_mem_free(meta->trampoline);
-    code_cache_set_default(NULL);
+    exec_mem_free(meta->exec_mem, meta->trampoline);
+    code_cache_set_default(meta->code_cache, NULL);
 }
 
 static void create_return_fn(struct native_dispatch_meta *meta) {
-    meta->return_fn = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(meta->return_fn, NULL, BASIC_ALLOC);
+    meta->return_fn = exec_mem_alloc(meta->exec_mem, BASIC_ALLOC);
+    x86asm_set_dst(meta->exec_mem, meta->return_fn, NULL, BASIC_ALLOC);
 
     // return PC
     x86asm_mov_reg32_reg32(new_pc_reg, REG_RET);
@@ -137,6 +150,26 @@ static void create_return_fn(struct native_dispatch_meta *meta) {
     store_quad_from_reg(meta->clock_vals + WASHDC_CLOCK_IDX_COUNTDOWN,
                         sched_tgt_reg, REG_VOL1);
 
+    emit_entry_epilogue();
+}
+
+/*
+ * break_fn is like return_fn, except it leaves the clock alone.  Code blocks
+ * jump here when they need to return to C code before the countdown has
+ * expired.  The PC to return is expected in new_pc_reg.
+ */
+static void create_break_fn(struct native_dispatch_meta *meta) {
+    meta->break_fn = exec_mem_alloc(meta->exec_mem, BASIC_ALLOC);
+    x86asm_set_dst(meta->exec_mem, meta->break_fn, NULL, BASIC_ALLOC);
+
+    // return PC
+    x86asm_mov_reg32_reg32(new_pc_reg, REG_RET);
+
+    emit_entry_epilogue();
+}
+
+// undo everything that native_dispatch_entry_create did and return
+static void emit_entry_epilogue(void) {
     // close the stack frame
     x86asm_addq_imm8_reg(8, RSP);
 
@@ -183,8 +216,8 @@ static void create_profile_code(struct native_dispatch_meta *meta) {
     struct x86asm_lbl8 skipit;
     x86asm_lbl8_init(&skipit);
 
-    meta->profile_code = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(meta->profile_code, NULL, BASIC_ALLOC);
+    meta->profile_code = exec_mem_alloc(meta->exec_mem, BASIC_ALLOC);
+    x86asm_set_dst(meta->exec_mem, meta->profile_code, NULL, BASIC_ALLOC);
 
     size_t const jit_profile_offs = offsetof(struct cache_entry, blk.profile);
     x86asm_movq_disp8_reg_reg(jit_profile_offs, cachep_reg, REG_ARG1);
@@ -211,9 +244,60 @@ static void create_profile_code(struct native_dispatch_meta *meta) {
 }
 #endif
 
+#ifdef ENABLE_TRACE
+static void native_dispatch_trace(struct cache_entry const *ent,
+                                  struct native_dispatch_meta const *meta) {
+    // the trampoline isn't a real code block
+    if (ent != &meta->fake_cache_entry)
+        meta->trace_block(ent->node.key);
+}
+
+/*
+ * emit a call to native_dispatch_trace for the cache_entry in cachep_reg.
+ * The stack must be aligned on a 16-byte boundary, and this only preserves the
+ * non-volatile registers along with REG_ARG0 and REG_ARG1.
+ */
+static void emit_trace_block(struct native_dispatch_meta const *meta) {
+    if (!meta->trace_block)
+        return;
+
+    // pushing two registers keeps the stack aligned
+    x86asm_pushq_reg64(REG_ARG0);
+    x86asm_pushq_reg64(REG_ARG1);
+
+    x86asm_mov_reg64_reg64(cachep_reg, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)meta, REG_ARG1);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)native_dispatch_trace, REG_RET);
+#ifdef ABI_MICROSOFT
+    native_dispatch_ms_shadow_open();
+#endif
+    x86asm_call_reg(REG_RET);
+#ifdef ABI_MICROSOFT
+    native_dispatch_ms_shadow_close();
+#endif
+
+    x86asm_popq_reg64(REG_ARG1);
+    x86asm_popq_reg64(REG_ARG0);
+}
+#endif
+
+/*
+ * emit a store of the hash of the cache_entry in cachep_reg to
+ * meta->sample_cur.  This clobbers tmp_reg_1 and REG_RET.
+ */
+static void emit_sample_block(struct native_dispatch_meta const *meta) {
+    if (!meta->sample_cur)
+        return;
+
+    size_t const addr_offs = offsetof(struct cache_entry, node.key);
+    x86asm_movl_disp8_reg_reg(addr_offs, cachep_reg, tmp_reg_1);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)meta->sample_cur, REG_RET);
+    x86asm_movl_reg_disp8_reg(tmp_reg_1, 0, REG_RET);
+}
+
 void native_dispatch_entry_create(struct native_dispatch_meta *meta) {
-    void *entry = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(entry, NULL, BASIC_ALLOC);
+    void *entry = exec_mem_alloc(meta->exec_mem, BASIC_ALLOC);
+    x86asm_set_dst(meta->exec_mem, entry, NULL, BASIC_ALLOC);
 
 #if defined(ABI_UNIX)
     x86asm_pushq_reg64(RBP);
@@ -272,7 +356,7 @@ void native_dispatch_entry_create(struct native_dispatch_meta *meta) {
      */
     x86asm_addq_imm8_reg(-8, RSP);
 
-    x86asm_mov_imm64_reg64((uintptr_t)(void*)code_cache_tbl,
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)meta->code_cache->tbl,
                            code_cache_tbl_ptr_reg);
 
     /*
@@ -287,11 +371,14 @@ void native_dispatch_entry_create(struct native_dispatch_meta *meta) {
 static struct cache_entry *
 dispatch_slow_path(uint32_t pc, struct native_dispatch_meta const *meta) {
     void *ctx_ptr = meta->ctx_ptr;
-    struct cache_entry *entry = code_cache_find_slow(meta->hash_func(ctx_ptr, pc));
+    struct cache_entry *entry =
+        code_cache_find_slow(meta->code_cache, meta->hash_func(ctx_ptr, pc));
 
-    code_cache_tbl[pc & CODE_CACHE_HASH_TBL_MASK] = entry;
+    meta->code_cache->tbl[pc & CODE_CACHE_HASH_TBL_MASK] = entry;
 
     if (!entry->valid) {
+        if (meta->sample_cur)
+            *meta->sample_cur = JIT_SAMPLE_COMPILING;
         meta->on_compile(ctx_ptr, meta, &entry->blk, pc);
         entry->valid = 1;
     }
@@ -311,7 +398,7 @@ static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
      * REGISTER ALLOCATION:
      *    RBX points to the struct cache_entry
      *    EDI holds the 32-bit SH4 PC address
-     *    ECX holds the index into the code_cache_tbl
+     *    ECX holds the index into the code cache's hash table
      *
      *    All other registers are considered to be "temporary" registers whose
      *    values change often.
@@ -342,6 +429,12 @@ static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
     x86asm_lbl8_define(&have_valid_ent);
     // cachep_reg points to a valid struct cache_entry which we want to jump to.
 
+#ifdef ENABLE_TRACE
+    emit_trace_block(meta);
+#endif
+
+    emit_sample_block(meta);
+
 #ifdef JIT_PROFILE
     x86asm_pushq_reg64(native_reg);
     jmp_to_addr(meta->profile_code, REG_RET);
@@ -374,6 +467,22 @@ void native_check_cycles_emit(struct native_dispatch_meta const *meta) {
     store_quad_from_reg(meta->clock_vals + WASHDC_CLOCK_IDX_COUNTDOWN,
                         countdown_reg, REG_VOL1);
 
+#ifdef ENABLE_WATCHPOINTS
+    if (meta->break_flag) {
+        struct x86asm_lbl8 no_break;
+        x86asm_lbl8_init(&no_break);
+
+        x86asm_mov_imm64_reg64((uintptr_t)meta->break_flag, REG_VOL0);
+        x86asm_movl_disp8_reg_reg(0, REG_VOL0, REG_VOL0);
+        x86asm_testl_reg32_reg32(REG_VOL0, REG_VOL0);
+        x86asm_jz_lbl8(&no_break);
+        jmp_to_addr(meta->break_fn, REG_VOL0);
+
+        x86asm_lbl8_define(&no_break);
+        x86asm_lbl8_cleanup(&no_break);
+    }
+#endif
+
     // call native_dispatch
     native_dispatch_emit(meta);
 
@@ -389,8 +498,9 @@ native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta) {
     if (native_offs >= 256)
         RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
 
-    meta->dispatch_slow_path = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(meta->dispatch_slow_path, NULL, BASIC_ALLOC);
+    meta->dispatch_slow_path = exec_mem_alloc(meta->exec_mem, BASIC_ALLOC);
+    x86asm_set_dst(meta->exec_mem, meta->dispatch_slow_path,
+                   NULL, BASIC_ALLOC);
 
     // pc is still in REG_ARG0
     x86asm_mov_imm64_reg64((uintptr_t)(void*)dispatch_slow_path, REG_RET);
@@ -417,8 +527,8 @@ native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta) {
 }
 
 static void native_dispatch_trampoline_create(struct native_dispatch_meta *meta) {
-    meta->trampoline = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(meta->trampoline, NULL, BASIC_ALLOC);
+    meta->trampoline = exec_mem_alloc(meta->exec_mem, BASIC_ALLOC);
+    x86asm_set_dst(meta->exec_mem, meta->trampoline, NULL, BASIC_ALLOC);
 
     // PC should already be in REG_ARG0
     x86asm_mov_imm64_reg64((uintptr_t)meta->dispatch_slow_path, REG_RET);
@@ -428,6 +538,12 @@ static void native_dispatch_trampoline_create(struct native_dispatch_meta *meta)
     x86asm_call_reg(REG_RET);
     x86asm_addq_imm8_reg(8, RSP);
 
+#ifdef ENABLE_TRACE
+    emit_trace_block(meta);
+#endif
+
+    emit_sample_block(meta);
+
 #ifdef JIT_PROFILE
     x86asm_pushq_reg64(native_reg);
     jmp_to_addr(meta->profile_code, REG_RET);
@@ -449,7 +565,7 @@ static void native_dispatch_trampoline_create(struct native_dispatch_meta *meta)
     meta->fake_cache_entry.blk.x86_64.native = meta->trampoline;
     meta->fake_cache_entry.node.key = 0xa0000000;
 
-    code_cache_set_default(&meta->fake_cache_entry);
+    code_cache_set_default(meta->code_cache, &meta->fake_cache_entry);
 }
 
 static void load_quad_into_reg(void *qptr, unsigned reg_no) {
@@ -37,6 +37,7 @@
 #include "jit/code_cache.h"
 
 struct native_dispatch_meta;
+struct exec_mem;
 
 void native_dispatch_init(struct native_dispatch_meta *meta, void *ctx_ptr);
 void native_dispatch_cleanup(struct native_dispatch_meta *meta);
@@ -55,6 +56,10 @@ void(*native_dispatch_compile_func)(void*,struct native_dispatch_meta const*,
 
 typedef jit_hash(*native_dispatch_hash_func)(void*,uint32_t);
 
+#ifdef ENABLE_TRACE
+typedef void(*native_dispatch_trace_func)(uint32_t);
+#endif
+
 #ifdef JIT_PROFILE
 typedef
 void(*native_dispatch_profile_notify_func)(void*,
@@ -70,8 +75,17 @@ struct native_dispatch_meta {
 
     dc_cycle_stamp_t *clock_vals;
 
+    // user-specified.  Everything this generates gets allocated from here.
+    struct exec_mem *exec_mem;
+
+    // user-specified.  This is where code blocks get looked up.
+    struct code_cache *code_cache;
+
     struct dc_clock *clk;
     void *return_fn;
+
+    // like return_fn, but for returning before the countdown has expired
+    void *break_fn;
     void *dispatch_slow_path;
 #ifdef JIT_PROFILE
     void *profile_code;
@@ -93,13 +107,13 @@ struct native_dispatch_meta {
     native_dispatch_entry_func entry;
 
     /*
-     * This is the default "invalid" code block that we fill out the
-     * code_cache_tbl with whenever the cache gets nuked.  The idea is that
+     * This is the default "invalid" code block that we fill out the code
+     * cache's hash table with whenever the cache gets nuked.  The idea is that
      * this will point to a fake code block which is equivalent to the slow-path
      * from the native_dispatch code.  The point of all this is to avoid
      * needing to check for NULL pointers in the code created by
      * native_dispatch_emit; otherwise there needs to be an additional branch to
-     * make sure that whatever we grab from the code_cache_tbl actually points
+     * make sure that whatever we grab from the hash table actually points
      * to a real code block.
      */
     void *trampoline;
@@ -108,6 +122,30 @@ struct native_dispatch_meta {
     struct cache_entry fake_cache_entry;
 
     native_dispatch_hash_func hash_func;
+
+#ifdef ENABLE_WATCHPOINTS
+    /*
+     * user-specified.  If this points to something nonzero at the end of a
+     * code block then the code returns through break_fn instead of moving on
+     * to the next block.
+     */
+    int const *break_flag;
+#endif
+
+#ifdef ENABLE_TRACE
+    /*
+     * user-specified.  If this is not NULL then it gets called with the hash
+     * of every code block right before that block runs.
+     */
+    native_dispatch_trace_func trace_block;
+#endif
+
+    /*
+     * user-specified.  If this is not NULL then the hash of every code block
+     * gets stored here right before that block runs so that the sampling
+     * profiler can see it (see jit/jit_sample.h).
+     */
+    uint32_t volatile *sample_cur;
 };
 
 /*
@@ -38,15 +38,28 @@
 #include "native_mem.h"
 #include "emit_x86_64.h"
 
+#ifdef ENABLE_WATCHPOINTS
+#include "washdc/debugger.h"
+#endif
+
+#include "trace.h"
+
 #define BASIC_ALLOC 32
 
-static void* emit_native_mem_read_float(struct memory_map const *map);
-static void* emit_native_mem_read_32(struct memory_map const *map);
-static void* emit_native_mem_read_8(struct memory_map const *map);
-static void* emit_native_mem_read_16(struct memory_map const *map);
-static void* emit_native_mem_write_8(struct memory_map const *map);
-static void* emit_native_mem_write_32(struct memory_map const *map);
-static void* emit_native_mem_write_float(struct memory_map const *map);
+static void* emit_native_mem_read_float(struct exec_mem *mem,
+                                        struct memory_map const *map);
+static void* emit_native_mem_read_32(struct exec_mem *mem,
+                                     struct memory_map const *map);
+static void* emit_native_mem_read_8(struct exec_mem *mem,
+                                    struct memory_map const *map);
+static void* emit_native_mem_read_16(struct exec_mem *mem,
+                                     struct memory_map const *map);
+static void* emit_native_mem_write_8(struct exec_mem *mem,
+                                     struct memory_map const *map);
+static void* emit_native_mem_write_32(struct exec_mem *mem,
+                                      struct memory_map const *map);
+static void* emit_native_mem_write_float(struct exec_mem *mem,
+                                         struct memory_map const *map);
 
 static void
 emit_ram_read_float(struct memory_map_region const *region, void *ctxt);
@@ -63,8 +76,13 @@ emit_ram_write_32(struct memory_map_region const *region, void *ctxt);
 static void
 emit_ram_write_float(struct memory_map_region const *region, void *ctxt);
 
+#ifdef ENABLE_DEBUGGER
+static void emit_ram_note_write(struct Memory *mem);
+#endif
+
 struct native_mem_map {
     struct memory_map const *map;
+    struct exec_mem *mem;
     struct fifo_node node;
     void *read_float_impl, *read_32_impl, *read_16_impl, *read_8_impl,
         *write_8_impl, *write_32_impl, *write_float_impl;
@@ -73,6 +91,24 @@ struct native_mem_map {
 static struct fifo_head native_impl;
 static struct native_mem_map *mem_map_impl(struct memory_map const *map);
 
+#ifdef ENABLE_WATCHPOINTS
+static void emit_watch_check(struct memory_map const *map, unsigned type,
+                             void *slow_path, unsigned ctxt_reg);
+#endif
+
+#if defined(ENABLE_WATCHPOINTS) || defined(ENABLE_TRACE)
+static void emit_slow_path(struct memory_map const *map,
+                           void *slow_path, unsigned ctxt_reg);
+
+static float slow_read_float(uint32_t addr, void *ctxt);
+static uint32_t slow_read_32(uint32_t addr, void *ctxt);
+static uint16_t slow_read_16(uint32_t addr, void *ctxt);
+static uint8_t slow_read_8(uint32_t addr, void *ctxt);
+static void slow_write_8(uint32_t addr, uint8_t val, void *ctxt);
+static void slow_write_32(uint32_t addr, uint32_t val, void *ctxt);
+static void slow_write_float(uint32_t addr, float val, void *ctxt);
+#endif
+
 void native_mem_init(void) {
     fifo_init(&native_impl);
 }
@@ -83,13 +119,13 @@ void native_mem_cleanup(void) {
         struct native_mem_map *native_map =
             &FIFO_DEREF(node, struct native_mem_map, node);
 
-        exec_mem_free(native_map->read_float_impl);
-        exec_mem_free(native_map->read_32_impl);
-        exec_mem_free(native_map->read_16_impl);
-        exec_mem_free(native_map->read_8_impl);
-        exec_mem_free(native_map->write_8_impl);
-        exec_mem_free(native_map->write_32_impl);
-        exec_mem_free(native_map->write_float_impl);
+        exec_mem_free(native_map->mem, native_map->read_float_impl);
+        exec_mem_free(native_map->mem, native_map->read_32_impl);
+        exec_mem_free(native_map->mem, native_map->read_16_impl);
+        exec_mem_free(native_map->mem, native_map->read_8_impl);
+        exec_mem_free(native_map->mem, native_map->write_8_impl);
+        exec_mem_free(native_map->mem, native_map->write_32_impl);
+        exec_mem_free(native_map->mem, native_map->write_float_impl);
 
         free(native_map);
     }
@@ -179,9 +215,10 @@ static void error_func(void) {
     RAISE_ERROR(ERROR_INTEGRITY);
 }
 
-static void* emit_native_mem_read_8(struct memory_map const *map) {
-    void *native_mem_read_8_impl = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(native_mem_read_8_impl, NULL, BASIC_ALLOC);
+static void* emit_native_mem_read_8(struct exec_mem *mem,
+                                    struct memory_map const *map) {
+    void *native_mem_read_8_impl = exec_mem_alloc(mem, BASIC_ALLOC);
+    x86asm_set_dst(mem, native_mem_read_8_impl, NULL, BASIC_ALLOC);
 
     static unsigned const addr_reg = REG_RET;
 
@@ -208,10 +245,20 @@ static void* emit_native_mem_read_8(struct memory_map const *map) {
 
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
+#ifdef ENABLE_WATCHPOINTS
+            emit_watch_check(map, DEBUG_WATCH_PAGE_R, slow_read_8, REG_ARG1);
+#endif
             emit_ram_read_8(region, region->ctxt);
             x86asm_ret();
             break;
         default:
+#ifdef ENABLE_TRACE
+            if (region->id == MEMORY_MAP_REGION_MMIO &&
+                TRACE_ON(TRACE_CAT_MMIO)) {
+                emit_slow_path(map, slow_read_8, REG_ARG1);
+                break;
+            }
+#endif
             // tail-call
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
             x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG1);
@@ -239,9 +286,10 @@ static void* emit_native_mem_read_8(struct memory_map const *map) {
     return native_mem_read_8_impl;
 }
 
-static void* emit_native_mem_read_16(struct memory_map const *map) {
-    void *native_mem_read_16_impl = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(native_mem_read_16_impl, NULL, BASIC_ALLOC);
+static void* emit_native_mem_read_16(struct exec_mem *mem,
+                                     struct memory_map const *map) {
+    void *native_mem_read_16_impl = exec_mem_alloc(mem, BASIC_ALLOC);
+    x86asm_set_dst(mem, native_mem_read_16_impl, NULL, BASIC_ALLOC);
 
     static unsigned const addr_reg = REG_RET;
 
@@ -268,10 +316,20 @@ static void* emit_native_mem_read_16(struct memory_map const *map) {
 
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
+#ifdef ENABLE_WATCHPOINTS
+            emit_watch_check(map, DEBUG_WATCH_PAGE_R, slow_read_16, REG_ARG1);
+#endif
             emit_ram_read_16(region, region->ctxt);
             x86asm_ret();
             break;
         default:
+#ifdef ENABLE_TRACE
+            if (region->id == MEMORY_MAP_REGION_MMIO &&
+                TRACE_ON(TRACE_CAT_MMIO)) {
+                emit_slow_path(map, slow_read_16, REG_ARG1);
+                break;
+            }
+#endif
             // tail-call
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
             x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG1);
@@ -299,9 +357,10 @@ static void* emit_native_mem_read_16(struct memory_map const *map) {
     return native_mem_read_16_impl;
 }
 
-static void* emit_native_mem_read_float(struct memory_map const *map) {
-    void *native_mem_read_float_impl = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(native_mem_read_float_impl, NULL, BASIC_ALLOC);
+static void* emit_native_mem_read_float(struct exec_mem *mem,
+                                        struct memory_map const *map) {
+    void *native_mem_read_float_impl = exec_mem_alloc(mem, BASIC_ALLOC);
+    x86asm_set_dst(mem, native_mem_read_float_impl, NULL, BASIC_ALLOC);
 
     static unsigned const addr_reg = REG_RET;
 
@@ -329,10 +388,21 @@ static void* emit_native_mem_read_float(struct memory_map const *map) {
 
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
+#ifdef ENABLE_WATCHPOINTS
+            emit_watch_check(map, DEBUG_WATCH_PAGE_R, slow_read_float,
+                             REG_ARG1);
+#endif
             emit_ram_read_float(region, region->ctxt);
             x86asm_ret();
             break;
         default:
+#ifdef ENABLE_TRACE
+            if (region->id == MEMORY_MAP_REGION_MMIO &&
+                TRACE_ON(TRACE_CAT_MMIO)) {
+                emit_slow_path(map, slow_read_float, REG_ARG1);
+                break;
+            }
+#endif
             // tail-call
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
             x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG1);
@@ -360,9 +430,10 @@ static void* emit_native_mem_read_float(struct memory_map const *map) {
     return native_mem_read_float_impl;
 }
 
-static void* emit_native_mem_read_32(struct memory_map const *map) {
-    void *native_mem_read_32_impl = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(native_mem_read_32_impl, NULL, BASIC_ALLOC);
+static void* emit_native_mem_read_32(struct exec_mem *mem,
+                                     struct memory_map const *map) {
+    void *native_mem_read_32_impl = exec_mem_alloc(mem, BASIC_ALLOC);
+    x86asm_set_dst(mem, native_mem_read_32_impl, NULL, BASIC_ALLOC);
 
     static unsigned const addr_reg = REG_RET;
 
@@ -390,10 +461,20 @@ static void* emit_native_mem_read_32(struct memory_map const *map) {
 
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
+#ifdef ENABLE_WATCHPOINTS
+            emit_watch_check(map, DEBUG_WATCH_PAGE_R, slow_read_32, REG_ARG1);
+#endif
             emit_ram_read_32(region, region->ctxt);
             x86asm_ret();
             break;
         default:
+#ifdef ENABLE_TRACE
+            if (region->id == MEMORY_MAP_REGION_MMIO &&
+                TRACE_ON(TRACE_CAT_MMIO)) {
+                emit_slow_path(map, slow_read_32, REG_ARG1);
+                break;
+            }
+#endif
             // tail-call
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
             x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG1);
@@ -421,9 +502,10 @@ static void* emit_native_mem_read_32(struct memory_map const *map) {
     return native_mem_read_32_impl;
 }
 
-static void* emit_native_mem_write_8(struct memory_map const *map) {
-    void *native_mem_write_8_impl = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(native_mem_write_8_impl, NULL, BASIC_ALLOC);
+static void* emit_native_mem_write_8(struct exec_mem *mem,
+                                     struct memory_map const *map) {
+    void *native_mem_write_8_impl = exec_mem_alloc(mem, BASIC_ALLOC);
+    x86asm_set_dst(mem, native_mem_write_8_impl, NULL, BASIC_ALLOC);
 
     static unsigned const addr_reg = REG_RET;
 
@@ -451,10 +533,20 @@ static void* emit_native_mem_write_8(struct memory_map const *map) {
 
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
+#ifdef ENABLE_WATCHPOINTS
+            emit_watch_check(map, DEBUG_WATCH_PAGE_W, slow_write_8, REG_ARG2);
+#endif
             emit_ram_write_8(region, region->ctxt);
             x86asm_ret();
             break;
         default:
+#ifdef ENABLE_TRACE
+            if (region->id == MEMORY_MAP_REGION_MMIO &&
+                TRACE_ON(TRACE_CAT_MMIO)) {
+                emit_slow_path(map, slow_write_8, REG_ARG2);
+                break;
+            }
+#endif
             // tail-call (the value to write is still in ESI)
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
             x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG2);
@@ -482,9 +574,10 @@ static void* emit_native_mem_write_8(struct memory_map const *map) {
     return native_mem_write_8_impl;
 }
 
-static void* emit_native_mem_write_32(struct memory_map const *map) {
-    void *native_mem_write_32_impl = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(native_mem_write_32_impl, NULL, BASIC_ALLOC);
+static void* emit_native_mem_write_32(struct exec_mem *mem,
+                                      struct memory_map const *map) {
+    void *native_mem_write_32_impl = exec_mem_alloc(mem, BASIC_ALLOC);
+    x86asm_set_dst(mem, native_mem_write_32_impl, NULL, BASIC_ALLOC);
 
     static unsigned const addr_reg = REG_RET;
 
@@ -512,10 +605,20 @@ static void* emit_native_mem_write_32(struct memory_map const *map) {
 
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
+#ifdef ENABLE_WATCHPOINTS
+            emit_watch_check(map, DEBUG_WATCH_PAGE_W, slow_write_32, REG_ARG2);
+#endif
             emit_ram_write_32(region, region->ctxt);
             x86asm_ret();
             break;
         default:
+#ifdef ENABLE_TRACE
+            if (region->id == MEMORY_MAP_REGION_MMIO &&
+                TRACE_ON(TRACE_CAT_MMIO)) {
+                emit_slow_path(map, slow_write_32, REG_ARG2);
+                break;
+            }
+#endif
             // tail-call (the value to write is still in ESI)
             x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
             x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG2);
@@ -543,7 +646,8 @@ static void* emit_native_mem_write_32(struct memory_map const *map) {
     return native_mem_write_32_impl;
 }
 
-static void* emit_native_mem_write_float(struct memory_map const *map) {
+static void* emit_native_mem_write_float(struct exec_mem *mem,
+                                         struct memory_map const *map) {
     /*
      * XXX: if ADDR_REG is ever not REG_ARG0, this function will need to be
      * changed...
@@ -560,8 +664,8 @@ static void* emit_native_mem_write_float(struct memory_map const *map) {
 #error unknown abi
 #endif
 
-    void *native_mem_write_float_impl = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(native_mem_write_float_impl, NULL, BASIC_ALLOC);
+    void *native_mem_write_float_impl = exec_mem_alloc(mem, BASIC_ALLOC);
+    x86asm_set_dst(mem, native_mem_write_float_impl, NULL, BASIC_ALLOC);
 
     // this corresponds to the addr AND'd with the comparison mask
     static unsigned const CMP_ADDR_REG = REG_RET;
@@ -591,10 +695,21 @@ static void* emit_native_mem_write_float(struct memory_map const *map) {
 
         switch (region->id) {
         case MEMORY_MAP_REGION_RAM:
+#ifdef ENABLE_WATCHPOINTS
+            emit_watch_check(map, DEBUG_WATCH_PAGE_W, slow_write_float,
+                             CTXT_REG);
+#endif
             emit_ram_write_float(region, region->ctxt);
             x86asm_ret();
             break;
         default:
+#ifdef ENABLE_TRACE
+            if (region->id == MEMORY_MAP_REGION_MMIO &&
+                TRACE_ON(TRACE_CAT_MMIO)) {
+                emit_slow_path(map, slow_write_float, CTXT_REG);
+                break;
+            }
+#endif
             // tail-call (the value to write is still in VAL_REG)
             x86asm_andl_imm32_reg32(region->mask, ADDR_REG);
             x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, CTXT_REG);
@@ -672,6 +787,10 @@ emit_ram_write_8(struct memory_map_region const *region, void *ctxt) {
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
     x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
     x86asm_movb_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+
+#ifdef ENABLE_DEBUGGER
+    emit_ram_note_write(mem);
+#endif
 }
 
 static void
@@ -683,6 +802,10 @@ emit_ram_write_32(struct memory_map_region const *region, void *ctxt) {
     x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
     x86asm_movl_reg_sib(REG_ARG1, REG_RET, 1, REG_ARG0);
+
+#ifdef ENABLE_DEBUGGER
+    emit_ram_note_write(mem);
+#endif
 }
 
 static void
@@ -700,7 +823,107 @@ emit_ram_write_float(struct memory_map_region const *region, void *ctxt) {
 #else
 #error unknown abi
 #endif
+
+#ifdef ENABLE_DEBUGGER
+    emit_ram_note_write(mem);
+#endif
+}
+
+#ifdef ENABLE_DEBUGGER
+/*
+ * set the byte in mem->written_pages for the address in REG_ARG0, which has
+ * already been masked down to an offset into mem.  This is the inlined
+ * equivalent of memory_note_write; accesses are aligned, so they never
+ * straddle two pages.
+ *
+ * This clobbers REG_ARG0, REG_ARG3 and REG_RET.
+ */
+static void emit_ram_note_write(struct Memory *mem) {
+    x86asm_shrl_imm8_reg32(MEMORY_PAGE_SHIFT, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)mem->written_pages, REG_RET);
+    x86asm_mov_imm32_reg32(1, REG_ARG3);
+    x86asm_movb_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+}
+#endif
+
+#ifdef ENABLE_WATCHPOINTS
+/*
+ * emit a check to see if the address in REG_ARG0 is on a page that has a
+ * watchpoint.  If it is, then tail-call slow_path with the memory map in
+ * ctxt_reg so that the memory map can check for the watchpoint; otherwise
+ * fall through to the inlined RAM access.
+ *
+ * This clobbers REG_RET and REG_ARG3.
+ */
+static void emit_watch_check(struct memory_map const *map, unsigned type,
+                             void *slow_path, unsigned ctxt_reg) {
+    struct x86asm_lbl8 not_watched;
+    x86asm_lbl8_init(&not_watched);
+
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_RET);
+    x86asm_andl_imm32_reg32(DEBUG_WATCH_ADDR_MASK, REG_RET);
+    x86asm_shrl_imm8_reg32(DEBUG_WATCH_PAGE_SHIFT, REG_RET);
+    x86asm_mov_imm64_reg64((uintptr_t)debug_watch_pages(DEBUG_CONTEXT_SH4),
+                           REG_ARG3);
+    x86asm_movb_sib_reg(REG_ARG3, 1, REG_RET, REG_RET);
+    x86asm_testl_imm32_reg32(type, REG_RET);
+    x86asm_jz_lbl8(&not_watched);
+
+    emit_slow_path(map, slow_path, ctxt_reg);
+
+    x86asm_lbl8_define(&not_watched);
+    x86asm_lbl8_cleanup(&not_watched);
+}
+#endif
+
+#if defined(ENABLE_WATCHPOINTS) || defined(ENABLE_TRACE)
+/*
+ * tail-call slow_path with the memory map in ctxt_reg.  The address has to
+ * still be in REG_ARG0 without having been masked.
+ *
+ * This clobbers REG_ARG3.
+ */
+static void emit_slow_path(struct memory_map const *map,
+                           void *slow_path, unsigned ctxt_reg) {
+    x86asm_mov_imm64_reg64((uintptr_t)map, ctxt_reg);
+    x86asm_mov_imm64_reg64((uintptr_t)slow_path, REG_ARG3);
+    x86asm_jmpq_reg64(REG_ARG3);
+}
+
+/*
+ * These have the same signatures as the memory_interface functions so that
+ * the code emitted by emit_slow_path can tail-call them the same way it would
+ * tail-call any other region.  They go through the memory map so that it can
+ * check for watchpoints and record MMIO accesses in the trace.
+ */
+static float slow_read_float(uint32_t addr, void *ctxt) {
+    return memory_map_read_float((struct memory_map*)ctxt, addr);
+}
+
+static uint32_t slow_read_32(uint32_t addr, void *ctxt) {
+    return memory_map_read_32((struct memory_map*)ctxt, addr);
+}
+
+static uint16_t slow_read_16(uint32_t addr, void *ctxt) {
+    return memory_map_read_16((struct memory_map*)ctxt, addr);
+}
+
+static uint8_t slow_read_8(uint32_t addr, void *ctxt) {
+    return memory_map_read_8((struct memory_map*)ctxt, addr);
+}
+
+static void slow_write_8(uint32_t addr, uint8_t val, void *ctxt) {
+    memory_map_write_8((struct memory_map*)ctxt, addr, val);
+}
+
+static void slow_write_32(uint32_t addr, uint32_t val, void *ctxt) {
+    memory_map_write_32((struct memory_map*)ctxt, addr, val);
+}
+
+static void slow_write_float(uint32_t addr, float val, void *ctxt) {
+    memory_map_write_float((struct memory_map*)ctxt, addr, val);
 }
+#endif
 
 static struct native_mem_map *mem_map_impl(struct memory_map const *map) {
     struct fifo_node *curs;
@@ -713,19 +936,20 @@ static struct native_mem_map *mem_map_impl(struct memory_map const *map) {
 
     return NULL;
 }
-void native_mem_register(struct memory_map const *map) {
+void native_mem_register(struct exec_mem *mem, struct memory_map const *map) {
     // create a new map
     struct native_mem_map *native_map =
         (struct native_mem_map*)malloc(sizeof(struct native_mem_map));
 
     native_map->map = map;
-    native_map->read_float_impl = emit_native_mem_read_float(map);
-    native_map->read_32_impl = emit_native_mem_read_32(map);
-    native_map->read_16_impl = emit_native_mem_read_16(map);
-    native_map->read_8_impl = emit_native_mem_read_8(map);
-    native_map->write_8_impl = emit_native_mem_write_8(map);
-    native_map->write_32_impl = emit_native_mem_write_32(map);
-    native_map->write_float_impl = emit_native_mem_write_float(map);
+    native_map->mem = mem;
+    native_map->read_float_impl = emit_native_mem_read_float(mem, map);
+    native_map->read_32_impl = emit_native_mem_read_32(mem, map);
+    native_map->read_16_impl = emit_native_mem_read_16(mem, map);
+    native_map->read_8_impl = emit_native_mem_read_8(mem, map);
+    native_map->write_8_impl = emit_native_mem_write_8(mem, map);
+    native_map->write_32_impl = emit_native_mem_write_32(mem, map);
+    native_map->write_float_impl = emit_native_mem_write_float(mem, map);
 
     fifo_push(&native_impl, &native_map->node);
 }
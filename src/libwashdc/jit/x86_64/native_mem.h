@@ -28,7 +28,13 @@
 void native_mem_init(void);
 void native_mem_cleanup(void);
 
-void native_mem_register(struct memory_map const *map);
+struct exec_mem;
+
+/*
+ * emit the fast-path handlers for map into mem.  They get freed back into the
+ * same arena by native_mem_cleanup.
+ */
+void native_mem_register(struct exec_mem *mem, struct memory_map const *map);
 
 /*
  * Normal calling convention rules about which registers are and are not saved
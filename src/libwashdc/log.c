@@ -24,6 +24,7 @@
 #include <string.h>
 #include <stdarg.h>
 
+#include "compiler_bullshit.h"
 #include "log.h"
 #include "washdc/log.h"
 #include "washdc/hostfile.h"
@@ -62,7 +63,7 @@ void log_do_write(enum log_severity lvl, char const *fmt, ...) {
 
 static void log_do_write_vararg(enum log_severity lvl,
                                 char const *fmt, va_list args) {
-    static char buf[1024];
+    static WASHDC_THREAD_LOCAL char buf[1024];
     if (verbose_mode || lvl >= log_severity_info) {
         va_list args2;
         va_copy(args2, args);
@@ -34,6 +34,28 @@ void memory_cleanup(struct Memory *mem) {
 
 void memory_clear(struct Memory *mem) {
     memset(mem->mem, 0, sizeof(mem->mem[0]) * MEMORY_SIZE);
+#ifdef ENABLE_DEBUGGER
+    memset(mem->written_pages, 1, sizeof(mem->written_pages));
+#endif
+}
+
+static int memory_read_raw(uint32_t addr, void *buf,
+                           unsigned len, void *ctxt) {
+    struct Memory *mem = (struct Memory*)ctxt;
+    if (!len || (addr + (len - 1)) & ~MEMORY_MASK)
+        return 1;
+    memcpy(buf, mem->mem + addr, len);
+    return 0;
+}
+
+static int memory_write_raw(uint32_t addr, void const *buf,
+                            unsigned len, void *ctxt) {
+    struct Memory *mem = (struct Memory*)ctxt;
+    if (!len || (addr + (len - 1)) & ~MEMORY_MASK)
+        return 1;
+    memcpy(mem->mem + addr, buf, len);
+    memory_note_write(mem, addr, len);
+    return 0;
 }
 
 struct memory_interface ram_intf = {
@@ -47,5 +69,8 @@ struct memory_interface ram_intf = {
     .writefloat = memory_write_float,
     .write32 = memory_write_32,
     .write16 = memory_write_16,
-    .write8 = memory_write_8
+    .write8 = memory_write_8,
+
+    .read_raw = memory_read_raw,
+    .write_raw = memory_write_raw
 };
@@ -35,10 +35,35 @@
 #define MEMORY_SIZE (1 << MEMORY_SIZE_SHIFT)
 #define MEMORY_MASK (MEMORY_SIZE - 1)
 
+#define MEMORY_PAGE_SHIFT 12
+#define MEMORY_N_PAGES (MEMORY_SIZE >> MEMORY_PAGE_SHIFT)
+
 struct Memory {
     uint8_t mem[MEMORY_SIZE];
+
+#ifdef ENABLE_DEBUGGER
+    /*
+     * one byte for every page of mem.  Everything that writes to mem sets the
+     * byte for each page it touches (including the native JIT's inlined
+     * stores), and the debugger's rewind clears them whenever it takes a
+     * snapshot so that it only needs to look at the pages that were written
+     * since the last one.
+     */
+    uint8_t written_pages[MEMORY_N_PAGES];
+#endif
 };
 
+static inline void
+memory_note_write(struct Memory *mem, size_t addr, size_t len) {
+#ifdef ENABLE_DEBUGGER
+    size_t page = addr >> MEMORY_PAGE_SHIFT;
+    size_t last_page = (addr + (len - 1)) >> MEMORY_PAGE_SHIFT;
+    do {
+        mem->written_pages[page] = 1;
+    } while (page++ < last_page);
+#endif
+}
+
 void memory_init(struct Memory *mem);
 
 void memory_cleanup(struct Memory *mem);
@@ -72,6 +97,7 @@ memory_write(struct Memory *mem, void const *buf, size_t addr, size_t len) {
     }
 
     memcpy(mem->mem + addr, buf, len);
+    memory_note_write(mem, addr, len);
 
     return 0;
 }
@@ -80,30 +106,35 @@ static inline void
 memory_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr, sizeof(val));
 }
 
 static inline void
 memory_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr, sizeof(val));
 }
 
 static inline void
 memory_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr, sizeof(val));
 }
 
 static inline void
 memory_write_float(addr32_t addr, float val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr, sizeof(val));
 }
 
 static inline void
 memory_write_double(addr32_t addr, double val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr, sizeof(val));
 }
 
 static inline uint8_t
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifdef _WIN32
+#include "i_hate_windows.h"
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+
+#include <stdint.h>
+
+#include "threading.h"
+#include "atomics.h"
+#include "washdc/win.h"
+
+#include "pace.h"
+
+// how long before the deadline to stop sleeping and start spinning
+#define PACE_SPIN_NS 500000ULL
+
+/*
+ * if the emulator is more than this far behind schedule, the deadlines get
+ * reset instead of trying to catch up.
+ */
+#define PACE_MAX_LAG_NS 100000000ULL
+
+static washdc_mutex pace_mutex = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar pace_cond = WASHDC_CVAR_STATIC_INIT;
+static bool wake_pending;
+
+static washdc_atomic_int frame_pacing = WASHDC_ATOMIC_INT_INIT(0);
+
+// these are only accessed by the emulation thread
+static bool have_deadline;
+static uint64_t deadline_ns;
+
+static uint64_t pace_now_ns(void) {
+#ifdef _WIN32
+    /*
+     * GetTickCount64 only has a resolution of 10-16ms, which is coarser than a
+     * whole frame, so use the performance counter instead.  The conversion is
+     * split in two so that it doesn't overflow.
+     */
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    uint64_t ticks = now.QuadPart, hz = freq.QuadPart;
+    return (ticks / hz) * 1000000000 + (ticks % hz) * 1000000000 / hz;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+static void pace_sleep_until(uint64_t when_ns) {
+#ifdef _WIN32
+    uint64_t now = pace_now_ns();
+    if (when_ns > now)
+        Sleep((DWORD)((when_ns - now) / 1000000));
+#else
+    struct timespec when = {
+        .tv_sec = when_ns / 1000000000,
+        .tv_nsec = when_ns % 1000000000
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                           &when, NULL) == EINTR)
+        ;
+#endif
+}
+
+void pace_wait(void) {
+    have_deadline = false;
+
+    if (win_can_wait_events()) {
+        win_wait_events();
+        return;
+    }
+
+    washdc_mutex_lock(&pace_mutex);
+    while (!wake_pending)
+        washdc_cvar_wait(&pace_cond, &pace_mutex);
+    wake_pending = false;
+    washdc_mutex_unlock(&pace_mutex);
+}
+
+void pace_wake(void) {
+    washdc_mutex_lock(&pace_mutex);
+    wake_pending = true;
+    washdc_cvar_signal(&pace_cond);
+    washdc_mutex_unlock(&pace_mutex);
+
+    win_wake_events();
+}
+
+void pace_set_frame_pacing(bool enable) {
+    washdc_atomic_int_store(&frame_pacing, enable);
+}
+
+void pace_end_frame(dc_cycle_stamp_t virt_frametime) {
+    if (!washdc_atomic_int_load(&frame_pacing)) {
+        have_deadline = false;
+        return;
+    }
+
+    uint64_t now = pace_now_ns();
+    uint64_t frametime_ns =
+        (uint64_t)(virt_frametime * (1000000000.0 / SCHED_FREQUENCY));
+
+    if (have_deadline)
+        deadline_ns += frametime_ns;
+    if (!have_deadline || now > deadline_ns + PACE_MAX_LAG_NS) {
+        deadline_ns = now;
+        have_deadline = true;
+        return;
+    }
+
+    if (deadline_ns > now + PACE_SPIN_NS)
+        pace_sleep_until(deadline_ns - PACE_SPIN_NS);
+    while (pace_now_ns() < deadline_ns)
+        ;
+}
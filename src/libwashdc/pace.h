@@ -0,0 +1,71 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef PACE_H_
+#define PACE_H_
+
+/*
+ * Pacing for the emulation thread.
+ *
+ * pace_wait is where the emulation thread blocks whenever it has nothing to
+ * do (while suspended or while waiting on the debugger).  It sleeps until
+ * somebody calls pace_wake, so it doesn't use any CPU time while it's waiting.
+ * If the window interface can block on window events, then pace_wait blocks
+ * there instead so that the UI stays responsive, and pace_wake posts a
+ * window event to break it out.
+ *
+ * pace_end_frame keeps the emulator from running faster than a real Dreamcast
+ * when frame pacing is enabled.  Every frame gets an absolute deadline one
+ * virtual frame-time after the previous frame's deadline.  The thread sleeps
+ * until shortly before the deadline and then spins for the rest, because the
+ * host's sleep can overshoot by more than we want to tolerate.  Because the
+ * deadlines are absolute, errors in one frame's sleep don't accumulate into
+ * the next.  If the emulator falls too far behind (or after it has been
+ * blocked in pace_wait), the deadlines are reset to the current time instead
+ * of trying to catch up.
+ */
+
+#include <stdbool.h>
+
+#include "dc_sched.h"
+
+/*
+ * block the emulation thread until pace_wake gets called.  If the window
+ * interface can wait on events, this will also return when there's a window
+ * event.
+ */
+void pace_wait(void);
+
+// this can be called from any thread
+void pace_wake(void);
+
+// this can be called from any thread
+void pace_set_frame_pacing(bool enable);
+
+/*
+ * called by the emulation thread at the end of every frame.  virt_frametime
+ * is the amount of virtual time that passed since the last frame.
+ */
+void pace_end_frame(dc_cycle_stamp_t virt_frametime);
+
+#endif
@@ -34,6 +34,10 @@ static int do_save_screenshot(washdc_hostfile stream, char const *path);
 static int grab_screen(uint32_t **fb_out, unsigned *fb_width_out,
                        unsigned *fb_height_out, bool *do_flip_out);
 
+static uint32_t screen_pixel(uint32_t const *fb, unsigned fb_width,
+                             unsigned fb_height, bool do_flip,
+                             unsigned row, unsigned col);
+
 static void write_wrapper_png(png_structp png, png_bytep dat, png_size_t len);
 static void flush_wrapper_png(png_structp png);
 
@@ -133,12 +137,8 @@ static int do_save_screenshot(washdc_hostfile stream, char const *path) {
             (png_bytep)malloc(sizeof(png_byte) * fb_width * 3);
 
         for (col = 0; col < fb_width; col++) {
-            unsigned pix_idx;
-            if (!do_flip)
-                pix_idx = (fb_height - 1 - row) * fb_width + col;
-            else
-                pix_idx = row * fb_width + col;
-            uint32_t in_px = fb_tmp[pix_idx];
+            uint32_t in_px = screen_pixel(fb_tmp, fb_width, fb_height,
+                                          do_flip, row, col);
             unsigned red = in_px & 0xff;
             unsigned green = (in_px >> 8) & 0xff;
             unsigned blue = (in_px >> 16) & 0xff;
@@ -167,6 +167,54 @@ static int do_save_screenshot(washdc_hostfile stream, char const *path) {
     return err_val;
 }
 
+#define FNV1A_64_OFFSET 0xcbf29ce484222325ull
+#define FNV1A_64_PRIME 0x100000001b3ull
+
+int screenshot_hash(uint64_t *hash_out, unsigned *width_out,
+                    unsigned *height_out) {
+    uint32_t *fb_tmp = NULL;
+    unsigned fb_width, fb_height;
+    bool do_flip;
+
+    if (grab_screen(&fb_tmp, &fb_width, &fb_height, &do_flip) < 0)
+        return -1;
+
+    // the guest hasn't turned on the framebuffer yet
+    if (!fb_tmp || !fb_width || !fb_height) {
+        free(fb_tmp);
+        return -1;
+    }
+
+    uint64_t hash = FNV1A_64_OFFSET;
+    unsigned row, col, chan;
+    for (row = 0; row < fb_height; row++) {
+        for (col = 0; col < fb_width; col++) {
+            uint32_t in_px = screen_pixel(fb_tmp, fb_width, fb_height,
+                                          do_flip, row, col);
+            for (chan = 0; chan < 3; chan++) {
+                hash ^= (in_px >> (8 * chan)) & 0xff;
+                hash *= FNV1A_64_PRIME;
+            }
+        }
+    }
+
+    free(fb_tmp);
+
+    *hash_out = hash;
+    *width_out = fb_width;
+    *height_out = fb_height;
+    return 0;
+}
+
+// returns the pixel at (row, col), counting rows from the top of the screen
+static uint32_t screen_pixel(uint32_t const *fb, unsigned fb_width,
+                             unsigned fb_height, bool do_flip,
+                             unsigned row, unsigned col) {
+    if (!do_flip)
+        return fb[(fb_height - 1 - row) * fb_width + col];
+    return fb[row * fb_width + col];
+}
+
 static int grab_screen(uint32_t **fb_out, unsigned *fb_width_out,
                        unsigned *fb_height_out, bool *do_flip_out) {
     struct gfx_framebuffer fb;
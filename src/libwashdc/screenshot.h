@@ -23,7 +23,17 @@
 #ifndef SCREENSHOT_H_
 #define SCREENSHOT_H_
 
+#include <stdint.h>
+
 int save_screenshot(char const *path);
 int save_screenshot_dir(void);
 
+/*
+ * hash the pixels that save_screenshot would write out (64-bit FNV-1a over
+ * the RGB bytes, top row first).  Returns 0 on success or -1 if the
+ * framebuffer can't be grabbed.
+ */
+int screenshot_hash(uint64_t *hash_out, unsigned *width_out,
+                    unsigned *height_out);
+
 #endif
@@ -0,0 +1,555 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef ENABLE_TRACE
+#error this file should only be built for -DENABLE_TRACE=On builds
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zlib.h"
+
+#include "log.h"
+#include "dc_sched.h"
+#include "threading.h"
+#include "compiler_bullshit.h"
+#include "washdc/ring.h"
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "washdc/MemoryMap.h"
+#include "washdc/config_file.h"
+
+#include "trace.h"
+
+#define TRACE_CHUNK_SIZE (64 * 1024)
+
+/*
+ * each thread gets (1 << TRACE_RING_LOG) - 1 chunks.  That's the most either
+ * of its rings can hold, so producing into a ring can never fail.
+ */
+#define TRACE_RING_LOG 4
+#define TRACE_CHUNKS_PER_THREAD ((1 << TRACE_RING_LOG) - 1)
+
+#define TRACE_MAX_THREADS 16
+#define TRACE_MAX_MAPS 4
+
+// type + LEB128 delta; a 64-bit delta takes at most 10 bytes
+#define TRACE_REC_HDR_MAX 11
+#define TRACE_PAYLOAD_MAX 16
+
+#define TRACE_OUT_BUF_LEN (256 * 1024)
+
+struct trace_chunk {
+    unsigned n_bytes;
+    uint8_t dat[TRACE_CHUNK_SIZE];
+};
+
+DEF_RING(trace_chunk_ring, struct trace_chunk*, TRACE_RING_LOG)
+
+struct trace_thread {
+    unsigned thread_no;
+
+    // only touched by the thread that owns this struct
+    struct trace_chunk *cur;
+    dc_cycle_stamp_t last_stamp;
+    unsigned n_stalls;
+
+    // chunks waiting to be written out
+    struct trace_chunk_ring full;
+
+    // chunks which have been written out and can be reused
+    struct trace_chunk_ring empty;
+
+    // signalled by the writer when it puts a chunk into empty
+    washdc_cvar empty_cond;
+
+    struct trace_chunk *chunks[TRACE_CHUNKS_PER_THREAD];
+};
+
+unsigned trace_cats;
+
+static struct dc_clock *trace_clk;
+
+static washdc_mutex trace_lock;
+static washdc_cvar trace_work_cond;
+static bool trace_work_pending, trace_quit;
+
+static washdc_thread trace_writer;
+
+static struct trace_thread *trace_threads[TRACE_MAX_THREADS];
+static unsigned trace_n_threads;
+
+/*
+ * trace_gen gets incremented by every call to trace_init so that threads
+ * don't hang onto a trace_thread from a previous session.
+ */
+static unsigned trace_gen;
+static WASHDC_THREAD_LOCAL struct trace_thread *trace_this_thread;
+static WASHDC_THREAD_LOCAL unsigned trace_this_gen;
+
+static struct memory_map const *trace_maps[TRACE_MAX_MAPS];
+static unsigned trace_n_maps;
+
+// these are only touched by the writer thread after trace_init returns
+static washdc_hostfile trace_file;
+static z_stream trace_strm;
+static uint8_t *trace_out_buf;
+static unsigned long long trace_bytes_in;
+
+static void trace_writer_main(void *argp);
+static void trace_deflate(void const *dat, unsigned len, int flush);
+static struct trace_thread *trace_thread_create(void);
+static void trace_thread_push_chunk(struct trace_thread *td);
+static void trace_emit(enum trace_rec_type tp, uint8_t const *payload,
+                       unsigned len);
+
+static uint8_t *put_u8(uint8_t *outp, uint8_t val) {
+    *outp++ = val;
+    return outp;
+}
+
+static uint8_t *put_u32(uint8_t *outp, uint32_t val) {
+    outp[0] = val;
+    outp[1] = val >> 8;
+    outp[2] = val >> 16;
+    outp[3] = val >> 24;
+    return outp + 4;
+}
+
+static uint8_t *put_u64(uint8_t *outp, uint64_t val) {
+    outp = put_u32(outp, val);
+    return put_u32(outp, val >> 32);
+}
+
+static uint8_t *put_varint(uint8_t *outp, uint64_t val) {
+    while (val >= 0x80) {
+        *outp++ = (val & 0x7f) | 0x80;
+        val >>= 7;
+    }
+    *outp++ = val;
+    return outp;
+}
+
+static unsigned trace_parse_events(char const *events) {
+    static struct {
+        char const *name;
+        unsigned cat;
+    } const cat_names[] = {
+        { "block", TRACE_CAT_BLOCK },
+        { "mmio", TRACE_CAT_MMIO },
+        { "irq", TRACE_CAT_IRQ },
+        { "dma", TRACE_CAT_DMA },
+        { "ta", TRACE_CAT_TA },
+        { "all", TRACE_CAT_BLOCK | TRACE_CAT_MMIO | TRACE_CAT_IRQ |
+          TRACE_CAT_DMA | TRACE_CAT_TA },
+        { NULL }
+    };
+
+    unsigned cats = 0;
+    char const *curs = events;
+    while (*curs) {
+        size_t len = strcspn(curs, ",");
+        unsigned idx;
+        for (idx = 0; cat_names[idx].name; idx++) {
+            if (strlen(cat_names[idx].name) == len &&
+                strncmp(cat_names[idx].name, curs, len) == 0) {
+                cats |= cat_names[idx].cat;
+                break;
+            }
+        }
+        if (!cat_names[idx].name)
+            LOG_WARN("unknown trace event type \"%.*s\"\n", (int)len, curs);
+
+        curs += len;
+        if (*curs == ',')
+            curs++;
+    }
+
+    return cats;
+}
+
+void trace_init(struct dc_clock *clk) {
+    trace_cats = 0;
+    trace_n_threads = 0;
+    trace_n_maps = 0;
+    trace_gen++;
+
+    char const *path = cfg_get_node("wash.trace.file");
+    if (!path || !strlen(path))
+        return;
+
+    char const *events = cfg_get_node("wash.trace.events");
+    unsigned cats = trace_parse_events(events ? events : "all");
+    if (!cats) {
+        LOG_WARN("not tracing anything because wash.trace.events is empty\n");
+        return;
+    }
+
+    trace_file = washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                                      WASHDC_HOSTFILE_BINARY);
+    if (trace_file == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("unable to open trace file \"%s\"\n", path);
+        return;
+    }
+
+    uint8_t hdr[TRACE_FILE_HDR_LEN];
+    uint8_t *outp = hdr;
+    memcpy(outp, TRACE_FILE_MAGIC, TRACE_FILE_MAGIC_LEN);
+    outp += TRACE_FILE_MAGIC_LEN;
+    outp = put_u32(outp, TRACE_FILE_VERSION);
+    outp = put_u32(outp, 0);
+    outp = put_u64(outp, SCHED_FREQUENCY);
+    washdc_hostfile_write(trace_file, hdr, sizeof(hdr));
+
+    memset(&trace_strm, 0, sizeof(trace_strm));
+    if (deflateInit(&trace_strm, Z_BEST_SPEED) != Z_OK)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    trace_out_buf = (uint8_t*)malloc(TRACE_OUT_BUF_LEN);
+    if (!trace_out_buf)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    trace_strm.next_out = trace_out_buf;
+    trace_strm.avail_out = TRACE_OUT_BUF_LEN;
+    trace_bytes_in = 0;
+
+    trace_clk = clk;
+    trace_work_pending = false;
+    trace_quit = false;
+    washdc_mutex_init(&trace_lock);
+    washdc_cvar_init(&trace_work_cond);
+    washdc_thread_create(&trace_writer, trace_writer_main, NULL);
+
+    trace_cats = cats;
+
+    LOG_INFO("recording execution trace to \"%s\"\n", path);
+}
+
+void trace_cleanup(void) {
+    if (!trace_cats)
+        return;
+
+    /*
+     * hand over whatever's left in the partially-filled chunks.  Nobody else
+     * is recording anything by now, so it's safe to touch other threads'
+     * chunks from here.
+     */
+    unsigned idx;
+    for (idx = 0; idx < trace_n_threads; idx++) {
+        struct trace_thread *td = trace_threads[idx];
+        if (td->cur->n_bytes)
+            trace_chunk_ring_produce(&td->full, td->cur);
+    }
+
+    trace_cats = 0;
+
+    washdc_mutex_lock(&trace_lock);
+    trace_quit = true;
+    washdc_cvar_signal(&trace_work_cond);
+    washdc_mutex_unlock(&trace_lock);
+
+    washdc_thread_join(&trace_writer);
+
+    trace_deflate(NULL, 0, Z_FINISH);
+    deflateEnd(&trace_strm);
+    washdc_hostfile_close(trace_file);
+    trace_file = WASHDC_HOSTFILE_INVALID;
+    free(trace_out_buf);
+    trace_out_buf = NULL;
+
+    LOG_INFO("execution trace: %llu bytes of events compressed to %llu "
+             "bytes\n", trace_bytes_in,
+             (unsigned long long)trace_strm.total_out);
+
+    for (idx = 0; idx < trace_n_threads; idx++) {
+        struct trace_thread *td = trace_threads[idx];
+        if (td->n_stalls) {
+            LOG_INFO("execution trace: thread %u waited on the writer %u "
+                     "times\n", td->thread_no, td->n_stalls);
+        }
+
+        unsigned chunk_no;
+        for (chunk_no = 0; chunk_no < TRACE_CHUNKS_PER_THREAD; chunk_no++)
+            free(td->chunks[chunk_no]);
+        washdc_cvar_cleanup(&td->empty_cond);
+        free(td);
+        trace_threads[idx] = NULL;
+    }
+    trace_n_threads = 0;
+    trace_n_maps = 0;
+
+    washdc_cvar_cleanup(&trace_work_cond);
+    washdc_mutex_cleanup(&trace_lock);
+}
+
+void trace_add_map(struct memory_map const *map, char const *name) {
+    if (!trace_cats)
+        return;
+
+    if (trace_n_maps >= TRACE_MAX_MAPS) {
+        LOG_ERROR("too many memory maps; accesses through \"%s\" will not be "
+                  "traced\n", name);
+        return;
+    }
+
+    unsigned map_no = trace_n_maps++;
+    trace_maps[map_no] = map;
+
+    /*
+     * the name goes straight into the chunk since it doesn't fit in
+     * TRACE_PAYLOAD_MAX
+     */
+    uint8_t rec[2 + 255];
+    size_t name_len = strlen(name);
+    if (name_len > 255)
+        name_len = 255;
+    rec[0] = map_no;
+    rec[1] = name_len;
+    memcpy(rec + 2, name, name_len);
+    trace_emit(TRACE_REC_MAP, rec, 2 + name_len);
+
+    unsigned region_no;
+    for (region_no = 0; region_no < map->n_regions; region_no++) {
+        struct memory_map_region const *reg = map->regions + region_no;
+        if (reg->id != MEMORY_MAP_REGION_MMIO)
+            continue;
+
+        uint8_t payload[TRACE_PAYLOAD_MAX];
+        uint8_t *outp = payload;
+        outp = put_u8(outp, map_no);
+        outp = put_u8(outp, region_no);
+        outp = put_u32(outp, reg->first_addr);
+        outp = put_u32(outp, reg->last_addr);
+        trace_emit(TRACE_REC_REGION, payload, outp - payload);
+    }
+}
+
+void trace_block(uint32_t blk_hash) {
+    uint8_t payload[TRACE_PAYLOAD_MAX];
+    put_u32(payload, blk_hash);
+    trace_emit(TRACE_REC_BLOCK, payload, 4);
+}
+
+void trace_mmio(struct memory_map const *map, unsigned region_no,
+                addr32_t addr, void const *val, unsigned len, bool write) {
+    unsigned map_no;
+    for (map_no = 0; map_no < trace_n_maps; map_no++)
+        if (trace_maps[map_no] == map)
+            break;
+    if (map_no == trace_n_maps)
+        return;
+
+    uint8_t payload[TRACE_PAYLOAD_MAX];
+    uint8_t *outp = payload;
+    outp = put_u8(outp, map_no);
+    outp = put_u8(outp, region_no);
+    outp = put_u8(outp, len);
+    outp = put_u32(outp, addr);
+
+    uint64_t val64 = 0;
+    memcpy(&val64, val, len);
+    unsigned idx;
+    for (idx = 0; idx < len; idx++)
+        outp = put_u8(outp, val64 >> (idx * 8));
+
+    trace_emit(write ? TRACE_REC_MMIO_WRITE : TRACE_REC_MMIO_READ,
+               payload, outp - payload);
+}
+
+void trace_irq(enum trace_irq_src src, unsigned code) {
+    uint8_t payload[TRACE_PAYLOAD_MAX];
+    uint8_t *outp = payload;
+    outp = put_u8(outp, src);
+    outp = put_u32(outp, code);
+    trace_emit(TRACE_REC_IRQ, payload, outp - payload);
+}
+
+void trace_dma(enum trace_dma_chan chan, addr32_t src, addr32_t dst,
+               unsigned n_bytes) {
+    uint8_t payload[TRACE_PAYLOAD_MAX];
+    uint8_t *outp = payload;
+    outp = put_u8(outp, chan);
+    outp = put_u32(outp, src);
+    outp = put_u32(outp, dst);
+    outp = put_u32(outp, n_bytes);
+    trace_emit(TRACE_REC_DMA, payload, outp - payload);
+}
+
+void trace_ta(enum trace_ta_evt evt, unsigned arg) {
+    uint8_t payload[TRACE_PAYLOAD_MAX];
+    uint8_t *outp = payload;
+    outp = put_u8(outp, evt);
+    outp = put_u32(outp, arg);
+    trace_emit(TRACE_REC_TA, payload, outp - payload);
+}
+
+static void trace_emit(enum trace_rec_type tp, uint8_t const *payload,
+                       unsigned len) {
+    struct trace_thread *td = trace_this_thread;
+    if (!td || trace_this_gen != trace_gen) {
+        td = trace_this_thread = trace_thread_create();
+        trace_this_gen = trace_gen;
+    }
+
+    dc_cycle_stamp_t now = clock_cycle_stamp(trace_clk);
+
+    if (TRACE_CHUNK_SIZE - td->cur->n_bytes < TRACE_REC_HDR_MAX + len)
+        trace_thread_push_chunk(td);
+
+    uint8_t *outp = td->cur->dat + td->cur->n_bytes;
+    if (!td->cur->n_bytes) {
+        // every chunk starts with the absolute time
+        outp = put_u8(outp, TRACE_REC_TIME);
+        outp = put_varint(outp, 0);
+        outp = put_u64(outp, now);
+        td->last_stamp = now;
+    }
+
+    dc_cycle_stamp_t delta = 0;
+    if (now > td->last_stamp) {
+        delta = now - td->last_stamp;
+        td->last_stamp = now;
+    }
+
+    outp = put_u8(outp, tp);
+    outp = put_varint(outp, delta);
+    memcpy(outp, payload, len);
+    outp += len;
+
+    td->cur->n_bytes = outp - td->cur->dat;
+}
+
+static struct trace_thread *trace_thread_create(void) {
+    struct trace_thread *td =
+        (struct trace_thread*)calloc(1, sizeof(struct trace_thread));
+    if (!td)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    trace_chunk_ring_init(&td->full);
+    trace_chunk_ring_init(&td->empty);
+    washdc_cvar_init(&td->empty_cond);
+
+    unsigned chunk_no;
+    for (chunk_no = 0; chunk_no < TRACE_CHUNKS_PER_THREAD; chunk_no++) {
+        struct trace_chunk *chunk =
+            (struct trace_chunk*)malloc(sizeof(struct trace_chunk));
+        if (!chunk)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        chunk->n_bytes = 0;
+        td->chunks[chunk_no] = chunk;
+        if (chunk_no)
+            trace_chunk_ring_produce(&td->empty, chunk);
+    }
+    td->cur = td->chunks[0];
+
+    washdc_mutex_lock(&trace_lock);
+    if (trace_n_threads >= TRACE_MAX_THREADS) {
+        washdc_mutex_unlock(&trace_lock);
+        error_set_feature("tracing more than TRACE_MAX_THREADS threads");
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+    td->thread_no = trace_n_threads;
+    trace_threads[trace_n_threads++] = td;
+    washdc_mutex_unlock(&trace_lock);
+
+    return td;
+}
+
+/*
+ * hand the current chunk over to the writer and start a new one, waiting for
+ * the writer to free one up if necessary.
+ */
+static void trace_thread_push_chunk(struct trace_thread *td) {
+    trace_chunk_ring_produce(&td->full, td->cur);
+
+    washdc_mutex_lock(&trace_lock);
+    trace_work_pending = true;
+    washdc_cvar_signal(&trace_work_cond);
+
+    struct trace_chunk *next;
+    if (!trace_chunk_ring_consume(&td->empty, &next)) {
+        td->n_stalls++;
+        do {
+            washdc_cvar_wait(&td->empty_cond, &trace_lock);
+        } while (!trace_chunk_ring_consume(&td->empty, &next));
+    }
+    washdc_mutex_unlock(&trace_lock);
+
+    next->n_bytes = 0;
+    td->cur = next;
+}
+
+static void trace_deflate(void const *dat, unsigned len, int flush) {
+    trace_strm.next_in = (Bytef*)dat;
+    trace_strm.avail_in = len;
+    trace_bytes_in += len;
+
+    do {
+        if (deflate(&trace_strm, flush) == Z_STREAM_ERROR)
+            RAISE_ERROR(ERROR_INTEGRITY);
+
+        if (!trace_strm.avail_out || flush == Z_FINISH) {
+            size_t n_bytes = TRACE_OUT_BUF_LEN - trace_strm.avail_out;
+            if (n_bytes &&
+                washdc_hostfile_write(trace_file, trace_out_buf,
+                                      n_bytes) != n_bytes) {
+                LOG_ERROR("failure to write to the trace file\n");
+            }
+            trace_strm.next_out = trace_out_buf;
+            trace_strm.avail_out = TRACE_OUT_BUF_LEN;
+        }
+    } while (trace_strm.avail_in ||
+             (flush == Z_FINISH && trace_strm.avail_out != TRACE_OUT_BUF_LEN));
+}
+
+static void trace_writer_main(void *argp) {
+    washdc_mutex_lock(&trace_lock);
+    for (;;) {
+        while (!trace_work_pending && !trace_quit)
+            washdc_cvar_wait(&trace_work_cond, &trace_lock);
+        trace_work_pending = false;
+        bool quit = trace_quit;
+        unsigned n_threads = trace_n_threads;
+        washdc_mutex_unlock(&trace_lock);
+
+        unsigned idx;
+        for (idx = 0; idx < n_threads; idx++) {
+            struct trace_thread *td = trace_threads[idx];
+            struct trace_chunk *chunk;
+            while (trace_chunk_ring_consume(&td->full, &chunk)) {
+                uint8_t hdr[TRACE_CHUNK_HDR_LEN];
+                put_u32(put_u32(hdr, td->thread_no), chunk->n_bytes);
+                trace_deflate(hdr, sizeof(hdr), Z_NO_FLUSH);
+                trace_deflate(chunk->dat, chunk->n_bytes, Z_NO_FLUSH);
+
+                washdc_mutex_lock(&trace_lock);
+                trace_chunk_ring_produce(&td->empty, chunk);
+                washdc_cvar_signal(&td->empty_cond);
+                washdc_mutex_unlock(&trace_lock);
+            }
+        }
+
+        washdc_mutex_lock(&trace_lock);
+        if (quit)
+            break;
+    }
+    washdc_mutex_unlock(&trace_lock);
+}
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/*
+ * Binary execution trace recorder.
+ *
+ * When WashingtonDC is built with -DENABLE_TRACE=On and wash.trace.file is set
+ * in the config file, the emulator writes a compact stream of events to that
+ * file: JIT block entries, MMIO register accesses, interrupts, DMA transfers
+ * and TA list submissions.  wash.trace.events selects which of those get
+ * recorded.  The format is described in washdc/trace_fmt.h, and
+ * washdc-tracedump can turn it back into text.
+ *
+ * Each host thread that records events gets its own set of chunk buffers, so
+ * recording an event is just a couple of stores into memory that nobody else
+ * touches.  Full chunks are handed off to a background thread through a
+ * lock-free single-producer/single-consumer ring, and that thread compresses
+ * them with zlib and writes them out.  If the writer falls behind, the thread
+ * recording events waits for it rather than dropping anything.
+ *
+ * The TRACE_* macros compile down to nothing when ENABLE_TRACE is not defined,
+ * and when it is defined they cost a single test of trace_cats when tracing
+ * is switched off at runtime.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "washdc/types.h"
+#include "washdc/trace_fmt.h"
+
+#define TRACE_CAT_BLOCK (1 << 0)
+#define TRACE_CAT_MMIO  (1 << 1)
+#define TRACE_CAT_IRQ   (1 << 2)
+#define TRACE_CAT_DMA   (1 << 3)
+#define TRACE_CAT_TA    (1 << 4)
+
+#ifdef ENABLE_TRACE
+
+struct dc_clock;
+struct memory_map;
+
+/*
+ * bitmask of TRACE_CAT_* categories that are being recorded.  This is 0 when
+ * tracing is disabled, and it does not change between trace_init and
+ * trace_cleanup.
+ */
+extern unsigned trace_cats;
+
+/*
+ * timestamps for all events are taken from clk.  This reads wash.trace.file
+ * and wash.trace.events, so it must be called after cfg_init.
+ */
+void trace_init(struct dc_clock *clk);
+
+/*
+ * flush everything and close the file.  Every thread other than the caller
+ * that recorded anything must have stopped doing so before this is called.
+ */
+void trace_cleanup(void);
+
+/*
+ * give a memory map a name and record its regions so that MMIO accesses
+ * through it can be traced.  Accesses through maps which have not been added
+ * this way are ignored.
+ */
+void trace_add_map(struct memory_map const *map, char const *name);
+
+void trace_block(uint32_t blk_hash);
+void trace_mmio(struct memory_map const *map, unsigned region_no,
+                addr32_t addr, void const *val, unsigned len, bool write);
+void trace_irq(enum trace_irq_src src, unsigned code);
+void trace_dma(enum trace_dma_chan chan, addr32_t src, addr32_t dst,
+               unsigned n_bytes);
+void trace_ta(enum trace_ta_evt evt, unsigned arg);
+
+#define TRACE_ON(cat) (trace_cats & (cat))
+
+#define TRACE_BLOCK(blk_hash)                                   \
+    do {                                                        \
+        if (TRACE_ON(TRACE_CAT_BLOCK))                          \
+            trace_block(blk_hash);                              \
+    } while (0)
+
+#define TRACE_MMIO(map, region_no, addr, valp, len, write)              \
+    do {                                                                \
+        if (TRACE_ON(TRACE_CAT_MMIO))                                   \
+            trace_mmio((map), (region_no), (addr), (valp), (len), (write)); \
+    } while (0)
+
+#define TRACE_IRQ(src, code)                                    \
+    do {                                                        \
+        if (TRACE_ON(TRACE_CAT_IRQ))                            \
+            trace_irq((src), (code));                           \
+    } while (0)
+
+#define TRACE_DMA(chan, src, dst, n_bytes)                      \
+    do {                                                        \
+        if (TRACE_ON(TRACE_CAT_DMA))                            \
+            trace_dma((chan), (src), (dst), (n_bytes));         \
+    } while (0)
+
+#define TRACE_TA(evt, arg)                                      \
+    do {                                                        \
+        if (TRACE_ON(TRACE_CAT_TA))                             \
+            trace_ta((evt), (arg));                             \
+    } while (0)
+
+#else
+
+#define TRACE_ON(cat) 0
+#define TRACE_BLOCK(blk_hash) do { } while (0)
+#define TRACE_MMIO(map, region_no, addr, valp, len, write) do { } while (0)
+#define TRACE_IRQ(src, code) do { } while (0)
+#define TRACE_DMA(chan, src, dst, n_bytes) do { } while (0)
+#define TRACE_TA(evt, arg) do { } while (0)
+
+#endif
+
+#endif
@@ -35,8 +35,12 @@
 #include "title.h"
 #include "washdc/win.h"
 #include "hw/pvr2/pvr2.h"
+#include "jit/jit_sample.h"
 #include "log.h"
+#include "pace.h"
+#include "bench.h"
 #include "washdc/config_file.h"
+#include "wdci.h"
 
 static struct washdc_hostfile_api const *hostfile_api;
 
@@ -52,7 +56,7 @@ static enum dc_boot_mode translate_boot_mode(enum washdc_boot_mode mode) {
     }
 }
 
-struct washdc_gameconsole const*
+struct washdc_instance *
 washdc_init(struct washdc_launch_settings const *settings) {
     config_set_log_stdout(settings->log_to_stdout);
     config_set_log_verbose(settings->log_verbose);
@@ -73,6 +77,13 @@ washdc_init(struct washdc_launch_settings const *settings) {
     config_set_dc_flash_path(settings->path_dc_flash);
     config_set_ser_srv_enable(settings->enable_serial);
     config_set_dc_path_rtc(settings->path_rtc);
+    config_set_bench_path(settings->path_bench);
+    config_set_bench_frames(settings->bench_frames);
+    config_set_bench_seconds(settings->bench_seconds);
+    config_set_movie_record_path(settings->path_movie_record);
+    config_set_movie_play_path(settings->path_movie_play);
+    config_set_frame_hash_path(settings->path_frame_hash);
+    config_set_frame_hash_frames(settings->frame_hash_frames);
 
     win_set_intf(settings->win_intf);
     gfx_set_overlay_intf(settings->overlay_intf);
@@ -86,85 +97,114 @@ washdc_init(struct washdc_launch_settings const *settings) {
                           settings->write_to_flash);
 }
 
-void washdc_cleanup() {
-    dreamcast_cleanup();
+void washdc_cleanup(struct washdc_instance *inst) {
+    dreamcast_cleanup(inst);
 }
 
-void washdc_run() {
-    dreamcast_run();
+struct washdc_gameconsole const *
+washdc_get_console(struct washdc_instance *inst) {
+    return dreamcast_get_console(inst);
 }
 
-void washdc_kill(void) {
+void washdc_run(struct washdc_instance *inst) {
+    dreamcast_run(inst);
+}
+
+unsigned washdc_sh4_difftest(struct washdc_instance *inst,
+                             char const *report_path, unsigned n_cases,
+                             unsigned seed) {
+    return dreamcast_sh4_difftest(inst, report_path, n_cases, seed);
+}
+
+int washdc_write_wdci(struct washdc_hostfile_api const *api,
+                      char const *gdi_path, char const *wdci_path) {
+    hostfile_api = api;
+
+    log_init(true, false);
+    int ret = wdci_write_from_gdi(gdi_path, wdci_path);
+    if (ret == 0)
+        ret = wdci_verify_against_gdi(wdci_path, gdi_path);
+    log_cleanup();
+
+    return ret;
+}
+
+void washdc_kill(struct washdc_instance *inst) {
     dreamcast_kill();
 }
 
-bool washdc_is_running(void) {
-    return dc_is_running();
+bool washdc_is_running(struct washdc_instance *inst) {
+    return dc_is_running(inst);
 }
 
-int washdc_save_screenshot(char const *path) {
+int washdc_save_screenshot(struct washdc_instance *inst, char const *path) {
     return save_screenshot(path);
 }
 
-int washdc_save_screenshot_dir(void) {
+int washdc_save_screenshot_dir(struct washdc_instance *inst) {
     return save_screenshot_dir();
 }
 
 // mark all buttons in btns as being pressed
-void washdc_controller_press_btns(unsigned port_no, uint32_t btns) {
+void washdc_controller_press_btns(struct washdc_instance *inst,
+                                  unsigned port_no, uint32_t btns) {
     dc_controller_press_buttons(port_no, btns);
 }
 
 // mark all buttons in btns as being released
-void washdc_controller_release_btns(unsigned port_no, uint32_t btns) {
+void washdc_controller_release_btns(struct washdc_instance *inst,
+                                    unsigned port_no, uint32_t btns) {
     dc_controller_release_buttons(port_no, btns);
 }
 
 void
-washdc_keyboard_set_btn(unsigned port_no, unsigned btn_no, bool is_pressed) {
+washdc_keyboard_set_btn(struct washdc_instance *inst,
+                        unsigned port_no, unsigned btn_no, bool is_pressed) {
     dc_keyboard_set_key(port_no, btn_no, is_pressed);
 }
 
 void
-washdc_keyboard_press_special(unsigned port_no,
+washdc_keyboard_press_special(struct washdc_instance *inst, unsigned port_no,
                               enum washdc_keyboard_special_keys which) {
     dc_keyboard_press_special(port_no, which);
 }
 
 void
-washdc_keyboard_release_special(unsigned port_no,
+washdc_keyboard_release_special(struct washdc_instance *inst, unsigned port_no,
                                 enum washdc_keyboard_special_keys which) {
     dc_keyboard_release_special(port_no, which);
 }
 
 // 0 = min, 255 = max, 128 = half
-void washdc_controller_set_axis(unsigned port_no, unsigned axis, unsigned val) {
+void washdc_controller_set_axis(struct washdc_instance *inst,
+                                unsigned port_no, unsigned axis, unsigned val) {
     dc_controller_set_axis(port_no, axis, val);
 }
 
-void washdc_on_expose(void) {
+void washdc_on_expose(struct washdc_instance *inst) {
     gfx_expose();
 }
 
-void washdc_on_resize(int xres, int yres) {
+void washdc_on_resize(struct washdc_instance *inst, int xres, int yres) {
     gfx_resize(xres, yres);
 }
 
-char const *washdc_win_get_title(void) {
+char const *washdc_win_get_title(struct washdc_instance *inst) {
     return title_get();
 }
 
-void washdc_gfx_toggle_wireframe(void) {
+void washdc_gfx_toggle_wireframe(struct washdc_instance *inst) {
     gfx_config_toggle_wireframe();
 }
 
-void washdc_gfx_toggle_filter(void) {
+void washdc_gfx_toggle_filter(struct washdc_instance *inst) {
     gfx_toggle_output_filter();
 }
 
-void washdc_get_pvr2_stat(struct washdc_pvr2_stat *stat) {
+void washdc_get_pvr2_stat(struct washdc_instance *inst,
+                          struct washdc_pvr2_stat *stat) {
     struct pvr2_stat src;
-    dc_get_pvr2_stats(&src);
+    dc_get_pvr2_stats(inst, &src);
 
     stat->poly_count[WASHDC_PVR2_POLY_GROUP_OPAQUE] =
         src.per_frame_counters.poly_count[PVR2_POLY_TYPE_OPAQUE];
@@ -189,23 +229,23 @@ void washdc_get_pvr2_stat(struct washdc_pvr2_stat *stat) {
         src.persistent_counters.tex_eviction_count;
 }
 
-void washdc_pause(void) {
-    dc_request_frame_stop();
+void washdc_pause(struct washdc_instance *inst) {
+    dc_request_frame_stop(inst);
 }
 
-void washdc_resume(void) {
+void washdc_resume(struct washdc_instance *inst) {
     dc_state_transition(DC_STATE_RUNNING, DC_STATE_SUSPEND);
 }
 
-bool washdc_is_paused(void) {
+bool washdc_is_paused(struct washdc_instance *inst) {
     return dc_get_state() == DC_STATE_SUSPEND;
 }
 
-void washdc_run_one_frame(void) {
+void washdc_run_one_frame(struct washdc_instance *inst) {
     enum dc_state dc_state = dc_get_state();
 
     if (dc_state == DC_STATE_SUSPEND) {
-        dc_request_frame_stop();
+        dc_request_frame_stop(inst);
         dc_state_transition(DC_STATE_RUNNING, DC_STATE_SUSPEND);
     } else {
         LOG_ERROR("%s - cannot run one frame becase emulator state is not "
@@ -213,8 +253,44 @@ void washdc_run_one_frame(void) {
     }
 }
 
-unsigned washdc_get_frame_count(void) {
-    return dc_get_frame_count();
+void washdc_set_frame_pacing(struct washdc_instance *inst, bool enable) {
+    pace_set_frame_pacing(enable);
+}
+
+void washdc_set_turbo(struct washdc_instance *inst, bool enable) {
+    dc_set_turbo(inst, enable);
+}
+
+bool washdc_get_turbo(struct washdc_instance *inst) {
+    return dc_get_turbo(inst);
+}
+
+unsigned washdc_get_frame_count(struct washdc_instance *inst) {
+    return dc_get_frame_count(inst);
+}
+
+void washdc_set_perf_counters(struct washdc_instance *inst, bool enable) {
+    bench_set_live(enable);
+}
+
+bool washdc_get_perf_counters(struct washdc_instance *inst,
+                              struct washdc_perf_counters *out) {
+    return bench_get_perf_counters(out);
+}
+
+bool washdc_jit_sample_enabled(struct washdc_instance *inst) {
+    return jit_sample_enabled();
+}
+
+unsigned washdc_jit_sample_top(struct washdc_instance *inst,
+                               struct washdc_jit_sample_blk *out,
+                               unsigned max_blocks,
+                               struct washdc_jit_sample_stat *stat) {
+    return jit_sample_top(out, max_blocks, stat);
+}
+
+void washdc_jit_sample_reset(struct washdc_instance *inst) {
+    jit_sample_reset();
 }
 
 washdc_hostfile washdc_hostfile_open(char const *path,
@@ -300,7 +376,8 @@ char washdc_hostfile_pathsep(void) {
     return hostfile_api->pathsep;
 }
 
-enum washdc_controller_tp washdc_controller_type(unsigned port_no) {
+enum washdc_controller_tp
+washdc_controller_type(struct washdc_instance *inst, unsigned port_no) {
     char tmp[32];
     snprintf(tmp, sizeof(tmp), "wash.dc.port.%u.0", port_no);
     tmp[sizeof(tmp) - 1] = '\0';
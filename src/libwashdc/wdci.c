@@ -0,0 +1,1061 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "zlib.h"
+
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "washdc/stringlib.h"
+#include "threading.h"
+#include "mount.h"
+#include "cdrom.h"
+#include "gdi.h"
+#include "log.h"
+
+#include "wdci.h"
+
+static char const wdci_magic[8] = { 'W', 'D', 'C', 'I', '\r', '\n', 0x1a, '\n' };
+
+#define WDCI_VERSION 1
+
+#define WDCI_HEADER_LEN 0x28
+#define WDCI_TRACK_ENTRY_LEN 24
+#define WDCI_HUNK_ENTRY_LEN 24
+
+#define WDCI_CODEC_STORED 0
+#define WDCI_CODEC_ZLIB 1
+
+// hunk size used by wdci_write_from_gdi, 8 full CD-ROM frames
+#define WDCI_DEFAULT_HUNK_BYTES (8 * CDROM_FRAME_SIZE)
+
+// sanity limits for images we didn't write ourselves
+#define WDCI_MAX_HUNK_BYTES (1024 * 1024)
+#define WDCI_MAX_TRACKS 99
+
+// number of decompressed hunks kept around
+#define WDCI_CACHE_HUNKS 32
+
+// how many hunks past the one being read the worker thread decompresses
+#define WDCI_PREFETCH_HUNKS 4
+
+#define WDCI_NO_HUNK 0xffffffff
+
+struct wdci_track {
+    unsigned fad_start;
+    unsigned ctrl;
+    unsigned sector_size;
+    unsigned n_sectors;
+    uint64_t data_offs;
+};
+
+struct wdci_hunk {
+    uint64_t file_offs;
+    uint32_t comp_len;
+    uint32_t crc;
+    uint32_t codec;
+};
+
+struct wdci_cache_ent {
+    unsigned hunk_no; // WDCI_NO_HUNK if this entry is empty
+
+    // true while some thread is decompressing into this entry
+    bool loading;
+
+    uint64_t last_used;
+    uint8_t *data;
+};
+
+struct wdci_mount {
+    unsigned hunk_bytes, n_hunks, n_tracks;
+    struct wdci_track *tracks;
+    struct wdci_hunk *hunks;
+
+    /*
+     * io_lock only protects fp, so the reader and the worker can decompress
+     * at the same time.  Each of them has its own buffer for compressed data.
+     */
+    washdc_mutex io_lock;
+    washdc_hostfile fp;
+    uint8_t *reader_comp_buf, *prefetch_comp_buf;
+    unsigned comp_buf_len;
+
+    /*
+     * everything below here is protected by cache_lock.  The reader waits on
+     * load_cond for hunks that the worker is in the middle of loading, and the
+     * worker waits on prefetch_cond for more work.
+     */
+    washdc_mutex cache_lock;
+    washdc_cvar load_cond, prefetch_cond;
+    struct wdci_cache_ent cache[WDCI_CACHE_HUNKS];
+    uint64_t use_count;
+    unsigned n_waiting;
+    unsigned prefetch_next, prefetch_end;
+    bool quit;
+
+    unsigned long long n_hits, n_misses, n_prefetched;
+
+    washdc_thread prefetch_thread;
+};
+
+static unsigned wdci_session_count(struct mount *mount);
+static int wdci_read_toc(struct mount *mount, struct mount_toc *toc,
+                         unsigned region);
+static int wdci_read_sector(struct mount *mount, void *buf, unsigned fad);
+static void wdci_cleanup(struct mount *mount);
+static int wdci_get_meta(struct mount *mount, struct mount_meta *meta);
+static unsigned wdci_get_leadout(struct mount *mount);
+static bool wdci_has_hd_region(struct mount *mount);
+static enum mount_disc_type wdci_get_disc_type(struct mount *mount);
+static void wdci_get_session_start(struct mount *mount, unsigned session_no,
+                                   unsigned *start_track, unsigned *fad);
+
+static void wdci_prefetch_main(void *argp);
+
+static struct mount_ops const wdci_mount_ops = {
+    .session_count = wdci_session_count,
+    .read_toc = wdci_read_toc,
+    .read_sector = wdci_read_sector,
+    .cleanup = wdci_cleanup,
+    .get_meta = wdci_get_meta,
+    .get_leadout = wdci_get_leadout,
+    .has_hd_region = wdci_has_hd_region,
+    .get_disc_type = wdci_get_disc_type,
+    .get_session_start = wdci_get_session_start
+};
+
+static uint32_t wdci_get32(uint8_t const *src) {
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+        ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+static uint64_t wdci_get64(uint8_t const *src) {
+    return (uint64_t)wdci_get32(src) | ((uint64_t)wdci_get32(src + 4) << 32);
+}
+
+static void wdci_put32(uint8_t *dst, uint32_t val) {
+    dst[0] = val & 0xff;
+    dst[1] = (val >> 8) & 0xff;
+    dst[2] = (val >> 16) & 0xff;
+    dst[3] = (val >> 24) & 0xff;
+}
+
+static void wdci_put64(uint8_t *dst, uint64_t val) {
+    wdci_put32(dst, val & 0xffffffff);
+    wdci_put32(dst + 4, val >> 32);
+}
+
+// offset of the 2048 bytes that read_sector returns within each sector
+static unsigned wdci_user_data_offset(unsigned sector_size) {
+    return sector_size == CDROM_FRAME_SIZE ? CDROM_MODE1_DATA_OFFSET : 0;
+}
+
+static int wdci_read_at(washdc_hostfile fp, uint64_t offs, void *dst,
+                        size_t len) {
+    if (washdc_hostfile_seek(fp, offs, WASHDC_HOSTFILE_SEEK_BEG) != 0)
+        return -1;
+    if (washdc_hostfile_read(fp, dst, len) != len)
+        return -1;
+    return 0;
+}
+
+// wdci_read_at for the mount's file, which is shared with the worker thread
+static int wdci_read_locked(struct wdci_mount *mnt, uint64_t offs, void *dst,
+                            size_t len) {
+    washdc_mutex_lock(&mnt->io_lock);
+    int err = wdci_read_at(mnt->fp, offs, dst, len);
+    washdc_mutex_unlock(&mnt->io_lock);
+    return err;
+}
+
+/*
+ * read and decompress the given hunk into dst.  comp_buf is the calling
+ * thread's buffer for compressed data.
+ */
+static int wdci_load_hunk(struct wdci_mount *mnt, unsigned hunk_no,
+                          uint8_t *dst, uint8_t *comp_buf) {
+    struct wdci_hunk const *hunk = mnt->hunks + hunk_no;
+    uLongf out_len = mnt->hunk_bytes;
+
+    switch (hunk->codec) {
+    case WDCI_CODEC_STORED:
+        if (wdci_read_locked(mnt, hunk->file_offs, dst, mnt->hunk_bytes) != 0)
+            goto on_io_error;
+        break;
+    case WDCI_CODEC_ZLIB:
+        if (wdci_read_locked(mnt, hunk->file_offs, comp_buf,
+                             hunk->comp_len) != 0) {
+            goto on_io_error;
+        }
+        if (uncompress(dst, &out_len, comp_buf, hunk->comp_len) != Z_OK ||
+            out_len != mnt->hunk_bytes) {
+            LOG_ERROR("%s: unable to decompress hunk %u\n", __func__, hunk_no);
+            return -1;
+        }
+        break;
+    default:
+        LOG_ERROR("%s: hunk %u has unknown codec %u\n",
+                  __func__, hunk_no, (unsigned)hunk->codec);
+        return -1;
+    }
+
+    if (crc32(0, dst, mnt->hunk_bytes) != hunk->crc) {
+        LOG_ERROR("%s: CRC mismatch on hunk %u\n", __func__, hunk_no);
+        return -1;
+    }
+
+    return 0;
+
+on_io_error:
+    LOG_ERROR("%s: unable to read hunk %u\n", __func__, hunk_no);
+    return -1;
+}
+
+// these next few must be called with cache_lock held
+static struct wdci_cache_ent *
+wdci_cache_find(struct wdci_mount *mnt, unsigned hunk_no) {
+    unsigned idx;
+    for (idx = 0; idx < WDCI_CACHE_HUNKS; idx++)
+        if (mnt->cache[idx].hunk_no == hunk_no)
+            return mnt->cache + idx;
+    return NULL;
+}
+
+/*
+ * pick the least-recently used entry that isn't being loaded and mark it as
+ * loading hunk_no.  There's always at least one to choose from because only
+ * two threads ever load hunks.
+ */
+static struct wdci_cache_ent *
+wdci_cache_claim(struct wdci_mount *mnt, unsigned hunk_no) {
+    struct wdci_cache_ent *victim = NULL;
+    unsigned idx;
+
+    for (idx = 0; idx < WDCI_CACHE_HUNKS; idx++) {
+        struct wdci_cache_ent *ent = mnt->cache + idx;
+        if (ent->loading)
+            continue;
+        if (ent->hunk_no == WDCI_NO_HUNK) {
+            victim = ent;
+            break;
+        }
+        if (!victim || ent->last_used < victim->last_used)
+            victim = ent;
+    }
+
+    if (!victim)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    victim->hunk_no = hunk_no;
+    victim->loading = true;
+    victim->last_used = ++mnt->use_count;
+    return victim;
+}
+
+static void wdci_cache_loaded(struct wdci_mount *mnt,
+                              struct wdci_cache_ent *ent, int err) {
+    ent->loading = false;
+    if (err)
+        ent->hunk_no = WDCI_NO_HUNK;
+    if (mnt->n_waiting)
+        washdc_cvar_signal(&mnt->load_cond);
+}
+
+/*
+ * return the cache entry for hunk_no, loading it if necessary.  Returns NULL
+ * if the hunk couldn't be loaded.  This temporarily drops cache_lock.
+ */
+static struct wdci_cache_ent *
+wdci_cache_get(struct wdci_mount *mnt, unsigned hunk_no) {
+    struct wdci_cache_ent *ent;
+
+    for (;;) {
+        ent = wdci_cache_find(mnt, hunk_no);
+        if (!ent)
+            break;
+        if (!ent->loading) {
+            ent->last_used = ++mnt->use_count;
+            mnt->n_hits++;
+            return ent;
+        }
+
+        // the worker is already on it
+        mnt->n_waiting++;
+        washdc_cvar_wait(&mnt->load_cond, &mnt->cache_lock);
+        mnt->n_waiting--;
+    }
+
+    mnt->n_misses++;
+    ent = wdci_cache_claim(mnt, hunk_no);
+    washdc_mutex_unlock(&mnt->cache_lock);
+
+    int err = wdci_load_hunk(mnt, hunk_no, ent->data, mnt->reader_comp_buf);
+
+    washdc_mutex_lock(&mnt->cache_lock);
+    wdci_cache_loaded(mnt, ent, err);
+
+    return err ? NULL : ent;
+}
+
+static void wdci_prefetch_main(void *argp) {
+    struct wdci_mount *mnt = (struct wdci_mount*)argp;
+
+    washdc_mutex_lock(&mnt->cache_lock);
+    while (!mnt->quit) {
+        if (mnt->prefetch_next >= mnt->prefetch_end) {
+            washdc_cvar_wait(&mnt->prefetch_cond, &mnt->cache_lock);
+            continue;
+        }
+
+        unsigned hunk_no = mnt->prefetch_next++;
+        if (wdci_cache_find(mnt, hunk_no))
+            continue;
+
+        struct wdci_cache_ent *ent = wdci_cache_claim(mnt, hunk_no);
+        washdc_mutex_unlock(&mnt->cache_lock);
+
+        int err = wdci_load_hunk(mnt, hunk_no, ent->data,
+                                 mnt->prefetch_comp_buf);
+
+        washdc_mutex_lock(&mnt->cache_lock);
+        wdci_cache_loaded(mnt, ent, err);
+        if (!err)
+            mnt->n_prefetched++;
+    }
+    washdc_mutex_unlock(&mnt->cache_lock);
+}
+
+// copy len bytes starting at offs in the uncompressed track data
+static int wdci_read(struct wdci_mount *mnt, void *dst, uint64_t offs,
+                     unsigned len) {
+    uint8_t *dst8 = (uint8_t*)dst;
+    int ret = 0;
+
+    washdc_mutex_lock(&mnt->cache_lock);
+
+    while (len) {
+        uint64_t hunk_no = offs / mnt->hunk_bytes;
+        unsigned hunk_offs = offs % mnt->hunk_bytes;
+        unsigned n_bytes = mnt->hunk_bytes - hunk_offs;
+        if (n_bytes > len)
+            n_bytes = len;
+
+        if (hunk_no >= mnt->n_hunks) {
+            ret = -1;
+            break;
+        }
+
+        struct wdci_cache_ent *ent = wdci_cache_get(mnt, hunk_no);
+        if (!ent) {
+            ret = -1;
+            break;
+        }
+        memcpy(dst8, ent->data + hunk_offs, n_bytes);
+
+        // get the worker started on the next few hunks
+        unsigned prefetch_end = hunk_no + 1 + WDCI_PREFETCH_HUNKS;
+        if (prefetch_end > mnt->n_hunks)
+            prefetch_end = mnt->n_hunks;
+        mnt->prefetch_next = hunk_no + 1;
+        mnt->prefetch_end = prefetch_end;
+        washdc_cvar_signal(&mnt->prefetch_cond);
+
+        dst8 += n_bytes;
+        offs += n_bytes;
+        len -= n_bytes;
+    }
+
+    washdc_mutex_unlock(&mnt->cache_lock);
+
+    return ret;
+}
+
+static int wdci_parse(struct wdci_mount *mnt, char const *path) {
+    uint8_t hdr[WDCI_HEADER_LEN];
+    uint8_t *tbl = NULL;
+    uint64_t data_len, map_offs, file_len;
+    unsigned idx;
+
+    if (washdc_hostfile_seek(mnt->fp, 0, WASHDC_HOSTFILE_SEEK_END) != 0) {
+        LOG_ERROR("%s: unable to get the length of %s\n", __func__, path);
+        return -1;
+    }
+    long len = washdc_hostfile_tell(mnt->fp);
+    if (len < 0) {
+        LOG_ERROR("%s: unable to get the length of %s\n", __func__, path);
+        return -1;
+    }
+    file_len = len;
+
+    if (wdci_read_at(mnt->fp, 0, hdr, sizeof(hdr)) != 0) {
+        LOG_ERROR("%s: unable to read header from %s\n", __func__, path);
+        return -1;
+    }
+
+    if (memcmp(hdr, wdci_magic, sizeof(wdci_magic)) != 0) {
+        LOG_ERROR("%s: %s is not a .wdci image\n", __func__, path);
+        return -1;
+    }
+
+    if (wdci_get32(hdr + 0x08) != WDCI_VERSION) {
+        LOG_ERROR("%s: %s is version %u, only version %u is supported\n",
+                  __func__, path, (unsigned)wdci_get32(hdr + 0x08),
+                  WDCI_VERSION);
+        return -1;
+    }
+
+    mnt->hunk_bytes = wdci_get32(hdr + 0x0c);
+    mnt->n_hunks = wdci_get32(hdr + 0x10);
+    mnt->n_tracks = wdci_get32(hdr + 0x14);
+    map_offs = wdci_get64(hdr + 0x18);
+    data_len = wdci_get64(hdr + 0x20);
+
+    // every hunk but the last must be full, and there can't be extras
+    if (!mnt->hunk_bytes || mnt->hunk_bytes > WDCI_MAX_HUNK_BYTES ||
+        mnt->n_tracks < 3 || mnt->n_tracks > WDCI_MAX_TRACKS ||
+        mnt->n_hunks !=
+        (data_len + mnt->hunk_bytes - 1) / mnt->hunk_bytes ||
+        map_offs > file_len ||
+        (uint64_t)mnt->n_hunks * WDCI_HUNK_ENTRY_LEN > file_len - map_offs) {
+        LOG_ERROR("%s: %s has a bad header\n", __func__, path);
+        return -1;
+    }
+
+    mnt->tracks = (struct wdci_track*)calloc(mnt->n_tracks,
+                                             sizeof(struct wdci_track));
+    mnt->hunks = (struct wdci_hunk*)calloc(mnt->n_hunks ? mnt->n_hunks : 1,
+                                           sizeof(struct wdci_hunk));
+    if (!mnt->tracks || !mnt->hunks)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    // track table
+    size_t tbl_len = (size_t)mnt->n_tracks * WDCI_TRACK_ENTRY_LEN;
+    if (!(tbl = (uint8_t*)malloc(tbl_len)))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    if (wdci_read_at(mnt->fp, WDCI_HEADER_LEN, tbl, tbl_len) != 0)
+        goto on_bad_file;
+    for (idx = 0; idx < mnt->n_tracks; idx++) {
+        uint8_t const *ent = tbl + idx * WDCI_TRACK_ENTRY_LEN;
+        struct wdci_track *trk = mnt->tracks + idx;
+        trk->fad_start = wdci_get32(ent);
+        trk->ctrl = wdci_get32(ent + 0x04);
+        trk->sector_size = wdci_get32(ent + 0x08);
+        trk->n_sectors = wdci_get32(ent + 0x0c);
+        trk->data_offs = wdci_get64(ent + 0x10);
+
+        if ((trk->sector_size != CDROM_FRAME_SIZE &&
+             trk->sector_size != CDROM_FRAME_DATA_SIZE) ||
+            trk->data_offs +
+            (uint64_t)trk->sector_size * trk->n_sectors > data_len) {
+            goto on_bad_file;
+        }
+    }
+    free(tbl);
+
+    // hunk map
+    tbl_len = (size_t)mnt->n_hunks * WDCI_HUNK_ENTRY_LEN;
+    if (!(tbl = (uint8_t*)malloc(tbl_len ? tbl_len : 1)))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    if (wdci_read_at(mnt->fp, map_offs, tbl, tbl_len) != 0)
+        goto on_bad_file;
+    mnt->comp_buf_len = 0;
+    for (idx = 0; idx < mnt->n_hunks; idx++) {
+        uint8_t const *ent = tbl + idx * WDCI_HUNK_ENTRY_LEN;
+        struct wdci_hunk *hunk = mnt->hunks + idx;
+        hunk->file_offs = wdci_get64(ent);
+        hunk->comp_len = wdci_get32(ent + 0x08);
+        hunk->crc = wdci_get32(ent + 0x0c);
+        hunk->codec = wdci_get32(ent + 0x10);
+
+        if (hunk->comp_len > compressBound(mnt->hunk_bytes) ||
+            (hunk->codec == WDCI_CODEC_STORED &&
+             hunk->comp_len != mnt->hunk_bytes) ||
+            hunk->file_offs > file_len ||
+            hunk->comp_len > file_len - hunk->file_offs) {
+            goto on_bad_file;
+        }
+        if (hunk->comp_len > mnt->comp_buf_len)
+            mnt->comp_buf_len = hunk->comp_len;
+    }
+    free(tbl);
+
+    return 0;
+
+on_bad_file:
+    LOG_ERROR("%s: %s is truncated or corrupt\n", __func__, path);
+    free(tbl);
+    return -1;
+}
+
+static void wdci_free(struct wdci_mount *mnt) {
+    unsigned idx;
+    for (idx = 0; idx < WDCI_CACHE_HUNKS; idx++)
+        free(mnt->cache[idx].data);
+    free(mnt->prefetch_comp_buf);
+    free(mnt->reader_comp_buf);
+    free(mnt->hunks);
+    free(mnt->tracks);
+    if (mnt->fp != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_close(mnt->fp);
+    free(mnt);
+}
+
+/*
+ * take ownership of fp, parse the image in it and start up the worker thread.
+ * Returns NULL if the image is bad.
+ */
+static struct wdci_mount *wdci_open(washdc_hostfile fp, char const *path) {
+    struct wdci_mount *mnt =
+        (struct wdci_mount*)calloc(1, sizeof(struct wdci_mount));
+    unsigned idx;
+
+    if (!mnt)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    mnt->fp = fp;
+
+    if (wdci_parse(mnt, path) != 0) {
+        wdci_free(mnt);
+        return NULL;
+    }
+
+    size_t comp_buf_len = mnt->comp_buf_len ? mnt->comp_buf_len : 1;
+    mnt->reader_comp_buf = (uint8_t*)malloc(comp_buf_len);
+    mnt->prefetch_comp_buf = (uint8_t*)malloc(comp_buf_len);
+    if (!mnt->reader_comp_buf || !mnt->prefetch_comp_buf)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    for (idx = 0; idx < WDCI_CACHE_HUNKS; idx++) {
+        mnt->cache[idx].hunk_no = WDCI_NO_HUNK;
+        if (!(mnt->cache[idx].data = (uint8_t*)malloc(mnt->hunk_bytes)))
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    washdc_mutex_init(&mnt->io_lock);
+    washdc_mutex_init(&mnt->cache_lock);
+    washdc_cvar_init(&mnt->load_cond);
+    washdc_cvar_init(&mnt->prefetch_cond);
+    washdc_thread_create(&mnt->prefetch_thread, wdci_prefetch_main, mnt);
+
+    return mnt;
+}
+
+static void wdci_close(struct wdci_mount *mnt) {
+    washdc_mutex_lock(&mnt->cache_lock);
+    mnt->quit = true;
+    washdc_cvar_signal(&mnt->prefetch_cond);
+    washdc_mutex_unlock(&mnt->cache_lock);
+
+    washdc_thread_join(&mnt->prefetch_thread);
+
+    LOG_INFO("wdci: %llu hunk cache hits, %llu misses, %llu hunks "
+             "prefetched\n", mnt->n_hits, mnt->n_misses, mnt->n_prefetched);
+
+    washdc_cvar_cleanup(&mnt->prefetch_cond);
+    washdc_cvar_cleanup(&mnt->load_cond);
+    washdc_mutex_cleanup(&mnt->cache_lock);
+    washdc_mutex_cleanup(&mnt->io_lock);
+
+    wdci_free(mnt);
+}
+
+void mount_wdci(char const *path) {
+    struct wdci_mount *mnt;
+    unsigned idx;
+
+    washdc_hostfile fp = washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                                              WASHDC_HOSTFILE_BINARY);
+    if (fp == WASHDC_HOSTFILE_INVALID) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    if (!(mnt = wdci_open(fp, path))) {
+        error_set_file_path(path);
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+
+    LOG_INFO("about to (attempt to) mount the following image:\n");
+    LOG_INFO("%s: %u tracks in %u hunks of %u bytes\n", path, mnt->n_tracks,
+             mnt->n_hunks, mnt->hunk_bytes);
+    for (idx = 0; idx < mnt->n_tracks; idx++) {
+        struct wdci_track const *trk = mnt->tracks + idx;
+        LOG_INFO("%u %u %u %u (%u sectors)\n", idx + 1,
+                 cdrom_fad_to_lba(trk->fad_start), trk->ctrl,
+                 trk->sector_size, trk->n_sectors);
+    }
+
+    mount_insert(&wdci_mount_ops, mnt);
+}
+
+static void wdci_cleanup(struct mount *mount) {
+    wdci_close((struct wdci_mount*)mount->state);
+}
+
+static unsigned wdci_session_count(struct mount *mount) {
+    return 1;
+}
+
+static enum mount_disc_type wdci_get_disc_type(struct mount *mount) {
+    return DISC_TYPE_GDROM;
+}
+
+static bool wdci_has_hd_region(struct mount *mount) {
+    return true;
+}
+
+static int wdci_read_toc(struct mount *mount, struct mount_toc *toc,
+                         unsigned region) {
+    struct wdci_mount const *mnt = (struct wdci_mount const*)mount->state;
+    unsigned first_track, last_track, track_no;
+
+    memset(toc->tracks, 0, sizeof(toc->tracks));
+
+    // same layout as a .gdi: tracks 1-2 are LD, everything else is HD
+    if (region == MOUNT_LD_REGION) {
+        first_track = 1;
+        last_track = 2;
+    } else {
+        first_track = 3;
+        last_track = mnt->n_tracks;
+    }
+
+    for (track_no = first_track; track_no <= last_track; track_no++) {
+        struct wdci_track const *trk = mnt->tracks + (track_no - 1);
+        toc->tracks[track_no - 1].fad = trk->fad_start;
+        toc->tracks[track_no - 1].adr = 1;
+        toc->tracks[track_no - 1].ctrl = trk->ctrl;
+        toc->tracks[track_no - 1].valid = true;
+    }
+
+    toc->first_track = first_track;
+    toc->last_track = last_track;
+    toc->leadout = mnt->tracks[last_track - 1].fad_start +
+        mnt->tracks[last_track - 1].n_sectors;
+    toc->leadout_adr = 1;
+
+    return 0;
+}
+
+// return the track holding the given FAD, or NULL if there isn't one
+static struct wdci_track const *
+wdci_find_track(struct wdci_mount const *mnt, unsigned fad) {
+    unsigned track_idx;
+
+    for (track_idx = 0; track_idx < mnt->n_tracks; track_idx++) {
+        struct wdci_track const *trk = mnt->tracks + track_idx;
+        if (fad >= trk->fad_start && fad < trk->fad_start + trk->n_sectors)
+            return trk;
+    }
+
+    return NULL;
+}
+
+static int wdci_read_sector(struct mount *mount, void *buf, unsigned fad) {
+    struct wdci_mount *mnt = (struct wdci_mount*)mount->state;
+    struct wdci_track const *trk = wdci_find_track(mnt, fad);
+
+    if (!trk)
+        return -1;
+
+    uint64_t offs = trk->data_offs +
+        (uint64_t)(fad - trk->fad_start) * trk->sector_size +
+        wdci_user_data_offset(trk->sector_size);
+    return wdci_read(mnt, buf, offs, CDROM_FRAME_DATA_SIZE);
+}
+
+static int wdci_get_meta(struct mount *mount, struct mount_meta *meta) {
+    struct wdci_mount *mnt = (struct wdci_mount*)mount->state;
+    struct wdci_track const *trk = mnt->tracks + 2;
+    uint8_t buffer[256];
+
+    if (!trk->n_sectors ||
+        wdci_read(mnt, buffer, trk->data_offs +
+                  wdci_user_data_offset(trk->sector_size),
+                  sizeof(buffer)) != 0) {
+        return -1;
+    }
+
+    memset(meta, 0, sizeof(*meta));
+
+    memcpy(meta->hardware, buffer, MOUNT_META_HARDWARE_LEN);
+    memcpy(meta->maker, buffer + 16, MOUNT_META_MAKER_LEN);
+    memcpy(meta->dev_info, buffer + 32, MOUNT_META_DEV_INFO_LEN);
+    memcpy(meta->region, buffer + 48, MOUNT_META_REGION_LEN);
+    memcpy(meta->periph_support, buffer + 56, MOUNT_META_PERIPH_LEN);
+    memcpy(meta->product_id, buffer + 64, MOUNT_META_PRODUCT_ID_LEN);
+    memcpy(meta->product_version, buffer + 74, MOUNT_META_PRODUCT_VERSION_LEN);
+    memcpy(meta->rel_date, buffer + 80, MOUNT_META_REL_DATE_LEN);
+    memcpy(meta->boot_file, buffer + 96, MOUNT_META_BOOT_FILE_LEN);
+    memcpy(meta->company, buffer + 112, MOUNT_META_COMPANY_LEN);
+    memcpy(meta->title, buffer + 128, MOUNT_META_TITLE_LEN);
+
+    return 0;
+}
+
+static unsigned wdci_get_leadout(struct mount *mount) {
+    struct wdci_mount const *mnt = (struct wdci_mount const*)mount->state;
+    struct wdci_track const *last_track = mnt->tracks + (mnt->n_tracks - 1);
+
+    return last_track->n_sectors + cdrom_fad_to_lba(last_track->fad_start);
+}
+
+static void wdci_get_session_start(struct mount *mount, unsigned session_no,
+                                   unsigned *start_track, unsigned *fad) {
+    if (session_no != 0)
+        RAISE_ERROR(ERROR_INTEGRITY);// there's only one session on a GD-ROM
+
+    struct wdci_mount const *mnt = (struct wdci_mount const*)mount->state;
+
+    *start_track = 0;
+    *fad = mnt->tracks[0].fad_start;
+}
+
+/*
+ * compress one hunk and append it to the file, filling in its map entry.
+ * Hunks that zlib can't shrink get stored as-is.
+ */
+static int wdci_write_hunk(washdc_hostfile out, uint8_t const *hunk,
+                           unsigned hunk_bytes, uint8_t *comp_buf,
+                           unsigned comp_buf_len, uint64_t *file_offs,
+                           uint8_t *map_ent) {
+    uLongf comp_len = comp_buf_len;
+    uint8_t const *data = comp_buf;
+    unsigned codec = WDCI_CODEC_ZLIB;
+
+    if (compress2(comp_buf, &comp_len, hunk, hunk_bytes,
+                  Z_BEST_COMPRESSION) != Z_OK || comp_len >= hunk_bytes) {
+        data = hunk;
+        comp_len = hunk_bytes;
+        codec = WDCI_CODEC_STORED;
+    }
+
+    if (washdc_hostfile_write(out, data, comp_len) != comp_len)
+        return -1;
+
+    memset(map_ent, 0, WDCI_HUNK_ENTRY_LEN);
+    wdci_put64(map_ent, *file_offs);
+    wdci_put32(map_ent + 0x08, comp_len);
+    wdci_put32(map_ent + 0x0c, crc32(0, hunk, hunk_bytes));
+    wdci_put32(map_ent + 0x10, codec);
+
+    *file_offs += comp_len;
+    return 0;
+}
+
+int wdci_write_from_gdi(char const *gdi_path, char const *wdci_path) {
+    unsigned const hunk_bytes = WDCI_DEFAULT_HUNK_BYTES;
+    unsigned const comp_buf_len = compressBound(hunk_bytes);
+    struct gdi_info info;
+    uint64_t *track_lens = NULL;
+    uint64_t data_len = 0, file_offs, comp_total = 0;
+    uint8_t *hunk = NULL, *comp_buf = NULL, *map = NULL, *tbl = NULL;
+    washdc_hostfile out = WASHDC_HOSTFILE_INVALID;
+    washdc_hostfile track_fp = WASHDC_HOSTFILE_INVALID;
+    unsigned track_no, n_hunks, hunk_no = 0, hunk_fill = 0;
+    int ret = -1;
+
+    parse_gdi(&info, gdi_path);
+
+    if (info.n_tracks < 3 || info.n_tracks > WDCI_MAX_TRACKS) {
+        LOG_ERROR("%s: bad track count in %s\n", __func__, gdi_path);
+        goto cleanup;
+    }
+
+    // measure the tracks so that the header can be written up front
+    if (!(track_lens = (uint64_t*)calloc(info.n_tracks, sizeof(uint64_t))))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    for (track_no = 0; track_no < info.n_tracks; track_no++) {
+        struct gdi_track const *trk = info.tracks + track_no;
+        char const *path = string_get(&trk->abs_path);
+
+        if (trk->sector_size != CDROM_FRAME_SIZE &&
+            trk->sector_size != CDROM_FRAME_DATA_SIZE) {
+            LOG_ERROR("%s: track %u of %s has unsupported sector size %u\n",
+                      __func__, track_no + 1, gdi_path, trk->sector_size);
+            goto cleanup;
+        }
+
+        track_fp = washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                                        WASHDC_HOSTFILE_BINARY);
+        if (track_fp == WASHDC_HOSTFILE_INVALID ||
+            washdc_hostfile_seek(track_fp, 0, WASHDC_HOSTFILE_SEEK_END) != 0) {
+            LOG_ERROR("%s: unable to open %s\n", __func__, path);
+            goto cleanup;
+        }
+        long len = washdc_hostfile_tell(track_fp);
+        washdc_hostfile_close(track_fp);
+        track_fp = WASHDC_HOSTFILE_INVALID;
+        if (len < 0) {
+            LOG_ERROR("%s: unable to get the length of %s\n", __func__, path);
+            goto cleanup;
+        }
+
+        // drop any partial sector at the end, gdi.c ignores those too
+        track_lens[track_no] = len - len % trk->sector_size;
+        data_len += track_lens[track_no];
+    }
+
+    n_hunks = (data_len + hunk_bytes - 1) / hunk_bytes;
+
+    hunk = (uint8_t*)malloc(hunk_bytes);
+    comp_buf = (uint8_t*)malloc(comp_buf_len);
+    map = (uint8_t*)calloc(n_hunks ? n_hunks : 1, WDCI_HUNK_ENTRY_LEN);
+    tbl = (uint8_t*)calloc(1, WDCI_HEADER_LEN +
+                           info.n_tracks * WDCI_TRACK_ENTRY_LEN);
+    if (!hunk || !comp_buf || !map || !tbl)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    out = washdc_hostfile_open(wdci_path, WASHDC_HOSTFILE_WRITE |
+                               WASHDC_HOSTFILE_BINARY);
+    if (out == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("%s: unable to open %s\n", __func__, wdci_path);
+        goto cleanup;
+    }
+
+    // header and track table; the map offset gets filled in at the end
+    memcpy(tbl, wdci_magic, sizeof(wdci_magic));
+    wdci_put32(tbl + 0x08, WDCI_VERSION);
+    wdci_put32(tbl + 0x0c, hunk_bytes);
+    wdci_put32(tbl + 0x10, n_hunks);
+    wdci_put32(tbl + 0x14, info.n_tracks);
+    wdci_put64(tbl + 0x20, data_len);
+
+    uint64_t track_offs = 0;
+    for (track_no = 0; track_no < info.n_tracks; track_no++) {
+        struct gdi_track const *trk = info.tracks + track_no;
+        uint8_t *ent = tbl + WDCI_HEADER_LEN + track_no * WDCI_TRACK_ENTRY_LEN;
+        wdci_put32(ent, trk->fad_start);
+        wdci_put32(ent + 0x04, trk->ctrl);
+        wdci_put32(ent + 0x08, trk->sector_size);
+        wdci_put32(ent + 0x0c, track_lens[track_no] / trk->sector_size);
+        wdci_put64(ent + 0x10, track_offs);
+        track_offs += track_lens[track_no];
+    }
+
+    size_t tbl_len = WDCI_HEADER_LEN + info.n_tracks * WDCI_TRACK_ENTRY_LEN;
+    if (washdc_hostfile_write(out, tbl, tbl_len) != tbl_len)
+        goto on_write_error;
+    file_offs = tbl_len;
+
+    // the track data, cut into hunks regardless of where the tracks begin
+    for (track_no = 0; track_no < info.n_tracks; track_no++) {
+        char const *path = string_get(&info.tracks[track_no].abs_path);
+        uint64_t remaining = track_lens[track_no];
+
+        track_fp = washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                                        WASHDC_HOSTFILE_BINARY);
+        if (track_fp == WASHDC_HOSTFILE_INVALID) {
+            LOG_ERROR("%s: unable to open %s\n", __func__, path);
+            goto cleanup;
+        }
+
+        while (remaining) {
+            unsigned n_bytes = hunk_bytes - hunk_fill;
+            if (n_bytes > remaining)
+                n_bytes = remaining;
+            if (washdc_hostfile_read(track_fp, hunk + hunk_fill,
+                                     n_bytes) != n_bytes) {
+                LOG_ERROR("%s: unable to read %s\n", __func__, path);
+                goto cleanup;
+            }
+            hunk_fill += n_bytes;
+            remaining -= n_bytes;
+
+            if (hunk_fill == hunk_bytes) {
+                uint64_t prev_offs = file_offs;
+                if (wdci_write_hunk(out, hunk, hunk_bytes, comp_buf,
+                                    comp_buf_len, &file_offs,
+                                    map + hunk_no * WDCI_HUNK_ENTRY_LEN) != 0)
+                    goto on_write_error;
+                comp_total += file_offs - prev_offs;
+                hunk_no++;
+                hunk_fill = 0;
+            }
+        }
+
+        washdc_hostfile_close(track_fp);
+        track_fp = WASHDC_HOSTFILE_INVALID;
+    }
+
+    if (hunk_fill) {
+        uint64_t prev_offs = file_offs;
+        memset(hunk + hunk_fill, 0, hunk_bytes - hunk_fill);
+        if (wdci_write_hunk(out, hunk, hunk_bytes, comp_buf, comp_buf_len,
+                            &file_offs,
+                            map + hunk_no * WDCI_HUNK_ENTRY_LEN) != 0)
+            goto on_write_error;
+        comp_total += file_offs - prev_offs;
+        hunk_no++;
+    }
+
+    if (hunk_no != n_hunks)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    if (washdc_hostfile_write(out, map, (size_t)n_hunks * WDCI_HUNK_ENTRY_LEN) !=
+        (size_t)n_hunks * WDCI_HUNK_ENTRY_LEN)
+        goto on_write_error;
+
+    // go back and fill in where the map is
+    uint8_t map_offs[8];
+    wdci_put64(map_offs, file_offs);
+    if (washdc_hostfile_seek(out, 0x18, WASHDC_HOSTFILE_SEEK_BEG) != 0 ||
+        washdc_hostfile_write(out, map_offs, sizeof(map_offs)) !=
+        sizeof(map_offs))
+        goto on_write_error;
+
+    LOG_INFO("%s: wrote %s: %llu bytes of track data compressed to %llu "
+             "bytes in %u hunks\n", __func__, wdci_path,
+             (unsigned long long)data_len, (unsigned long long)comp_total,
+             n_hunks);
+    ret = 0;
+    goto cleanup;
+
+on_write_error:
+    LOG_ERROR("%s: unable to write to %s\n", __func__, wdci_path);
+
+cleanup:
+    if (track_fp != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_close(track_fp);
+    if (out != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_close(out);
+    free(tbl);
+    free(map);
+    free(comp_buf);
+    free(hunk);
+    free(track_lens);
+    cleanup_gdi_info(&info);
+    return ret;
+}
+
+int wdci_verify_against_gdi(char const *wdci_path, char const *gdi_path) {
+    uint8_t gdi_sector[CDROM_FRAME_SIZE], wdci_sector[CDROM_FRAME_SIZE];
+    struct gdi_info info;
+    struct wdci_mount *mnt = NULL;
+    washdc_hostfile track_fp = WASHDC_HOSTFILE_INVALID;
+    unsigned track_no;
+    unsigned long long n_sectors_total = 0, n_mismatch = 0;
+    int ret = -1;
+
+    parse_gdi(&info, gdi_path);
+
+    washdc_hostfile fp = washdc_hostfile_open(wdci_path, WASHDC_HOSTFILE_READ |
+                                              WASHDC_HOSTFILE_BINARY);
+    if (fp == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("%s: unable to open %s\n", __func__, wdci_path);
+        goto cleanup;
+    }
+    if (!(mnt = wdci_open(fp, wdci_path)))
+        goto cleanup;
+
+    if (mnt->n_tracks != info.n_tracks) {
+        LOG_ERROR("%s: %s has %u tracks but %s has %u\n", __func__,
+                  wdci_path, mnt->n_tracks, gdi_path, info.n_tracks);
+        goto cleanup;
+    }
+
+    for (track_no = 0; track_no < info.n_tracks; track_no++) {
+        struct gdi_track const *gdi_trk = info.tracks + track_no;
+        struct wdci_track const *wdci_trk = mnt->tracks + track_no;
+        char const *path = string_get(&gdi_trk->abs_path);
+        unsigned sector_size = gdi_trk->sector_size;
+        unsigned sector_no, n_sectors;
+
+        track_fp = washdc_hostfile_open(path, WASHDC_HOSTFILE_READ |
+                                        WASHDC_HOSTFILE_BINARY);
+        if (track_fp == WASHDC_HOSTFILE_INVALID ||
+            washdc_hostfile_seek(track_fp, 0, WASHDC_HOSTFILE_SEEK_END) != 0) {
+            LOG_ERROR("%s: unable to open %s\n", __func__, path);
+            goto cleanup;
+        }
+        long len = washdc_hostfile_tell(track_fp);
+        if (len < 0 ||
+            washdc_hostfile_seek(track_fp, 0, WASHDC_HOSTFILE_SEEK_BEG) != 0) {
+            LOG_ERROR("%s: unable to get the length of %s\n", __func__, path);
+            goto cleanup;
+        }
+        n_sectors = len / sector_size;
+
+        if (wdci_trk->fad_start != gdi_trk->fad_start ||
+            wdci_trk->ctrl != gdi_trk->ctrl ||
+            wdci_trk->sector_size != sector_size ||
+            wdci_trk->n_sectors != n_sectors) {
+            LOG_ERROR("%s: track %u of %s doesn't match %s\n", __func__,
+                      track_no + 1, wdci_path, gdi_path);
+            goto cleanup;
+        }
+
+        /*
+         * look each sector up by FAD the same way wdci_read_sector does, but
+         * compare the whole frame instead of just the user data.
+         */
+        for (sector_no = 0; sector_no < n_sectors; sector_no++) {
+            unsigned fad = gdi_trk->fad_start + sector_no;
+            struct wdci_track const *trk = wdci_find_track(mnt, fad);
+
+            if (washdc_hostfile_read(track_fp, gdi_sector,
+                                     sector_size) != sector_size) {
+                LOG_ERROR("%s: unable to read %s\n", __func__, path);
+                goto cleanup;
+            }
+
+            if (!trk ||
+                wdci_read(mnt, wdci_sector, trk->data_offs +
+                          (uint64_t)(fad - trk->fad_start) * trk->sector_size,
+                          sector_size) != 0 ||
+                memcmp(gdi_sector, wdci_sector, sector_size) != 0) {
+                if (!n_mismatch)
+                    LOG_ERROR("%s: FAD %u (track %u) of %s doesn't match "
+                              "%s\n", __func__, fad, track_no + 1, wdci_path,
+                              gdi_path);
+                n_mismatch++;
+            }
+        }
+
+        n_sectors_total += n_sectors;
+        washdc_hostfile_close(track_fp);
+        track_fp = WASHDC_HOSTFILE_INVALID;
+    }
+
+    if (n_mismatch) {
+        LOG_ERROR("%s: %llu of %llu sectors in %s don't match %s\n", __func__,
+                  n_mismatch, n_sectors_total, wdci_path, gdi_path);
+    } else {
+        LOG_INFO("%s: all %llu sectors in %s match %s\n", __func__,
+                 n_sectors_total, wdci_path, gdi_path);
+        ret = 0;
+    }
+
+cleanup:
+    if (track_fp != WASHDC_HOSTFILE_INVALID)
+        washdc_hostfile_close(track_fp);
+    if (mnt)
+        wdci_close(mnt);
+    cleanup_gdi_info(&info);
+    return ret;
+}
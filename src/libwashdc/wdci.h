@@ -0,0 +1,78 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef WASHDC_WDCI_H_
+#define WASHDC_WDCI_H_
+
+/*
+ * .wdci - WashingtonDC's compressed disc image format.
+ *
+ * This is a GD-ROM image with the same tracks as a .gdi, except that all of
+ * the track data is concatenated into one stream and cut into fixed-size
+ * hunks which are individually compressed with zlib.  Sectors are read back
+ * out through a small LRU cache of decompressed hunks, and a worker thread
+ * decompresses the next few hunks ahead of the reader since the GD-ROM mostly
+ * reads sequentially.
+ *
+ * Everything is little-endian.  The file starts with a header:
+ *
+ *     0x00    magic, "WDCI\r\n\x1a\n"
+ *     0x08    u32 format version (1)
+ *     0x0c    u32 bytes per hunk (the last hunk is zero-padded)
+ *     0x10    u32 number of hunks
+ *     0x14    u32 number of tracks
+ *     0x18    u64 file offset of the hunk map
+ *     0x20    u64 total length of the uncompressed track data
+ *
+ * followed by one 24-byte entry per track:
+ *
+ *     0x00    u32 FAD of the track's first sector
+ *     0x04    u32 ctrl
+ *     0x08    u32 sector size (2352 or 2048)
+ *     0x0c    u32 number of sectors
+ *     0x10    u64 offset of the track within the uncompressed data
+ *
+ * The hunk map is one 24-byte entry per hunk:
+ *
+ *     0x00    u64 file offset of the hunk's data
+ *     0x08    u32 length of the hunk's data in the file
+ *     0x0c    u32 CRC-32 of the uncompressed hunk
+ *     0x10    u32 codec (0 = stored, 1 = zlib)
+ *     0x14    u32 reserved (0)
+ */
+
+void mount_wdci(char const *path);
+
+/*
+ * repack the .gdi image at gdi_path into a .wdci image at wdci_path.  Returns
+ * 0 on success or nonzero on error.
+ */
+int wdci_write_from_gdi(char const *gdi_path, char const *wdci_path);
+
+/*
+ * reopen the .wdci image at wdci_path and check every sector in it against
+ * the .gdi image at gdi_path.  Returns 0 if they all match.
+ */
+int wdci_verify_against_gdi(char const *wdci_path, char const *gdi_path);
+
+#endif
@@ -59,3 +59,16 @@ int win_get_width(void) {
 int win_get_height(void) {
     return win_intf->get_height();
 }
+
+bool win_can_wait_events(void) {
+    return win_intf && win_intf->wait_events;
+}
+
+void win_wait_events(void) {
+    win_intf->wait_events();
+}
+
+void win_wake_events(void) {
+    if (win_intf && win_intf->wake_events)
+        win_intf->wake_events();
+}
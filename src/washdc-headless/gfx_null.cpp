@@ -38,7 +38,9 @@ static void null_render_update_tex(unsigned tex_obj);
 static void null_render_release_tex(unsigned tex_obj);
 static void null_render_set_blend_enable(bool enable);
 static void null_render_set_rend_param(struct gfx_rend_param const *param);
-static void null_render_draw_array(float const *verts, unsigned n_verts);
+static void null_render_set_vert_array(struct gfx_vert const *verts,
+                                       unsigned n_verts);
+static void null_render_draw_array(unsigned first_vert, unsigned n_verts);
 static void null_render_clear(float const bgcolor[4]);
 static void null_render_set_screen_dim(unsigned width, unsigned height);
 static void null_render_set_clip_range(float new_clip_min, float new_clip_max);
@@ -63,12 +65,7 @@ static void null_render_obj_read(struct gfx_obj *obj, void *out,
 
 struct rend_if null_rend_if;
 
-static void null_render_init(void) {
-    flip_screen = false;
-    bound_obj_handle = 0;
-    bound_obj_w = 0.0;
-    bound_obj_h = 0.0;
-
+void null_rend_if_init(void) {
     null_rend_if.init = null_render_init;
     null_rend_if.cleanup = null_render_cleanup;
     null_rend_if.update_tex = null_render_update_tex;
@@ -77,6 +74,7 @@ static void null_render_init(void) {
     null_rend_if.set_rend_param = null_render_set_rend_param;
     null_rend_if.set_screen_dim = null_render_set_screen_dim;
     null_rend_if.set_clip_range = null_render_set_clip_range;
+    null_rend_if.set_vert_array = null_render_set_vert_array;
     null_rend_if.draw_array = null_render_draw_array;
     null_rend_if.clear = null_render_clear;
     null_rend_if.begin_sort_mode = null_render_begin_sort_mode;
@@ -91,6 +89,13 @@ static void null_render_init(void) {
     null_rend_if.video_toggle_filter = null_render_toggle_filter;
 }
 
+static void null_render_init(void) {
+    flip_screen = false;
+    bound_obj_handle = 0;
+    bound_obj_w = 0.0;
+    bound_obj_h = 0.0;
+}
+
 static void null_render_cleanup(void) {
 }
 
@@ -106,7 +111,11 @@ static void null_render_set_blend_enable(bool enable) {
 static void null_render_set_rend_param(struct gfx_rend_param const *param) {
 }
 
-static void null_render_draw_array(float const *verts, unsigned n_verts) {
+static void null_render_set_vert_array(struct gfx_vert const *verts,
+                                       unsigned n_verts) {
+}
+
+static void null_render_draw_array(unsigned first_vert, unsigned n_verts) {
 }
 
 static void null_render_clear(float const bgcolor[4]) {
@@ -27,4 +27,7 @@
 
 extern struct rend_if null_rend_if;
 
+// fills in null_rend_if; call this before handing it to washdc_init
+void null_rend_if_init(void);
+
 #endif
@@ -21,6 +21,7 @@
  ******************************************************************************/
 
 #include <iostream>
+#include <stdlib.h>
 #include <string.h>
 
 #include "washdc/hostfile.h"
@@ -64,6 +65,7 @@ struct washdc_overlay_intf overlay_intf;
 static struct washdc_sound_intf snd_intf;
 static struct win_intf null_win_intf;
 
+struct washdc_instance *instance;
 struct washdc_gameconsole const *console;
 
 static void null_win_init(unsigned width, unsigned height);
@@ -97,12 +99,19 @@ int main(int argc, char **argv) {
     bool launch_wizard = false;
     char const *dc_bios_path = NULL, *dc_flash_path = NULL;
     bool write_to_flash_mem = false;
+    char const *path_bench = NULL;
+    unsigned bench_frames = 0, bench_seconds = 0;
+    char const *path_movie_record = NULL, *path_movie_play = NULL;
+    char const *path_frame_hash = NULL, *frame_hash_frames = NULL;
+    char const *path_difftest = NULL;
+    unsigned difftest_cases = 1000, difftest_seed = 1;
+    char const *path_wdci = NULL;
 
     create_cfg_dir();
     create_data_dir();
     create_screenshot_dir();
 
-    while ((opt = washdc_getopt(argc, argv, "w:b:f:c:s:m:d:u:g:htjxpnlv")) != -1) {
+    while ((opt = washdc_getopt(argc, argv, "w:b:f:c:s:m:d:u:g:B:N:R:P:H:K:D:S:Z:htjxpnlv")) != -1) {
         switch (opt) {
         case 'g':
             enable_debugger = true;
@@ -161,6 +170,56 @@ int main(int argc, char **argv) {
         case 'w':
             launch_wizard = true;
             break;
+        case 'B':
+            path_bench = washdc_optarg;
+            break;
+        case 'N':
+            {
+                char *endp;
+                unsigned long limit = strtoul(washdc_optarg, &endp, 0);
+                if (endp == washdc_optarg || limit == 0 ||
+                    (*endp && strcmp(endp, "s") != 0)) {
+                    fprintf(stderr, "ERROR: -N expects a number of frames, "
+                            "or a number of seconds followed by 's'\n");
+                    exit(1);
+                }
+                if (*endp)
+                    bench_seconds = limit;
+                else
+                    bench_frames = limit;
+            }
+            break;
+        case 'R':
+            path_movie_record = washdc_optarg;
+            break;
+        case 'P':
+            path_movie_play = washdc_optarg;
+            break;
+        case 'H':
+            path_frame_hash = washdc_optarg;
+            break;
+        case 'K':
+            frame_hash_frames = washdc_optarg;
+            break;
+        case 'D':
+            path_difftest = washdc_optarg;
+            break;
+        case 'S':
+            {
+                char *endp;
+                difftest_cases = strtoul(washdc_optarg, &endp, 0);
+                if (*endp == ',')
+                    difftest_seed = strtoul(endp + 1, &endp, 0);
+                if (endp == washdc_optarg || *endp || !difftest_cases) {
+                    fprintf(stderr, "ERROR: -S expects a number of cases, "
+                            "optionally followed by a comma and a seed\n");
+                    exit(1);
+                }
+            }
+            break;
+        case 'Z':
+            path_wdci = washdc_optarg;
+            break;
         default:
             print_usage(cmd);
             exit(0);
@@ -210,20 +269,29 @@ int main(int argc, char **argv) {
 
     settings.hostfile_api = &hostfile_api;
 
+    /*
+     * converting an image doesn't touch the emulated machine, so do it here
+     * before washdc_init goes looking for firmware.
+     */
+    if (path_wdci) {
+        if (!path_gdi) {
+            fprintf(stderr, "ERROR: -Z needs a .gdi image to convert (-m)\n");
+            exit(1);
+        }
+        if (washdc_write_wdci(&hostfile_api, path_gdi, path_wdci) != 0) {
+            fprintf(stderr, "ERROR: unable to convert %s\n", path_gdi);
+            exit(1);
+        }
+        printf("wrote %s\n", path_wdci);
+        exit(0);
+    }
+
     if (enable_debugger && enable_washdbg) {
         fprintf(stderr, "You can't enable WashDbg and GDB at the same time\n");
         exit(1);
     }
 
     if (enable_debugger || enable_washdbg) {
-        if (enable_jit || enable_native_jit) {
-            fprintf(stderr, "Debugger enabled - this overrides the jit "
-                    "compiler and sets WashingtonDC to interpreter mode\n");
-            enable_jit = false;
-            enable_native_jit = false;
-        }
-        enable_interpreter = true;
-
         if (washdc_have_debugger()) {
             settings.dbg_enable = true;
             settings.washdbg_enable = enable_washdbg;
@@ -321,6 +389,28 @@ int main(int argc, char **argv) {
     settings.enable_serial = enable_serial;
     settings.path_gdi = path_gdi;
 
+    if ((bench_frames || bench_seconds) && !path_bench) {
+        fprintf(stderr, "ERROR: -N doesn't do anything without -B\n");
+        exit(1);
+    }
+    settings.path_bench = path_bench;
+    settings.bench_frames = bench_frames;
+    settings.bench_seconds = bench_seconds;
+
+    if (path_movie_record && path_movie_play) {
+        fprintf(stderr, "ERROR: -R and -P can't be used together\n");
+        exit(1);
+    }
+    settings.path_movie_record = path_movie_record;
+    settings.path_movie_play = path_movie_play;
+
+    if (!path_frame_hash != !frame_hash_frames) {
+        fprintf(stderr, "ERROR: -H and -K must be used together\n");
+        exit(1);
+    }
+    settings.path_frame_hash = path_frame_hash;
+    settings.frame_hash_frames = frame_hash_frames;
+
     null_win_intf.init = null_win_init;
     null_win_intf.cleanup = null_win_cleanup;
     null_win_intf.check_events = null_win_check_events;
@@ -342,24 +432,37 @@ int main(int argc, char **argv) {
 
     settings.sndsrv = &snd_intf;
 
+    null_rend_if_init();
     settings.gfx_rend_if = &null_rend_if;
 
 #ifdef USE_LIBEVENT
     io::init();
 #endif
 
-    console = washdc_init(&settings);
-
-    washdc_run();
+    instance = washdc_init(&settings);
+    console = washdc_get_console(instance);
+
+    int exit_status = 0;
+    if (path_difftest) {
+        unsigned n_mismatch = washdc_sh4_difftest(instance, path_difftest,
+                                                  difftest_cases,
+                                                  difftest_seed);
+        printf("SH4 difftest: %u of %u cases didn't match (see %s)\n",
+               n_mismatch, difftest_cases, path_difftest);
+        if (n_mismatch)
+            exit_status = 1;
+    } else {
+        washdc_run(instance);
+    }
 
 #ifdef USE_LIBEVENT
     io::kick();
     io::cleanup();
 #endif
 
-    washdc_cleanup();
+    washdc_cleanup(instance);
 
-    exit(0);
+    exit(exit_status);
 
     return 0;
 }
@@ -382,13 +485,29 @@ static void print_usage(char const *cmd) {
             "\t-t\t\testablish serial server over TCP port 1998\n"
             "\t-h\t\tdisplay this message and exit\n"
             "\t-l\t\tdump logs to stdout\n"
-            "\t-m\t\tmount the given image in the GD-ROM drive\n"
+            "\t-m\t\tmount the given image (.gdi, .cdi or .wdci) in the GD-ROM "
+            "drive\n"
             "\t-n\t\tdon't inline memory reads/writes into the jit\n"
             "\t-p\t\tdisable the dynarec and enable the interpreter instead\n"
             "\t-j\t\tenable dynamic recompiler (as opposed to interpreter)\n"
             "\t-v\t\tenable verbose logging\n"
             "\t-x\t\tenable native x86_64 dynamic recompiler backend "
-            "(default)\n");
+            "(default)\n"
+            "\t-B <path>\twrite per-frame benchmark data to path (CSV if it "
+            "ends in .csv, JSON otherwise)\n"
+            "\t-N <n>[s]\tstop benchmarking after n frames (or n seconds)\n"
+            "\t-R <path>\trecord all input into an input movie\n"
+            "\t-P <path>\tplay back an input movie recorded with -R\n"
+            "\t-H <path>\twrite framebuffer hashes for the -K checkpoints "
+            "to path\n"
+            "\t-K <n,...>\thash the framebuffer at the end of these frames, "
+            "then exit\n"
+            "\t-D <path>\tinstead of running, compare the SH4 interpreter "
+            "against the jit backends and write a report to path\n"
+            "\t-S <n>[,seed]\tnumber of random cases for -D (default "
+            "1000,1)\n"
+            "\t-Z <path>\tinstead of running, convert the -m .gdi image "
+            "into a compressed .wdci image at path\n");
 }
 
 static void null_sound_init(void) {
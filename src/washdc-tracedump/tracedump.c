@@ -0,0 +1,531 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+/*
+ * washdc-tracedump: decode the binary execution traces written when
+ * WashingtonDC is built with -DENABLE_TRACE=On.
+ *
+ * By default every record gets printed as one line of text.  With -s it
+ * prints a summary instead: how many of each type of record there were, the
+ * most frequently-executed code blocks and the number of reads and writes to
+ * each MMIO region.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "zlib.h"
+
+#include "washdc/trace_fmt.h"
+#include "washdc_getopt.h"
+
+// for washdc_getopt
+char *washdc_optarg;
+int washdc_optind = 1, washdc_opterr, washdc_optopt;
+
+#define MAX_MAPS 256
+#define MAX_REGIONS 256
+#define MAX_THREADS 256
+
+#define IN_BUF_LEN (256 * 1024)
+
+#define N_HOT_BLOCKS 20
+
+struct region_info {
+    bool valid;
+    uint32_t first, last;
+    unsigned long long n_reads, n_writes;
+};
+
+struct map_info {
+    char name[256];
+    struct region_info regions[MAX_REGIONS];
+};
+
+struct block_count {
+    uint32_t hash;
+    unsigned long long count;
+};
+
+static struct trace_reader {
+    FILE *fp;
+    z_stream strm;
+    uint8_t in_buf[IN_BUF_LEN];
+    bool stream_end;
+} rd;
+
+static struct map_info maps[MAX_MAPS];
+
+static unsigned long long rec_counts[TRACE_REC_COUNT];
+static unsigned long long dma_bytes[TRACE_DMA_CHAN_COUNT];
+static uint64_t thread_stamp[MAX_THREADS];
+
+// open-addressed hash table of block counts; n_blocks_alloc is a power of two
+static struct block_count *blocks;
+static unsigned n_blocks, n_blocks_alloc;
+
+static bool summary_mode;
+
+static char const *rec_names[TRACE_REC_COUNT] = {
+    [TRACE_REC_TIME] = "TIME",
+    [TRACE_REC_MAP] = "MAP",
+    [TRACE_REC_REGION] = "REGION",
+    [TRACE_REC_BLOCK] = "BLOCK",
+    [TRACE_REC_MMIO_READ] = "MMIO_READ",
+    [TRACE_REC_MMIO_WRITE] = "MMIO_WRITE",
+    [TRACE_REC_IRQ] = "IRQ",
+    [TRACE_REC_DMA] = "DMA",
+    [TRACE_REC_TA] = "TA"
+};
+
+static char const *irq_src_names[TRACE_IRQ_SRC_COUNT] = {
+    [TRACE_IRQ_HOLLY_NRM] = "holly-nrm",
+    [TRACE_IRQ_HOLLY_EXT] = "holly-ext",
+    [TRACE_IRQ_SH4] = "sh4"
+};
+
+static char const *dma_chan_names[TRACE_DMA_CHAN_COUNT] = {
+    [TRACE_DMA_SH4_CH2] = "sh4-ch2",
+    [TRACE_DMA_GDROM] = "gdrom",
+    [TRACE_DMA_AICA] = "aica",
+    [TRACE_DMA_MAPLE] = "maple"
+};
+
+static char const *ta_evt_names[TRACE_TA_EVT_COUNT] = {
+    [TRACE_TA_LIST_END] = "list-end",
+    [TRACE_TA_STARTRENDER] = "startrender"
+};
+
+static void print_usage(char const *cmd) {
+    fprintf(stderr, "Usage: %s [-s] trace_file\n\n"
+            "OPTIONS:\n"
+            "-s\tprint a summary instead of every record\n"
+            "-h\tdisplay this message and exit\n", cmd);
+}
+
+static uint32_t get_u32(uint8_t const *inp) {
+    return inp[0] | (inp[1] << 8) | (inp[2] << 16) | ((uint32_t)inp[3] << 24);
+}
+
+static uint64_t get_u64(uint8_t const *inp) {
+    return get_u32(inp) | ((uint64_t)get_u32(inp + 4) << 32);
+}
+
+/*
+ * read exactly len bytes of decompressed data.  Returns 0 on success, or
+ * nonzero if the stream ended (or was corrupt) first.
+ */
+static int read_exact(void *outp, size_t len) {
+    rd.strm.next_out = (Bytef*)outp;
+    rd.strm.avail_out = len;
+
+    while (rd.strm.avail_out) {
+        if (rd.stream_end)
+            return -1;
+
+        if (!rd.strm.avail_in) {
+            size_t n_read = fread(rd.in_buf, 1, sizeof(rd.in_buf), rd.fp);
+            if (!n_read) {
+                fprintf(stderr, "trace file is truncated\n");
+                return -1;
+            }
+            rd.strm.next_in = rd.in_buf;
+            rd.strm.avail_in = n_read;
+        }
+
+        int err = inflate(&rd.strm, Z_NO_FLUSH);
+        if (err == Z_STREAM_END) {
+            rd.stream_end = true;
+        } else if (err != Z_OK) {
+            fprintf(stderr, "error decompressing trace file (%d)\n", err);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void count_block(uint32_t hash) {
+    if ((n_blocks + 1) * 2 > n_blocks_alloc) {
+        unsigned old_alloc = n_blocks_alloc;
+        struct block_count *old_blocks = blocks;
+
+        n_blocks_alloc = old_alloc ? old_alloc * 2 : 1024;
+        blocks = (struct block_count*)calloc(n_blocks_alloc, sizeof(*blocks));
+        if (!blocks) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+
+        unsigned idx;
+        for (idx = 0; idx < old_alloc; idx++) {
+            if (!old_blocks[idx].count)
+                continue;
+            unsigned slot = old_blocks[idx].hash & (n_blocks_alloc - 1);
+            while (blocks[slot].count)
+                slot = (slot + 1) & (n_blocks_alloc - 1);
+            blocks[slot] = old_blocks[idx];
+        }
+        free(old_blocks);
+    }
+
+    unsigned slot = hash & (n_blocks_alloc - 1);
+    while (blocks[slot].count && blocks[slot].hash != hash)
+        slot = (slot + 1) & (n_blocks_alloc - 1);
+    if (!blocks[slot].count) {
+        blocks[slot].hash = hash;
+        n_blocks++;
+    }
+    blocks[slot].count++;
+}
+
+static int cmp_block_count(void const *lhs, void const *rhs) {
+    unsigned long long lcount = ((struct block_count const*)lhs)->count;
+    unsigned long long rcount = ((struct block_count const*)rhs)->count;
+    if (lcount < rcount)
+        return 1;
+    else if (lcount > rcount)
+        return -1;
+    return 0;
+}
+
+static char const *map_name(unsigned map_no) {
+    return maps[map_no].name[0] ? maps[map_no].name : "<unknown>";
+}
+
+/*
+ * decode one chunk's worth of records.  Returns 0 on success or nonzero if
+ * the chunk is malformed.
+ */
+static int
+decode_chunk(unsigned thread_no, uint8_t const *dat, size_t n_bytes) {
+    uint8_t const *curs = dat, *end = dat + n_bytes;
+
+    while (curs < end) {
+        unsigned tp = *curs++;
+
+        uint64_t delta = 0;
+        unsigned shift = 0;
+        for (;;) {
+            if (curs >= end || shift >= 64)
+                return -1;
+            uint8_t byte = *curs++;
+            delta |= (uint64_t)(byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80))
+                break;
+        }
+        thread_stamp[thread_no] += delta;
+        uint64_t stamp = thread_stamp[thread_no];
+
+        if (tp >= TRACE_REC_COUNT) {
+            fprintf(stderr, "unknown record type %u\n", tp);
+            return -1;
+        }
+        rec_counts[tp]++;
+
+        size_t rem = end - curs;
+
+        if (!summary_mode && tp != TRACE_REC_TIME)
+            printf("[%u] %" PRIu64 " %s ", thread_no, stamp, rec_names[tp]);
+
+        switch (tp) {
+        case TRACE_REC_TIME:
+            if (rem < 8)
+                return -1;
+            thread_stamp[thread_no] = get_u64(curs);
+            curs += 8;
+            break;
+        case TRACE_REC_MAP:
+            {
+                if (rem < 2 || rem - 2 < curs[1])
+                    return -1;
+                unsigned map_no = curs[0];
+                unsigned name_len = curs[1];
+                memcpy(maps[map_no].name, curs + 2, name_len);
+                maps[map_no].name[name_len] = '\0';
+                curs += 2 + name_len;
+                if (!summary_mode)
+                    printf("%u \"%s\"\n", map_no, maps[map_no].name);
+            }
+            break;
+        case TRACE_REC_REGION:
+            {
+                if (rem < 10)
+                    return -1;
+                struct region_info *reg = maps[curs[0]].regions + curs[1];
+                reg->valid = true;
+                reg->first = get_u32(curs + 2);
+                reg->last = get_u32(curs + 6);
+                if (!summary_mode) {
+                    printf("%s %u %08x-%08x\n", map_name(curs[0]), curs[1],
+                           (unsigned)reg->first, (unsigned)reg->last);
+                }
+                curs += 10;
+            }
+            break;
+        case TRACE_REC_BLOCK:
+            if (rem < 4)
+                return -1;
+            if (summary_mode)
+                count_block(get_u32(curs));
+            else
+                printf("%08x\n", (unsigned)get_u32(curs));
+            curs += 4;
+            break;
+        case TRACE_REC_MMIO_READ:
+        case TRACE_REC_MMIO_WRITE:
+            {
+                if (rem < 7 || rem - 7 < curs[2] || curs[2] > 8)
+                    return -1;
+                unsigned map_no = curs[0], region_no = curs[1], len = curs[2];
+                uint32_t addr = get_u32(curs + 3);
+                uint64_t val = 0;
+                unsigned idx;
+                for (idx = 0; idx < len; idx++)
+                    val |= (uint64_t)curs[7 + idx] << (idx * 8);
+                curs += 7 + len;
+
+                struct region_info *reg = maps[map_no].regions + region_no;
+                if (tp == TRACE_REC_MMIO_READ)
+                    reg->n_reads++;
+                else
+                    reg->n_writes++;
+
+                if (!summary_mode) {
+                    printf("%s %u %08x %u 0x%0*" PRIx64 "\n",
+                           map_name(map_no), region_no, (unsigned)addr, len,
+                           (int)len * 2, val);
+                }
+            }
+            break;
+        case TRACE_REC_IRQ:
+            if (rem < 5)
+                return -1;
+            if (!summary_mode) {
+                printf("%s 0x%x\n", curs[0] < TRACE_IRQ_SRC_COUNT ?
+                       irq_src_names[curs[0]] : "<unknown>",
+                       (unsigned)get_u32(curs + 1));
+            }
+            curs += 5;
+            break;
+        case TRACE_REC_DMA:
+            if (rem < 13)
+                return -1;
+            if (curs[0] < TRACE_DMA_CHAN_COUNT)
+                dma_bytes[curs[0]] += get_u32(curs + 9);
+            if (!summary_mode) {
+                printf("%s %08x -> %08x %u bytes\n",
+                       curs[0] < TRACE_DMA_CHAN_COUNT ?
+                       dma_chan_names[curs[0]] : "<unknown>",
+                       (unsigned)get_u32(curs + 1),
+                       (unsigned)get_u32(curs + 5),
+                       (unsigned)get_u32(curs + 9));
+            }
+            curs += 13;
+            break;
+        case TRACE_REC_TA:
+            if (rem < 5)
+                return -1;
+            if (!summary_mode) {
+                printf("%s 0x%x\n", curs[0] < TRACE_TA_EVT_COUNT ?
+                       ta_evt_names[curs[0]] : "<unknown>",
+                       (unsigned)get_u32(curs + 1));
+            }
+            curs += 5;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static void print_summary(void) {
+    unsigned idx;
+
+    printf("record counts:\n");
+    for (idx = 0; idx < TRACE_REC_COUNT; idx++)
+        printf("\t%-12s %llu\n", rec_names[idx], rec_counts[idx]);
+
+    printf("\nDMA bytes per channel:\n");
+    for (idx = 0; idx < TRACE_DMA_CHAN_COUNT; idx++)
+        printf("\t%-12s %llu\n", dma_chan_names[idx], dma_bytes[idx]);
+
+    if (n_blocks) {
+        struct block_count *sorted =
+            (struct block_count*)malloc(n_blocks * sizeof(*sorted));
+        if (!sorted) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        unsigned n_sorted = 0;
+        for (idx = 0; idx < n_blocks_alloc; idx++)
+            if (blocks[idx].count)
+                sorted[n_sorted++] = blocks[idx];
+        qsort(sorted, n_sorted, sizeof(*sorted), cmp_block_count);
+
+        printf("\n%u distinct code blocks; the most frequent were:\n",
+               n_sorted);
+        for (idx = 0; idx < n_sorted && idx < N_HOT_BLOCKS; idx++) {
+            printf("\t%08x %llu\n", (unsigned)sorted[idx].hash,
+                   sorted[idx].count);
+        }
+        free(sorted);
+    }
+
+    printf("\nMMIO accesses per region:\n");
+    unsigned map_no, region_no;
+    for (map_no = 0; map_no < MAX_MAPS; map_no++) {
+        for (region_no = 0; region_no < MAX_REGIONS; region_no++) {
+            struct region_info const *reg = maps[map_no].regions + region_no;
+            if (!reg->n_reads && !reg->n_writes)
+                continue;
+            if (reg->valid) {
+                printf("\t%s %08x-%08x: %llu reads, %llu writes\n",
+                       map_name(map_no), (unsigned)reg->first,
+                       (unsigned)reg->last, reg->n_reads, reg->n_writes);
+            } else {
+                printf("\t%s region %u: %llu reads, %llu writes\n",
+                       map_name(map_no), region_no, reg->n_reads,
+                       reg->n_writes);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    char const *cmd = argv[0];
+
+    while ((opt = washdc_getopt(argc, argv, "sh")) != -1) {
+        switch (opt) {
+        case 's':
+            summary_mode = true;
+            break;
+        case 'h':
+            print_usage(cmd);
+            exit(0);
+        default:
+            print_usage(cmd);
+            exit(1);
+        }
+    }
+
+    argv += washdc_optind;
+    argc -= washdc_optind;
+
+    if (argc != 1) {
+        print_usage(cmd);
+        exit(1);
+    }
+
+    rd.fp = fopen(argv[0], "rb");
+    if (!rd.fp) {
+        fprintf(stderr, "unable to open %s\n", argv[0]);
+        exit(1);
+    }
+
+    uint8_t hdr[TRACE_FILE_HDR_LEN];
+    if (fread(hdr, 1, sizeof(hdr), rd.fp) != sizeof(hdr) ||
+        memcmp(hdr, TRACE_FILE_MAGIC, TRACE_FILE_MAGIC_LEN) != 0) {
+        fprintf(stderr, "%s is not a WashingtonDC trace file\n", argv[0]);
+        exit(1);
+    }
+
+    unsigned version = get_u32(hdr + TRACE_FILE_MAGIC_LEN);
+    if (version != TRACE_FILE_VERSION) {
+        fprintf(stderr, "unsupported trace file version %u\n", version);
+        exit(1);
+    }
+
+    uint64_t ticks_per_sec = get_u64(hdr + 16);
+    if (!summary_mode)
+        printf("%" PRIu64 " ticks per second\n", ticks_per_sec);
+
+    if (inflateInit(&rd.strm) != Z_OK) {
+        fprintf(stderr, "unable to initialize zlib\n");
+        exit(1);
+    }
+
+    uint8_t *chunk = NULL;
+    size_t chunk_alloc = 0;
+    unsigned long long n_chunks = 0;
+    int ret_code = 0;
+
+    for (;;) {
+        uint8_t chunk_hdr[TRACE_CHUNK_HDR_LEN];
+        if (read_exact(chunk_hdr, sizeof(chunk_hdr)) != 0) {
+            // a stream that ends cleanly between chunks is fine
+            if (!(rd.stream_end && rd.strm.avail_out == sizeof(chunk_hdr)))
+                ret_code = 1;
+            break;
+        }
+
+        unsigned thread_no = get_u32(chunk_hdr);
+        size_t n_bytes = get_u32(chunk_hdr + 4);
+        if (thread_no >= MAX_THREADS) {
+            fprintf(stderr, "bad thread number %u\n", thread_no);
+            ret_code = 1;
+            break;
+        }
+
+        if (n_bytes > chunk_alloc) {
+            free(chunk);
+            chunk = (uint8_t*)malloc(n_bytes);
+            if (!chunk) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+            chunk_alloc = n_bytes;
+        }
+
+        if (read_exact(chunk, n_bytes) != 0) {
+            ret_code = 1;
+            break;
+        }
+
+        if (decode_chunk(thread_no, chunk, n_bytes) != 0) {
+            fprintf(stderr, "chunk %llu is malformed\n", n_chunks);
+            ret_code = 1;
+            break;
+        }
+        n_chunks++;
+    }
+
+    if (summary_mode) {
+        printf("%llu chunks, %" PRIu64 " ticks per second\n\n",
+               n_chunks, ticks_per_sec);
+        print_summary();
+    }
+
+    free(chunk);
+    free(blocks);
+    inflateEnd(&rd.strm);
+    fclose(rd.fp);
+
+    return ret_code;
+}
@@ -92,11 +92,14 @@ static void print_usage(char const *cmd) {
             "\t-j\t\tenable dynamic recompiler (as opposed to interpreter)\n"
             "\t-v\t\tenable verbose logging\n"
             "\t-x\t\tenable native x86_64 dynamic recompiler backend "
-            "(default)\n");
+            "(default)\n"
+            "\t-R <path>\trecord all input into an input movie\n"
+            "\t-P <path>\tplay back an input movie recorded with -R\n");
 }
 
 struct washdc_overlay_intf overlay_intf;
 
+struct washdc_instance *instance;
 struct washdc_gameconsole const *console;
 
 static void wizard(path_string console_name, path_string dc_bios_path,
@@ -193,12 +196,13 @@ int main(int argc, char **argv) {
     bool launch_wizard = false;
     char const *dc_bios_path = NULL, *dc_flash_path = NULL;
     bool write_to_flash_mem = false;
+    char const *path_movie_record = NULL, *path_movie_play = NULL;
 
     create_cfg_dir();
     create_data_dir();
     create_screenshot_dir();
 
-    while ((opt = washdc_getopt(argc, argv, "w:b:f:c:s:m:d:u:g:htjxpnlv")) != -1) {
+    while ((opt = washdc_getopt(argc, argv, "w:b:f:c:s:m:d:u:g:R:P:htjxpnlv")) != -1) {
         switch (opt) {
         case 'g':
             enable_debugger = true;
@@ -257,6 +261,12 @@ int main(int argc, char **argv) {
         case 'w':
             launch_wizard = true;
             break;
+        case 'R':
+            path_movie_record = washdc_optarg;
+            break;
+        case 'P':
+            path_movie_play = washdc_optarg;
+            break;
         default:
             print_usage(cmd);
             exit(0);
@@ -313,14 +323,6 @@ int main(int argc, char **argv) {
     }
 
     if (enable_debugger || enable_washdbg) {
-        if (enable_jit || enable_native_jit) {
-            fprintf(stderr, "Debugger enabled - this overrides the jit "
-                    "compiler and sets WashingtonDC to interpreter mode\n");
-            enable_jit = false;
-            enable_native_jit = false;
-        }
-        enable_interpreter = true;
-
         if (washdc_have_debugger()) {
             settings.dbg_enable = true;
             settings.washdbg_enable = enable_washdbg;
@@ -417,6 +419,14 @@ int main(int argc, char **argv) {
         settings.path_rtc = console_get_rtc_path(console_name);
     settings.enable_serial = enable_serial;
     settings.path_gdi = path_gdi;
+
+    if (path_movie_record && path_movie_play) {
+        fprintf(stderr, "ERROR: -R and -P can't be used together\n");
+        exit(1);
+    }
+    settings.path_movie_record = path_movie_record;
+    settings.path_movie_play = path_movie_play;
+
     settings.win_intf = get_win_intf_glfw();
 
 #ifdef ENABLE_TCP_SERIAL
@@ -441,11 +451,12 @@ int main(int argc, char **argv) {
     io::init();
 #endif
 
-    console = washdc_init(&settings);
+    instance = washdc_init(&settings);
+    console = washdc_get_console(instance);
 
     overlay::init(enable_debugger || enable_washdbg);
 
-    washdc_run();
+    washdc_run(instance);
 
     overlay::cleanup();
 
@@ -454,19 +465,19 @@ int main(int argc, char **argv) {
     io::cleanup();
 #endif
 
-    washdc_cleanup();
+    washdc_cleanup(instance);
 
     exit(0);
 }
 
 void do_resume(void) {
-    washdc_resume();
+    washdc_resume(instance);
 }
 
 void do_run_one_frame(void) {
-    washdc_run_one_frame();
+    washdc_run_one_frame(instance);
 }
 
 void do_pause(void) {
-    washdc_pause();
+    washdc_pause(instance);
 }
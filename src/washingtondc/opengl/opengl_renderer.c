@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 
 #define GL3_PROTOTYPES 1
 #include <GL/glew.h>
@@ -57,6 +58,14 @@ static GLint trans_mat_slot = -1;
 
 static GLuint vbo, vao;
 
+/*
+ * the current frame's vertex array.  This gets uploaded to vbo in its
+ * entirety by opengl_renderer_set_vert_array, and then draw_array renders
+ * ranges out of it.
+ */
+static struct gfx_vert const *vert_array;
+static unsigned vert_array_len;
+
 struct obj_tex_meta {
     unsigned width, height;
 
@@ -132,7 +141,7 @@ static const GLenum depth_funcs[PVR2_DEPTH_FUNC_COUNT] = {
 #define OIT_MAX_GROUPS (4*1024)
 
 struct oit_group {
-    float const *verts;
+    unsigned first_vert;
     unsigned n_verts;
 
     float avg_depth;
@@ -162,7 +171,9 @@ static void opengl_renderer_update_tex(unsigned tex_obj);
 static void opengl_renderer_release_tex(unsigned tex_obj);
 static void opengl_renderer_set_blend_enable(bool enable);
 static void opengl_renderer_set_rend_param(struct gfx_rend_param const *param);
-static void opengl_renderer_draw_array(float const *verts, unsigned n_verts);
+static void opengl_renderer_set_vert_array(struct gfx_vert const *verts,
+                                           unsigned n_verts);
+static void opengl_renderer_draw_array(unsigned first_vert, unsigned n_verts);
 static void opengl_renderer_clear(float const bgcolor[4]);
 static void opengl_renderer_set_screen_dim(unsigned width, unsigned height);
 static void opengl_renderer_set_clip_range(float new_clip_min,
@@ -177,6 +188,7 @@ struct rend_if const opengl_rend_if = {
     .release_tex = opengl_renderer_release_tex,
     .set_blend_enable = opengl_renderer_set_blend_enable,
     .set_rend_param = opengl_renderer_set_rend_param,
+    .set_vert_array = opengl_renderer_set_vert_array,
     .draw_array = opengl_renderer_draw_array,
     .clear = opengl_renderer_clear,
     .set_screen_dim = opengl_renderer_set_screen_dim,
@@ -468,6 +480,7 @@ static void opengl_render_init(void) {
 }
 
 static void opengl_render_cleanup(void) {
+    opengl_target_cleanup();
     glDeleteTextures(GFX_OBJ_COUNT, obj_tex_array);
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
@@ -481,27 +494,21 @@ static void opengl_render_cleanup(void) {
 
 static DEF_ERROR_INT_ATTR(max_length);
 
-static void opengl_renderer_update_tex(unsigned tex_obj) {
-    struct gfx_tex const *tex = gfx_tex_cache_get(tex_obj);
-    struct gfx_obj *obj = gfx_obj_get(tex->obj_handle);
-
-    // nothing to do here
-    if (obj->state & GFX_OBJ_STATE_TEX)
-        return;
-
-    gfx_obj_alloc(obj);
+static unsigned tex_fmt_pixel_size(enum gfx_tex_fmt gfx_fmt) {
+    return gfx_fmt == GFX_TEX_FMT_ARGB_8888 ? 4 : 2;
+}
 
-    void const *tex_dat = obj->dat;
+/*
+ * upload one level of tex into the currently-bound texture object.  tex_dat
+ * points to the first pixel of that level.
+ */
+static void
+opengl_renderer_upload_tex_level(struct gfx_tex const *tex, GLint level,
+                                 unsigned tex_w, unsigned tex_h,
+                                 void const *tex_dat) {
     GLenum format = tex->tex_fmt == GFX_TEX_FMT_RGB_565 ?
         GL_RGB : GL_RGBA;
 
-    unsigned tex_w = tex->width;
-    unsigned tex_h = tex->height;
-
-    glBindTexture(GL_TEXTURE_2D, obj_tex_array[tex->obj_handle]);
-    // TODO: maybe don't always set this to 1
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
     /*
      * TODO: ideally I wouldn't need to copy ARGB_4444 and ARGB_1555 into a
      * separate buffer to do the pixel conversion.  The reason I do this is that
@@ -510,50 +517,26 @@ static void opengl_renderer_update_tex(unsigned tex_obj) {
      * change things to remove this mostly-unnecessary buffering...
      */
     if (tex->tex_fmt == GFX_TEX_FMT_ARGB_4444) {
-        size_t n_bytes = tex->width * tex->height * sizeof(uint16_t);
-#ifdef INVARIANTS
-        if (n_bytes > obj->dat_len) {
-            error_set_length(n_bytes);
-            error_set_max_length(obj->dat_len);
-            RAISE_ERROR(ERROR_OVERFLOW);
-        }
-#endif
+        size_t n_bytes = tex_w * tex_h * sizeof(uint16_t);
         uint16_t *tex_dat_conv = (uint16_t*)malloc(n_bytes);
         if (!tex_dat_conv)
             RAISE_ERROR(ERROR_FAILED_ALLOC);
         memcpy(tex_dat_conv, tex_dat, n_bytes);
         render_conv_argb_4444(tex_dat_conv, tex_w * tex_h);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_w, tex_h, 0,
+        glTexImage2D(GL_TEXTURE_2D, level, format, tex_w, tex_h, 0,
                      format, tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_4444),
                      tex_dat_conv);
-        opengl_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        opengl_renderer_tex_set_format(tex->obj_handle, format);
-        opengl_renderer_tex_set_dat_type(tex->obj_handle,
-                                         tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_4444));
-        opengl_renderer_tex_set_dirty(tex->obj_handle, false);
         free(tex_dat_conv);
     } else if (tex->tex_fmt == GFX_TEX_FMT_ARGB_1555) {
-        size_t n_bytes = tex->width * tex->height * sizeof(uint16_t);
-#ifdef INVARIANTS
-        if (n_bytes > obj->dat_len) {
-            error_set_length(n_bytes);
-            error_set_max_length(obj->dat_len);
-            RAISE_ERROR(ERROR_OVERFLOW);
-        }
-#endif
+        size_t n_bytes = tex_w * tex_h * sizeof(uint16_t);
         uint16_t *tex_dat_conv = (uint16_t*)malloc(n_bytes);
         if (!tex_dat_conv)
             RAISE_ERROR(ERROR_FAILED_ALLOC);
         memcpy(tex_dat_conv, tex_dat, n_bytes);
         render_conv_argb_1555(tex_dat_conv, tex_w * tex_h);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_w, tex_h, 0,
+        glTexImage2D(GL_TEXTURE_2D, level, format, tex_w, tex_h, 0,
                      format, tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_1555),
                      tex_dat_conv);
-        opengl_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        opengl_renderer_tex_set_format(tex->obj_handle, format);
-        opengl_renderer_tex_set_dat_type(tex->obj_handle,
-                                         tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_1555));
-        opengl_renderer_tex_set_dirty(tex->obj_handle, false);
         free(tex_dat_conv);
     } else if (tex->tex_fmt == GFX_TEX_FMT_YUV_422) {
         uint8_t *tmp_dat =
@@ -561,22 +544,84 @@ static void opengl_renderer_update_tex(unsigned tex_obj) {
         if (!tmp_dat)
             RAISE_ERROR(ERROR_FAILED_ALLOC);
         washdc_conv_yuv422_rgb888(tmp_dat, tex_dat, tex_w, tex_h);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tex_w, tex_h, 0,
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, tex_w, tex_h, 0,
                      GL_RGB, GL_UNSIGNED_BYTE, tmp_dat);
-        opengl_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        opengl_renderer_tex_set_format(tex->obj_handle, GL_RGB);
-        opengl_renderer_tex_set_dat_type(tex->obj_handle, GL_UNSIGNED_BYTE);
-        opengl_renderer_tex_set_dirty(tex->obj_handle, false);
         free(tmp_dat);
     } else {
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_w, tex_h, 0,
+        glTexImage2D(GL_TEXTURE_2D, level, format, tex_w, tex_h, 0,
                      format, tex_fmt_to_data_type(tex->tex_fmt), tex_dat);
-        opengl_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        opengl_renderer_tex_set_format(tex->obj_handle, format);
-        opengl_renderer_tex_set_dat_type(tex->obj_handle,
-                                         tex_fmt_to_data_type(tex->tex_fmt));
-        opengl_renderer_tex_set_dirty(tex->obj_handle, false);
     }
+}
+
+static void opengl_renderer_update_tex(unsigned tex_obj) {
+    struct gfx_tex const *tex = gfx_tex_cache_get(tex_obj);
+    struct gfx_obj *obj = gfx_obj_get(tex->obj_handle);
+
+    // nothing to do here
+    if (obj->state & GFX_OBJ_STATE_TEX)
+        return;
+
+    gfx_obj_alloc(obj);
+
+    uint8_t const *tex_dat = (uint8_t const*)obj->dat;
+    unsigned tex_w = tex->width;
+    unsigned tex_h = tex->height;
+    unsigned px_sz = tex_fmt_pixel_size(tex->tex_fmt);
+
+    /*
+     * mipmapped textures are always square, and their levels are packed
+     * together in the gfx_obj from largest to smallest.
+     */
+    GLint n_levels = 1;
+    size_t n_bytes = tex_w * tex_h * px_sz;
+    if (tex->mipmap) {
+        unsigned side;
+        n_bytes = 0;
+        for (side = tex_w, n_levels = 0; side; side >>= 1, n_levels++)
+            n_bytes += side * side * px_sz;
+    }
+
+#ifdef INVARIANTS
+    if (n_bytes > obj->dat_len) {
+        error_set_length(n_bytes);
+        error_set_max_length(obj->dat_len);
+        RAISE_ERROR(ERROR_OVERFLOW);
+    }
+#endif
+
+    glBindTexture(GL_TEXTURE_2D, obj_tex_array[tex->obj_handle]);
+    // TODO: maybe don't always set this to 1
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    GLint level;
+    unsigned level_w = tex_w, level_h = tex_h;
+    for (level = 0; level < n_levels; level++) {
+        opengl_renderer_upload_tex_level(tex, level, level_w, level_h, tex_dat);
+        tex_dat += level_w * level_h * px_sz;
+        level_w >>= 1;
+        level_h >>= 1;
+    }
+
+    /*
+     * GL_TEXTURE_MAX_LEVEL needs to be set even when there are no mipmaps
+     * because this object may have previously held a mipmapped texture.
+     */
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, n_levels - 1);
+
+    GLenum format, dat_type;
+    if (tex->tex_fmt == GFX_TEX_FMT_YUV_422) {
+        format = GL_RGB;
+        dat_type = GL_UNSIGNED_BYTE;
+    } else {
+        format = tex->tex_fmt == GFX_TEX_FMT_RGB_565 ? GL_RGB : GL_RGBA;
+        dat_type = tex_fmt_to_data_type(tex->tex_fmt);
+    }
+    opengl_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
+    opengl_renderer_tex_set_format(tex->obj_handle, format);
+    opengl_renderer_tex_set_dat_type(tex->obj_handle, dat_type);
+    opengl_renderer_tex_set_dirty(tex->obj_handle, false);
+
     obj->state |= GFX_OBJ_STATE_TEX;
     glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -659,8 +704,10 @@ static void opengl_renderer_set_rend_param(struct gfx_rend_param const *param) {
             break;
         }
 
+        bool mipmap = false;
         if (gfx_tex_cache_get(param->tex_idx)->valid) {
             int obj_handle = gfx_tex_cache_get(param->tex_idx)->obj_handle;
+            mipmap = gfx_tex_cache_get(param->tex_idx)->mipmap;
             glBindTexture(GL_TEXTURE_2D, obj_tex_array[obj_handle]);
         } else {
             fprintf(stderr, "WARNING: attempt to bind invalid texture %u\n",
@@ -671,15 +718,24 @@ static void opengl_renderer_set_rend_param(struct gfx_rend_param const *param) {
         switch (param->tex_filter) {
         case TEX_FILTER_TRILINEAR_A:
         case TEX_FILTER_TRILINEAR_B:
+            if (mipmap) {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                                GL_LINEAR_MIPMAP_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+                                GL_LINEAR);
+                break;
+            }
             fprintf(stderr,
                     "WARNING: trilinear filtering is not yet supported\n");
             // intentional fall-through
         case TEX_FILTER_NEAREST:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                            mipmap ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
             break;
         case TEX_FILTER_BILINEAR:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                            mipmap ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
             break;
         }
@@ -745,23 +801,62 @@ static void opengl_renderer_set_rend_param(struct gfx_rend_param const *param) {
     tex_enable = param->tex_enable;
 }
 
-static void opengl_renderer_draw_array(float const *verts, unsigned n_verts) {
+static void opengl_renderer_set_vert_array(struct gfx_vert const *verts,
+                                           unsigned n_verts) {
+    vert_array = verts;
+    vert_array_len = n_verts;
+
+    if (!n_verts)
+        return;
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(struct gfx_vert) * n_verts,
+                 verts, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(POSITION_SLOT);
+    glEnableVertexAttribArray(BASE_COLOR_SLOT);
+    glEnableVertexAttribArray(OFFS_COLOR_SLOT);
+    glVertexAttribPointer(POSITION_SLOT, 3, GL_FLOAT, GL_FALSE,
+                          sizeof(struct gfx_vert),
+                          (GLvoid*)offsetof(struct gfx_vert, pos));
+    glVertexAttribPointer(BASE_COLOR_SLOT, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(struct gfx_vert),
+                          (GLvoid*)offsetof(struct gfx_vert, base_color));
+    glVertexAttribPointer(OFFS_COLOR_SLOT, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(struct gfx_vert),
+                          (GLvoid*)offsetof(struct gfx_vert, offs_color));
+    glVertexAttribPointer(TEX_COORD_SLOT, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(struct gfx_vert),
+                          (GLvoid*)offsetof(struct gfx_vert, tex_coord));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+static void opengl_renderer_draw_array(unsigned first_vert, unsigned n_verts) {
     if (!n_verts)
         return;
 
+    if (first_vert > vert_array_len || n_verts > vert_array_len - first_vert) {
+        fprintf(stderr, "OPENGL GFX: vertex range %u-%u is out of bounds "
+                "(%u verts)\n", first_vert, first_vert + n_verts,
+                vert_array_len);
+        return;
+    }
+
     if (oit_state.enabled) {
         oit_state.tri_count += n_verts / 3;
 
         if (oit_state.group_count < OIT_MAX_GROUPS) {
             struct oit_group *grp = oit_state.groups + oit_state.group_count++;
             grp->rend_param = oit_state.cur_rend_param;
-            grp->verts = verts;
+            grp->first_vert = first_vert;
             grp->n_verts = n_verts;
 
             float avg_depth = 0.0f;
+            struct gfx_vert const *verts = vert_array + first_vert;
             unsigned vert_no;
             for (vert_no = 0; vert_no < n_verts; vert_no++)
-                avg_depth += verts[vert_no * GFX_VERT_LEN + 2];
+                avg_depth += verts[vert_no].pos[2];
             avg_depth /= n_verts;
 
             grp->avg_depth = avg_depth;
@@ -791,30 +886,11 @@ static void opengl_renderer_draw_array(float const *verts, unsigned n_verts) {
 
     // now draw the geometry itself
     glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 sizeof(float) * n_verts * GFX_VERT_LEN,
-                 verts, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(POSITION_SLOT);
-    glEnableVertexAttribArray(BASE_COLOR_SLOT);
-    glEnableVertexAttribArray(OFFS_COLOR_SLOT);
-    glVertexAttribPointer(POSITION_SLOT, 3, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_POS_OFFSET * sizeof(float)));
-    glVertexAttribPointer(BASE_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_BASE_COLOR_OFFSET * sizeof(float)));
-    glVertexAttribPointer(OFFS_COLOR_SLOT, 4, GL_FLOAT, GL_FALSE,
-                          GFX_VERT_LEN * sizeof(float),
-                          (GLvoid*)(GFX_VERT_OFFS_COLOR_OFFSET * sizeof(float)));
-    if (tex_enable) {
+    if (tex_enable)
         glEnableVertexAttribArray(TEX_COORD_SLOT);
-        glVertexAttribPointer(TEX_COORD_SLOT, 2, GL_FLOAT, GL_FALSE,
-                              GFX_VERT_LEN * sizeof(float),
-                              (GLvoid*)(GFX_VERT_TEX_COORD_OFFSET * sizeof(float)));
-    }
-    glDrawArrays(GL_TRIANGLES, 0, n_verts);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    else
+        glDisableVertexAttribArray(TEX_COORD_SLOT);
+    glDrawArrays(GL_TRIANGLES, first_vert, n_verts);
     glBindVertexArray(0);
 
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -957,7 +1033,7 @@ static void opengl_renderer_end_sort_mode(void) {
         for (src_idx = 0; src_idx < grp_cnt; src_idx++) {
             struct oit_group *grp_src = oit_state.groups + src_idx;
             opengl_renderer_set_rend_param(&grp_src->rend_param);
-            opengl_renderer_draw_array(grp_src->verts, grp_src->n_verts);
+            opengl_renderer_draw_array(grp_src->first_vert, grp_src->n_verts);
         }
     }
 }
@@ -43,9 +43,25 @@ static GLuint depth_buf_tex;
 static GLenum draw_buffer = GL_COLOR_ATTACHMENT0;
 static unsigned fbo_width, fbo_height;
 
+/*
+ * Render targets are read back asynchronously.  When rendering to a target
+ * ends, a glReadPixels into a pixel-buffer object gets queued up, and it only
+ * gets mapped into client memory when the emulator actually asks for the
+ * pixels.  By then the transfer has usually already finished, so the
+ * emulation thread doesn't have to wait on the GPU.
+ */
+struct target_readback {
+    GLuint pbo;
+    size_t n_bytes;
+    bool valid;
+};
+
+static struct target_readback readback[GFX_OBJ_COUNT];
+
 static void opengl_target_obj_read(struct gfx_obj  *obj, void *out,
                                    size_t n_bytes);
 static void opengl_target_grab_pixels(int handle, void *out, GLsizei buf_size);
+static void opengl_target_begin_readback(int obj_handle);
 
 void opengl_target_init(void) {
     fbo_width = 0;
@@ -53,6 +69,20 @@ void opengl_target_init(void) {
 
     glGenFramebuffers(1, &fbo);
     glGenTextures(1, &depth_buf_tex);
+
+    memset(readback, 0, sizeof(readback));
+}
+
+void opengl_target_cleanup(void) {
+    unsigned idx;
+    for (idx = 0; idx < GFX_OBJ_COUNT; idx++) {
+        if (readback[idx].pbo)
+            glDeleteBuffers(1, &readback[idx].pbo);
+    }
+    memset(readback, 0, sizeof(readback));
+
+    glDeleteTextures(1, &depth_buf_tex);
+    glDeleteFramebuffers(1, &fbo);
 }
 
 void opengl_target_begin(unsigned width, unsigned height, int tgt_handle) {
@@ -63,6 +93,9 @@ void opengl_target_begin(unsigned width, unsigned height, int tgt_handle) {
 
     glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
+    // whatever was read back previously is about to become stale
+    readback[tgt_handle].valid = false;
+
     GLuint color_buf_tex = opengl_renderer_tex(tgt_handle);
 
     if (opengl_renderer_tex_get_dirty(tgt_handle) ||
@@ -138,6 +171,8 @@ void opengl_target_end(int tgt_handle) {
         return;
     }
 
+    opengl_target_begin_readback(tgt_handle);
+
     static GLenum back_buffer = GL_BACK;
     glDrawBuffers(1, &back_buffer);
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -159,12 +194,48 @@ static void opengl_target_grab_pixels(int obj_handle, void *out,
         RAISE_ERROR(ERROR_MEM_OUT_OF_BOUNDS);
     }
 
+    struct target_readback *rb = readback + obj_handle;
+    if (rb->valid && rb->n_bytes == length_expect) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+        void const *pix = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (pix) {
+            memcpy(out, pix, rb->n_bytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            return;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
     GLuint color_buf_tex = opengl_renderer_tex(obj_handle);
     glBindTexture(GL_TEXTURE_2D, color_buf_tex);
     glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, out);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+/*
+ * queue up a transfer from the render target into its PBO.  This must be
+ * called while the target is still bound to the FBO.
+ */
+static void opengl_target_begin_readback(int obj_handle) {
+    struct target_readback *rb = readback + obj_handle;
+    size_t n_bytes = fbo_width * fbo_height * 4 * sizeof(uint8_t);
+
+    if (!rb->pbo)
+        glGenBuffers(1, &rb->pbo);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+    if (rb->n_bytes != n_bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, n_bytes, NULL, GL_STREAM_READ);
+        rb->n_bytes = n_bytes;
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, fbo_width, fbo_height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    rb->valid = true;
+}
+
 void opengl_target_bind_obj(int obj_handle) {
 #ifdef INVARIANTS
     struct gfx_obj *obj = gfx_obj_get(obj_handle);
@@ -2,7 +2,7 @@
  *
  *
  *    WashingtonDC Dreamcast Emulator
- *    Copyright (C) 2018, 2019 snickerbockers
+ *    Copyright (C) 2018-2020 snickerbockers
  *
  *    This program is free software: you can redistribute it and/or modify
  *    it under the terms of the GNU General Public License as published by
@@ -23,15 +23,17 @@
 #include "i_hate_windows.h"
 
 #include <cmath>
-#include <mutex>
-#include <condition_variable>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 
 #include <portaudio.h>
 
 #include "washdc/error.h"
 #include "sound.hpp"
 #include "washdc/config_file.h"
-#include "threading.h"
 #include "intmath.h"
 
 namespace sound {
@@ -47,27 +49,67 @@ static int snd_cb(const void *input, void *output,
                   PaStreamCallbackFlags flags,
                   void *argp);
 
+struct frame {
+    washdc_sample_type left, right;
+};
 
-static washdc_mutex buffer_lock;
-static washdc_cvar samples_submitted;
+/*
+ * Single-producer/single-consumer ring of stereo frames.  The emulation
+ * thread is the only producer and the PortAudio callback is the only
+ * consumer, so neither side ever has to take a lock.  The indices are
+ * free-running and only get masked when they're used to index into the
+ * ring, so the ring is empty when they're equal.
+ */
+static const unsigned RING_LEN = 8192; // must be a power of two
+static struct frame ring[RING_LEN];
+static std::atomic<unsigned> ring_read_idx, ring_write_idx;
+
+/*
+ * the producer stalls instead of letting the ring fill up past this point.
+ * This is 1/10 of a second.
+ */
+static const unsigned RING_MAX_FILL = 4410;
+
+/*
+ * when the ring is full, the producer sleeps in steps of RING_POLL_PERIOD
+ * until the callback has made some room.  The callback never has to wake it
+ * up, so it doesn't touch anything but the ring and its indices.  This is
+ * much shorter than the 1/10 of a second that RING_MAX_FILL holds, so the
+ * ring doesn't come anywhere near running dry while the producer sleeps.
+ */
+static const std::chrono::microseconds RING_POLL_PERIOD(500);
+
+/*
+ * in SYNC_MODE_DRC, the producer resamples its input to keep the ring this
+ * full.  The input rate is allowed to deviate from the output rate by up to
+ * DRC_MAX_DEVIATION, which is too small to hear.
+ */
+static const unsigned DRC_TARGET_FILL = RING_MAX_FILL / 2;
+static const double DRC_MAX_DEVIATION = 0.005;
+
+// resampler state for SYNC_MODE_DRC
+static struct frame drc_prev_frame;
+static double drc_phase;
 
-// 1/10 of a second
-static const unsigned BUF_LEN = 4410;
-static washdc_sample_type sample_buf[BUF_LEN];
-static unsigned read_buf_idx, write_buf_idx;
 static bool do_mute, have_sound_dev;
 static enum sync_mode audio_sync_mode;
+static bool use_drc;
 
-void init(void) {
-    washdc_mutex_init(&buffer_lock);
-    washdc_cvar_init(&samples_submitted);
+static_assert(!(RING_LEN & (RING_LEN - 1)),
+              "RING_LEN must be a power of two");
+static_assert(RING_MAX_FILL < RING_LEN, "RING_MAX_FILL is too large");
 
+void init(void) {
     do_mute = false;
     have_sound_dev = true;
+    use_drc = true;
     audio_sync_mode = SYNC_MODE_NORM;
     cfg_get_bool("audio.mute", &do_mute);
+    cfg_get_bool("audio.dynamic-rate-control", &use_drc);
 
-    read_buf_idx = write_buf_idx = 0;
+    ring_read_idx = ring_write_idx = 0;
+    drc_prev_frame = { 0, 0 };
+    drc_phase = 0.0;
 
     int err;
     if ((err = Pa_Initialize()) != paNoError) {
@@ -109,9 +151,6 @@ void cleanup(void) {
             RAISE_ERROR(ERROR_EXT_FAILURE);
         }
     }
-
-    washdc_cvar_cleanup(&samples_submitted);
-    washdc_mutex_cleanup(&buffer_lock);
 }
 
 static int snd_cb(const void *input, void *output,
@@ -119,28 +158,72 @@ static int snd_cb(const void *input, void *output,
                   PaStreamCallbackTimeInfo const *ti,
                   PaStreamCallbackFlags flags,
                   void *argp) {
-    washdc_mutex_lock(&buffer_lock);
-
-    washdc_sample_type *outbuf = (washdc_sample_type*)output;
-    int frame_no;
-    for (frame_no = 0; frame_no < n_frames; frame_no++) {
-        // TODO: stereo
-        washdc_sample_type sample;
-        if (read_buf_idx != write_buf_idx) {
-            sample = sample_buf[read_buf_idx];
-            read_buf_idx = (1 + read_buf_idx) % BUF_LEN;
-        } else {
-            sample = 0;
-        }
-        *outbuf++ = sample;
-        *outbuf++ = sample;
-    }
-    washdc_cvar_signal(&samples_submitted);
+    struct frame *outbuf = (struct frame*)output;
+    unsigned read_idx = ring_read_idx.load(std::memory_order_relaxed);
+    unsigned write_idx = ring_write_idx.load(std::memory_order_acquire);
+
+    unsigned n_avail = std::min<unsigned>(write_idx - read_idx, n_frames);
+    unsigned pos = read_idx & (RING_LEN - 1);
+    unsigned first_len = std::min(n_avail, RING_LEN - pos);
+
+    memcpy(outbuf, ring + pos, first_len * sizeof(struct frame));
+    memcpy(outbuf + first_len, ring,
+           (n_avail - first_len) * sizeof(struct frame));
+
+    ring_read_idx.store(read_idx + n_avail, std::memory_order_release);
+
+    // underrun
+    if (n_avail < n_frames)
+        memset(outbuf + n_avail, 0,
+               (n_frames - n_avail) * sizeof(struct frame));
 
-    washdc_mutex_unlock(&buffer_lock);
     return 0;
 }
 
+static unsigned ring_fill(void) {
+    return ring_write_idx.load(std::memory_order_relaxed) -
+        ring_read_idx.load(std::memory_order_acquire);
+}
+
+// block until the callback has drained the ring below RING_MAX_FILL
+static void ring_wait_for_space(void) {
+    while (ring_fill() >= RING_MAX_FILL)
+        std::this_thread::sleep_for(RING_POLL_PERIOD);
+}
+
+/*
+ * copy frames into the ring.  If there isn't enough room, then this either
+ * waits for the callback to make room or drops whatever doesn't fit,
+ * depending on the sync mode.
+ */
+static void ring_produce(struct frame const *frames, unsigned count) {
+    while (count) {
+        unsigned fill = ring_fill();
+        unsigned space = fill < RING_MAX_FILL ? RING_MAX_FILL - fill : 0;
+
+        if (!space) {
+            if (audio_sync_mode == SYNC_MODE_UNLIMITED)
+                return;
+            ring_wait_for_space();
+            continue;
+        }
+
+        unsigned n_copy = std::min(count, space);
+        unsigned write_idx = ring_write_idx.load(std::memory_order_relaxed);
+        unsigned pos = write_idx & (RING_LEN - 1);
+        unsigned first_len = std::min(n_copy, RING_LEN - pos);
+
+        memcpy(ring + pos, frames, first_len * sizeof(struct frame));
+        memcpy(ring, frames + first_len,
+               (n_copy - first_len) * sizeof(struct frame));
+
+        ring_write_idx.store(write_idx + n_copy, std::memory_order_release);
+
+        frames += n_copy;
+        count -= n_copy;
+    }
+}
+
 static washdc_sample_type scale_sample(washdc_sample_type sample) {
     /*
      * even though we use 32-bit int to store samples, we expect the emu
@@ -150,25 +233,77 @@ static washdc_sample_type scale_sample(washdc_sample_type sample) {
     return sat_shift(sample, 8);
 }
 
+static struct frame make_frame(washdc_sample_type const *sample) {
+    if (do_mute)
+        return { 0, 0 };
+    return { scale_sample(sample[0]), scale_sample(sample[1]) };
+}
+
+/*
+ * resample in_samples (which holds interleaved stereo frames) into out_frames
+ * using linear interpolation, with the rate chosen based on how full the ring
+ * is.  If the ring is too full this produces slightly fewer frames than it was
+ * given, and if it's running low this produces slightly more.  Returns the
+ * number of output frames.
+ */
+static unsigned drc_resample(struct frame *out_frames,
+                             washdc_sample_type const *in_samples,
+                             unsigned in_count) {
+    double err = ((double)ring_fill() - (double)DRC_TARGET_FILL) /
+        (double)DRC_TARGET_FILL;
+    err = std::max(-1.0, std::min(1.0, err));
+
+    // number of input frames consumed for every output frame
+    double step = 1.0 + DRC_MAX_DEVIATION * err;
+
+    unsigned n_out = 0;
+    unsigned idx;
+    for (idx = 0; idx < in_count; idx++) {
+        struct frame cur = make_frame(in_samples + 2 * idx);
+        while (drc_phase < 1.0) {
+            struct frame *outp = out_frames + n_out++;
+            outp->left = (washdc_sample_type)(drc_prev_frame.left +
+                (cur.left - (double)drc_prev_frame.left) * drc_phase);
+            outp->right = (washdc_sample_type)(drc_prev_frame.right +
+                (cur.right - (double)drc_prev_frame.right) * drc_phase);
+            drc_phase += step;
+        }
+        drc_phase -= 1.0;
+        drc_prev_frame = cur;
+    }
+
+    return n_out;
+}
+
 void submit_samples(washdc_sample_type *samples, unsigned count) {
     if (!have_sound_dev)
         return;
-    washdc_mutex_lock(&buffer_lock);
+
+    /*
+     * the resampler can produce at most (1 / (1 - DRC_MAX_DEVIATION)) output
+     * frames per input sample, plus one for its phase.
+     */
+    static const unsigned CHUNK_LEN = 256;
+    struct frame out_frames[CHUNK_LEN * 2];
 
     while (count) {
-        unsigned next_write_buf_idx = (1 + write_buf_idx) % BUF_LEN;
-        if (audio_sync_mode == SYNC_MODE_NORM)
-            while (next_write_buf_idx == read_buf_idx)
-                washdc_cvar_wait(&samples_submitted, &buffer_lock);
-        if (do_mute)
-            sample_buf[write_buf_idx] = 0;
-        else
-            sample_buf[write_buf_idx] = scale_sample(*samples++);
-        write_buf_idx = next_write_buf_idx;
-        count--;
-    }
+        unsigned in_count = std::min(count, CHUNK_LEN);
+        unsigned out_count;
 
-    washdc_mutex_unlock(&buffer_lock);
+        if (audio_sync_mode == SYNC_MODE_DRC) {
+            out_count = drc_resample(out_frames, samples, in_count);
+        } else {
+            unsigned idx;
+            for (idx = 0; idx < in_count; idx++)
+                out_frames[idx] = make_frame(samples + 2 * idx);
+            out_count = in_count;
+        }
+
+        ring_produce(out_frames, out_count);
+
+        samples += 2 * in_count;
+        count -= in_count;
+    }
 }
 
 void mute(bool en_mute) {
@@ -180,6 +315,8 @@ bool is_muted(void) {
 }
 
 void set_sync_mode(enum sync_mode mode) {
+    if (mode == SYNC_MODE_NORM && use_drc)
+        mode = SYNC_MODE_DRC;
     audio_sync_mode = mode;
 }
 
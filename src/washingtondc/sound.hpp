@@ -39,8 +39,19 @@ void mute(bool en_mute);
 bool is_muted(void);
 
 enum sync_mode {
+    // wait for the audio callback whenever the buffer fills up
     SYNC_MODE_NORM,
-    SYNC_MODE_UNLIMITED
+
+    // drop samples instead of waiting
+    SYNC_MODE_UNLIMITED,
+
+    /*
+     * like SYNC_MODE_NORM, but slightly resample the audio to keep the
+     * buffer half-full so that it neither underruns nor stalls the emulator.
+     * set_sync_mode uses this instead of SYNC_MODE_NORM if the
+     * audio.dynamic-rate-control config option is enabled.
+     */
+    SYNC_MODE_DRC
 };
 
 void set_sync_mode(enum sync_mode mode);
@@ -54,6 +54,7 @@
 #include "overlay.hpp"
 
 // see main.cpp
+extern struct washdc_instance *instance;
 extern struct washdc_gameconsole const *console;
 
 static double framerate, virt_framerate;
@@ -61,6 +62,11 @@ static bool not_hidden;
 static bool en_perf_win = true;
 static bool en_demo_win = false;
 static bool en_aica_win = true;
+static bool en_jit_profile_win = false;
+static bool en_perf_counters_win = false;
+
+// whether libwashdc's perf counters are switched on (see en_perf_counters_win)
+static bool perf_counters_on = false;
 
 // disabled by default due to poor performance
 static bool en_tex_cache_win = false;
@@ -83,6 +89,8 @@ static std::unique_ptr<renderer> ui_renderer;
 namespace overlay {
 static void show_perf_win(void);
 static void show_aica_win(void);
+static void show_jit_profile_win(void);
+static void show_perf_counters_win(void);
 static void show_tex_cache_win(void);
 static void show_tex_win(unsigned idx);
 static std::string var_as_str(struct washdc_var const *var);
@@ -136,20 +144,22 @@ void overlay::draw() {
 
         if (ImGui::BeginMenu("File")) {
             if (ImGui::MenuItem("Quit", "Ctrl+Q"))
-                washdc_kill();
+                washdc_kill(instance);
             ImGui::EndMenu();
         }
 
         if (!have_debugger && ImGui::BeginMenu("Execution")) {
-            if (washdc_is_paused()) {
+            if (washdc_is_paused(instance)) {
                 exec_opt = EXEC_OPT_PAUSED;
                 if (ImGui::MenuItem("Resume (normal speed)")) {
                     sound::set_sync_mode(sound::SYNC_MODE_NORM);
+                    washdc_set_frame_pacing(instance, true);
                     exec_opt = EXEC_OPT_100P;
                     do_resume();
                 }
                 if (ImGui::MenuItem("Resume (unlimited speed)")) {
                     sound::set_sync_mode(sound::SYNC_MODE_UNLIMITED);
+                    washdc_set_frame_pacing(instance, false);
                     exec_opt = EXEC_OPT_UNLIMITED;
                     do_resume();
                 }
@@ -163,6 +173,10 @@ void overlay::draw() {
                 ImGui::RadioButton("100% speed", &choice, EXEC_OPT_100P);
                 ImGui::RadioButton("Unlimited speed", &choice, EXEC_OPT_UNLIMITED);
 
+                bool turbo = washdc_get_turbo(instance);
+                if (ImGui::Checkbox("Turbo", &turbo))
+                    washdc_set_turbo(instance, turbo);
+
                 if (choice != (int)exec_opt) {
                     exec_opt = (enum exec_options)choice;
                     switch (exec_opt) {
@@ -171,9 +185,11 @@ void overlay::draw() {
                         break;
                     case EXEC_OPT_100P:
                         sound::set_sync_mode(sound::SYNC_MODE_NORM);
+                        washdc_set_frame_pacing(instance, true);
                         break;
                     case EXEC_OPT_UNLIMITED:
                         sound::set_sync_mode(sound::SYNC_MODE_UNLIMITED);
+                        washdc_set_frame_pacing(instance, false);
                         break;
                     }
                 }
@@ -188,8 +204,11 @@ void overlay::draw() {
 
         if (ImGui::BeginMenu("Window")) {
             ImGui::Checkbox("Performance", &en_perf_win);
+            ImGui::Checkbox("Perf Counters", &en_perf_counters_win);
             ImGui::Checkbox("AICA", &en_aica_win);
             ImGui::Checkbox("Texture Cache", &en_tex_cache_win);
+            if (washdc_jit_sample_enabled(instance))
+                ImGui::Checkbox("JIT Profile", &en_jit_profile_win);
             ImGui::EndMenu();
         }
 
@@ -261,6 +280,16 @@ void overlay::draw() {
         ImGui::ShowDemoWindow(&en_demo_win);
     if (en_aica_win)
         show_aica_win();
+    if (en_jit_profile_win)
+        show_jit_profile_win();
+
+    // only pay for the counters while somebody is looking at them
+    if (en_perf_counters_win != perf_counters_on) {
+        perf_counters_on = en_perf_counters_win;
+        washdc_set_perf_counters(instance, perf_counters_on);
+    }
+    if (en_perf_counters_win)
+        show_perf_counters_win();
 
     for (tex_stat& stat : textures)
         stat.dirty = true;
@@ -291,7 +320,7 @@ void overlay::draw() {
     if (mem_dump_browser->HasSelected()) {
         std::filesystem::path sel = mem_dump_browser->GetSelected();
         mem_dump_browser->Close();
-        washdc_dump_main_memory(sel.string().c_str());
+        washdc_dump_main_memory(instance, sel.string().c_str());
     }
 #endif
 
@@ -312,10 +341,10 @@ static void overlay::show_perf_win(void) {
     static double buf[MAX_FRAMES];
 
     struct washdc_pvr2_stat stat;
-    washdc_get_pvr2_stat(&stat);
+    washdc_get_pvr2_stat(instance, &stat);
 
     double framerate_ratio = framerate / virt_framerate;
-    if (!washdc_is_paused()) {
+    if (!washdc_is_paused(instance)) {
         // update persistent stats
         if (framerate_ratio > best)
             best = framerate_ratio;
@@ -334,7 +363,7 @@ static void overlay::show_perf_win(void) {
 
     ImGui::Begin("Performance", &en_perf_win);
     ImGui::Text("Framerate: %.2f / %.2f (%.2f%%)", framerate, virt_framerate, 100.0 * framerate_ratio);
-    ImGui::Text("%u frames rendered\n", washdc_get_frame_count());
+    ImGui::Text("%u frames rendered\n", washdc_get_frame_count(instance));
 
     ImGui::Text("Best: %f%%", 100.0 * best);
     ImGui::Text("Worst: %f%%", 100.0 * worst);
@@ -366,6 +395,65 @@ static void overlay::show_perf_win(void) {
     ImGui::End();
 }
 
+static void overlay::show_jit_profile_win(void) {
+    static const unsigned MAX_BLOCKS = 32;
+    struct washdc_jit_sample_blk blks[MAX_BLOCKS];
+    struct washdc_jit_sample_stat stat;
+
+    unsigned n_blocks = washdc_jit_sample_top(instance,
+                                              blks, MAX_BLOCKS, &stat);
+    double total = stat.n_samples ? stat.n_samples : 1.0;
+
+    ImGui::Begin("JIT Profile", &en_jit_profile_win);
+    if (ImGui::Button("Reset"))
+        washdc_jit_sample_reset(instance);
+    ImGui::Text("%llu samples in %u blocks", stat.n_samples, stat.n_blocks);
+    ImGui::Text("%.1f%% outside JIT code, %.1f%% compiling",
+                100.0 * stat.n_outside / total,
+                100.0 * stat.n_compiling / total);
+    ImGui::Text("address         %%  cycles  IL  fallbacks  compiles");
+    for (unsigned idx = 0; idx < n_blocks; idx++) {
+        ImGui::Text("0x%08x %6.2f %7u %3u %10u %9u",
+                    (unsigned)blks[idx].addr,
+                    100.0 * blks[idx].n_samples / total,
+                    blks[idx].cycle_count, blks[idx].n_il_insts,
+                    blks[idx].n_fallbacks, blks[idx].n_compiles);
+    }
+    ImGui::End();
+}
+
+static void overlay::show_perf_counters_win(void) {
+    // in the same order as enum washdc_perf_cat
+    static char const *const cat_names[WASHDC_PERF_CAT_COUNT] = {
+        "SH4", "ARM7", "AICA", "TA", "render", "texture upload",
+        "JIT compile", "GD-ROM", "other"
+    };
+
+    struct washdc_perf_counters perf;
+
+    ImGui::Begin("Perf Counters", &en_perf_counters_win);
+    if (!washdc_get_perf_counters(instance, &perf)) {
+        ImGui::Text("waiting for the first frame...");
+        ImGui::End();
+        return;
+    }
+
+    double host_ms = perf.host_ns / 1000000.0;
+    double total = perf.host_ns ? perf.host_ns : 1.0;
+
+    ImGui::Text("frame %u: %.3f ms host, %.3f ms emulated", perf.frame_no,
+                host_ms, perf.virt_ns / 1000000.0);
+    ImGui::Text("%llu code cache misses", perf.code_cache_misses);
+    ImGui::Text("category            ms       %%   calls");
+    for (unsigned cat = 0; cat < WASHDC_PERF_CAT_COUNT; cat++) {
+        ImGui::Text("%-15s %9.3f %7.2f %7u", cat_names[cat],
+                    perf.cat_ns[cat] / 1000000.0,
+                    100.0 * perf.cat_ns[cat] / total,
+                    perf.cat_count[cat]);
+    }
+    ImGui::End();
+}
+
 static void overlay::show_aica_win(void) {
     ImGui::Begin("AICA", &en_aica_win);
     ImGui::BeginChild("Scrolling");
@@ -625,15 +713,18 @@ void overlay::init(bool enable_debugger) {
     if (exec_mode_str == NULL || strcmp(exec_mode_str, "full") == 0) {
         exec_opt = EXEC_OPT_100P;
         sound::set_sync_mode(sound::SYNC_MODE_NORM);
+        washdc_set_frame_pacing(instance, true);
     } else if (strcmp(exec_mode_str, "unlimited") == 0) {
         exec_opt = EXEC_OPT_UNLIMITED;
         sound::set_sync_mode(sound::SYNC_MODE_UNLIMITED);
+        washdc_set_frame_pacing(instance, false);
     } else if (strcmp(exec_mode_str, "pause") == 0) {
         exec_opt = EXEC_OPT_PAUSED;
         do_pause();
     } else {
         exec_opt = EXEC_OPT_100P;
         sound::set_sync_mode(sound::SYNC_MODE_NORM);
+        washdc_set_frame_pacing(instance, true);
         std::cerr << "Unrecognized execution mode \"" <<
             exec_mode_str << "\"" << std::endl;
     }
@@ -36,9 +36,13 @@
 #include "ui/overlay.hpp"
 #include "sound.hpp"
 
+extern struct washdc_instance *instance;
+
 static void win_glfw_init(unsigned width, unsigned height);
 static void win_glfw_cleanup();
 static void win_glfw_check_events(void);
+static void win_glfw_wait_events(void);
+static void win_glfw_wake_events(void);
 static void win_glfw_update(void);
 static void win_glfw_make_context_current(void);
 static void win_glfw_update_title(void);
@@ -83,6 +87,8 @@ struct win_intf const* get_win_intf_glfw(void) {
     win_intf_glfw.get_width = win_glfw_get_width;
     win_intf_glfw.get_height = win_glfw_get_height;
     win_intf_glfw.update_title = win_glfw_update_title;
+    win_intf_glfw.wait_events = win_glfw_wait_events;
+    win_intf_glfw.wake_events = win_glfw_wake_events;
 
     return &win_intf_glfw;
 }
@@ -175,11 +181,12 @@ static void win_glfw_init(unsigned width, unsigned height) {
         printf("Enabling fullscreen mode.\n");
         res_x = vidmode->width;
         res_y = vidmode->height;
-        win = glfwCreateWindow(res_x, res_y, washdc_win_get_title(),
+        win = glfwCreateWindow(res_x, res_y, washdc_win_get_title(instance),
                                monitor, NULL);
     } else {
         printf("Enabling windowed mode.\n");
-        win = glfwCreateWindow(res_x, res_y, washdc_win_get_title(), NULL, NULL);
+        win = glfwCreateWindow(res_x, res_y, washdc_win_get_title(instance),
+                               NULL, NULL);
     }
 
     if (!win) {
@@ -209,6 +216,7 @@ static void win_glfw_init(unsigned width, unsigned height) {
     bind_ctrl_from_cfg("toggle-wireframe", "wash.ctrl.toggle-wireframe");
     bind_ctrl_from_cfg("screenshot", "wash.ctrl.screenshot");
     bind_ctrl_from_cfg("toggle-mute", "wash.ctrl.toggle-mute");
+    bind_ctrl_from_cfg("toggle-turbo", "wash.ctrl.toggle-turbo");
     bind_ctrl_from_cfg("resume-execution", "wash.ctrl.resume-execution");
     bind_ctrl_from_cfg("run-one-frame", "wash.ctrl.run-one-frame");
     bind_ctrl_from_cfg("pause-execution", "wash.ctrl.pause-execution");
@@ -626,7 +634,27 @@ static void win_glfw_check_events(void) {
     overlay::update();
 
     if (glfwWindowShouldClose(win))
-        washdc_kill();
+        washdc_kill(instance);
+}
+
+/*
+ * joysticks don't generate GLFW events, so if there's one plugged in then
+ * this still needs to wake up periodically in case somebody pushes a button
+ * that's bound to resume-execution.
+ */
+static void win_glfw_wait_events(void) {
+    int js;
+    for (js = GLFW_JOYSTICK_1; js <= GLFW_JOYSTICK_LAST; js++) {
+        if (glfwJoystickPresent(js)) {
+            glfwWaitEventsTimeout(1.0 / 60.0);
+            return;
+        }
+    }
+    glfwWaitEvents();
+}
+
+static void win_glfw_wake_events(void) {
+    glfwPostEmptyEvent();
 }
 
 static void win_glfw_update() {
@@ -634,7 +662,7 @@ static void win_glfw_update() {
 }
 
 static void expose_callback(GLFWwindow *win) {
-    washdc_on_expose();
+    washdc_on_expose(instance);
 }
 
 enum gamepad_btn {
@@ -665,7 +693,7 @@ static char const *bind_name(unsigned ctrlr, char const *bind) {
 
 static void scan_input_for_controller(unsigned which) {
     if (which >= 4 ||
-        (washdc_controller_type(which) !=
+        (washdc_controller_type(instance, which) !=
          WASHDC_CONTROLLER_TP_DREAMCAST_CONTROLLER)) {
         return;
     }
@@ -781,54 +809,70 @@ static void scan_input_for_controller(unsigned which) {
         ctrl_get_button(bind_name(which, "_2.dpad-right"));
 
     if (btns[GAMEPAD_BTN_A])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_A_MASK);
+        washdc_controller_press_btns(instance, which, WASHDC_CONT_BTN_A_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_A_MASK);
+        washdc_controller_release_btns(instance, which, WASHDC_CONT_BTN_A_MASK);
     if (btns[GAMEPAD_BTN_B])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_B_MASK);
+        washdc_controller_press_btns(instance, which, WASHDC_CONT_BTN_B_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_B_MASK);
+        washdc_controller_release_btns(instance, which, WASHDC_CONT_BTN_B_MASK);
     if (btns[GAMEPAD_BTN_X])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_X_MASK);
+        washdc_controller_press_btns(instance, which, WASHDC_CONT_BTN_X_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_X_MASK);
+        washdc_controller_release_btns(instance, which, WASHDC_CONT_BTN_X_MASK);
     if (btns[GAMEPAD_BTN_Y])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_Y_MASK);
+        washdc_controller_press_btns(instance, which, WASHDC_CONT_BTN_Y_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_Y_MASK);
+        washdc_controller_release_btns(instance, which, WASHDC_CONT_BTN_Y_MASK);
     if (btns[GAMEPAD_BTN_START])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_START_MASK);
+        washdc_controller_press_btns(instance, which,
+                                     WASHDC_CONT_BTN_START_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_START_MASK);
+        washdc_controller_release_btns(instance, which,
+                                       WASHDC_CONT_BTN_START_MASK);
 
     if (hat[GAMEPAD_HAT_UP])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_DPAD_UP_MASK);
+        washdc_controller_press_btns(instance, which,
+                                     WASHDC_CONT_BTN_DPAD_UP_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_DPAD_UP_MASK);
+        washdc_controller_release_btns(instance, which,
+                                       WASHDC_CONT_BTN_DPAD_UP_MASK);
     if (hat[GAMEPAD_HAT_DOWN])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_DPAD_DOWN_MASK);
+        washdc_controller_press_btns(instance, which,
+                                     WASHDC_CONT_BTN_DPAD_DOWN_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_DPAD_DOWN_MASK);
+        washdc_controller_release_btns(instance, which,
+                                       WASHDC_CONT_BTN_DPAD_DOWN_MASK);
     if (hat[GAMEPAD_HAT_LEFT])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_DPAD_LEFT_MASK);
+        washdc_controller_press_btns(instance, which,
+                                     WASHDC_CONT_BTN_DPAD_LEFT_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_DPAD_LEFT_MASK);
+        washdc_controller_release_btns(instance, which,
+                                       WASHDC_CONT_BTN_DPAD_LEFT_MASK);
     if (hat[GAMEPAD_HAT_RIGHT])
-        washdc_controller_press_btns(which, WASHDC_CONT_BTN_DPAD_RIGHT_MASK);
+        washdc_controller_press_btns(instance, which,
+                                     WASHDC_CONT_BTN_DPAD_RIGHT_MASK);
     else
-        washdc_controller_release_btns(which, WASHDC_CONT_BTN_DPAD_RIGHT_MASK);
-
-    washdc_controller_set_axis(which, WASHDC_CONTROLLER_AXIS_R_TRIG, trig_r);
-    washdc_controller_set_axis(which, WASHDC_CONTROLLER_AXIS_L_TRIG, trig_l);
-    washdc_controller_set_axis(which, WASHDC_CONTROLLER_AXIS_JOY1_X, stick_hor);
-    washdc_controller_set_axis(which, WASHDC_CONTROLLER_AXIS_JOY1_Y, stick_vert);
-    washdc_controller_set_axis(which, WASHDC_CONTROLLER_AXIS_JOY2_X, 0);
-    washdc_controller_set_axis(which, WASHDC_CONTROLLER_AXIS_JOY2_Y, 0);
+        washdc_controller_release_btns(instance, which,
+                                       WASHDC_CONT_BTN_DPAD_RIGHT_MASK);
+
+    washdc_controller_set_axis(instance, which,
+                               WASHDC_CONTROLLER_AXIS_R_TRIG, trig_r);
+    washdc_controller_set_axis(instance, which,
+                               WASHDC_CONTROLLER_AXIS_L_TRIG, trig_l);
+    washdc_controller_set_axis(instance, which,
+                               WASHDC_CONTROLLER_AXIS_JOY1_X, stick_hor);
+    washdc_controller_set_axis(instance, which,
+                               WASHDC_CONTROLLER_AXIS_JOY1_Y, stick_vert);
+    washdc_controller_set_axis(instance, which,
+                               WASHDC_CONTROLLER_AXIS_JOY2_X, 0);
+    washdc_controller_set_axis(instance, which,
+                               WASHDC_CONTROLLER_AXIS_JOY2_Y, 0);
 }
 
 static void scan_input_for_keyboard(unsigned which) {
     if (which >= 4 ||
-        (washdc_controller_type(which) !=
+        (washdc_controller_type(instance, which) !=
          WASHDC_CONTROLLER_TP_DREAMCAST_KEYBOARD)) {
         return;
     }
@@ -1059,7 +1103,7 @@ static void scan_input_for_keyboard(unsigned which) {
     int idx = 0;
     char const **curs = kbd_bind_names;
     while (*curs) {
-        washdc_keyboard_set_btn(which, idx++,
+        washdc_keyboard_set_btn(instance, which, idx++,
                                 ctrl_get_button(bind_name(which, *curs++)));
     }
 
@@ -1089,8 +1133,10 @@ static void scan_input_for_keyboard(unsigned which) {
         ctrl_get_button(bind_name(which, "_2.kbd_s2")))
         mods |= WASHDC_KEYBOARD_S1;
 
-    washdc_keyboard_press_special(which, (enum washdc_keyboard_special_keys)mods);
-    washdc_keyboard_release_special(which, (enum washdc_keyboard_special_keys)~mods);
+    washdc_keyboard_press_special(instance, which,
+                                  (enum washdc_keyboard_special_keys)mods);
+    washdc_keyboard_release_special(instance, which,
+                                    (enum washdc_keyboard_special_keys)~mods);
 }
 
 static void scan_input(void) {
@@ -1114,7 +1160,7 @@ static void scan_input(void) {
     static bool wireframe_key_prev = false;
     bool wireframe_key = ctrl_get_button("toggle-wireframe");
     if (wireframe_key && !wireframe_key_prev)
-        washdc_gfx_toggle_wireframe();
+        washdc_gfx_toggle_wireframe(instance);
     wireframe_key_prev = wireframe_key;
 
     // Allow the user to toggle fullscreen
@@ -1127,13 +1173,13 @@ static void scan_input(void) {
     static bool filter_key_prev = false;
     bool filter_key = ctrl_get_button("toggle-filter");
     if (filter_key && !filter_key_prev)
-        washdc_gfx_toggle_filter();
+        washdc_gfx_toggle_filter(instance);
     filter_key_prev = filter_key;
 
     static bool screenshot_key_prev = false;
     bool screenshot_key = ctrl_get_button("screenshot");
     if (screenshot_key && !screenshot_key_prev)
-        washdc_save_screenshot_dir();
+        washdc_save_screenshot_dir(instance);
     screenshot_key_prev = screenshot_key;
 
     static bool mute_key_prev = false;
@@ -1142,34 +1188,40 @@ static void scan_input(void) {
         sound::mute(!sound::is_muted());
     mute_key_prev = mute_key;
 
+    static bool turbo_key_prev = false;
+    bool turbo_key = ctrl_get_button("toggle-turbo");
+    if (turbo_key && !turbo_key_prev)
+        washdc_set_turbo(instance, !washdc_get_turbo(instance));
+    turbo_key_prev = turbo_key;
+
     static bool resume_key_prev = false;
     bool resume_key = ctrl_get_button("resume-execution");
     if (resume_key && !resume_key_prev) {
-        if (washdc_is_paused())
-            washdc_resume();
+        if (washdc_is_paused(instance))
+            washdc_resume(instance);
     }
     resume_key_prev = resume_key;
 
     static bool run_frame_prev = false;
     bool run_frame_key = ctrl_get_button("run-one-frame");
     if (run_frame_key && !run_frame_prev) {
-        if (washdc_is_paused())
-            washdc_run_one_frame();
+        if (washdc_is_paused(instance))
+            washdc_run_one_frame(instance);
     }
     run_frame_prev = run_frame_key;
 
     static bool pause_key_prev = false;
     bool pause_key = ctrl_get_button("pause-execution");
     if (pause_key && !pause_key_prev) {
-        if (!washdc_is_paused())
-            washdc_pause();
+        if (!washdc_is_paused(instance))
+            washdc_pause(instance);
     }
     pause_key_prev = pause_key;
 
     bool exit_key = ctrl_get_button("exit-now");
     if (exit_key) {
         printf("emergency exit button pressed - WashingtonDC will exit soon.\n");
-        washdc_kill();
+        washdc_kill(instance);
     }
 }
 
@@ -1178,13 +1230,13 @@ static void win_glfw_make_context_current(void) {
 }
 
 static void win_glfw_update_title(void) {
-    glfwSetWindowTitle(win, washdc_win_get_title());
+    glfwSetWindowTitle(win, washdc_win_get_title(instance));
 }
 
 static void resize_callback(GLFWwindow *win, int width, int height) {
     res_x = width;
     res_y = height;
-    washdc_on_resize(width, height);
+    washdc_on_resize(instance, width, height);
 }
 
 int win_glfw_get_width(void) {
@@ -1220,7 +1272,7 @@ static void toggle_fullscreen(void) {
     }
 
     if (res_x != old_res_x || res_y != old_res_y)
-        washdc_on_resize(res_x, res_y);
+        washdc_on_resize(instance, res_x, res_y);
 }
 
 static void toggle_overlay(void) {